@@ -82,6 +82,14 @@ static ILCmdLineOption const options[] = {
 	{"--keep-going", 'k', 0,
 		"--keep-going           or -k",
 		"Keep processing even after an error."},
+	{"-j", 'j', 1, 0, 0},
+	{"--jobs", 'j', 1,
+		"--jobs n               or -j n",
+		"Build up to `n' independent targets at the same time."},
+	{"-o", 'o', 1, 0, 0},
+	{"--object-cache", 'o', 1,
+		"--object-cache dir     or -o dir",
+		"Cache the object files compiled by cscc in `dir'."},
 	{"-s", 's', 0, 0, 0},
 	{"--silent", 's', 0,
 		"--silent               or -s",
@@ -126,7 +134,6 @@ static char *progname;
 static void usage(const char *progname);
 static void version(void);
 static char *defaultBuildFile(const char *baseDir);
-static int xmlRead(void *data, void *buffer, int len);
 
 int main(int argc, char *argv[])
 {
@@ -210,6 +217,22 @@ int main(int argc, char *argv[])
 			}
 			break;
 
+			case 'j':
+			{
+				CSAntJobs = atoi(param);
+				if(CSAntJobs < 1)
+				{
+					CSAntJobs = 1;
+				}
+			}
+			break;
+
+			case 'o':
+			{
+				CSAntObjectCache = param;
+			}
+			break;
+
 			case 's':
 			{
 				CSAntSilent = 1;
@@ -311,7 +334,7 @@ int main(int argc, char *argv[])
 	}
 	else
 	{
-		if((reader = ILXMLCreate(xmlRead, infile, 0)) == 0)
+		if((reader = ILXMLCreateFromStream(infile, 0)) == 0)
 		{
 			CSAntOutOfMemory();
 		}
@@ -333,7 +356,7 @@ int main(int argc, char *argv[])
 		}
 		else
 		{
-			if((reader = ILXMLCreate(xmlRead, infile, 0)) == 0)
+			if((reader = ILXMLCreateFromStream(infile, 0)) == 0)
 			{
 				CSAntOutOfMemory();
 			}
@@ -428,21 +451,6 @@ static char *defaultBuildFile(const char *baseDir)
 	return combined;
 }
 
-/*
- * Read a block of bytes from a file-based XML input stream.
- */
-static int xmlRead(void *data, void *buffer, int len)
-{
-	if(!feof((FILE *)data))
-	{
-		return fread(buffer, 1, len, (FILE *)data);
-	}
-	else
-	{
-		return 0;
-	}
-}
-
 void CSAntOutOfMemory(void)
 {
 	fputs(progname, stderr);
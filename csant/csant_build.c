@@ -19,6 +19,9 @@
  */
 
 #include "csant_defs.h"
+#ifdef HAVE_UNISTD_H
+	#include <unistd.h>
+#endif
 
 #ifdef	__cplusplus
 extern	"C" {
@@ -32,8 +35,11 @@ int   CSAntDummyDoc      = 0;
 int   CSAntForceCorLib   = 0;
 int   CSAntInstallMode   = 0;
 int   CSAntUninstallMode = 0;
+int   CSAntJobs          = 1;
 char *CSAntCompiler      = 0;
 char *CSAntCacheDir      = 0;
+char *CSAntObjectCache   = 0;
+char *CSAntObjectCacheStats = 0;
 
 /*
  * List of non-global targets that are registered to be built.
@@ -157,6 +163,90 @@ static int ProcessTask(CSAntTask *task)
 	return 0;
 }
 
+/*
+ * Print the message that indicates that a target is being built.
+ */
+static void StartTarget(CSAntTarget *target)
+{
+	if(!CSAntSilent)
+	{
+		if(target->name)
+		{
+			if(CSAntProjectName)
+			{
+				printf("Building target `%s' for project `%s'\n",
+					   target->name, CSAntProjectName);
+			}
+			else
+			{
+				printf("Building target `%s'\n", target->name);
+			}
+		}
+	}
+}
+
+/*
+ * Print the message that indicates that we are done with a target.
+ */
+static void EndTarget(CSAntTarget *target, int success)
+{
+	if(!CSAntSilent)
+	{
+		if(success)
+		{
+			if(target->name)
+			{
+				if(CSAntProjectName)
+				{
+					printf("Leaving target `%s' for project `%s'\n",
+						   target->name, CSAntProjectName);
+				}
+				else
+				{
+					printf("Leaving target `%s'\n", target->name);
+				}
+			}
+		}
+		else
+		{
+			if(target->name)
+			{
+				if(CSAntProjectName)
+				{
+					printf("*** Target `%s' for project `%s' failed ***\n",
+						   target->name, CSAntProjectName);
+				}
+				else
+				{
+					printf("*** Target `%s' failed ***\n", target->name);
+				}
+			}
+		}
+	}
+}
+
+/*
+ * Process the tasks within a target.  Returns zero on failure.
+ */
+static int ProcessTasks(CSAntTarget *target)
+{
+	int success = 1;
+	CSAntTask *task = target->tasks;
+	while(task != 0)
+	{
+		if(!ProcessTask(task))
+		{
+			success = 0;
+			if(!CSAntKeepGoing)
+			{
+				break;
+			}
+		}
+		task = task->next;
+	}
+	return success;
+}
+
 /*
  * Build a specific target.  Returns zero on failure.
  */
@@ -165,7 +255,6 @@ static int BuildTarget(const char *name, CSAntTarget *target)
 	int success = 1;
 	int error = 0;
 	int posn;
-	CSAntTask *task;
 
 	/* Find the target by name */
 	if(!target)
@@ -191,21 +280,7 @@ static int BuildTarget(const char *name, CSAntTarget *target)
 	target->built = 1;
 
 	/* Print a debug message indicating the target that we are building */
-	if(!CSAntSilent)
-	{
-		if(target->name)
-		{
-			if(CSAntProjectName)
-			{
-				printf("Building target `%s' for project `%s'\n",
-					   target->name, CSAntProjectName);
-			}
-			else
-			{
-				printf("Building target `%s'\n", target->name);
-			}
-		}
-	}
+	StartTarget(target);
 
 	/* Build all of the targets that we depend upon */
 	for(posn = 0; !error && posn < target->numDependsOn; ++posn)
@@ -224,58 +299,345 @@ static int BuildTarget(const char *name, CSAntTarget *target)
 	}
 
 	/* Process the tasks within the target */
-	task = target->tasks;
-	while(!error && task != 0)
+	if(!error && !ProcessTasks(target))
 	{
-		if(!ProcessTask(task))
+		if(CSAntKeepGoing)
 		{
-			if(CSAntKeepGoing)
-			{
-				success = 0;
-			}
-			else
-			{
-				error = 1;
-			}
+			success = 0;
+		}
+		else
+		{
+			error = 1;
 		}
-		task = task->next;
 	}
 
 	/* Print a debug message indicating the target that we are done with */
-	if(!CSAntSilent)
+	EndTarget(target, !error && success);
+
+	/* Done */
+	if(error)
 	{
-		if(!error && success)
+		return 0;
+	}
+	else
+	{
+		return success;
+	}
+}
+
+/*
+ * States of a target during a parallel build.
+ */
+#define	JOB_WAITING		0
+#define	JOB_RUNNING		1
+#define	JOB_DONE		2
+#define	JOB_FAILED		3
+
+/*
+ * Information about a target during a parallel build.
+ */
+typedef struct
+{
+	CSAntTarget	   *target;
+	int				state;
+	int				inParent;
+	int				pid;
+	FILE		   *output;
+	FILE		   *errors;
+
+} CSAntJob;
+
+/*
+ * Find the job for a target, or -1 if it is not part of the build.
+ */
+static int FindJob(CSAntJob *jobs, int numJobs, CSAntTarget *target)
+{
+	int posn;
+	for(posn = 0; posn < numJobs; ++posn)
+	{
+		if(jobs[posn].target == target)
 		{
-			if(target->name)
+			return posn;
+		}
+	}
+	return -1;
+}
+
+/*
+ * Determine if a target must be built by the csant process itself.
+ * Properties and <call> targets affect the state of the build,
+ * which would be lost if they were processed in a child process.
+ */
+static int MustBuildInParent(CSAntTarget *target)
+{
+	CSAntTask *task = target->tasks;
+	while(task != 0)
+	{
+		if(!strcmp(task->name, "property") || !strcmp(task->name, "call"))
+		{
+			return 1;
+		}
+		task = task->next;
+	}
+	return 0;
+}
+
+/*
+ * Collect a target and its dependencies into the job list, in the
+ * order that a serial build would finish them.  Returns zero if
+ * the target could not be found.
+ */
+static int CollectJobs(CSAntJob **jobs, int *numJobs,
+					   const char *name, CSAntTarget *target)
+{
+	int ok = 1;
+	int posn;
+
+	/* Find the target by name */
+	if(!target)
+	{
+		target = CSAntFindTarget(name);
+		if(!target)
+		{
+			fprintf(stderr, "%s: no such target\n", name);
+			return 0;
+		}
+	}
+
+	/* Skip targets that are already built or collected.  Targets that
+	   we are in the middle of collecting are ignored, to trap cycles
+	   in the same way as "BuildTarget" */
+	if(target->built || FindJob(*jobs, *numJobs, target) >= 0)
+	{
+		return 1;
+	}
+	target->built = 1;
+	for(posn = 0; posn < target->numDependsOn; ++posn)
+	{
+		if(!CollectJobs(jobs, numJobs, 0, target->dependsOn[posn]))
+		{
+			ok = 0;
+		}
+	}
+	target->built = 0;
+
+	/* Add the target to the job list */
+	*jobs = (CSAntJob *)ILRealloc(*jobs, sizeof(CSAntJob) * (*numJobs + 1));
+	if(!(*jobs))
+	{
+		CSAntOutOfMemory();
+	}
+	(*jobs)[*numJobs].target = target;
+	(*jobs)[*numJobs].state = JOB_WAITING;
+	(*jobs)[*numJobs].inParent = MustBuildInParent(target);
+	(*jobs)[*numJobs].pid = 0;
+	(*jobs)[*numJobs].output = 0;
+	(*jobs)[*numJobs].errors = 0;
+	++(*numJobs);
+	return ok;
+}
+
+/*
+ * Copy the captured output of a child process to a stream.
+ */
+static void CopyOutput(FILE *captured, FILE *stream)
+{
+	char buffer[BUFSIZ];
+	size_t len;
+	if(captured)
+	{
+		rewind(captured);
+		while((len = fread(buffer, 1, sizeof(buffer), captured)) > 0)
+		{
+			fwrite(buffer, 1, len, stream);
+		}
+		fclose(captured);
+	}
+}
+
+/*
+ * Build a target in a child process.
+ */
+static int BuildJob(void *arg)
+{
+	CSAntTarget *target = (CSAntTarget *)arg;
+	int success;
+	StartTarget(target);
+	success = ProcessTasks(target);
+	EndTarget(target, success);
+	return (success ? 0 : 1);
+}
+
+/*
+ * Build the jobs in the list, running up to "CSAntJobs" at a time.
+ * Returns zero on failure.
+ */
+static int BuildJobs(CSAntJob *jobs, int numJobs)
+{
+	int success = 1;
+	int error = 0;
+	int running = 0;
+	int nextOutput = 0;
+	int posn, dep, ready;
+	int pid, status;
+	CSAntJob *job;
+
+	for(;;)
+	{
+		/* Print the output of finished jobs, in build order */
+		while(nextOutput < numJobs &&
+			  jobs[nextOutput].state >= JOB_DONE)
+		{
+			job = &(jobs[nextOutput++]);
+			CopyOutput(job->output, stdout);
+			fflush(stdout);
+			CopyOutput(job->errors, stderr);
+			job->output = 0;
+			job->errors = 0;
+		}
+
+		/* Start all jobs whose dependencies have been built */
+		for(posn = 0; !error && posn < numJobs &&
+					  running < CSAntJobs; ++posn)
+		{
+			job = &(jobs[posn]);
+			if(job->state != JOB_WAITING)
 			{
-				if(CSAntProjectName)
+				continue;
+			}
+			if(job->inParent)
+			{
+				/* Build on our own once everything before is done.
+				   Later jobs may depend upon the state that this one
+				   changes, so they must wait until it is finished */
+				if(running != 0 || nextOutput != posn)
 				{
-					printf("Leaving target `%s' for project `%s'\n",
-						   target->name, CSAntProjectName);
+					break;
+				}
+				job->state = (BuildTarget(0, job->target)
+								? JOB_DONE : JOB_FAILED);
+				++nextOutput;
+			}
+			else
+			{
+				/* Skip the job if its dependencies are not built yet */
+				ready = 1;
+				for(dep = 0; dep < job->target->numDependsOn; ++dep)
+				{
+					status = FindJob(jobs, posn, job->target->dependsOn[dep]);
+					if(status >= 0 && jobs[status].state < JOB_DONE)
+					{
+						ready = 0;
+						break;
+					}
+				}
+				if(!ready)
+				{
+					continue;
+				}
+
+				/* A <call> task may have built the target already */
+				if(job->target->built)
+				{
+					job->state = JOB_DONE;
+					continue;
+				}
+
+				/* Launch a child process to build the target */
+				job->target->built = 1;
+				pid = ILSpawnFunction(BuildJob, job->target,
+									  (void **)&(job->output),
+									  (void **)&(job->errors));
+				if(pid > 0)
+				{
+					job->pid = pid;
+					job->state = JOB_RUNNING;
+					++running;
+					continue;
+				}
+				else if(pid < 0)
+				{
+					job->state = JOB_FAILED;
+				}
+				else if(running == 0 && nextOutput == posn)
+				{
+					/* Child processes are not supported on this
+					   system, so build the target directly */
+					job->state = (BuildJob(job->target)
+									? JOB_FAILED : JOB_DONE);
+					++nextOutput;
 				}
 				else
 				{
-					printf("Leaving target `%s'\n", target->name);
+					/* Try again once the jobs before this one are done */
+					job->target->built = 0;
+					break;
+				}
+			}
+
+			/* Stop starting jobs after a failure unless keeping going */
+			if(job->state == JOB_FAILED)
+			{
+				if(CSAntKeepGoing)
+				{
+					success = 0;
+				}
+				else
+				{
+					error = 1;
 				}
 			}
 		}
-		else
+
+		/* Wait for the next job to finish */
+		if(!running)
 		{
-			if(target->name)
+			if(error || nextOutput >= numJobs)
 			{
-				if(CSAntProjectName)
+				break;
+			}
+			continue;
+		}
+		pid = ILSpawnWaitForAny(&status);
+		if(pid < 0)
+		{
+			break;
+		}
+		for(posn = 0; posn < numJobs; ++posn)
+		{
+			job = &(jobs[posn]);
+			if(job->state == JOB_RUNNING && job->pid == pid)
+			{
+				--running;
+				if(status == 0)
 				{
-					printf("*** Target `%s' for project `%s' failed ***\n",
-						   target->name, CSAntProjectName);
+					job->state = JOB_DONE;
 				}
 				else
 				{
-					printf("*** Target `%s' failed ***\n", target->name);
+					job->state = JOB_FAILED;
+					if(CSAntKeepGoing)
+					{
+						success = 0;
+					}
+					else
+					{
+						error = 1;
+					}
 				}
+				break;
 			}
 		}
 	}
 
+	/* Print the output of any jobs that finished after a failure */
+	for(posn = nextOutput; posn < numJobs; ++posn)
+	{
+		CopyOutput(jobs[posn].output, stdout);
+		fflush(stdout);
+		CopyOutput(jobs[posn].errors, stderr);
+	}
+
 	/* Done */
 	if(error)
 	{
@@ -287,6 +649,54 @@ static int BuildTarget(const char *name, CSAntTarget *target)
 	}
 }
 
+/*
+ * Create the statistics file for the object cache, which "cscc"
+ * appends a line to for each lookup.
+ */
+static void StartObjectCache(void)
+{
+	int len = strlen(CSAntObjectCache);
+	ILCreateDir(CSAntObjectCache);
+	CSAntObjectCacheStats = (char *)ILMalloc(len + 32);
+	if(!CSAntObjectCacheStats)
+	{
+		CSAntOutOfMemory();
+	}
+#ifdef HAVE_GETPID
+	sprintf(CSAntObjectCacheStats, "%s/stats.%ld",
+			CSAntObjectCache, (long)getpid());
+#else
+	sprintf(CSAntObjectCacheStats, "%s/stats", CSAntObjectCache);
+#endif
+	ILDeleteFile(CSAntObjectCacheStats);
+}
+
+/*
+ * Report the hit ratio for the object cache.
+ */
+static void ReportObjectCache(void)
+{
+	FILE *file;
+	long hit, miss;
+	long hits = 0;
+	long misses = 0;
+	if((file = fopen(CSAntObjectCacheStats, "r")) != NULL)
+	{
+		while(fscanf(file, "%ld %ld", &hit, &miss) == 2)
+		{
+			hits += hit;
+			misses += miss;
+		}
+		fclose(file);
+		ILDeleteFile(CSAntObjectCacheStats);
+	}
+	if(!CSAntSilent && (hits + misses) > 0)
+	{
+		printf("Object cache: %ld hits, %ld misses (%ld%% hit ratio)\n",
+			   hits, misses, (hits * 100) / (hits + misses));
+	}
+}
+
 int CSAntBuild(const char *buildFilename)
 {
 	int posn;
@@ -302,6 +712,12 @@ int CSAntBuild(const char *buildFilename)
 		CSAntAddBuildTarget(CSAntDefaultTarget);
 	}
 
+	/* Prepare to collect statistics for the object cache */
+	if(CSAntObjectCache)
+	{
+		StartObjectCache();
+	}
+
 	/* Print a debug message indicating the project that we are building */
 	if(!CSAntSilent)
 	{
@@ -329,7 +745,42 @@ int CSAntBuild(const char *buildFilename)
 	}
 
 	/* Build the specified targets */
-	for(posn = 0; !error && posn < numTargets; ++posn)
+	if(!error && CSAntJobs > 1)
+	{
+		/* Build independent targets in parallel */
+		CSAntJob *jobs = 0;
+		int numJobs = 0;
+		for(posn = 0; posn < numTargets; ++posn)
+		{
+			if(!CollectJobs(&jobs, &numJobs, targets[posn], 0))
+			{
+				if(CSAntKeepGoing)
+				{
+					success = 0;
+				}
+				else
+				{
+					error = 1;
+				}
+			}
+		}
+		if(!error && !BuildJobs(jobs, numJobs))
+		{
+			if(CSAntKeepGoing)
+			{
+				success = 0;
+			}
+			else
+			{
+				error = 1;
+			}
+		}
+		if(jobs)
+		{
+			ILFree(jobs);
+		}
+	}
+	for(posn = 0; !error && CSAntJobs <= 1 && posn < numTargets; ++posn)
 	{
 		if(!BuildTarget(targets[posn], 0))
 		{
@@ -344,6 +795,12 @@ int CSAntBuild(const char *buildFilename)
 		}
 	}
 
+	/* Report how many compiles were satisfied by the object cache */
+	if(CSAntObjectCache)
+	{
+		ReportObjectCache();
+	}
+
 	/* Print a debug message indicating the project that we are done with */
 	if(!CSAntSilent)
 	{
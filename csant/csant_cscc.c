@@ -515,6 +515,13 @@ static char **BuildCsccCommandLine(CSAntCompileArgs *args)
 		AddValueArg(&argv, &argc, "-fplugin-c-path=", temp);
 	}
 
+	/* Share the object cache and record lookups for the hit ratio */
+	if(CSAntObjectCache)
+	{
+		AddValueArg(&argv, &argc, "-fcache-dir=", CSAntObjectCache);
+		AddValueArg(&argv, &argc, "-fcache-stats=", CSAntObjectCacheStats);
+	}
+
 	/* Set the output file */
 	AddArg(&argv, &argc, "-o");
 	AddArg(&argv, &argc, (char *)(args->output));
@@ -43,6 +43,9 @@ extern int   CSAntDummyDoc;
 extern int   CSAntForceCorLib;
 extern int   CSAntInstallMode;
 extern int   CSAntUninstallMode;
+extern int   CSAntJobs;
+extern char *CSAntObjectCache;
+extern char *CSAntObjectCacheStats;
 extern char *CSAntCompiler;
 extern char *CSAntBaseSrcDir;
 extern char *CSAntBaseBuildDir;
@@ -527,6 +527,11 @@ static int Task_CSAnt(CSAntTask *task)
 	{
 		argv[argc++] = "-u";
 	}
+	if(CSAntObjectCache)
+	{
+		argv[argc++] = "-o";
+		argv[argc++] = CSAntObjectCache;
+	}
 	argv[argc++] = "-C";
 	argv[argc++] = (char *)compiler;
 	if(target)
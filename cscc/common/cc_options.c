@@ -99,6 +99,7 @@ int dependency_level = DEP_LEVEL_NONE;
 int dependency_gen_flag = 0;
 char *dependency_file = 0;
 int preproc_show_headers = 0;
+int parallel_jobs = 1;
 
 /*
  * Add a string to a list of strings.
@@ -486,6 +487,18 @@ static void mfOption(char *arg)
 	dependency_file = arg;
 }
 
+/*
+ * Process a -j option.
+ */
+static void jOption(char *arg)
+{
+	parallel_jobs = atoi(arg);
+	if(parallel_jobs < 1)
+	{
+		parallel_jobs = 1;
+	}
+}
+
 /*
  * Process a -v option (this is only used if "-v" is the only option).
  * The "-dumpversion" option can also be used for this.
@@ -577,6 +590,8 @@ static CmdLineOpt const options[] = {
 	{"-MM",			0,	&dependency_level,		DEP_LEVEL_MM, 0, 0, 0},
 	{"-MMD",		0,	&dependency_level,		DEP_LEVEL_MMD, 0, 0, 0},
 	{"-MF",			3,	0,						0,	mfOption, 0, 0},
+	{"-j",			2,	0,						0,	jOption,
+			N_("-j <n>"), N_("Process up to <n> input files at a time")},
 	{"-g",			0,	&debug_flag,			1,	0,
 			"-g", N_("Enable debug symbol information in the output")},
 	{"-nostdinc",	0,	&nostdinc_flag,			1,	0,
@@ -126,6 +126,7 @@ extern int dependency_level;
 extern int dependency_gen_flag;
 extern char *dependency_file;
 extern int preproc_show_headers;
+extern int parallel_jobs;
 
 /*
  * Add a path to a list of strings.
@@ -26,6 +26,7 @@ Environment variables:
 	CSCC_INCLUDE_CPP_PATH	Where to look for included C++ system files.
 	CSCC_LIB_PATH			Where to look for link libraries.
 	CSCC_PLUGINS_PATH		Where to look for language plug-ins.
+	CSCC_CACHE_DIR			Where to cache compiled object files.
 
 */
 
@@ -35,6 +36,7 @@ Environment variables:
 #include "il_linker.h"
 #include "common/cc_options.h"
 #include "common/cc_intl.h"
+#include "cscc_cache.h"
 
 #ifdef	__cplusplus
 extern	"C" {
@@ -114,6 +116,8 @@ static int ProcessWithAssembler(const char *filename, int jvmMode);
 static int ProcessWithPlugin(const char *filename, char *plugin,
 							 int filenum, int isMultiple);
 static int LinkExecutable(void);
+static int ProcessFile(int filenum);
+static int ProcessFilesInParallel(void);
 
 int main(int argc, char *argv[])
 {
@@ -273,66 +277,23 @@ int main(int argc, char *argv[])
 	}
 
 	/* Process each of the input files in turn */
-	for(filenum = 0; filenum < num_input_files; ++filenum)
+	if(parallel_jobs > 1)
 	{
-		filename = input_files[filenum];
-		switch(file_proc_types[filenum])
+		newstatus = ProcessFilesInParallel();
+		if(newstatus && !status)
 		{
-			case FILEPROC_TYPE_BINARY:
-			{
-				/* Add the binary to the list of files to be linked */
-				CCAddLinkFile(filename, 0);
-			}
-			break;
-
-			case FILEPROC_TYPE_IL:
-			{
-				/* Assemble this input file using "ilasm" */
-				newstatus = ProcessWithAssembler(filename, 0);
-				if(newstatus && !status)
-				{
-					status = newstatus;
-				}
-			}
-			break;
-
-			case FILEPROC_TYPE_JL:
-			{
-				/* Assemble this input file using "ilasm" in JVM mode */
-				newstatus = ProcessWithAssembler(filename, 1);
-				if(newstatus && !status)
-				{
-					status = newstatus;
-				}
-			}
-			break;
-
-			case FILEPROC_TYPE_SINGLE:
-			{
-				/* Compile this input file using a language-specific plug-in */
-				newstatus = ProcessWithPlugin
-								(filename, plugin_list[filenum], filenum, 0);
-				if(newstatus && !status)
-				{
-					status = newstatus;
-				}
-			}
-			break;
-
-			case FILEPROC_TYPE_MULTIPLE:
+			status = newstatus;
+		}
+	}
+	else
+	{
+		for(filenum = 0; filenum < num_input_files; ++filenum)
+		{
+			newstatus = ProcessFile(filenum);
+			if(newstatus && !status)
 			{
-				/* Compile this input file and all other files for the
-				   same language using a language-specific plug-in */
-				newstatus = ProcessWithPlugin
-								(filename, plugin_list[filenum], filenum, 1);
-				if(newstatus && !status)
-				{
-					status = newstatus;
-				}
+				status = newstatus;
 			}
-			break;
-
-			default:	break;
 		}
 	}
 
@@ -963,6 +924,25 @@ static void DumpCmdLine(char **argv)
  */
 int ILAsmMain(int argc, char *argv[], FILE *newStdin);
 
+/*
+ * Get the name of the object file that is created for an input file.
+ */
+static char *ObjectFileName(const char *filename)
+{
+	if(executable_flag)
+	{
+		return ChangeExtension((char *)filename, "objtmp");
+	}
+	else if(compile_flag)
+	{
+		return output_filename;
+	}
+	else
+	{
+		return ChangeExtension((char *)filename, "obj");
+	}
+}
+
 /*
  * Process an input file using the assembler.
  */
@@ -977,19 +957,11 @@ static int ProcessWithAssembler(const char *filename, int jvmMode)
 	cmdline = 0;
 	cmdline_size = 0;
 	AddArgument(&cmdline, &cmdline_size, "ilasm");
+	obj_output = ObjectFileName(filename);
 	if(executable_flag)
 	{
-		obj_output = ChangeExtension((char *)filename, "objtmp");
 		CCAddLinkFile(obj_output, 1);
 	}
-	else if(compile_flag)
-	{
-		obj_output = output_filename;
-	}
-	else
-	{
-		obj_output = ChangeExtension((char *)filename, "obj");
-	}
 	AddArgument(&cmdline, &cmdline_size, "-o");
 	AddArgument(&cmdline, &cmdline_size, obj_output);
 	if(debug_flag)
@@ -1045,6 +1017,7 @@ static int ProcessWithPlugin(const char *filename, char *plugin,
 	int pipePid = 0;
 	int canPipe;
 	char **pluginCmdline = 0;
+	char *cacheEntry = 0;
 	static char * const depLevels[] = {0, "-M", "-MD", "-MM", "-MMD"};
 
 	/* Get the default dependency filename, if necessary */
@@ -1325,6 +1298,31 @@ static int ProcessWithPlugin(const char *filename, char *plugin,
 		canPipe = 0;
 	}
 
+	/* Look for the object file in the compilation cache.  Single-file
+	   plug-ins are for languages like C, whose included files are not
+	   part of the cache key, so they are never cached */
+	obj_output = 0;
+	if(isMultiple && !assemble_flag && !preprocess_flag && !saveAsm &&
+	   dependency_level == DEP_LEVEL_NONE &&
+	   !CCStringListContains(extension_flags, num_extension_flags,
+							 "syntax-check") &&
+	   !CCStringListContains(extension_flags, num_extension_flags,
+							 "semantic-check"))
+	{
+		obj_output = ObjectFileName(filename);
+		cacheEntry = CCCacheEntry(cmdline, outputIndex, obj_output);
+		if(cacheEntry && CCCacheFetch(cacheEntry, obj_output))
+		{
+			if(executable_flag)
+			{
+				CCAddLinkFile(obj_output, 1);
+			}
+			ILFree(cacheEntry);
+			ILFree(cmdline);
+			return 0;
+		}
+	}
+
 	/* Execute the plugin, using a pipe if possible */
 	if(canPipe)
 	{
@@ -1373,6 +1371,10 @@ static int ProcessWithPlugin(const char *filename, char *plugin,
 		{
 			ILDeleteFile(asm_output);
 		}
+		if(cacheEntry)
+		{
+			ILFree(cacheEntry);
+		}
 		return status;
 	}
 
@@ -1396,18 +1398,13 @@ static int ProcessWithPlugin(const char *filename, char *plugin,
 	cmdline = 0;
 	cmdline_size = 0;
 	AddArgument(&cmdline, &cmdline_size, "ilasm");
-	if(executable_flag)
-	{
-		obj_output = ChangeExtension((char *)filename, "objtmp");
-		CCAddLinkFile(obj_output, 1);
-	}
-	else if(compile_flag)
+	if(!obj_output)
 	{
-		obj_output = output_filename;
+		obj_output = ObjectFileName(filename);
 	}
-	else
+	if(executable_flag)
 	{
-		obj_output = ChangeExtension((char *)filename, "obj");
+		CCAddLinkFile(obj_output, 1);
 	}
 	AddArgument(&cmdline, &cmdline_size, "-o");
 	AddArgument(&cmdline, &cmdline_size, obj_output);
@@ -1461,6 +1458,10 @@ static int ProcessWithPlugin(const char *filename, char *plugin,
 			ILDeleteFile(asm_output);
 		}
 		ILDeleteFile(obj_output);
+		if(cacheEntry)
+		{
+			ILFree(cacheEntry);
+		}
 		return status;
 	}
 	if(!saveAsm && asm_output)
@@ -1468,10 +1469,175 @@ static int ProcessWithPlugin(const char *filename, char *plugin,
 		ILDeleteFile(asm_output);
 	}
 
+	/* Save the object file in the compilation cache */
+	if(cacheEntry)
+	{
+		CCCacheStore(cacheEntry, obj_output);
+		ILFree(cacheEntry);
+	}
+
 	/* Done */
 	return 0;
 }
 
+/*
+ * Process a single input file.  Returns the exit status.
+ */
+static int ProcessFile(int filenum)
+{
+	char *filename = input_files[filenum];
+	int status = 0;
+	switch(file_proc_types[filenum])
+	{
+		case FILEPROC_TYPE_BINARY:
+		{
+			/* Add the binary to the list of files to be linked */
+			CCAddLinkFile(filename, 0);
+		}
+		break;
+
+		case FILEPROC_TYPE_IL:
+		{
+			/* Assemble this input file using "ilasm" */
+			status = ProcessWithAssembler(filename, 0);
+		}
+		break;
+
+		case FILEPROC_TYPE_JL:
+		{
+			/* Assemble this input file using "ilasm" in JVM mode */
+			status = ProcessWithAssembler(filename, 1);
+		}
+		break;
+
+		case FILEPROC_TYPE_SINGLE:
+		{
+			/* Compile this input file using a language-specific plug-in */
+			status = ProcessWithPlugin
+						(filename, plugin_list[filenum], filenum, 0);
+		}
+		break;
+
+		case FILEPROC_TYPE_MULTIPLE:
+		{
+			/* Compile this input file and all other files for the
+			   same language using a language-specific plug-in */
+			status = ProcessWithPlugin
+						(filename, plugin_list[filenum], filenum, 1);
+		}
+		break;
+
+		default:	break;
+	}
+	return status;
+}
+
+/*
+ * Process an input file in a child process.
+ */
+static int ProcessFileJob(void *arg)
+{
+	return ProcessFile((int)(ILNativeInt)arg);
+}
+
+/*
+ * Maximum number of input files whose captured output is kept while it
+ * waits for the output of earlier files, unless more jobs than this are
+ * running.  Each file uses two temporary files for its output.
+ */
+#define	MAX_HELD_OUTPUTS	32
+
+/*
+ * Process the input files using up to "parallel_jobs" child processes.
+ * The plug-in and assembler stages for each file are independent of
+ * each other, so only the list of files to be linked needs to be built
+ * by the parent, in the same order as a serial build.  The output of
+ * each child is printed in input file order.  Returns the exit status.
+ *
+ * Only files that are processed one at a time can run in parallel.
+ * A plug-in that compiles all of its files at once, such as the C#
+ * plug-in, runs in a single child for all of those files.
+ */
+static int ProcessFilesInParallel(void)
+{
+	ILSpawnJobs *jobs;
+	int filenum, posn;
+	int status = 0;
+	int pid, newstatus;
+
+	jobs = ILSpawnJobsCreate(num_input_files, parallel_jobs,
+							 MAX_HELD_OUTPUTS, stdout, stderr);
+	if(!jobs)
+	{
+		CCOutOfMemory();
+	}
+
+	for(filenum = 0; filenum < num_input_files; ++filenum)
+	{
+		/* Determine how to process the file */
+		switch(file_proc_types[filenum])
+		{
+			case FILEPROC_TYPE_IL:
+			case FILEPROC_TYPE_JL:
+			case FILEPROC_TYPE_SINGLE:
+			case FILEPROC_TYPE_MULTIPLE:
+			{
+				/* Process the file in a child process */
+				pid = ILSpawnJobsStart(jobs, ProcessFileJob,
+									   (void *)(ILNativeInt)filenum);
+				if(pid == 0)
+				{
+					/* Child processes are not supported on this system */
+					newstatus = ProcessFile(filenum);
+					if(newstatus && !status)
+					{
+						status = newstatus;
+					}
+					ILSpawnJobsSkip(jobs);
+					break;
+				}
+
+				/* Record the object file that the child will create */
+				if(executable_flag)
+				{
+					CCAddLinkFile(ObjectFileName(input_files[filenum]), 1);
+				}
+
+				/* The child processes all other files for the same
+				   plug-in, so don't start another child for them */
+				if(file_proc_types[filenum] == FILEPROC_TYPE_MULTIPLE)
+				{
+					for(posn = filenum + 1; posn < num_input_files; ++posn)
+					{
+						if(file_proc_types[posn] == FILEPROC_TYPE_MULTIPLE &&
+						   !strcmp(plugin_list[filenum], plugin_list[posn]))
+						{
+							file_proc_types[posn] = FILEPROC_TYPE_DONE;
+						}
+					}
+				}
+			}
+			break;
+
+			default:
+			{
+				/* Binaries are added to the link list in order */
+				ProcessFile(filenum);
+				ILSpawnJobsSkip(jobs);
+			}
+			break;
+		}
+	}
+
+	/* Wait for the remaining children and print their output */
+	newstatus = ILSpawnJobsFinish(jobs);
+	if(newstatus && !status)
+	{
+		status = newstatus;
+	}
+	return status;
+}
+
 /*
  * Link the final executable.
  */
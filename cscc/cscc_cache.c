@@ -0,0 +1,382 @@
+/*
+ * cscc_cache.c - Cache of compiled object files for "cscc".
+ *
+ * Copyright (C) 2010  Southern Storm Software, Pty Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+
+The cache is a directory of object files, named after the SHA1 hash
+of everything that can affect the object file that the plug-in and
+assembler stages produce for a set of input files:
+
+	- the version of cscc, and the modification time of the plug-in;
+	- the plug-in command-line, which includes the defines and the
+	  compiler options;
+	- the contents of the input files;
+	- the name of the object file, which becomes its module name;
+	- the MVID's of the standard library and the "-l" libraries.
+
+The cache is enabled with "-fcache-dir=DIR" or the "CSCC_CACHE_DIR"
+environment variable.  If "-fcache-stats=FILE" is supplied, then a
+line is appended to FILE for every lookup, containing "1 0" for a hit
+or "0 1" for a miss.  "csant" uses this to report the hit ratio.
+
+Entries are written to a temporary file and then renamed, so that
+several compilers can share the same cache directory.
+
+*/
+
+#include <stdio.h>
+#include "il_system.h"
+#include "il_utils.h"
+#include "il_sysio.h"
+#include "il_crypt.h"
+#include "il_image.h"
+#include "il_program.h"
+#include "common/cc_options.h"
+#include "cscc_cache.h"
+#ifdef HAVE_UNISTD_H
+	#include <unistd.h>
+#endif
+
+#ifdef	__cplusplus
+extern	"C" {
+#endif
+
+/*
+ * Format of the cache entries.  Change this if the contents
+ * of the key change, so that old entries are not used.
+ */
+#define	CACHE_FORMAT	"cscc-cache-1"
+
+/*
+ * Hash of the referenced assemblies, computed once per process.
+ */
+static unsigned char referencesHash[IL_SHA_HASH_SIZE];
+static int referencesHashed = 0;
+
+/*
+ * Get the cache directory, or NULL if the cache is disabled.
+ */
+static char *CacheDir(void)
+{
+	char *dir = CCStringListGetValue(extension_flags, num_extension_flags,
+									 "cache-dir");
+	if(!dir || *dir == '\0')
+	{
+		dir = getenv("CSCC_CACHE_DIR");
+		if(dir && *dir == '\0')
+		{
+			dir = 0;
+		}
+	}
+	return dir;
+}
+
+/*
+ * Record a cache hit or miss in the statistics file.
+ */
+static void RecordLookup(int hit)
+{
+	char *filename = CCStringListGetValue(extension_flags, num_extension_flags,
+										  "cache-stats");
+	FILE *file;
+	if(filename && (file = fopen(filename, "a")) != NULL)
+	{
+		fputs((hit ? "1 0\n" : "0 1\n"), file);
+		fclose(file);
+	}
+}
+
+/*
+ * Add a string to a hash, including its terminating NUL.
+ */
+static void HashString(ILSHAContext *sha, const char *str)
+{
+	ILSHAData(sha, str, strlen(str) + 1);
+}
+
+/*
+ * Add the contents of a file to a hash.  Returns zero on error.
+ */
+static int HashFile(ILSHAContext *sha, const char *filename)
+{
+	FILE *file;
+	char buffer[BUFSIZ];
+	int len;
+	if((file = fopen(filename, "rb")) == NULL)
+	{
+		if((file = fopen(filename, "r")) == NULL)
+		{
+			return 0;
+		}
+	}
+	while((len = (int)fread(buffer, 1, sizeof(buffer), file)) > 0)
+	{
+		ILSHAData(sha, buffer, (unsigned long)len);
+	}
+	fclose(file);
+	return 1;
+}
+
+/*
+ * Search the library directories for a library, in the same
+ * way as the linker.  Returns NULL if not found.
+ */
+static char *ResolveLibrary(const char *name)
+{
+	int len;
+	char *newName;
+	char *expanded;
+
+	/* Does the filename contain a path specification? */
+	len = strlen(name);
+	while(len > 0 && name[len - 1] != '/' && name[len - 1] != '\\')
+	{
+		--len;
+	}
+	if(len > 0)
+	{
+		return (ILFileExists(name, (char **)0) ? ILDupString(name) : 0);
+	}
+
+	/* Search the library directories for the name */
+	newName = ILImageSearchPath
+		(name, 0, 0,
+		 (const char **)link_dirs, num_link_dirs,
+		 (const char **)sys_link_dirs, (nostdlib_flag ? 0 : num_sys_link_dirs),
+		 0, 0);
+	if(newName || !strncmp(name, "lib", 3))
+	{
+		return newName;
+	}
+
+	/* Try again with "lib" prepended to the name */
+	expanded = (char *)ILMalloc(strlen(name) + 4);
+	if(!expanded)
+	{
+		CCOutOfMemory();
+	}
+	strcpy(expanded, "lib");
+	strcpy(expanded + 3, name);
+	newName = ILImageSearchPath
+		(expanded, 0, 0,
+		 (const char **)link_dirs, num_link_dirs,
+		 (const char **)sys_link_dirs, (nostdlib_flag ? 0 : num_sys_link_dirs),
+		 0, 0);
+	ILFree(expanded);
+	return newName;
+}
+
+/*
+ * Add the identity of a referenced library to a hash.  The MVID
+ * changes every time that the library is rebuilt.
+ */
+static void HashLibrary(ILSHAContext *sha, ILContext *context,
+						const char *name)
+{
+	char *path = ResolveLibrary(name);
+	ILImage *image;
+	ILModule *module;
+	const unsigned char *mvid = 0;
+
+	HashString(sha, name);
+	if(!path)
+	{
+		return;
+	}
+	HashString(sha, path);
+	if(ILImageLoadFromFile(path, context, &image,
+						   IL_LOADFLAG_FORCE_32BIT | IL_LOADFLAG_NO_RESOLVE,
+						   0) == 0)
+	{
+		module = ILModule_FromToken(image, IL_META_TOKEN_MODULE | 1);
+		if(module)
+		{
+			mvid = ILModule_MVID(module);
+		}
+		if(mvid)
+		{
+			ILSHAData(sha, mvid, 16);
+		}
+		ILImageDestroy(image);
+	}
+	if(!mvid)
+	{
+		/* Not an IL image, so the file contents must do */
+		HashFile(sha, path);
+	}
+	ILFree(path);
+}
+
+/*
+ * Compute the hash of the referenced assemblies.
+ */
+static void HashReferences(void)
+{
+	ILSHAContext sha;
+	ILContext *context;
+	char *name;
+	int posn;
+
+	ILSHAInit(&sha);
+	if((context = ILContextCreate()) == 0)
+	{
+		CCOutOfMemory();
+	}
+	if(!nostdlib_flag)
+	{
+		name = CCStringListGetValue(extension_flags, num_extension_flags,
+									"stdlib-name");
+		HashLibrary(&sha, context, (name ? name : "mscorlib"));
+	}
+	for(posn = 0; posn < num_libraries; ++posn)
+	{
+		HashLibrary(&sha, context, libraries[posn]);
+	}
+	ILContextDestroy(context);
+	ILSHAFinalize(&sha, referencesHash);
+	referencesHashed = 1;
+}
+
+char *CCCacheEntry(char **argv, int outputIndex, const char *objOutput)
+{
+	char *dir = CacheDir();
+	ILSHAContext sha;
+	unsigned char hash[IL_SHA_HASH_SIZE];
+	ILInt64 modified;
+	int posn, len;
+	int inputs = 0;
+	char *entry;
+	static char const hexchars[] = "0123456789abcdef";
+
+	/* Bail out if the cache is disabled */
+	if(!dir)
+	{
+		return 0;
+	}
+
+	/* Hash the compiler version and the plug-in */
+	ILSHAInit(&sha);
+	HashString(&sha, CACHE_FORMAT);
+	HashString(&sha, VERSION);
+	if(ILSysIOPathGetLastModification(argv[0], &modified) == 0)
+	{
+		ILSHAData(&sha, &modified, sizeof(modified));
+	}
+
+	/* Hash the command-line and the contents of the input files */
+	for(posn = 0; argv[posn] != 0; ++posn)
+	{
+		if(posn == outputIndex)
+		{
+			continue;
+		}
+		if(inputs)
+		{
+			if(!strcmp(argv[posn], "-") || !HashFile(&sha, argv[posn]))
+			{
+				/* We cannot cache stdin or unreadable inputs */
+				return 0;
+			}
+		}
+		else if(!strcmp(argv[posn], "--"))
+		{
+			inputs = 1;
+		}
+		else if(!strncmp(argv[posn], "cache-", 6))
+		{
+			/* The cache options don't affect the object file */
+			continue;
+		}
+		HashString(&sha, argv[posn]);
+	}
+
+	/* Hash the name of the object file, without its directory */
+	len = strlen(objOutput);
+	while(len > 0 && objOutput[len - 1] != '/' && objOutput[len - 1] != '\\')
+	{
+		--len;
+	}
+	HashString(&sha, objOutput + len);
+
+	/* Hash the referenced assemblies */
+	if(!referencesHashed)
+	{
+		HashReferences();
+	}
+	ILSHAData(&sha, referencesHash, IL_SHA_HASH_SIZE);
+	ILSHAFinalize(&sha, hash);
+
+	/* Build the pathname of the entry */
+	len = strlen(dir);
+	entry = (char *)ILMalloc(len + IL_SHA_HASH_SIZE * 2 + 6);
+	if(!entry)
+	{
+		CCOutOfMemory();
+	}
+	strcpy(entry, dir);
+	entry[len++] = '/';
+	for(posn = 0; posn < IL_SHA_HASH_SIZE; ++posn)
+	{
+		entry[len++] = hexchars[(hash[posn] >> 4) & 0x0F];
+		entry[len++] = hexchars[hash[posn] & 0x0F];
+	}
+	strcpy(entry + len, ".obj");
+	return entry;
+}
+
+int CCCacheFetch(const char *entry, const char *objOutput)
+{
+	int hit = (ILFileExists(entry, (char **)0) &&
+			   ILCopyFile(entry, objOutput) == 0);
+	RecordLookup(hit);
+	return hit;
+}
+
+void CCCacheStore(const char *entry, const char *objOutput)
+{
+	char *temp;
+	int len = strlen(entry);
+
+	/* Make sure that the cache directory exists */
+	ILCreateDir(CacheDir());
+
+	/* Copy the object file to a temporary name and then rename it,
+	   so that other compilers never see a partial entry */
+	temp = (char *)ILMalloc(len + 32);
+	if(!temp)
+	{
+		CCOutOfMemory();
+	}
+#ifdef HAVE_GETPID
+	sprintf(temp, "%s.%ld", entry, (long)getpid());
+#else
+	sprintf(temp, "%s.tmp", entry);
+#endif
+	if(ILCopyFile(objOutput, temp) != 0 ||
+	   ILRenameDir(temp, entry) != 0)
+	{
+		ILDeleteFile(temp);
+	}
+	ILFree(temp);
+}
+
+#ifdef	__cplusplus
+};
+#endif
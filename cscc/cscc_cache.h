@@ -0,0 +1,52 @@
+/*
+ * cscc_cache.h - Cache of compiled object files for "cscc".
+ *
+ * Copyright (C) 2010  Southern Storm Software, Pty Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef	_CSCC_CACHE_H
+#define	_CSCC_CACHE_H
+
+#ifdef	__cplusplus
+extern	"C" {
+#endif
+
+/*
+ * Get the pathname of the cache entry for the object file that results
+ * from running a plug-in command-line and then assembling its output
+ * into "objOutput".  The argument at "outputIndex" names the plug-in's
+ * temporary output file, and is ignored.  Returns NULL if the cache is
+ * disabled or the inputs cannot be cached, or an ILMalloc'ed string.
+ */
+char *CCCacheEntry(char **argv, int outputIndex, const char *objOutput);
+
+/*
+ * Copy the object file for a cache entry to "objOutput".
+ * Returns zero if the entry is not present in the cache.
+ */
+int CCCacheFetch(const char *entry, const char *objOutput);
+
+/*
+ * Store "objOutput" in the cache under the name "entry".
+ */
+void CCCacheStore(const char *entry, const char *objOutput);
+
+#ifdef	__cplusplus
+};
+#endif
+
+#endif	/* _CSCC_CACHE_H */
@@ -316,28 +316,13 @@ const char *ILDocFlagValueN(const char *flag, int n)
 	return 0;
 }
 
-/*
- * XML reader function.
- */
-static int xmlRead(void *data, void *buffer, int len)
-{
-	if(!feof((FILE *)data))
-	{
-		return fread(buffer, 1, len, (FILE *)data);
-	}
-	else
-	{
-		return 0;
-	}
-}
-
 /*
  * Load the contents of an XML input file.
  */
 static void loadXML(ILDocTree *tree, const char *filename,
 				    FILE *stream, int closeStream, const char *progname)
 {
-	ILXMLReader *reader = ILXMLCreate(xmlRead, stream, 0);
+	ILXMLReader *reader = ILXMLCreateFromStream(stream, 0);
 	if(!reader)
 	{
 		if(closeStream)
@@ -58,6 +58,7 @@ this automatically, but the explicit casts are recommended.
 
 #include "engine_private.h"
 #include "lib_defs.h"
+#include "interlocked.h"
 #include <il_varargs.h>
 
 #ifdef	__cplusplus
@@ -1277,6 +1278,37 @@ ILMethod *_ILLookupInterfaceMethod(ILClassPrivate *objectClassPrivate,
 	return 0;
 }
 
+void _ILCallSiteCacheAdd(ILExecProcess *process, ILCallSiteCache *site,
+						 ILClassPrivate *classPrivate, void *target)
+{
+	ILCallSiteEntry *entry;
+	ILInt32 slot;
+
+	/* Bail out if the site is already known to be megamorphic */
+	if(ILInterlockedLoadI4(&(site->used)) > IL_CALL_SITE_CACHE_SIZE)
+	{
+		return;
+	}
+
+	/* Claim a slot.  Only the thread that claims the first slot past
+	   the end of the cache counts the site as megamorphic */
+	slot = ILInterlockedIncrementI4(&(site->used)) - 1;
+	if(slot >= IL_CALL_SITE_CACHE_SIZE)
+	{
+		if(slot == IL_CALL_SITE_CACHE_SIZE)
+		{
+			ILInterlockedIncrementI4(&(process->icMegamorphic));
+		}
+		return;
+	}
+
+	/* Fill in the slot and then publish it to readers */
+	entry = &(site->slots[slot]);
+	entry->classPrivate = classPrivate;
+	entry->target = target;
+	ILInterlockedStoreP_Release((void **)&(site->entries[slot]), entry);
+}
+
 /*
  * Throw a missing method exception.
  */
@@ -609,6 +609,16 @@ extern	"C" {
 #define COP_PREFIX_PROFILE_START		0x92
 #define COP_PREFIX_PROFILE_END			0x93
 
+/*
+ * Superinstructions for common sequences of "int32" local
+ * variable operations.  See "cvmc_super.c" for details.
+ */
+#define COP_PREFIX_ILOAD2				0x94
+#define COP_PREFIX_ILOAD_LDC			0x95
+#define COP_PREFIX_IADD_LL				0x96
+#define COP_PREFIX_IADD_LC				0x97
+#define COP_PREFIX_IINC					0x98
+
 
 /*
  * Definition of a CVM stack word which can hold
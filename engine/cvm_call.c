@@ -115,6 +115,10 @@ ILCallFrame *_ILAllocCallFrame(ILExecThread *thread)
 				_ILExecThreadSuspendThread(thread, thread->supportThread); \
 			} \
 		} \
+		else if (thread->managedSafePointFlags & _IL_MANAGED_SAFEPOINT_SAMPLE) \
+		{ \
+			_ILSamplerRecord(thread, method); \
+		} \
 	}
 
 #define BEGIN_NATIVE_CALL()	\
@@ -203,6 +207,36 @@ ILCallFrame *_ILAllocCallFrame(ILExecThread *thread)
 			} while (0)
 #endif
 
+/*
+ * Find the method to call at an interface call site after a miss in the
+ * call site's inline cache.  The IMT and then the interface tables of the
+ * object's class are searched, and the method is added to the cache.
+ * Returns NULL if the class does not implement the interface method.
+ */
+static ILMethod *LookupInterfaceMiss(ILExecThread *thread,
+									 ILClassPrivate *classPrivate,
+									 ILCallSiteCache *site,
+									 ILUInt32 imtIndex)
+{
+	ILMethod *method;
+
+#ifdef IL_USE_IMTS
+	method = classPrivate->imt[imtIndex];
+	if(!method)
+#endif
+	{
+		method = _ILLookupInterfaceMethod(classPrivate,
+										  site->method->member.owner,
+										  site->method->index);
+	}
+	if(method)
+	{
+		_ILCallSiteCacheAdd(_ILExecThreadProcess(thread), site,
+							classPrivate, method);
+	}
+	return method;
+}
+
 /*
  * Determine the number of stack words that are occupied
  * by a specific type.
@@ -1004,7 +1038,9 @@ VMBREAK(COP_CALL_VIRTUAL);
  *   1 indicates the top of stack, 2 indicates the stack word
  *   just below the top-most stack word, etc.  The value <i>M</i>
  *   is the offset into the interface's vtable for the method.  The value
- *   <i>cptr</i> indicates the interface class pointer.</description>
+ *   <i>cptr</i> points to the inline cache for the call site, which
+ *   records the interface method and the classes recently seen at the
+ *   site.</description>
  *
  *   <notes>See the description of the <i>call</i> instruction for
  *   a full account of frame handling, argument handling, etc.<p/>
@@ -1026,41 +1062,30 @@ VMCASE(COP_CALL_INTERFACE):
 	tempptr = stacktop[-((ILInt32)CVM_ARG_DWIDE1_SMALL)].ptrValue;
 	BEGIN_NULL_CHECK(tempptr)
 	{
-		/* Locate the method to be called */
-	#ifdef IL_USE_IMTS
-		methodToCall = GetObjectClassPrivate(tempptr)
-			->imt[CVM_ARG_DWIDE2_SMALL];
+		/* Locate the method to be called, trying the call site's
+		   inline cache before searching the object's class */
+		methodToCall = (ILMethod *)_ILCallSiteCacheFind
+			(thread, CVM_ARG_DWIDE_PTR_SMALL(ILCallSiteCache *),
+			 GetObjectClassPrivate(tempptr));
 		if(!methodToCall)
 		{
-			methodToCall = CVM_ARG_DWIDE_PTR_SMALL(ILMethod *);
-			methodToCall = _ILLookupInterfaceMethod
-				(GetObjectClassPrivate(tempptr),
-				 methodToCall->member.owner, methodToCall->index);
+			methodToCall = LookupInterfaceMiss
+				(thread, GetObjectClassPrivate(tempptr),
+				 CVM_ARG_DWIDE_PTR_SMALL(ILCallSiteCache *),
+				 CVM_ARG_DWIDE2_SMALL);
 			if(!methodToCall)
 			{
 				MISSING_METHOD_EXCEPTION();
 			}
 		}
-		#if IL_DEBUG_IMTS
-		if(methodToCall)
-		{
-			fprintf(stderr, "%s:%d found <%s:%s> for <%s:%s> \n", 
-				__FILE__, __LINE__,
-				ILClass_Name(methodToCall->member.owner),
-				ILMethod_Name(methodToCall),
-				ILClass_Name(
-					ILMethod_Owner(CVM_ARG_DWIDE_PTR_SMALL(ILMethod *))),
-				ILMethod_Name(CVM_ARG_DWIDE_PTR_SMALL(ILMethod*)));
-		}
-		#endif
-	#else
-		methodToCall = _ILLookupInterfaceMethod
-			(GetObjectClassPrivate(tempptr), CVM_ARG_DWIDE_PTR_SMALL(ILClass *),
-			 CVM_ARG_DWIDE2_SMALL);
-		if(!methodToCall)
-		{
-			MISSING_METHOD_EXCEPTION();
-		}
+	#if IL_DEBUG_IMTS
+		fprintf(stderr, "%s:%d found <%s:%s> for <%s:%s> \n", 
+			__FILE__, __LINE__,
+			ILClass_Name(methodToCall->member.owner),
+			ILMethod_Name(methodToCall),
+			ILClass_Name(ILMethod_Owner
+				(CVM_ARG_DWIDE_PTR_SMALL(ILCallSiteCache *)->method)),
+			ILMethod_Name(CVM_ARG_DWIDE_PTR_SMALL(ILCallSiteCache *)->method));
 	#endif
 
 		/* Has the method already been converted? */
@@ -1556,30 +1581,22 @@ case COP_CALL_INTERFACE:
 	tempptr = stacktop[-((ILInt32)CVM_ARG_DWIDE1_LARGE)].ptrValue;
 	BEGIN_NULL_CHECK(tempptr)
 	{
-		/* Locate the method to be called */
-	#ifdef IL_USE_IMTS
-		methodToCall = GetObjectClassPrivate(tempptr)
-			->imt[CVM_ARG_DWIDE2_LARGE];
+		/* Locate the method to be called, trying the call site's
+		   inline cache before searching the object's class */
+		methodToCall = (ILMethod *)_ILCallSiteCacheFind
+			(thread, CVM_ARG_DWIDE_PTR_LARGE(ILCallSiteCache *),
+			 GetObjectClassPrivate(tempptr));
 		if(!methodToCall)
 		{
-			methodToCall = CVM_ARG_DWIDE_PTR_LARGE(ILMethod *);
-			methodToCall = _ILLookupInterfaceMethod
-				(GetObjectClassPrivate(tempptr),
-				 methodToCall->member.owner, methodToCall->index);
+			methodToCall = LookupInterfaceMiss
+				(thread, GetObjectClassPrivate(tempptr),
+				 CVM_ARG_DWIDE_PTR_LARGE(ILCallSiteCache *),
+				 CVM_ARG_DWIDE2_LARGE);
 			if(!methodToCall)
 			{
 				MISSING_METHOD_EXCEPTION();
 			}
 		}
-	#else
-		methodToCall = _ILLookupInterfaceMethod
-			(GetObjectClassPrivate(tempptr), CVM_ARG_DWIDE_PTR_LARGE(ILClass *),
-			 CVM_ARG_DWIDE2_LARGE);
-		if(!methodToCall)
-		{
-			MISSING_METHOD_EXCEPTION();
-		}
-	#endif
 
 		/* Copy the state back into the thread object */
 		COPY_STATE_TO_THREAD();
@@ -1772,29 +1789,21 @@ VMCASE(COP_PREFIX_TAIL_CALLINTF):
 	tempptr = stacktop[-((ILInt32)CVMP_ARG_WORD)].ptrValue;
 	BEGIN_NULL_CHECK(tempptr)
 	{
-		/* Locate the method to be called */
-	#ifdef IL_USE_IMTS
-		methodToCall = GetObjectClassPrivate(tempptr)->imt[CVMP_ARG_WORD2];
+		/* Locate the method to be called, trying the call site's
+		   inline cache before searching the object's class */
+		methodToCall = (ILMethod *)_ILCallSiteCacheFind
+			(thread, CVMP_ARG_WORD2_PTR(ILCallSiteCache *),
+			 GetObjectClassPrivate(tempptr));
 		if(!methodToCall)
 		{
-			methodToCall = CVMP_ARG_WORD2_PTR(ILMethod *);
-			methodToCall = _ILLookupInterfaceMethod
-				(GetObjectClassPrivate(tempptr),
-				 methodToCall->member.owner, methodToCall->index);
+			methodToCall = LookupInterfaceMiss
+				(thread, GetObjectClassPrivate(tempptr),
+				 CVMP_ARG_WORD2_PTR(ILCallSiteCache *), CVMP_ARG_WORD2);
 			if(!methodToCall)
 			{
 				MISSING_METHOD_EXCEPTION();
 			}
 		}
-	#else
-		methodToCall = _ILLookupInterfaceMethod
-			(GetObjectClassPrivate(tempptr), CVMP_ARG_WORD2_PTR(ILClass *),
-			 CVMP_ARG_WORD2);
-		if(!methodToCall)
-		{
-			MISSING_METHOD_EXCEPTION();
-		}
-	#endif
 		goto performTailCall;
 	}
 	END_NULL_CHECK();
@@ -52,6 +52,8 @@ extern	"C" {
 /*#define	IL_PROFILE_CVM_VAR_USAGE*/
 #ifdef IL_PROFILE_CVM_INSNS
 extern int _ILCVMInsnCount[];
+extern int _ILCVMInsnPairCount[];
+extern int _ILCVMLastInsn;
 #endif
 
 /*
@@ -63,12 +65,25 @@ extern int _ILCVMInsnCount[];
 	#define CVM_WIDE_DUMP()
 	#define CVM_PREFIX_DUMP()
 #elif defined(IL_PROFILE_CVM_INSNS)
+	/* Count each instruction, and each pair of consecutive instructions
+	   so that "ilrun -I" can report candidates for superinstructions.
+	   The "wide" and "prefix" opcodes are not part of the pairs */
+	#define	_CVM_COUNT_INSN(insn)	\
+		do { \
+			int __insn = (insn); \
+			++(_ILCVMInsnCount[__insn]); \
+			if(__insn != COP_WIDE && __insn != COP_PREFIX) \
+			{ \
+				++(_ILCVMInsnPairCount[_ILCVMLastInsn * 512 + __insn]); \
+				_ILCVMLastInsn = __insn; \
+			} \
+		} while (0)
 	#define	CVM_DUMP()	\
-		(++(_ILCVMInsnCount[pc[0]]))
+		_CVM_COUNT_INSN(pc[0])
 	#define CVM_WIDE_DUMP()	\
-		(++(_ILCVMInsnCount[pc[1]]))
+		_CVM_COUNT_INSN(pc[1])
 	#define CVM_PREFIX_DUMP()	\
-		(++(_ILCVMInsnCount[((int)(pc[1])) + 256]))
+		_CVM_COUNT_INSN(((int)(pc[1])) + 256)
 #else
 	#define	CVM_DUMP()
 	#define CVM_WIDE_DUMP()
@@ -22,6 +22,7 @@
 
 #include "il_dumpasm.h"
 #include "engine_private.h"
+#include "cvm_config.h"
 
 #ifdef	__cplusplus
 extern	"C" {
@@ -62,6 +63,7 @@ extern	"C" {
 #define	CVM_OPER_TAIL_INTERFACE		29
 #define	CVM_OPER_TYPE				30
 #define	CVM_OPER_PTR				31
+#define	CVM_OPER_UINT_AND_INT32		32
 
 /*
  * Table of CVM opcodes.  This must be kept in sync with "cvm.h".
@@ -668,14 +670,18 @@ static CVMOpcode const prefixOpcodes[0xA0] = {
 	{"profile_start",	CVM_OPER_NONE},
 	{"profile_end",		CVM_OPER_NONE},
 
+	/*
+	 * Superinstructions.
+	 */
+	{"iload2",			CVM_OPER_TWO_UINT32},
+	{"iload_ldc",		CVM_OPER_UINT_AND_INT32},
+	{"iadd_ll",			CVM_OPER_TWO_UINT32},
+	{"iadd_lc",			CVM_OPER_UINT_AND_INT32},
+	{"iinc",			CVM_OPER_UINT_AND_INT32},
+
 	/*
 	 * Reserved opcodes.
 	 */
-	{"preserved_94",	CVM_OPER_NONE},
-	{"preserved_95",	CVM_OPER_NONE},
-	{"preserved_96",	CVM_OPER_NONE},
-	{"preserved_97",	CVM_OPER_NONE},
-	{"preserved_98",	CVM_OPER_NONE},
 	{"preserved_99",	CVM_OPER_NONE},
 	{"preserved_9A",	CVM_OPER_NONE},
 	{"preserved_9B",	CVM_OPER_NONE},
@@ -882,17 +888,10 @@ int _ILDumpCVMInsn(FILE *stream, ILMethod *currMethod, unsigned char *pc)
 
 		case CVM_OPER_CALL_INTERFACE:
 		{
-		#ifdef IL_USE_IMTS
-			method = (ILMethod *)CVMReadPointer(pc + 3);
+			method = ((ILCallSiteCache *)CVMReadPointer(pc + 3))->method;
 			ILDumpClassName(stream, ILProgramItem_Image(currMethod),
 							ILMethod_Owner(method), 0);
-			fprintf(stream, ", %d, %d", (int)(pc[1]), method->index);
-		#else
-			classInfo = (ILClass *)CVMReadPointer(pc + 3);
-			ILDumpClassName(stream, ILProgramItem_Image(currMethod),
-							classInfo, 0);
 			fprintf(stream, ", %d, %d", (int)(pc[1]), (int)(pc[2]));
-		#endif
 			size = 3 + sizeof(void *);
 		}
 		break;
@@ -990,21 +989,12 @@ int _ILDumpCVMInsn(FILE *stream, ILMethod *currMethod, unsigned char *pc)
 
 				case CVM_OPER_CALL_INTERFACE:
 				{
-				#ifdef IL_USE_IMTS
-					method = (ILMethod *)CVMReadPointer(pc + 10);
+					method = ((ILCallSiteCache *)CVMReadPointer(pc + 10))->method;
 					ILDumpClassName(stream, ILProgramItem_Image(currMethod),
 									ILMethod_Owner(method), 0);
-					fprintf(stream, ", %lu, %lu",
-							(unsigned long)IL_READ_UINT32(pc + 2),
-							(unsigned long)(method->index));
-				#else
-					classInfo = (ILClass *)CVMReadPointer(pc + 10);
-					ILDumpClassName(stream, ILProgramItem_Image(currMethod),
-									classInfo, 0);
 					fprintf(stream, ", %lu, %lu",
 							(unsigned long)IL_READ_UINT32(pc + 2),
 							(unsigned long)IL_READ_UINT32(pc + 6));
-				#endif
 					size = 10 + sizeof(void *);
 				}
 				break;
@@ -1116,27 +1106,27 @@ int _ILDumpCVMInsn(FILE *stream, ILMethod *currMethod, unsigned char *pc)
 					fprintf(stream, "%lu, %lu",
 							(unsigned long)(IL_READ_UINT32(pc + 2)),
 							(unsigned long)(IL_READ_UINT32(pc + 6)));
-					pc += 10;
+					size = 10;
 				}
 				break;
 
-				case CVM_OPER_TAIL_INTERFACE:
+				case CVM_OPER_UINT_AND_INT32:
 				{
-				#ifdef IL_USE_IMTS
-					method = (ILMethod *)CVMReadPointer(pc + 10);
-					fprintf(stream, "%lu, %lu, ",
+					fprintf(stream, "%lu, %ld",
 							(unsigned long)(IL_READ_UINT32(pc + 2)),
-							(unsigned long)(method->index));
-					ILDumpClassName(stream, ILProgramItem_Image(currMethod),
-									ILMethod_Owner(method), 0);
-				#else
-					classInfo = (ILClass *)CVMReadPointer(pc + 10);
+							(long)(IL_READ_INT32(pc + 6)));
+					size = 10;
+				}
+				break;
+
+				case CVM_OPER_TAIL_INTERFACE:
+				{
+					method = ((ILCallSiteCache *)CVMReadPointer(pc + 10))->method;
 					fprintf(stream, "%lu, %lu, ",
 							(unsigned long)(IL_READ_UINT32(pc + 2)),
 							(unsigned long)(IL_READ_UINT32(pc + 6)));
 					ILDumpClassName(stream, ILProgramItem_Image(currMethod),
-									classInfo, 0);
-				#endif
+									ILMethod_Owner(method), 0);
 					size = 10 + sizeof(void *);
 				}
 				break;
@@ -1176,6 +1166,88 @@ int _ILDumpCVMInsn(FILE *stream, ILMethod *currMethod, unsigned char *pc)
  */
 int _ILCVMInsnCount[512];
 
+#ifdef IL_PROFILE_CVM_INSNS
+
+/*
+ * Instruction pair profiling array, indexed by "first * 512 + second",
+ * and the last instruction that was counted.
+ */
+int _ILCVMInsnPairCount[512 * 512];
+int _ILCVMLastInsn;
+
+/*
+ * Number of instruction pairs to report.
+ */
+#define	CVM_NUM_PAIRS		50
+
+/*
+ * Get the name of an instruction in the profiling arrays.
+ */
+static const char *ProfileInsnName(int insn)
+{
+	if(insn < 256)
+	{
+		return opcodes[insn].name;
+	}
+	else
+	{
+		return prefixOpcodes[insn - 256].name;
+	}
+}
+
+/*
+ * Dump the most frequent pairs of consecutive instructions.
+ * These are the candidates for new superinstructions.
+ */
+static void DumpInsnPairs(FILE *stream)
+{
+	int top[CVM_NUM_PAIRS];
+	int numTop = 0;
+	int pair, posn;
+
+	/* Keep the most frequent pairs in decreasing order of count */
+	for(pair = 0; pair < 512 * 512; ++pair)
+	{
+		if(!(_ILCVMInsnPairCount[pair]))
+		{
+			continue;
+		}
+		posn = numTop;
+		while(posn > 0 && _ILCVMInsnPairCount[top[posn - 1]] <
+								_ILCVMInsnPairCount[pair])
+		{
+			if(posn < CVM_NUM_PAIRS)
+			{
+				top[posn] = top[posn - 1];
+			}
+			--posn;
+		}
+		if(posn < CVM_NUM_PAIRS)
+		{
+			top[posn] = pair;
+			if(numTop < CVM_NUM_PAIRS)
+			{
+				++numTop;
+			}
+		}
+	}
+
+	/* Dump the pairs */
+	if(numTop > 0)
+	{
+		fprintf(stream, "\nInstruction pairs:\n\n");
+		for(posn = 0; posn < numTop; ++posn)
+		{
+			fprintf(stream, "%-20s  %-20s  %d\n",
+					ProfileInsnName(top[posn] / 512),
+					ProfileInsnName(top[posn] % 512),
+					_ILCVMInsnPairCount[top[posn]]);
+		}
+	}
+}
+
+#endif /* IL_PROFILE_CVM_INSNS */
+
 /*
  * Dump the instruction profile array.
  */
@@ -1229,6 +1301,11 @@ int _ILDumpInsnProfile(FILE *stream)
 		}
 	}
 
+#ifdef IL_PROFILE_CVM_INSNS
+	/* Dump the instruction pairs */
+	DumpInsnPairs(stream);
+#endif
+
 	/* Indicate to the caller whether we have count information or not */
 	return sawCounts;
 }
@@ -619,11 +619,16 @@ unsigned char const _ILCVMLengths[512] = {
 	/* profile_start */		CVMP_LEN_NONE,
 	/* profile_end */		CVMP_LEN_NONE,
 
-	/* preserved_94 */		CVMP_LEN_NONE,
-	/* preserved_95 */		CVMP_LEN_NONE,
-	/* preserved_96 */		CVMP_LEN_NONE,
-	/* preserved_97 */		CVMP_LEN_NONE,
-	/* preserved_98 */		CVMP_LEN_NONE,
+	/*
+	 * Superinstructions.
+	 */
+
+	/* iload2 */			CVMP_LEN_WORD2,
+	/* iload_ldc */			CVMP_LEN_WORD2,
+	/* iadd_ll */			CVMP_LEN_WORD2,
+	/* iadd_lc */			CVMP_LEN_WORD2,
+	/* iinc */				CVMP_LEN_WORD2,
+
 	/* preserved_99 */		CVMP_LEN_NONE,
 	/* preserved_9a */		CVMP_LEN_NONE,
 	/* preserved_9b */		CVMP_LEN_NONE,
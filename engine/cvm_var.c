@@ -941,4 +941,164 @@ case COP_MK_LOCAL_N:
 }
 VMBREAKNOEND;
 
-#endif /* IL_CVM_WIDE */
+#elif defined(IL_CVM_PREFIX)
+
+/**
+ * <opcode name="iload2" group="Local variable handling">
+ *   <operation>Load two <code>int32</code> variables
+ *              onto the stack</operation>
+ *
+ *   <format>prefix<fsep/>iload2<fsep/>N1[4]<fsep/>N2[4]</format>
+ *   <dformat>{iload2}<fsep/>N1<fsep/>N2</dformat>
+ *
+ *   <form name="iload2" code="COP_PREFIX_ILOAD2"/>
+ *
+ *   <before>...</before>
+ *   <after>..., value1, value2</after>
+ *
+ *   <description>Load the <code>int32</code> variables from positions
+ *   <i>N1</i> and <i>N2</i> in the local variable frame and push
+ *   <i>value1</i> and <i>value2</i> onto the stack.</description>
+ *
+ *   <notes>This superinstruction replaces the sequence
+ *   <i>iload N1; iload N2</i>.</notes>
+ * </opcode>
+ */
+VMCASE(COP_PREFIX_ILOAD2):
+{
+	/* Load two integer values from the frame */
+	CVM_VAR_LOADED(CVMP_ARG_WORD);
+	stacktop[0].intValue = frame[CVMP_ARG_WORD].intValue;
+	CVM_VAR_LOADED(CVMP_ARG_WORD2);
+	stacktop[1].intValue = frame[CVMP_ARG_WORD2].intValue;
+	MODIFY_PC_AND_STACK(CVMP_LEN_WORD2, 2);
+}
+VMBREAK(COP_PREFIX_ILOAD2);
+
+/**
+ * <opcode name="iload_ldc" group="Local variable handling">
+ *   <operation>Load an <code>int32</code> variable and an
+ *              <code>int32</code> constant onto the stack</operation>
+ *
+ *   <format>prefix<fsep/>iload_ldc<fsep/>N[4]<fsep/>V[4]</format>
+ *   <dformat>{iload_ldc}<fsep/>N<fsep/>V</dformat>
+ *
+ *   <form name="iload_ldc" code="COP_PREFIX_ILOAD_LDC"/>
+ *
+ *   <before>...</before>
+ *   <after>..., value, V</after>
+ *
+ *   <description>Load the <code>int32</code> variable from position
+ *   <i>N</i> in the local variable frame and push its <i>value</i>
+ *   onto the stack, followed by the <code>int32</code> constant
+ *   <i>V</i>.</description>
+ *
+ *   <notes>This superinstruction replaces the sequence
+ *   <i>iload N; ldc_i4 V</i>.</notes>
+ * </opcode>
+ */
+VMCASE(COP_PREFIX_ILOAD_LDC):
+{
+	/* Load an integer value from the frame and an integer constant */
+	CVM_VAR_LOADED(CVMP_ARG_WORD);
+	stacktop[0].intValue = frame[CVMP_ARG_WORD].intValue;
+	stacktop[1].intValue = (ILInt32)CVMP_ARG_WORD2;
+	MODIFY_PC_AND_STACK(CVMP_LEN_WORD2, 2);
+}
+VMBREAK(COP_PREFIX_ILOAD_LDC);
+
+/**
+ * <opcode name="iadd_ll" group="Local variable handling">
+ *   <operation>Add two <code>int32</code> variables</operation>
+ *
+ *   <format>prefix<fsep/>iadd_ll<fsep/>N1[4]<fsep/>N2[4]</format>
+ *   <dformat>{iadd_ll}<fsep/>N1<fsep/>N2</dformat>
+ *
+ *   <form name="iadd_ll" code="COP_PREFIX_IADD_LL"/>
+ *
+ *   <before>...</before>
+ *   <after>..., result</after>
+ *
+ *   <description>Add the <code>int32</code> variables at positions
+ *   <i>N1</i> and <i>N2</i> in the local variable frame and push
+ *   the <code>int32</code> <i>result</i> onto the stack.</description>
+ *
+ *   <notes>This superinstruction replaces the sequence
+ *   <i>iload N1; iload N2; iadd</i>.</notes>
+ * </opcode>
+ */
+VMCASE(COP_PREFIX_IADD_LL):
+{
+	/* Add two integer values from the frame */
+	CVM_VAR_LOADED(CVMP_ARG_WORD);
+	CVM_VAR_LOADED(CVMP_ARG_WORD2);
+	stacktop[0].intValue = frame[CVMP_ARG_WORD].intValue +
+						   frame[CVMP_ARG_WORD2].intValue;
+	MODIFY_PC_AND_STACK(CVMP_LEN_WORD2, 1);
+}
+VMBREAK(COP_PREFIX_IADD_LL);
+
+/**
+ * <opcode name="iadd_lc" group="Local variable handling">
+ *   <operation>Add an <code>int32</code> constant to an
+ *              <code>int32</code> variable</operation>
+ *
+ *   <format>prefix<fsep/>iadd_lc<fsep/>N[4]<fsep/>V[4]</format>
+ *   <dformat>{iadd_lc}<fsep/>N<fsep/>V</dformat>
+ *
+ *   <form name="iadd_lc" code="COP_PREFIX_IADD_LC"/>
+ *
+ *   <before>...</before>
+ *   <after>..., result</after>
+ *
+ *   <description>Add the <code>int32</code> constant <i>V</i> to the
+ *   <code>int32</code> variable at position <i>N</i> in the local
+ *   variable frame and push the <code>int32</code> <i>result</i>
+ *   onto the stack.</description>
+ *
+ *   <notes>This superinstruction replaces the sequences
+ *   <i>iload N; ldc_i4 V; iadd</i> and
+ *   <i>iload N; ldc_i4 -V; isub</i>.</notes>
+ * </opcode>
+ */
+VMCASE(COP_PREFIX_IADD_LC):
+{
+	/* Add an integer constant to an integer value from the frame */
+	CVM_VAR_LOADED(CVMP_ARG_WORD);
+	stacktop[0].intValue = frame[CVMP_ARG_WORD].intValue +
+						   (ILInt32)CVMP_ARG_WORD2;
+	MODIFY_PC_AND_STACK(CVMP_LEN_WORD2, 1);
+}
+VMBREAK(COP_PREFIX_IADD_LC);
+
+/**
+ * <opcode name="iinc" group="Local variable handling">
+ *   <operation>Increment an <code>int32</code> variable</operation>
+ *
+ *   <format>prefix<fsep/>iinc<fsep/>N[4]<fsep/>V[4]</format>
+ *   <dformat>{iinc}<fsep/>N<fsep/>V</dformat>
+ *
+ *   <form name="iinc" code="COP_PREFIX_IINC"/>
+ *
+ *   <before>...</before>
+ *   <after>...</after>
+ *
+ *   <description>Add the <code>int32</code> constant <i>V</i> to the
+ *   <code>int32</code> variable at position <i>N</i> in the local
+ *   variable frame.</description>
+ *
+ *   <notes>This superinstruction replaces the sequences
+ *   <i>iload N; ldc_i4 V; iadd; istore N</i> and
+ *   <i>iload N; ldc_i4 -V; isub; istore N</i>.</notes>
+ * </opcode>
+ */
+VMCASE(COP_PREFIX_IINC):
+{
+	/* Add an integer constant to an integer value in the frame */
+	CVM_VAR_STORED(CVMP_ARG_WORD);
+	frame[CVMP_ARG_WORD].intValue += (ILInt32)CVMP_ARG_WORD2;
+	MODIFY_PC_AND_STACK(CVMP_LEN_WORD2, 0);
+}
+VMBREAK(COP_PREFIX_IINC);
+
+#endif /* IL_CVM_PREFIX */
@@ -82,6 +82,12 @@ struct _tagILCVMCoder
 	ILCVMLabel     *labelList;
 	int				labelOutOfMemory;
 	unsigned char  *switchStart;
+	int				superEnabled;
+	int				superKind;
+	unsigned char  *superStart;
+	unsigned char  *superEnd;
+	ILUInt32		superOffset;
+	ILInt32			superValue;
 	int				debugEnabled;
 	ILUInt32		optimizationLevel;
 #ifdef IL_DEBUGGER
@@ -103,6 +109,7 @@ struct _tagILCVMCoder
 
 #define	IL_CVMC_DECLARATIONS
 #include "cvmc_setup.c"
+#include "cvmc_super.c"
 #undef	IL_CVMC_DECLARATIONS
 
 /*
@@ -156,6 +163,7 @@ static ILUInt32 GetStackTypeSize(ILExecProcess *process, ILType *type)
 }
 
 #define IL_CVMC_FUNCTIONS
+#include "cvmc_super.c"
 #include "cvmc_setup.c"
 #include "cvmc_except.c"
 #undef IL_CVMC_FUNCTIONS
@@ -198,6 +206,12 @@ static ILCoder *CVMCoder_Create(ILExecProcess *process, ILUInt32 size,
 	coder->labelList = 0;
 	coder->labelOutOfMemory = 0;
 	coder->switchStart = 0;
+	coder->superEnabled = 0;
+	coder->superKind = CVM_SUPER_NONE;
+	coder->superStart = 0;
+	coder->superEnd = 0;
+	coder->superOffset = 0;
+	coder->superValue = 0;
 	coder->debugEnabled = 0;
 	coder->flags = 0;
 	coder->optimizationLevel = 1;
@@ -295,6 +309,8 @@ static ILUInt32 CVMCoder_GetNativeOffset(ILCoder *_coder, void *start,
  */
 static void CVMCoder_MarkBytecode(ILCoder *coder, ILUInt32 offset)
 {
+	/* Superinstructions must not span a bytecode boundary */
+	((ILCVMCoder *)coder)->superKind = CVM_SUPER_NONE;
 	ILCacheMarkBytecode(&(((ILCVMCoder *)coder)->codePosn), offset);
 #ifdef IL_DEBUGGER
 	/* Insert potential breakpoint */
@@ -105,7 +105,10 @@ static void CVMCoder_Binary(ILCoder *coder, int opcode,
 		{
 			if(type1 == ILEngineType_I4)
 			{
-				CVM_OUT_NONE(COP_IADD);
+				if(!SuperAddInt(coder, 0))
+				{
+					CVM_OUT_NONE(COP_IADD);
+				}
 				CVM_ADJUST(-1);
 			}
 			else if(type1 == ILEngineType_I8)
@@ -155,7 +158,10 @@ static void CVMCoder_Binary(ILCoder *coder, int opcode,
 		{
 			if(type1 == ILEngineType_I4)
 			{
-				CVM_OUT_NONE(COP_ISUB);
+				if(!SuperAddInt(coder, 1))
+				{
+					CVM_OUT_NONE(COP_ISUB);
+				}
 				CVM_ADJUST(-1);
 			}
 			else if(type1 == ILEngineType_I8)
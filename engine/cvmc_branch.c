@@ -67,6 +67,9 @@ static void CVMCoder_Label(ILCoder *_coder, ILUInt32 offset)
 	   the new stack contents by calling "StackRefresh" */
 	coder->height = coder->minHeight;
 
+	/* Superinstructions must not span a branch target */
+	coder->superKind = CVM_SUPER_NONE;
+
 	/* If we might be unrolling the code later, then mark the label */
 	if(_ILCVMUnrollPossible())
 	{
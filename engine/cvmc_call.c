@@ -176,13 +176,14 @@ static void CVMCoder_CallInterface(ILCoder *coder, ILCoderMethodInfo *info,
 								   ILMethod *methodInfo)
 {
 	ILUInt32 argSize = ComputeStackSize(coder, info->args, info->numBaseArgs);
+	ILUInt32 index = methodInfo->index;
+	ILCallSiteCache *site;
 	if(info->hasParamArray)
 	{
 		++argSize;
 	}
 #ifdef IL_USE_IMTS
 	{
-		ILUInt32 index = methodInfo->index;
 		ILClassPrivate *classPrivate;
 		classPrivate = (ILClassPrivate *)(methodInfo->member.owner->userData);
 		if(classPrivate)
@@ -190,32 +191,27 @@ static void CVMCoder_CallInterface(ILCoder *coder, ILCoderMethodInfo *info,
 			index += classPrivate->imtBase;
 		}
 		index %= IL_IMT_SIZE;
-		if(info->tailCall)
-		{
-			CVMP_OUT_WORD2_PTR(COP_PREFIX_TAIL_CALLINTF, argSize,
-							   index, methodInfo);
-		}
-		else
-		{
-			CVM_OUT_DWIDE_PTR(COP_CALL_INTERFACE, argSize,
-							  index, methodInfo);
-		}
 	}
-#else
+#endif
+
+	/* Allocate the inline cache for the call site alongside the code.
+	   If the cache is full, the method will be restarted, so a NULL
+	   site is never executed */
+	site = (ILCallSiteCache *)ILCacheAlloc(&(((ILCVMCoder *)coder)->codePosn),
+										   sizeof(ILCallSiteCache));
+	if(site)
 	{
-		void *ptr = ILMethod_Owner(methodInfo);
-		if(info->tailCall)
-		{
-			CVMP_OUT_WORD2_PTR(COP_PREFIX_TAIL_CALLINTF, argSize,
-							   methodInfo->index, ptr);
-		}
-		else
-		{
-			CVM_OUT_DWIDE_PTR(COP_CALL_INTERFACE, argSize,
-							  methodInfo->index, ptr);
-		}
+		ILMemZero(site, sizeof(ILCallSiteCache));
+		site->method = methodInfo;
+	}
+	if(info->tailCall)
+	{
+		CVMP_OUT_WORD2_PTR(COP_PREFIX_TAIL_CALLINTF, argSize, index, site);
+	}
+	else
+	{
+		CVM_OUT_DWIDE_PTR(COP_CALL_INTERFACE, argSize, index, site);
 	}
-#endif
 	AdjustForCall(coder, info, returnItem);
 }
 
@@ -25,24 +25,40 @@
  */
 static void CVMCoder_Constant(ILCoder *coder, int opcode, unsigned char *arg)
 {
-	if(opcode >= IL_OP_LDNULL && opcode <= IL_OP_LDC_I4_8)
+	if(opcode >= IL_OP_LDC_I4_M1 && opcode <= IL_OP_LDC_I4_8 &&
+	   SuperLoadConstInt(coder, (ILInt32)(opcode - IL_OP_LDC_I4_0)))
+	{
+		/* Folded into "iload_ldc" */
+		CVM_ADJUST(1);
+	}
+	else if(opcode >= IL_OP_LDNULL && opcode <= IL_OP_LDC_I4_8)
 	{
 		CVM_OUT_NONE(opcode - IL_OP_LDNULL + COP_LDNULL);
 		CVM_ADJUST(1);
 	}
 	else if(opcode == IL_OP_LDC_I4_S)
 	{
-	#ifdef IL_CVM_DIRECT
-		/* In direct mode, "ldc_i4" is more efficient than "ldc_i4_s" */
-		CVM_OUT_WORD(COP_LDC_I4, (ILInt32)(ILInt8)(arg[0]));
-	#else
-		CVM_OUT_BYTE(COP_LDC_I4_S, arg[0]);
-	#endif
+		if(SuperLoadConstInt(coder, (ILInt32)(ILInt8)(arg[0])))
+		{
+			/* Folded into "iload_ldc" */
+		}
+		else
+		{
+		#ifdef IL_CVM_DIRECT
+			/* In direct mode, "ldc_i4" is more efficient than "ldc_i4_s" */
+			CVM_OUT_WORD(COP_LDC_I4, (ILInt32)(ILInt8)(arg[0]));
+		#else
+			CVM_OUT_BYTE(COP_LDC_I4_S, arg[0]);
+		#endif
+		}
 		CVM_ADJUST(1);
 	}
 	else if(opcode == IL_OP_LDC_I4)
 	{
-		CVM_OUT_WORD(COP_LDC_I4, IL_READ_UINT32(arg));
+		if(!SuperLoadConstInt(coder, IL_READ_INT32(arg)))
+		{
+			CVM_OUT_WORD(COP_LDC_I4, IL_READ_UINT32(arg));
+		}
 		CVM_ADJUST(1);
 	}
 	else if(opcode == IL_OP_LDC_R4)
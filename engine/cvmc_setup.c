@@ -281,6 +281,10 @@ static int CVMEntryGen(CVMEntryContext *ctx, ILCVMCoder *coder,
 	/* Return the start of the method code to the caller */
 	*start = coder->start;
 
+	/* Superinstructions are used unless the method is unrolled later */
+	coder->superEnabled = (coder->optimizationLevel > 0);
+	coder->superKind = CVM_SUPER_NONE;
+
 	/* Set the number of arguments, which initialize's the method's frame */
 	CVM_OUT_WIDE(COP_SET_NUM_ARGS, ctx->numArgWords);
 
@@ -357,6 +361,7 @@ static int CVMEntryGen(CVMEntryContext *ctx, ILCVMCoder *coder,
 		if(ordinaryMethod && _ILCVMUnrollPossible() && !(coder->debugEnabled))
 		{
 			CVMP_OUT_NONE(COP_PREFIX_UNROLL_METHOD);
+			coder->superEnabled = 0;
 		}
 #if defined(DONT_UNROLL_SYSTEM)
 	}
@@ -0,0 +1,209 @@
+/*
+ * cvmc_super.c - Coder implementation for CVM superinstructions.
+ *
+ * Copyright (C) 2010  Southern Storm Software, Pty Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+
+Superinstructions replace common sequences of instructions on "int32"
+local variables with a single instruction, to reduce the number of
+dispatches that the interpreter performs.  The sequences are the most
+frequent pairs that "ilrun -I" reports when the engine is built with
+"IL_PROFILE_CVM_INSNS", and the longer sequences that they grow into:
+
+	iload N1; iload N2                  ->  iload2 N1, N2
+	iload N1; iload N2; iadd            ->  iadd_ll N1, N2
+	iload N; ldc_i4 V                   ->  iload_ldc N, V
+	iload N; ldc_i4 V; iadd             ->  iadd_lc N, V
+	iload N; ldc_i4 V; isub             ->  iadd_lc N, -V
+	iload N; ldc_i4 V; iadd; istore N   ->  iinc N, V
+	iload N; ldc_i4 V; isub; istore N   ->  iinc N, -V
+
+Compare and branch are already fused in the CVM instruction set, so
+"iload2" followed by a conditional branch covers loop conditions.
+
+The coder remembers the last sequence that could be extended, and
+where it starts and ends in the code buffer.  When the next instruction
+extends the sequence, the coder rewinds to the start of the sequence
+and outputs the combined instruction in its place.  The sequence is
+forgotten if anything else is output, or if a label or bytecode mark
+is placed after it, so that superinstructions never span a branch
+target or a debug line boundary.
+
+Superinstructions are not used in methods that will be unrolled,
+because the unroller turns the original sequences into native code
+without any dispatch at all.  They are also turned off when the
+optimization level is zero.
+
+*/
+
+#ifdef IL_CVMC_DECLARATIONS
+
+/*
+ * Kinds of instruction sequences that can be extended.
+ */
+#define	CVM_SUPER_NONE			0	/* Nothing to extend */
+#define	CVM_SUPER_ILOAD			1	/* iload N */
+#define	CVM_SUPER_ILOAD2		2	/* iload2 N1, N2 */
+#define	CVM_SUPER_ILOAD_LDC		3	/* iload_ldc N, V */
+#define	CVM_SUPER_IADD_LC		4	/* iadd_lc N, V */
+
+#endif /* IL_CVMC_DECLARATIONS */
+
+#ifdef IL_CVMC_FUNCTIONS
+
+/*
+ * Determine if the last instruction sequence is of a particular
+ * kind and nothing has been output after it.
+ */
+static int SuperCanExtend(ILCVMCoder *coder, int kind)
+{
+	return (coder->superKind == kind &&
+			coder->superEnd == CVM_POSN() &&
+			!ILCacheIsFull(coder->cache, &(coder->codePosn)));
+}
+
+/*
+ * Rewind the code buffer to the start of the last instruction sequence.
+ */
+static unsigned char *SuperRewind(ILCVMCoder *coder)
+{
+	coder->codePosn.ptr = coder->superStart;
+	return coder->superStart;
+}
+
+/*
+ * Record an instruction sequence that runs from "start" to the
+ * current position, and which may be extended by the next instruction.
+ */
+static void SuperRecord(ILCVMCoder *coder, int kind, unsigned char *start,
+						ILUInt32 offset, ILInt32 value)
+{
+	if(coder->superEnabled)
+	{
+		coder->superKind = kind;
+		coder->superStart = start;
+		coder->superEnd = CVM_POSN();
+		coder->superOffset = offset;
+		coder->superValue = value;
+	}
+}
+
+/*
+ * Output an "int32" load from a local variable or argument.
+ */
+static void SuperLoadInt(ILCoder *_coder, ILUInt32 offset)
+{
+	ILCVMCoder *coder = (ILCVMCoder *)_coder;
+	unsigned char *start;
+	if(SuperCanExtend(coder, CVM_SUPER_ILOAD))
+	{
+		/* iload N1; iload N2 -> iload2 N1, N2 */
+		start = SuperRewind(coder);
+		CVMP_OUT_WORD2(COP_PREFIX_ILOAD2, coder->superOffset, offset);
+		SuperRecord(coder, CVM_SUPER_ILOAD2, start, coder->superOffset,
+					(ILInt32)offset);
+		return;
+	}
+	start = CVM_POSN();
+	if(offset < 4)
+	{
+		CVM_OUT_NONE(COP_ILOAD_0 + offset);
+	}
+	else
+	{
+		CVM_OUT_WIDE(COP_ILOAD, offset);
+	}
+	SuperRecord(coder, CVM_SUPER_ILOAD, start, offset, 0);
+}
+
+/*
+ * Try to fold an "int32" constant into the previous instruction.
+ * Returns zero if the constant must be output normally.
+ */
+static int SuperLoadConstInt(ILCoder *_coder, ILInt32 value)
+{
+	ILCVMCoder *coder = (ILCVMCoder *)_coder;
+	unsigned char *start;
+	if(SuperCanExtend(coder, CVM_SUPER_ILOAD))
+	{
+		/* iload N; ldc_i4 V -> iload_ldc N, V */
+		start = SuperRewind(coder);
+		CVMP_OUT_WORD2(COP_PREFIX_ILOAD_LDC, coder->superOffset, value);
+		SuperRecord(coder, CVM_SUPER_ILOAD_LDC, start,
+					coder->superOffset, value);
+		return 1;
+	}
+	return 0;
+}
+
+/*
+ * Try to fold an "int32" addition or subtraction into the previous
+ * instruction.  Returns zero if it must be output normally.
+ */
+static int SuperAddInt(ILCoder *_coder, int isSub)
+{
+	ILCVMCoder *coder = (ILCVMCoder *)_coder;
+	unsigned char *start;
+	ILInt32 value;
+	if(!isSub && SuperCanExtend(coder, CVM_SUPER_ILOAD2))
+	{
+		/* iload N1; iload N2; iadd -> iadd_ll N1, N2 */
+		SuperRewind(coder);
+		CVMP_OUT_WORD2(COP_PREFIX_IADD_LL, coder->superOffset,
+					   coder->superValue);
+		coder->superKind = CVM_SUPER_NONE;
+		return 1;
+	}
+	else if(SuperCanExtend(coder, CVM_SUPER_ILOAD_LDC))
+	{
+		/* iload N; ldc_i4 V; iadd -> iadd_lc N, V */
+		value = coder->superValue;
+		if(isSub)
+		{
+			value = (ILInt32)(((ILUInt32)0) - (ILUInt32)value);
+		}
+		start = SuperRewind(coder);
+		CVMP_OUT_WORD2(COP_PREFIX_IADD_LC, coder->superOffset, value);
+		SuperRecord(coder, CVM_SUPER_IADD_LC, start,
+					coder->superOffset, value);
+		return 1;
+	}
+	return 0;
+}
+
+/*
+ * Try to fold an "int32" store to a local variable or argument into
+ * the previous instruction.  Returns zero if it must be output normally.
+ */
+static int SuperStoreInt(ILCoder *_coder, ILUInt32 offset)
+{
+	ILCVMCoder *coder = (ILCVMCoder *)_coder;
+	if(SuperCanExtend(coder, CVM_SUPER_IADD_LC) &&
+	   coder->superOffset == offset)
+	{
+		/* iload N; ldc_i4 V; iadd; istore N -> iinc N, V */
+		SuperRewind(coder);
+		CVMP_OUT_WORD2(COP_PREFIX_IINC, offset, coder->superValue);
+		coder->superKind = CVM_SUPER_NONE;
+		return 1;
+	}
+	return 0;
+}
+
+#endif /* IL_CVMC_FUNCTIONS */
@@ -83,14 +83,7 @@ static void LoadLocal(ILCoder *coder, ILUInt32 offset, ILType *type)
 			case IL_META_ELEMTYPE_U:
 		#endif
 			{
-				if(offset < 4)
-				{
-					CVM_OUT_NONE(COP_ILOAD_0 + offset);
-				}
-				else
-				{
-					CVM_OUT_WIDE(COP_ILOAD, offset);
-				}
+				SuperLoadInt(coder, offset);
 				CVM_ADJUST(1);
 			}
 			break;
@@ -237,7 +230,11 @@ static void StoreLocal(ILCoder *coder, ILUInt32 offset,
 					CVM_ADJUST(-(CVM_WORDS_PER_LONG - 1));
 				}
 			#endif
-				if(offset < 4)
+				if(SuperStoreInt(coder, offset))
+				{
+					/* Folded into "iinc" */
+				}
+				else if(offset < 4)
 				{
 					CVM_OUT_NONE(COP_ISTORE_0 + offset);
 				}
@@ -51,6 +51,7 @@ extern	"C" {
    at safe points */
 #define _IL_MANAGED_SAFEPOINT_THREAD_ABORT		(1)
 #define _IL_MANAGED_SAFEPOINT_THREAD_SUSPEND	(2)
+#define _IL_MANAGED_SAFEPOINT_SAMPLE			(4)
 
 /* IL_SETJMP return value for null pointer interrupts */
 #define _IL_INTERRUPT_NULL_POINTER	(-1)
@@ -92,6 +93,11 @@ extern	"C" {
 	#define	IL_INLINE
 #endif
 
+/*
+ * Number of free GC handle slots that each thread can cache.
+ */
+#define	IL_GC_HANDLE_CACHE_SIZE		32
+
 /*
  * Default values.
  */
@@ -244,6 +250,17 @@ typedef struct
 #include "jitc.h"
 #endif
 
+/*
+ * State of the sampling profiler for a process (see "sampler.c").
+ */
+typedef struct _tagILSampler ILSampler;
+
+/*
+ * Threads that complete asynchronous socket operations for a
+ * process when their sockets become ready (see "lib_socket.c").
+ */
+typedef struct _tagILSocketPoller ILSocketPoller;
+
 /*
  * Execution control context for a process.
  */
@@ -266,6 +283,7 @@ struct _tagILExecProcess
 
 	/* Read/write lock for the metadata in "context" */
 	ILRWLock       *metadataLock;
+	int				metadataWriting;
 
 	/* Exit status if the process executes something like "exit(N)" */
 	int 			exitStatus;
@@ -283,6 +301,11 @@ struct _tagILExecProcess
 	ILClass        *clrTypeClass;
 	ILClass		 *threadAbortClass;
 
+	/* Array class for exception stack traces and the field of
+	   "System.Exception" that holds them, looked up on first use */
+	ILClass		   *packedStackFrameClass;
+	ILField		   *stackTraceField;
+
 	/* The object to throw when the system runs out of memory */
 	ILObject	   *outOfMemoryObject;
 
@@ -295,6 +318,12 @@ struct _tagILExecProcess
 	/* Hash table that contains all intern'ed strings within the system */
 	void		   *internHash;
 
+	/* Cache of classes, methods and fields looked up by name */
+	void		   *lookupCache;
+
+	/* Stubs for invoking methods via reflection, by signature */
+	void		   *invokeStubs;
+
 	/* name of this appDomain / ILExecProcess */
 	char		   *friendlyName;
 
@@ -304,9 +333,8 @@ struct _tagILExecProcess
 	ILClassPrivate *firstClassPrivate;
 
 #ifdef IL_CONFIG_USE_THIN_LOCKS
-	/* Hash table that contains all monitors */
+	/* Striped hash table that contains all monitors */
 	void			*monitorTable;
-	ILMutex		*monitorSystemLock;
 #endif
 
 	/* Finalization context used by this process */
@@ -337,6 +365,18 @@ struct _tagILExecProcess
 	/* Size of the global thread-static allocation */
 	ILUInt32			numThreadStaticSlots;
 
+	/* Interface call site cache statistics.  The hits and misses of
+	   threads are added to these when the threads are destroyed */
+	ILUInt64			icHits;
+	ILUInt64			icMisses;
+	ILInt32				icMegamorphic;
+
+	/* Call stack samples taken by the sampling profiler */
+	ILSampler		   *sampler;
+
+	/* Poller threads for asynchronous socket operations */
+	ILSocketPoller	   *socketPoller;
+
 	/* Image loading flags */
 	int					loadFlags;
 
@@ -441,6 +481,19 @@ typedef struct _tagILCallFrame
 } ILCallFrame;
 #define	IL_INVALID_PC		((unsigned char *)(ILNativeInt)(-1))
 
+/*
+ * Entry in a thread's cache of the IL offsets of the call sites
+ * that appear in exception stack traces.
+ */
+typedef struct _tagILTraceOffset
+{
+	void		   *start;			/* Start of the method's code */
+	void		   *pc;				/* Return address within the method */
+	ILInt32			offset;			/* IL offset of the call */
+
+} ILTraceOffset;
+#define	IL_TRACE_OFFSET_CACHE_SIZE	64
+
 /*
  * Execution control context for a single thread.
  */
@@ -476,6 +529,10 @@ struct _tagILExecThread
 	   managed code */	   
 	volatile ILUInt32	managedSafePointFlags;
 
+	/* Number of profiler samples taken since the thread last
+	   reached a safe point */
+	volatile ILInt32	samplesPending;
+
 	/* System.Threading.Thread object */
 	ILObject *clrThread;
 
@@ -489,6 +546,20 @@ struct _tagILExecThread
 	/* Number of monitors in the free monitor list */
 	int freeMonitorCount;
 
+	/* Number of interface calls that hit and missed the call site caches.
+	   The JIT counts only the misses, to keep its hit path short */
+	ILUInt64		icHits;
+	ILUInt64		icMisses;
+
+	/* IL offsets of recent stack trace call sites, or NULL */
+	ILTraceOffset  *traceOffsets;
+
+#ifdef IL_CONFIG_RUNTIME_INFRA
+	/* Free slots for regular and weak GC handles cached by this thread */
+	ILInt32			gcHandleCache[2][IL_GC_HANDLE_CACHE_SIZE];
+	int				gcHandleCacheCount[2];
+#endif
+
 #ifdef IL_USE_CVM
 	/* Extent of the execution stack */
 	CVMWord		   *stackBase;
@@ -888,6 +959,86 @@ ILObject *_ILEngineAllocAtomic(ILExecThread *thread, ILClass *classInfo,
  */
 ILObject *_ILEngineAllocObject(ILExecThread *thread, ILClass *classInfo);
 
+/*
+ * Inline cache for an interface call site.  Each entry maps the class
+ * of the "this" object to the method that implements the interface
+ * method for that class: an "ILMethod *" for the CVM coder, or a
+ * vtable pointer for the JIT coder.  Entries are claimed by incrementing
+ * "used" and never change once they are published in "entries", so the
+ * cache can be read without locking.  A call site that sees more
+ * classes than there are entries is megamorphic, and its misses fall
+ * back to the IMT and the interface tables of the class.
+ */
+#define	IL_CALL_SITE_CACHE_SIZE		4
+typedef struct
+{
+	ILClassPrivate *classPrivate;		/* Class of the "this" object */
+	void		   *target;				/* Method to call for the class */
+
+} ILCallSiteEntry;
+typedef struct _tagILCallSiteCache ILCallSiteCache;
+struct _tagILCallSiteCache
+{
+	ILMethod	   *method;				/* Interface method being called */
+	ILInt32			used;				/* Number of entries claimed */
+	ILCallSiteEntry *entries[IL_CALL_SITE_CACHE_SIZE];
+	ILCallSiteEntry slots[IL_CALL_SITE_CACHE_SIZE];
+
+};
+
+/*
+ * Find the target for "classPrivate" in an interface call site cache.
+ * Returns NULL on a miss.
+ */
+static IL_INLINE void *_ILCallSiteCacheLookup(ILCallSiteCache *site,
+											  ILClassPrivate *classPrivate)
+{
+	ILCallSiteEntry *entry;
+	int posn;
+
+	for(posn = 0; posn < IL_CALL_SITE_CACHE_SIZE; ++posn)
+	{
+		entry = site->entries[posn];
+		if(!entry)
+		{
+			break;
+		}
+		if(entry->classPrivate == classPrivate)
+		{
+			return entry->target;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Find the target for "classPrivate" in an interface call site cache
+ * and count the hit or miss against "thread".  Returns NULL on a miss.
+ */
+static IL_INLINE void *_ILCallSiteCacheFind(ILExecThread *thread,
+											ILCallSiteCache *site,
+											ILClassPrivate *classPrivate)
+{
+	void *target = _ILCallSiteCacheLookup(site, classPrivate);
+	if(target)
+	{
+		++(thread->icHits);
+	}
+	else
+	{
+		++(thread->icMisses);
+	}
+	return target;
+}
+
+/*
+ * Add the target for "classPrivate" to an interface call site cache
+ * after a miss.  Counts the site as megamorphic against "process"
+ * when there is no room left.
+ */
+void _ILCallSiteCacheAdd(ILExecProcess *process, ILCallSiteCache *site,
+						 ILClassPrivate *classPrivate, void *target);
+
 /*
  * Find the function for an "internalcall" method.
  * Returns zero if there is no function information.
@@ -924,6 +1075,29 @@ ILMethod *_ILLookupInterfaceMethod(ILClassPrivate *objectClassPrivate,
  */
 int _ILLookupTypeMatch(ILType *type, const char *signature);
 
+/*
+ * Look up a class by name without using the cache of lookups by name.
+ * This is for names that are in temporary buffers, whose addresses
+ * would never be seen again.
+ */
+ILClass *_ILExecThreadLookupClassUncached(ILExecThread *thread,
+										 const char *className);
+
+/*
+ * Destroy the cache of lookups by name for a process.
+ */
+void _ILLookupCacheDestroy(ILExecProcess *process);
+
+/*
+ * Destroy the reflection invoke stubs for a process.
+ */
+void _ILInvokeStubsDestroy(ILExecProcess *process);
+
+/*
+ * Destroy the intern'ed string hash table for a process.
+ */
+void _ILStringInternTableDestroy(ILExecProcess *process);
+
 /*
  * Intern a string from a constant within an image.
  * Returns NULL if an exception was thrown.
@@ -969,6 +1143,51 @@ void _ILProfilingEnd(ILMethod *method, ILInt64 *start);
 #endif /* ENHANCED_PROFILER */
 #endif /* !IL_CONFIG_REDUCE_CODE && !IL_WITHOUT_TOOLS */
 
+/*
+ * Record the pending profiler samples for a thread that has reached a
+ * safe point.  "method" is the method that the thread is executing,
+ * which is not yet on the CVM frame stack.
+ */
+void _ILSamplerRecord(ILExecThread *thread, ILMethod *method);
+
+/*
+ * Record the engine thread that is attached to "thread", so that the
+ * profiler's signal handler can find it.  Does nothing unless "thread"
+ * is the current thread.
+ */
+void _ILSamplerSetThread(ILThread *thread, ILExecThread *execThread);
+
+/*
+ * Destroy the sampling profiler state for a process.
+ */
+void _ILSamplerDestroy(ILExecProcess *process);
+
+#ifdef IL_CONFIG_NETWORKING
+
+/*
+ * Stop the socket poller threads for a process and release
+ * the operations that are still waiting for their sockets.
+ */
+void _ILSocketPollerDestroy(ILExecProcess *process);
+
+#endif /* IL_CONFIG_NETWORKING */
+
+#ifdef IL_CONFIG_RUNTIME_INFRA
+
+/*
+ * Return the free GC handle slots that are cached by a thread to
+ * the handle table of its process.  Called before the thread leaves
+ * the process, without holding the process lock.
+ */
+void _ILGCHandleCacheFlush(ILExecThread *thread);
+
+/*
+ * Destroy the GC handle table of a process.
+ */
+void _ILGCHandleTableFree(struct _tagILGCHandleTable *table);
+
+#endif /* IL_CONFIG_RUNTIME_INFRA */
+
 #ifndef REDUCED_STDIO
 
 /*
@@ -1105,11 +1324,19 @@ void *_ILDelegateGetClosure(ILExecThread *thread, ILObject *delegate);
 ILUInt32 _ILGetMethodParamCount(ILExecThread *thread, ILMethod *method,
 								int suppressThis);
 
+/*
+ * Lock metadata for writing, or unlock it after reading or writing.
+ * Writers also hold the context's lazy loading lock, so that metadata
+ * is never loaded on demand while a writer is changing the context.
+ */
+void _ILExecProcessMetadataWriteLock(ILExecProcess *process);
+void _ILExecProcessMetadataUnlock(ILExecProcess *process);
+
 /*
  * Lock metadata for reading or writing from the given process.
  */
 #define	IL_METADATA_WRLOCK(process)	\
-			ILRWLockWriteLock((process)->metadataLock)
+			_ILExecProcessMetadataWriteLock((process))
 #define	IL_METADATA_RDLOCK(process)	\
 			ILRWLockReadLock((process)->metadataLock)
 
@@ -1117,7 +1344,7 @@ ILUInt32 _ILGetMethodParamCount(ILExecThread *thread, ILMethod *method,
  * Unlock metadata from the given process.
  */
 #define	IL_METADATA_UNLOCK(process)	\
-			ILRWLockUnlock((process)->metadataLock)
+			_ILExecProcessMetadataUnlock((process))
 
 #ifdef IL_CONFIG_DEBUG_LINES
 
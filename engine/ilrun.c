@@ -137,13 +137,22 @@ static ILCmdLineOption const options[] = {
 	{"--dump-config", 'D', 0,
 		"--dump-config           or -D",
 		"Dump information about the engine configuration."},
+	{"-P", 'P', 0, 0, 0},
+	{"--dump-params", 'P', 0,
+		"--dump-params           or -P",
+		"Display memory, call and monitor statistics on exit."},
+	{"-R", 'R', 1, 0, 0},
+	{"--sample-rate", 'R', 1,
+		"--sample-rate rate      or -R rate",
+		"Sample call stacks `rate' times per second of CPU time."},
+	{"--sample-file", 'F', 1,
+		"--sample-file file",
+		"Write call stack samples to `file' (default ilrun.folded)."},
 
 	{"-I", 'I', 0, 0, 0},
 	{"--insn-profile", 'I', 0, 0, 0},
 	{"-V", 'V', 0, 0, 0},
 	{"--var-profile", 'V', 0, 0, 0},
-	{"-P", 'P', 0, 0, 0},
-	{"--dump-params", 'P', 0, 0, 0},
 #endif
 
 	{"-v", 'v', 0, 0, 0},
@@ -187,6 +196,8 @@ int main(int argc, char *argv[])
 	int dumpMethodProfile = 0;
 	int dumpParams = 0;
 	int dumpConfig = 0;
+	int sampleRate = 0;
+	const char *sampleFile = "ilrun.folded";
 #endif
 #ifdef ENHANCED_PROFILER
 	int profilingEnabled = 0;
@@ -323,6 +334,28 @@ int main(int argc, char *argv[])
 			}
 			break;
 
+			case 'R':
+			{
+				sampleRate = 0;
+				while(*param >= '0' && *param <= '9' && sampleRate < 1000000)
+				{
+					sampleRate = sampleRate * 10 + (*param - '0');
+					++param;
+				}
+				if(*param != '\0' || sampleRate <= 0)
+				{
+					fprintf(stderr, "%s: invalid sample rate\n", progname);
+					return 1;
+				}
+			}
+			break;
+
+			case 'F':
+			{
+				sampleFile = param;
+			}
+			break;
+
 			case 'D':
 			{
 				dumpConfig+=1;
@@ -497,6 +530,14 @@ int main(int argc, char *argv[])
 	thread = ILExecProcessGetMain(process);
 #ifdef ENHANCED_PROFILER
 	thread->profilingEnabled = profilingEnabled;
+#endif
+#if !defined(IL_CONFIG_REDUCE_CODE) && !defined(IL_WITHOUT_TOOLS)
+	if(sampleRate > 0 && !ILExecProcessStartSampling(process, sampleRate))
+	{
+		fprintf(stderr, "%s: call stack sampling is not available\n",
+				progname);
+		sampleRate = 0;
+	}
 #endif
 	error = ILExecProcessExecuteFile(process, ilprogram, argv + 2, &retval);
 	if((error != IL_EXECUTE_OK) && (error != IL_EXECUTE_ERR_EXCEPTION))
@@ -580,6 +621,22 @@ int main(int argc, char *argv[])
 	ILThreadWaitForForegroundThreads(-1);
  
 #if !defined(IL_CONFIG_REDUCE_CODE) && !defined(IL_WITHOUT_TOOLS)
+	/* Write the call stack samples if requested */
+	if(sampleRate > 0)
+	{
+		FILE *sampleStream;
+		ILExecProcessStopSampling(process);
+		if((sampleStream = fopen(sampleFile, "w")) != 0)
+		{
+			ILExecProcessDumpSamples(process, sampleStream);
+			fclose(sampleStream);
+		}
+		else
+		{
+			perror(sampleFile);
+		}
+	}
+
 	/* Print profile information if requested */
 	if(dumpInsnProfile)
 	{
@@ -615,6 +672,7 @@ int main(int argc, char *argv[])
 	if(dumpParams)
 	{
 		long mallocMax;
+		ILMonitorStats monitorStats;
 		printf("GC Heap Size      = %ld\n",
 			   ILExecProcessGetParam(process, IL_EXEC_PARAM_GC_SIZE));
 		printf("Method Cache Size = %ld\n",
@@ -624,6 +682,28 @@ int main(int argc, char *argv[])
 		{
 			printf("Max Malloc Usage  = %ld\n", mallocMax);
 		}
+		printf("IC Hits           = %ld\n",
+			   ILExecProcessGetParam(process, IL_EXEC_PARAM_IC_HITS));
+		printf("IC Misses         = %ld\n",
+			   ILExecProcessGetParam(process, IL_EXEC_PARAM_IC_MISSES));
+		printf("IC Megamorphic    = %ld\n",
+			   ILExecProcessGetParam(process, IL_EXEC_PARAM_IC_MEGAMORPHIC));
+		printf("Metadata Rows     = %ld of %ld\n",
+			   ILExecProcessGetParam(process, IL_EXEC_PARAM_META_LOADED),
+			   ILExecProcessGetParam(process, IL_EXEC_PARAM_META_PRESENT));
+		ILMonitorGetStats(&monitorStats);
+		printf("Monitors Used     = %lu\n",
+			   (unsigned long)(monitorStats.numUsed));
+		printf("Monitors Free     = %lu\n",
+			   (unsigned long)(monitorStats.numFree));
+		printf("Monitor Hits      = %lu\n",
+			   (unsigned long)(monitorStats.cacheHits));
+		printf("Monitor Refills   = %lu\n",
+			   (unsigned long)(monitorStats.cacheMisses));
+		printf("Monitor Drains    = %lu\n",
+			   (unsigned long)(monitorStats.drains));
+		printf("Monitor Contended = %lu\n",
+			   (unsigned long)(monitorStats.contended));
 	}
 #endif
 
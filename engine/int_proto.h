@@ -604,6 +604,8 @@ extern void _IL_CryptoMethods_HashUpdate(ILExecThread * _thread, ILNativeInt sta
 extern void _IL_CryptoMethods_HashFinal(ILExecThread * _thread, ILNativeInt state, System_Array * hash);
 extern void _IL_CryptoMethods_Decrypt(ILExecThread * _thread, ILNativeInt state, System_Array * inBuffer, ILInt32 inOffset, System_Array * outBuffer, ILInt32 outOffset);
 extern void _IL_CryptoMethods_Encrypt(ILExecThread * _thread, ILNativeInt state, System_Array * inBuffer, ILInt32 inOffset, System_Array * outBuffer, ILInt32 outOffset);
+extern void _IL_CryptoMethods_DecryptBlocks(ILExecThread * _thread, ILNativeInt state, System_Array * inBuffer, ILInt32 inOffset, System_Array * outBuffer, ILInt32 outOffset, ILInt32 count);
+extern void _IL_CryptoMethods_EncryptBlocks(ILExecThread * _thread, ILNativeInt state, System_Array * inBuffer, ILInt32 inOffset, System_Array * outBuffer, ILInt32 outOffset, ILInt32 count);
 extern ILNativeInt _IL_CryptoMethods_EncryptCreate(ILExecThread * _thread, ILInt32 algorithm, System_Array * key);
 extern ILNativeInt _IL_CryptoMethods_DecryptCreate(ILExecThread * _thread, ILInt32 algorithm, System_Array * key);
 extern void _IL_CryptoMethods_SymmetricFree(ILExecThread * _thread, ILNativeInt state);
@@ -717,6 +719,12 @@ extern ILBool _IL_SocketMethods_CanStartThreads(ILExecThread * _thread);
 extern ILBool _IL_SocketMethods_QueueCompletionItem(ILExecThread * _thread, ILObject * callback, ILObject * state);
 extern ILObject * _IL_SocketMethods_CreateManualResetEvent(ILExecThread * _thread);
 extern void _IL_SocketMethods_WaitHandleSet(ILExecThread * _thread, ILObject * waitHandle);
+extern ILBool _IL_SocketMethods_QueueReadyItem(ILExecThread * _thread, ILNativeInt handle, ILInt32 events, ILObject * callback, ILObject * state);
+extern ILNativeInt _IL_SocketMethods_PollSetCreate(ILExecThread * _thread);
+extern void _IL_SocketMethods_PollSetDestroy(ILExecThread * _thread, ILNativeInt pollSet);
+extern ILBool _IL_SocketMethods_PollSetAdd(ILExecThread * _thread, ILNativeInt pollSet, ILNativeInt handle, ILInt32 events);
+extern ILBool _IL_SocketMethods_PollSetRemove(ILExecThread * _thread, ILNativeInt pollSet, ILNativeInt handle);
+extern ILInt32 _IL_SocketMethods_PollSetWait(ILExecThread * _thread, ILNativeInt pollSet, System_Array * handles, System_Array * events, ILInt64 timeout);
 
 extern ILBool _IL_DnsMethods_InternalGetHostByName(ILExecThread * _thread, ILString * host, ILString * * h_name, System_Array * * h_aliases, System_Array * * h_addr_list);
 extern ILBool _IL_DnsMethods_InternalGetHostByAddr(ILExecThread * _thread, ILInt64 address, ILString * * h_name, System_Array * * h_aliases, System_Array * * h_addr_list);
@@ -2690,6 +2690,15 @@ static void marshal_bppipi(void (*fn)(), void *rvalue, void **avalue)
 
 #endif
 
+#if !defined(HAVE_LIBFFI)
+
+static void marshal_vpjpipii(void (*fn)(), void *rvalue, void **avalue)
+{
+	(*(void (*)(void *, ILNativeUInt, void *, ILInt32, void *, ILInt32, ILInt32))fn)(*((void * *)(avalue[0])), *((ILNativeUInt *)(avalue[1])), *((void * *)(avalue[2])), *((ILInt32 *)(avalue[3])), *((void * *)(avalue[4])), *((ILInt32 *)(avalue[5])), *((ILInt32 *)(avalue[6])));
+}
+
+#endif
+
 #ifndef _IL_CryptoMethods_suppressed
 
 IL_METHOD_BEGIN(CryptoMethods_Methods)
@@ -2701,6 +2710,8 @@ IL_METHOD_BEGIN(CryptoMethods_Methods)
 	IL_METHOD("HashFinal", "(j[B)V", _IL_CryptoMethods_HashFinal, marshal_vpjp)
 	IL_METHOD("Decrypt", "(j[Bi[Bi)V", _IL_CryptoMethods_Decrypt, marshal_vpjpipi)
 	IL_METHOD("Encrypt", "(j[Bi[Bi)V", _IL_CryptoMethods_Encrypt, marshal_vpjpipi)
+	IL_METHOD("DecryptBlocks", "(j[Bi[Bii)V", _IL_CryptoMethods_DecryptBlocks, marshal_vpjpipii)
+	IL_METHOD("EncryptBlocks", "(j[Bi[Bii)V", _IL_CryptoMethods_EncryptBlocks, marshal_vpjpipii)
 	IL_METHOD("EncryptCreate", "(i[B)j", _IL_CryptoMethods_EncryptCreate, marshal_jpip)
 	IL_METHOD("DecryptCreate", "(i[B)j", _IL_CryptoMethods_DecryptCreate, marshal_jpip)
 	IL_METHOD("SymmetricFree", "(j)V", _IL_CryptoMethods_SymmetricFree, marshal_vpj)
@@ -3015,6 +3026,33 @@ static void marshal_bpjb(void (*fn)(), void *rvalue, void **avalue)
 
 #endif
 
+#if !defined(HAVE_LIBFFI)
+
+static void marshal_bpjji(void (*fn)(), void *rvalue, void **avalue)
+{
+	*((ILNativeInt *)rvalue) = (*(ILInt8 (*)(void *, ILNativeUInt, ILNativeUInt, ILInt32))fn)(*((void * *)(avalue[0])), *((ILNativeUInt *)(avalue[1])), *((ILNativeUInt *)(avalue[2])), *((ILInt32 *)(avalue[3])));
+}
+
+#endif
+
+#if !defined(HAVE_LIBFFI)
+
+static void marshal_ipjppl(void (*fn)(), void *rvalue, void **avalue)
+{
+	*((ILNativeInt *)rvalue) = (*(ILInt32 (*)(void *, ILNativeUInt, void *, void *, ILInt64))fn)(*((void * *)(avalue[0])), *((ILNativeUInt *)(avalue[1])), *((void * *)(avalue[2])), *((void * *)(avalue[3])), *((ILInt64 *)(avalue[4])));
+}
+
+#endif
+
+#if !defined(HAVE_LIBFFI)
+
+static void marshal_bpjipp(void (*fn)(), void *rvalue, void **avalue)
+{
+	*((ILNativeInt *)rvalue) = (*(ILInt8 (*)(void *, ILNativeUInt, ILInt32, void *, void *))fn)(*((void * *)(avalue[0])), *((ILNativeUInt *)(avalue[1])), *((ILInt32 *)(avalue[2])), *((void * *)(avalue[3])), *((void * *)(avalue[4])));
+}
+
+#endif
+
 #ifndef _IL_SocketMethods_suppressed
 
 IL_METHOD_BEGIN(SocketMethods_Methods)
@@ -3048,6 +3086,12 @@ IL_METHOD_BEGIN(SocketMethods_Methods)
 	IL_METHOD("QueueCompletionItem", "(oSystem.AsyncCallback;oSystem.IAsyncResult;)Z", _IL_SocketMethods_QueueCompletionItem, marshal_bppp)
 	IL_METHOD("CreateManualResetEvent", "()oSystem.Threading.WaitHandle;", _IL_SocketMethods_CreateManualResetEvent, marshal_pp)
 	IL_METHOD("WaitHandleSet", "(oSystem.Threading.WaitHandle;)V", _IL_SocketMethods_WaitHandleSet, marshal_vpp)
+	IL_METHOD("QueueReadyItem", "(jioSystem.AsyncCallback;oSystem.IAsyncResult;)Z", _IL_SocketMethods_QueueReadyItem, marshal_bpjipp)
+	IL_METHOD("PollSetCreate", "()j", _IL_SocketMethods_PollSetCreate, marshal_jp)
+	IL_METHOD("PollSetDestroy", "(j)V", _IL_SocketMethods_PollSetDestroy, marshal_vpj)
+	IL_METHOD("PollSetAdd", "(jji)Z", _IL_SocketMethods_PollSetAdd, marshal_bpjji)
+	IL_METHOD("PollSetRemove", "(jj)Z", _IL_SocketMethods_PollSetRemove, marshal_bpjj)
+	IL_METHOD("PollSetWait", "(j[j[il)i", _IL_SocketMethods_PollSetWait, marshal_ipjppl)
 IL_METHOD_END
 
 #endif
@@ -205,6 +205,12 @@ static ILJitType _ILJitSignature_ILRuntimeExceptionThrowOutOfMemory = 0;
  */
 static ILJitType _ILJitSignature_ILRuntimeLookupInterfaceMethod = 0;
 
+/*
+ * static void *_ILRuntimeLookupInterfaceCallSite(ILClassPrivate *objectClassPrivate,
+ *												  ILCallSiteCache *site)
+ */
+static ILJitType _ILJitSignature_ILRuntimeLookupInterfaceCallSite = 0;
+
 /*
  * ILInt32 ILRuntimeCanCastClass(ILMethod *method, ILObject *object, ILClass *toClass)
  *
@@ -429,6 +435,9 @@ struct _tagILJITCoder
 	/* Pool for the method infos. */
 	ILMemPool		methodPool;
 
+	/* Pool for the inline caches of interface call sites. */
+	ILMemPool		callSitePool;
+
 #define	IL_JITC_CODER_INSTANCE
 #include "jitc_inline.c"
 #include "jitc_locals.c"
@@ -1598,6 +1607,10 @@ void ILRuntimeHandleManagedSafePointFlags(ILExecThread *thread)
 			_ILExecThreadSuspendThread(thread, thread->supportThread);
 		}
 	}
+	else if(thread->managedSafePointFlags & _IL_MANAGED_SAFEPOINT_SAMPLE)
+	{
+		_ILSamplerRecord(thread, 0);
+	}
 }
 
 /*
@@ -1793,6 +1806,51 @@ static void *_ILRuntimeLookupInterfaceMethod(ILClassPrivate *objectClassPrivate,
 	return 0;
 }
 
+/*
+ * Look up an interface method through the IMT of the object's class and
+ * then the inline cache for a call site, falling back to a search of the
+ * object's interface tables on a miss.  Only the misses are counted, so
+ * that the hit path does not need the current thread.
+ */
+static void *_ILRuntimeLookupInterfaceCallSite(ILClassPrivate *objectClassPrivate,
+											   ILCallSiteCache *site)
+{
+	ILExecThread *thread;
+	void *function;
+#ifdef IL_USE_IMTS
+	ILClassPrivate *interfacePrivate;
+
+	/* The IMT finds the method directly unless its slot is shared */
+	interfacePrivate =
+		(ILClassPrivate *)(site->method->member.owner->userData);
+	if(interfacePrivate)
+	{
+		function = objectClassPrivate->imt
+			[(interfacePrivate->imtBase + site->method->index) % IL_IMT_SIZE];
+		if(function)
+		{
+			return function;
+		}
+	}
+#endif
+
+	function = _ILCallSiteCacheLookup(site, objectClassPrivate);
+	if(!function)
+	{
+		thread = ILExecThreadCurrent();
+		++(thread->icMisses);
+		function = _ILRuntimeLookupInterfaceMethod(objectClassPrivate,
+												   site->method->member.owner,
+												   site->method->index);
+		if(function)
+		{
+			_ILCallSiteCacheAdd(_ILExecThreadProcess(thread), site,
+								objectClassPrivate, function);
+		}
+	}
+	return function;
+}
+
 #ifdef IL_JIT_FNPTR_ILMETHOD
 /*
  * This is the same function as above but returns the ILMethod instead of the
@@ -2363,6 +2421,15 @@ int ILJitInit()
 		return 0;
 	}
 
+	args[0] = _IL_JIT_TYPE_VPTR;
+	args[1] = _IL_JIT_TYPE_VPTR;
+	returnType = _IL_JIT_TYPE_VPTR;
+	if(!(_ILJitSignature_ILRuntimeLookupInterfaceCallSite = 
+		jit_type_create_signature(IL_JIT_CALLCONV_CDECL, returnType, args, 2, 1)))
+	{
+		return 0;
+	}
+
 	returnType = _IL_JIT_TYPE_VOID;
 	if(!(_ILJitSignature_JitExceptionClearLast =
 		jit_type_create_signature(IL_JIT_CALLCONV_CDECL, returnType, 0, 0, 1)))
@@ -2623,12 +2690,16 @@ static ILCoder *JITCoder_Create(ILExecProcess *process, ILUInt32 size,
 	/* Intialize the pool for the method infos. */
 	ILMemPoolInit(&(coder->methodPool), sizeof(ILJitMethodInfo), 100);
 
+	/* Initialize the pool for the interface call site caches. */
+	ILMemPoolInit(&(coder->callSitePool), sizeof(ILCallSiteCache), 100);
+
 	/* Init the current jitted function. */
 	coder->jitFunction = 0;
 
 	if(!ILCCtorMgr_Init(&(coder->cctorMgr), 10))
 	{
 		ILMemPoolDestroy(&(coder->methodPool));
+		ILMemPoolDestroy(&(coder->callSitePool));
 		ILFree(coder);
 		return 0;
 	}
@@ -2887,6 +2958,8 @@ static void JITCoder_Destroy(ILCoder *_coder)
 
 	ILMemPoolDestroy(&(coder->methodPool));
 
+	ILMemPoolDestroy(&(coder->callSitePool));
+
 	ILCCtorMgr_Destroy(&(coder->cctorMgr));
 
 	ILFree(coder);
@@ -237,6 +237,13 @@ ILMethod *_ILJitGetCallingMethod(ILExecThread *thread, ILUInt32 frames);
  */
 ILInt32 _ILJitDiagNumFrames(ILExecThread *thread);
 
+/*
+ * Get the methods of the jitted frames on the current call stack,
+ * innermost first.  Returns the number of methods stored in "methods".
+ */
+ILInt32 _ILJitDiagGetMethods(ILExecThread *thread, ILMethod **methods,
+							 ILInt32 maxMethods);
+
 /*
  * Get the current PackedStackFrame.
  */
@@ -106,33 +106,48 @@ static ILInt32 _ILJitFillArguments(ILJITCoder *coder,
  */
 static ILJitValue _ILJitGetInterfaceFunction(ILJITCoder *jitCoder,
 											 ILJitStackItem *object,
-											 ILClass *interface,
-											 int index)
+											 ILMethod *methodInfo)
 {
 	ILJitValue classPrivate;
-	ILJitValue interfaceClass;
-	ILJitValue methodIndex;
 	ILJitValue args[3];
 	ILJitValue jitFunction;
+	ILCallSiteCache *site;
 	jit_label_t label = jit_label_undefined;
 
 	_ILJitStackItemCheckNull(jitCoder, *object);
 	classPrivate = _ILJitGetObjectClassPrivate(jitCoder->jitFunction,
 											   _ILJitStackItemValue(*object));
-	interfaceClass = jit_value_create_nint_constant(jitCoder->jitFunction,
-													_IL_JIT_TYPE_VPTR,
-													(jit_nint)interface);
-	methodIndex = jit_value_create_nint_constant(jitCoder->jitFunction,
-												 _IL_JIT_TYPE_UINT32,
-												 (jit_nint)index);
 	args[0] = classPrivate;
-	args[1] = interfaceClass;
-	args[2] = methodIndex;
-	jitFunction = jit_insn_call_native(jitCoder->jitFunction,
-									   "_ILRuntimeLookupInterfaceMethod",
-									   _ILRuntimeLookupInterfaceMethod,
-									   _ILJitSignature_ILRuntimeLookupInterfaceMethod,
-									   args, 3, 0);
+
+	/* Look the method up through an inline cache for the call site if
+	   one can be allocated, or search the interface tables directly */
+	site = ILMemPoolCalloc(&(jitCoder->callSitePool), ILCallSiteCache);
+	if(site)
+	{
+		site->method = methodInfo;
+		args[1] = jit_value_create_nint_constant(jitCoder->jitFunction,
+												 _IL_JIT_TYPE_VPTR,
+												 (jit_nint)site);
+		jitFunction = jit_insn_call_native(jitCoder->jitFunction,
+										   "_ILRuntimeLookupInterfaceCallSite",
+										   _ILRuntimeLookupInterfaceCallSite,
+										   _ILJitSignature_ILRuntimeLookupInterfaceCallSite,
+										   args, 2, 0);
+	}
+	else
+	{
+		args[1] = jit_value_create_nint_constant(jitCoder->jitFunction,
+												 _IL_JIT_TYPE_VPTR,
+												 (jit_nint)methodInfo->member.owner);
+		args[2] = jit_value_create_nint_constant(jitCoder->jitFunction,
+												 _IL_JIT_TYPE_UINT32,
+												 (jit_nint)methodInfo->index);
+		jitFunction = jit_insn_call_native(jitCoder->jitFunction,
+										   "_ILRuntimeLookupInterfaceMethod",
+										   _ILRuntimeLookupInterfaceMethod,
+										   _ILJitSignature_ILRuntimeLookupInterfaceMethod,
+										   args, 3, 0);
+	}
 
 	jit_insn_branch_if(jitCoder->jitFunction, jitFunction, &label);
 	_ILJitThrowSystem(jitCoder->jitFunction, _IL_JIT_MISSING_METHOD);
@@ -1101,8 +1116,7 @@ static void JITCoder_CallInterface(ILCoder *coder, ILCoderMethodInfo *info,
 
 	jitFunction = _ILJitGetInterfaceFunction(jitCoder,
 											 _ILJitStackItemGetTop(jitCoder, -1),
-											 methodInfo->member.owner,
-											 methodInfo->index);
+											 methodInfo);
 #else
 	destroyCallSignature = _ILJitFillArguments(jitCoder,
 											   methodInfo,
@@ -1113,8 +1127,7 @@ static void JITCoder_CallInterface(ILCoder *coder, ILCoderMethodInfo *info,
 
 	jitFunction = _ILJitGetInterfaceFunction(jitCoder,
 											 _ILJitStackItemGetTop(jitCoder, -1),
-											 methodInfo->member.owner,
-											 methodInfo->index);
+											 methodInfo);
 #endif
 #if !defined(IL_CONFIG_REDUCE_CODE) && !defined(IL_WITHOUT_TOOLS) && defined(_IL_JIT_ENABLE_DEBUG)
 	if (jitCoder->flags & IL_CODER_FLAG_STATS)
@@ -1990,8 +2003,7 @@ static void JITCoder_LoadInterfaceAddr(ILCoder *coder, ILMethod *methodInfo)
 #else
 	jitFunction = _ILJitGetInterfaceFunction(jitCoder,
 											 &object,
-											 methodInfo->member.owner,
-											 methodInfo->index);
+											 methodInfo);
 #endif
 	/* Push the function pointer on the stack. */
 	_ILJitStackPushValue(jitCoder, jitFunction);
@@ -112,6 +112,45 @@ ILInt32 _ILJitDiagNumFrames(ILExecThread *thread)
 	return num;
 }
 
+/*
+ * Get the methods of the jitted frames on the current call stack,
+ * innermost first.
+ */
+ILInt32 _ILJitDiagGetMethods(ILExecThread *thread, ILMethod **methods,
+							 ILInt32 maxMethods)
+{
+	ILJITCoder *jitCoder = (ILJITCoder *)(_ILExecThreadProcess(thread)->coder);
+	ILInt32 num = 0;
+
+	if(jitCoder)
+	{
+		jit_stack_trace_t stackTrace = jit_exception_get_stack_trace();
+		if(stackTrace)
+		{
+			ILUInt32 size = jit_stack_trace_get_size(stackTrace);
+			ILUInt32 current;
+			ILJitFunction func;
+			ILMethod *method;
+
+			for(current = 0; current < size && num < maxMethods; ++current)
+			{
+				if((func = jit_stack_trace_get_function(jitCoder->context,
+														stackTrace, current)))
+				{
+					method = (ILMethod *)jit_function_get_meta
+						(func, IL_JIT_META_METHOD);
+					if(method != 0)
+					{
+						methods[num++] = method;
+					}
+				}
+			}
+			jit_stack_trace_free(stackTrace);
+		}
+	}
+	return num;
+}
+
 /*
  * Get the current PackedStackFrame.
  */
@@ -136,6 +175,8 @@ System_Array *_ILJitGetExceptionStackTrace(ILExecThread *thread)
 		ILObject *array;
 		PackedStackFrame *data;
 		ILClass *classInfo;
+		ILTraceOffset *entry;
+		void *pc;
 		ILUInt32 current;
 
 		for(current = 0; current < size; ++current)
@@ -163,8 +204,7 @@ System_Array *_ILJitGetExceptionStackTrace(ILExecThread *thread)
 		   use "ILExecThreadNew" because it will re-enter the engine.
 		   If we are throwing "StackOverflowException", then we will
 		   get an infinite recursive loop */
-		classInfo = ILExecThreadLookupClass
-				(thread, "[vSystem.Diagnostics.PackedStackFrame;");
+		classInfo = _ILGetPackedStackFrameClass(thread);
 		if(!classInfo)
 		{
 			ILExecThreadThrowOutOfMemory(thread);
@@ -192,13 +232,30 @@ System_Array *_ILJitGetExceptionStackTrace(ILExecThread *thread)
 													IL_JIT_META_METHOD)) != 0)
 				{
 					data->method = method;
-					data->offset = jit_stack_trace_get_offset(jitCoder->context,
-															  stackTrace,
-															  current);
 					/* Get the native pc  */
 					/* TODO: make nativeOffset a void *. */
-					data->nativeOffset = (ILInt32)jit_stack_trace_get_pc(stackTrace,
-																		 current);
+					pc = jit_stack_trace_get_pc(stackTrace, current);
+					data->nativeOffset = (ILInt32)pc;
+
+					/* Mapping the pc to an IL offset is expensive, so
+					   remember it in case we see the call again */
+					entry = _ILTraceOffsetEntry(thread, pc);
+					if(entry && entry->pc == pc &&
+					   entry->start == (void *)method)
+					{
+						data->offset = entry->offset;
+					}
+					else
+					{
+						data->offset = jit_stack_trace_get_offset
+							(jitCoder->context, stackTrace, current);
+						if(entry)
+						{
+							entry->start = (void *)method;
+							entry->pc = pc;
+							entry->offset = data->offset;
+						}
+					}
 					++data;
 					--num;
 				}
@@ -78,11 +78,16 @@ typedef struct
 typedef void (*SymResetFunc)(void *ctx);
 typedef void (*SymCryptFunc)(void *ctx, unsigned char *input,
 							 unsigned char *output);
+typedef void (*SymBlocksFunc)(void *ctx, const unsigned char *input,
+							  unsigned char *output, unsigned long numBlocks);
 typedef struct
 {
 	SymResetFunc	reset;
 	SymCryptFunc	encrypt;
 	SymCryptFunc	decrypt;
+	SymBlocksFunc	encryptBlocks;
+	SymBlocksFunc	decryptBlocks;
+	int				blockSize;
 
 } SymContext;
 
@@ -563,6 +568,9 @@ ILNativeInt _IL_CryptoMethods_EncryptCreate(ILExecThread *_thread,
 			context->reset = (SymResetFunc)ILDESFinalize;
 			context->encrypt = (SymCryptFunc)ILDESProcess;
 			context->decrypt = (SymCryptFunc)ILDESProcess;
+			context->encryptBlocks = 0;
+			context->decryptBlocks = 0;
+			context->blockSize = 8;
 			ILDESInit(&(((DESContext *)context)->des),
 					  ArrayToBuffer(key), 0);
 			return (ILNativeInt)context;
@@ -581,6 +589,9 @@ ILNativeInt _IL_CryptoMethods_EncryptCreate(ILExecThread *_thread,
 			context->reset = (SymResetFunc)ILDES3Finalize;
 			context->encrypt = (SymCryptFunc)ILDES3Process;
 			context->decrypt = (SymCryptFunc)ILDES3Process;
+			context->encryptBlocks = 0;
+			context->decryptBlocks = 0;
+			context->blockSize = 8;
 			ILDES3Init(&(((DES3Context *)context)->des3),
 					   ArrayToBuffer(key), (int)(ArrayLength(key) * 8), 0);
 			return (ILNativeInt)context;
@@ -599,6 +610,9 @@ ILNativeInt _IL_CryptoMethods_EncryptCreate(ILExecThread *_thread,
 			context->reset = (SymResetFunc)ILRC2Finalize;
 			context->encrypt = (SymCryptFunc)ILRC2Encrypt;
 			context->decrypt = (SymCryptFunc)ILRC2Decrypt;
+			context->encryptBlocks = 0;
+			context->decryptBlocks = 0;
+			context->blockSize = 8;
 			ILRC2Init(&(((RC2Context *)context)->rc2),
 					  ArrayToBuffer(key), (int)(ArrayLength(key) * 8));
 			return (ILNativeInt)context;
@@ -617,6 +631,9 @@ ILNativeInt _IL_CryptoMethods_EncryptCreate(ILExecThread *_thread,
 			context->reset = (SymResetFunc)ILAESFinalize;
 			context->encrypt = (SymCryptFunc)ILAESEncrypt;
 			context->decrypt = (SymCryptFunc)ILAESDecrypt;
+			context->encryptBlocks = (SymBlocksFunc)ILAESEncryptBlocks;
+			context->decryptBlocks = (SymBlocksFunc)ILAESDecryptBlocks;
+			context->blockSize = 16;
 			ILAESInit(&(((AESContext *)context)->aes),
 					  ArrayToBuffer(key), (int)(ArrayLength(key) * 8));
 			return (ILNativeInt)context;
@@ -653,6 +670,9 @@ ILNativeInt _IL_CryptoMethods_DecryptCreate(ILExecThread *_thread,
 			context->reset = (SymResetFunc)ILDESFinalize;
 			context->encrypt = (SymCryptFunc)ILDESProcess;
 			context->decrypt = (SymCryptFunc)ILDESProcess;
+			context->encryptBlocks = 0;
+			context->decryptBlocks = 0;
+			context->blockSize = 8;
 			ILDESInit(&(((DESContext *)context)->des),
 					  ArrayToBuffer(key), 1);
 			return (ILNativeInt)context;
@@ -671,6 +691,9 @@ ILNativeInt _IL_CryptoMethods_DecryptCreate(ILExecThread *_thread,
 			context->reset = (SymResetFunc)ILDES3Finalize;
 			context->encrypt = (SymCryptFunc)ILDES3Process;
 			context->decrypt = (SymCryptFunc)ILDES3Process;
+			context->encryptBlocks = 0;
+			context->decryptBlocks = 0;
+			context->blockSize = 8;
 			ILDES3Init(&(((DES3Context *)context)->des3),
 					   ArrayToBuffer(key), (int)(ArrayLength(key) * 8), 1);
 			return (ILNativeInt)context;
@@ -719,6 +742,73 @@ void _IL_CryptoMethods_Decrypt(ILExecThread *_thread,
 	}
 }
 
+/*
+ * Encrypt or decrypt a run of whole blocks with a symmetric context.
+ */
+static void CryptBlocks(SymContext *context, SymCryptFunc crypt,
+						SymBlocksFunc cryptBlocks, System_Array *inBuffer,
+						ILInt32 inOffset, System_Array *outBuffer,
+						ILInt32 outOffset, ILInt32 count)
+{
+	unsigned char *input;
+	unsigned char *output;
+	unsigned long numBlocks;
+
+	input = ((unsigned char *)(ArrayToBuffer(inBuffer))) + inOffset;
+	output = ((unsigned char *)(ArrayToBuffer(outBuffer))) + outOffset;
+	numBlocks = (unsigned long)(count / context->blockSize);
+	if(cryptBlocks)
+	{
+		/* The algorithm can pipeline several blocks at once */
+		(*cryptBlocks)(&(((RC2Context *)context)->rc2),
+					   input, output, numBlocks);
+		return;
+	}
+	while(numBlocks > 0)
+	{
+		(*crypt)(&(((RC2Context *)context)->rc2), input, output);
+		input += context->blockSize;
+		output += context->blockSize;
+		--numBlocks;
+	}
+}
+
+/*
+ * public static void EncryptBlocks(IntPtr state, byte[] inBuffer,
+ *									int inOffset, byte[] outBuffer,
+ *									int outOffset, int count);
+ */
+void _IL_CryptoMethods_EncryptBlocks(ILExecThread *_thread,
+									 ILNativeInt state, System_Array *inBuffer,
+									 ILInt32 inOffset, System_Array *outBuffer,
+									 ILInt32 outOffset, ILInt32 count)
+{
+	if(state)
+	{
+		CryptBlocks((SymContext *)state, ((SymContext *)state)->encrypt,
+					((SymContext *)state)->encryptBlocks, inBuffer,
+					inOffset, outBuffer, outOffset, count);
+	}
+}
+
+/*
+ * public static void DecryptBlocks(IntPtr state, byte[] inBuffer,
+ *									int inOffset, byte[] outBuffer,
+ *									int outOffset, int count);
+ */
+void _IL_CryptoMethods_DecryptBlocks(ILExecThread *_thread,
+									 ILNativeInt state, System_Array *inBuffer,
+									 ILInt32 inOffset, System_Array *outBuffer,
+									 ILInt32 outOffset, ILInt32 count)
+{
+	if(state)
+	{
+		CryptBlocks((SymContext *)state, ((SymContext *)state)->decrypt,
+					((SymContext *)state)->decryptBlocks, inBuffer,
+					inOffset, outBuffer, outOffset, count);
+	}
+}
+
 /*
  * public static void SymmetricFree(IntPtr state);
  */
@@ -112,11 +112,17 @@ extern	"C" {
 	#define IL_OBJECT_HEADER_PTR_MAP		(0)
 
 	/*
-	 * Gets a pointer to the WaitHandle object used by the object.
+	 * Compare and exchange the LockWord for the object.
 	 */
 	ILLockWord CompareAndExchangeObjectLockWord
 		(ILExecThread *thread, ILObject *obj, ILLockWord value, ILLockWord comparand);
 
+	/*
+	 * Gets a pointer to the LockWord for the object.  The pointer stays
+	 * valid for as long as the object is alive.
+	 */
+	ILLockWord *GetObjectLockWordPtr(ILExecThread *thread, ILObject *obj);
+
 	/*
 	 *	Gets the LockWord for the object.
 	 */
@@ -343,6 +349,15 @@ ILObject *_ILClrToObject(ILExecThread *thread, void *item, const char *name);
  */
 void *_ILClrFromObject(ILExecThread *thread, ILObject *object);
 
+/*
+ * Invoke a method via reflection, marshalling the arguments and return
+ * value by walking the signature.  "MethodInfo.Invoke" only does this
+ * if the arguments don't suit the invoke stub for the signature.
+ */
+ILObject *_ILInvokeMethodGeneric(ILExecThread *thread, ILMethod *method,
+								 ILType *signature, ILObject *_this,
+								 System_Array *parameters, int isCtor);
+
 /*
  * Throw a "NotSupportedException" from within the reflection code.
  */
@@ -395,6 +410,29 @@ typedef struct
 
 } PackedStackFrame;
 
+/*
+ * Get the array class for "System.Diagnostics.PackedStackFrame",
+ * which is looked up once per process.  Returns NULL if not found.
+ */
+ILClass *_ILGetPackedStackFrameClass(ILExecThread *thread);
+
+/*
+ * Find the entry in a thread's stack trace offset cache that a
+ * return address maps to.  Returns NULL if out of memory.
+ */
+ILTraceOffset *_ILTraceOffsetEntry(ILExecThread *thread, void *pc);
+
+#if defined(IL_USE_CVM) && defined(IL_CONFIG_DEBUG_LINES)
+
+/*
+ * Fill in the packed stack frames for the "num" innermost
+ * call frames of the current thread.
+ */
+void _ILFillPackedStackFrames(ILExecThread *thread, PackedStackFrame *data,
+							  ILInt32 num);
+
+#endif
+
 /*
  * Structure of the ECMA part of the "System.Exception" class.
  */
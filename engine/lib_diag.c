@@ -26,6 +26,36 @@
 extern	"C" {
 #endif
 
+ILClass *_ILGetPackedStackFrameClass(ILExecThread *thread)
+{
+	ILExecProcess *process = thread->process;
+	ILClass *classInfo = process->packedStackFrameClass;
+	if(!classInfo)
+	{
+		/* Racing threads will find the same class, so no lock is needed */
+		classInfo = ILExecThreadLookupClass
+			(thread, "[vSystem.Diagnostics.PackedStackFrame;");
+		process->packedStackFrameClass = classInfo;
+	}
+	return classInfo;
+}
+
+ILTraceOffset *_ILTraceOffsetEntry(ILExecThread *thread, void *pc)
+{
+	ILNativeUInt hash = (ILNativeUInt)pc;
+	if(!(thread->traceOffsets))
+	{
+		thread->traceOffsets = (ILTraceOffset *)ILCalloc
+			(IL_TRACE_OFFSET_CACHE_SIZE, sizeof(ILTraceOffset));
+		if(!(thread->traceOffsets))
+		{
+			return 0;
+		}
+	}
+	hash ^= (hash >> 7);
+	return &(thread->traceOffsets[hash & (IL_TRACE_OFFSET_CACHE_SIZE - 1)]);
+}
+
 #ifdef IL_CONFIG_DEBUG_LINES
 
 int ILExecProcessDebugHook(ILExecProcess *process,
@@ -418,6 +448,69 @@ ILString *_IL_StackFrame_InternalGetDebugInfo
 	return ILStringCreate(thread, filename);
 }
 
+#ifdef IL_USE_CVM
+
+void _ILFillPackedStackFrames(ILExecThread *thread, PackedStackFrame *data,
+							  ILInt32 num)
+{
+	ILCallFrame *frame;
+	ILTraceOffset *entry;
+	unsigned char *start;
+
+	frame = _ILGetCallFrame(thread, 0);
+	while(frame != 0 && num > 0)
+	{
+		data->method = frame->method;
+		if(frame->method && frame->pc != IL_INVALID_PC)
+		{
+			/* Find the start of the frame method */
+			start = (unsigned char *)ILMethodGetUserData(frame->method);
+			if(ILMethodIsConstructor(frame->method))
+			{
+				start -= ILCoderCtorOffset(thread->process->coder);
+			}
+
+			/* Get the native offset from the method start */
+			data->nativeOffset = (ILInt32)(frame->pc - start);
+
+			/* Get the IL offset from the coder.  We use the native
+			   offset minus 1 because we want the IL offset for the
+			   instruction just before the return address, not after.
+			   Searching the coder's debug information is expensive,
+			   so remember the offset in case we see the call again */
+			entry = _ILTraceOffsetEntry(thread, frame->pc);
+			if(entry && entry->pc == (void *)(frame->pc) &&
+			   entry->start == (void *)start)
+			{
+				data->offset = entry->offset;
+			}
+			else
+			{
+				data->offset = (ILInt32)ILCoderGetILOffset
+					(thread->process->coder, (void *)start,
+					 (ILUInt32)(data->nativeOffset - 1), 0);
+				if(entry)
+				{
+					entry->start = (void *)start;
+					entry->pc = (void *)(frame->pc);
+					entry->offset = data->offset;
+				}
+			}
+		}
+		else
+		{
+			/* Probably a native method that does not have offsets */
+			data->offset = -1;
+			data->nativeOffset = -1;
+		}
+		++data;
+		frame = _ILGetNextCallFrame(thread, frame);
+		--num;
+	}
+}
+
+#endif /* IL_USE_CVM */
+
 /*
  * internal static PackedStackFrame[] GetExceptionStackTrace();
  */
@@ -428,8 +521,6 @@ System_Array *_IL_StackFrame_GetExceptionStackTrace(ILExecThread *thread)
 	ILInt32 num;
 	ILCallFrame *frame;
 	ILObject *array;
-	PackedStackFrame *data;
-	unsigned char *start;
 	ILClass *classInfo;
 
 	/* Get the number of frames on the stack, and also determine
@@ -453,8 +544,7 @@ System_Array *_IL_StackFrame_GetExceptionStackTrace(ILExecThread *thread)
 	   use "ILExecThreadNew" because it will re-enter the engine.
 	   If we are throwing "StackOverflowException", then we will
 	   get an infinite recursive loop */
-	classInfo = ILExecThreadLookupClass
-			(thread, "[vSystem.Diagnostics.PackedStackFrame;");
+	classInfo = _ILGetPackedStackFrameClass(thread);
 	if(!classInfo)
 	{
 		ILExecThreadThrowOutOfMemory(thread);
@@ -470,40 +560,8 @@ System_Array *_IL_StackFrame_GetExceptionStackTrace(ILExecThread *thread)
 	ArrayLength(array) = num;
 
 	/* Fill the array with the packed stack data */
-	data = (PackedStackFrame *)ArrayToBuffer(array);
-	frame = _ILGetCallFrame(thread, 0);
-	while(frame != 0 && num > 0)
-	{
-		data->method = frame->method;
-		if(frame->method && frame->pc != IL_INVALID_PC)
-		{
-			/* Find the start of the frame method */
-			start = (unsigned char *)ILMethodGetUserData(frame->method);
-			if(ILMethodIsConstructor(frame->method))
-			{
-				start -= ILCoderCtorOffset(thread->process->coder);
-			}
-
-			/* Get the native offset from the method start */
-			data->nativeOffset = (ILInt32)(frame->pc - start);
-
-			/* Get the IL offset from the coder.  We use the native
-			   offset minus 1 because we want the IL offset for the
-			   instruction just before the return address, not after */
-			data->offset = (ILInt32)ILCoderGetILOffset
-				(thread->process->coder, (void *)start,
-				 (ILUInt32)(data->nativeOffset - 1), 0);
-		}
-		else
-		{
-			/* Probably a native method that does not have offsets */
-			data->offset = -1;
-			data->nativeOffset = -1;
-		}
-		++data;
-		frame = _ILGetNextCallFrame(thread, frame);
-		--num;
-	}
+	_ILFillPackedStackFrames
+		(thread, (PackedStackFrame *)ArrayToBuffer(array), num);
 
 	/* Done */
 	return (System_Array *)array;
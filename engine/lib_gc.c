@@ -21,6 +21,7 @@
 
 #include "engine_private.h"
 #include "lib_defs.h"
+#include "interlocked.h"
 
 #ifdef	__cplusplus
 extern	"C" {
@@ -111,109 +112,372 @@ ILInt64 _IL_GC_GetTotalMemoryInternal(ILExecThread *_thread,
 #define	GCHandleType_Normal					2
 #define	GCHandleType_Pinned					3
 
+/*
+ * Regular and weak handles are kept in separate lists, because the
+ * slots for weak handles must not be scanned by the garbage collector.
+ * Handles are encoded as "((index + 1) << 2) | type".
+ */
+#define	GCHandleList_Regular				0
+#define	GCHandleList_Weak					1
+#define	GCHandleListOf(type)	\
+			(((type) & 2) ? GCHandleList_Regular : GCHandleList_Weak)
+
+/*
+ * The slots of a handle list are stored in segments that double in
+ * size, starting at "IL_GC_HANDLE_SEGMENT_SIZE" slots.  Segments never
+ * move once they have been allocated, so slots can be read without
+ * taking a lock and weak slots stay registered with the collector
+ * while the list grows.  The number of segments limits the handle
+ * index so that encoded handles fit into an ILInt32.
+ */
+#define	IL_GC_HANDLE_SEGMENT_SHIFT			6
+#define	IL_GC_HANDLE_SEGMENT_SIZE			(1 << IL_GC_HANDLE_SEGMENT_SHIFT)
+#define	IL_GC_HANDLE_NUM_SEGMENTS			23
+
+/*
+ * Free slots hold the index + 1 of the next slot in the free list,
+ * shifted up and tagged with the low bit, which can never be set in
+ * the GC base of an object.
+ */
+#define	GCHandleSlotIsFree(ptr)		(((ILNativeUInt)(ptr)) & 1)
+#define	GCHandleFreeSlot(next)	\
+			((void *)(ILNativeUInt)((((ILNativeUInt)(next)) << 1) | 1))
+#define	GCHandleFreeSlotNext(ptr)	((ILInt32)(((ILNativeUInt)(ptr)) >> 1))
+
+/*
+ * Structure of a list of GC handles.
+ */
+typedef struct _tagILGCHandleList
+{
+	/* Segments of the list, indexed by size */
+	void * volatile *segments[IL_GC_HANDLE_NUM_SEGMENTS];
+
+	/* Number of slots that have been handed out so far */
+	volatile ILInt32 numHandles;
+
+	/* Index + 1 of the first slot in the free list, or zero */
+	ILInt32 freeList;
+
+} ILGCHandleList;
+
 /*
  * Structure of the GC handle table.
  */
 typedef struct _tagILGCHandleTable
 {
-	/* Lock to serialize access to this object */
+	/* Lock to serialize changes to the free lists, the growth of the
+	   lists, and changes to weak slots */
 	ILMutex        *lock;
 
-	void **regularHandles;
-	ILInt32 numRegularHandles;
-	void **weakHandles;
-	ILInt32 numWeakHandles;
+	/* Lists of regular and weak handles */
+	ILGCHandleList	lists[2];
 
 } ILGCHandleTable;
 
-static void _ILGCHandleTableInit(ILGCHandleTable *table)
+/*
+ * Get the segment number and the offset within the segment of a slot.
+ */
+static IL_INLINE int GCHandleSegment(ILInt32 index, ILInt32 *offset)
 {
-	/* Initialize all members even if that might be not needed. */
-	table->regularHandles = 0;
-	table->numRegularHandles = 0;
-	table->weakHandles = 0;
-	table->numWeakHandles = 0;
-
-	/* Initialize the object lock */
-	table->lock = ILMutexCreate();
+	ILUInt32 posn = ((ILUInt32)index) + IL_GC_HANDLE_SEGMENT_SIZE;
+	int segment;
+#if defined(__GNUC__)
+	segment = (31 - __builtin_clz(posn)) - IL_GC_HANDLE_SEGMENT_SHIFT;
+#else
+	segment = 0;
+	while((posn >> (segment + IL_GC_HANDLE_SEGMENT_SHIFT)) > 1)
+	{
+		++segment;
+	}
+#endif
+	*offset = (ILInt32)(posn - (IL_GC_HANDLE_SEGMENT_SIZE << segment));
+	return segment;
 }
 
 /*
- * Get the GC handle table and lock it down.
+ * Get the address of the slot for an index in a handle list.
+ * Returns NULL if the slot's segment has not been allocated yet.
+ * Segments are filled with free slots before they are published,
+ * so slots that have not been handed out yet look like free ones.
+ */
+static IL_INLINE void * volatile *GCHandleSlot(ILGCHandleList *list,
+											   ILInt32 index)
+{
+	void * volatile *segment;
+	ILInt32 offset;
+	int segNum;
+
+	if(index < 0)
+	{
+		return 0;
+	}
+	segNum = GCHandleSegment(index, &offset);
+	if(segNum >= IL_GC_HANDLE_NUM_SEGMENTS)
+	{
+		return 0;
+	}
+	segment = (void * volatile *)ILInterlockedLoadP
+		((void **)&(list->segments[segNum]));
+	if(!segment)
+	{
+		return 0;
+	}
+	return segment + offset;
+}
+
+/*
+ * Get the GC handle table, creating it if necessary.
  */
 static ILGCHandleTable *GetGCHandleTable(ILExecThread *_thread)
 {
 	ILExecProcess *process = _thread->process;
+	ILGCHandleTable *gcHandles;
+
+	gcHandles = (ILGCHandleTable *)ILInterlockedLoadP
+		((void **)&(process->gcHandles));
+	if(gcHandles)
+	{
+		return gcHandles;
+	}
+	ILMutexLock(process->lock);
+	/* Check again because of race conditions. */
 	if(!(process->gcHandles))
 	{
-		ILMutexLock(process->lock);
-		/* Check again because of race conditions. */
-		if(!(process->gcHandles))
+		/* Disable finalizers here because we hold the process lock.
+		 * Otherwise we might get a deadlock if finalizers are invoked
+		 * the first time and the finalizer thread is created.
+		 */
+		ILGCDisableFinalizers(-1);
+		gcHandles = (ILGCHandleTable *)
+			ILGCAllocPersistent(sizeof(ILGCHandleTable));
+		ILGCEnableFinalizers();
+		if(!gcHandles)
 		{
-			ILGCHandleTable *gcHandles;
-
-			/* Disable finalizers here because we hold the process lock.
-			 * Otherwise we might get a deadlock if finalizers are invoked
-			 * the first time and the finalizer thread is created.
-			 */
-			ILGCDisableFinalizers(-1);
-			gcHandles = (ILGCHandleTable *)
-				ILGCAllocPersistent(sizeof(ILGCHandleTable));
-			ILGCEnableFinalizers();
-			if(!gcHandles)
+			/* The table could not be allocated so bail out */
+			ILMutexUnlock(process->lock);
+			return 0;
+		}
+		if((gcHandles->lock = ILMutexCreate()) == 0)
+		{
+			ILGCFreePersistent(gcHandles);
+			ILMutexUnlock(process->lock);
+			return 0;
+		}
+		ILInterlockedStoreP_Release((void **)&(process->gcHandles), gcHandles);
+	}
+	gcHandles = process->gcHandles;
+	ILMutexUnlock(process->lock);
+	return gcHandles;
+}
+
+/*
+ * Look up the slot for a handle.  Returns NULL if the handle is invalid.
+ * This never creates the GC handle table, because there cannot be any
+ * valid handles without one.
+ */
+static void * volatile *LookupGCHandle(ILExecThread *_thread, ILInt32 handle,
+									   ILGCHandleTable **table)
+{
+	*table = (ILGCHandleTable *)ILInterlockedLoadP
+		((void **)&(_thread->process->gcHandles));
+	if(!(*table))
+	{
+		return 0;
+	}
+	return GCHandleSlot(&((*table)->lists[GCHandleListOf(handle & 3)]),
+						(handle >> 2) - 1);
+}
+
+/*
+ * Allocate a segment of a handle list.  Weak slots are allocated
+ * atomically so that the collector does not see the references in them.
+ */
+static void * volatile *AllocGCHandleSegment(int listNum, int segNum)
+{
+	ILInt32 numSlots = (IL_GC_HANDLE_SEGMENT_SIZE << segNum);
+	void * volatile *segment;
+	ILInt32 offset;
+
+	if(listNum == GCHandleList_Weak)
+	{
+		segment = (void * volatile *)ILGCAllocAtomic
+			(numSlots * sizeof(void *));
+	}
+	else
+	{
+		segment = (void * volatile *)ILGCAllocPersistent
+			(numSlots * sizeof(void *));
+	}
+	if(segment)
+	{
+		for(offset = 0; offset < numSlots; ++offset)
+		{
+			segment[offset] = GCHandleFreeSlot(0);
+		}
+	}
+	return segment;
+}
+
+/*
+ * Free a segment of a handle list.  Weak segments are left to
+ * the garbage collector.
+ */
+static void FreeGCHandleSegment(int listNum, void * volatile *segment)
+{
+	if(listNum != GCHandleList_Weak)
+	{
+		ILGCFreePersistent((void *)segment);
+	}
+}
+
+/*
+ * Move free slots from the handle table into the calling thread's
+ * cache, which must be empty.  New slots are handed out when the
+ * free list of the table runs dry.  Returns zero if out of memory.
+ */
+static int FillGCHandleCache(ILExecThread *_thread, ILGCHandleTable *table,
+							 int listNum)
+{
+	ILGCHandleList *list = &(table->lists[listNum]);
+	ILInt32 *cache = _thread->gcHandleCache[listNum];
+	void * volatile *segment;
+	ILInt32 numHandles;
+	ILInt32 index;
+	ILInt32 offset;
+	int segNum;
+	int count = 0;
+
+	ILMutexLock(table->lock);
+	while(count < IL_GC_HANDLE_CACHE_SIZE / 2)
+	{
+		if(list->freeList)
+		{
+			/* Reuse a slot that was freed by this or another thread */
+			index = list->freeList - 1;
+			list->freeList = GCHandleFreeSlotNext
+				(list->segments[GCHandleSegment(index, &offset)][offset]);
+		}
+		else
+		{
+			/* Hand out a new slot, allocating its segment if necessary */
+			numHandles = list->numHandles;
+			segNum = GCHandleSegment(numHandles, &offset);
+			if(segNum >= IL_GC_HANDLE_NUM_SEGMENTS)
 			{
-				/* The table could not be allocated so bail out */
-				ILMutexUnlock(process->lock);
-				return 0;
+				break;
 			}
-			_ILGCHandleTableInit(gcHandles);
-			process->gcHandles = gcHandles;
+			if(!(list->segments[segNum]))
+			{
+				/* Allocate the segment without holding the lock */
+				ILMutexUnlock(table->lock);
+				segment = AllocGCHandleSegment(listNum, segNum);
+				ILMutexLock(table->lock);
+				if(!segment)
+				{
+					break;
+				}
+				if(list->segments[segNum])
+				{
+					/* Another thread allocated the segment first */
+					FreeGCHandleSegment(listNum, segment);
+					continue;
+				}
+				ILInterlockedStoreP_Release
+					((void **)&(list->segments[segNum]), (void *)segment);
+			}
+			index = numHandles;
+			ILInterlockedStoreI4(&(list->numHandles), numHandles + 1);
 		}
-		ILMutexUnlock(process->lock);
+		cache[count++] = index;
 	}
-	ILMutexLock(process->gcHandles->lock);
-	return process->gcHandles;
+	ILMutexUnlock(table->lock);
+	_thread->gcHandleCacheCount[listNum] = count;
+	return (count != 0);
 }
 
 /*
- * Unlock the GC handle table.
+ * Return the oldest "count" slots in a thread's cache to the free
+ * list of the handle table.
  */
-static void UnlockGCHandleTable(ILGCHandleTable *table)
+static void DrainGCHandleCache(ILExecThread *_thread, ILGCHandleTable *table,
+							   int listNum, int count)
 {
+	ILGCHandleList *list = &(table->lists[listNum]);
+	ILInt32 *cache = _thread->gcHandleCache[listNum];
+	int left = _thread->gcHandleCacheCount[listNum] - count;
+	ILInt32 index;
+	ILInt32 offset;
+	int posn;
+
+	ILMutexLock(table->lock);
+	for(posn = 0; posn < count; ++posn)
+	{
+		index = cache[posn];
+		list->segments[GCHandleSegment(index, &offset)][offset] =
+			GCHandleFreeSlot(list->freeList);
+		list->freeList = index + 1;
+	}
 	ILMutexUnlock(table->lock);
+	ILMemMove(cache, cache + count, left * sizeof(ILInt32));
+	_thread->gcHandleCacheCount[listNum] = left;
+}
+
+void _ILGCHandleCacheFlush(ILExecThread *thread)
+{
+	ILGCHandleTable *table = thread->process->gcHandles;
+	int listNum;
+
+	for(listNum = 0; listNum < 2; ++listNum)
+	{
+		if(!table)
+		{
+			thread->gcHandleCacheCount[listNum] = 0;
+		}
+		else if(thread->gcHandleCacheCount[listNum] > 0)
+		{
+			DrainGCHandleCache(thread, table, listNum,
+							   thread->gcHandleCacheCount[listNum]);
+		}
+	}
+}
+
+/*
+ * Put a slot that has just been freed into the calling thread's cache.
+ */
+static void CacheGCHandleSlot(ILExecThread *_thread, ILGCHandleTable *table,
+							  int listNum, ILInt32 index)
+{
+	if(_thread->gcHandleCacheCount[listNum] >= IL_GC_HANDLE_CACHE_SIZE)
+	{
+		DrainGCHandleCache(_thread, table, listNum,
+						   IL_GC_HANDLE_CACHE_SIZE / 2);
+	}
+	_thread->gcHandleCache[listNum][(_thread->gcHandleCacheCount[listNum])++]
+		= index;
 }
 
 ILNativeInt _IL_GCHandle_GCAddrOfPinnedObject(ILExecThread *_thread,
 											  ILInt32 handle)
 {
 	ILGCHandleTable *table;
+	void * volatile *slot;
 	void *ptr;
 	ILObject *object = 0;
 
-	/* Get the handle table and look up the handle.  We assume that
-	   the caller has already checked that the handle is pinned */
-	handle >>= 2;
-	table = GetGCHandleTable(_thread);
-	if(table)
+	/* Look up the handle.  We assume that the caller has
+	   already checked that the handle is pinned */
+	slot = LookupGCHandle(_thread, handle, &table);
+	if(slot)
 	{
-		if(handle > 0 && handle <= table->numRegularHandles)
+		ptr = *slot;
+		if(ptr && !GCHandleSlotIsFree(ptr))
 		{
-			ptr = table->regularHandles[handle - 1];
-			if(ptr == ((void *)(ILNativeInt)(-1)) || !ptr)
+			object = GetObjectFromGcBase(ptr);
+			if(_ILIsSArray((System_Array *)object))
 			{
-				object = 0;
-			}
-			else
-			{
-				object = GetObjectFromGcBase(ptr);
-				if(_ILIsSArray((System_Array *)object))
-				{
-					object = ((void *)(((System_Array *)(object)) + 1));
-				}
+				object = ((void *)(((System_Array *)(object)) + 1));
 			}
 		}
-		/* Unlock the handle table */
-		UnlockGCHandleTable(table);
 	}
 
 	/* None of the objects in our implementation move about
@@ -225,10 +489,11 @@ ILInt32 _IL_GCHandle_GCAlloc(ILExecThread *_thread, ILObject *value,
 							 ILInt32 type)
 {
 	ILGCHandleTable *table;
+	void * volatile *slot;
 	void *ptr;
-	ILInt32 handle = 0;
-	void **newArray;
+	int listNum = GCHandleListOf(type);
 	ILInt32 index;
+	ILInt32 offset;
 
 	/* Convert the object into a pointer to the object's GC base */
 	if(value)
@@ -242,243 +507,122 @@ ILInt32 _IL_GCHandle_GCAlloc(ILExecThread *_thread, ILObject *value,
 
 	/* Get the GC handle table */
 	table = GetGCHandleTable(_thread);
-	if(table)
+	if(!table)
 	{
-		/* Allocate a new handle slot */
-		switch(type)
-		{
-			case GCHandleType_Weak:
-			case GCHandleType_WeakTrackResurrection:
-			{
-				for( index = 0; index < table->numWeakHandles; index++ ) {
-					if(table->weakHandles[index] == (void *)(ILNativeInt)(-1)) {
-						table->weakHandles[index] = ptr;
-						if( 0 != table->weakHandles[index] ) {
-							ILGCRegisterGeneralWeak(&(table->weakHandles[index]), table->weakHandles[index] );
-						}
-						handle = (((++(index)) << 2) | type);
-						break;
-					}
-				}
-				if( handle != 0 ) break;
-				
-				if((table->numWeakHandles & 7) == 0)
-				{
-					/* Extend the size of the weak handle table */
-					/* for weak refs, do use AllocAtomic so that the ref will
-					 * not be scanned.by the gc during collection.
- 					 */
-					newArray = (void **)ILGCAllocAtomic
-						((table->numWeakHandles + 8) * sizeof(void *));
-					if(!newArray)
-					{
-						ILExecThreadThrowOutOfMemory(_thread);
-						break;
-					}
-					if(table->weakHandles != 0)
-					{
-						for(index = 0; index < table->numWeakHandles; ++index)
-						{
-							newArray[index] = table->weakHandles[index];
-							if(table->weakHandles[index] !=
-									(void *)(ILNativeInt)(-1))
-							{
-								/* use RegisterGeneralWeak to monitor 
-								 * disappearing links
-								 */
-								if( 0 != table->weakHandles[index] ) {
-									ILGCUnregisterWeak(&(table->weakHandles[index]));
-								}
-								if( 0 != newArray[index] ) {
-									ILGCRegisterGeneralWeak(&(newArray[index]), newArray[index] ); 
-								}
-							}
-						}
-						ILGCFreePersistent(table->weakHandles);
-					}
-					table->weakHandles = newArray;
-				}
-				table->weakHandles[table->numWeakHandles] = ptr;
-				
-				if( 0 != table->weakHandles[table->numWeakHandles] ) {
-					ILGCRegisterGeneralWeak(&(table->weakHandles[table->numWeakHandles]), table->weakHandles[table->numWeakHandles] );
-				}
-				handle = (((++(table->numWeakHandles)) << 2) | type);
-			}
-			break;
-
-			case GCHandleType_Normal:
-			case GCHandleType_Pinned:
-			{
-				for( index = 0; index < table->numRegularHandles; index++ ) {
-					if(table->regularHandles[index] == (void *)(ILNativeInt)(-1)) {
-						table->regularHandles[index] = ptr;
-						handle = (((++(index)) << 2) | type);
-						break;
-					}
-				}
-				if( handle != 0 ) break;
-				
-				if((table->numRegularHandles & 7) == 0)
-				{
-					/* Extend the size of the regular handle table */
-					newArray = (void **)ILGCAllocPersistent
-						((table->numRegularHandles + 8) * sizeof(void *));
-					if(!newArray)
-					{
-						ILExecThreadThrowOutOfMemory(_thread);
-						break;
-					}
-					if(table->regularHandles != 0)
-					{
-						ILMemCpy(newArray, table->regularHandles,
-								 table->numRegularHandles * sizeof(void *));
-						ILGCFreePersistent(table->regularHandles);
-					}
-					table->regularHandles = newArray;
-				}
-				table->regularHandles[table->numRegularHandles] = ptr;
-				handle = (((++(table->numRegularHandles)) << 2) | type);
-			}
-			break;
-		}
-		/* Unlock the GC handle table and return */
-		UnlockGCHandleTable(table);
+		ILExecThreadThrowOutOfMemory(_thread);
+		return 0;
 	}
 
-	return handle;
+	/* Take a free slot from the thread's cache, refilling it if necessary */
+	if(_thread->gcHandleCacheCount[listNum] == 0 &&
+	   !FillGCHandleCache(_thread, table, listNum))
+	{
+		ILExecThreadThrowOutOfMemory(_thread);
+		return 0;
+	}
+	index = _thread->gcHandleCache[listNum]
+				[--(_thread->gcHandleCacheCount[listNum])];
+
+	/* Nobody else can see the slot until we return the handle,
+	   so it can be filled in without locking the table */
+	slot = table->lists[listNum].segments[GCHandleSegment(index, &offset)]
+				+ offset;
+	*slot = ptr;
+	if(listNum == GCHandleList_Weak && ptr)
+	{
+		/* use RegisterGeneralWeak to monitor disappearing links */
+		ILGCRegisterGeneralWeak((void *)slot, ptr);
+	}
+	return (((index + 1) << 2) | type);
 }
 
 void _IL_GCHandle_GCFree(ILExecThread *_thread, ILInt32 handle)
 {
 	ILGCHandleTable *table;
-	ILInt32 index = (handle >> 2);
+	void * volatile *slot;
+	void *ptr;
 
-	/* Get the GC handle table */
-	table = GetGCHandleTable(_thread);
-	if(table)
+	slot = LookupGCHandle(_thread, handle, &table);
+	if(!slot)
 	{
-		switch(handle & 3)
+		return;
+	}
+	if(GCHandleListOf(handle & 3) == GCHandleList_Weak)
+	{
+		/* Weak slots are freed with the table locked so that a
+		   concurrent "SetTarget" cannot leave a link registered */
+		ILMutexLock(table->lock);
+		ptr = *slot;
+		if(!GCHandleSlotIsFree(ptr))
 		{
-			case GCHandleType_Weak:
-			case GCHandleType_WeakTrackResurrection:
-			{
-				if(index > 0 && index <= table->numWeakHandles)
-				{
-					--index;
-					if(table->weakHandles[index] != (void *)(ILNativeInt)(-1))
-					{
-						ILGCUnregisterWeak(&(table->weakHandles[index]));
-						table->weakHandles[index] = (void *)(ILNativeInt)(-1);
-					}
-				}
-			}
-			break;
-
-			case GCHandleType_Normal:
-			case GCHandleType_Pinned:
+			ILGCUnregisterWeak((void *)slot);
+			*slot = GCHandleFreeSlot(0);
+		}
+		ILMutexUnlock(table->lock);
+		if(GCHandleSlotIsFree(ptr))
+		{
+			return;
+		}
+	}
+	else
+	{
+		/* Mark the slot as free, unless another thread beat us to it */
+		do
+		{
+			ptr = *slot;
+			if(GCHandleSlotIsFree(ptr))
 			{
-				if(index > 0 && index <= table->numRegularHandles)
-				{
-					table->regularHandles[index - 1]
-						= (void *)(ILNativeInt)(-1);
-				}
+				return;
 			}
-			break;
 		}
-		/* Unlock the GC handle table and return */
-		UnlockGCHandleTable(table);
+		while(ILInterlockedCompareAndExchangeP
+					((void **)slot, GCHandleFreeSlot(0), ptr) != ptr);
 	}
+	CacheGCHandleSlot(_thread, table, GCHandleListOf(handle & 3),
+					  (handle >> 2) - 1);
 }
 
 ILBool _IL_GCHandle_GCValidate(ILExecThread *_thread, ILInt32 handle)
 {
 	ILGCHandleTable *table;
-	ILBool valid = 0;
-	ILInt32 index = (handle >> 2);
+	ILInt32 numHandles;
 
-	/* Get the GC handle table */
-	table = GetGCHandleTable(_thread);
-	if(table)
+	/* The handle is valid if its slot has been handed out at some point */
+	if(!LookupGCHandle(_thread, handle, &table))
 	{
-		switch(handle & 3)
-		{
-			case GCHandleType_Weak:
-			case GCHandleType_WeakTrackResurrection:
-			{
-				valid = (index > 0 && index <= table->numWeakHandles);
-			}
-			break;
-
-			case GCHandleType_Normal:
-			case GCHandleType_Pinned:
-			{
-				valid = (index > 0 && index <= table->numRegularHandles);
-			}
-			break;
-		}
-		/* Unlock the handle table and return */
-		UnlockGCHandleTable(table);
+		return 0;
 	}
-
-	return valid;
+	numHandles = ILInterlockedLoadI4
+		(&(table->lists[GCHandleListOf(handle & 3)].numHandles));
+	return ((handle >> 2) <= numHandles);
 }
 
 ILObject *_IL_GCHandle_GCGetTarget(ILExecThread *_thread, ILInt32 handle)
 {
 	ILGCHandleTable *table;
+	void * volatile *slot;
 	void *ptr;
-	ILObject *object = 0;
-	ILInt32 index = (handle >> 2);
 
-	/* Get the handle table and look up the handle */
-	table = GetGCHandleTable(_thread);
-	if(table)
+	/* Look up the handle without locking the table */
+	slot = LookupGCHandle(_thread, handle, &table);
+	if(slot)
 	{
-		ptr = 0;
-		switch(handle & 3)
-		{
-			case GCHandleType_Weak:
-			case GCHandleType_WeakTrackResurrection:
-			{
-				if(index > 0 && index <= table->numWeakHandles)
-				{
-					ptr = table->weakHandles[index - 1];
-				}
-			}
-			break;
-
-			case GCHandleType_Normal:
-			case GCHandleType_Pinned:
-			{
-				if(index > 0 && index <= table->numRegularHandles)
-				{
-					ptr = table->regularHandles[index - 1];
-				}
-			}
-			break;
-		}
-		if(ptr == ((void *)(ILNativeInt)(-1)) || !ptr)
+		ptr = *slot;
+		if(ptr && !GCHandleSlotIsFree(ptr))
 		{
-			object = 0;
+			return GetObjectFromGcBase(ptr);
 		}
-		else
-		{
-			object = GetObjectFromGcBase(ptr);
-		}
-		/* Unlock the handle table and return */
-		UnlockGCHandleTable(table);
 	}
-
-	return object;
+	return 0;
 }
 
 void _IL_GCHandle_GCSetTarget(ILExecThread *_thread, ILInt32 handle,
 							  ILObject *value)
 {
 	ILGCHandleTable *table;
+	void * volatile *slot;
 	void *ptr;
-	ILInt32 index = (handle >> 2);
+	void *oldPtr;
 
 	/* Convert the object into a pointer to the object's GC base */
 	if(value)
@@ -490,68 +634,72 @@ void _IL_GCHandle_GCSetTarget(ILExecThread *_thread, ILInt32 handle,
 		ptr = 0;
 	}
 
-	/* Get the handle table and look up the handle */
-	table = GetGCHandleTable(_thread);
-	if(table)
+	/* Look up the handle */
+	slot = LookupGCHandle(_thread, handle, &table);
+	if(!slot)
 	{
-		switch(handle & 3)
+		return;
+	}
+	if(GCHandleListOf(handle & 3) == GCHandleList_Weak)
+	{
+		ILMutexLock(table->lock);
+		if(!GCHandleSlotIsFree(*slot))
 		{
-			case GCHandleType_Weak:
-			case GCHandleType_WeakTrackResurrection:
+			/* unregister old Target and Register new target */
+			if(*slot)
 			{
-				if(index > 0 && index <= table->numWeakHandles)
-				{
-					if(table->weakHandles[index - 1] !=
-							(void *)(ILNativeInt)(-1))
-					{
-						/* unregister old Target and Register new target */
-						if( 0 != table->weakHandles[index - 1] )
-						{
-							ILGCUnregisterWeak(&(table->weakHandles[index-1]));
-						}
-						
-						table->weakHandles[index - 1] = ptr;
-						
-						if( 0 != ptr )
-						{
-							ILGCRegisterGeneralWeak(&(table->weakHandles[index-1]), table->weakHandles[index-1] ); 
-						}
-					}
-				}
+				ILGCUnregisterWeak((void *)slot);
 			}
-			break;
-
-			case GCHandleType_Normal:
-			case GCHandleType_Pinned:
+			*slot = ptr;
+			if(ptr)
 			{
-				if(index > 0 && index <= table->numRegularHandles)
-				{
-					if(table->regularHandles[index - 1] !=
-							(void *)(ILNativeInt)(-1))
-					{
-						table->regularHandles[index - 1] = ptr;
-					}
-				}
+				ILGCRegisterGeneralWeak((void *)slot, ptr);
 			}
-			break;
 		}
-		/* Unlock the handle table and return */
-		UnlockGCHandleTable(table);
+		ILMutexUnlock(table->lock);
+	}
+	else
+	{
+		/* Replace the target, unless the handle has been freed */
+		do
+		{
+			oldPtr = *slot;
+			if(GCHandleSlotIsFree(oldPtr))
+			{
+				return;
+			}
+		}
+		while(ILInterlockedCompareAndExchangeP
+					((void **)slot, ptr, oldPtr) != oldPtr);
 	}
 }
 
 void _ILGCHandleTableFree(ILGCHandleTable *table)
 {
-	if(table->regularHandles)
+	ILGCHandleList *list;
+	ILInt32 index;
+	ILInt32 offset;
+	int segNum;
+
+	/* Free the regular segments */
+	list = &(table->lists[GCHandleList_Regular]);
+	for(segNum = 0; segNum < IL_GC_HANDLE_NUM_SEGMENTS; ++segNum)
 	{
-		ILGCFreePersistent(table->regularHandles);
+		if(list->segments[segNum])
+		{
+			FreeGCHandleSegment(GCHandleList_Regular, list->segments[segNum]);
+		}
 	}
-	if(table->weakHandles)
+
+	/* Unregister the weak slots that are still in use.  The weak
+	   segments themselves are reclaimed by the garbage collector */
+	list = &(table->lists[GCHandleList_Weak]);
+	for(index = 0; index < list->numHandles; ++index)
 	{
-		ILInt32 index;
-		for(index = 0; index < table->numWeakHandles; ++index)
+		segNum = GCHandleSegment(index, &offset);
+		if(!GCHandleSlotIsFree(list->segments[segNum][offset]))
 		{
-			ILGCUnregisterWeak(&(table->weakHandles[index]));
+			ILGCUnregisterWeak((void *)&(list->segments[segNum][offset]));
 		}
 	}
 
@@ -69,8 +69,10 @@ extern	"C" {
  * On some platforms, CompareAndExchangeObjectLockWord may use a global lock
  * because it uses ILInterlockedCompareAndExchangePointers which may not be
  * ported to that platform (see support/interlocked.h).  
- * CompareAndExchangeObjectLockWord always uses a global lock if the thin-lock
- * algorithm is used.
+ * If the thin-lock algorithm is used the hashtable is split into stripes
+ * with separate locks.  Only the creation of a new hashtable entry takes
+ * a stripe lock, the lookup of an existing entry and the compare-and-exchange
+ * of its lockword are lock-free.
  *
  * The algorithm ASSUMES ILInterlockedCompareAndExchangePointers acts as a
  * memory barrier.
@@ -22,6 +22,7 @@
 #include "lib_defs.h"
 #include "il_serialize.h"
 #include "il_crypt.h"
+#include "interlocked.h"
 
 #ifdef	__cplusplus
 extern	"C" {
@@ -176,7 +177,8 @@ static ILObject *DeserializeObject(ILExecThread *thread,
 					 * terminated */
 					copyStr=(char*) ILCalloc(strLen+1,sizeof(char));
 					ILMemCpy(copyStr,strValue,strLen);
-					classInfo = ILExecThreadLookupClass(thread,copyStr);
+					classInfo = _ILExecThreadLookupClassUncached
+						(thread, copyStr);
 					ILFree(copyStr);
 					if(!classInfo)
 					{
@@ -240,7 +242,8 @@ static ILObject *DeserializeObject(ILExecThread *thread,
 							 * is NULL terminated */
 							copyStr=(char*) ILCalloc(strLen+1,sizeof(char));
 							ILMemCpy(copyStr,strValue,strLen);
-							classInfo = ILExecThreadLookupClass(thread,copyStr);
+							classInfo = _ILExecThreadLookupClassUncached
+								(thread, copyStr);
 							ILFree(copyStr);
 							if(!classInfo)
 							{
@@ -2759,12 +2762,710 @@ static ILObject* PromoteToFloat(ILExecThread *thread, ILType *paramType,
 	return ILExecThreadBoxFloat(thread, paramType, &nativeValue);
 }
 
+/*
+ * Reflection invoke stubs.  The first time that a method signature is
+ * invoked via reflection, we work out how each argument and the return
+ * value will be marshalled and keep the result in a per-process table.
+ * Later invocations only need to check that each boxed argument has
+ * exactly the expected class before copying it straight onto the CVM
+ * stack, or passing a pointer to it to the JIT.  Anything else, such as
+ * a null value type or an argument that needs to be promoted, is handed
+ * to "InvokeMethod", which will throw the right exception if necessary.
+ */
+#define	IL_INVOKE_STUB_HASH_SIZE	512
+#define	IL_INVOKE_STUB_MAX			8192
+
+/*
+ * Kinds of values that can be marshalled by an invoke stub.
+ */
+#define	IL_INVOKE_VOID				0
+#define	IL_INVOKE_INT8				1	/* int8, bool */
+#define	IL_INVOKE_UINT8				2
+#define	IL_INVOKE_INT16				3
+#define	IL_INVOKE_UINT16			4	/* uint16, char */
+#define	IL_INVOKE_INT32				5	/* int32, uint32 */
+#define	IL_INVOKE_INT64				6	/* int64, uint64 */
+#define	IL_INVOKE_FLOAT32			7
+#define	IL_INVOKE_FLOAT64			8
+#define	IL_INVOKE_NATIVE_FLOAT		9
+#define	IL_INVOKE_VALUE				10	/* other value types */
+#define	IL_INVOKE_OBJECT			11	/* class and array references */
+
+typedef struct
+{
+	int				kind;
+	ILUInt32		size;		/* Size of the value in bytes */
+	ILClass		   *classInfo;	/* Class of boxed values or references */
+	ILType		   *type;		/* Type to check references against */
+	int				anyObject;	/* Reference to "System.Object" */
+
+} ILInvokeValue;
+
+typedef struct _tagILInvokeStub ILInvokeStub;
+struct _tagILInvokeStub
+{
+	ILInvokeStub   *next;
+	ILType		   *signature;
+	int				generic;	/* Always use "InvokeMethod" */
+	ILUInt32		numParams;
+	ILUInt32		stackWords;	/* CVM stack words for the parameters */
+	ILInvokeValue	returnValue;
+	ILInvokeValue	params[1];
+
+};
+
+typedef struct
+{
+	ILInvokeStub * volatile buckets[IL_INVOKE_STUB_HASH_SIZE];
+	volatile ILInt32 numStubs;
+
+} ILInvokeStubTable;
+
+/*
+ * Information that is passed to the pack and unpack functions.
+ */
+typedef struct
+{
+	ILInvokeStub   *stub;
+	ILObject	  **args;
+	ILObject	   *_this;
+
+} ILInvokeCall;
+
+/*
+ * Work out how to marshal a value of a particular type.
+ * Returns zero if the stub cannot handle the type.
+ */
+static int BuildInvokeValue(ILExecThread *thread, ILType *type,
+							ILInvokeValue *value)
+{
+	ILType *enumType = ILTypeGetEnumType(type);
+	ILClass *classInfo;
+
+	value->type = type;
+	value->classInfo = 0;
+	value->anyObject = 0;
+	if(ILType_IsPrimitive(enumType))
+	{
+		switch(ILType_ToElement(enumType))
+		{
+			case IL_META_ELEMTYPE_VOID:
+			{
+				value->kind = IL_INVOKE_VOID;
+				value->size = 0;
+				return 1;
+			}
+			/* Not reached */
+
+			case IL_META_ELEMTYPE_BOOLEAN:
+			case IL_META_ELEMTYPE_I1:
+			{
+				value->kind = IL_INVOKE_INT8;
+				value->size = sizeof(ILInt8);
+			}
+			break;
+
+			case IL_META_ELEMTYPE_U1:
+			{
+				value->kind = IL_INVOKE_UINT8;
+				value->size = sizeof(ILUInt8);
+			}
+			break;
+
+			case IL_META_ELEMTYPE_I2:
+			{
+				value->kind = IL_INVOKE_INT16;
+				value->size = sizeof(ILInt16);
+			}
+			break;
+
+			case IL_META_ELEMTYPE_U2:
+			case IL_META_ELEMTYPE_CHAR:
+			{
+				value->kind = IL_INVOKE_UINT16;
+				value->size = sizeof(ILUInt16);
+			}
+			break;
+
+			case IL_META_ELEMTYPE_I4:
+			case IL_META_ELEMTYPE_U4:
+		#ifdef IL_NATIVE_INT32
+			case IL_META_ELEMTYPE_I:
+			case IL_META_ELEMTYPE_U:
+		#endif
+			{
+				value->kind = IL_INVOKE_INT32;
+				value->size = sizeof(ILInt32);
+			}
+			break;
+
+			case IL_META_ELEMTYPE_I8:
+			case IL_META_ELEMTYPE_U8:
+		#ifdef IL_NATIVE_INT64
+			case IL_META_ELEMTYPE_I:
+			case IL_META_ELEMTYPE_U:
+		#endif
+			{
+				value->kind = IL_INVOKE_INT64;
+				value->size = sizeof(ILInt64);
+			}
+			break;
+
+			case IL_META_ELEMTYPE_R4:
+			{
+				value->kind = IL_INVOKE_FLOAT32;
+				value->size = sizeof(ILFloat);
+			}
+			break;
+
+			case IL_META_ELEMTYPE_R8:
+			{
+				value->kind = IL_INVOKE_FLOAT64;
+				value->size = sizeof(ILDouble);
+			}
+			break;
+
+			case IL_META_ELEMTYPE_R:
+			{
+				value->kind = IL_INVOKE_NATIVE_FLOAT;
+				value->size = sizeof(ILNativeFloat);
+			}
+			break;
+
+			default: return 0;
+		}
+	}
+	else if(ILType_IsValueType(enumType))
+	{
+		value->kind = IL_INVOKE_VALUE;
+		value->size = ILSizeOfType(thread, enumType);
+	}
+	else if(ILType_IsClass(enumType) ||
+			(enumType != 0 && ILType_IsComplex(enumType) &&
+			 (ILType_Kind(enumType) == IL_TYPE_COMPLEX_ARRAY ||
+			  ILType_Kind(enumType) == IL_TYPE_COMPLEX_ARRAY_CONTINUE)))
+	{
+		value->kind = IL_INVOKE_OBJECT;
+		value->size = sizeof(ILObject *);
+		value->anyObject = ILTypeIsObjectClass(type);
+	}
+	else
+	{
+		return 0;
+	}
+
+	/* Find the class that boxed values or references must have */
+	classInfo = ILClassFromType
+		(ILContextNextImage(thread->process->context, 0), 0, type, 0);
+	if(!classInfo)
+	{
+		return 0;
+	}
+	value->classInfo = ILClassResolve(classInfo);
+	return 1;
+}
+
+/*
+ * Get the number of CVM stack words that are used by a value.
+ */
+static ILUInt32 InvokeValueWords(ILInvokeValue *value)
+{
+	switch(value->kind)
+	{
+		case IL_INVOKE_INT64:
+			return CVM_WORDS_PER_LONG;
+
+		case IL_INVOKE_FLOAT32:
+		case IL_INVOKE_FLOAT64:
+		case IL_INVOKE_NATIVE_FLOAT:
+			return CVM_WORDS_PER_NATIVE_FLOAT;
+
+		case IL_INVOKE_VALUE:
+			return (value->size + sizeof(CVMWord) - 1) / sizeof(CVMWord);
+	}
+	return 1;
+}
+
+/*
+ * Build the invoke stub for a method signature.  The stub is
+ * marked as generic if it cannot handle the signature.
+ */
+static ILInvokeStub *BuildInvokeStub(ILExecThread *thread, ILType *signature)
+{
+	ILUInt32 numParams = ILTypeNumParams(signature);
+	ILInvokeStub *stub;
+	ILUInt32 param;
+
+	stub = (ILInvokeStub *)ILMalloc(sizeof(ILInvokeStub) +
+									sizeof(ILInvokeValue) * numParams);
+	if(!stub)
+	{
+		return 0;
+	}
+	stub->next = 0;
+	stub->signature = signature;
+	stub->generic = 0;
+	stub->numParams = numParams;
+	stub->stackWords = 0;
+	if((ILType_CallConv(signature) & IL_META_CALLCONV_MASK) ==
+			IL_META_CALLCONV_VARARG ||
+	   !BuildInvokeValue(thread, ILTypeGetReturn(signature),
+	   					 &(stub->returnValue)))
+	{
+		stub->generic = 1;
+		return stub;
+	}
+	for(param = 0; param < numParams; ++param)
+	{
+		if(!BuildInvokeValue(thread, ILTypeGetParam(signature, param + 1),
+							 &(stub->params[param])) ||
+		   stub->params[param].kind == IL_INVOKE_VOID)
+		{
+			stub->generic = 1;
+			return stub;
+		}
+		stub->stackWords += InvokeValueWords(&(stub->params[param]));
+	}
+	return stub;
+}
+
+/*
+ * Get the invoke stub for a method signature, building it if necessary.
+ * Returns NULL if the signature must be invoked using "InvokeMethod".
+ */
+static ILInvokeStub *GetInvokeStub(ILExecThread *thread, ILType *signature)
+{
+	ILExecProcess *process = thread->process;
+	ILInvokeStubTable *table;
+	ILInvokeStub *stub;
+	ILInvokeStub *head;
+	ILInvokeStub * volatile *bucket;
+
+	/* Look for an existing stub */
+	table = (ILInvokeStubTable *)ILInterlockedLoadP
+		((void **)&(process->invokeStubs));
+	if(!table)
+	{
+		table = (ILInvokeStubTable *)ILCalloc(1, sizeof(ILInvokeStubTable));
+		if(!table)
+		{
+			return 0;
+		}
+		if(ILInterlockedCompareAndExchangeP
+				((void **)&(process->invokeStubs), table, 0) != 0)
+		{
+			/* Another thread created the table first */
+			ILFree(table);
+			table = (ILInvokeStubTable *)(process->invokeStubs);
+		}
+	}
+	bucket = &(table->buckets[(((ILNativeUInt)signature) >> 4) &
+							  (IL_INVOKE_STUB_HASH_SIZE - 1)]);
+	stub = (ILInvokeStub *)ILInterlockedLoadP((void **)bucket);
+	while(stub != 0)
+	{
+		if(stub->signature == signature)
+		{
+			return (stub->generic ? 0 : stub);
+		}
+		stub = stub->next;
+	}
+
+	/* Build a new stub and add it to the table */
+	if(ILInterlockedIncrementI4(&(table->numStubs)) > IL_INVOKE_STUB_MAX)
+	{
+		return 0;
+	}
+	stub = BuildInvokeStub(thread, signature);
+	if(!stub)
+	{
+		return 0;
+	}
+	do
+	{
+		head = *bucket;
+		stub->next = head;
+	}
+	while(ILInterlockedCompareAndExchangeP
+			((void **)bucket, stub, head) != (void *)head);
+	return (stub->generic ? 0 : stub);
+}
+
+#ifdef IL_USE_JIT
+
+/*
+ * Pass pointers to the boxed arguments to the JIT.
+ */
+static int InvokeStubPack(ILExecThread *thread, ILType *signature,
+						  int isCtor, void *_this,
+						  void *argBuffer, void **jitArgs, void *userData)
+{
+	ILInvokeCall *call = (ILInvokeCall *)userData;
+	ILInvokeStub *stub = call->stub;
+	ILUInt32 param;
+
+	if(call->_this)
+	{
+		*jitArgs++ = &(call->_this);
+	}
+	for(param = 0; param < stub->numParams; ++param)
+	{
+		if(stub->params[param].kind == IL_INVOKE_OBJECT)
+		{
+			*jitArgs++ = &(call->args[param]);
+		}
+		else
+		{
+			/* Boxed values have the same layout as the JIT's arguments */
+			*jitArgs++ = (void *)(call->args[param]);
+		}
+	}
+	return 0;
+}
+
+/*
+ * The JIT stores the return value directly.
+ */
+#define	InvokeStubUnpack	_ILCallUnpackDirectResult
+
+#else /* !IL_USE_JIT */
+
+/*
+ * Copy the boxed arguments onto the CVM stack.
+ */
+static int InvokeStubPack(ILExecThread *thread, ILMethod *method,
+						  int isCtor, void *_this, void *userData)
+{
+	ILInvokeCall *call = (ILInvokeCall *)userData;
+	ILInvokeStub *stub = call->stub;
+	CVMWord *stacktop = thread->stackTop;
+	ILInvokeValue *value;
+	ILNativeFloat fValue;
+	void *box;
+	ILUInt32 param;
+
+	if((stacktop + stub->stackWords + 1) > thread->stackLimit)
+	{
+		_ILExecThreadSetException(thread, _ILSystemException
+			(thread, "System.StackOverflowException"));
+		return 1;
+	}
+	if(call->_this)
+	{
+		stacktop->ptrValue = call->_this;
+		++stacktop;
+	}
+	for(param = 0; param < stub->numParams; ++param)
+	{
+		value = &(stub->params[param]);
+		box = (void *)(call->args[param]);
+		switch(value->kind)
+		{
+			case IL_INVOKE_INT8:
+			{
+				stacktop->intValue = *((ILInt8 *)box);
+				++stacktop;
+			}
+			break;
+
+			case IL_INVOKE_UINT8:
+			{
+				stacktop->uintValue = *((ILUInt8 *)box);
+				++stacktop;
+			}
+			break;
+
+			case IL_INVOKE_INT16:
+			{
+				stacktop->intValue = *((ILInt16 *)box);
+				++stacktop;
+			}
+			break;
+
+			case IL_INVOKE_UINT16:
+			{
+				stacktop->uintValue = *((ILUInt16 *)box);
+				++stacktop;
+			}
+			break;
+
+			case IL_INVOKE_INT32:
+			{
+				stacktop->intValue = *((ILInt32 *)box);
+				++stacktop;
+			}
+			break;
+
+			case IL_INVOKE_INT64:
+			{
+				ILMemCpy(stacktop, box, sizeof(ILInt64));
+				stacktop += CVM_WORDS_PER_LONG;
+			}
+			break;
+
+			case IL_INVOKE_FLOAT32:
+			{
+				fValue = (ILNativeFloat)(*((ILFloat *)box));
+				ILMemCpy(stacktop, &fValue, sizeof(ILNativeFloat));
+				stacktop += CVM_WORDS_PER_NATIVE_FLOAT;
+			}
+			break;
+
+			case IL_INVOKE_FLOAT64:
+			{
+				fValue = (ILNativeFloat)(*((ILDouble *)box));
+				ILMemCpy(stacktop, &fValue, sizeof(ILNativeFloat));
+				stacktop += CVM_WORDS_PER_NATIVE_FLOAT;
+			}
+			break;
+
+			case IL_INVOKE_NATIVE_FLOAT:
+			{
+				ILMemCpy(stacktop, box, sizeof(ILNativeFloat));
+				stacktop += CVM_WORDS_PER_NATIVE_FLOAT;
+			}
+			break;
+
+			case IL_INVOKE_VALUE:
+			{
+				ILMemCpy(stacktop, box, value->size);
+				stacktop += InvokeValueWords(value);
+			}
+			break;
+
+			default:
+			{
+				stacktop->ptrValue = box;
+				++stacktop;
+			}
+			break;
+		}
+	}
+	thread->stackTop = stacktop;
+	return 0;
+}
+
+/*
+ * Copy the return value from the CVM stack into its box.
+ */
+static void InvokeStubUnpack(ILExecThread *thread, ILMethod *method,
+							 int isCtor, void *result, void *userData)
+{
+	ILInvokeValue *value = &(((ILInvokeCall *)userData)->stub->returnValue);
+	CVMWord *stacktop = thread->stackTop;
+	ILNativeFloat fValue;
+
+	if(isCtor || value->kind == IL_INVOKE_OBJECT)
+	{
+		*((void **)result) = stacktop[-1].ptrValue;
+		--stacktop;
+	}
+	else if(value->kind == IL_INVOKE_FLOAT32 ||
+			value->kind == IL_INVOKE_FLOAT64 ||
+			value->kind == IL_INVOKE_NATIVE_FLOAT)
+	{
+		stacktop -= CVM_WORDS_PER_NATIVE_FLOAT;
+		ILMemCpy(&fValue, stacktop, sizeof(ILNativeFloat));
+		if(value->kind == IL_INVOKE_FLOAT32)
+		{
+			*((ILFloat *)result) = (ILFloat)fValue;
+		}
+		else if(value->kind == IL_INVOKE_FLOAT64)
+		{
+			*((ILDouble *)result) = (ILDouble)fValue;
+		}
+		else
+		{
+			*((ILNativeFloat *)result) = fValue;
+		}
+	}
+	else if(value->kind == IL_INVOKE_INT8 || value->kind == IL_INVOKE_UINT8)
+	{
+		*((ILInt8 *)result) = (ILInt8)(stacktop[-1].intValue);
+		--stacktop;
+	}
+	else if(value->kind == IL_INVOKE_INT16 || value->kind == IL_INVOKE_UINT16)
+	{
+		*((ILInt16 *)result) = (ILInt16)(stacktop[-1].intValue);
+		--stacktop;
+	}
+	else if(value->kind == IL_INVOKE_INT32)
+	{
+		*((ILInt32 *)result) = stacktop[-1].intValue;
+		--stacktop;
+	}
+	else if(value->kind != IL_INVOKE_VOID)
+	{
+		/* 64-bit integers and other value types */
+		stacktop -= InvokeValueWords(value);
+		ILMemCpy(result, stacktop, value->size);
+	}
+	thread->stackTop = stacktop;
+}
+
+#endif /* !IL_USE_JIT */
+
+/*
+ * Invoke a method via reflection using the stub for its signature.
+ * Returns zero if the arguments don't suit the stub, in which case
+ * the caller should use "InvokeMethod" instead.
+ */
+static int InvokeWithStub(ILExecThread *thread, ILMethod *method,
+						  ILType *signature, ILObject *_this,
+						  System_Array *parameters, int isCtor,
+						  ILObject **retval)
+{
+	ILInvokeStub *stub;
+	ILInvokeValue *value;
+	ILInvokeCall call;
+	ILImage *image = 0;
+	ILObject *result = 0;
+	ILClass *objectClass;
+	ILObject *arg;
+	ILUInt32 param;
+
+	/* Find the stub and check the number of parameters */
+	stub = GetInvokeStub(thread, signature);
+	if(!stub)
+	{
+		return 0;
+	}
+	if(parameters)
+	{
+		if(ArrayLength(parameters) != (ILInt32)(stub->numParams))
+		{
+			return 0;
+		}
+		call.args = (ILObject **)ArrayToBuffer(parameters);
+	}
+	else if(stub->numParams != 0)
+	{
+		return 0;
+	}
+	else
+	{
+		call.args = 0;
+	}
+	call.stub = stub;
+	if(ILType_HasThis(signature) && !isCtor)
+	{
+		if(!_this)
+		{
+			return 0;
+		}
+		call._this = _this;
+	}
+	else
+	{
+		call._this = 0;
+	}
+
+	/* Check the argument types */
+	for(param = 0; param < stub->numParams; ++param)
+	{
+		value = &(stub->params[param]);
+		arg = call.args[param];
+		if(value->kind != IL_INVOKE_OBJECT)
+		{
+			/* Boxed values must have exactly the right class */
+			if(!arg || GetObjectClass(arg) != value->classInfo)
+			{
+				return 0;
+			}
+		}
+		else if(arg && !(value->anyObject) &&
+				(objectClass = GetObjectClass(arg)) != value->classInfo)
+		{
+			if(!image)
+			{
+				image = ILProgramItem_Image(method);
+			}
+			if(!ILTypeAssignCompatible
+					(image, ILClassToType(objectClass), value->type))
+			{
+				return 0;
+			}
+		}
+	}
+
+	/* Call the method, boxing the return value directly */
+	if(isCtor || stub->returnValue.kind == IL_INVOKE_VOID ||
+	   stub->returnValue.kind == IL_INVOKE_OBJECT)
+	{
+		if(_ILCallMethod(thread, method, InvokeStubUnpack, &result,
+						 isCtor, call._this, InvokeStubPack, &call))
+		{
+			result = 0;
+		}
+		else if(!isCtor && stub->returnValue.kind == IL_INVOKE_VOID)
+		{
+			result = 0;
+		}
+	}
+	else
+	{
+		result = (ILObject *)_ILEngineAllocObject
+			(thread, stub->returnValue.classInfo);
+		if(result &&
+		   _ILCallMethod(thread, method, InvokeStubUnpack, (void *)result,
+						 isCtor, call._this, InvokeStubPack, &call))
+		{
+			result = 0;
+		}
+	}
+	*retval = result;
+	return 1;
+}
+
+/*
+ * Destroy the reflection invoke stubs for a process.
+ */
+void _ILInvokeStubsDestroy(ILExecProcess *process)
+{
+	ILInvokeStubTable *table = (ILInvokeStubTable *)(process->invokeStubs);
+	ILInvokeStub *stub;
+	ILInvokeStub *next;
+	int bucket;
+
+	if(table)
+	{
+		for(bucket = 0; bucket < IL_INVOKE_STUB_HASH_SIZE; ++bucket)
+		{
+			stub = table->buckets[bucket];
+			while(stub != 0)
+			{
+				next = stub->next;
+				ILFree(stub);
+				stub = next;
+			}
+		}
+		ILFree(table);
+		process->invokeStubs = 0;
+	}
+}
+
 /*
  * Invoke a method via reflection.
  */
 static ILObject *InvokeMethod(ILExecThread *thread, ILMethod *method,
 							  ILType *signature, ILObject *_this,
 							  System_Array *parameters, int isCtor)
+{
+	ILObject *result;
+
+	/* Use the stub for the signature if the arguments suit it */
+	if(InvokeWithStub(thread, method, signature, _this,
+					  parameters, isCtor, &result))
+	{
+		return result;
+	}
+	return _ILInvokeMethodGeneric(thread, method, signature, _this,
+								  parameters, isCtor);
+}
+
+ILObject *_ILInvokeMethodGeneric(ILExecThread *thread, ILMethod *method,
+								 ILType *signature, ILObject *_this,
+								 System_Array *parameters, int isCtor)
 {
 	ILExecValue *args;
 	ILExecValue result;
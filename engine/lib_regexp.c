@@ -30,30 +30,63 @@
 extern	"C" {
 #endif
 
+/*
+ * Compiled regular expression.  Extended expressions that describe
+ * regular languages also get a DFA, which is much faster than
+ * "regexec" when sub-expression positions are not needed.
+ */
+typedef struct
+{
+	regex_t		regex;
+	ILRegexDFA *dfa;
+
+} ILRegexp;
+
+/*
+ * Search for a match with the DFA.  Returns 1 for a match, 0 for no
+ * match, or -1 if "regexec" must be used instead.
+ */
+static int DFAExec(ILExecThread *_thread, ILRegexp *re, ILString *input,
+				   ILInt32 flags, long *start, long *end)
+{
+	ILUInt16 *buf;
+	ILInt32 len;
+	if(!(re->dfa) || !input)
+	{
+		return -1;
+	}
+	len = _ILStringToBuffer(_thread, input, &buf);
+	return ILRegexDFAExec(re->dfa, buf, (long)len, (int)flags, start, end);
+}
+
 ILNativeInt _IL_RegexpMethods_CompileInternal(ILExecThread * _thread, 
 										ILString * pattern, ILInt32 flags)
 {
 	char *pat;
 	int error;
-	regex_t *result;
+	ILRegexp *result;
 	pat=ILStringToAnsi(_thread,pattern);
 	if(!pat)
 	{
 		ILExecThreadThrowOutOfMemory(_thread);
 		return 0;
 	}
-	result=ILCalloc(1,sizeof(regex_t));
+	result=(ILRegexp *)ILCalloc(1,sizeof(ILRegexp));
 	if(!result)
 	{
 		ILExecThreadThrowOutOfMemory(_thread);
 		return 0;
 	}
-	error=IL_regcomp(result,pat,flags);
+	error=IL_regcomp(&(result->regex),pat,flags);
 	if(error)
 	{
 		ILFree(result);
 		return 0;
 	}
+	if((flags & REG_EXTENDED) != 0)
+	{
+		result->dfa=ILRegexDFACreate(pat,flags);
+	}
 	return (ILNativeInt)result;
 }
 
@@ -66,15 +99,14 @@ ILNativeInt _IL_RegexpMethods_CompileWithSyntaxInternal(ILExecThread *_thread,
 {
 	char *pat;
 	int error;
-	struct re_pattern_buffer *result;
+	ILRegexp *result;
 	pat=ILStringToAnsi(_thread,pattern);
 	if(!pat)
 	{
 		ILExecThreadThrowOutOfMemory(_thread);
 		return 0;
 	}
-	result=(struct re_pattern_buffer *)ILCalloc
-				(1,sizeof(struct re_pattern_buffer));
+	result=(ILRegexp *)ILCalloc(1,sizeof(ILRegexp));
 	if(!result)
 	{
 		ILExecThreadThrowOutOfMemory(_thread);
@@ -82,16 +114,20 @@ ILNativeInt _IL_RegexpMethods_CompileWithSyntaxInternal(ILExecThread *_thread,
 	}
 	if(syntax == RE_SYNTAX_POSIX_BASIC)
 	{
-		error=IL_regcomp(result,pat,0);
+		error=IL_regcomp(&(result->regex),pat,0);
 	}
 	else if(syntax == RE_SYNTAX_POSIX_EXTENDED)
 	{
-		error=IL_regcomp(result,pat,REG_EXTENDED);
+		error=IL_regcomp(&(result->regex),pat,REG_EXTENDED);
+		if(error == 0)
+		{
+			result->dfa=ILRegexDFACreate(pat,REG_EXTENDED);
+		}
 	}
 	else
 	{
 		re_set_syntax((reg_syntax_t)syntax);
-		error=(IL_re_compile_pattern(pat,strlen(pat),result) != NULL);
+		error=(IL_re_compile_pattern(pat,strlen(pat),&(result->regex)) != NULL);
 	}
 	if(error != 0)
 	{
@@ -108,14 +144,20 @@ ILInt32 _IL_RegexpMethods_ExecInternal(ILExecThread * _thread,
 									   ILNativeInt compiled,
 									   ILString * input, ILInt32 flags)
 {
+	ILRegexp *re = (ILRegexp *)compiled;
 	char *pat;
+	switch(DFAExec(_thread, re, input, flags, 0, 0))
+	{
+		case 0:		return REG_NOMATCH;
+		case 1:		return 0;
+	}
 	pat= ILStringToAnsi(_thread,input);
 	if(!pat)
 	{
 		ILExecThreadThrowOutOfMemory(_thread);
 		return -1;
 	}
-	return IL_regexec((regex_t*)compiled,pat,0,0,flags);
+	return IL_regexec(&(re->regex),pat,0,0,flags);
 }
 
 /*
@@ -140,12 +182,50 @@ ILObject *_IL_RegexpMethods_MatchInternal(ILExecThread *_thread,
 										  ILInt32 flags,
 										  ILObject *elemType)
 {
+	ILRegexp *re = (ILRegexp *)compiled;
 	char *pat;
 	regmatch_t *matches;
 	ILClass *elemClass;
 	ILObject *array;
 	ILInt32 numMatches, index;
 	RegexMatch *matchList;
+	long start, end;
+
+	/* The DFA can report the overall match, but not sub-expressions */
+	numMatches = re->regex.re_nsub + 1;
+	numMatches = (maxMatches < numMatches) ? maxMatches : numMatches;
+	switch(DFAExec(_thread, re, input, flags,
+				   (numMatches <= 1 ? &start : 0), &end))
+	{
+		case 0:		return 0;
+
+		case 1:
+		{
+			if(numMatches > 1)
+			{
+				break;
+			}
+			elemClass = _ILGetClrClass(_thread, elemType);
+			if(!elemClass)
+			{
+				return 0;
+			}
+			if(numMatches < 0)
+			{
+				numMatches = 0;
+			}
+			array = _IL_Array_CreateArray_jiiii
+				(_thread, (ILNativeInt)elemClass, 1, numMatches, 0, 0);
+			if(array && numMatches > 0)
+			{
+				matchList = ArrayToBuffer(array);
+				matchList[0].start = (ILInt32)start;
+				matchList[0].end = (ILInt32)end;
+			}
+			return array;
+		}
+		/* Not reached */
+	}
 
 	pat= ILStringToAnsi(_thread,input);
 	if(!pat)
@@ -167,7 +247,7 @@ ILObject *_IL_RegexpMethods_MatchInternal(ILExecThread *_thread,
 		matches = 0;
 		maxMatches = 0;
 	}
-	if(IL_regexec((regex_t*)compiled,pat,(size_t)maxMatches,matches,flags) != 0)
+	if(IL_regexec(&(re->regex),pat,(size_t)maxMatches,matches,flags) != 0)
 	{
 		if(matches != 0)
 		{
@@ -185,7 +265,7 @@ ILObject *_IL_RegexpMethods_MatchInternal(ILExecThread *_thread,
 		return 0;
 	}
 	
-	numMatches = ((regex_t*)compiled)->re_nsub + 1;
+	numMatches = re->regex.re_nsub + 1;
 
 	numMatches = (maxMatches < numMatches) ? maxMatches : numMatches ;
 							
@@ -218,9 +298,14 @@ ILObject *_IL_RegexpMethods_MatchInternal(ILExecThread *_thread,
 void _IL_RegexpMethods_FreeInternal(ILExecThread * _thread, 
 									ILNativeInt compiled)
 {
-	if(compiled)
+	ILRegexp *re = (ILRegexp *)compiled;
+	if(re)
 	{
-		IL_regfree((regex_t*)compiled);
+		if(re->dfa)
+		{
+			ILRegexDFADestroy(re->dfa);
+		}
+		IL_regfree(&(re->regex));
 		ILFree((void*)compiled);
 	}
 }
@@ -50,6 +50,8 @@ typedef union
 	
 } _ILSocketConversionHelper;
 
+static void CancelReadyItem(ILExecThread *thread, ILSysIOHandle handle);
+
 /*
  * public static IntPtr GetInvalidHandle();
  */
@@ -202,6 +204,7 @@ ILInt32 _IL_SocketMethods_SendTo(ILExecThread *_thread, ILNativeInt handle,
 
 ILBool _IL_SocketMethods_Close(ILExecThread *_thread, ILNativeInt handle)
 {
+	CancelReadyItem(_thread, (ILSysIOHandle)handle);
 	return (ILBool)(ILSysIOSocketClose((ILSysIOHandle)handle));
 }
 
@@ -224,6 +227,74 @@ ILInt32 _IL_SocketMethods_Select(ILExecThread *_thread,
 		 (errorarray ? ArrayLength(errorarray) : 0), timeout);
 }
 
+/*
+ * public static IntPtr PollSetCreate();
+ */
+ILNativeInt _IL_SocketMethods_PollSetCreate(ILExecThread *_thread)
+{
+	return (ILNativeInt)ILSysIOPollSetCreate();
+}
+
+/*
+ * public static void PollSetDestroy(IntPtr pollSet);
+ */
+void _IL_SocketMethods_PollSetDestroy(ILExecThread *_thread,
+									  ILNativeInt pollSet)
+{
+	if(pollSet)
+	{
+		ILSysIOPollSetDestroy((ILSysIOPollSet *)pollSet);
+	}
+}
+
+/*
+ * public static bool PollSetAdd(IntPtr pollSet, IntPtr handle, int events);
+ */
+ILBool _IL_SocketMethods_PollSetAdd(ILExecThread *_thread,
+									ILNativeInt pollSet,
+									ILNativeInt handle, ILInt32 events)
+{
+	return (ILBool)(ILSysIOPollSetAdd((ILSysIOPollSet *)pollSet,
+									  (ILSysIOHandle)handle, events));
+}
+
+/*
+ * public static bool PollSetRemove(IntPtr pollSet, IntPtr handle);
+ */
+ILBool _IL_SocketMethods_PollSetRemove(ILExecThread *_thread,
+									   ILNativeInt pollSet,
+									   ILNativeInt handle)
+{
+	return (ILBool)(ILSysIOPollSetRemove((ILSysIOPollSet *)pollSet,
+										 (ILSysIOHandle)handle));
+}
+
+/*
+ * public static int PollSetWait(IntPtr pollSet, IntPtr[] handles,
+ *                               int[] events, long timeout);
+ */
+ILInt32 _IL_SocketMethods_PollSetWait(ILExecThread *_thread,
+									  ILNativeInt pollSet,
+									  System_Array *handles,
+									  System_Array *events,
+									  ILInt64 timeout)
+{
+	ILInt32 maxEvents;
+	if(!handles || !events)
+	{
+		return -1;
+	}
+	maxEvents = ArrayLength(handles);
+	if(ArrayLength(events) < maxEvents)
+	{
+		maxEvents = ArrayLength(events);
+	}
+	return ILSysIOPollSetWait((ILSysIOPollSet *)pollSet,
+							  (ILSysIOHandle *)(ArrayToBuffer(handles)),
+							  (ILInt32 *)(ArrayToBuffer(events)),
+							  maxEvents, timeout);
+}
+
 /*
  * public static bool SetBlocking(IntPtr handle, bool blocking);
  */
@@ -413,6 +484,458 @@ ILBool _IL_SocketMethods_QueueCompletionItem(ILExecThread *_thread,
 	return result;
 }
 
+/*
+
+Asynchronous socket operations wait for their sockets to become ready
+in a poll set that is shared by the whole process.  A small number of
+poller threads wait on the set, and hand each operation whose socket
+is ready to "ThreadPool.QueueCompletionItem", which runs the operation's
+callback.  This replaces a thread per pending operation with a fixed
+number of threads, no matter how many operations are waiting.
+
+Sockets are registered with IL_SYSIO_POLL_ONESHOT, so each registration
+is reported to one poller thread only.  Each socket can have one read
+and one write operation waiting at a time, and is registered for the
+combination of their events.  Since the one-shot registration covers
+both, the direction that did not fire is armed again after the other
+was dispatched.  The class library falls back to "QueueCompletionItem"
+when "QueueReadyItem" fails.
+
+Operations are keyed by socket handle and direction.  If a socket is
+closed and its
+descriptor is reused before the operation is dispatched, the operation
+can complete with the new socket's readiness.  This is harmless because
+the operation then fails when it uses its closed socket.
+
+*/
+
+/*
+ * Number of poller threads for each process.
+ */
+#define	IL_SOCKET_POLLER_THREADS	2
+
+/*
+ * Maximum number of ready sockets to handle for each wait.
+ */
+#define	IL_SOCKET_POLLER_BATCH		32
+
+/*
+ * Time to wait before checking for shutdown, in microseconds.
+ */
+#define	IL_SOCKET_POLLER_TIMEOUT	((ILInt64)1000000)
+
+/*
+ * An asynchronous operation that is waiting for its socket.  These
+ * are allocated as persistent GC blocks so that the callback and state
+ * objects stay reachable while the operation is pending.
+ */
+typedef struct
+{
+	ILSysIOHandle	handle;
+	ILInt32			direction;
+	ILObject	   *callback;
+	ILObject	   *state;
+
+} ILSocketCompletion;
+
+/*
+ * Socket poller state for a process.
+ */
+struct _tagILSocketPoller
+{
+	ILMutex		   *lock;
+	ILSysIOPollSet *pollSet;
+	ILHashTable	   *pending;
+	ILThread	   *threads[IL_SOCKET_POLLER_THREADS];
+	int				numThreads;
+	volatile int	shutdown;
+
+};
+
+/*
+ * Hash table callbacks for the pending operations.  The keys are
+ * completion structures with only "handle" and "direction" set.
+ */
+static unsigned long Completion_Compute(const ILSocketCompletion *completion)
+{
+	return ((unsigned long)(ILNativeUInt)(completion->handle) << 1) |
+		   (completion->direction == IL_SYSIO_POLL_WRITE);
+}
+static int Completion_Match(const ILSocketCompletion *completion,
+							const ILSocketCompletion *key)
+{
+	return (completion->handle == key->handle &&
+			completion->direction == key->direction);
+}
+
+/*
+ * Find the pending operation for a socket and direction.
+ * Must be called with the poller lock held.
+ */
+static ILSocketCompletion *FindCompletion(ILSocketPoller *poller,
+										  ILSysIOHandle handle,
+										  ILInt32 direction)
+{
+	ILSocketCompletion key;
+	key.handle = handle;
+	key.direction = direction;
+	return ILHashFindType(poller->pending, &key, ILSocketCompletion);
+}
+
+/*
+ * Remove the pending operations for a socket whose directions are
+ * in "events", and return them in "taken".  If an operation for the
+ * other direction is still waiting, then arm the socket for it again,
+ * because the one-shot registration was disarmed for both directions.
+ * Returns the number of operations that were taken.
+ */
+static int TakeCompletions(ILSocketPoller *poller, ILSysIOHandle handle,
+						   ILInt32 events, int rearm,
+						   ILSocketCompletion **taken)
+{
+	static ILInt32 const directions[2] =
+		{IL_SYSIO_POLL_READ, IL_SYSIO_POLL_WRITE};
+	ILSocketCompletion *completion;
+	ILInt32 waiting = 0;
+	int index, numTaken = 0;
+
+	/* An error completes the operations in both directions */
+	if((events & IL_SYSIO_POLL_ERROR) != 0)
+	{
+		events |= IL_SYSIO_POLL_READ | IL_SYSIO_POLL_WRITE;
+	}
+	ILMutexLock(poller->lock);
+	for(index = 0; index < 2; ++index)
+	{
+		completion = FindCompletion(poller, handle, directions[index]);
+		if(!completion)
+		{
+			continue;
+		}
+		if((events & directions[index]) != 0)
+		{
+			ILHashRemove(poller->pending, completion, 0);
+			taken[numTaken++] = completion;
+		}
+		else
+		{
+			waiting |= directions[index];
+		}
+	}
+	if(rearm && waiting != 0)
+	{
+		ILSysIOPollSetAdd(poller->pollSet, handle,
+						  waiting | IL_SYSIO_POLL_ERROR |
+						  IL_SYSIO_POLL_ONESHOT);
+	}
+	ILMutexUnlock(poller->lock);
+	return numTaken;
+}
+
+/*
+ * Queue a pending operation's callback to the thread pool,
+ * and then free the operation.  The thread pool would reject
+ * a null callback, so there is nothing to queue in that case.
+ */
+static void DispatchCompletion(ILExecThread *thread,
+							   ILSocketCompletion *completion)
+{
+	ILBool result = 0;
+	if(completion->callback)
+	{
+		ILExecThreadCallNamed(thread, "System.Threading.ThreadPool",
+							  "QueueCompletionItem",
+							  "(oSystem.AsyncCallback;oSystem.IAsyncResult;)Z",
+							  &result, completion->callback, completion->state);
+		if(ILExecThreadHasException(thread))
+		{
+			ILExecThreadClearException(thread);
+		}
+	}
+	ILGCFreePersistent(completion);
+}
+
+/*
+ * Main function for a poller thread.
+ */
+static void PollerThreadFunc(void *arg)
+{
+	ILSocketPoller *poller = (ILSocketPoller *)arg;
+	ILExecThread *thread = ILExecThreadCurrent();
+	ILSysIOHandle handles[IL_SOCKET_POLLER_BATCH];
+	ILInt32 events[IL_SOCKET_POLLER_BATCH];
+	ILSocketCompletion *taken[2];
+	ILInt32 count, index;
+	int numTaken;
+
+	/* Poller threads are aborted and joined when the process unloads.
+	   Waits are interrupted by the abort, or time out regularly */
+	while(!(poller->shutdown) && !ILThreadIsAbortRequested())
+	{
+		count = ILSysIOPollSetWait(poller->pollSet, handles, events,
+								   IL_SOCKET_POLLER_BATCH,
+								   IL_SOCKET_POLLER_TIMEOUT);
+		if(count < 0)
+		{
+			/* Don't spin if the wait fails */
+			ILThreadSleep(10);
+			continue;
+		}
+		for(index = 0; index < count; ++index)
+		{
+			numTaken = TakeCompletions(poller, handles[index],
+									   events[index], 1, taken);
+			while(numTaken > 0)
+			{
+				DispatchCompletion(thread, taken[--numTaken]);
+			}
+		}
+	}
+}
+
+/*
+ * Create the socket poller for a process.  The poller threads
+ * are started by the caller.
+ */
+static ILSocketPoller *CreateSocketPoller(void)
+{
+	ILSocketPoller *poller;
+	if((poller = (ILSocketPoller *)ILCalloc(1, sizeof(ILSocketPoller))) == 0)
+	{
+		return 0;
+	}
+	if((poller->lock = ILMutexCreate()) == 0)
+	{
+		ILFree(poller);
+		return 0;
+	}
+	if((poller->pollSet = ILSysIOPollSetCreate()) == 0)
+	{
+		ILMutexDestroy(poller->lock);
+		ILFree(poller);
+		return 0;
+	}
+	if((poller->pending = ILHashCreate
+			(0, (ILHashComputeFunc)Completion_Compute,
+			 (ILHashKeyComputeFunc)Completion_Compute,
+			 (ILHashMatchFunc)Completion_Match,
+			 (ILHashFreeFunc)0)) == 0)
+	{
+		ILSysIOPollSetDestroy(poller->pollSet);
+		ILMutexDestroy(poller->lock);
+		ILFree(poller);
+		return 0;
+	}
+	return poller;
+}
+
+/*
+ * Start a poller thread as a background thread of a process.
+ */
+static ILThread *StartPollerThread(ILExecProcess *process,
+								   ILSocketPoller *poller)
+{
+	ILThread *supportThread;
+	if((supportThread = ILThreadCreate(PollerThreadFunc, poller)) == 0)
+	{
+		return 0;
+	}
+	ILThreadSetBackground(supportThread, 1);
+	if(!ILThreadRegisterForManagedExecution(process, supportThread))
+	{
+		ILThreadDestroy(supportThread);
+		return 0;
+	}
+	if(!ILThreadStart(supportThread))
+	{
+		ILThreadUnregisterForManagedExecution(supportThread);
+		ILThreadDestroy(supportThread);
+		return 0;
+	}
+	return supportThread;
+}
+
+/*
+ * Get the socket poller for a process, creating it and starting
+ * its threads if necessary.  Returns NULL if it cannot be started.
+ */
+static ILSocketPoller *GetSocketPoller(ILExecThread *thread)
+{
+	ILExecProcess *process = _ILExecThreadProcess(thread);
+	ILSocketPoller *poller;
+	ILSocketPoller *newPoller;
+	ILThread *supportThread;
+	int index;
+
+	if((poller = process->socketPoller) != 0)
+	{
+		return (poller->numThreads > 0 ? poller : 0);
+	}
+	if(!ILHasThreads() || (newPoller = CreateSocketPoller()) == 0)
+	{
+		return 0;
+	}
+
+	/* Install the poller unless another thread got there first.
+	   The threads are started outside the process lock because
+	   registering them with the process acquires it */
+	ILMutexLock(process->lock);
+	if((poller = process->socketPoller) == 0 &&
+	   process->state < _IL_PROCESS_STATE_UNLOADING)
+	{
+		process->socketPoller = poller = newPoller;
+		newPoller = 0;
+	}
+	ILMutexUnlock(process->lock);
+	if(newPoller)
+	{
+		ILHashDestroy(newPoller->pending);
+		ILSysIOPollSetDestroy(newPoller->pollSet);
+		ILMutexDestroy(newPoller->lock);
+		ILFree(newPoller);
+	}
+	else if(poller)
+	{
+		ILMutexLock(poller->lock);
+		for(index = 0; index < IL_SOCKET_POLLER_THREADS; ++index)
+		{
+			supportThread = StartPollerThread(process, poller);
+			if(!supportThread)
+			{
+				break;
+			}
+			poller->threads[(poller->numThreads)++] = supportThread;
+		}
+		ILMutexUnlock(poller->lock);
+	}
+	return ((poller && poller->numThreads > 0) ? poller : 0);
+}
+
+/*
+ * Cancel the pending operation for a socket that is being closed,
+ * by completing it.  The operation's callback then sees the closed
+ * socket, which is what it would see if it were waiting in "Select".
+ */
+static void CancelReadyItem(ILExecThread *thread, ILSysIOHandle handle)
+{
+	ILSocketPoller *poller = _ILExecThreadProcess(thread)->socketPoller;
+	ILSocketCompletion *taken[2];
+	int numTaken;
+	if(poller)
+	{
+		ILSysIOPollSetRemove(poller->pollSet, handle);
+		numTaken = TakeCompletions(poller, handle, IL_SYSIO_POLL_ERROR,
+								   0, taken);
+		while(numTaken > 0)
+		{
+			DispatchCompletion(thread, taken[--numTaken]);
+		}
+	}
+}
+
+/*
+ * public static bool QueueReadyItem(IntPtr handle, int events,
+ *									 AsyncCallback callback,
+ *									 IAsyncResult state);
+ */
+ILBool _IL_SocketMethods_QueueReadyItem(ILExecThread *_thread,
+										ILNativeInt handle, ILInt32 events,
+										ILObject *callback, ILObject *state)
+{
+	ILSocketPoller *poller;
+	ILSocketCompletion *completion;
+	ILSysIOHandle sockfd = (ILSysIOHandle)handle;
+	ILInt32 direction = (events & (IL_SYSIO_POLL_READ | IL_SYSIO_POLL_WRITE));
+	ILInt32 waiting;
+	ILBool result = 0;
+
+	/* Each operation waits for one direction only */
+	if(direction != IL_SYSIO_POLL_READ && direction != IL_SYSIO_POLL_WRITE)
+	{
+		return 0;
+	}
+	if((poller = GetSocketPoller(_thread)) == 0)
+	{
+		return 0;
+	}
+	completion = (ILSocketCompletion *)
+		ILGCAllocPersistent(sizeof(ILSocketCompletion));
+	if(!completion)
+	{
+		return 0;
+	}
+	completion->handle = sockfd;
+	completion->direction = direction;
+	completion->callback = callback;
+	completion->state = state;
+
+	/* Register the operation and arm its socket for both directions
+	   if an operation in the other direction is already waiting.
+	   Only one operation can wait for each direction of a socket */
+	ILMutexLock(poller->lock);
+	if(!FindCompletion(poller, sockfd, direction) &&
+	   ILHashAdd(poller->pending, completion))
+	{
+		waiting = direction;
+		if(FindCompletion(poller, sockfd,
+						  direction ^ (IL_SYSIO_POLL_READ |
+						  			   IL_SYSIO_POLL_WRITE)))
+		{
+			waiting = IL_SYSIO_POLL_READ | IL_SYSIO_POLL_WRITE;
+		}
+		if(ILSysIOPollSetAdd(poller->pollSet, sockfd,
+							 waiting | IL_SYSIO_POLL_ERROR |
+							 IL_SYSIO_POLL_ONESHOT))
+		{
+			result = 1;
+		}
+		else
+		{
+			ILHashRemove(poller->pending, completion, 0);
+		}
+	}
+	ILMutexUnlock(poller->lock);
+	if(!result)
+	{
+		ILGCFreePersistent(completion);
+	}
+	return result;
+}
+
+void _ILSocketPollerDestroy(ILExecProcess *process)
+{
+	ILSocketPoller *poller = process->socketPoller;
+	ILSocketCompletion *completion;
+	ILHashIter iter;
+	int index;
+
+	if(!poller)
+	{
+		return;
+	}
+
+	/* The threads have normally exited already, because they
+	   were aborted and joined when the process was unloaded */
+	poller->shutdown = 1;
+	for(index = 0; index < poller->numThreads; ++index)
+	{
+		ILThreadJoin(poller->threads[index], -1);
+		ILThreadDestroy(poller->threads[index]);
+	}
+
+	/* Discard the operations that never completed */
+	ILHashIterInit(&iter, poller->pending);
+	while((completion = ILHashIterNextType(&iter, ILSocketCompletion)) != 0)
+	{
+		ILGCFreePersistent(completion);
+	}
+	ILHashDestroy(poller->pending);
+	ILSysIOPollSetDestroy(poller->pollSet);
+	ILMutexDestroy(poller->lock);
+	ILFree(poller);
+	process->socketPoller = 0;
+}
+
 /*
  * public static WaitHandle CreateManualResetEvent();
  */
@@ -21,6 +21,7 @@
 #include "engine.h"
 #include "lib_defs.h"
 #include "il_utils.h"
+#include "interlocked.h"
 
 #ifdef	__cplusplus
 extern	"C" {
@@ -541,9 +542,6 @@ ILInt32 _IL_String_InternalOrdinal(ILExecThread *thread,
 						   		   System_String *strB,
 								   ILInt32 indexB, ILInt32 lengthB)
 {
-	ILUInt16 *bufA;
-	ILUInt16 *bufB;
-
 	/* Handle the easy cases first */
 	if(!strA)
 	{
@@ -562,37 +560,8 @@ ILInt32 _IL_String_InternalOrdinal(ILExecThread *thread,
 	}
 
 	/* Compare the two strings */
-	bufA = StringToBuffer(strA) + indexA;
-	bufB = StringToBuffer(strB) + indexB;
-	while(lengthA > 0 && lengthB > 0)
-	{
-		if(*bufA < *bufB)
-		{
-			return -1;
-		}
-		else if(*bufA > *bufB)
-		{
-			return 1;
-		}
-		++bufA;
-		++bufB;
-		--lengthA;
-		--lengthB;
-	}
-
-	/* Determine the ordering based on the tail sections */
-	if(lengthA > 0)
-	{
-		return 1;
-	}
-	else if(lengthB > 0)
-	{
-		return -1;
-	}
-	else
-	{
-		return 0;
-	}
+	return ILUTF16CompareOrdinal(StringToBuffer(strA) + indexA, lengthA,
+								 StringToBuffer(strB) + indexB, lengthB);
 }
 
 /*
@@ -631,9 +600,8 @@ ILBool _IL_String_Equals(ILExecThread *thread,
 	}
 	else
 	{
-		return !ILMemCmp(StringToBuffer(strA),
-						 StringToBuffer(strB),
-						 strA->length * sizeof(ILUInt16));
+		return (ILUTF16Mismatch(StringToBuffer(strA), StringToBuffer(strB),
+								strA->length) < 0);
 	}
 }
 
@@ -820,7 +788,7 @@ ILInt32 _IL_String_IndexOf(ILExecThread *thread,
 					       ILInt32 startIndex,
 					       ILInt32 count)
 {
-	ILUInt16 *buf;
+	long posn;
 
 	/* Validate the parameters */
 	if(startIndex < 0)
@@ -837,17 +805,8 @@ ILInt32 _IL_String_IndexOf(ILExecThread *thread,
 	}
 
 	/* Search for the value */
-	buf = StringToBuffer(_this) + startIndex;
-	while(count > 0)
-	{
-		if(*buf++ == value)
-		{
-			return startIndex;
-		}
-		++startIndex;
-		--count;
-	}
-	return -1;
+	posn = ILUTF16IndexOf(StringToBuffer(_this) + startIndex, count, value);
+	return (posn < 0 ? -1 : startIndex + (ILInt32)posn);
 }
 
 /*
@@ -859,10 +818,9 @@ ILInt32 _IL_String_IndexOfAny(ILExecThread *thread,
 					          ILInt32 startIndex,
 					          ILInt32 count)
 {
-	ILUInt16 *buf;
 	ILUInt16 *anyBuf;
 	ILInt32 anyLength;
-	ILInt32 anyPosn;
+	long posn;
 
 	/* Validate the parameters */
 	if(!anyOf)
@@ -893,21 +851,9 @@ ILInt32 _IL_String_IndexOfAny(ILExecThread *thread,
 	}
 
 	/* Search for the value */
-	buf = StringToBuffer(_this) + startIndex;
-	while(count > 0)
-	{
-		for(anyPosn = 0; anyPosn < anyLength; ++anyPosn)
-		{
-			if(*buf == anyBuf[anyPosn])
-			{
-				return startIndex;
-			}
-		}
-		++buf;
-		++startIndex;
-		--count;
-	}
-	return -1;
+	posn = ILUTF16IndexOfAny(StringToBuffer(_this) + startIndex, count,
+							 anyBuf, anyLength);
+	return (posn < 0 ? -1 : startIndex + (ILInt32)posn);
 }
 
 /*
@@ -919,7 +865,7 @@ ILInt32 _IL_String_LastIndexOf(ILExecThread *thread,
 					 	       ILInt32 startIndex,
 					 	       ILInt32 count)
 {
-	ILUInt16 *buf;
+	long posn;
 
 	/* Validate the parameters */
 	if(startIndex < 0)
@@ -942,18 +888,14 @@ ILInt32 _IL_String_LastIndexOf(ILExecThread *thread,
 		startIndex = _this->length - 1;
 	}
 
-	/* Search for the value */
-	buf = StringToBuffer(_this) + startIndex;
-	while(count > 0)
+	/* Search for the value in the "count" characters ending at "startIndex" */
+	if(count <= 0)
 	{
-		if(*buf-- == value)
-		{
-			return startIndex;
-		}
-		--startIndex;
-		--count;
+		return -1;
 	}
-	return -1;
+	startIndex -= count - 1;
+	posn = ILUTF16LastIndexOf(StringToBuffer(_this) + startIndex, count, value);
+	return (posn < 0 ? -1 : startIndex + (ILInt32)posn);
 }
 
 /*
@@ -965,10 +907,9 @@ ILInt32 _IL_String_LastIndexOfAny(ILExecThread *thread,
 							      ILInt32 startIndex,
 							      ILInt32 count)
 {
-	ILUInt16 *buf;
 	ILUInt16 *anyBuf;
 	ILInt32 anyLength;
-	ILInt32 anyPosn;
+	long posn;
 
 	/* Validate the parameters */
 	if(!anyOf)
@@ -1005,22 +946,15 @@ ILInt32 _IL_String_LastIndexOfAny(ILExecThread *thread,
 		startIndex = _this->length - 1;
 	}
 
-	/* Search for the value */
-	buf = StringToBuffer(_this) + startIndex;
-	while(count > 0)
+	/* Search for the value in the "count" characters ending at "startIndex" */
+	if(count <= 0)
 	{
-		for(anyPosn = 0; anyPosn < anyLength; ++anyPosn)
-		{
-			if(*buf == anyBuf[anyPosn])
-			{
-				return startIndex;
-			}
-		}
-		--buf;
-		--startIndex;
-		--count;
+		return -1;
 	}
-	return -1;
+	startIndex -= count - 1;
+	posn = ILUTF16LastIndexOfAny(StringToBuffer(_this) + startIndex, count,
+								 anyBuf, anyLength);
+	return (posn < 0 ? -1 : startIndex + (ILInt32)posn);
 }
 
 /*
@@ -1034,77 +968,66 @@ ILInt32 _IL_String_FindInRange(ILExecThread *thread, System_String *_this,
 	ILUInt16 *buf1;
 	ILUInt16 *buf2;
 	ILUInt32 size;
+	long posn;
 
 	/* Searches for zero length strings always match */
 	if(dest->length == 0)
 		return srcFirst;
-	buf1 = StringToBuffer(_this) + srcFirst;
+	buf1 = StringToBuffer(_this);
 	buf2 = StringToBuffer(dest);
 	size = (ILUInt32)(dest->length * sizeof(ILUInt16));
 	if(step > 0)
 	{
-		/* Scan forwards for the string */
-		if (dest->length == 1)
+		/* Scan forwards for the first character, then check the rest */
+		while(srcFirst <= srcLast)
 		{
-			while(srcFirst <= srcLast)
+			posn = ILUTF16IndexOf(buf1 + srcFirst, srcLast - srcFirst + 1,
+								  *buf2);
+			if(posn < 0)
 			{
-				if(*buf1 == *buf2)
-				{
-					return srcFirst;
-				}
-				++buf1;
-				++srcFirst;
+				break;
 			}
-		}
-		else
-		{
-			while(srcFirst <= srcLast)
+			srcFirst += (ILInt32)posn;
+			if(dest->length == 1 || !ILMemCmp(buf1 + srcFirst, buf2, size))
 			{
-				if((*buf1 == *buf2) && !ILMemCmp(buf1, buf2, size))
-				{
-					return srcFirst;
-				}
-				++buf1;
-				++srcFirst;
+				return srcFirst;
 			}
+			++srcFirst;
 		}
 		return -1;
 	}
 	else
 	{
-		/* Scan backwards for the string */
-		if(dest->length == 1)
+		/* Scan backwards for the first character, then check the rest */
+		while(srcFirst >= srcLast)
 		{
-			while(srcFirst >= srcLast)
+			posn = ILUTF16LastIndexOf(buf1 + srcLast, srcFirst - srcLast + 1,
+									  *buf2);
+			if(posn < 0)
 			{
-				if(*buf1 == *buf2)
-				{
-					return srcFirst;
-				}
-				--buf1;
-				--srcFirst;
+				break;
 			}
-		}
-		else
-		{
-			while(srcFirst >= srcLast)
+			srcFirst = srcLast + (ILInt32)posn;
+			if(dest->length == 1 || !ILMemCmp(buf1 + srcFirst, buf2, size))
 			{
-				if((*buf1 == *buf2) && !ILMemCmp(buf1, buf2, size))
-				{
-					return srcFirst;
-				}
-				--buf1;
-				--srcFirst;
+				return srcFirst;
 			}
+			--srcFirst;
 		}
 		return -1;
 	}
 }
 
 /*
- * Size of the intern'ed string hash table.
+ * Initial number of buckets in the intern'ed string hash table.
+ * The number of buckets must be a power of 2.
  */
-#define	IL_INTERN_HASH_SIZE		509
+#define	IL_INTERN_HASH_SIZE		512
+
+/*
+ * Average chain length at which the intern'ed string hash table grows.
+ */
+#define	IL_INTERN_LOAD_FACTOR	1
 
 /*
  * Structure of a intern'ed string hash table entry.
@@ -1112,79 +1035,330 @@ ILInt32 _IL_String_FindInRange(ILExecThread *thread, System_String *_this,
 typedef struct _tagILStrHash ILStrHash;
 struct _tagILStrHash
 {
-	System_String	*value;
-	ILStrHash		*next;
+	System_String	   *value;
+	ILUInt32			hash;
+	ILStrHash * volatile next;
 
 };
 
 /*
- * Look up the intern'ed string hash table for a value.
+ * Bucket array of the intern'ed string hash table.  The array is
+ * replaced as a whole when the table grows.
  */
-static System_String *InternString(ILExecThread *thread,
-								   System_String *str, int add)
+typedef struct _tagILStrHashBuckets ILStrHashBuckets;
+struct _tagILStrHashBuckets
 {
-	ILStrHash *table;
-	ILStrHash *entry;
-	ILUInt32 hash;
+	ILUInt32			size;
+	ILStrHash * volatile entries[1];
+
+};
 
-	/* Allocate a new hash table, if required */
-	table = (ILStrHash *)(thread->process->internHash);
+/*
+ * The intern'ed string hash table.  Lookups don't lock the table.
+ * Chains are only ever extended at the head and the entries are copied
+ * when the table grows, so a lookup never misses a string that was
+ * already in the table when the lookup started.  Insertions are
+ * serialized by the table lock.
+ */
+typedef struct _tagILStrHashTable ILStrHashTable;
+struct _tagILStrHashTable
+{
+	ILMutex			   *lock;
+	ILStrHashBuckets * volatile buckets;
+	ILUInt32			count;
+
+};
+
+/*
+ * Get the bucket index for a string hash value.
+ */
+static IL_INLINE ILUInt32 InternBucket(ILUInt32 hash, ILUInt32 size)
+{
+	hash ^= (hash >> 16);
+	hash *= 0x85EBCA6BU;
+	hash ^= (hash >> 13);
+	return hash & (size - 1);
+}
+
+/*
+ * Allocate a bucket array for the intern'ed string hash table.
+ */
+static ILStrHashBuckets *InternBucketsCreate(ILUInt32 size)
+{
+	ILStrHashBuckets *buckets;
+
+	buckets = (ILStrHashBuckets *)ILGCAlloc(sizeof(ILStrHashBuckets) +
+											(size - 1) * sizeof(ILStrHash *));
+	if(buckets)
+	{
+		buckets->size = size;
+	}
+	return buckets;
+}
+
+/*
+ * Get the intern'ed string hash table for the current process,
+ * creating it if necessary.  Returns NULL if out of memory.
+ */
+static ILStrHashTable *GetInternTable(ILExecThread *thread)
+{
+	ILExecProcess *process = thread->process;
+	ILStrHashTable *table;
+	ILStrHashTable *other;
+
+	table = (ILStrHashTable *)ILInterlockedLoadP
+		((void **)&(process->internHash));
+	if(table)
+	{
+		return table;
+	}
+
+	/* Allocate a new hash table */
+	table = (ILStrHashTable *)ILGCAllocPersistent(sizeof(ILStrHashTable));
 	if(!table)
 	{
-		table = (ILStrHash *)ILGCAllocPersistent(sizeof(ILStrHash) *
-												 IL_INTERN_HASH_SIZE);
-		if(!table)
+		return 0;
+	}
+	if((table->buckets = InternBucketsCreate(IL_INTERN_HASH_SIZE)) == 0 ||
+	   (table->lock = ILMutexCreate()) == 0)
+	{
+		ILGCFreePersistent(table);
+		return 0;
+	}
+
+	/* Publish the table unless another thread beat us to it */
+	other = (ILStrHashTable *)ILInterlockedCompareAndExchangeP_Full
+		((void **)&(process->internHash), (void *)table, (void *)0);
+	if(other)
+	{
+		ILMutexDestroy(table->lock);
+		ILGCFreePersistent(table);
+		return other;
+	}
+	return table;
+}
+
+/*
+ * Destroy the intern'ed string hash table for a process.
+ * The buckets and entries will be cleaned up by the garbage collector.
+ */
+void _ILStringInternTableDestroy(ILExecProcess *process)
+{
+	ILStrHashTable *table = (ILStrHashTable *)(process->internHash);
+
+	if(table)
+	{
+		process->internHash = 0;
+		ILMutexDestroy(table->lock);
+		ILGCFreePersistent(table);
+	}
+}
+
+/*
+ * Determine if the contents of a string buffer is the
+ * same as a literal string value from an image.
+ */
+static int SameAsImage(ILUInt16 *buf, const char *str, ILInt32 len)
+{
+#if defined(__i386) || defined(__i386__)
+	/* We can take a short-cut on x86 platforms which already
+	   have the string in the correct format */
+	if(len > 0)
+	{
+		return !ILMemCmp(buf, str, len * sizeof(ILUInt16));
+	}
+	else
+	{
+		return 1;
+	}
+#else
+	while(len > 0)
+	{
+		if(*buf++ != IL_READ_UINT16(str))
+		{
+			return 0;
+		}
+		str += 2;
+		--len;
+	}
+	return 1;
+#endif
+}
+
+/*
+ * Look for an intern'ed string with the given contents without locking.
+ * If "fromImage" is non-zero then "buf" points to little-endian
+ * string data from an image.
+ */
+static System_String *InternFind(ILStrHashBuckets *buckets, ILUInt32 hash,
+								 const void *buf, ILInt32 len, int fromImage)
+{
+	ILStrHash *entry;
+	System_String *value;
+
+	/* Every load depends on the address loaded before and all writers
+	   publish with release semantics, so no barriers are needed here */
+	entry = (ILStrHash *)ILInterlockedLoadP
+		((void **)&(buckets->entries[InternBucket(hash, buckets->size)]));
+	while(entry != 0)
+	{
+		value = entry->value;
+		if(entry->hash == hash && value->length == len)
 		{
-			if(add)
+			if(len == 0)
 			{
-				ILExecThreadThrowOutOfMemory(thread);
+				return value;
+			}
+			else if(fromImage)
+			{
+				if(SameAsImage(StringToBuffer(value), (const char *)buf, len))
+				{
+					return value;
+				}
+			}
+			else if(!ILMemCmp(StringToBuffer(value), buf,
+							  len * sizeof(ILUInt16)))
+			{
+				return value;
 			}
-			return 0;
 		}
-		thread->process->internHash = (void *)table;
+		entry = (ILStrHash *)ILInterlockedLoadP((void **)&(entry->next));
 	}
+	return 0;
+}
 
-	/* Compute the hash of the string */
-	hash = ((ILUInt32)(_IL_String_GetHashCode(thread, str)))
-				% IL_INTERN_HASH_SIZE;
+/*
+ * Double the number of buckets in the intern'ed string hash table.
+ * The entries are copied so that concurrent lookups on the old bucket
+ * array still see all strings.  The table lock must be held.
+ */
+static void InternGrow(ILStrHashTable *table)
+{
+	ILStrHashBuckets *oldBuckets = table->buckets;
+	ILStrHashBuckets *newBuckets;
+	ILStrHash *entry;
+	ILStrHash *newEntry;
+	ILUInt32 index;
+	ILUInt32 bucket;
 
-	/* Look for an existing string with the same value */
-	entry = &(table[hash]);
-	while(entry != 0 && entry->value != 0)
+	newBuckets = InternBucketsCreate(oldBuckets->size * 2);
+	if(!newBuckets)
 	{
-		if(entry->value->length == str->length &&
-		   (entry->value->length == 0 ||
-		    !ILMemCmp(StringToBuffer(entry->value), StringToBuffer(str),
-					  entry->value->length * 2)))
+		/* Keep on using the longer chains */
+		return;
+	}
+	for(index = 0; index < oldBuckets->size; ++index)
+	{
+		entry = oldBuckets->entries[index];
+		while(entry != 0)
 		{
-			return entry->value;
+			newEntry = (ILStrHash *)ILGCAlloc(sizeof(ILStrHash));
+			if(!newEntry)
+			{
+				return;
+			}
+			newEntry->value = entry->value;
+			newEntry->hash = entry->hash;
+			bucket = InternBucket(entry->hash, newBuckets->size);
+			newEntry->next = newBuckets->entries[bucket];
+			newBuckets->entries[bucket] = newEntry;
+			entry = entry->next;
 		}
-		entry = entry->next;
 	}
-	if(!add)
+
+	/* Publish the new bucket array */
+	ILInterlockedStoreP_Release((void **)&(table->buckets), newBuckets);
+}
+
+/*
+ * Add a string to the intern'ed string hash table unless another thread
+ * added a string with the same contents first.  Returns the string that
+ * is in the table afterwards or NULL if out of memory.
+ */
+static System_String *InternAdd(ILStrHashTable *table, ILUInt32 hash,
+								System_String *str)
+{
+	ILStrHashBuckets *buckets;
+	ILStrHash *entry;
+	System_String *value;
+	ILUInt32 bucket;
+
+	ILMutexLock(table->lock);
+
+	/* Search again now that insertions are blocked */
+	buckets = table->buckets;
+	value = InternFind(buckets, hash, StringToBuffer(str), str->length, 0);
+	if(value)
 	{
-		return 0;
+		ILMutexUnlock(table->lock);
+		return value;
 	}
 
-	/* Add a new entry to the intern'ed string hash table */
-	entry = &(table[hash]);
-	if(entry->value == 0)
+	/* Grow the table if the chains are getting too long */
+	if(table->count >= buckets->size * IL_INTERN_LOAD_FACTOR)
 	{
-		entry->value = str;
+		InternGrow(table);
+		buckets = table->buckets;
 	}
-	else
+
+	/* Add a new entry at the head of the chain */
+	entry = (ILStrHash *)ILGCAlloc(sizeof(ILStrHash));
+	if(!entry)
 	{
-		entry = (ILStrHash *)ILGCAlloc(sizeof(ILStrHash));
-		if(!entry)
+		ILMutexUnlock(table->lock);
+		return 0;
+	}
+	bucket = InternBucket(hash, buckets->size);
+	entry->value = str;
+	entry->hash = hash;
+	entry->next = buckets->entries[bucket];
+	ILInterlockedStoreP_Release((void **)&(buckets->entries[bucket]), entry);
+	++(table->count);
+
+	ILMutexUnlock(table->lock);
+	return str;
+}
+
+/*
+ * Look up the intern'ed string hash table for a value.
+ */
+static System_String *InternString(ILExecThread *thread,
+								   System_String *str, int add)
+{
+	ILStrHashTable *table;
+	System_String *value;
+	ILUInt32 hash;
+
+	/* Get the hash table, allocating it if required */
+	table = GetInternTable(thread);
+	if(!table)
+	{
+		if(add)
 		{
 			ILExecThreadThrowOutOfMemory(thread);
-			return 0;
 		}
-		entry->value = str;
-		entry->next = table[hash].next;
-		table[hash].next = entry;
+		return 0;
 	}
-	return str;
+
+	/* Compute the hash of the string */
+	hash = (ILUInt32)(_IL_String_GetHashCode(thread, str));
+
+	/* Look for an existing string with the same value */
+	value = InternFind((ILStrHashBuckets *)ILInterlockedLoadP
+							((void **)&(table->buckets)),
+					   hash, StringToBuffer(str), str->length, 0);
+	if(value || !add)
+	{
+		return value;
+	}
+
+	/* Add a new entry to the intern'ed string hash table */
+	value = InternAdd(table, hash, str);
+	if(!value)
+	{
+		ILExecThreadThrowOutOfMemory(thread);
+	}
+	return value;
 }
 
 /*
@@ -1263,9 +1437,8 @@ System_String *_IL_String_Replace_cc(ILExecThread *thread,
 								     ILUInt16 newChar)
 {
 	System_String *str;
-	ILUInt16 *buf1;
 	ILInt32 len;
-	ILInt32 pos = 0;
+	long pos;
 
 	/* If nothing will happen, then return the current string as-is */
 	len = _this->length;
@@ -1274,54 +1447,29 @@ System_String *_IL_String_Replace_cc(ILExecThread *thread,
 		return _this;
 	}
 
-	/* Scan the two strings, copying and replacing as we go */
-	buf1 = StringToBuffer(_this);
-	while(len > 0)
+	/* Find the first character to replace */
+	pos = ILUTF16IndexOf(StringToBuffer(_this), len, oldChar);
+	if(pos < 0)
 	{
-		if(*buf1 != oldChar)
-		{
-			++buf1;
-			++pos;
-			--len;
-		}
-		else /* found one char to replace */
-		{
-			ILUInt16 *buf2;
+		return _this;
+	}
 
-			/* Allocate a new string */
-			str = AllocString(thread, _this->length);
-			if(!str)
-			{
-				return 0;
-			}
-			if(pos > 0)
-			{
-				/* copy the allready checked part */
-				ILMemCpy(StringToBuffer(str), StringToBuffer(_this),
-				 sizeof(ILUInt16) * pos);
-			}
-			buf2 = StringToBuffer(str) + pos;
-			++buf1;
-			*buf2++ = newChar;
-			--len;
-			while(len > 0)
-			{
-				if(*buf1 != oldChar)
-				{
-					*buf2++ = *buf1++;
-				}
-				else
-				{
-					*buf2++ = newChar;
-					++buf1;
-				}
-				--len;
-			}
-			return str;
-		}
+	/* Allocate a new string */
+	str = AllocString(thread, len);
+	if(!str)
+	{
+		return 0;
+	}
 
+	/* Copy the already checked part and replace in the rest */
+	if(pos > 0)
+	{
+		ILMemCpy(StringToBuffer(str), StringToBuffer(_this),
+				 sizeof(ILUInt16) * pos);
 	}
-	return _this;
+	ILUTF16Replace(StringToBuffer(str) + pos, StringToBuffer(_this) + pos,
+				   len - pos, oldChar, newChar);
+	return str;
 }
 
 /*
@@ -1860,59 +2008,22 @@ ILString *ILStringIntern(ILExecThread *thread, ILString *str)
 	}
 }
 
-/*
- * Determine if the contents of a string buffer is the
- * same as a literal string value from an image.
- */
-static int SameAsImage(ILUInt16 *buf, const char *str, ILInt32 len)
-{
-#if defined(__i386) || defined(__i386__)
-	/* We can take a short-cut on x86 platforms which already
-	   have the string in the correct format */
-	if(len > 0)
-	{
-		return !ILMemCmp(buf, str, len * sizeof(ILUInt16));
-	}
-	else
-	{
-		return 1;
-	}
-#else
-	while(len > 0)
-	{
-		if(*buf++ != IL_READ_UINT16(str))
-		{
-			return 0;
-		}
-		str += 2;
-		--len;
-	}
-	return 1;
-#endif
-}
-
 static ILString *InternFromBuffer(ILExecThread *thread,
 								  const char *str, unsigned long len)
 {
 	unsigned long posn;
 	System_String *newStr;
-	ILStrHash *table;
-	ILStrHash *entry;
+	System_String *value;
+	ILStrHashTable *table;
 	ILInt32 hashTemp;
 	ILUInt32 hash;
 
-	/* Allocate a new hash table, if required */
-	table = (ILStrHash *)(thread->process->internHash);
+	/* Get the hash table, allocating it if required */
+	table = GetInternTable(thread);
 	if(!table)
 	{
-		table = (ILStrHash *)ILGCAllocPersistent(sizeof(ILStrHash) *
-												 IL_INTERN_HASH_SIZE);
-		if(!table)
-		{
-			ILExecThreadThrowOutOfMemory(thread);
-			return 0;
-		}
-		thread->process->internHash = (void *)table;
+		ILExecThreadThrowOutOfMemory(thread);
+		return 0;
 	}
 
 	/* Compute the hash of the string */
@@ -1922,20 +2033,15 @@ static ILString *InternFromBuffer(ILExecThread *thread,
 		hashTemp = (hashTemp << 5) + hashTemp +
 				   (ILInt32)(IL_READ_UINT16(str + posn * 2));
 	}
-	hash = ((ILUInt32)hashTemp) % IL_INTERN_HASH_SIZE;
+	hash = (ILUInt32)hashTemp;
 
 	/* Look for an existing string with the same value */
-	entry = &(table[hash]);
-	while(entry != 0 && entry->value != 0)
+	value = InternFind((ILStrHashBuckets *)ILInterlockedLoadP
+							((void **)&(table->buckets)),
+					   hash, str, (ILInt32)len, 1);
+	if(value)
 	{
-		if(entry->value->length == (ILInt32)len &&
-		   (entry->value->length == 0 ||
-		    SameAsImage(StringToBuffer(entry->value), str,
-					    entry->value->length)))
-		{
-			return (ILString *)(entry->value);
-		}
-		entry = entry->next;
+		return (ILString *)value;
 	}
 
 	/* Allocate space for the string */
@@ -1965,27 +2071,17 @@ static ILString *InternFromBuffer(ILExecThread *thread,
 	}
 #endif
 
-	/* Add a new entry to the intern'ed string hash table */
-	entry = &(table[hash]);
-	if(entry->value == 0)
-	{
-		entry->value = newStr;
-	}
-	else
+	/* Add a new entry to the intern'ed string hash table.  If another
+	   thread interned the same string in the meantime we use that one */
+	value = InternAdd(table, hash, newStr);
+	if(!value)
 	{
-		entry = (ILStrHash *)ILGCAlloc(sizeof(ILStrHash));
-		if(!entry)
-		{
-			ILExecThreadThrowOutOfMemory(thread);
-			return 0;
-		}
-		entry->value = newStr;
-		entry->next = table[hash].next;
-		table[hash].next = entry;
+		ILExecThreadThrowOutOfMemory(thread);
+		return 0;
 	}
 
 	/* Return the final string to the caller */
-	return (ILString *)newStr;
+	return (ILString *)value;
 }
 
 ILString *_ILStringInternFromImage(ILExecThread *thread, ILImage *image,
@@ -21,6 +21,7 @@
 #include "engine_private.h"
 #include "lib_defs.h"
 #include "il_utils.h"
+#include "../support/interlocked.h"
 
 #ifdef	__cplusplus
 extern	"C" {
@@ -2156,6 +2157,10 @@ ILObject *_IL_ClrType_GetMemberImpl(ILExecThread *thread,
 	inexactIsAmbig = 0;
 	do
 	{
+		if(_ILClassMembersPending(classInfo))
+		{
+			_ILClassLoadMembers(classInfo);
+		}
 		member = classInfo->firstMember;
 		while(member != 0)
 		{
@@ -2422,6 +2427,10 @@ ILObject *_IL_ClrType_GetMembersImpl(ILExecThread *thread,
 	numFound = 0;
 	do
 	{
+		if(_ILClassMembersPending(classInfo))
+		{
+			_ILClassLoadMembers(classInfo);
+		}
 		member = classInfo->firstMember;
 		while(member != 0)
 		{
@@ -66,11 +66,219 @@ An example of a signature:
 */
 
 #include "engine.h"
+#include "interlocked.h"
 
 #ifdef	__cplusplus
 extern	"C" {
 #endif
 
+/*
+ * Classes, methods and fields that have been found by name are cached
+ * per process, because the engine looks up the same names over and
+ * over again.  Entries are keyed by the addresses of the name strings,
+ * which are almost always constants, so a lookup usually costs a few
+ * pointer comparisons.  Callers that look up names in temporary buffers
+ * use "_ILExecThreadLookupClassUncached", because their entries could
+ * never be found again.  A copy of the names is kept in each entry in
+ * case a caller reuses a buffer for a different name.  Failed lookups
+ * are not cached, because loading another image may change the outcome.
+ *
+ * Entries are never removed or modified once they are in the cache,
+ * so lookups don't need a lock.  New entries are pushed onto the front
+ * of their bucket with a compare-and-exchange.
+ */
+#define	IL_LOOKUP_CACHE_SIZE		256
+#define	IL_LOOKUP_CACHE_MAX			4096
+#define	IL_LOOKUP_CLASS				0
+#define	IL_LOOKUP_METHOD			1
+#define	IL_LOOKUP_FIELD				2
+typedef struct _tagILLookupEntry ILLookupEntry;
+struct _tagILLookupEntry
+{
+	ILLookupEntry  *next;
+	int				kind;
+	const char	   *typeName;
+	const char	   *name;
+	const char	   *signature;
+	void		   *result;
+	char		   *typeCopy;
+	char		   *nameCopy;
+	char		   *signatureCopy;
+
+};
+typedef struct
+{
+	ILLookupEntry * volatile buckets[IL_LOOKUP_CACHE_SIZE];
+	volatile ILInt32 numEntries;
+
+} ILLookupCache;
+
+/*
+ * Compute the bucket for a cache key.
+ */
+static IL_INLINE ILUInt32 LookupHash(int kind, const char *typeName,
+									 const char *name, const char *signature)
+{
+	ILNativeUInt hash = (ILNativeUInt)typeName;
+	hash = hash * 31 + (ILNativeUInt)name;
+	hash = hash * 31 + (ILNativeUInt)signature;
+	hash = (hash >> 4) ^ (hash >> 12) ^ (ILNativeUInt)kind;
+	return (ILUInt32)(hash & (IL_LOOKUP_CACHE_SIZE - 1));
+}
+
+/*
+ * Compare a name against its copy in a cache entry.
+ */
+static IL_INLINE int LookupNameMatch(const char *copy, const char *name)
+{
+	return (!name || !strcmp(copy, name));
+}
+
+/*
+ * Find a previous lookup in the cache.  Returns NULL if not found.
+ */
+static void *LookupCacheFind(ILExecProcess *process, int kind,
+							 const char *typeName, const char *name,
+							 const char *signature)
+{
+	ILLookupCache *cache;
+	ILLookupEntry *entry;
+
+	cache = (ILLookupCache *)ILInterlockedLoadP
+		((void **)&(process->lookupCache));
+	if(!cache)
+	{
+		return 0;
+	}
+	entry = (ILLookupEntry *)ILInterlockedLoadP
+		((void **)&(cache->buckets
+			[LookupHash(kind, typeName, name, signature)]));
+	while(entry != 0)
+	{
+		if(entry->typeName == typeName && entry->name == name &&
+		   entry->signature == signature && entry->kind == kind &&
+		   LookupNameMatch(entry->typeCopy, typeName) &&
+		   LookupNameMatch(entry->nameCopy, name) &&
+		   LookupNameMatch(entry->signatureCopy, signature))
+		{
+			return entry->result;
+		}
+		entry = entry->next;
+	}
+	return 0;
+}
+
+/*
+ * Add the result of a successful lookup to the cache.  The entry
+ * is silently dropped if the cache is full or out of memory.
+ */
+static void LookupCacheAdd(ILExecProcess *process, int kind,
+						   const char *typeName, const char *name,
+						   const char *signature, void *result)
+{
+	ILLookupCache *cache;
+	ILLookupEntry *entry;
+	ILLookupEntry *head;
+	ILLookupEntry * volatile *bucket;
+	ILInt32 numEntries;
+	int typeLen = (typeName ? strlen(typeName) + 1 : 0);
+	int nameLen = (name ? strlen(name) + 1 : 0);
+	int signatureLen = (signature ? strlen(signature) + 1 : 0);
+
+	/* Create the cache the first time */
+	cache = (ILLookupCache *)ILInterlockedLoadP
+		((void **)&(process->lookupCache));
+	if(!cache)
+	{
+		cache = (ILLookupCache *)ILCalloc(1, sizeof(ILLookupCache));
+		if(!cache)
+		{
+			return;
+		}
+		if(ILInterlockedCompareAndExchangeP
+				((void **)&(process->lookupCache), cache, 0) != 0)
+		{
+			/* Another thread created the cache first */
+			ILFree(cache);
+			cache = (ILLookupCache *)(process->lookupCache);
+		}
+	}
+
+	/* Reserve a place for the entry, unless the cache is full */
+	do
+	{
+		numEntries = cache->numEntries;
+		if(numEntries >= IL_LOOKUP_CACHE_MAX)
+		{
+			return;
+		}
+	}
+	while(ILInterlockedCompareAndExchangeI4
+			(&(cache->numEntries), numEntries + 1, numEntries) != numEntries);
+
+	/* Build the entry, with the copies of the names after it */
+	entry = (ILLookupEntry *)ILMalloc
+		(sizeof(ILLookupEntry) + typeLen + nameLen + signatureLen);
+	if(!entry)
+	{
+		return;
+	}
+	entry->kind = kind;
+	entry->typeName = typeName;
+	entry->name = name;
+	entry->signature = signature;
+	entry->result = result;
+	entry->typeCopy = (char *)(entry + 1);
+	entry->nameCopy = entry->typeCopy + typeLen;
+	entry->signatureCopy = entry->nameCopy + nameLen;
+	if(typeName)
+	{
+		ILMemCpy(entry->typeCopy, typeName, typeLen);
+	}
+	if(name)
+	{
+		ILMemCpy(entry->nameCopy, name, nameLen);
+	}
+	if(signature)
+	{
+		ILMemCpy(entry->signatureCopy, signature, signatureLen);
+	}
+
+	/* Publish the entry at the front of its bucket */
+	bucket = &(cache->buckets[LookupHash(kind, typeName, name, signature)]);
+	do
+	{
+		head = *bucket;
+		entry->next = head;
+	}
+	while(ILInterlockedCompareAndExchangeP
+			((void **)bucket, entry, head) != (void *)head);
+}
+
+void _ILLookupCacheDestroy(ILExecProcess *process)
+{
+	ILLookupCache *cache = (ILLookupCache *)(process->lookupCache);
+	ILLookupEntry *entry;
+	ILLookupEntry *next;
+	int bucket;
+
+	if(cache)
+	{
+		for(bucket = 0; bucket < IL_LOOKUP_CACHE_SIZE; ++bucket)
+		{
+			entry = cache->buckets[bucket];
+			while(entry != 0)
+			{
+				next = entry->next;
+				ILFree(entry);
+				entry = next;
+			}
+		}
+		ILFree(cache);
+		process->lookupCache = 0;
+	}
+}
+
 /*
  * Look up a class name that is length-specified.
  */
@@ -180,16 +388,13 @@ ILClass *_ILLookupClass(ILExecProcess *process,
 	return classInfo;
 }
 
-ILClass *ILExecThreadLookupClass(ILExecThread *thread, const char *className)
+/*
+ * Look up a class by name without using the lookup cache.
+ */
+static ILClass *LookupClassByName(ILExecThread *thread, const char *className)
 {
 	ILType *type;
 
-	/* Sanity-check the arguments */
-	if(!thread || !className)
-	{
-		return 0;
-	}
-
 	/* If the class name begins with a type modifier,
 	   then we need to look for a synthetic class */
 	if(*className == '[' || *className == '{' ||
@@ -210,6 +415,44 @@ ILClass *ILExecThreadLookupClass(ILExecThread *thread, const char *className)
 	return LookupClass(thread, className, strlen(className));
 }
 
+ILClass *ILExecThreadLookupClass(ILExecThread *thread, const char *className)
+{
+	ILClass *classInfo;
+
+	/* Sanity-check the arguments */
+	if(!thread || !className)
+	{
+		return 0;
+	}
+
+	/* Have we looked for this class before? */
+	classInfo = (ILClass *)LookupCacheFind
+		(thread->process, IL_LOOKUP_CLASS, className, 0, 0);
+	if(classInfo)
+	{
+		return classInfo;
+	}
+
+	/* Look up the class and remember it for next time */
+	classInfo = LookupClassByName(thread, className);
+	if(classInfo)
+	{
+		LookupCacheAdd(thread->process, IL_LOOKUP_CLASS,
+					   className, 0, 0, classInfo);
+	}
+	return classInfo;
+}
+
+ILClass *_ILExecThreadLookupClassUncached(ILExecThread *thread,
+										 const char *className)
+{
+	if(!thread || !className)
+	{
+		return 0;
+	}
+	return LookupClassByName(thread, className);
+}
+
 ILType *ILExecThreadLookupType(ILExecThread *thread, const char *typeName)
 {
 	int len;
@@ -716,9 +959,30 @@ ILMethod *ILExecThreadLookupMethod(ILExecThread *thread,
 								   const char *signature)
 {
 	ILClass *classInfo;
+	ILMethod *method;
+
+	/* Have we looked for this method before? */
+	if(!thread)
+	{
+		return 0;
+	}
+	method = (ILMethod *)LookupCacheFind
+		(thread->process, IL_LOOKUP_METHOD, typeName, methodName, signature);
+	if(method)
+	{
+		return method;
+	}
+
+	/* Look up the method and remember it for next time */
 	classInfo = ILExecThreadLookupClass(thread, typeName);
-	return ILExecThreadLookupMethodInClass
+	method = ILExecThreadLookupMethodInClass
 			(thread, classInfo, methodName, signature);
+	if(method)
+	{
+		LookupCacheAdd(thread->process, IL_LOOKUP_METHOD,
+					   typeName, methodName, signature, method);
+	}
+	return method;
 }
 
 ILMethod *ILExecThreadLookupMethodInClass(ILExecThread *thread,
@@ -782,9 +1046,30 @@ ILField *ILExecThreadLookupField(ILExecThread *thread,
 								 const char *signature)
 {
 	ILClass *classInfo;
+	ILField *field;
+
+	/* Have we looked for this field before? */
+	if(!thread)
+	{
+		return 0;
+	}
+	field = (ILField *)LookupCacheFind
+		(thread->process, IL_LOOKUP_FIELD, typeName, fieldName, signature);
+	if(field)
+	{
+		return field;
+	}
+
+	/* Look up the field and remember it for next time */
 	classInfo = ILExecThreadLookupClass(thread, typeName);
-	return ILExecThreadLookupFieldInClass
-		(thread, classInfo, fieldName, signature);	
+	field = ILExecThreadLookupFieldInClass
+		(thread, classInfo, fieldName, signature);
+	if(field)
+	{
+		LookupCacheAdd(thread->process, IL_LOOKUP_FIELD,
+					   typeName, fieldName, signature, field);
+	}
+	return field;
 }
 
 ILField *ILExecThreadLookupFieldInClass(ILExecThread *thread,
@@ -26,6 +26,7 @@ See the bottom of this file for documentation on the cache system.
 #include "il_system.h"
 #include "il_align.h"
 #include "il_meta.h"
+#include "interlocked.h"
 
 #ifdef	__cplusplus
 extern	"C" {
@@ -53,9 +54,8 @@ struct _tagILCacheDebug
 };
 
 /*
- * Method information block, organised as a red-black tree node.
- * There may be more than one such block associated with a method
- * if the method contains exception regions.
+ * Method information block.  There may be more than one such block
+ * associated with a method if the method contains exception regions.
  */
 typedef struct _tagILCacheMethod ILCacheMethod;
 struct _tagILCacheMethod
@@ -65,11 +65,74 @@ struct _tagILCacheMethod
 	unsigned char  *start;			/* Start of the region */
 	unsigned char  *end;			/* End of the region */
 	ILCacheDebug   *debug;			/* Debug information for method */
-	ILCacheMethod  *left;			/* Left sub-tree and red/black bit */
-	ILCacheMethod  *right;			/* Right sub-tree */
+	ILCacheMethod  *next;			/* Next region while translating */
 
 };
 
+/*
+ * List of the method regions within a cache page, in address order.
+ * The start of each region is copied into the list so that searching
+ * it doesn't touch the region blocks.  Unused entries at the end of
+ * the list start at IL_CACHE_UNUSED, so readers don't need to fetch
+ * "count".  When the list is full, it is copied into a larger one and
+ * the old copy is kept on the "retired" chain because a reader may
+ * still be looking at it.  Retired lists are freed with the cache.
+ */
+typedef struct
+{
+	unsigned char     *start;		/* Start of the region */
+	ILCacheMethod     *region;		/* Region information block */
+
+} ILCacheRegionEntry;
+typedef struct _tagILCacheRegionList ILCacheRegionList;
+struct _tagILCacheRegionList
+{
+	ILCacheRegionList *retired;		/* Previous copy of the list */
+	ILInt32			   size;		/* Maximum number of regions */
+	ILInt32			   count;		/* Number of regions, for writers */
+	ILCacheRegionEntry regions[1];	/* The regions, sorted by start */
+
+};
+#define	IL_CACHE_UNUSED		((unsigned char *)(~((ILNativeUInt)0)))
+
+/*
+ * Information about a cache page, for lookups by address.
+ */
+typedef struct _tagILCachePage ILCachePage;
+struct _tagILCachePage
+{
+	unsigned char     *start;		/* Start of the page */
+	unsigned char     *end;			/* End of the page */
+	ILCacheRegionList *regions;		/* Regions within the page */
+
+};
+
+/*
+ * Map of all cache pages, sorted by address.  A new map is built
+ * and the old one retired whenever a page is added to the cache.
+ * The start of each page is copied into the map so that searching
+ * it doesn't touch the page information blocks.
+ */
+typedef struct
+{
+	unsigned char     *start;		/* Start of the page */
+	ILCachePage       *page;		/* Information about the page */
+
+} ILCachePageMapEntry;
+typedef struct _tagILCachePageMap ILCachePageMap;
+struct _tagILCachePageMap
+{
+	ILCachePageMap    *retired;		/* Previous copy of the map */
+	unsigned long      numPages;	/* Number of pages in the map */
+	ILCachePageMapEntry pages[1];	/* The pages, sorted by start */
+
+};
+
+/*
+ * Initial size of the region list for a page.
+ */
+#define	IL_CACHE_REGION_LIST_SIZE	64
+
 /*
  * Structure of the method cache.
  */
@@ -85,8 +148,8 @@ struct _tagILCache
 	int				  needRestart;	/* True when page restart is required */
 	long			  pagesLeft;	/* Number of pages left to allocate */
 	ILCacheMethod    *method;		/* Information for the current method */
-	ILCacheMethod	  head;			/* Head of the lookup tree */
-	ILCacheMethod	  nil;			/* Nil pointer for the lookup tree */
+	ILCachePageMap   *pageMap;		/* Map of pages for lookups by address */
+	ILCachePage      *lastPage;		/* Page that methods are written to */
 	unsigned char    *start;		/* Start of the current method */
 	unsigned char	  debugData[IL_CACHE_DEBUG_SIZE];
 	int				  debugLen;		/* Length of temporary debug data */
@@ -95,6 +158,89 @@ struct _tagILCache
 
 };
 
+/*
+ * Create an empty region list with room for "size" regions.
+ */
+static ILCacheRegionList *CreateRegionList(ILInt32 size)
+{
+	ILCacheRegionList *list;
+	ILInt32 posn;
+
+	list = (ILCacheRegionList *)ILMalloc
+		(sizeof(ILCacheRegionList) + (size - 1) * sizeof(ILCacheRegionEntry));
+	if(!list)
+	{
+		return 0;
+	}
+	list->retired = 0;
+	list->size = size;
+	list->count = 0;
+	for(posn = 0; posn < size; ++posn)
+	{
+		list->regions[posn].start = IL_CACHE_UNUSED;
+		list->regions[posn].region = 0;
+	}
+	return list;
+}
+
+/*
+ * Add a newly allocated cache page to the page map.
+ * Returns zero if out of memory.
+ */
+static int AddToPageMap(ILCache *cache, void *ptr)
+{
+	ILCachePageMap *map = cache->pageMap;
+	ILCachePageMap *newMap;
+	ILCachePage *page;
+	unsigned long numPages = (map ? map->numPages : 0);
+	unsigned long posn;
+
+	/* Create the page information block */
+	page = (ILCachePage *)ILMalloc(sizeof(ILCachePage));
+	if(!page)
+	{
+		return 0;
+	}
+	page->start = (unsigned char *)ptr;
+	page->end = page->start + cache->pageSize;
+	page->regions = CreateRegionList(IL_CACHE_REGION_LIST_SIZE);
+	if(!(page->regions))
+	{
+		ILFree(page);
+		return 0;
+	}
+
+	/* Build a new map with the page inserted in address order */
+	newMap = (ILCachePageMap *)ILMalloc
+		(sizeof(ILCachePageMap) + numPages * sizeof(ILCachePageMapEntry));
+	if(!newMap)
+	{
+		ILFree(page->regions);
+		ILFree(page);
+		return 0;
+	}
+	posn = 0;
+	while(posn < numPages && map->pages[posn].start < page->start)
+	{
+		newMap->pages[posn] = map->pages[posn];
+		++posn;
+	}
+	newMap->pages[posn].start = page->start;
+	newMap->pages[posn].page = page;
+	while(posn < numPages)
+	{
+		newMap->pages[posn + 1] = map->pages[posn];
+		++posn;
+	}
+	newMap->numPages = numPages + 1;
+	newMap->retired = map;
+
+	/* Publish the new map to readers */
+	ILInterlockedStoreP_Release((void **)&(cache->pageMap), newMap);
+	cache->lastPage = page;
+	return 1;
+}
+
 /*
  * Allocate a cache page and add it to the cache.
  */
@@ -133,6 +279,11 @@ static void AllocCachePage(ILCache *cache)
 		return;
 	}
 	cache->pages = list;
+	if(!AddToPageMap(cache, ptr))
+	{
+		ILPageFree(ptr, cache->pageSize);
+		goto failAlloc;
+	}
 	list[(cache->numPages)++] = ptr;
 
 	/* One less page before we hit the limit */
@@ -147,183 +298,159 @@ static void AllocCachePage(ILCache *cache)
 }
 
 /*
- * Get or set the sub-trees of a node.
+ * Make sure that the region list for the page that methods are
+ * being written to has room for "num" more regions.  Returns
+ * zero if out of memory.
  */
-#define	GetLeft(node)	\
-	((ILCacheMethod *)(((ILNativeUInt)((node)->left)) & ~((ILNativeUInt)1)))
-#define	GetRight(node)	((node)->right)
-#define	SetLeft(node,value)	\
-	((node)->left = (ILCacheMethod *)(((ILNativeUInt)(value)) | \
-						(((ILNativeUInt)((node)->left)) & ((ILNativeUInt)1))))
-#define	SetRight(node,value)	\
-			((node)->right = (value))
+static int ReserveRegions(ILCache *cache, ILInt32 num)
+{
+	ILCachePage *page = cache->lastPage;
+	ILCacheRegionList *list = page->regions;
+	ILCacheRegionList *newList;
+	ILInt32 size;
 
-/*
- * Get or set the red/black state of a node.
- */
-#define	GetRed(node)	\
-	((((ILNativeUInt)((node)->left)) & ((ILNativeUInt)1)) != 0)
-#define	SetRed(node)	\
-	((node)->left = (ILCacheMethod *)(((ILNativeUInt)((node)->left)) | \
-									  ((ILNativeUInt)1)))
-#define	SetBlack(node)	\
-	((node)->left = (ILCacheMethod *)(((ILNativeUInt)((node)->left)) & \
-									  ~((ILNativeUInt)1)))
+	/* Bail out if there is already enough room */
+	if((list->size - list->count) >= num)
+	{
+		return 1;
+	}
+
+	/* Copy the regions into a larger list */
+	size = list->size * 2;
+	while((size - list->count) < num)
+	{
+		size *= 2;
+	}
+	newList = CreateRegionList(size);
+	if(!newList)
+	{
+		return 0;
+	}
+	ILMemCpy(newList->regions, list->regions,
+			 list->count * sizeof(ILCacheRegionEntry));
+	newList->retired = list;
+	newList->count = list->count;
+
+	/* Publish the new list to readers */
+	ILInterlockedStoreP_Release((void **)&(page->regions), newList);
+	return 1;
+}
 
 /*
- * Compare a key against a node, being careful of sentinel nodes.
+ * Add the region blocks for a method to the lookup index.  The blocks
+ * are chained in reverse order through "next".  Space must have been
+ * reserved with "ReserveRegions" beforehand.
  */
-static int CacheCompare(ILCache *cache, unsigned char *key,
-						ILCacheMethod *node)
+static void AddToLookupIndex(ILCache *cache, ILCacheMethod *method)
 {
-	if(node == &(cache->nil) || node == &(cache->head))
+	ILCacheRegionList *list = cache->lastPage->regions;
+	ILCacheMethod *prev = 0;
+	ILCacheMethod *next;
+	ILInt32 count;
+
+	/* Reverse the chain so that the regions are in address order */
+	while(method != 0)
 	{
-		/* Every key is greater than the sentinel nodes */
-		return 1;
+		next = method->next;
+		method->next = prev;
+		prev = method;
+		method = next;
 	}
-	else
+
+	/* Publish the non-empty regions to readers.  The start is stored
+	   last because that is what makes the entry visible to searches */
+	count = list->count;
+	for(method = prev; method != 0; method = method->next)
 	{
-		/* Compare a regular node */
-		if(key < node->start)
-		{
-			return -1;
-		}
-		else if(key > node->start)
-		{
-			return 1;
-		}
-		else
+		if(method->start < method->end)
 		{
-			return 0;
+			list->regions[count].region = method;
+			ILInterlockedStoreP_Release
+				((void **)&(list->regions[count].start), method->start);
+			++count;
 		}
 	}
+	list->count = count;
 }
 
 /*
- * Rotate a sub-tree around a specific node.
+ * Find the region block that contains a particular address.  This
+ * does not take any locks and may run while another thread adds
+ * methods to the cache.  Returns NULL if not found.
  */
-static ILCacheMethod *CacheRotate(ILCache *cache, unsigned char *key,
-								  ILCacheMethod *around)
+static ILCacheMethod *FindRegion(ILCache *cache, unsigned char *pc)
 {
-	ILCacheMethod *child, *grandChild;
-	int setOnLeft;
-	if(CacheCompare(cache, key, around) < 0)
-	{
-		child = GetLeft(around);
-		setOnLeft = 1;
-	}
-	else
-	{
-		child = GetRight(around);
-		setOnLeft = 0;
-	}
-	if(CacheCompare(cache, key, child) < 0)
+	ILCachePageMap *map;
+	ILCachePage *page;
+	ILCacheRegionList *list;
+	ILCacheMethod *region;
+	unsigned long left, right, middle;
+	ILInt32 low, high, mid;
+
+	/* Find the page that contains the address */
+	map = (ILCachePageMap *)ILInterlockedLoadP((void **)&(cache->pageMap));
+	if(!map)
 	{
-		grandChild = GetLeft(child);
-		SetLeft(child, GetRight(grandChild));
-		SetRight(grandChild, child);
+		return 0;
 	}
-	else
+	left = 0;
+	right = map->numPages;
+	while(left < right)
 	{
-		grandChild = GetRight(child);
-		SetRight(child, GetLeft(grandChild));
-		SetLeft(grandChild, child);
+		middle = left + (right - left) / 2;
+		if(pc < map->pages[middle].start)
+		{
+			right = middle;
+		}
+		else
+		{
+			left = middle + 1;
+		}
 	}
-	if(setOnLeft)
+	if(left == 0)
 	{
-		SetLeft(around, grandChild);
+		return 0;
 	}
-	else
+	page = map->pages[left - 1].page;
+	if(pc >= page->end)
 	{
-		SetRight(around, grandChild);
+		return 0;
 	}
-	return grandChild;
-}
-
-/*
- * Split a red-black tree at the current position.
- */
-#define	Split()		\
-			do { \
-				SetRed(temp); \
-				SetBlack(GetLeft(temp)); \
-				SetBlack(GetRight(temp)); \
-				if(GetRed(parent)) \
-				{ \
-					SetRed(grandParent); \
-					if((CacheCompare(cache, key, grandParent) < 0) != \
-							(CacheCompare(cache, key, parent) < 0)) \
-					{ \
-						parent = CacheRotate(cache, key, grandParent); \
-					} \
-					temp = CacheRotate(cache, key, greatGrandParent); \
-					SetBlack(temp); \
-				} \
-			} while (0)
 
-/*
- * Add a method region block to the red-black lookup tree
- * that is associated with a method cache.
- */
-static void AddToLookupTree(ILCache *cache, ILCacheMethod *method)
-{
-	unsigned char *key = method->start;
-	ILCacheMethod *temp;
-	ILCacheMethod *greatGrandParent;
-	ILCacheMethod *grandParent;
-	ILCacheMethod *parent;
-	ILCacheMethod *nil = &(cache->nil);
-	int cmp;
-
-	/* Search for the insert position */
-	temp = &(cache->head);
-	greatGrandParent = temp;
-	grandParent = temp;
-	parent = temp;
-	while(temp != nil)
-	{
-		/* Adjust our ancestor pointers */
-		greatGrandParent = grandParent;
-		grandParent = parent;
-		parent = temp;
-
-		/* Compare the key against the current node */
-		cmp = CacheCompare(cache, key, temp);
-		if(cmp == 0)
-		{
-			/* This is a duplicate, which normally shouldn't happen.
-			   If it does happen, then ignore the node and bail out */
-			return;
-		}
-		else if(cmp < 0)
+	/* Find the last region in the page that starts at or before "pc".
+	   A thread can only have a "pc" within a method after the method
+	   was published, so the region block will be visible by then */
+	list = (ILCacheRegionList *)ILInterlockedLoadP((void **)&(page->regions));
+	low = 0;
+	high = list->size;
+	while(low < high)
+	{
+		mid = low + (high - low) / 2;
+		if(pc < (unsigned char *)ILInterlockedLoadP
+					((void **)&(list->regions[mid].start)))
 		{
-			temp = GetLeft(temp);
+			high = mid;
 		}
 		else
 		{
-			temp = GetRight(temp);
-		}
-
-		/* Do we need to split this node? */
-		if(GetRed(GetLeft(temp)) && GetRed(GetRight(temp)))
-		{
-			Split();
+			low = mid + 1;
 		}
 	}
-
-	/* Insert the new node into the current position */
-	method->left = (ILCacheMethod *)(((ILNativeUInt)nil) | ((ILNativeUInt)1));
-	method->right = nil;
-	if(CacheCompare(cache, key, parent) < 0)
+	if(low == 0)
 	{
-		SetLeft(parent, method);
+		return 0;
 	}
-	else
+	region = (ILCacheMethod *)ILInterlockedLoadP
+		((void **)&(list->regions[low - 1].region));
+	if(!region)
+	{
+		return 0;
+	}
+	if(pc >= region->end)
 	{
-		SetRight(parent, method);
+		return 0;
 	}
-	Split();
-	SetBlack(cache->head.right);
+	return region;
 }
 
 /*
@@ -429,20 +556,8 @@ ILCache *_ILCacheCreate(long limit, unsigned long cachePageSize)
 		cache->pagesLeft = -1;
 	}
 	cache->method = 0;
-	cache->nil.method = 0;
-	cache->nil.cookie = 0;
-	cache->nil.start = 0;
-	cache->nil.end = 0;
-	cache->nil.debug = 0;
-	cache->nil.left = &(cache->nil);
-	cache->nil.right = &(cache->nil);
-	cache->head.method = 0;
-	cache->head.cookie = 0;
-	cache->head.start = 0;
-	cache->head.end = 0;
-	cache->head.debug = 0;
-	cache->head.left = 0;
-	cache->head.right = &(cache->nil);
+	cache->pageMap = 0;
+	cache->lastPage = 0;
 	cache->start = 0;
 	cache->debugLen = 0;
 	cache->firstDebug = 0;
@@ -463,6 +578,33 @@ ILCache *_ILCacheCreate(long limit, unsigned long cachePageSize)
 void _ILCacheDestroy(ILCache *cache)
 {
 	unsigned long page;
+	ILCachePageMap *map;
+	ILCachePageMap *nextMap;
+	ILCacheRegionList *list;
+	ILCacheRegionList *nextList;
+
+	/* Free the lookup index, including the retired copies */
+	map = cache->pageMap;
+	if(map)
+	{
+		for(page = 0; page < map->numPages; ++page)
+		{
+			list = map->pages[page].page->regions;
+			while(list != 0)
+			{
+				nextList = list->retired;
+				ILFree(list);
+				list = nextList;
+			}
+			ILFree(map->pages[page].page);
+		}
+	}
+	while(map != 0)
+	{
+		nextMap = map->retired;
+		ILFree(map);
+		map = nextMap;
+	}
 
 	/* Free all of the cache pages */
 	for(page = 0; page < cache->numPages; ++page)
@@ -539,8 +681,7 @@ void *_ILCacheStartMethod(ILCache *cache, ILCachePosn *posn,
 		cache->method->start = posn->ptr;
 		cache->method->end = posn->ptr;
 		cache->method->debug = 0;
-		cache->method->left = 0;
-		cache->method->right = 0;
+		cache->method->next = 0;
 	}
 	cache->start = posn->ptr;
 
@@ -557,7 +698,7 @@ int _ILCacheEndMethod(ILCachePosn *posn)
 {
 	ILCache *cache = posn->cache;
 	ILCacheMethod *method;
-	ILCacheMethod *next;
+	ILInt32 numRegions;
 
 	/* Determine if we ran out of space while writing the method */
 	if(posn->ptr >= posn->limit)
@@ -588,24 +729,36 @@ int _ILCacheEndMethod(ILCachePosn *posn)
 		}
 	}
 
-	/* Flush the position information back to the cache */
-	cache->freeStart = posn->ptr;
-	cache->freeEnd = posn->limit;
-
-	/* Update the last method region block and then
-	   add all method regions to the lookup tree */
+	/* Update the last method region block and make sure
+	   that there is room for the regions in the lookup index */
 	method = cache->method;
 	if(method)
 	{
 		method->end = posn->ptr;
+		numRegions = 0;
 		do
 		{
 			method->debug = cache->firstDebug;
-			next = method->right;
-			AddToLookupTree(cache, method);
-			method = next;
+			++numRegions;
+			method = method->next;
 		}
 		while(method != 0);
+		if(!ReserveRegions(cache, numRegions))
+		{
+			cache->method = 0;
+			cache->outOfMemory = 1;
+			return IL_CACHE_END_TOO_BIG;
+		}
+	}
+
+	/* Flush the position information back to the cache */
+	cache->freeStart = posn->ptr;
+	cache->freeEnd = posn->limit;
+
+	/* Add all method regions to the lookup index */
+	if(cache->method)
+	{
+		AddToLookupIndex(cache, cache->method);
 		cache->method = 0;
 	}
 
@@ -739,9 +892,10 @@ void _ILCacheNewRegion(ILCachePosn *posn, void *cookie)
 	newMethod->start = posn->ptr;
 	newMethod->end = posn->ptr;
 
+	newMethod->debug = 0;
+
 	/* Attach the new region to the cache */
-	newMethod->left = 0;
-	newMethod->right = method;
+	newMethod->next = method;
 	posn->cache->method = newMethod;
 }
 
@@ -755,98 +909,63 @@ void _ILCacheSetCookie(ILCachePosn *posn, void *cookie)
 
 void *_ILCacheGetMethod(ILCache *cache, void *pc, void **cookie)
 {
-	ILCacheMethod *node = cache->head.right;
-	while(node != &(cache->nil))
+	ILCacheMethod *node = FindRegion(cache, (unsigned char *)pc);
+	if(node)
 	{
-		if(((unsigned char *)pc) < node->start)
-		{
-			node = GetLeft(node);
-		}
-		else if(((unsigned char *)pc) >= node->end)
+		if(cookie)
 		{
-			node = GetRight(node);
-		}
-		else
-		{
-			if(cookie)
-			{
-				*cookie = node->cookie;
-			}
-			return node->method;
+			*cookie = node->cookie;
 		}
+		return node->method;
 	}
 	return 0;
 }
 
 /*
- * Count the number of methods in a sub-tree.
- */
-static unsigned long CountMethods(ILCacheMethod *node,
-								  ILCacheMethod *nil,
-								  void **prev)
-{
-	unsigned long num;
-
-	/* Bail out if we've reached a leaf */
-	if(node == nil)
-	{
-		return 0;
-	}
-
-	/* Count the number of methods in the left sub-tree */
-	num = CountMethods(GetLeft(node), nil, prev);
-
-	/* Process the current node */
-	if(node->method != 0 && node->method != *prev)
-	{
-		++num;
-		*prev = node->method;
-	}
-
-	/* Count the number of methods in the right sub-tree */
-	return num + CountMethods(GetRight(node), nil, prev);
-}
-
-/*
- * Fill a list with methods.
+ * Walk the regions in the cache in address order and collect the
+ * distinct methods into "list", if it is not NULL.  Returns the
+ * number of distinct methods.
  */
-static unsigned long FillMethodList(void **list,
-									ILCacheMethod *node,
-								    ILCacheMethod *nil,
-								    void **prev)
+static unsigned long VisitMethods(ILCache *cache, void **list)
 {
-	unsigned long num;
+	ILCachePageMap *map = cache->pageMap;
+	ILCacheRegionList *regions;
+	unsigned long page;
+	ILInt32 posn;
+	void *prev = 0;
+	unsigned long num = 0;
 
-	/* Bail out if we've reached a leaf */
-	if(node == nil)
+	if(!map)
 	{
 		return 0;
 	}
-
-	/* Process the methods in the left sub-tree */
-	num = FillMethodList(list, GetLeft(node), nil, prev);
-
-	/* Process the current node */
-	if(node->method != 0 && node->method != *prev)
+	for(page = 0; page < map->numPages; ++page)
 	{
-		list[num] = node->method;
-		++num;
-		*prev = node->method;
+		regions = map->pages[page].page->regions;
+		for(posn = 0; posn < regions->count; ++posn)
+		{
+			void *method = regions->regions[posn].region->method;
+			if(method != 0 && method != prev)
+			{
+				if(list)
+				{
+					list[num] = method;
+				}
+				++num;
+				prev = method;
+			}
+		}
 	}
-
-	/* Process the methods in the right sub-tree */
-	return num + FillMethodList(list + num, GetRight(node), nil, prev);
+	return num;
 }
 
 void **_ILCacheGetMethodList(ILCache *cache)
 {
-	void *prev;
 	unsigned long num;
 	void **list;
 
-	/* Count the number of distinct methods in the tree */
-	prev = 0;
-	num = CountMethods(cache->head.right, &(cache->nil), &prev);
+	/* Count the number of distinct methods in the cache */
+	num = VisitMethods(cache, 0);
 
 	/* Allocate a list to hold all of the method descriptors */
 	list = (void **)ILMalloc((num + 1) * sizeof(void *));
@@ -856,8 +975,7 @@ void **_ILCacheGetMethodList(ILCache *cache)
 	}
 
 	/* Fill the list with methods and then return it */
-	prev = 0;
-	FillMethodList(list, cache->head.right, &(cache->nil), &prev);
+	VisitMethods(cache, list);
 	list[num] = 0;
 	return list;
 }
@@ -877,28 +995,17 @@ typedef struct
  */
 static void InitDebugIter(ILCacheDebugIter *iter, ILCache *cache, void *start)
 {
-	ILCacheMethod *node = cache->head.right;
-	while(node != &(cache->nil))
+	ILCacheMethod *node = FindRegion(cache, (unsigned char *)start);
+	if(node)
 	{
-		if(((unsigned char *)start) < node->start)
-		{
-			node = GetLeft(node);
-		}
-		else if(((unsigned char *)start) >= node->end)
-		{
-			node = GetRight(node);
-		}
-		else
+		iter->list = node->debug;
+		if(iter->list)
 		{
-			iter->list = node->debug;
-			if(iter->list)
-			{
-				iter->reader.data = (unsigned char *)(iter->list + 1);
-				iter->reader.len = IL_CACHE_DEBUG_SIZE;
-				iter->reader.error = 0;
-			}
-			return;
+			iter->reader.data = (unsigned char *)(iter->list + 1);
+			iter->reader.len = IL_CACHE_DEBUG_SIZE;
+			iter->reader.error = 0;
 		}
+		return;
 	}
 	iter->list = 0;
 }
@@ -1080,10 +1187,13 @@ with it.  These blocks indicate the start and end of regions within the
 method.  Normally these regions correspond to exception "try" blocks, or
 regular code between "try" blocks.
 
-The ILCacheMethod blocks are organised into a red-black tree, which
-is used to perform fast lookups by address (ILCacheGetMethod).  These
-lookups are used when walking the stack during exceptions or security
-processing.
+The ILCacheMethod blocks are indexed by a sorted map of cache pages,
+each of which holds a sorted list of the regions within that page.
+Methods are only ever written at increasing addresses in the newest
+page, so new regions are appended to the end of that page's list.
+The index is used to perform fast lookups by address (ILCacheGetMethod).
+These lookups are used when walking the stack during exceptions or
+security processing.
 
 Each method can also have offset information associated with it, to map
 between native code addresses and offsets within the original bytecode.
@@ -1093,10 +1203,16 @@ as auxillary data, attached to the ILCacheMethod block.
 Threading issues
 ----------------
 
-Writing a method to the cache, querying a method by address, or querying
-offset information for a method, are not thread-safe.  The caller should
-arrange for a cache lock to be acquired prior to performing these
-operations.
+Writing a method to the cache is not thread-safe.  The caller should
+arrange for a cache lock to be acquired prior to writing a method.
+
+Querying a method by address, or querying offset information for a
+method, does not need a lock and may be performed while another thread
+is writing a method.  The page map and region lists are never modified
+in place once readers can see them, other than by filling in an unused
+entry at the end of a region list.  When a list must grow, it
+is copied and the new copy is published, and the old copy is kept
+until the cache is destroyed because a reader may still be using it.
 
 Executing methods from the cache is thread-safe, as the method code is
 fixed in place once it has been written.
@@ -34,20 +34,98 @@ extern	"C" {
 
 #ifdef IL_CONFIG_USE_THIN_LOCKS
 
-#define DEFAULT_HASHTABLE_SIZE		(523)
+/*
+ * The monitor table is split into a fixed number of stripes, each with
+ * its own lock and its own bucket array.  Lookups of objects that already
+ * have an entry don't take any lock at all.  Only the insertion of new
+ * entries and the growing of a stripe are serialized by the stripe lock.
+ * IL_MONITOR_TABLE_STRIPES and IL_MONITOR_STRIPE_INITIAL_SIZE must be
+ * powers of 2.
+ */
+#define IL_MONITOR_TABLE_STRIPE_BITS	(4)
+#define IL_MONITOR_TABLE_STRIPES		(1 << IL_MONITOR_TABLE_STRIPE_BITS)
+#define IL_MONITOR_STRIPE_INITIAL_SIZE	(32)
+
+/*
+ * Average chain length at which a stripe is rehashed.
+ */
+#define IL_MONITOR_STRIPE_LOAD_FACTOR	(2)
 
 /*
  *	An entry in the monitor Hashtable.
+ *
+ *	The obj member is a weak reference and is zeroed by the GC if the object
+ *	is collected.  Such entries are called "ghosts" and are either reused
+ *	for other objects or dropped when the stripe is rehashed.
  */
 typedef struct _tagILMonitorEntry ILMonitorEntry;
 
 struct _tagILMonitorEntry
 {
-	volatile ILObject *obj;
+	ILObject * volatile obj;
 	volatile ILLockWord lockWord;
-	volatile ILMonitorEntry *next;
+	ILMonitorEntry * volatile next;
+};
+
+/*
+ * Layout of an ILMonitorEntry for the GC.  Only lockWord and next
+ * are scanned so that the entry doesn't keep the object alive.
+ */
+#define IL_MONITOR_ENTRY_BITMAP			(0x06)
+#define IL_MONITOR_ENTRY_BITMAP_LEN		(3)
+
+/*
+ * Bucket array of a stripe.  A stripe's bucket array is replaced as a
+ * whole when the stripe grows so that lock-free readers always see a
+ * consistent size.
+ */
+typedef struct _tagILMonitorBuckets ILMonitorBuckets;
+
+struct _tagILMonitorBuckets
+{
+	ILUInt32 size;
+	ILMonitorEntry * volatile entries[1];
 };
 
+/*
+ * A stripe of the monitor table.
+ */
+typedef struct _tagILMonitorStripe ILMonitorStripe;
+
+struct _tagILMonitorStripe
+{
+	ILMutex *lock;
+	ILMonitorBuckets * volatile buckets;
+	ILUInt32 count;
+};
+
+/*
+ * The monitor table of a process.
+ */
+typedef struct _tagILMonitorTable ILMonitorTable;
+
+struct _tagILMonitorTable
+{
+	ILNativeInt entryDescriptor;
+	ILMonitorStripe stripes[IL_MONITOR_TABLE_STRIPES];
+};
+
+/*
+ * Allocate a zeroed bucket array with the given number of buckets.
+ */
+static ILMonitorBuckets *MonitorBucketsCreate(ILUInt32 size)
+{
+	ILMonitorBuckets *buckets;
+
+	buckets = (ILMonitorBuckets *)ILGCAlloc(sizeof(ILMonitorBuckets) +
+							(size - 1) * sizeof(ILMonitorEntry *));
+	if(buckets)
+	{
+		buckets->size = size;
+	}
+	return buckets;
+}
+
 #endif /* IL_CONFIG_USE_THIN_LOCKS */
 
 /*
@@ -56,24 +134,33 @@ struct _tagILMonitorEntry
 int _ILExecMonitorProcessCreate(ILExecProcess *process)
 {
 #ifdef IL_CONFIG_USE_THIN_LOCKS	
-	ILMonitorEntry **table;
+	ILMonitorTable *table;
+	ILNativeUInt bitmap = IL_MONITOR_ENTRY_BITMAP;
+	int stripe;
 
-	/* Initialize the monitor system lock */
-	process->monitorSystemLock = ILMutexCreate();
-	
-	if(!(process->monitorSystemLock))
-	{		
+	table = (ILMonitorTable *)ILGCAlloc(sizeof(ILMonitorTable));
+
+	if (table == 0)
+	{
 		return 0;
 	}
 
-	table = (ILMonitorEntry **)ILGCAlloc(sizeof(ILMonitorEntry *)
-		* DEFAULT_HASHTABLE_SIZE);
+	table->entryDescriptor =
+		ILGCCreateTypeDescriptor(&bitmap, IL_MONITOR_ENTRY_BITMAP_LEN);
 
-	if (table == 0)
+	for(stripe = 0; stripe < IL_MONITOR_TABLE_STRIPES; ++stripe)
 	{
-		ILMutexDestroy(process->monitorSystemLock);
+		table->stripes[stripe].buckets =
+			MonitorBucketsCreate(IL_MONITOR_STRIPE_INITIAL_SIZE);
+		table->stripes[stripe].lock = ILMutexCreate();
+		if(!(table->stripes[stripe].buckets) || !(table->stripes[stripe].lock))
+		{
+			process->monitorTable = table;
+			_ILExecMonitorProcessDestroy(process);
+			process->monitorTable = 0;
 
-		return 0;
+			return 0;
+		}
 	}
 
 	process->monitorTable = table;
@@ -90,9 +177,19 @@ int _ILExecMonitorProcessCreate(ILExecProcess *process)
 int _ILExecMonitorProcessDestroy(ILExecProcess *process)
 {
 #ifdef IL_CONFIG_USE_THIN_LOCKS
-	if (process->monitorSystemLock)
+	ILMonitorTable *table = (ILMonitorTable *)process->monitorTable;
+	int stripe;
+
+	if(table)
 	{
-		ILMutexDestroy(process->monitorSystemLock);
+		for(stripe = 0; stripe < IL_MONITOR_TABLE_STRIPES; ++stripe)
+		{
+			if(table->stripes[stripe].lock)
+			{
+				ILMutexDestroy(table->stripes[stripe].lock);
+				table->stripes[stripe].lock = 0;
+			}
+		}
 	}
 	return 1;
 #else
@@ -142,113 +239,219 @@ ILExecMonitor *_ILExecMonitorCreate(void)
 #ifdef IL_CONFIG_USE_THIN_LOCKS
 
 /*
- *	Gets a pointer to the WaitHandle object used by the object.
+ * Hash an object pointer.  The low bits select the stripe and the
+ * remaining bits select the bucket within the stripe.
  */
-static IL_INLINE ILLockWord *GetObjectLockWordPtr(ILExecThread *thread, ILObject *obj)
+static IL_INLINE ILUInt32 MonitorHash(ILObject *obj)
 {
-	ILNativeInt x;
-	volatile ILMonitorEntry **table, *entry, *preventry, *ghost, *ghostparent;
+	ILNativeUInt x = (ILNativeUInt)obj;
 
-	ILMutexLock(thread->process->monitorSystemLock);
+	/* Objects are at least 8 byte aligned */
+	x >>= 3;
+#ifdef IL_NATIVE_INT64
+	x ^= (x >> 32);
+#endif
+	x ^= (x >> 15);
 
-	table = thread->process->monitorTable;
+	return (ILUInt32)x * 0x9E3779B1U;
+}
 
-	/* Get the hashtable index */
+#define	MonitorStripeIndex(hash)	\
+	((hash) >> (32 - IL_MONITOR_TABLE_STRIPE_BITS))
+#define	MonitorBucketIndex(hash, size)	\
+	((hash) & ((size) - 1))
 
-	x = (ILNativeInt)obj;
-	
-	x = x ^ (x / sizeof(int));
-	
-	x %= DEFAULT_HASHTABLE_SIZE;
-	
-	entry = table[x];
-	
-	ghost = 0;
-	ghostparent = 0;
-	preventry = 0;
+/*
+ * Search a bucket array for the entry of an object without locking.
+ * This may miss an entry that is concurrently moved by a rehash, in
+ * which case the caller has to repeat the search with the stripe locked.
+ *
+ * All writers publish with release semantics and every load here depends
+ * on the address loaded before, so relaxed loads are sufficient and we
+ * avoid a full memory barrier per chain link.
+ */
+static IL_INLINE ILMonitorEntry *MonitorFindEntry(ILMonitorBuckets *buckets,
+												  ILUInt32 hash, ILObject *obj)
+{
+	ILMonitorEntry *entry;
 
-	for (;;)
+	entry = (ILMonitorEntry *)ILInterlockedLoadP
+		((void **)&(buckets->entries[MonitorBucketIndex(hash, buckets->size)]));
+	while(entry != 0)
 	{
-		if (entry == 0)
+		if(ILInterlockedLoadP((void **)&(entry->obj)) == (void *)obj)
 		{
-			if (ghost == 0)
-			{					
-				/* No ghost found.  Create a whole new entry. */
-
-				if ((entry = (ILMonitorEntry *)ILGCAlloc(sizeof(ILMonitorEntry))) == 0)
-				{
-					ILMutexUnlock(thread->process->monitorSystemLock);
+			return entry;
+		}
+		entry = (ILMonitorEntry *)ILInterlockedLoadP((void **)&(entry->next));
+	}
+	return 0;
+}
 
-					ILExecThreadThrowOutOfMemory(thread);
+/*
+ * Double the number of buckets in a stripe and drop all ghosts.
+ * The stripe lock must be held by the caller.
+ */
+static void MonitorStripeGrow(ILMonitorStripe *stripe)
+{
+	ILMonitorBuckets *oldBuckets = stripe->buckets;
+	ILMonitorBuckets *newBuckets;
+	ILMonitorEntry *entry;
+	ILMonitorEntry *next;
+	ILUInt32 index;
+	ILUInt32 bucket;
+
+	newBuckets = MonitorBucketsCreate(oldBuckets->size * 2);
+	if(!newBuckets)
+	{
+		/* Keep on using the longer chains */
+		return;
+	}
 
-					return 0;
-				}
+	/* Relink the entries into the new buckets.  Lock-free readers on the
+	   old bucket array will see only complete chains and fall back to
+	   the locked search if they miss an entry */
+	for(index = 0; index < oldBuckets->size; ++index)
+	{
+		entry = oldBuckets->entries[index];
+		while(entry != 0)
+		{
+			next = entry->next;
+			if(entry->obj == 0)
+			{
+				/* Drop the ghost */
+				ILGCUnregisterWeak((void *)&(entry->obj));
+				--(stripe->count);
 			}
 			else
 			{
-				/* Use the entry that no longer points
-				to a live object */
-
-				entry = ghost;
-
-				/* Remove ghost from list */
-				if (ghostparent == 0)
-				{
-					table[x] = ghost->next;
-				}
-				else
-				{
-					ghostparent->next = ghost->next;
-				}
-
-				ILGCUnregisterWeak((void *)&entry->obj);
+				bucket = MonitorBucketIndex(MonitorHash(entry->obj),
+											newBuckets->size);
+				ILInterlockedStoreP_Release((void **)&(entry->next),
+											newBuckets->entries[bucket]);
+				newBuckets->entries[bucket] = entry;
 			}
+			entry = next;
+		}
+	}
 
-			/* Setup the new entry */
+	/* Publish the new bucket array */
+	ILInterlockedStoreP_Release((void **)&(stripe->buckets), newBuckets);
+}
 
-			entry->obj = obj;
-			entry->next = table[x];
-			entry->lockWord = 0;
-			
-			table[x] = entry;
+/*
+ *	Gets a pointer to the lock word used by the object.
+ */
+ILLockWord *GetObjectLockWordPtr(ILExecThread *thread, ILObject *obj)
+{
+	ILMonitorTable *table = (ILMonitorTable *)(thread->process->monitorTable);
+	ILUInt32 hash = MonitorHash(obj);
+	ILMonitorStripe *stripe = &(table->stripes[MonitorStripeIndex(hash)]);
+	ILMonitorBuckets *buckets;
+	ILMonitorEntry *entry, *preventry, *ghost, *ghostparent;
+	ILUInt32 bucket;
+
+	/* Try to find an existing entry without locking the stripe */
+	buckets = (ILMonitorBuckets *)ILInterlockedLoadP((void **)&(stripe->buckets));
+	if((entry = MonitorFindEntry(buckets, hash, obj)) != 0)
+	{
+		return (ILLockWord *)&(entry->lockWord);
+	}
 
-			/* Tells the GC to zero entry->obj if obj is GC-ed */
-			ILGCRegisterGeneralWeak((void *)&entry->obj, obj);
+	ILMutexLock(stripe->lock);
 
-			ILMutexUnlock(thread->process->monitorSystemLock);
+	/* Grow the stripe if the chains are getting too long */
+	buckets = stripe->buckets;
+	if(stripe->count >= buckets->size * IL_MONITOR_STRIPE_LOAD_FACTOR)
+	{
+		MonitorStripeGrow(stripe);
+		buckets = stripe->buckets;
+	}
 
-			return (ILLockWord *)&entry->lockWord;
-		}
-		else if (entry->obj == obj)
+	bucket = MonitorBucketIndex(hash, buckets->size);
+	entry = buckets->entries[bucket];
+
+	ghost = 0;
+	ghostparent = 0;
+	preventry = 0;
+
+	while(entry != 0)
+	{
+		if(entry->obj == obj)
 		{
-			/* Entry was found.  Return it */
+			/* Entry was inserted by another thread.  Return it */
 
-			ILMutexUnlock(thread->process->monitorSystemLock);
+			ILMutexUnlock(stripe->lock);
 
-			return (ILLockWord *)&entry->lockWord;
+			return (ILLockWord *)&(entry->lockWord);
 		}
-		else if (entry->obj == 0)
+		else if(entry->obj == 0 && ghost == 0)
 		{
-			/* Found an entry pointing to a dead object */
+			/* Found an entry pointing to a dead object.  Save the
+			   parent so we can remove the ghost from the list if
+			   it is used */
+			ghost = entry;
+			ghostparent = preventry;
+		}
 
-			if (ghost == 0)
-			{
-				ghost = entry;
+		preventry = entry;
+		entry = entry->next;
+	}
 
-				/* Save the parent so we can remove the
-					ghost from the list if it is used */
-					   				
-				ghostparent = preventry;
-			}
+	if(ghost == 0)
+	{
+		/* No ghost found.  Create a whole new entry. */
+
+		if((entry = (ILMonitorEntry *)ILGCAllocExplicitlyTyped
+				(sizeof(ILMonitorEntry), table->entryDescriptor)) == 0)
+		{
+			ILMutexUnlock(stripe->lock);
+
+			ILExecThreadThrowOutOfMemory(thread);
+
+			return 0;
 		}
 
-		preventry = entry;			
-		entry = entry->next;
+		++(stripe->count);
 	}
+	else
+	{
+		/* Use the entry that no longer points to a live object */
 
-	ILMutexUnlock(thread->process->monitorSystemLock);
-	
-	return 0;
+		entry = ghost;
+
+		/* Remove ghost from list */
+		if(ghostparent == 0)
+		{
+			ILInterlockedStoreP_Release
+				((void **)&(buckets->entries[bucket]), ghost->next);
+		}
+		else
+		{
+			ILInterlockedStoreP_Release
+				((void **)&(ghostparent->next), ghost->next);
+		}
+
+		ILGCUnregisterWeak((void *)&(entry->obj));
+	}
+
+	/* Setup the new entry.  The object is stored last so that lock-free
+	   readers never see a stale lock word for it */
+
+	entry->lockWord = 0;
+	ILInterlockedStoreP_Release((void **)&(entry->next),
+								buckets->entries[bucket]);
+	ILInterlockedStoreP_Release((void **)&(entry->obj), obj);
+
+	/* Tells the GC to zero entry->obj if obj is GC-ed.  The GC expects
+	   the start of the block and not the object pointer */
+	ILGCRegisterGeneralWeak((void *)&(entry->obj), GetObjectGcBase(obj));
+
+	ILInterlockedStoreP_Release((void **)&(buckets->entries[bucket]), entry);
+
+	ILMutexUnlock(stripe->lock);
+
+	return (ILLockWord *)&(entry->lockWord);
 }
 
 /*
@@ -269,28 +472,18 @@ void SetObjectLockWord(ILExecThread *thread, ILObject *obj, ILLockWord value)
 
 /*
  *	Implementation of CompareAndExchangeObjectLockWord using hashtables.
+ *	Entries are never moved in memory so the lock word can be exchanged
+ *	without holding a table lock.
  */
 ILLockWord CompareAndExchangeObjectLockWord(ILExecThread *thread, 
 							ILObject *obj, ILLockWord value, ILLockWord comparand)
 {
-	ILLockWord oldValue;
 	ILLockWord *lockWordPtr;
 
-	/* Lockdown the monitor hashtable */
-	ILMutexLock(thread->process->monitorSystemLock);
-	
 	lockWordPtr = GetObjectLockWordPtr(thread, obj);
 
-	/* Do the compare & exchange */
-	if ((oldValue = *lockWordPtr ) == comparand)
-	{
-		*lockWordPtr  = value;
-	}
-
-	/* Unlock the monitor hashtable */
-	ILMutexUnlock(thread->process->monitorSystemLock);
-
-	return oldValue;
+	return (ILLockWord)ILInterlockedCompareAndExchangeP_Full
+		((void **)lockWordPtr, (void *)value, (void *)comparand);
 }
 
 #endif  /* IL_CONFIG_USE_THIN_LOCKS */
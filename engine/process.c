@@ -20,7 +20,7 @@
  * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  */
 
-#include "engine.h"
+#include "engine_private.h"
 #include "lib_defs.h"
 #include "il_utils.h"
 #include "il_console.h"
@@ -277,6 +277,14 @@ static void _ILExecProcessDestroyInternal(ILExecProcess *process,
 	}
 #endif
 
+	/* Stop the sampling profiler and discard its samples */
+	_ILSamplerDestroy(process);
+
+#ifdef IL_CONFIG_NETWORKING
+	/* Destroy the socket poller */
+	_ILSocketPollerDestroy(process);
+#endif
+
 	/* Destroy the coder instance */
 	if (process->coder)
 	{
@@ -299,13 +307,16 @@ static void _ILExecProcessDestroyInternal(ILExecProcess *process,
 		process->context = 0;
 	}
 
-	if (process->internHash)
-	{
-		/* Destroy the main part of the intern'ed hash table.
-		The rest will be cleaned up by the garbage collector */
-		ILGCFreePersistent(process->internHash);
-		process->internHash = 0;
-	}
+	/* Destroy the intern'ed string hash table */
+	_ILStringInternTableDestroy(process);
+
+	/* Destroy the cache of lookups by name */
+	_ILLookupCacheDestroy(process);
+
+#ifdef IL_CONFIG_REFLECTION
+	/* Destroy the reflection invoke stubs */
+	_ILInvokeStubsDestroy(process);
+#endif
 
 	if (process->reflectionHash)
 	{
@@ -338,7 +349,6 @@ static void _ILExecProcessDestroyInternal(ILExecProcess *process,
 	/* Destroy the GC handle table */
 	if(process->gcHandles)
 	{
-		extern void _ILGCHandleTableFree(struct _tagILGCHandleTable *table);
 		_ILGCHandleTableFree(process->gcHandles);
 		process->gcHandles = 0;
 	}
@@ -436,6 +446,7 @@ static ILExecProcess *_ILExecProcessCreateInternal(void)
 	process->finalizerThread = 0;
 	process->context = 0;
 	process->metadataLock = 0;
+	process->metadataWriting = 0;
 	process->exitStatus = 0;
 	process->coder = 0;
 	process->objectClass = 0;
@@ -445,8 +456,12 @@ static ILExecProcess *_ILExecProcessCreateInternal(void)
 	process->outOfMemoryObject = 0;	
 	process->commandLineObject = 0;
 	process->threadAbortClass = 0;
+	process->packedStackFrameClass = 0;
+	process->stackTraceField = 0;
 	ILGetCurrTime(&(process->startTime));
 	process->internHash = 0;
+	process->lookupCache = 0;
+	process->invokeStubs = 0;
 	process->reflectionHash = 0;
 	process->loadedModules = 0;
 	process->gcHandles = 0;
@@ -458,7 +473,12 @@ static ILExecProcess *_ILExecProcessCreateInternal(void)
 	process->randomLastTime = 0;
 	process->randomCount = 0;
 	process->numThreadStaticSlots = 0;
-	process->loadFlags = IL_LOADFLAG_FORCE_32BIT;
+	process->icHits = 0;
+	process->icMisses = 0;
+	process->icMegamorphic = 0;
+	process->sampler = 0;
+	process->socketPoller = 0;
+	process->loadFlags = IL_LOADFLAG_FORCE_32BIT | IL_LOADFLAG_LAZY_METADATA;
 #if IL_CONFIG_DEBUG_LINES
 	process->debugHookFunc = 0;
 	process->debugHookData = 0;
@@ -891,16 +911,35 @@ static int ILExecProcessInitForExecute(ILExecProcess *process)
 	return 1;
 }
 
+void _ILExecProcessMetadataWriteLock(ILExecProcess *process)
+{
+	ILRWLockWriteLock(process->metadataLock);
+	_ILContextLazyLock(process->context);
+	process->metadataWriting = 1;
+}
+
+void _ILExecProcessMetadataUnlock(ILExecProcess *process)
+{
+	/* Readers and writers exclude each other, so the flag
+	   can only be set here if the caller is the writer */
+	if(process->metadataWriting)
+	{
+		process->metadataWriting = 0;
+		_ILContextLazyUnlock(process->context);
+	}
+	ILRWLockUnlock(process->metadataLock);
+}
+
 #ifndef REDUCED_STDIO
 
 int ILExecProcessLoadImage(ILExecProcess *process, FILE *file)
 {
 	ILImage *image;
 	int loadError;
-	ILRWLockWriteLock(process->metadataLock);
+	IL_METADATA_WRLOCK(process);
 	loadError = ILImageLoad(file, 0, process->context, &image,
 					   	    process->loadFlags);
-	ILRWLockUnlock(process->metadataLock);
+	IL_METADATA_UNLOCK(process);
 	if(loadError == 0)
 	{
 		_ILExecProcessLoadStandard(process, image);
@@ -914,10 +953,10 @@ int ILExecProcessLoadFile(ILExecProcess *process, const char *filename)
 {
 	int error;
 	ILImage *image;
-	ILRWLockWriteLock(process->metadataLock);
+	IL_METADATA_WRLOCK(process);
 	error = ILImageLoadFromFile(filename, process->context, &image,
 								process->loadFlags, 0);
-	ILRWLockUnlock(process->metadataLock);
+	IL_METADATA_UNLOCK(process);
 	if(error == 0)
 	{
 		_ILExecProcessLoadStandard(process, image);
@@ -980,10 +1019,10 @@ static int ILExecProcessLoadFileInternal(ILExecProcess *process,
 										 ILImage **image)
 {
 	int error;
-	ILRWLockWriteLock(process->metadataLock);
+	IL_METADATA_WRLOCK(process);
 	error = ILImageLoadFromFile(filename, process->context, image,
 								process->loadFlags, 0);
-	ILRWLockUnlock(process->metadataLock);
+	IL_METADATA_UNLOCK(process);
 	return error;
 }
 
@@ -1219,6 +1258,49 @@ int ILExecProcessEntryType(ILMethod *method)
 	return entryType;
 }
 
+/*
+ * Get the number of call site cache hits or misses for a process,
+ * including the threads that are still running.
+ */
+static long GetCallSiteCacheCount(ILExecProcess *process, int hits)
+{
+	ILExecThread *thread;
+	ILUInt64 count;
+
+	ILMutexLock(process->lock);
+	count = (hits ? process->icHits : process->icMisses);
+	thread = process->firstThread;
+	while(thread != 0)
+	{
+		count += (hits ? thread->icHits : thread->icMisses);
+		thread = thread->nextThread;
+	}
+	ILMutexUnlock(process->lock);
+	return (long)count;
+}
+
+/*
+ * Get the number of metadata rows that have been loaded, or that
+ * are present, across all of the images in a process.
+ */
+static long GetMetaRowCount(ILExecProcess *process, int loaded)
+{
+	ILImage *image;
+	unsigned long numLoaded;
+	unsigned long numPresent;
+	long count = 0;
+
+	IL_METADATA_RDLOCK(process);
+	image = 0;
+	while((image = ILContextNextImage(process->context, image)) != 0)
+	{
+		ILImageMetaRowCounts(image, &numLoaded, &numPresent);
+		count += (long)(loaded ? numLoaded : numPresent);
+	}
+	IL_METADATA_UNLOCK(process);
+	return count;
+}
+
 long ILExecProcessGetParam(ILExecProcess *process, int type)
 {
 	switch(type)
@@ -1241,6 +1323,36 @@ long ILExecProcessGetParam(ILExecProcess *process, int type)
 			return _ILMallocMaxUsage();
 		}
 		/* Not reached */
+
+		case IL_EXEC_PARAM_IC_HITS:
+		{
+			return GetCallSiteCacheCount(process, 1);
+		}
+		/* Not reached */
+
+		case IL_EXEC_PARAM_IC_MISSES:
+		{
+			return GetCallSiteCacheCount(process, 0);
+		}
+		/* Not reached */
+
+		case IL_EXEC_PARAM_IC_MEGAMORPHIC:
+		{
+			return (long)(process->icMegamorphic);
+		}
+		/* Not reached */
+
+		case IL_EXEC_PARAM_META_LOADED:
+		{
+			return GetMetaRowCount(process, 1);
+		}
+		/* Not reached */
+
+		case IL_EXEC_PARAM_META_PRESENT:
+		{
+			return GetMetaRowCount(process, 0);
+		}
+		/* Not reached */
 	}
 	return -1;
 }
@@ -0,0 +1,414 @@
+/*
+ * sampler.c - Sampling profiler for managed call stacks.
+ *
+ * Copyright (C) 2010  Southern Storm Software, Pty Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "engine_private.h"
+#include "interlocked.h"
+#if !defined(IL_CONFIG_REDUCE_CODE) && defined(HAVE_SIGACTION) && \
+	defined(HAVE_SYS_TIME_H) && defined(__GNUC__)
+#include <signal.h>
+#include <sys/time.h>
+#ifdef ITIMER_PROF
+#define	IL_SAMPLER_SUPPORTED	1
+#endif
+#endif
+
+#ifdef	__cplusplus
+extern	"C" {
+#endif
+
+/*
+
+The sampler uses the "ITIMER_PROF" interval timer, which delivers
+"SIGPROF" to the process after every period of CPU time that it uses.
+The signal handler cannot safely walk the stack of the interrupted
+thread, because the thread may be in the middle of pushing a frame or
+growing its frame stack.  Instead, it counts the sample against the
+thread and sets a flag that is checked at the engine's managed safe
+points, where the thread records its own stack.
+
+The handler cannot call "ILExecThreadCurrent" either, because looking
+up the thread object may not be async-signal-safe.  Each thread keeps
+a pointer to its engine thread in compiler thread local storage, which
+is set whenever the engine thread is attached to or detached from it,
+and the handler only reads that pointer.
+
+Safe points are checked when returning from methods and after native
+calls.  Samples that arrive while a method is looping are therefore
+recorded when the method returns, with the method still on top of the
+stack.
+
+Each distinct stack is stored once in a hash table with the number
+of samples that hit it, and is written out in the "collapsed stack"
+format read by flame graph tools: the methods from the outermost to
+the innermost separated by ';', followed by a space and the count.
+
+*/
+
+#ifdef IL_SAMPLER_SUPPORTED
+
+/*
+ * Maximum number of methods that are recorded for a sample.
+ * Deeper stacks keep their innermost methods.
+ */
+#define	IL_SAMPLE_MAX_DEPTH		128
+
+/*
+ * A distinct call stack and the number of samples that hit it.
+ * The methods are stored from the innermost to the outermost.
+ */
+typedef struct _tagILSampleStack ILSampleStack;
+struct _tagILSampleStack
+{
+	unsigned long	hash;
+	ILUInt32		count;
+	ILUInt32		depth;
+	ILMethod	   *methods[1];
+};
+
+/*
+ * Key that is used to look up a stack in the hash table.
+ */
+typedef struct
+{
+	unsigned long	hash;
+	ILUInt32		depth;
+	ILMethod	  **methods;
+} ILSampleKey;
+
+/*
+ * Sampler state for a process.
+ */
+struct _tagILSampler
+{
+	ILMutex		   *lock;
+	ILHashTable	   *stacks;
+	int				active;
+	struct sigaction oldAction;
+};
+
+/*
+ * The process whose threads are being sampled.  The interval timer
+ * is shared by the whole program, so only one process can be sampled
+ * at a time.
+ */
+static ILExecProcess *sampledProcess = 0;
+
+/*
+ * The engine thread that is attached to the current thread, for the
+ * signal handler.
+ */
+static __thread ILExecThread *volatile sampleThread = 0;
+
+/*
+ * Hash table callbacks for the sample stacks.
+ */
+static unsigned long StackHash_Compute(const ILSampleStack *stack)
+{
+	return stack->hash;
+}
+static unsigned long StackHash_KeyCompute(const ILSampleKey *key)
+{
+	return key->hash;
+}
+static int StackHash_Match(const ILSampleStack *stack, const ILSampleKey *key)
+{
+	return (stack->hash == key->hash && stack->depth == key->depth &&
+			!ILMemCmp(stack->methods, key->methods,
+					  key->depth * sizeof(ILMethod *)));
+}
+
+/*
+ * Handle "SIGPROF" by flagging a sample for the current thread.
+ * Only async-signal-safe operations may be used here.
+ */
+static void SampleHandler(int signo)
+{
+	ILExecThread *thread = sampleThread;
+	if(thread && _ILExecThreadProcess(thread) == sampledProcess)
+	{
+		ILInterlockedIncrementI4(&(thread->samplesPending));
+		ILInterlockedOrU4(&(thread->managedSafePointFlags),
+						  _IL_MANAGED_SAFEPOINT_SAMPLE);
+	}
+}
+
+/*
+ * Set the interval timer to "rate" ticks per second of CPU time,
+ * or turn it off if "rate" is zero.
+ */
+static int SetSampleTimer(int rate)
+{
+	struct itimerval timer;
+	timer.it_interval.tv_sec = 0;
+	timer.it_interval.tv_usec = (rate > 0 ? 1000000 / rate : 0);
+	if(rate > 0 && !(timer.it_interval.tv_usec))
+	{
+		timer.it_interval.tv_usec = 1;
+	}
+	timer.it_value = timer.it_interval;
+	return (setitimer(ITIMER_PROF, &timer, 0) == 0);
+}
+
+/*
+ * Write the name of a class for a collapsed stack.
+ */
+static void DumpClassName(FILE *stream, ILClass *classInfo)
+{
+	ILClass *parent = ILClass_NestedParent(classInfo);
+	const char *nspace;
+	if(parent)
+	{
+		DumpClassName(stream, parent);
+		putc('/', stream);
+	}
+	else if((nspace = ILClass_Namespace(classInfo)) != 0)
+	{
+		fputs(nspace, stream);
+		putc('.', stream);
+	}
+	fputs(ILClass_Name(classInfo), stream);
+}
+#endif /* IL_SAMPLER_SUPPORTED */
+
+int ILExecProcessStartSampling(ILExecProcess *process, int rate)
+{
+#ifdef IL_SAMPLER_SUPPORTED
+	ILSampler *sampler;
+	struct sigaction action;
+
+	if(rate <= 0 || (sampledProcess != 0 && sampledProcess != process))
+	{
+		return 0;
+	}
+
+	/* Create the sampler state the first time sampling is started.
+	   It stays around until the process is destroyed so that the
+	   samples accumulate across restarts */
+	sampler = process->sampler;
+	if(!sampler)
+	{
+		if((sampler = (ILSampler *)ILCalloc(1, sizeof(ILSampler))) == 0)
+		{
+			return 0;
+		}
+		if((sampler->lock = ILMutexCreate()) == 0)
+		{
+			ILFree(sampler);
+			return 0;
+		}
+		if((sampler->stacks = ILHashCreate
+				(0, (ILHashComputeFunc)StackHash_Compute,
+				 (ILHashKeyComputeFunc)StackHash_KeyCompute,
+				 (ILHashMatchFunc)StackHash_Match,
+				 (ILHashFreeFunc)ILFree)) == 0)
+		{
+			ILMutexDestroy(sampler->lock);
+			ILFree(sampler);
+			return 0;
+		}
+		process->sampler = sampler;
+	}
+
+	/* Install the signal handler if this is a new sampling session */
+	if(!(sampler->active))
+	{
+		ILMemZero(&action, sizeof(action));
+		action.sa_handler = SampleHandler;
+		action.sa_flags = SA_RESTART;
+		sigemptyset(&(action.sa_mask));
+		if(sigaction(SIGPROF, &action, &(sampler->oldAction)) != 0)
+		{
+			return 0;
+		}
+		sampledProcess = process;
+		sampler->active = 1;
+	}
+
+	/* Start the timer, or change its rate */
+	if(!SetSampleTimer(rate))
+	{
+		ILExecProcessStopSampling(process);
+		return 0;
+	}
+	return 1;
+#else
+	return 0;
+#endif
+}
+
+void ILExecProcessStopSampling(ILExecProcess *process)
+{
+#ifdef IL_SAMPLER_SUPPORTED
+	ILSampler *sampler = process->sampler;
+	if(sampler && sampler->active)
+	{
+		SetSampleTimer(0);
+		sigaction(SIGPROF, &(sampler->oldAction), 0);
+		sampledProcess = 0;
+		sampler->active = 0;
+	}
+#endif
+}
+
+long ILExecProcessDumpSamples(ILExecProcess *process, FILE *stream)
+{
+#ifdef IL_SAMPLER_SUPPORTED
+	ILSampler *sampler = process->sampler;
+	ILHashIter iter;
+	ILSampleStack *stack;
+	ILUInt32 posn;
+	long numSamples = 0;
+
+	if(!sampler)
+	{
+		return 0;
+	}
+	ILMutexLock(sampler->lock);
+	ILHashIterInit(&iter, sampler->stacks);
+	while((stack = ILHashIterNextType(&iter, ILSampleStack)) != 0)
+	{
+		for(posn = stack->depth; posn > 0; --posn)
+		{
+			DumpClassName(stream, ILMethod_Owner(stack->methods[posn - 1]));
+			fputs("::", stream);
+			fputs(ILMethod_Name(stack->methods[posn - 1]), stream);
+			putc((posn > 1 ? ';' : ' '), stream);
+		}
+		fprintf(stream, "%lu\n", (unsigned long)(stack->count));
+		numSamples += (long)(stack->count);
+	}
+	ILMutexUnlock(sampler->lock);
+	return numSamples;
+#else
+	return 0;
+#endif
+}
+
+void _ILSamplerRecord(ILExecThread *thread, ILMethod *method)
+{
+#ifdef IL_SAMPLER_SUPPORTED
+	ILSampler *sampler = _ILExecThreadProcess(thread)->sampler;
+	ILMethod *methods[IL_SAMPLE_MAX_DEPTH];
+	ILSampleKey key;
+	ILSampleStack *stack;
+	ILInt32 count;
+	ILUInt32 posn;
+#ifdef IL_USE_CVM
+	ILCallFrame *frame;
+#endif
+
+	/* Clear the flag before collecting the pending samples so that
+	   a signal arriving in between is picked up at the next safe point */
+	ILInterlockedAndU4(&(thread->managedSafePointFlags),
+					   ~_IL_MANAGED_SAFEPOINT_SAMPLE);
+	count = ILInterlockedExchangeI4(&(thread->samplesPending), 0);
+	if(!sampler || count <= 0)
+	{
+		return;
+	}
+
+	/* Collect the methods on the stack, innermost first */
+	key.depth = 0;
+#ifdef IL_USE_CVM
+	if(method)
+	{
+		methods[(key.depth)++] = method;
+	}
+	frame = _ILGetCallFrame(thread, 0);
+	while(frame != 0 && key.depth < IL_SAMPLE_MAX_DEPTH)
+	{
+		if(frame->method)
+		{
+			methods[(key.depth)++] = frame->method;
+		}
+		frame = _ILGetNextCallFrame(thread, frame);
+	}
+#endif
+#ifdef IL_USE_JIT
+	key.depth = (ILUInt32)_ILJitDiagGetMethods(thread, methods,
+											   IL_SAMPLE_MAX_DEPTH);
+#endif
+	if(!(key.depth))
+	{
+		return;
+	}
+	key.methods = methods;
+	key.hash = 0;
+	for(posn = 0; posn < key.depth; ++posn)
+	{
+		key.hash = (key.hash * 31) + (unsigned long)(ILNativeUInt)(methods[posn]);
+	}
+
+	/* Add the samples to the stack's count */
+	ILMutexLock(sampler->lock);
+	stack = ILHashFindType(sampler->stacks, &key, ILSampleStack);
+	if(!stack)
+	{
+		stack = (ILSampleStack *)ILMalloc
+			(sizeof(ILSampleStack) + (key.depth - 1) * sizeof(ILMethod *));
+		if(stack)
+		{
+			stack->hash = key.hash;
+			stack->count = 0;
+			stack->depth = key.depth;
+			ILMemCpy(stack->methods, methods, key.depth * sizeof(ILMethod *));
+			if(!ILHashAdd(sampler->stacks, stack))
+			{
+				ILFree(stack);
+				stack = 0;
+			}
+		}
+	}
+	if(stack)
+	{
+		stack->count += (ILUInt32)count;
+	}
+	ILMutexUnlock(sampler->lock);
+#endif
+}
+
+void _ILSamplerSetThread(ILThread *thread, ILExecThread *execThread)
+{
+#ifdef IL_SAMPLER_SUPPORTED
+	if(thread == ILThreadSelf())
+	{
+		sampleThread = execThread;
+	}
+#endif
+}
+
+void _ILSamplerDestroy(ILExecProcess *process)
+{
+#ifdef IL_SAMPLER_SUPPORTED
+	ILSampler *sampler = process->sampler;
+	if(sampler)
+	{
+		ILExecProcessStopSampling(process);
+		ILHashDestroy(sampler->stacks);
+		ILMutexDestroy(sampler->lock);
+		ILFree(sampler);
+		process->sampler = 0;
+	}
+#endif
+}
+
+#ifdef	__cplusplus
+};
+#endif
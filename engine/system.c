@@ -37,12 +37,19 @@ ILMutex *globalTraceMutex;
  */
 static int FindAndSetStackTrace(ILExecThread *thread, ILObject *object)
 {
+	ILExecProcess *process = thread->process;
 	ILField *field;
 
-	/* Find the "stackTrace" field within the "Exception" class */
-	field = ILExecThreadLookupField
-			(thread, "System.Exception", "stackTrace",
-			 "[vSystem.Diagnostics.PackedStackFrame;");
+	/* Find the "stackTrace" field within the "Exception" class.
+	   Racing threads will find the same field, so no lock is needed */
+	field = process->stackTraceField;
+	if(!field)
+	{
+		field = ILExecThreadLookupField
+				(thread, "System.Exception", "stackTrace",
+				 "[vSystem.Diagnostics.PackedStackFrame;");
+		process->stackTraceField = field;
+	}
 	if(field)
 	{
 #ifdef IL_USE_CVM
@@ -99,10 +106,14 @@ void _ILSetExceptionStackTrace(ILExecThread *thread, ILObject *object)
 	{
 		return;
 	}
-	classInfo = ILExecThreadLookupClass(thread, "System.Exception");
+	classInfo = thread->process->exceptionClass;
 	if(!classInfo)
 	{
-		return;
+		classInfo = ILExecThreadLookupClass(thread, "System.Exception");
+		if(!classInfo)
+		{
+			return;
+		}
 	}
 	if(!ILClassInheritsFrom(GetObjectClass(object), classInfo))
 	{
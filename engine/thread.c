@@ -157,6 +157,7 @@ void _ILThreadSetExecContext(ILThread *thread, ILThreadExecContext *context, ILT
 	}
 
 	ILThreadSetObject(thread, context->execThread);
+	_ILSamplerSetThread(thread, context->execThread);
 
 	#if defined(IL_USE_INTERRUPT_BASED_X)
 		if (context->execThread)
@@ -182,6 +183,7 @@ void _ILThreadSaveExecContext(ILThread *thread, ILThreadExecContext *saveContext
 void _ILThreadRestoreExecContext(ILThread *thread, ILThreadExecContext *context)
 {
 	ILThreadSetObject(thread, context->execThread);
+	_ILSamplerSetThread(thread, context->execThread);
 
 	if (context->execThread)
 	{
@@ -215,6 +217,7 @@ void _ILThreadClearExecContext(ILThread *thread)
 	#endif
 
 	ILThreadSetObject(thread, 0);
+	_ILSamplerSetThread(thread, 0);
 }
 
 /*
@@ -656,12 +659,20 @@ ILExecThread *_ILExecThreadCreate(ILExecProcess *process, int ignoreProcessState
 	thread->aborting = 0;
 	thread->freeMonitor = 0;
 	thread->freeMonitorCount = 0;
+	thread->icHits = 0;
+	thread->icMisses = 0;
+	thread->traceOffsets = 0;
+#ifdef IL_CONFIG_RUNTIME_INFRA
+	thread->gcHandleCacheCount[0] = 0;
+	thread->gcHandleCacheCount[1] = 0;
+#endif
 	thread->isFinalizerThread = 0;
 	thread->method = 0;
 	thread->thrownException = 0;
 	thread->threadStaticSlots = 0;
 	thread->threadStaticSlotsUsed = 0;
 	thread->managedSafePointFlags = 0;
+	thread->samplesPending = 0;
 	thread->runningManagedCode = 0;
 	thread->process = 0;
 
@@ -738,6 +749,11 @@ void _ILExecThreadDestroy(ILExecThread *thread)
 
 	if(process)
 	{
+#ifdef IL_CONFIG_RUNTIME_INFRA
+		/* Give the cached GC handle slots back to the process */
+		_ILGCHandleCacheFlush(thread);
+#endif
+
 		/* Lock down the process */
 		ILMutexLock(process->lock);
 
@@ -747,6 +763,10 @@ void _ILExecThreadDestroy(ILExecThread *thread)
 			process->finalizerThread = 0;
 		}
 
+		/* Keep the thread's call site cache statistics */
+		process->icHits += thread->icHits;
+		process->icMisses += thread->icMisses;
+
 		/* Detach the thread from its process */
 		ILExecThreadDetachFromProcess(thread);
 
@@ -783,6 +803,12 @@ void _ILExecThreadDestroy(ILExecThread *thread)
 	}
 #endif
 
+	/* Destroy the stack trace offset cache */
+	if(thread->traceOffsets)
+	{
+		ILFree(thread->traceOffsets);
+	}
+
 	/* Destroy the thread block */
 	ILGCFreePersistent(thread);
 }
@@ -971,6 +997,14 @@ int ILExecThreadReturnToProcess(ILExecThread *thread, ILExecContext *context)
 		ILExecProcess *leavingProcess = _ILExecThreadProcess(thread);
 		/* perform a real return */
 
+#ifdef IL_CONFIG_RUNTIME_INFRA
+		/* Give the cached GC handle slots back to the process */
+		if(leavingProcess)
+		{
+			_ILGCHandleCacheFlush(thread);
+		}
+#endif
+
 		/* do this so that the locks are always in the same order to avoid a deadlock */
 		if(returnProcess < leavingProcess)
 		{
@@ -1049,6 +1083,14 @@ int ILExecThreadSwitchToProcess(ILExecThread *thread, ILExecProcess *process, IL
 	{
 		int result = 1;
 
+#ifdef IL_CONFIG_RUNTIME_INFRA
+		/* Give the cached GC handle slots back to the process */
+		if(prevProcess)
+		{
+			_ILGCHandleCacheFlush(thread);
+		}
+#endif
+
 		/* do this so that the locks are always in the same order to avoid a deadlock */
 		if(prevProcess < process)
 		{
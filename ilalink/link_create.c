@@ -62,6 +62,7 @@ ILLinker *ILLinkerCreate(FILE *stream, int seekable, int type, int flags)
 	/* Initialize the other linker fields */
 	linker->libraries = 0;
 	linker->lastLibrary = 0;
+	linker->preloaded = 0;
 	linker->libraryDirs = 0;
 	linker->numLibraryDirs = 0;
 	linker->outOfMemory = 0;
@@ -510,7 +511,15 @@ void ILLinkerSetMetadataVersion(ILLinker *linker, const char *version,
 	}
 	else if((library = _ILLinkerFindLibrary(linker, stdLibrary)) != 0)
 	{
-		ILWriterInferVersionString(linker->writer, library->image);
+		if(library->image)
+		{
+			ILWriterInferVersionString(linker->writer, library->image);
+		}
+		else if(library->runtimeVersion)
+		{
+			/* The library was created from its index */
+			ILWriterSetVersionString(linker->writer, library->runtimeVersion);
+		}
 	}
 }
 
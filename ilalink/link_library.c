@@ -20,6 +20,9 @@
 
 #include "linker.h"
 #include "il_crypt.h"
+#include "il_thread.h"
+#include "il_sysio.h"
+#include <errno.h>
 #ifdef HAVE_SYS_STAT_H
 #include <sys/stat.h>
 #endif
@@ -154,6 +157,52 @@ char *ILLinkerResolveLibrary(ILLinker *linker, const char *name)
 	return newName;
 }
 
+/*
+ * Kinds of records within a library index.  Every record has a kind,
+ * two values, and a payload of NUL-terminated strings, so that the
+ * names can be used directly from the index:
+ *
+ *		INDEX_ASSEMBLY	version, version, assembly name
+ *		INDEX_KEY		-, -, public key bytes
+ *		INDEX_C_IMAGE	non-zero if a C image, -, -
+ *		INDEX_RUNTIME	-, -, runtime version of the metadata
+ *		INDEX_REF		-, -, name of a referenced assembly
+ *		INDEX_MODULE	-, -, name of the "<Module>" type
+ *		INDEX_CLASS		TypeDef token, parent token, name, namespace
+ *		INDEX_SYMBOL	member token, symbol flags, name, "aliasFor"
+ */
+#define	INDEX_END			0
+#define	INDEX_ASSEMBLY		1
+#define	INDEX_KEY			2
+#define	INDEX_C_IMAGE		3
+#define	INDEX_RUNTIME		4
+#define	INDEX_REF			5
+#define	INDEX_MODULE		6
+#define	INDEX_CLASS			7
+#define	INDEX_SYMBOL		8
+#define	INDEX_RECORD_SIZE	16
+#define	INDEX_HEADER_SIZE	48
+#define	INDEX_MAX_NESTING	64
+#define	INDEX_SUFFIX		".ilidx"
+
+/*
+ * Magic number at the start of an index file.  Change this if
+ * the format changes, so that old indexes are not used.
+ */
+static char const indexMagic[8] = {'I', 'L', 'L', 'I', 'D', 'X', '0', '2'};
+
+/*
+ * Buffer that holds a library index while it is being recorded.
+ */
+struct _tagILLibraryIndex
+{
+	unsigned char  *data;
+	ILUInt32		len;
+	ILUInt32		max;
+	unsigned char	header[INDEX_HEADER_SIZE];
+
+};
+
 /*
  * Destroy a library context.
  */
@@ -173,10 +222,26 @@ static void LibraryDestroy(ILLibrary *library)
 		}
 		ILHashDestroy(library->classHash);
 		ILHashDestroy(library->symbolHash);
+		if(library->index)
+		{
+			ILFree(library->index->data);
+			ILFree(library->index);
+		}
 		ILMemPoolDestroy(&(library->pool));
 		if(isFirst)
 		{
-			ILContextDestroy(library->context);
+			if(library->context)
+			{
+				ILContextDestroy(library->context);
+			}
+			if(library->assemblyRefs)
+			{
+				ILFree((void *)(library->assemblyRefs));
+			}
+			if(library->indexData)
+			{
+				ILFree(library->indexData);
+			}
 			isFirst = 0;
 		}
 		ILFree(library);
@@ -270,10 +335,58 @@ static int SymbolHash_Match(const ILLibrarySymbol *libSymbol,
 	return (strcmp(libSymbol->name, key) == 0);
 }
 
+/*
+ * Create an ILLibrary record for an assembly definition.  If "first"
+ * is not NULL, then the record is an alternative name for "first",
+ * and shares its hash tables.  Returns NULL if out of memory.
+ */
+static ILLibrary *CreateLibrary(ILLinker *linker, ILLibrary *first,
+								const char *name, const char *filename,
+								const ILUInt16 *version)
+{
+	ILLibrary *library = (ILLibrary *)ILCalloc(1, sizeof(ILLibrary));
+	if(!library)
+	{
+		_ILLinkerOutOfMemory(linker);
+		return 0;
+	}
+	library->name = ILDupString(name);
+	library->filename = ILDupString(filename);
+	library->moduleName = ILDupString(IL_LINKER_DLL_MODULE_NAME);
+	ILMemCpy(library->version, version, 4 * sizeof(ILUInt16));
+	ILMemPoolInitType(&(library->pool), ILLibraryClassOrSymbol, 0);
+	if(first)
+	{
+		library->isCImage = first->isCImage;
+	}
+	else
+	{
+		library->classHash =
+			ILHashCreate(0, (ILHashComputeFunc)ClassHash_Compute,
+							(ILHashKeyComputeFunc)ClassHash_KeyCompute,
+							(ILHashMatchFunc)ClassHash_Match,
+							(ILHashFreeFunc)0);
+		library->symbolHash =
+			ILHashCreate(0, (ILHashComputeFunc)SymbolHash_Compute,
+							(ILHashKeyComputeFunc)SymbolHash_KeyCompute,
+							(ILHashMatchFunc)SymbolHash_Match,
+							(ILHashFreeFunc)0);
+	}
+	if(!(library->name) || !(library->filename) || !(library->moduleName) ||
+	   (!first && (!(library->classHash) || !(library->symbolHash))))
+	{
+		LibraryDestroy(library);
+		_ILLinkerOutOfMemory(linker);
+		return 0;
+	}
+	return library;
+}
+
 /*
  * Create ILLibrary records for all assembly definitions
  * within a supplied library image.  Returns the list,
- * or NULL if an error occurred.
+ * or NULL if an error occurred or there are no assembly
+ * definitions in the image.
  */
 static ILLibrary *ScanAssemblies(ILLinker *linker, ILContext *context,
 								 ILImage *image, const char *filename)
@@ -284,6 +397,7 @@ static ILLibrary *ScanAssemblies(ILLinker *linker, ILContext *context,
 	ILAssembly *assem;
 	const void *originator;
 	ILUInt32 originatorLen;
+	unsigned long numRefs;
 
 	/* Scan the assembly definitions */
 	library = 0;
@@ -292,124 +406,68 @@ static ILLibrary *ScanAssemblies(ILLinker *linker, ILContext *context,
 	while((assem = (ILAssembly *)ILImageNextToken
 				(image, IL_META_TOKEN_ASSEMBLY, (void *)assem)) != 0)
 	{
-		nextLibrary = (ILLibrary *)ILMalloc(sizeof(ILLibrary));
+		nextLibrary = CreateLibrary(linker, library, ILAssembly_Name(assem),
+									filename, ILAssemblyGetVersion(assem));
 		if(!nextLibrary)
 		{
-			_ILLinkerOutOfMemory(linker);
-			LibraryDestroy(library);
-			return 0;
-		}
-		nextLibrary->publicKey = 0;
-		nextLibrary->publicKeyLen = 0;
-		nextLibrary->name = ILDupString(ILAssembly_Name(assem));
-		if(!(nextLibrary->name))
-		{
-			ILFree(nextLibrary);
-			_ILLinkerOutOfMemory(linker);
-			LibraryDestroy(library);
-			return 0;
-		}
-		nextLibrary->filename = ILDupString(filename);
-		if(!(nextLibrary->filename))
-		{
-			ILFree((void *)(nextLibrary->name));
-			ILFree(nextLibrary);
-			_ILLinkerOutOfMemory(linker);
-			LibraryDestroy(library);
-			return 0;
-		}
-		nextLibrary->moduleName = ILDupString(IL_LINKER_DLL_MODULE_NAME);
-		if(!(nextLibrary->moduleName))
-		{
-			ILFree((void *)(nextLibrary->filename));
-			ILFree((void *)(nextLibrary->name));
-			ILFree(nextLibrary);
-			_ILLinkerOutOfMemory(linker);
 			LibraryDestroy(library);
 			return 0;
 		}
-		ILMemCpy(nextLibrary->version, ILAssemblyGetVersion(assem),
-				 4 * sizeof(ILUInt16));
-		nextLibrary->altNames = 0;
-		if(library)
+		if(lastLibrary)
 		{
-			nextLibrary->classHash = 0;
-			nextLibrary->symbolHash = 0;
-			nextLibrary->isCImage = library->isCImage;
+			lastLibrary->altNames = nextLibrary;
 		}
 		else
 		{
-			nextLibrary->isCImage = ILLinkerIsCObject(image);
+			library = nextLibrary;
+			library->isCImage = ILLinkerIsCObject(image);
 			originator = ILAssemblyGetOriginator(assem, &originatorLen);
 			if(originator && originatorLen)
 			{
-				nextLibrary->publicKey =
+				library->publicKey =
 					(unsigned char *)ILMalloc(originatorLen + 1);
-				if(nextLibrary->publicKey)
-				{
-					ILMemCpy(nextLibrary->publicKey, originator, originatorLen);
-					nextLibrary->publicKeyLen = originatorLen;
-				}
-			}
-			nextLibrary->classHash =
-				ILHashCreate(0, (ILHashComputeFunc)ClassHash_Compute,
-								(ILHashKeyComputeFunc)ClassHash_KeyCompute,
-								(ILHashMatchFunc)ClassHash_Match,
-								(ILHashFreeFunc)0);
-			if(!(nextLibrary->classHash))
-			{
-				if(nextLibrary->publicKey)
-				{
-					ILFree(nextLibrary->publicKey);
-				}
-				ILFree((void *)(nextLibrary->moduleName));
-				ILFree((void *)(nextLibrary->filename));
-				ILFree((void *)(nextLibrary->name));
-				ILFree(nextLibrary);
-				LibraryDestroy(library);
-				return 0;
-			}
-			nextLibrary->symbolHash =
-				ILHashCreate(0, (ILHashComputeFunc)SymbolHash_Compute,
-								(ILHashKeyComputeFunc)SymbolHash_KeyCompute,
-								(ILHashMatchFunc)SymbolHash_Match,
-								(ILHashFreeFunc)0);
-			if(!(nextLibrary->symbolHash))
-			{
-				ILHashDestroy(nextLibrary->classHash);
-				if(nextLibrary->publicKey)
+				if(library->publicKey)
 				{
-					ILFree(nextLibrary->publicKey);
+					ILMemCpy(library->publicKey, originator, originatorLen);
+					library->publicKeyLen = originatorLen;
 				}
-				ILFree((void *)(nextLibrary->moduleName));
-				ILFree((void *)(nextLibrary->filename));
-				ILFree((void *)(nextLibrary->name));
-				ILFree(nextLibrary);
-				LibraryDestroy(library);
-				return 0;
 			}
 		}
-		ILMemPoolInitType(&(nextLibrary->pool), ILLibraryClassOrSymbol, 0);
-		nextLibrary->next = 0;
-		nextLibrary->context = context;
-		nextLibrary->image = image;
-		if(lastLibrary)
+		lastLibrary = nextLibrary;
+	}
+	if(!library)
+	{
+		return 0;
+	}
+
+	/* Collect the names of the assemblies that the library references */
+	numRefs = ILImageNumTokens(image, IL_META_TOKEN_ASSEMBLY_REF);
+	if(numRefs > 0)
+	{
+		library->assemblyRefs =
+			(const char **)ILMalloc(sizeof(const char *) * numRefs);
+		if(!(library->assemblyRefs))
 		{
-			lastLibrary->altNames = nextLibrary;
+			_ILLinkerOutOfMemory(linker);
+			LibraryDestroy(library);
+			return 0;
 		}
-		else
+		assem = 0;
+		while((assem = (ILAssembly *)ILImageNextToken
+					(image, IL_META_TOKEN_ASSEMBLY_REF, (void *)assem)) != 0 &&
+			  library->numAssemblyRefs < (int)numRefs)
 		{
-			library = nextLibrary;
+			library->assemblyRefs[(library->numAssemblyRefs)++] =
+				ILAssembly_Name(assem);
 		}
-		lastLibrary = nextLibrary;
 	}
 
-	/* Bail out if there are no assembly definitions */
-	if(!library)
+	/* The library records now own the image and its context */
+	for(nextLibrary = library; nextLibrary != 0;
+		nextLibrary = nextLibrary->altNames)
 	{
-		fprintf(stderr, "%s: missing assembly definition tokens", filename);
-		linker->error = 1;
-		return 0;
+		nextLibrary->context = context;
+		nextLibrary->image = image;
 	}
 
 	/* Return the library list to the caller */
@@ -417,25 +475,223 @@ static ILLibrary *ScanAssemblies(ILLinker *linker, ILContext *context,
 }
 
 /*
- * Walk a public type and all of its visible nested types.
+ * Append a record to an index buffer.  The payload is made up of
+ * "str1" and "str2", with NUL terminators.  If "len1" is not zero,
+ * then it is the length of "str1", which is copied without a NUL.
+ * Returns zero if out of memory.
  */
-static int WalkTypeAndNested(ILLinker *linker, ILImage *image,
-							 ILLibrary *library, ILClass *classInfo,
-							 ILLibraryClass *parent)
+static int IndexAppend(ILLibraryIndex *index, ILUInt32 kind, ILUInt32 value1,
+					   ILUInt32 value2, const char *str1, ILUInt32 len1,
+					   const char *str2)
 {
-	ILNestedInfo *nestedInfo;
-	ILClass *child;
-	ILLibraryClass *libClass;
-	const char *name;
-	const char *namespace;
+	ILUInt32 len2 = 0;
+	ILUInt32 size;
+	unsigned char *data;
+	if(str1 && !len1)
+	{
+		len1 = strlen(str1) + 1;
+	}
+	if(str2)
+	{
+		len2 = strlen(str2) + 1;
+	}
+	size = INDEX_RECORD_SIZE + len1 + len2;
+	if((index->max - index->len) < size)
+	{
+		ILUInt32 newMax = index->max * 2 + size + 256;
+		data = (unsigned char *)ILRealloc(index->data, newMax);
+		if(!data)
+		{
+			return 0;
+		}
+		index->data = data;
+		index->max = newMax;
+	}
+	data = index->data + index->len;
+	IL_WRITE_UINT32(data, kind);
+	IL_WRITE_UINT32(data + 4, value1);
+	IL_WRITE_UINT32(data + 8, value2);
+	IL_WRITE_UINT32(data + 12, len1 + len2);
+	ILMemCpy(data + INDEX_RECORD_SIZE, str1, len1);
+	ILMemCpy(data + INDEX_RECORD_SIZE + len1, str2, len2);
+	index->len += size;
+	return 1;
+}
 
-	/* Add the name of this type to the library's hash table */
-	name = (ILInternString((char *)(ILClass_Name(classInfo)), -1)).string;
-	namespace = (const char *)(ILClass_Namespace(classInfo));
-	if(namespace)
+/*
+ * Record a class or symbol in the index for a library, if one is
+ * being recorded.  If we run out of memory, then the index is
+ * abandoned, because the library can be scanned without it.
+ */
+static void IndexRecord(ILLibrary *library, ILUInt32 kind, ILUInt32 value1,
+						ILUInt32 value2, const char *str1, const char *str2)
+{
+	if(library->index &&
+	   !IndexAppend(library->index, kind, value1, value2, str1, 0, str2))
+	{
+		ILFree(library->index->data);
+		ILFree(library->index);
+		library->index = 0;
+	}
+}
+
+/*
+ * Build the header of the index for a library file, which identifies
+ * the exact version of the file that the index describes.  Returns
+ * zero if the file cannot be identified.  The sub-second part of the
+ * modification time catches a library that is rebuilt in place within
+ * the same second, and the inode catches one that is replaced by a
+ * new file with the same size and timestamp.
+ */
+static int IndexHeader(const char *filename, unsigned char *header)
+{
+#ifdef HAVE_STAT
+	struct stat st;
+	ILUInt64 nsec;
+	if(stat(filename, &st) < 0)
+	{
+		return 0;
+	}
+#ifdef HAVE_STAT_ST_MTIM
+	nsec = (ILUInt64)(st.st_mtim.tv_nsec);
+#else
+	nsec = 0;
+#endif
+	ILMemCpy(header, indexMagic, 8);
+	IL_WRITE_UINT64(header + 8, (ILUInt64)(st.st_mtime));
+	IL_WRITE_UINT64(header + 16, nsec);
+	IL_WRITE_UINT64(header + 24, (ILUInt64)(st.st_size));
+	IL_WRITE_UINT64(header + 32, (ILUInt64)(st.st_ino));
+	IL_WRITE_UINT64(header + 40, (ILUInt64)(st.st_dev));
+	return 1;
+#else
+	return 0;
+#endif
+}
+
+/*
+ * Get the name of the index file for a library.
+ */
+static char *IndexFilename(const char *filename, const char *extra)
+{
+	int len = strlen(filename);
+	char *name = (char *)ILMalloc(len + strlen(INDEX_SUFFIX) + 32);
+	if(name)
+	{
+		strcpy(name, filename);
+		strcpy(name + len, INDEX_SUFFIX);
+		if(extra)
+		{
+			strcat(name, extra);
+		}
+	}
+	return name;
+}
+
+/*
+ * Write the index that was recorded while scanning a library to its
+ * index file.  The file is written under a temporary name and then
+ * renamed, so that concurrent links never see a partial index.
+ * Errors are ignored, because the library directory may not be
+ * writable, and the library can always be scanned again.
+ */
+static void IndexSave(ILLibrary *library)
+{
+	ILLibraryIndex *index = library->index;
+	ILLibraryIndex prefix;
+	ILLibrary *altName;
+	const char *runtime;
+	char extra[32];
+	char *filename;
+	char *temp;
+	FILE *file;
+	int posn, len, ok;
+
+	/* Detach the recorded classes and symbols from the library */
+	if(!index)
+	{
+		return;
+	}
+	library->index = 0;
+
+	/* Record the information that is needed to use the library
+	   without loading it, and terminate the index */
+	prefix.data = 0;
+	prefix.len = 0;
+	prefix.max = 0;
+	ok = 1;
+	for(altName = library; altName != 0; altName = altName->altNames)
+	{
+		ok = ok && IndexAppend(&prefix, INDEX_ASSEMBLY,
+							   (((ILUInt32)(altName->version[0])) << 16) |
+							   		altName->version[1],
+							   (((ILUInt32)(altName->version[2])) << 16) |
+							   		altName->version[3],
+							   altName->name, 0, 0);
+	}
+	if(library->publicKey)
+	{
+		ok = ok && IndexAppend(&prefix, INDEX_KEY, 0, 0,
+							   (const char *)(library->publicKey),
+							   library->publicKeyLen, 0);
+	}
+	ok = ok && IndexAppend(&prefix, INDEX_C_IMAGE,
+						   (ILUInt32)(library->isCImage), 0, 0, 0, 0);
+	runtime = ILImageMetaRuntimeVersion(library->image, &len);
+	if(runtime && len > 0)
+	{
+		ok = ok && IndexAppend(&prefix, INDEX_RUNTIME, 0, 0,
+							   runtime, (ILUInt32)len, "");
+	}
+	for(posn = 0; posn < library->numAssemblyRefs; ++posn)
+	{
+		ok = ok && IndexAppend(&prefix, INDEX_REF, 0, 0,
+							   library->assemblyRefs[posn], 0, 0);
+	}
+	ok = ok && IndexAppend(&prefix, INDEX_MODULE, 0, 0,
+						   library->moduleName, 0, 0);
+	ok = ok && IndexAppend(index, INDEX_END, 0, 0, 0, 0, 0);
+
+	/* Write the index to a temporary file and then rename it */
+#ifdef HAVE_GETPID
+	sprintf(extra, ".%ld", (long)getpid());
+#else
+	strcpy(extra, ".tmp");
+#endif
+	filename = IndexFilename(library->filename, 0);
+	temp = IndexFilename(library->filename, extra);
+	if(ok && filename && temp && (file = fopen(temp, "wb")) != NULL)
 	{
-		namespace = (ILInternString(namespace, -1)).string;
+		ok = (fwrite(index->header, 1, INDEX_HEADER_SIZE, file) ==
+					INDEX_HEADER_SIZE &&
+			  fwrite(prefix.data, 1, prefix.len, file) == prefix.len &&
+			  fwrite(index->data, 1, index->len, file) == index->len);
+		ok = (fclose(file) == 0 && ok);
+		if(!ok || ILRenameDir(temp, filename) != 0)
+		{
+			ILDeleteFile(temp);
+		}
 	}
+
+	/* Clean up */
+	ILFree(filename);
+	ILFree(temp);
+	ILFree(prefix.data);
+	ILFree(index->data);
+	ILFree(index);
+}
+
+/*
+ * Add a type to a library's class hash table.  The names are not
+ * intern'ed, because libraries may be scanned on several threads
+ * at once.  They point into the library image or index, which
+ * lives for as long as the library does.
+ */
+static ILLibraryClass *AddLibraryClass(ILLinker *linker, ILLibrary *library,
+									   const char *name, const char *namespace,
+									   ILLibraryClass *parent)
+{
+	ILLibraryClass *libClass;
 	if((libClass = ILMemPoolAlloc(&(library->pool), ILLibraryClass)) == 0)
 	{
 		_ILLinkerOutOfMemory(linker);
@@ -449,6 +705,33 @@ static int WalkTypeAndNested(ILLinker *linker, ILImage *image,
 		_ILLinkerOutOfMemory(linker);
 		return 0;
 	}
+	return libClass;
+}
+
+/*
+ * Walk a public type and all of its visible nested types.
+ */
+static int WalkTypeAndNested(ILLinker *linker, ILImage *image,
+							 ILLibrary *library, ILClass *classInfo,
+							 ILLibraryClass *parent)
+{
+	ILNestedInfo *nestedInfo;
+	ILClass *child;
+	ILLibraryClass *libClass;
+	const char *name;
+	const char *namespace;
+
+	/* Add the name of this type to the library's hash table */
+	name = ILClass_Name(classInfo);
+	namespace = ILClass_Namespace(classInfo);
+	libClass = AddLibraryClass(linker, library, name, namespace, parent);
+	if(!libClass)
+	{
+		return 0;
+	}
+	IndexRecord(library, INDEX_CLASS, ILClass_Token(classInfo),
+				(parent ? ILClass_Token(ILClass_NestedParent(classInfo)) : 0),
+				name, namespace);
 
 	/* Walk the visible nested types */
 	nestedInfo = 0;
@@ -480,7 +763,7 @@ static int WalkTypeAndNested(ILLinker *linker, ILImage *image,
  */
 static int AddGlobalSymbol(ILLinker *linker, ILLibrary *library,
 						   const char *name, char *aliasFor, int flags,
-						   ILMember *member)
+						   ILMember *member, ILToken token)
 {
 	ILLibrarySymbol *libSymbol;
 	if(library)
@@ -494,11 +777,14 @@ static int AddGlobalSymbol(ILLinker *linker, ILLibrary *library,
 		libSymbol->aliasFor = aliasFor;
 		libSymbol->flags = flags;
 		libSymbol->member = member;
+		libSymbol->token = token;
 		if(!ILHashAdd(library->symbolHash, libSymbol))
 		{
 			_ILLinkerOutOfMemory(linker);
 			return 0;
 		}
+		IndexRecord(library, INDEX_SYMBOL, token, (ILUInt32)flags,
+					name, aliasFor);
 	}
 	else
 	{
@@ -543,6 +829,7 @@ static int AddGlobalSymbol(ILLinker *linker, ILLibrary *library,
 		libSymbol->aliasFor = aliasFor;
 		libSymbol->flags = flags;
 		libSymbol->member = member;
+		libSymbol->token = token;
 		if(!ILHashAdd(linker->symbolHash, libSymbol))
 		{
 			_ILLinkerOutOfMemory(linker);
@@ -552,6 +839,20 @@ static int AddGlobalSymbol(ILLinker *linker, ILLibrary *library,
 	return 1;
 }
 
+/*
+ * Get the name to use for a global symbol.  Library symbol names
+ * point into the library image or index, like class names, but the names
+ * for the image being linked must outlive its image.
+ */
+static const char *SymbolName(ILLibrary *library, const char *name)
+{
+	if(library)
+	{
+		return name;
+	}
+	return (ILInternString(name, -1)).string;
+}
+
 /*
  * Walk the global symbol definitions in a "<Module>" type.
  */
@@ -574,8 +875,7 @@ static int WalkGlobals(ILLinker *linker, ILImage *image,
 			field = (ILField *)member;
 			if(ILField_IsPublic(field) && ILField_IsStatic(field))
 			{
-				name = (ILInternString
-					((char *)(ILField_Name(field)), -1)).string;
+				name = SymbolName(library, ILField_Name(field));
 				flags = IL_LINKSYM_VARIABLE;
 				aliasFor = ILLinkerGetStringAttribute
 					(ILToProgramItem(field),
@@ -585,7 +885,8 @@ static int WalkGlobals(ILLinker *linker, ILImage *image,
 					flags |= IL_LINKSYM_STRONG;
 				}
 				if(!AddGlobalSymbol(linker, library, name,
-									aliasFor, flags, member))
+									aliasFor, flags, member,
+									ILMember_Token(member)))
 				{
 					return 0;
 				}
@@ -596,8 +897,7 @@ static int WalkGlobals(ILLinker *linker, ILImage *image,
 			method = (ILMethod *)member;
 			if(ILMethod_IsPublic(method) && ILMethod_IsStatic(method))
 			{
-				name = (ILInternString
-					(ILMethod_Name(method), -1)).string;
+				name = SymbolName(library, ILMethod_Name(method));
 				flags = IL_LINKSYM_FUNCTION;
 				aliasFor = ILLinkerGetStringAttribute
 					(ILToProgramItem(method),
@@ -617,7 +917,8 @@ static int WalkGlobals(ILLinker *linker, ILImage *image,
 					}
 				}
 				if(!AddGlobalSymbol(linker, library, name,
-									aliasFor, flags, member))
+									aliasFor, flags, member,
+									ILMember_Token(member)))
 				{
 					return 0;
 				}
@@ -688,153 +989,775 @@ static int WalkTypeDefs(ILLinker *linker, ILImage *image, ILLibrary *library)
 }
 
 /*
- * Add a library image to the linker context.
+ * Create the ILLibrary records for a library from its index file,
+ * without loading the library image.  Returns NULL if there is no
+ * usable index, in which case the library must be scanned.
  */
-static ILLibrary *AddLibrary(ILLinker *linker, ILContext *context,
-							 ILImage *image, const char *filename)
+static ILLibrary *IndexLoad(ILLinker *linker, const char *filename)
 {
+	unsigned char header[INDEX_HEADER_SIZE];
+	ILToken tokens[INDEX_MAX_NESTING];
+	ILLibraryClass *parents[INDEX_MAX_NESTING];
+	unsigned char *buffer;
+	unsigned char *data;
+	ILUInt32 len, kind, value1, value2, strLen, nameLen;
+	char *str;
+	char *str2;
+	char *indexName;
+	FILE *file;
+	long size;
 	ILLibrary *library;
-
-	/* Create ILLibrary records for the assembly definitions */
-	library = ScanAssemblies(linker, context, image, filename);
-	if(!library)
+	ILLibrary *lastLibrary;
+	ILLibrary *nextLibrary;
+	ILLibraryClass *libClass;
+	ILUInt16 version[4];
+	const char **refs;
+	int depth, ok;
+
+	/* Read the index file into memory, and check that it was
+	   built from the current version of the library file */
+	if(!IndexHeader(filename, header) ||
+	   (indexName = IndexFilename(filename, 0)) == 0)
 	{
 		return 0;
 	}
-
-	/* Add the library to the linker's list */
-	if(linker->lastLibrary)
-	{
-		linker->lastLibrary->next = library;
-	}
-	else
+	file = fopen(indexName, "rb");
+	ILFree(indexName);
+	if(!file)
 	{
-		linker->libraries = library;
+		return 0;
 	}
-	linker->lastLibrary = library;
-	return library;
-}
-
-/*
- * Find a library by filename.
- */
-static ILLibrary *FindLibraryByFilename(ILLinker *linker, const char *filename)
-{
-	ILLibrary *library;
-	library = linker->libraries;
-	while(library != 0)
+	buffer = 0;
+	if(fseek(file, 0, SEEK_END) == 0 && (size = ftell(file)) > INDEX_HEADER_SIZE &&
+	   fseek(file, 0, SEEK_SET) == 0 &&
+	   (buffer = (unsigned char *)ILMalloc((unsigned long)size)) != 0)
 	{
-		if(!strcmp(library->filename, filename))
+		if(fread(buffer, 1, (unsigned long)size, file) != (unsigned long)size ||
+		   ILMemCmp(buffer, header, INDEX_HEADER_SIZE) != 0)
 		{
-			return library;
+			ILFree(buffer);
+			buffer = 0;
 		}
-		library = library->next;
 	}
-	return 0;
-}
-
-int ILLinkerAddLibrary(ILLinker *linker, const char *name)
-{
-	FILE *file;
-	ILContext *context;
-	int loadError;
-	ILImage *image;
-	int result = 1;
-	char *newFilename;
-	ILLibrary *library;
-	ILAssembly *assem;
-
-	/* Bail out if we already have a library with this assembly name */
-	if(_ILLinkerFindLibrary(linker, name) != 0)
+	fclose(file);
+	if(!buffer)
 	{
-		return 1;
+		return 0;
 	}
 
-	/* Resolve the library name */
-	newFilename = ILLinkerResolveLibrary(linker, name);
-	if(!newFilename)
+	/* Process the records.  The names point into the buffer, which
+	   is owned by the library once its first record is created */
+	data = buffer + INDEX_HEADER_SIZE;
+	len = (ILUInt32)(size - INDEX_HEADER_SIZE);
+	library = 0;
+	lastLibrary = 0;
+	depth = 0;
+	ok = 0;
+	while(len >= INDEX_RECORD_SIZE)
 	{
-		fprintf(stderr, "%s: library not found\n", name);
-		linker->error = 1;
-		return 0;
+		/* Parse the record header and split the payload into strings */
+		kind = IL_READ_UINT32(data);
+		value1 = IL_READ_UINT32(data + 4);
+		value2 = IL_READ_UINT32(data + 8);
+		strLen = IL_READ_UINT32(data + 12);
+		if(strLen > (len - INDEX_RECORD_SIZE))
+		{
+			break;
+		}
+		str = (char *)(data + INDEX_RECORD_SIZE);
+		str2 = 0;
+		data += INDEX_RECORD_SIZE + strLen;
+		len -= INDEX_RECORD_SIZE + strLen;
+		if(kind != INDEX_KEY && strLen > 0)
+		{
+			if(str[strLen - 1] != '\0')
+			{
+				break;
+			}
+			nameLen = strlen(str) + 1;
+			if(nameLen < strLen)
+			{
+				str2 = str + nameLen;
+			}
+		}
+		else if(kind != INDEX_KEY)
+		{
+			str = 0;
+		}
+		if(kind == INDEX_END)
+		{
+			ok = (len == 0 && library != 0);
+			break;
+		}
+		if(kind == INDEX_ASSEMBLY)
+		{
+			if(!str)
+			{
+				break;
+			}
+			version[0] = (ILUInt16)(value1 >> 16);
+			version[1] = (ILUInt16)value1;
+			version[2] = (ILUInt16)(value2 >> 16);
+			version[3] = (ILUInt16)value2;
+			nextLibrary = CreateLibrary(linker, library, str,
+										filename, version);
+			if(!nextLibrary)
+			{
+				break;
+			}
+			if(lastLibrary)
+			{
+				lastLibrary->altNames = nextLibrary;
+			}
+			else
+			{
+				library = nextLibrary;
+				library->indexData = buffer;
+			}
+			lastLibrary = nextLibrary;
+			continue;
+		}
+		if(!library)
+		{
+			break;
+		}
+		if(kind == INDEX_KEY)
+		{
+			library->publicKey = (unsigned char *)ILMalloc(strLen + 1);
+			if(!(library->publicKey))
+			{
+				break;
+			}
+			ILMemCpy(library->publicKey, str, strLen);
+			library->publicKeyLen = strLen;
+		}
+		else if(kind == INDEX_C_IMAGE)
+		{
+			for(nextLibrary = library; nextLibrary != 0;
+				nextLibrary = nextLibrary->altNames)
+			{
+				nextLibrary->isCImage = (int)value1;
+			}
+		}
+		else if(kind == INDEX_RUNTIME && str)
+		{
+			library->runtimeVersion = str;
+		}
+		else if(kind == INDEX_REF && str)
+		{
+			refs = (const char **)ILRealloc
+				((void *)(library->assemblyRefs),
+				 sizeof(const char *) * (library->numAssemblyRefs + 1));
+			if(!refs)
+			{
+				break;
+			}
+			refs[(library->numAssemblyRefs)++] = str;
+			library->assemblyRefs = refs;
+		}
+		else if(kind == INDEX_MODULE && str)
+		{
+			if((str = ILDupString(str)) == 0)
+			{
+				break;
+			}
+			ILFree((void *)(library->moduleName));
+			library->moduleName = str;
+		}
+		else if(kind == INDEX_CLASS && str)
+		{
+			/* Records are in walk order, so the parent of a nested
+			   type is always on the stack of enclosing types */
+			while(depth > 0 && tokens[depth - 1] != value2)
+			{
+				--depth;
+			}
+			if((value2 != 0 && depth == 0) || depth >= INDEX_MAX_NESTING)
+			{
+				break;
+			}
+			libClass = AddLibraryClass
+				(linker, library, str, str2,
+				 (depth > 0 ? parents[depth - 1] : 0));
+			if(!libClass)
+			{
+				break;
+			}
+			tokens[depth] = value1;
+			parents[depth] = libClass;
+			++depth;
+		}
+		else if(kind == INDEX_SYMBOL && str)
+		{
+			if(!AddGlobalSymbol(linker, library, str, str2,
+								(int)value2, 0, value1))
+			{
+				break;
+			}
+		}
+		else
+		{
+			break;
+		}
 	}
 
-	/* Bail out if we already have a library with this filename */
-	if(FindLibraryByFilename(linker, newFilename) != 0)
+	/* Clean up if the index was not usable */
+	if(!ok)
 	{
-		ILFree(newFilename);
-		return 1;
+		if(library)
+		{
+			LibraryDestroy(library);
+		}
+		else
+		{
+			ILFree(buffer);
+		}
+		return 0;
 	}
+	return library;
+}
+
+/*
+ * Open a library file and load it as an image.  Returns zero
+ * if the library could not be loaded, with the reason in "load".
+ */
+static int LoadImage(ILLinker *linker, ILLibraryLoad *load)
+{
+	FILE *file;
 
 	/* Open the library file */
-	if((file = fopen(newFilename, "rb")) == NULL)
+	if((file = fopen(load->filename, "rb")) == NULL)
 	{
 		/* Try again in case libc does not understand "rb" */
-		if((file = fopen(newFilename, "r")) == NULL)
+		if((file = fopen(load->filename, "r")) == NULL)
 		{
-			perror(newFilename);
-			ILFree(newFilename);
-			linker->error = 1;
+			load->openError = errno;
 			return 0;
 		}
 	}
 
 	/* Load the library as an image */
-	context = ILContextCreate();
-	if(!context)
+	load->context = ILContextCreate();
+	if(!(load->context))
 	{
 		_ILLinkerOutOfMemory(linker);
-		ILFree(newFilename);
+		fclose(file);
 		return 0;
 	}
-	loadError = ILImageLoad(file, newFilename, context, &image,
-							IL_LOADFLAG_FORCE_32BIT | IL_LOADFLAG_NO_RESOLVE);
-	if(loadError)
+	load->loadError = ILImageLoad(file, load->filename, load->context,
+								  &(load->image),
+								  IL_LOADFLAG_FORCE_32BIT |
+								  IL_LOADFLAG_NO_RESOLVE);
+	fclose(file);
+	if(load->loadError)
 	{
-		linker->error = 1;
-		fprintf(stderr, "%s: %s\n", newFilename, ILImageLoadError(loadError));
-		ILContextDestroy(context);
-		fclose(file);
-		ILFree(newFilename);
+		ILContextDestroy(load->context);
+		load->context = 0;
+		load->image = 0;
 		return 0;
 	}
-	fclose(file);
+	return 1;
+}
+
+/*
+ * Report the reason why a library could not be loaded.
+ */
+static void ReportLoadError(ILLinker *linker, ILLibraryLoad *load)
+{
+	if(load->openError)
+	{
+		fprintf(stderr, "%s: %s\n", load->filename,
+				strerror(load->openError));
+	}
+	else if(load->loadError)
+	{
+		fprintf(stderr, "%s: %s\n", load->filename,
+				ILImageLoadError(load->loadError));
+	}
+	else if(load->image &&
+			ILImageNumTokens(load->image, IL_META_TOKEN_ASSEMBLY) == 0)
+	{
+		fprintf(stderr, "%s: missing assembly definition tokens\n",
+				load->filename);
+	}
+	linker->error = 1;
+}
+
+/*
+ * Load a library and scan it for classes and global symbols, or
+ * read them from the library's index.  This may be called on
+ * several threads at once for different libraries, and only
+ * touches the linker to set its error flags.  Errors are reported
+ * later by "FinishLoad", so that they appear in the same order
+ * as for a serial link.
+ */
+static void LoadLibraryFile(ILLinker *linker, ILLibraryLoad *load)
+{
+	int useIndex = ((linker->linkerFlags & IL_LINKFLAG_LIBRARY_INDEX) != 0);
+	unsigned char header[INDEX_HEADER_SIZE];
+	ILLibrary *library;
+
+	/* Use the index from the last time that the library was scanned */
+	if(useIndex && (load->library = IndexLoad(linker, load->filename)) != 0)
+	{
+		return;
+	}
+
+	/* Identify the library file before it is loaded, so that a new
+	   index is never stamped with a version that was not scanned */
+	useIndex = (useIndex && IndexHeader(load->filename, header));
 
-	/* Add the library image to the linker context */
-	library = AddLibrary(linker, context, image, newFilename);
+	/* Load the library image and create ILLibrary records
+	   for the assembly definitions */
+	if(!LoadImage(linker, load))
+	{
+		return;
+	}
+	library = ScanAssemblies(linker, load->context, load->image,
+							 load->filename);
 	if(!library)
 	{
-		linker->error = 1;
-		result = 0;
+		return;
 	}
 
-	/* Clean up temporary memory that we used */
-	ILFree(newFilename);
+	/* Walk the type definitions in the library to discover what is
+	   present, recording an index of them if requested */
+	if(useIndex)
+	{
+		library->index = (ILLibraryIndex *)ILCalloc(1, sizeof(ILLibraryIndex));
+		if(library->index)
+		{
+			ILMemCpy(library->index->header, header, INDEX_HEADER_SIZE);
+		}
+	}
+	if(!WalkTypeDefs(linker, load->image, library))
+	{
+		LibraryDestroy(library);
+		load->context = 0;
+		load->image = 0;
+		return;
+	}
+	IndexSave(library);
+	load->library = library;
+}
 
-	/* Add assemblies that were referenced by this library, because
-	   this library may contain TypeRef's in its public signatures
-	   to some other assembly, and we need to import them too */
-	if(result)
+/*
+ * Create a load record for a library, taking ownership of "filename".
+ */
+static ILLibraryLoad *CreateLoad(ILLinker *linker, char *filename)
+{
+	ILLibraryLoad *load = (ILLibraryLoad *)ILCalloc(1, sizeof(ILLibraryLoad));
+	if(!load)
 	{
-		assem = 0;
-		while((assem = (ILAssembly *)ILImageNextToken
-					(image, IL_META_TOKEN_ASSEMBLY_REF, (void *)assem)) != 0)
+		_ILLinkerOutOfMemory(linker);
+		ILFree(filename);
+		return 0;
+	}
+	load->filename = filename;
+	return load;
+}
+
+/*
+ * Destroy a load record, and the library if it was not used.
+ */
+static void DestroyLoad(ILLibraryLoad *load)
+{
+	if(load->library)
+	{
+		LibraryDestroy(load->library);
+	}
+	else if(load->context)
+	{
+		ILContextDestroy(load->context);
+	}
+	ILFree(load->filename);
+	ILFree(load);
+}
+
+/*
+ * Report the errors for a library load, and then destroy the load
+ * record.  Returns the library, or NULL if it could not be loaded.
+ */
+static ILLibrary *FinishLoad(ILLinker *linker, ILLibraryLoad *load)
+{
+	ILLibrary *library = load->library;
+	if(library)
+	{
+		/* The library now owns the context and image */
+		load->library = 0;
+		load->context = 0;
+	}
+	else
+	{
+		ReportLoadError(linker, load);
+	}
+	DestroyLoad(load);
+	return library;
+}
+
+/*
+ * Find a library by filename.
+ */
+static ILLibrary *FindLibraryByFilename(ILLinker *linker, const char *filename)
+{
+	ILLibrary *library;
+	library = linker->libraries;
+	while(library != 0)
+	{
+		if(!strcmp(library->filename, filename))
+		{
+			return library;
+		}
+		library = library->next;
+	}
+	return 0;
+}
+
+/*
+ * Find a library that was loaded ahead of time.  If "detach" is
+ * non-zero, then remove it from the list of preloaded libraries.
+ */
+static ILLibraryLoad *FindPreloaded(ILLinker *linker, const char *filename,
+									int detach)
+{
+	ILLibraryLoad *load = linker->preloaded;
+	ILLibraryLoad *prev = 0;
+	while(load != 0)
+	{
+		if(!strcmp(load->filename, filename))
+		{
+			if(detach)
+			{
+				if(prev)
+				{
+					prev->next = load->next;
+				}
+				else
+				{
+					linker->preloaded = load->next;
+				}
+				load->next = 0;
+			}
+			return load;
+		}
+		prev = load;
+		load = load->next;
+	}
+	return 0;
+}
+
+/*
+ * Queue a library to be loaded in a specific round of scanning,
+ * if it has not been loaded already.  Libraries that cannot be
+ * resolved are skipped, so that "ILLinkerAddLibrary" reports them.
+ */
+static void QueuePreload(ILLinker *linker, const char *name, int round)
+{
+	char *filename;
+	ILLibraryLoad *load;
+	if(_ILLinkerFindLibrary(linker, name) != 0)
+	{
+		return;
+	}
+	if((filename = ILLinkerResolveLibrary(linker, name)) == 0)
+	{
+		return;
+	}
+	if(FindLibraryByFilename(linker, filename) != 0 ||
+	   FindPreloaded(linker, filename, 0) != 0)
+	{
+		ILFree(filename);
+		return;
+	}
+	if((load = CreateLoad(linker, filename)) != 0)
+	{
+		load->round = round;
+		load->next = linker->preloaded;
+		linker->preloaded = load;
+	}
+}
+
+/*
+ * Queue of libraries that are being scanned by worker threads.
+ */
+#define	IL_LINKER_SCAN_THREADS		4
+typedef struct
+{
+	ILLinker	   *linker;
+	ILLibraryLoad **loads;
+	int				numLoads;
+	int				nextLoad;
+	ILMutex		   *lock;
+
+} ScanQueue;
+
+/*
+ * Get the number of processors that can be used for scanning.
+ */
+static int ScanProcessors(void)
+{
+#ifdef _SC_NPROCESSORS_ONLN
+	long num = sysconf(_SC_NPROCESSORS_ONLN);
+	if(num > 0)
+	{
+		return (int)num;
+	}
+#endif
+	return 1;
+}
+
+/*
+ * Scan libraries from a queue until it is empty.
+ */
+static void ScanWorker(void *arg)
+{
+	ScanQueue *queue = (ScanQueue *)arg;
+	int posn;
+	for(;;)
+	{
+		ILMutexLock(queue->lock);
+		posn = queue->nextLoad++;
+		ILMutexUnlock(queue->lock);
+		if(posn >= queue->numLoads)
+		{
+			break;
+		}
+		LoadLibraryFile(queue->linker, queue->loads[posn]);
+	}
+}
+
+/*
+ * Load and scan all libraries that were queued for a round, using
+ * worker threads if they are available.  Returns the number of
+ * libraries that were scanned.
+ */
+static int ScanRound(ILLinker *linker, int round)
+{
+	ScanQueue queue;
+	ILThread *threads[IL_LINKER_SCAN_THREADS - 1];
+	int numThreads, maxThreads, posn;
+	ILLibraryLoad *load;
+
+	/* Collect the libraries for this round */
+	queue.numLoads = 0;
+	for(load = linker->preloaded; load != 0; load = load->next)
+	{
+		if(load->round == round)
 		{
-			if(!ILLinkerAddLibrary(linker, ILAssembly_Name(assem)))
+			++(queue.numLoads);
+		}
+	}
+	if(!(queue.numLoads))
+	{
+		return 0;
+	}
+	queue.loads = (ILLibraryLoad **)ILMalloc
+		(sizeof(ILLibraryLoad *) * queue.numLoads);
+	if(!(queue.loads))
+	{
+		_ILLinkerOutOfMemory(linker);
+		return 0;
+	}
+	posn = queue.numLoads;
+	for(load = linker->preloaded; load != 0; load = load->next)
+	{
+		if(load->round == round)
+		{
+			/* The list is in reverse order of queueing */
+			queue.loads[--posn] = load;
+		}
+	}
+	queue.linker = linker;
+	queue.nextLoad = 0;
+	queue.lock = 0;
+
+	/* Start the worker threads, and then help them on this thread */
+	numThreads = 0;
+	maxThreads = ScanProcessors();
+	if(maxThreads > IL_LINKER_SCAN_THREADS)
+	{
+		maxThreads = IL_LINKER_SCAN_THREADS;
+	}
+	if(maxThreads > queue.numLoads)
+	{
+		maxThreads = queue.numLoads;
+	}
+	if(maxThreads > 1 && ILHasThreads())
+	{
+		ILThreadInit();
+		queue.lock = ILMutexCreate();
+	}
+	if(queue.lock)
+	{
+		while(numThreads < (maxThreads - 1))
+		{
+			threads[numThreads] = ILThreadCreate(ScanWorker, &queue);
+			if(!threads[numThreads])
+			{
+				break;
+			}
+			if(!ILThreadStart(threads[numThreads]))
 			{
-				result = 0;
+				ILThreadDestroy(threads[numThreads]);
 				break;
 			}
+			++numThreads;
+		}
+		ScanWorker(&queue);
+		for(posn = 0; posn < numThreads; ++posn)
+		{
+			ILThreadJoin(threads[posn], IL_WAIT_INFINITE);
+			ILThreadDestroy(threads[posn]);
+		}
+		ILMutexDestroy(queue.lock);
+	}
+	else
+	{
+		for(posn = 0; posn < queue.numLoads; ++posn)
+		{
+			LoadLibraryFile(linker, queue.loads[posn]);
+		}
+	}
+	ILFree(queue.loads);
+	return 1;
+}
+
+/*
+ * Load and scan a list of libraries and everything that they
+ * reference, one level of references at a time.
+ */
+static void PreloadLibraries(ILLinker *linker, const char * const *names,
+							 int numNames)
+{
+	ILLibraryLoad *load;
+	int round = 1;
+	int posn;
+
+	for(posn = 0; posn < numNames; ++posn)
+	{
+		QueuePreload(linker, names[posn], round);
+	}
+	while(ScanRound(linker, round))
+	{
+		for(load = linker->preloaded; load != 0; load = load->next)
+		{
+			if(load->round == round && load->library)
+			{
+				for(posn = 0; posn < load->library->numAssemblyRefs; ++posn)
+				{
+					QueuePreload(linker, load->library->assemblyRefs[posn],
+								 round + 1);
+				}
+			}
+		}
+		++round;
+	}
+}
+
+/*
+ * Discard libraries that were loaded ahead of time but not used.
+ */
+static void DiscardPreloaded(ILLinker *linker)
+{
+	ILLibraryLoad *load;
+	while((load = linker->preloaded) != 0)
+	{
+		linker->preloaded = load->next;
+		DestroyLoad(load);
+	}
+}
+
+int ILLinkerAddLibrary(ILLinker *linker, const char *name)
+{
+	char *newFilename;
+	ILLibraryLoad *load;
+	ILLibrary *library;
+	int posn;
+
+	/* Bail out if we already have a library with this assembly name */
+	if(_ILLinkerFindLibrary(linker, name) != 0)
+	{
+		return 1;
+	}
+
+	/* Resolve the library name */
+	newFilename = ILLinkerResolveLibrary(linker, name);
+	if(!newFilename)
+	{
+		fprintf(stderr, "%s: library not found\n", name);
+		linker->error = 1;
+		return 0;
+	}
+
+	/* Bail out if we already have a library with this filename */
+	if(FindLibraryByFilename(linker, newFilename) != 0)
+	{
+		ILFree(newFilename);
+		return 1;
+	}
+
+	/* Use the library if it was scanned ahead of time, or scan it now */
+	load = FindPreloaded(linker, newFilename, 1);
+	if(load)
+	{
+		ILFree(newFilename);
+	}
+	else
+	{
+		if((load = CreateLoad(linker, newFilename)) == 0)
+		{
+			return 0;
 		}
+		LoadLibraryFile(linker, load);
+	}
+	library = FinishLoad(linker, load);
+	if(!library)
+	{
+		return 0;
+	}
+
+	/* Add the library to the linker's list */
+	if(linker->lastLibrary)
+	{
+		linker->lastLibrary->next = library;
 	}
+	else
+	{
+		linker->libraries = library;
+	}
+	linker->lastLibrary = library;
 
-	/* Walk the type definitions in the library to discover what is present */
-	if(result && !WalkTypeDefs(linker, image, library))
+	/* Add assemblies that were referenced by this library, because
+	   this library may contain TypeRef's in its public signatures
+	   to some other assembly, and we need to import them too */
+	for(posn = 0; posn < library->numAssemblyRefs; ++posn)
 	{
-		result = 0;
+		if(!ILLinkerAddLibrary(linker, library->assemblyRefs[posn]))
+		{
+			return 0;
+		}
 	}
+	return 1;
+}
+
+int ILLinkerAddLibraries(ILLinker *linker, const char * const *names,
+						 int numNames)
+{
+	int result = 1;
+	int posn;
 
-	/* Return the final result to the caller */
+	/* Load and scan the libraries ahead of time, in parallel */
+	PreloadLibraries(linker, names, numNames);
+
+	/* Add the libraries to the linker's list in order */
+	for(posn = 0; posn < numNames; ++posn)
+	{
+		if(!ILLinkerAddLibrary(linker, names[posn]))
+		{
+			result = 0;
+		}
+	}
+	DiscardPreloaded(linker);
 	return result;
 }
 
@@ -842,6 +1765,7 @@ void _ILLinkerDestroyLibraries(ILLinker *linker)
 {
 	ILLibrary *library;
 	ILLibrary *next;
+	DiscardPreloaded(linker);
 	library = linker->libraries;
 	while(library != 0)
 	{
@@ -1110,6 +2034,32 @@ ILClass *_ILLinkerMakeTypeRef(ILLibraryFind *find, ILImage *image)
 	}
 }
 
+/*
+ * Get the image for a library, loading it now if the library was
+ * created from its index.  Returns NULL if it cannot be loaded.
+ */
+static ILImage *LibraryImage(ILLinker *linker, ILLibrary *library)
+{
+	ILLibraryLoad load;
+	ILLibrary *altName;
+	if(!(library->image))
+	{
+		ILMemZero(&load, sizeof(load));
+		load.filename = (char *)(library->filename);
+		if(!LoadImage(linker, &load))
+		{
+			ReportLoadError(linker, &load);
+			return 0;
+		}
+		for(altName = library; altName != 0; altName = altName->altNames)
+		{
+			altName->context = load.context;
+			altName->image = load.image;
+		}
+	}
+	return library->image;
+}
+
 /*
  * Create a "MemberRef" token that refers to a global symbol in a library.
  */
@@ -1129,6 +2079,23 @@ static ILMember *CreateSymbolRef(ILLinker *linker, ILLibrary *library,
 		return libSymbol->member;
 	}
 
+	/* Find the member definition if the library was created from its index */
+	if(library && !(libSymbol->member))
+	{
+		if(!LibraryImage(linker, library))
+		{
+			return 0;
+		}
+		libSymbol->member = ILMember_FromToken(library->image, libSymbol->token);
+		if(!(libSymbol->member))
+		{
+			fprintf(stderr, "%s: %s: symbol is missing from the library\n",
+					library->filename, libSymbol->name);
+			linker->error = 1;
+			return 0;
+		}
+	}
+
 	/* Make a "TypeRef" for the library's "<Module>" type */
 	if(libSymbol->member &&
 	   !_ILLinkerIsModule(ILMember_Owner(libSymbol->member)))
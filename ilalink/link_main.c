@@ -132,7 +132,10 @@ static ILCmdLineOption const options[] = {
 	{"-G", 'G', 0,
 		"-mgui-subsystem             or -G",
 		"Link for the GUI subsystem."},
-	{"-f", 'f', 1, 0, 0},
+	{"-f", 'f', 1,
+		"-flibrary-index",
+		"Keep an index of each library's classes and symbols in a\n"
+		"`.ilidx' file next to it, to speed up later links."},
 	{"-m", 'm', 1, 0, 0},
 	{"-v", 'v', 0, 0, 0},
 	{"--version", 'v', 0,
@@ -236,8 +239,9 @@ int ILLinkerMain(int argc, char *argv[])
 	int temp, temp2;
 	ILLinker *linker;
 
-	/* Allocate an array to hold the libraries to link against */
-	libraries = (char **)ILCalloc(argc, sizeof(char *));
+	/* Allocate an array to hold the libraries to link against,
+	   with room for the standard library at the front */
+	libraries = (char **)ILCalloc(argc + 1, sizeof(char *));
 	if(!libraries)
 	{
 		outOfMemory();
@@ -589,6 +593,10 @@ int ILLinkerMain(int argc, char *argv[])
 				{
 					linkerFlags |= IL_LINKFLAG_MINIMIZE_PARAMS;
 				}
+				else if(!strcmp(param, "library-index"))
+				{
+					linkerFlags |= IL_LINKFLAG_LIBRARY_INDEX;
+				}
 				else
 				{
 					/* All other flags are ignored, because they may
@@ -804,15 +812,18 @@ int ILLinkerMain(int argc, char *argv[])
 		errors |= !ILLinkerAddLibraryDir(linker, libraryDirs[temp]);
 	}
 
-	/* Add the libraries to the linker context */
+	/* Add the libraries to the linker context, scanning them in parallel */
 	if(useStdlib)
 	{
-		errors |= addLibrary(linker, stdLibrary);
-	}
-	for(temp = 0; temp < numLibraries; ++temp)
-	{
-		errors |= addLibrary(linker, libraries[temp]);
+		for(temp = numLibraries; temp > 0; --temp)
+		{
+			libraries[temp] = libraries[temp - 1];
+		}
+		libraries[0] = stdLibrary;
+		++numLibraries;
 	}
+	errors |= !ILLinkerAddLibraries(linker, (const char * const *)libraries,
+									numLibraries);
 
 	/* Set the metadata version in the assembly's header */
 	ILLinkerSetMetadataVersion(linker, metadataVersion, stdLibrary);
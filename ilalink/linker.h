@@ -56,6 +56,7 @@ struct _tagILLibrarySymbol
 	const char	   *aliasFor;		/* Intern'ed name of the aliased symbol */
 	int				flags;			/* Flags that define the symbol kind */
 	ILMember       *member;			/* Member reference information */
+	ILToken			token;			/* Member token in the library image */
 };
 
 /*
@@ -78,6 +79,11 @@ typedef union
 
 } ILLibraryClassOrSymbol;
 
+/*
+ * Class and symbol index that is recorded while a library is scanned.
+ */
+typedef struct _tagILLibraryIndex ILLibraryIndex;
+
 /*
  * Information that is stored for a library assembly.
  */
@@ -97,10 +103,33 @@ struct _tagILLibrary
 	ILMemPool		pool;			/* Memory pool for symbol allocation */
 	ILContext      *context;		/* Context containing the library image */
 	ILImage        *image;			/* Image that corresponds to the library */
+	const char	   *runtimeVersion;	/* Runtime version, if no image yet */
+	const char	  **assemblyRefs;	/* Names of referenced assemblies */
+	int				numAssemblyRefs;/* Number of referenced assemblies */
+	ILLibraryIndex *index;			/* Index being recorded, or NULL */
+	unsigned char  *indexData;		/* Index that the names point into */
 	ILLibrary	   *next;			/* Next library used by the linker */
 
 };
 
+/*
+ * Library that has been loaded and scanned ahead of being
+ * added to the linker's list.
+ */
+typedef struct _tagILLibraryLoad ILLibraryLoad;
+struct _tagILLibraryLoad
+{
+	char		   *filename;		/* Resolved filename of the library */
+	ILContext	   *context;		/* Context containing the library image */
+	ILImage		   *image;			/* Library image, or NULL on error */
+	ILLibrary	   *library;		/* Scanned library records, or NULL */
+	int				openError;		/* "errno" value if the open failed */
+	int				loadError;		/* Error code if the image load failed */
+	int				round;			/* Round of scanning that loaded it */
+	ILLibraryLoad  *next;			/* Next library that was loaded ahead */
+
+};
+
 /*
  * Information that is stored for an image to be linked.
  */
@@ -123,6 +152,7 @@ struct _tagILLinker
 	ILWriter	   *writer;			/* Writer being used by the linker */
 	ILLibrary	   *libraries;		/* Libraries being used by the linker */
 	ILLibrary      *lastLibrary;	/* Last library being used by the linker */
+	ILLibraryLoad  *preloaded;		/* Libraries that were scanned ahead */
 	char          **libraryDirs;	/* List of library directories */
 	int				numLibraryDirs;	/* Number of library directories */
 	int				outOfMemory;	/* Set to non-zero when out of memory */
@@ -19,6 +19,7 @@
  */
 
 #include "program.h"
+#include "../support/interlocked.h"
 
 #ifdef	__cplusplus
 extern	"C" {
@@ -1641,6 +1642,10 @@ ILMember *ILClassNextMember(ILClass *info, ILMember *last)
 		info = ILClassGetUnderlying(info);
 		if(info)
 		{
+			if(_ILClassMembersPending(info))
+			{
+				_ILClassLoadMembers(info);
+			}
 			return info->firstMember;
 		}
 	}
@@ -1658,6 +1663,10 @@ ILMember *ILClassNextMemberByKind(ILClass *info, ILMember *last, int kind)
 		info = ILClassGetUnderlying(info);
 		if(info)
 		{
+			if(_ILClassMembersPending(info))
+			{
+				_ILClassLoadMembers(info);
+			}
 			last = info->firstMember;
 		}
 	}
@@ -1688,6 +1697,10 @@ ILMember *ILClassNextMemberMatch(ILClass *info, ILMember *last, int kind,
 		info = ILClassGetUnderlying(info);
 		if(info)
 		{
+			if(_ILClassMembersPending(info))
+			{
+				_ILClassLoadMembers(info);
+			}
 			last = info->firstMember;
 		}
 	}
@@ -2232,8 +2245,13 @@ ILMethod *ILClassGetMethodImplForProxy(ILClass *info, ILMethod *method)
 void ILClassDetachMember(ILMember *member)
 {
 	ILClass *info = member->owner;
-	ILMember *current = info->firstMember;
+	ILMember *current;
 	ILMember *prev = 0;
+	if(_ILClassMembersPending(info))
+	{
+		_ILClassLoadMembers(info);
+	}
+	current = info->firstMember;
 	while(current != 0 && current != member)
 	{
 		prev = current;
@@ -2258,6 +2276,10 @@ void ILClassDetachMember(ILMember *member)
 
 void ILClassAttachMember(ILClass *info, ILMember *member)
 {
+	if(_ILClassMembersPending(info))
+	{
+		_ILClassLoadMembers(info);
+	}
 	member->owner = info;
 	if(info->lastMember)
 	{
@@ -278,6 +278,11 @@ ILContext *ILContextCreate(void)
 		ILFree(context);
 		return 0;
 	}
+	if((context->lazyLock = ILMutexCreate()) == 0)
+	{
+		ILContextDestroy(context);
+		return 0;
+	}
 	return context;
 }
 
@@ -301,6 +306,12 @@ void ILContextDestroy(ILContext *context)
 	/* Destroy the type pool */
 	ILMemPoolDestroy(&(context->typePool));
 
+	/* Destroy the lazy loading lock */
+	if(context->lazyLock)
+	{
+		ILMutexDestroy(context->lazyLock);
+	}
+
 	/* Destory the redo table */
 	if(context->redoItems)
 	{
@@ -329,6 +340,30 @@ void ILContextDestroy(ILContext *context)
 	ILFree(context);
 }
 
+void _ILContextLazyLock(ILContext *context)
+{
+	ILThread *self = ILThreadSelf();
+
+	/* Only the owner can see its own thread in "lazyOwner" */
+	if(context->lazyDepth > 0 && context->lazyOwner == self)
+	{
+		++(context->lazyDepth);
+		return;
+	}
+	ILMutexLock(context->lazyLock);
+	context->lazyOwner = self;
+	context->lazyDepth = 1;
+}
+
+void _ILContextLazyUnlock(ILContext *context)
+{
+	if(--(context->lazyDepth) == 0)
+	{
+		context->lazyOwner = 0;
+		ILMutexUnlock(context->lazyLock);
+	}
+}
+
 const char *_ILContextPersistString(ILImage *image, const char *str)
 {
 	if(str)
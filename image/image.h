@@ -24,6 +24,7 @@
 #include "il_values.h"
 #include "il_system.h"
 #include "il_utils.h"
+#include "il_thread.h"
 #include "il_program.h"
 #if !defined(__palmos__)
 #define	IL_USE_WRITER
@@ -58,6 +59,11 @@ extern	"C" {
 			(((ILUInt64)(IL_BREAD_UINT32((buf) + 4))) | \
 			 (((ILUInt64)(IL_BREAD_UINT32((buf)))) << 32))
 
+/*
+ * Opaque definition of a class whose members are being loaded on demand.
+ */
+typedef struct _tagILLazyLoading ILLazyLoading;
+
 /*
  * Structure of a context, which holds multiple loaded images,
  * and the information about the classes, methods, etc, in them.
@@ -118,6 +124,15 @@ struct _tagILContext
 	ILUInt32		maxRedoItems;
 	ILUInt32		redoLevel;
 
+	/* Lock that serializes loading members on demand.  It may be
+	   acquired recursively by the thread that owns it */
+	ILMutex		   *lazyLock;
+	ILThread	   *lazyOwner;
+	int				lazyDepth;
+
+	/* Classes whose members are being loaded by the lock owner */
+	ILLazyLoading  *lazyLoading;
+
 };
 
 /*
@@ -159,6 +174,7 @@ typedef struct _tagILSectionMap
  */
 #define	IL_NORMAL_BLOCK_SIZE	1024
 typedef struct _tagILStringBlock ILStringBlock;
+typedef struct _tagILLazyMembers ILLazyMembers;
 struct _tagILStringBlock
 {
 	ILStringBlock  *next;
@@ -238,8 +254,12 @@ struct _tagILImage
 	unsigned char	tokenSize[64];	/* Size of each token's record */
 	unsigned char  *tokenStart[64];	/* Start of each token table */
 	void		  **tokenData[64];	/* Data associated with the tokens */
+	void		  **tokenLoaded[64];/* Fully loaded items of lazy images */
 	ILUInt64		sorted;			/* Token tables that are sorted */
 
+	/* Index for loading class members on demand, or NULL if eager */
+	ILLazyMembers  *lazyMembers;
+
 };
 
 /*
@@ -444,6 +464,15 @@ struct _tagILWriter
 
 #endif /* IL_USE_WRITER */
 
+/*
+ * Acquire and release the lock that serializes loading metadata on
+ * demand within a context.  The lock is recursive, because loading
+ * the members of one class can require the members of other classes.
+ * The runtime engine also holds it while it has metadata write-locked.
+ */
+void _ILContextLazyLock(ILContext *context);
+void _ILContextLazyUnlock(ILContext *context);
+
 /*
  * Create a persistent version of a string if necessary.
  * This is typically used on class names and the like which
@@ -515,6 +544,11 @@ int _ILImageRedoReferences(ILContext *context);
  */
 void *_ILImageLoadOnDemand(ILImage *image, ILToken token);
 
+/*
+ * Free the index that is used to load class members on demand.
+ */
+void _ILImageFreeLazyMembers(ILImage *image);
+
 /*
  * Determine if a token has already been loaded.
  */
@@ -1026,8 +1026,10 @@ int ILImageLoadAssembly(const char *name, ILContext *context,
 	}
 
 	/* If the assembly was loaded from a system directory, then we
-	   can assume that it is being loaded from a secure location */
-	flags = IL_LOADFLAG_FORCE_32BIT;
+	   can assume that it is being loaded from a secure location.
+	   Load it lazily if the parent image was loaded lazily */
+	flags = IL_LOADFLAG_FORCE_32BIT |
+			(parentImage->loadFlags & IL_LOADFLAG_LAZY_METADATA);
 	if(sameDir)
 	{
 		flags |= (parentImage->secure ? 0 : IL_LOADFLAG_INSECURE);
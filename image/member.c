@@ -19,6 +19,7 @@
  */
 
 #include "program.h"
+#include "../support/interlocked.h"
 
 #ifdef	__cplusplus
 extern	"C" {
@@ -365,7 +366,12 @@ static ILMember *MemberCreate(ILClass *info, ILToken token,
 		return 0;
 	}
 
-	/* Attach the member to its owning class */
+	/* Attach the member to its owning class, after any members
+	   that were deferred when the class was loaded */
+	if(_ILClassMembersPending(info))
+	{
+		_ILClassLoadMembers(info);
+	}
 	member->owner = info;
 	member->nextMember = 0;
 	if(info->lastMember)
@@ -19,6 +19,7 @@
  */
 
 #include "program.h"
+#include "../support/interlocked.h"
 #include <stdio.h>
 
 #ifdef	__cplusplus
@@ -1768,6 +1769,12 @@ static int Load_FieldDefOnDemand(ILImage *image, ILUInt32 *values,
 		return IL_LOADERR_BAD_META;
 	}
 
+	/* Load the members of the type if they were deferred */
+	if(_ILClassMembersPending(classInfo))
+	{
+		_ILClassLoadMembers(classInfo);
+	}
+
 	/* Done */
 	return 0;
 }
@@ -1959,6 +1966,48 @@ static int Load_MethodDefOnDemand(ILImage *image, ILUInt32 *values,
 		return IL_LOADERR_BAD_META;
 	}
 
+	/* Load the members of the type if they were deferred */
+	if(_ILClassMembersPending(classInfo))
+	{
+		_ILClassLoadMembers(classInfo);
+	}
+
+	/* Done */
+	return 0;
+}
+
+/*
+ * Load the fields and methods for a class, given its TypeDef values.
+ */
+static int LoadFieldsAndMethods(ILImage *image, ILClass *info,
+								ILUInt32 *values, ILUInt32 *valuesNext,
+								ILToken token)
+{
+	ILUInt32 num;
+	int error;
+
+	/* Load the fields */
+	if(!SizeOfRange(image, IL_META_TOKEN_FIELD_DEF,
+					values, valuesNext, IL_OFFSET_TYPEDEF_FIRST_FIELD, &num))
+	{
+		META_VAL_ERROR("invalid field count");
+		return IL_LOADERR_BAD_META;
+	}
+	EXIT_IF_ERROR(LoadTokenRange(image, IL_META_TOKEN_FIELD_DEF,
+								 values[IL_OFFSET_TYPEDEF_FIRST_FIELD], num,
+								 Load_FieldDef, info));
+
+	/* Load the methods */
+	if(!SizeOfRange(image, IL_META_TOKEN_METHOD_DEF,
+					values, valuesNext, IL_OFFSET_TYPEDEF_FIRST_METHOD, &num))
+	{
+		META_VAL_ERROR("invalid method count");
+		return IL_LOADERR_BAD_META;
+	}
+	EXIT_IF_ERROR(LoadTokenRange(image, IL_META_TOKEN_METHOD_DEF,
+								 values[IL_OFFSET_TYPEDEF_FIRST_METHOD], num,
+								 Load_MethodDef, info));
+
 	/* Done */
 	return 0;
 }
@@ -1971,8 +2020,6 @@ static int Load_TypeDefPhase2(ILImage *image, ILUInt32 *values,
 						      void *userData)
 {
 	ILClass *info;
-	ILUInt32 num;
-	int error;
 
 	/* Get the class information block for the token */
 	info = ILClass_FromToken(image, token);
@@ -1991,30 +2038,15 @@ static int Load_TypeDefPhase2(ILImage *image, ILUInt32 *values,
 		return IL_LOADERR_BAD_META;
 	}
 
-	/* Load the fields */
-	if(!SizeOfRange(image, IL_META_TOKEN_FIELD_DEF,
-					values, valuesNext, IL_OFFSET_TYPEDEF_FIRST_FIELD, &num))
-	{
-		META_VAL_ERROR("invalid field count");
-		return IL_LOADERR_BAD_META;
-	}
-	EXIT_IF_ERROR(LoadTokenRange(image, IL_META_TOKEN_FIELD_DEF,
-								 values[IL_OFFSET_TYPEDEF_FIRST_FIELD], num,
-								 Load_FieldDef, info));
-
-	/* Load the methods */
-	if(!SizeOfRange(image, IL_META_TOKEN_METHOD_DEF,
-					values, valuesNext, IL_OFFSET_TYPEDEF_FIRST_METHOD, &num))
+	/* Defer the members until the class is used if loading lazily */
+	if(image->lazyMembers)
 	{
-		META_VAL_ERROR("invalid method count");
-		return IL_LOADERR_BAD_META;
+		info->attributes |= IL_META_TYPEDEF_MEMBERS_PENDING;
+		return 0;
 	}
-	EXIT_IF_ERROR(LoadTokenRange(image, IL_META_TOKEN_METHOD_DEF,
-								 values[IL_OFFSET_TYPEDEF_FIRST_METHOD], num,
-								 Load_MethodDef, info));
 
 	/* Done: we'll get the events, properties, and interfaces later */
-	return 0;
+	return LoadFieldsAndMethods(image, info, values, valuesNext, token);
 }
 
 /*
@@ -3500,6 +3532,503 @@ static int Load_MethodSpec(ILImage *image, ILUInt32 *values,
 	return 0;
 }
 
+/*
+ * Rows of a table, grouped by the TypeDef, Event, or Property that
+ * owns them.  The rows for owner "N" are "rows[start[N]]" up to,
+ * but not including, "rows[start[N + 1]]".
+ */
+typedef struct
+{
+	ILUInt32	   *start;			/* Start of each owner's rows */
+	ILUInt32	   *rows;			/* Row numbers, in table order */
+
+} ILLazyOwnerIndex;
+
+/*
+ * Index that is used to load the members of one class at a time,
+ * when an image is loaded with "IL_LOADFLAG_LAZY_METADATA".  It is
+ * built the first time that the members of a class are needed.
+ */
+struct _tagILLazyMembers
+{
+	int					built;			/* 1 if built, -1 if failed */
+	ILUInt32		   *eventOwners;	/* Owning TypeDef for each Event */
+	ILUInt32		   *propertyOwners;	/* Owning TypeDef for each Property */
+	ILLazyOwnerIndex	events;			/* Events for each TypeDef */
+	ILLazyOwnerIndex	properties;		/* Properties for each TypeDef */
+	ILLazyOwnerIndex	eventSems;		/* MethodSemantics for each Event */
+	ILLazyOwnerIndex	propertySems;	/* MethodSemantics for each Property */
+	ILLazyOwnerIndex	overrides;		/* MethodImpl's for each TypeDef */
+
+};
+
+/*
+ * State for scanning a table to find the owner of each row.
+ */
+typedef struct
+{
+	ILUInt32	   *owners;			/* Owner token for each row */
+	int				ownerColumn;	/* Column that contains the owner */
+	int				rangeColumn;	/* Column that contains the row range */
+	unsigned long	rangeType;		/* Table that the range refers to */
+
+} ILLazyScan;
+
+/*
+ * Record the owner of a row that names its owner directly.
+ */
+static int Index_Owner(ILImage *image, ILUInt32 *values,
+					   ILUInt32 *valuesNext, ILToken token,
+					   void *userData)
+{
+	ILLazyScan *scan = (ILLazyScan *)userData;
+	scan->owners[token & ~IL_META_TOKEN_MASK] = values[scan->ownerColumn];
+	return 0;
+}
+
+/*
+ * Record the owner of each row in an EventMap or PropertyMap range.
+ */
+static int Index_OwnerRange(ILImage *image, ILUInt32 *values,
+							ILUInt32 *valuesNext, ILToken token,
+							void *userData)
+{
+	ILLazyScan *scan = (ILLazyScan *)userData;
+	ILUInt32 first, num;
+	if(!SizeOfRange(image, scan->rangeType, values, valuesNext,
+					scan->rangeColumn, &num))
+	{
+		META_VAL_ERROR("invalid member count");
+		return IL_LOADERR_BAD_META;
+	}
+	first = (values[scan->rangeColumn] & ~IL_META_TOKEN_MASK);
+	if(num > 0 &&
+	   (first + num - 1) > image->tokenCount[scan->rangeType >> 24])
+	{
+		META_VAL_ERROR("member range is out of bounds");
+		return IL_LOADERR_BAD_META;
+	}
+	while(num > 0)
+	{
+		scan->owners[first++] = values[scan->ownerColumn];
+		--num;
+	}
+	return 0;
+}
+
+/*
+ * Scan a table to find the owner of each row in "rowType".
+ * Returns an array indexed by row number, or NULL on error.
+ */
+static ILUInt32 *ScanOwners(ILImage *image, ILToken rowType,
+							ILToken tableType, TokenLoadFunc func,
+							int ownerColumn, int rangeColumn)
+{
+	ILLazyScan scan;
+	scan.owners = (ILUInt32 *)ILCalloc
+		(image->tokenCount[rowType >> 24] + 1, sizeof(ILUInt32));
+	if(!(scan.owners))
+	{
+		return 0;
+	}
+	scan.ownerColumn = ownerColumn;
+	scan.rangeColumn = rangeColumn;
+	scan.rangeType = rowType;
+	if(LoadTokens(image, tableType, func, &scan) != 0)
+	{
+		ILFree(scan.owners);
+		return 0;
+	}
+	return scan.owners;
+}
+
+/*
+ * Group the rows in "rowType" by owner.  "owners" contains the owner
+ * token for each row, and only owners in "ownerType" are indexed.
+ * Returns zero if out of memory.
+ */
+static int BuildOwnerIndex(ILImage *image, ILLazyOwnerIndex *index,
+						   const ILUInt32 *owners, ILToken rowType,
+						   ILToken ownerType)
+{
+	ILUInt32 numRows = image->tokenCount[rowType >> 24];
+	ILUInt32 numOwners = image->tokenCount[ownerType >> 24];
+	ILUInt32 row, owner;
+
+	/* Count the rows for each owner, and convert into start offsets */
+	index->start = (ILUInt32 *)ILCalloc(numOwners + 2, sizeof(ILUInt32));
+	if(!(index->start))
+	{
+		return 0;
+	}
+	for(row = 1; row <= numRows; ++row)
+	{
+		owner = owners[row];
+		if((owner & IL_META_TOKEN_MASK) == ownerType &&
+		   (owner & ~IL_META_TOKEN_MASK) >= 1 &&
+		   (owner & ~IL_META_TOKEN_MASK) <= numOwners)
+		{
+			++(index->start[(owner & ~IL_META_TOKEN_MASK) + 1]);
+		}
+	}
+	for(owner = 1; owner <= numOwners + 1; ++owner)
+	{
+		index->start[owner] += index->start[owner - 1];
+	}
+
+	/* Place the rows, using "start" as a cursor for each owner.
+	   Afterwards, "start[N]" is where "start[N + 1]" was before */
+	index->rows = (ILUInt32 *)ILMalloc
+		((index->start[numOwners + 1] + 1) * sizeof(ILUInt32));
+	if(!(index->rows))
+	{
+		return 0;
+	}
+	for(row = 1; row <= numRows; ++row)
+	{
+		owner = owners[row];
+		if((owner & IL_META_TOKEN_MASK) == ownerType &&
+		   (owner & ~IL_META_TOKEN_MASK) >= 1 &&
+		   (owner & ~IL_META_TOKEN_MASK) <= numOwners)
+		{
+			index->rows[(index->start[owner & ~IL_META_TOKEN_MASK])++] = row;
+		}
+	}
+	for(owner = numOwners + 1; owner > 0; --owner)
+	{
+		index->start[owner] = index->start[owner - 1];
+	}
+	index->start[0] = 0;
+	return 1;
+}
+
+/*
+ * Build the lazy member index for an image.  Returns zero on error.
+ */
+static int BuildLazyMembers(ILImage *image)
+{
+	ILLazyMembers *lazy = image->lazyMembers;
+	ILUInt32 *owners;
+	int ok;
+
+	/* Bail out if the index has already been built */
+	if(lazy->built != 0)
+	{
+		return (lazy->built > 0);
+	}
+	lazy->built = -1;
+
+	/* Find the events and properties for each TypeDef */
+	lazy->eventOwners = ScanOwners
+		(image, IL_META_TOKEN_EVENT, IL_META_TOKEN_EVENT_MAP,
+		 Index_OwnerRange, IL_OFFSET_EVENTMAP_TYPE, IL_OFFSET_EVENTMAP_EVENT);
+	if(!(lazy->eventOwners) ||
+	   !BuildOwnerIndex(image, &(lazy->events), lazy->eventOwners,
+	   					IL_META_TOKEN_EVENT, IL_META_TOKEN_TYPE_DEF))
+	{
+		return 0;
+	}
+	lazy->propertyOwners = ScanOwners
+		(image, IL_META_TOKEN_PROPERTY, IL_META_TOKEN_PROPERTY_MAP,
+		 Index_OwnerRange, IL_OFFSET_PROPMAP_TYPE, IL_OFFSET_PROPMAP_PROPERTY);
+	if(!(lazy->propertyOwners) ||
+	   !BuildOwnerIndex(image, &(lazy->properties), lazy->propertyOwners,
+	   					IL_META_TOKEN_PROPERTY, IL_META_TOKEN_TYPE_DEF))
+	{
+		return 0;
+	}
+
+	/* Find the method semantics for each event and property */
+	owners = ScanOwners(image, IL_META_TOKEN_METHOD_SEMANTICS,
+						IL_META_TOKEN_METHOD_SEMANTICS, Index_Owner,
+						IL_OFFSET_METHODSEM_OWNER, 0);
+	if(!owners)
+	{
+		return 0;
+	}
+	ok = (BuildOwnerIndex(image, &(lazy->eventSems), owners,
+						  IL_META_TOKEN_METHOD_SEMANTICS,
+						  IL_META_TOKEN_EVENT) &&
+		  BuildOwnerIndex(image, &(lazy->propertySems), owners,
+						  IL_META_TOKEN_METHOD_SEMANTICS,
+						  IL_META_TOKEN_PROPERTY));
+	ILFree(owners);
+	if(!ok)
+	{
+		return 0;
+	}
+
+	/* Find the override declarations for each TypeDef */
+	owners = ScanOwners(image, IL_META_TOKEN_METHOD_IMPL,
+						IL_META_TOKEN_METHOD_IMPL, Index_Owner,
+						IL_OFFSET_METHODIMPL_TYPE, 0);
+	if(!owners)
+	{
+		return 0;
+	}
+	ok = BuildOwnerIndex(image, &(lazy->overrides), owners,
+						 IL_META_TOKEN_METHOD_IMPL, IL_META_TOKEN_TYPE_DEF);
+	ILFree(owners);
+	if(!ok)
+	{
+		return 0;
+	}
+
+	/* Done */
+	lazy->built = 1;
+	return 1;
+}
+
+/*
+ * Load the rows in "rowType" that belong to a particular owner.
+ */
+static void LoadOwnedRows(ILImage *image, ILLazyOwnerIndex *index,
+						  ILUInt32 owner, unsigned long rowType,
+						  TokenLoadFunc func, void *userData)
+{
+	ILUInt32 posn;
+	for(posn = index->start[owner]; posn < index->start[owner + 1]; ++posn)
+	{
+		LoadTokenRange(image, rowType, rowType | index->rows[posn], 1,
+					   func, userData);
+	}
+}
+
+/*
+ * Load the method semantics for the events or properties of a class.
+ */
+static void LoadOwnedSemantics(ILImage *image, ILLazyOwnerIndex *index,
+							   ILLazyOwnerIndex *semIndex, ILUInt32 owner)
+{
+	ILUInt32 posn;
+	for(posn = index->start[owner]; posn < index->start[owner + 1]; ++posn)
+	{
+		LoadOwnedRows(image, semIndex, index->rows[posn],
+					  IL_META_TOKEN_METHOD_SEMANTICS,
+					  Load_MethodAssociation, 0);
+	}
+}
+
+/*
+ * A class whose members are being loaded.  These are chained on the
+ * stack of the thread that owns the context's lazy loading lock, so
+ * that requests for the same class while it is being loaded return
+ * straight away instead of loading the members again.
+ */
+struct _tagILLazyLoading
+{
+	ILClass		   *info;
+	ILLazyLoading  *next;
+
+};
+
+/*
+ * Load the members of a class.  Called with the lazy loading lock held.
+ */
+static void LoadMembers(ILClass *info)
+{
+	ILImage *image = info->programItem.image;
+	ILLazyMembers *lazy = image->lazyMembers;
+	ILToken token = info->programItem.token;
+	ILUInt32 owner = (token & ~IL_META_TOKEN_MASK);
+	ILUInt32 values[IL_IMAGE_TOKEN_COLUMNS];
+	ILUInt32 valuesNext[IL_IMAGE_TOKEN_COLUMNS];
+	ILUInt32 *valuesNextPtr;
+
+	/* Fetch the TypeDef details for this class and the next one */
+	if(!lazy || !_ILImageRawTokenData(image, token, values))
+	{
+		return;
+	}
+	if(owner < image->tokenCount[IL_META_TOKEN_TYPE_DEF >> 24])
+	{
+		if(!_ILImageRawTokenData(image, token + 1, valuesNext))
+		{
+			return;
+		}
+		valuesNextPtr = valuesNext;
+	}
+	else
+	{
+		valuesNextPtr = 0;
+	}
+
+	/* Load the fields and methods */
+	if(LoadFieldsAndMethods(image, info, values, valuesNextPtr, token) != 0)
+	{
+		return;
+	}
+
+	/* Load the events, properties, and override declarations, in the
+	   same order that "_ILImageBuildMetaStructures" would have */
+	if(!BuildLazyMembers(image))
+	{
+		return;
+	}
+	LoadOwnedRows(image, &(lazy->events), owner,
+				  IL_META_TOKEN_EVENT, Load_Event, info);
+	LoadOwnedRows(image, &(lazy->properties), owner,
+				  IL_META_TOKEN_PROPERTY, Load_Property, info);
+	LoadOwnedSemantics(image, &(lazy->events), &(lazy->eventSems), owner);
+	LoadOwnedSemantics(image, &(lazy->properties),
+					   &(lazy->propertySems), owner);
+	LoadOwnedRows(image, &(lazy->overrides), owner,
+				  IL_META_TOKEN_METHOD_IMPL, Load_Override, 0);
+}
+
+void _ILClassLoadMembers(ILClass *info)
+{
+	ILContext *context = info->programItem.image->context;
+	ILLazyLoading loading;
+	ILLazyLoading *current;
+
+	_ILContextLazyLock(context);
+
+	/* Another thread may have loaded the members while we were waiting
+	   for the lock.  If this thread is already loading them, then the
+	   request came from the loading code, which must see the members
+	   that have been loaded so far */
+	if(!_ILClassMembersPending(info))
+	{
+		_ILContextLazyUnlock(context);
+		return;
+	}
+	for(current = context->lazyLoading; current != 0; current = current->next)
+	{
+		if(current->info == info)
+		{
+			_ILContextLazyUnlock(context);
+			return;
+		}
+	}
+
+	/* Load the members, and then publish them by clearing the flag.
+	   The flag is cleared even if there was a metadata error, so that
+	   we don't try to load the same broken members again */
+	loading.info = info;
+	loading.next = context->lazyLoading;
+	context->lazyLoading = &loading;
+	LoadMembers(info);
+	context->lazyLoading = loading.next;
+	ILInterlockedAndU4_Release(&(info->attributes),
+							   ~IL_META_TYPEDEF_MEMBERS_PENDING);
+
+	_ILContextLazyUnlock(context);
+}
+
+/*
+ * Load an event or property on-demand by loading its type.
+ */
+static int LoadOwnerOnDemand(ILImage *image, ILToken token, int isEvent)
+{
+	ILLazyMembers *lazy = image->lazyMembers;
+	ILClass *classInfo;
+
+	/* Events and properties are only loaded on demand if lazy */
+	if(!lazy || !BuildLazyMembers(image))
+	{
+		return IL_LOADERR_UNRESOLVED;
+	}
+
+	/* Load the type */
+	if(isEvent)
+	{
+		classInfo = ILClass_FromToken
+			(image, lazy->eventOwners[token & ~IL_META_TOKEN_MASK]);
+	}
+	else
+	{
+		classInfo = ILClass_FromToken
+			(image, lazy->propertyOwners[token & ~IL_META_TOKEN_MASK]);
+	}
+	if(!classInfo)
+	{
+		META_VAL_ERROR("could not find type for event or property");
+		return IL_LOADERR_BAD_META;
+	}
+	if(_ILClassMembersPending(classInfo))
+	{
+		_ILClassLoadMembers(classInfo);
+	}
+
+	/* Done */
+	return 0;
+}
+
+/*
+ * Load an event on-demand by loading its type.
+ */
+static int Load_EventOnDemand(ILImage *image, ILUInt32 *values,
+						      ILUInt32 *valuesNext, ILToken token,
+						      void *userData)
+{
+	return LoadOwnerOnDemand(image, token, 1);
+}
+
+/*
+ * Load a property on-demand by loading its type.
+ */
+static int Load_PropertyOnDemand(ILImage *image, ILUInt32 *values,
+						         ILUInt32 *valuesNext, ILToken token,
+						         void *userData)
+{
+	return LoadOwnerOnDemand(image, token, 0);
+}
+
+/*
+ * Load a member reference on-demand.  Member references are
+ * only deferred when the image is loaded lazily.
+ */
+static int Load_MemberRefOnDemand(ILImage *image, ILUInt32 *values,
+						          ILUInt32 *valuesNext, ILToken token,
+						          void *userData)
+{
+	if(!(image->lazyMembers))
+	{
+		return IL_LOADERR_UNRESOLVED;
+	}
+	return Load_MemberRef(image, values, valuesNext, token,
+						  (void *)(ILNativeInt)(image->loadFlags));
+}
+
+/*
+ * Free the rows in an owner index.
+ */
+static void FreeOwnerIndex(ILLazyOwnerIndex *index)
+{
+	if(index->start)
+	{
+		ILFree(index->start);
+	}
+	if(index->rows)
+	{
+		ILFree(index->rows);
+	}
+}
+
+void _ILImageFreeLazyMembers(ILImage *image)
+{
+	ILLazyMembers *lazy = image->lazyMembers;
+	if(lazy)
+	{
+		if(lazy->eventOwners)
+		{
+			ILFree(lazy->eventOwners);
+		}
+		if(lazy->propertyOwners)
+		{
+			ILFree(lazy->propertyOwners);
+		}
+		FreeOwnerIndex(&(lazy->events));
+		FreeOwnerIndex(&(lazy->properties));
+		FreeOwnerIndex(&(lazy->eventSems));
+		FreeOwnerIndex(&(lazy->propertySems));
+		FreeOwnerIndex(&(lazy->overrides));
+		ILFree(lazy);
+		image->lazyMembers = 0;
+	}
+}
+
 int _ILImageBuildMetaStructures(ILImage *image, const char *filename,
 								int loadFlags)
 {
@@ -3556,6 +4085,23 @@ int _ILImageBuildMetaStructures(ILImage *image, const char *filename,
 		EXIT_IF_ERROR(ResolveTypeRefsPhase2(image, loadFlags));
 	}
 
+	/* If loading lazily, then the members of each class are loaded
+	   when the class is first used, and member references when they
+	   are first used.  Types, interfaces, and generic parameters are
+	   still loaded up front, because name lookups and searches for
+	   generic parameters by owner rely upon them */
+	if((loadFlags & IL_LOADFLAG_LAZY_METADATA) != 0)
+	{
+		/* The lazy loading lock records its owner thread */
+		ILThreadInit();
+		image->lazyMembers =
+			(ILLazyMembers *)ILCalloc(1, sizeof(ILLazyMembers));
+		if(!(image->lazyMembers))
+		{
+			return IL_LOADERR_MEMORY;
+		}
+	}
+
 	/* Load the TypeDef table - phase 2 (fields and methods) */
 	EXIT_IF_ERROR(LoadTokens(image, IL_META_TOKEN_TYPE_DEF,
 							 Load_TypeDefPhase2, 0));
@@ -3564,21 +4110,25 @@ int _ILImageBuildMetaStructures(ILImage *image, const char *filename,
 	EXIT_IF_ERROR(LoadTokens(image, IL_META_TOKEN_INTERFACE_IMPL,
 							 Load_InterfaceImpl, 0));
 
-	/* Load events and properties for all of the types */
-	EXIT_IF_ERROR(LoadTokens(image, IL_META_TOKEN_EVENT_MAP,
-							 Load_EventAssociation, 0));
-	EXIT_IF_ERROR(LoadTokens(image, IL_META_TOKEN_PROPERTY_MAP,
-							 Load_PropertyAssociation, 0));
-	EXIT_IF_ERROR(LoadTokens(image, IL_META_TOKEN_METHOD_SEMANTICS,
-							 Load_MethodAssociation, 0));
+	if(!(image->lazyMembers))
+	{
+		/* Load events and properties for all of the types */
+		EXIT_IF_ERROR(LoadTokens(image, IL_META_TOKEN_EVENT_MAP,
+								 Load_EventAssociation, 0));
+		EXIT_IF_ERROR(LoadTokens(image, IL_META_TOKEN_PROPERTY_MAP,
+								 Load_PropertyAssociation, 0));
+		EXIT_IF_ERROR(LoadTokens(image, IL_META_TOKEN_METHOD_SEMANTICS,
+								 Load_MethodAssociation, 0));
 
-	/* Load member references to other images */
-	EXIT_IF_ERROR(LoadTokens(image, IL_META_TOKEN_MEMBER_REF,
-							 Load_MemberRef, (void *)(ILNativeInt)loadFlags));
+		/* Load member references to other images */
+		EXIT_IF_ERROR(LoadTokens(image, IL_META_TOKEN_MEMBER_REF,
+								 Load_MemberRef,
+								 (void *)(ILNativeInt)loadFlags));
 
-	/* Load the override declarations */
-	EXIT_IF_ERROR(LoadTokens(image, IL_META_TOKEN_METHOD_IMPL,
-							 Load_Override, 0));
+		/* Load the override declarations */
+		EXIT_IF_ERROR(LoadTokens(image, IL_META_TOKEN_METHOD_IMPL,
+								 Load_Override, 0));
+	}
 
 	/* Load generic type parameters */
 	EXIT_IF_ERROR(LoadTokens(image, IL_META_TOKEN_GENERIC_PAR,
@@ -3605,7 +4155,7 @@ static TokenLoadFunc const TokenLoadFunctions[] = {
 	0,
 	0,							/* 08 */
 	0,
-	0,
+	Load_MemberRefOnDemand,
 	Load_Constant,
 	0,
 	Load_FieldMarshal,
@@ -3615,10 +4165,10 @@ static TokenLoadFunc const TokenLoadFunctions[] = {
 	Load_StandAloneSig,
 	0,
 	0,
+	Load_EventOnDemand,
 	0,
 	0,
-	0,
-	0,
+	Load_PropertyOnDemand,
 	0,							/* 18 */
 	0,
 	Load_ModuleRef,
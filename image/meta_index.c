@@ -19,6 +19,7 @@
  */
 
 #include "program.h"
+#include "../support/interlocked.h"
 #include <stdio.h>
 
 #ifdef	__cplusplus
@@ -1251,7 +1252,57 @@ unsigned long ILImageNumTokens(ILImage *image, ILToken tokenType)
 	}
 }
 
-void *ILImageTokenInfo(ILImage *image, ILToken token)
+/*
+ * Tables that are counted by "ILImageMetaRowCounts".
+ */
+static ILToken const MetaRowTables[] = {
+	IL_META_TOKEN_TYPE_REF,
+	IL_META_TOKEN_TYPE_DEF,
+	IL_META_TOKEN_FIELD_DEF,
+	IL_META_TOKEN_METHOD_DEF,
+	IL_META_TOKEN_PARAM_DEF,
+	IL_META_TOKEN_INTERFACE_IMPL,
+	IL_META_TOKEN_MEMBER_REF,
+	IL_META_TOKEN_EVENT,
+	IL_META_TOKEN_PROPERTY,
+	IL_META_TOKEN_METHOD_IMPL,
+	IL_META_TOKEN_TYPE_SPEC,
+	IL_META_TOKEN_GENERIC_PAR,
+};
+#define	IL_NUM_META_ROW_TABLES	\
+			(sizeof(MetaRowTables) / sizeof(MetaRowTables[0]))
+
+void ILImageMetaRowCounts(ILImage *image, unsigned long *loaded,
+						  unsigned long *present)
+{
+	unsigned long table;
+	ILToken tokenType;
+	ILUInt32 tokenId;
+	void **data;
+	*loaded = 0;
+	*present = 0;
+	for(table = 0; table < IL_NUM_META_ROW_TABLES; ++table)
+	{
+		tokenType = (MetaRowTables[table] >> 24);
+		*present += image->tokenCount[tokenType];
+		data = image->tokenData[tokenType];
+		if(data)
+		{
+			for(tokenId = 0; tokenId < image->tokenCount[tokenType]; ++tokenId)
+			{
+				if(data[tokenId])
+				{
+					++(*loaded);
+				}
+			}
+		}
+	}
+}
+
+/*
+ * Get the information block for a token, loading it on demand.
+ */
+static void *TokenInfo(ILImage *image, ILToken token)
 {
 	void **data;
 	void *item;
@@ -1280,6 +1331,85 @@ void *ILImageTokenInfo(ILImage *image, ILToken token)
 	return 0;
 }
 
+/*
+ * Get the information block for a token of a lazy image without
+ * taking the lazy loading lock.  Returns NULL if the item has not
+ * been published as fully loaded yet.  Items are stored in "tokenData"
+ * before they are complete, so they are published to other threads
+ * in a separate table, which is read like the other lock-free tables
+ * in the engine: the item is only used through the loaded pointer.
+ */
+static void *LoadedTokenInfo(ILImage *image, ILToken token)
+{
+	ILToken tokenId = (token & (unsigned long)0x00FFFFFF);
+	ILToken tokenType = (token >> 24);
+	void **loaded;
+	if(token < (unsigned long)0x40000000 &&
+	   tokenId >= 1 && tokenId <= image->tokenCount[tokenType])
+	{
+		loaded = (void **)ILInterlockedLoadP
+			((void **)&(image->tokenLoaded[tokenType]));
+		if(loaded)
+		{
+			return ILInterlockedLoadP(&(loaded[tokenId - 1]));
+		}
+	}
+	return 0;
+}
+
+/*
+ * Publish a fully loaded item of a lazy image.  Must be called with
+ * the lazy loading lock held, and only when no loading is in progress.
+ */
+static void PublishTokenInfo(ILImage *image, ILToken token, void *item)
+{
+	ILToken tokenId = (token & (unsigned long)0x00FFFFFF);
+	ILToken tokenType = (token >> 24);
+	void **loaded = image->tokenLoaded[tokenType];
+	if(!loaded)
+	{
+		loaded = (void **)ILCalloc(image->tokenCount[tokenType],
+								   sizeof(void *));
+		if(!loaded)
+		{
+			/* Not fatal: the token will be looked up with the lock */
+			return;
+		}
+		ILInterlockedStoreP_Release
+			((void **)&(image->tokenLoaded[tokenType]), loaded);
+	}
+	ILInterlockedStoreP_Release(&(loaded[tokenId - 1]), item);
+}
+
+void *ILImageTokenInfo(ILImage *image, ILToken token)
+{
+	ILContext *context;
+	void *item;
+	if(image->lazyMembers)
+	{
+		/* Items that were published as fully loaded don't need the lock */
+		if((item = LoadedTokenInfo(image, token)) != 0)
+		{
+			return item;
+		}
+
+		/* The tokens of a lazy image can be loaded by any thread that
+		   uses them, so load them with the lazy loading lock held.  If
+		   this thread isn't already loading something, then the item
+		   is complete once it has been found, and can be published */
+		context = image->context;
+		_ILContextLazyLock(context);
+		item = TokenInfo(image, token);
+		if(item && context->lazyDepth == 1)
+		{
+			PublishTokenInfo(image, token, item);
+		}
+		_ILContextLazyUnlock(context);
+		return item;
+	}
+	return TokenInfo(image, token);
+}
+
 int _ILImageTokenAlreadyLoaded(ILImage *image, ILToken token)
 {
 	void **data;
@@ -1385,12 +1515,17 @@ void *ILImageSearchForToken(ILImage *image, ILToken tokenType,
 void _ILImageFreeTokens(ILImage *image)
 {
 	int tokenType;
+	_ILImageFreeLazyMembers(image);
 	for(tokenType = 0; tokenType < 64; ++tokenType)
 	{
 		if(image->tokenData[tokenType])
 		{
 			ILFree(image->tokenData[tokenType]);
 		}
+		if(image->tokenLoaded[tokenType])
+		{
+			ILFree(image->tokenLoaded[tokenType]);
+		}
 	}
 }
 
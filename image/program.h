@@ -343,7 +343,25 @@ struct _tagILClass
 #define	IL_META_TYPEDEF_CCTOR_RUNNING	0x08000000	/* .cctor is currenty executed. */
 #define	IL_META_TYPEDEF_CCTOR_ONCE		0x04000000	/* .cctor already done */
 #define	IL_META_TYPEDEF_CCTOR_MASK		0x0C000000	/* .cctor flags */
-#define	IL_META_TYPEDEF_SYSTEM_MASK		0xFC000000	/* System flags */
+#define	IL_META_TYPEDEF_MEMBERS_PENDING	0x02000000	/* Members not loaded yet */
+#define	IL_META_TYPEDEF_SYSTEM_MASK		0xFE000000	/* System flags */
+
+/*
+ * Load the members of a class whose loading was deferred because
+ * its image was loaded with "IL_LOADFLAG_LAZY_METADATA".  This is
+ * serialized with all other lazy loading in the same context.
+ */
+void _ILClassLoadMembers(ILClass *info);
+
+/*
+ * Determine if the members of a class are still pending.  The flag is
+ * cleared with release semantics after the members have been loaded,
+ * so a clear flag means that the member list is complete.  Callers
+ * must include "../support/interlocked.h".
+ */
+#define	_ILClassMembersPending(info)	\
+			((ILInterlockedLoadU4_Acquire(&((info)->attributes)) & \
+			  IL_META_TYPEDEF_MEMBERS_PENDING) != 0)
 
 /*
  * Information about an "implements" clause for a class.
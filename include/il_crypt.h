@@ -59,6 +59,14 @@ void ILSHAData(ILSHAContext *sha, const void *buffer, unsigned long len);
  */
 void ILSHAFinalize(ILSHAContext *sha, unsigned char hash[IL_SHA_HASH_SIZE]);
 
+/*
+ * Select the kernels that are used by the SHA1 functions above.  "name"
+ * may be "scalar", "ssse3" or "shani", or NULL for the best kernels supported
+ * by the CPU.  Unsupported names are ignored.  Returns the name of
+ * the kernels in use.
+ */
+const char *ILSHAUseKernels(const char *name);
+
 /*
  * The size of MD5 hash values.
  */
@@ -124,6 +132,25 @@ void ILSHA256Data(ILSHA256Context *sha, const void *buffer, unsigned long len);
 void ILSHA256Finalize(ILSHA256Context *sha,
 					  unsigned char hash[IL_SHA256_HASH_SIZE]);
 
+/*
+ * Compute the SHA-256 hashes of "numBuffers" independent buffers,
+ * writing IL_SHA256_HASH_SIZE bytes to "hashes" for each one.  This
+ * is faster than hashing the buffers one at a time if the kernels
+ * can hash several buffers in parallel.
+ */
+void ILSHA256HashBuffers(const void * const *buffers,
+						 const unsigned long *lens, int numBuffers,
+						 unsigned char *hashes);
+
+/*
+ * Select the kernels that are used by the SHA-256 functions above.
+ * "name" may be "scalar", "ssse3", "avx2" or "shani", or NULL for
+ * the best kernels supported by the CPU.  The "avx2" kernels are the
+ * "ssse3" kernels, with a faster "ILSHA256HashBuffers".  Unsupported
+ * names are ignored.  Returns the name of the kernels in use.
+ */
+const char *ILSHA256UseKernels(const char *name);
+
 /*
  * The size of SHA-512 hash values.
  */
@@ -283,12 +310,16 @@ int ILDESIsWeakKey(unsigned char *key);
 int ILDESIsSemiWeakKey(unsigned char *key);
 
 /*
- * Structure of an AES cipher context object.
+ * Structure of an AES cipher context object.  The round keys are
+ * also stored as bytes, in encryption and decryption order, for
+ * the AES-NI kernels.
  */
 typedef struct
 {
-	int			numRounds;
-	ILInt32		keySchedule[15 * 4];
+	int				numRounds;
+	ILInt32			keySchedule[15 * 4];
+	unsigned char	encryptKeys[15 * 16];
+	unsigned char	decryptKeys[15 * 16];
 
 } ILAESContext;
 
@@ -311,11 +342,33 @@ void ILAESEncrypt(ILAESContext *aes, unsigned char *input,
 void ILAESDecrypt(ILAESContext *aes, unsigned char *input,
 				  unsigned char *output);
 
+/*
+ * Encrypt "numBlocks" consecutive 128-bit blocks using AES in ECB mode.
+ * The input and output buffers can be the same.
+ */
+void ILAESEncryptBlocks(ILAESContext *aes, const unsigned char *input,
+						unsigned char *output, unsigned long numBlocks);
+
+/*
+ * Decrypt "numBlocks" consecutive 128-bit blocks using AES in ECB mode.
+ * The input and output buffers can be the same.
+ */
+void ILAESDecryptBlocks(ILAESContext *aes, const unsigned char *input,
+						unsigned char *output, unsigned long numBlocks);
+
 /*
  * Finalize an AES encryption context, clearing all sensitive values.
  */
 void ILAESFinalize(ILAESContext *aes);
 
+/*
+ * Select the kernels that are used by the AES functions above.  "name"
+ * may be "scalar" or "aesni", or NULL for the best kernels supported
+ * by the CPU.  Unsupported names are ignored.  Returns the name of
+ * the kernels in use.
+ */
+const char *ILAESUseKernels(const char *name);
+
 /*
  * Structure of an RC2 encryption context.
  */
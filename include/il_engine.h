@@ -366,6 +366,11 @@ int ILExecProcessEntryType(ILMethod *method);
 #define	IL_EXEC_PARAM_GC_SIZE		1	/* Size of the GC heap */
 #define	IL_EXEC_PARAM_MC_SIZE		2	/* Size of the method cache */
 #define	IL_EXEC_PARAM_MALLOC_MAX	3	/* Maximum malloc usage */
+#define	IL_EXEC_PARAM_IC_HITS		4	/* Interface call site cache hits */
+#define	IL_EXEC_PARAM_IC_MISSES		5	/* Interface call site cache misses */
+#define	IL_EXEC_PARAM_IC_MEGAMORPHIC 6	/* Megamorphic interface call sites */
+#define	IL_EXEC_PARAM_META_LOADED	7	/* Metadata rows loaded so far */
+#define	IL_EXEC_PARAM_META_PRESENT	8	/* Metadata rows in all images */
 
 /*
  * Get parameter information about a process.  Returns -1 if
@@ -373,6 +378,27 @@ int ILExecProcessEntryType(ILMethod *method);
  */
 long ILExecProcessGetParam(ILExecProcess *process, int type);
 
+/*
+ * Start sampling the managed call stacks of a process "rate" times
+ * per second of CPU time.  Samples accumulate until the process is
+ * destroyed, so sampling can be stopped and started again at any time.
+ * Returns zero if sampling is not supported on this platform or another
+ * process is already being sampled.
+ */
+int ILExecProcessStartSampling(ILExecProcess *process, int rate);
+
+/*
+ * Stop sampling the managed call stacks of a process.
+ */
+void ILExecProcessStopSampling(ILExecProcess *process);
+
+/*
+ * Write the call stack samples for a process to a stream in the
+ * "collapsed stack" format that is read by flame graph tools.
+ * Returns the number of samples that were written.
+ */
+long ILExecProcessDumpSamples(ILExecProcess *process, FILE *stream);
+
 /*
  * Set the command-line arguments.  Returns the parameter
  * that should be passed to "Main".
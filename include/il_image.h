@@ -56,6 +56,7 @@ extern	"C" {
 #define	IL_LOADFLAG_NO_MAP			32	/* Don't use mmap to load image */
 #define	IL_LOADFLAG_IN_PLACE		64	/* Memory load: execute in place */
 #define	IL_LOADFLAG_IGNORE_ERRORS	128	/* Ignore load errors (use wiseley) */
+#define	IL_LOADFLAG_LAZY_METADATA	256	/* Load class members on demand */
 
 /*
  * Image types.
@@ -536,6 +537,15 @@ const char *ILImageGetAssemblyName(ILImage *image);
  */
 unsigned long ILImageNumTokens(ILImage *image, ILToken tokenType);
 
+/*
+ * Get the number of rows in the tables that describe types and their
+ * members, and the number of those rows that have been loaded so far.
+ * When an image is loaded with "IL_LOADFLAG_LAZY_METADATA", rows are
+ * loaded on demand and "loaded" is normally much less than "present".
+ */
+void ILImageMetaRowCounts(ILImage *image, unsigned long *loaded,
+						  unsigned long *present);
+
 /*
  * Get the information block associated with a token.
  * Returns the block, or NULL if the token is invalid.
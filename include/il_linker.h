@@ -37,6 +37,7 @@ typedef struct _tagILLinker ILLinker;
  * Extra linker flags.
  */
 #define	IL_LINKFLAG_MINIMIZE_PARAMS		(1<<0)
+#define	IL_LINKFLAG_LIBRARY_INDEX		(1<<1)
 
 /*
  * Create a linker context.  The supplied parameters
@@ -93,6 +94,18 @@ char *ILLinkerResolveLibrary(ILLinker *linker, const char *name);
  */
 int ILLinkerAddLibrary(ILLinker *linker, const char *name);
 
+/*
+ * Add a list of named assemblies to a linker context as libraries.
+ * The libraries and the assemblies that they reference are loaded
+ * and scanned in parallel, and then added in the same order as
+ * "ILLinkerAddLibrary" would add them.  If "IL_LINKFLAG_LIBRARY_INDEX"
+ * is set, then the class and symbol index of each library is kept
+ * in a file next to it, so that later links can skip the scan.
+ * Returns zero on error.
+ */
+int ILLinkerAddLibraries(ILLinker *linker, const char * const *names,
+						 int numNames);
+
 /*
  * Add an image to a linker context as one of the primary objects.
  * This must be done after all libraries have been added.
@@ -569,6 +569,23 @@ extern size_t regerror _RE_ARGS ((int __errcode, const regex_t *__preg,
 
 extern void regfree _RE_ARGS ((regex_t *__preg));
 
+/* Lazy DFA matcher for the regular subset of POSIX extended regular
+   expressions (regex_dfa.c).  "ILRegexDFACreate" returns NULL if the
+   pattern uses features that it does not support, such as
+   back-references, in which case "regexec" must be used instead.  */
+typedef struct _tagILRegexDFA ILRegexDFA;
+
+extern ILRegexDFA *ILRegexDFACreate (const char *__pattern, int __cflags);
+
+extern void ILRegexDFADestroy (ILRegexDFA *__dfa);
+
+/* Search "__str" for the leftmost-longest match.  Returns 1 if there
+   is a match, 0 if there is no match, or -1 if the input cannot be
+   handled and "regexec" must be used instead.  The match positions are
+   returned in "__start" and "__end" if "__start" is not NULL.  */
+extern int ILRegexDFAExec (ILRegexDFA *__dfa, const unsigned short *__str,
+			   long __len, int __eflags, long *__start, long *__end);
+
 
 #ifdef __cplusplus
 }
@@ -291,6 +291,55 @@ ILInt32 ILSysIOSocketSelect(ILSysIOHandle **readfds, ILInt32 numRead,
 						    ILSysIOHandle **exceptfds, ILInt32 numExcept,
 						    ILInt64 timeout);
 
+/*
+ * Persistent set of sockets that are polled for readiness.  Sockets
+ * stay registered between waits, so the cost of a wait depends on the
+ * number of sockets that are ready rather than the number registered.
+ */
+typedef struct _tagILSysIOPollSet ILSysIOPollSet;
+
+/*
+ * Events that can be polled for.  IL_SYSIO_POLL_ONESHOT disarms a
+ * registration once it has been reported, until it is added again.
+ */
+#define	IL_SYSIO_POLL_READ		0x0001
+#define	IL_SYSIO_POLL_WRITE		0x0002
+#define	IL_SYSIO_POLL_ERROR		0x0004
+#define	IL_SYSIO_POLL_ONESHOT	0x0100
+
+/*
+ * Create a poll set.  Returns NULL if out of resources.
+ */
+ILSysIOPollSet *ILSysIOPollSetCreate(void);
+
+/*
+ * Destroy a poll set.  No thread may be waiting on it.
+ */
+void ILSysIOPollSetDestroy(ILSysIOPollSet *set);
+
+/*
+ * Register a socket with a poll set, or change the events of a
+ * socket that is already registered.  Returns zero on error.
+ */
+int ILSysIOPollSetAdd(ILSysIOPollSet *set, ILSysIOHandle sockfd,
+					  ILInt32 events);
+
+/*
+ * Remove a socket from a poll set.  Returns zero if the
+ * socket was not registered.
+ */
+int ILSysIOPollSetRemove(ILSysIOPollSet *set, ILSysIOHandle sockfd);
+
+/*
+ * Wait for up to "maxEvents" sockets in a poll set to become ready.
+ * The timeout is in microseconds, or -1 for an infinite timeout.
+ * Returns -1 on error, 0 on timeout or signal, or the number of
+ * entries written to "handles" and "events".
+ */
+ILInt32 ILSysIOPollSetWait(ILSysIOPollSet *set, ILSysIOHandle *handles,
+						   ILInt32 *events, ILInt32 maxEvents,
+						   ILInt64 timeout);
+
 /*
  * Set or reset the blocking flag on a socket.  Returns zero on error.
  */
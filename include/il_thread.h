@@ -630,6 +630,33 @@ int ILMonitorPulseAll(void **monitorLocation);
  */
 void ILMonitorReclaim(void **monitorLocation);
 
+/*
+ * Statistics about the monitor pool.  The counters of a thread are
+ * added to the totals when the thread exits, so the counters of
+ * running threads other than the caller are not included.
+ */
+typedef struct
+{
+	ILUInt64	cacheHits;		/* Monitors inflated from a thread's cache */
+	ILUInt64	cacheMisses;	/* Thread cache refills from the pool */
+	ILUInt64	contended;		/* Enters that had to join another thread */
+	ILUInt64	drains;			/* Thread cache drains to the pool */
+	ILUInt32	numUsed;		/* Monitors allocated by the pool */
+	ILUInt32	numFree;		/* Monitors on the pool's freelist */
+	ILUInt32	numReclaimed;	/* Monitors reclaimed from dead objects */
+
+} ILMonitorStats;
+
+/*
+ * Get the current monitor pool statistics.
+ */
+void ILMonitorGetStats(ILMonitorStats *stats);
+
+/*
+ * Print the monitor pool statistics to stderr.
+ */
+void ILMonitorPrintStats(void);
+
 #ifdef	__cplusplus 
 };
 #endif
@@ -236,6 +236,52 @@ int ILUTF16WriteChar(unsigned short *buf, unsigned long ch);
  */
 int ILUTF16WriteCharAsBytes(void *buf, unsigned long ch);
 
+/*
+ * Search for a character in a 16-bit string.  Returns the index
+ * of the first or last occurrence, or -1 if not found.
+ */
+long ILUTF16IndexOf(const unsigned short *str, long len, unsigned short ch);
+long ILUTF16LastIndexOf(const unsigned short *str, long len,
+						unsigned short ch);
+
+/*
+ * Search for any of the characters in "anyOf" in a 16-bit string.
+ * Returns the index of the first or last occurrence, or -1 if
+ * not found.
+ */
+long ILUTF16IndexOfAny(const unsigned short *str, long len,
+					   const unsigned short *anyOf, long anyLen);
+long ILUTF16LastIndexOfAny(const unsigned short *str, long len,
+						   const unsigned short *anyOf, long anyLen);
+
+/*
+ * Get the index of the first character that differs between two
+ * 16-bit strings of the same length, or -1 if they are equal.
+ */
+long ILUTF16Mismatch(const unsigned short *str1,
+					 const unsigned short *str2, long len);
+
+/*
+ * Compare two 16-bit strings by character value.  Returns -1, 0, or 1.
+ */
+int ILUTF16CompareOrdinal(const unsigned short *str1, long len1,
+						  const unsigned short *str2, long len2);
+
+/*
+ * Copy a 16-bit string, replacing all occurrences of "oldCh"
+ * with "newCh".  "dest" and "src" may be the same.
+ */
+void ILUTF16Replace(unsigned short *dest, const unsigned short *src,
+					long len, unsigned short oldCh, unsigned short newCh);
+
+/*
+ * Select the kernels that are used by the search and compare functions
+ * above.  "name" may be "scalar", "sse2" or "avx2", or NULL for the best
+ * kernels supported by the CPU.  Unsupported names are ignored.
+ * Returns the name of the kernels in use.
+ */
+const char *ILUTF16UseKernels(const char *name);
+
 /*
  * Get the number of bytes that are needed to encode an array
  * of 16-bit Unicode characters in the "ANSI" encoding.
@@ -412,6 +458,58 @@ int ILSpawnProcessWithPipe(char *argv[], void **stream);
  */
 int ILSpawnProcessWaitForExit(int pid, char *argv[]);
 
+/*
+ * Run "func(arg)" in a child process, capturing its stdout and
+ * stderr in temporary streams that are returned in "*output" and
+ * "*errors".  The child exits with the value returned by "func".
+ * Returns zero if this is not supported, -1 on error, or the pid.
+ */
+int ILSpawnFunction(int (*func)(void *arg), void *arg,
+					void **output, void **errors);
+
+/*
+ * Wait for any child process that was spawned by "ILSpawnFunction"
+ * to exit.  Returns the pid, or -1 if there are no children to wait
+ * for.  The exit status, or -1 on error, is returned in "*status".
+ */
+int ILSpawnWaitForAny(int *status);
+
+/*
+ * Opaque definition of a set of jobs that run in child processes.
+ */
+typedef struct _tagILSpawnJobs ILSpawnJobs;
+
+/*
+ * Create a set of up to "numJobs" jobs.  At most "maxRunning" of them
+ * run at once, and the captured output of at most "maxHeld" jobs is
+ * kept while it waits for earlier jobs to finish.  The output of the
+ * jobs is copied to the "FILE *" streams "output" and "errors" in the
+ * order that the jobs were started.  Returns NULL if out of memory.
+ */
+ILSpawnJobs *ILSpawnJobsCreate(int numJobs, int maxRunning, int maxHeld,
+							   void *output, void *errors);
+
+/*
+ * Start the next job by running "func(arg)" with "ILSpawnFunction",
+ * after waiting for room in the job set.  Returns zero if this is not
+ * supported, in which case the caller should run the job itself and
+ * then call "ILSpawnJobsSkip".  Returns -1 on error, or the pid.
+ */
+int ILSpawnJobsStart(ILSpawnJobs *jobs, int (*func)(void *arg), void *arg);
+
+/*
+ * Record the next job as done without output, because the caller
+ * has dealt with it.
+ */
+void ILSpawnJobsSkip(ILSpawnJobs *jobs);
+
+/*
+ * Wait for all jobs to finish, copy their remaining output and then
+ * destroy the job set.  Returns the first non-zero exit status of
+ * the jobs, or zero if they all succeeded.
+ */
+int ILSpawnJobsFinish(ILSpawnJobs *jobs);
+
 /*
  * Opaque definition of the hash table type.
  */
@@ -422,14 +520,19 @@ typedef struct _tagILHashTable ILHashTable;
  */
 typedef struct _tagILHashEntry ILHashEntry;
 
+/*
+ * Opaque definition of a block of hash entries.
+ */
+typedef struct _tagILHashBlock ILHashBlock;
+
 /*
  * Structure that is used to iterate over an entire hash table.
  */
 typedef struct
 {
 	ILHashTable	   *hashtab;
+	ILHashBlock	   *block;
 	int				index;
-	ILHashEntry	   *entry;
 
 } ILHashIter;
 
@@ -456,7 +559,9 @@ typedef void (*ILHashFreeFunc)(void *elem);
 
 /*
  * Create a hash table.  If "size" is zero, then use a
- * builtin default size.  All functions must be supplied,
+ * builtin default size.  The table grows automatically
+ * when the number of elements exceeds the number of
+ * buckets.  All functions must be supplied,
  * except "freeFunc", which can be NULL if the elements
  * do not need to be free'd.  Returns NULL if out of memory.
  */
@@ -479,7 +584,8 @@ int ILHashAdd(ILHashTable *hashtab, void *elem);
 
 /*
  * Find an element within a hash table by key.  Returns
- * the element, or NULL if not present.
+ * the element, or NULL if not present.  If more than one
+ * element matches the key, the one added first is returned.
  */
 void *ILHashFind(ILHashTable *hashtab, const void *key);
 
@@ -517,7 +623,11 @@ void ILHashRemoveSubset(ILHashTable *hashtab, ILHashMatchFunc matchFunc,
 
 /*
  * Initialize an iterator for scanning all elements
- * within a hash table.
+ * within a hash table.  Elements are returned in the
+ * order they were added, unless they reuse the entry
+ * of a removed element.  Elements that are added while
+ * the iteration is in progress are returned if no
+ * elements were removed before they were added.
  */
 void ILHashIterInit(ILHashIter *iter, ILHashTable *hashtab);
 
@@ -21,6 +21,8 @@
 #ifndef	_IL_XML_H
 #define	_IL_XML_H
 
+#include <stdio.h>
+
 #ifdef	__cplusplus
 extern	"C" {
 #endif
@@ -59,6 +61,21 @@ typedef enum
  */
 ILXMLReader *ILXMLCreate(ILXMLReadFunc readFunc, void *data, int maxText);
 
+/*
+ * Create an XML reader for an in-memory buffer.  The buffer
+ * must remain valid until the reader is destroyed.
+ */
+ILXMLReader *ILXMLCreateFromBuffer(const char *buffer, unsigned long len,
+								   int maxText);
+
+/*
+ * Create an XML reader for the rest of a stdio stream.  If the
+ * stream is a regular file, then it is mapped into memory.
+ * Otherwise it is read in blocks.  The stream must remain open
+ * until the reader is destroyed.
+ */
+ILXMLReader *ILXMLCreateFromStream(FILE *stream, int maxText);
+
 /*
  * Destroy an XML reader.
  */
@@ -112,6 +129,17 @@ const char *ILXMLGetParam(ILXMLReader *reader, const char *name);
  */
 const char *ILXMLGetText(ILXMLReader *reader);
 
+/*
+ * Get views of the current tag name without namespace qualifiers,
+ * the value of a tag parameter, or the current text item.  The
+ * views point into the input, are not NUL-terminated, and are
+ * valid until the next call to "ILXMLReadNext".  Returns NULL
+ * if the item or parameter is not present.
+ */
+const char *ILXMLTagNameView(ILXMLReader *reader, int *len);
+const char *ILXMLGetParamView(ILXMLReader *reader, const char *name, int *len);
+const char *ILXMLGetTextView(ILXMLReader *reader, int *len);
+
 /*
  * Get the contents of the current element.  The
  * stream should be positioned on a start tag.  If
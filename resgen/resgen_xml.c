@@ -28,21 +28,6 @@
 extern	"C" {
 #endif
 
-/*
- * XML reader function.
- */
-static int xmlRead(void *data, void *buffer, int len)
-{
-	if(!feof((FILE *)data))
-	{
-		return fread(buffer, 1, len, (FILE *)data);
-	}
-	else
-	{
-		return 0;
-	}
-}
-
 int ILResLoadXML(const char *filename, FILE *stream)
 {
 	ILXMLReader *reader;
@@ -54,7 +39,7 @@ int ILResLoadXML(const char *filename, FILE *stream)
 	int error;
 
 	/* Initialize the XML reader */
-	reader = ILXMLCreate(xmlRead, stream, 0);
+	reader = ILXMLCreateFromStream(stream, 0);
 	if(!reader)
 	{
 		ILResOutOfMemory();
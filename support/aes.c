@@ -22,11 +22,13 @@
  * This file implements the AES symmetric encryption algorithm for
  * 128-bit, 192-bit, and 256-bit keys, based on the description that
  * can be found on the NIST Web site at "http://www.nist.gov/aes/".
- * This implementation is designed for correctness, not speed.
+ * The portable implementation is designed for correctness, not speed.
+ * AES-NI kernels are used instead if the CPU supports them.
  */
 
 #include "il_crypt.h"
 #include "il_system.h"
+#include "crypt_cpu.h"
 
 #ifdef	__cplusplus
 extern	"C" {
@@ -218,7 +220,7 @@ static IL_INLINE ILInt32 unmix(ILInt32 col)
 void ILAESInit(ILAESContext *aes, unsigned char *key, int keyBits)
 {
 	const unsigned char *s = sbox;
-	int i, nk, total, bit;
+	int i, nk, total, bit, posn;
 	ILInt32 temp;
 
 	/* Determine the number of rounds from the length of the key */
@@ -275,12 +277,30 @@ void ILAESInit(ILAESContext *aes, unsigned char *key, int keyBits)
 		aes->keySchedule[i] = aes->keySchedule[i - nk] ^ temp;
 	}
 
+	/* Store the round keys as bytes for the AES-NI kernels.  The
+	   decryption keys are in reverse order, and the middle ones
+	   have InvMixColumns() applied, for the equivalent inverse cipher */
+	for(i = 0; i < total; ++i)
+	{
+		temp = aes->keySchedule[i];
+		IL_BWRITE_INT32(aes->encryptKeys + i * 4, temp);
+		posn = (aes->numRounds - i / 4) * 16 + (i % 4) * 4;
+		if(i >= 4 && i < total - 4)
+		{
+			temp = unmix(temp);
+		}
+		IL_BWRITE_INT32(aes->decryptKeys + posn, temp);
+	}
+
 	/* Clear temporary values */
 	temp = 0;
 }
 
-void ILAESEncrypt(ILAESContext *aes, unsigned char *input,
-				  unsigned char *output)
+/*
+ * Encrypt a single block using the portable code.
+ */
+static void ScalarEncryptBlock(ILAESContext *aes, const unsigned char *input,
+							   unsigned char *output)
 {
 	ILInt32 *ks = aes->keySchedule;
 	int nr = aes->numRounds;
@@ -369,8 +389,11 @@ void ILAESEncrypt(ILAESContext *aes, unsigned char *input,
 	ncol0 = ncol1 = ncol2 = ncol3 = 0;
 }
 
-void ILAESDecrypt(ILAESContext *aes, unsigned char *input,
-				  unsigned char *output)
+/*
+ * Decrypt a single block using the portable code.
+ */
+static void ScalarDecryptBlock(ILAESContext *aes, const unsigned char *input,
+							   unsigned char *output)
 {
 	ILInt32 *ks = aes->keySchedule;
 	int nr = aes->numRounds;
@@ -459,6 +482,224 @@ void ILAESDecrypt(ILAESContext *aes, unsigned char *input,
 	ncol0 = ncol1 = ncol2 = ncol3 = 0;
 }
 
+/*
+ * Table of kernel functions.
+ */
+typedef struct
+{
+	const char *name;
+	void (*encrypt)(ILAESContext *aes, const unsigned char *input,
+					unsigned char *output, unsigned long numBlocks);
+	void (*decrypt)(ILAESContext *aes, const unsigned char *input,
+					unsigned char *output, unsigned long numBlocks);
+
+} ILAESKernels;
+
+/*
+ * Scalar kernels.
+ */
+static void ScalarEncrypt(ILAESContext *aes, const unsigned char *input,
+						  unsigned char *output, unsigned long numBlocks)
+{
+	while(numBlocks > 0)
+	{
+		ScalarEncryptBlock(aes, input, output);
+		input += 16;
+		output += 16;
+		--numBlocks;
+	}
+}
+
+static void ScalarDecrypt(ILAESContext *aes, const unsigned char *input,
+						  unsigned char *output, unsigned long numBlocks)
+{
+	while(numBlocks > 0)
+	{
+		ScalarDecryptBlock(aes, input, output);
+		input += 16;
+		output += 16;
+		--numBlocks;
+	}
+}
+
+static const ILAESKernels scalarKernels = {
+	"scalar",
+	ScalarEncrypt,
+	ScalarDecrypt
+};
+
+#ifdef IL_CRYPT_X86
+
+/*
+ * AES-NI kernels.  Four blocks are processed at a time where possible,
+ * because the "aesenc" instruction can start a new block every cycle
+ * but takes several cycles to deliver its result.
+ */
+#define	AESNI_TARGET		__attribute__((target("sse2,aes")))
+
+/*
+ * Perform one round on four blocks at once.
+ */
+#define	AESNI_ROUND4(op,key)	\
+			do { \
+				b0 = op(b0, (key)); \
+				b1 = op(b1, (key)); \
+				b2 = op(b2, (key)); \
+				b3 = op(b3, (key)); \
+			} while (0)
+
+/*
+ * Process blocks with either the encryption or the decryption keys.
+ */
+#define	AESNI_PROCESS(keyBytes,round,lastRound)	\
+			do { \
+				__m128i keys[15]; \
+				__m128i b0, b1, b2, b3; \
+				int nr = aes->numRounds; \
+				int r; \
+				for(r = 0; r <= nr; ++r) \
+				{ \
+					keys[r] = _mm_loadu_si128 \
+						((const __m128i *)((keyBytes) + r * 16)); \
+				} \
+				while(numBlocks >= 4) \
+				{ \
+					b0 = _mm_xor_si128(_mm_loadu_si128 \
+						((const __m128i *)input), keys[0]); \
+					b1 = _mm_xor_si128(_mm_loadu_si128 \
+						((const __m128i *)(input + 16)), keys[0]); \
+					b2 = _mm_xor_si128(_mm_loadu_si128 \
+						((const __m128i *)(input + 32)), keys[0]); \
+					b3 = _mm_xor_si128(_mm_loadu_si128 \
+						((const __m128i *)(input + 48)), keys[0]); \
+					for(r = 1; r < nr; ++r) \
+					{ \
+						AESNI_ROUND4(round, keys[r]); \
+					} \
+					AESNI_ROUND4(lastRound, keys[nr]); \
+					_mm_storeu_si128((__m128i *)output, b0); \
+					_mm_storeu_si128((__m128i *)(output + 16), b1); \
+					_mm_storeu_si128((__m128i *)(output + 32), b2); \
+					_mm_storeu_si128((__m128i *)(output + 48), b3); \
+					input += 64; \
+					output += 64; \
+					numBlocks -= 4; \
+				} \
+				while(numBlocks > 0) \
+				{ \
+					b0 = _mm_xor_si128(_mm_loadu_si128 \
+						((const __m128i *)input), keys[0]); \
+					for(r = 1; r < nr; ++r) \
+					{ \
+						b0 = round(b0, keys[r]); \
+					} \
+					b0 = lastRound(b0, keys[nr]); \
+					_mm_storeu_si128((__m128i *)output, b0); \
+					input += 16; \
+					output += 16; \
+					--numBlocks; \
+				} \
+				b0 = b1 = b2 = b3 = _mm_setzero_si128(); \
+				for(r = 0; r <= nr; ++r) \
+				{ \
+					keys[r] = b0; \
+				} \
+			} while (0)
+
+AESNI_TARGET static void AESNIEncrypt(ILAESContext *aes,
+									  const unsigned char *input,
+									  unsigned char *output,
+									  unsigned long numBlocks)
+{
+	AESNI_PROCESS(aes->encryptKeys, _mm_aesenc_si128, _mm_aesenclast_si128);
+}
+
+AESNI_TARGET static void AESNIDecrypt(ILAESContext *aes,
+									  const unsigned char *input,
+									  unsigned char *output,
+									  unsigned long numBlocks)
+{
+	AESNI_PROCESS(aes->decryptKeys, _mm_aesdec_si128, _mm_aesdeclast_si128);
+}
+
+static const ILAESKernels aesniKernels = {
+	"aesni",
+	AESNIEncrypt,
+	AESNIDecrypt
+};
+
+#endif /* IL_CRYPT_X86 */
+
+/*
+ * Kernels that are currently in use.  Races on the initialization
+ * are harmless because all threads will select the same kernels.
+ */
+static const ILAESKernels *kernels = 0;
+
+/*
+ * Get the kernels with a specific name, or the best kernels for
+ * this CPU if "name" is NULL.  Returns NULL if the kernels with
+ * the name are not supported.
+ */
+static const ILAESKernels *FindKernels(const char *name)
+{
+#ifdef IL_CRYPT_X86
+	if((_ILCryptCPUFeatures() & IL_CRYPT_CPU_AES) != 0 &&
+	   (!name || !strcmp(name, aesniKernels.name)))
+	{
+		return &aesniKernels;
+	}
+#endif
+	if(!name || !strcmp(name, scalarKernels.name))
+	{
+		return &scalarKernels;
+	}
+	return 0;
+}
+
+static const ILAESKernels *GetKernels(void)
+{
+	if(!kernels)
+	{
+		kernels = FindKernels(0);
+	}
+	return kernels;
+}
+
+const char *ILAESUseKernels(const char *name)
+{
+	const ILAESKernels *newKernels = FindKernels(name);
+	if(newKernels)
+	{
+		kernels = newKernels;
+	}
+	return GetKernels()->name;
+}
+
+void ILAESEncrypt(ILAESContext *aes, unsigned char *input,
+				  unsigned char *output)
+{
+	(*(GetKernels()->encrypt))(aes, input, output, 1);
+}
+
+void ILAESDecrypt(ILAESContext *aes, unsigned char *input,
+				  unsigned char *output)
+{
+	(*(GetKernels()->decrypt))(aes, input, output, 1);
+}
+
+void ILAESEncryptBlocks(ILAESContext *aes, const unsigned char *input,
+						unsigned char *output, unsigned long numBlocks)
+{
+	(*(GetKernels()->encrypt))(aes, input, output, numBlocks);
+}
+
+void ILAESDecryptBlocks(ILAESContext *aes, const unsigned char *input,
+						unsigned char *output, unsigned long numBlocks)
+{
+	(*(GetKernels()->decrypt))(aes, input, output, numBlocks);
+}
+
 void ILAESFinalize(ILAESContext *aes)
 {
 	ILMemZero(aes, sizeof(ILAESContext));
@@ -0,0 +1,86 @@
+/*
+ * crypt_cpu.h - Detect the CPU features used by the crypto kernels.
+ *
+ * Copyright (C) 2010  Southern Storm Software, Pty Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef	_CRYPT_CPU_H
+#define	_CRYPT_CPU_H
+
+/*
+ * The AES-NI, SHA-NI, SSSE3 and AVX2 kernels are compiled with target
+ * attributes, and are only used if "__builtin_cpu_supports" reports
+ * that the CPU supports the instructions.  Older compilers don't know
+ * the "aes" and "sha" feature names, so they only get scalar kernels.
+ */
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__)) && \
+	defined(__SSE2__) && \
+	((defined(__clang__) && __clang_major__ >= 16) || \
+	 (!defined(__clang__) && __GNUC__ >= 11))
+#define	IL_CRYPT_X86	1
+#include <immintrin.h>
+#endif
+
+#ifdef	__cplusplus
+extern	"C" {
+#endif
+
+/*
+ * Feature flags that are returned by "_ILCryptCPUFeatures".
+ */
+#define	IL_CRYPT_CPU_AES		(1 << 0)	/* AES-NI */
+#define	IL_CRYPT_CPU_SHA		(1 << 1)	/* SHA-NI, SSSE3 and SSE4.1 */
+#define	IL_CRYPT_CPU_AVX2		(1 << 2)	/* AVX2 */
+#define	IL_CRYPT_CPU_SSSE3		(1 << 3)	/* SSSE3 */
+
+#ifdef IL_CRYPT_X86
+
+/*
+ * Determine which of the crypto features the CPU supports.
+ */
+static int _ILCryptCPUFeatures(void)
+{
+	int features = 0;
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("aes"))
+	{
+		features |= IL_CRYPT_CPU_AES;
+	}
+	if(!__builtin_cpu_supports("ssse3"))
+	{
+		return features;
+	}
+	features |= IL_CRYPT_CPU_SSSE3;
+	if(__builtin_cpu_supports("sha") && __builtin_cpu_supports("sse4.1"))
+	{
+		features |= IL_CRYPT_CPU_SHA;
+	}
+	if(__builtin_cpu_supports("avx2"))
+	{
+		/* This also checks that the OS saves the AVX state */
+		features |= IL_CRYPT_CPU_AVX2;
+	}
+	return features;
+}
+
+#endif /* IL_CRYPT_X86 */
+
+#ifdef	__cplusplus
+};
+#endif
+
+#endif	/* _CRYPT_CPU_H */
@@ -25,6 +25,13 @@
 extern	"C" {
 #endif
 
+/*
+ * Default number of buckets and the minimum number of entries
+ * in an entry block.
+ */
+#define	IL_HASH_DEFAULT_SIZE		509
+#define	IL_HASH_MIN_BLOCK_SIZE		32
+
 /*
  * Structure of a single hash entry.
  */
@@ -36,12 +43,15 @@ struct _tagILHashEntry
 };
 
 /*
- * Structure of an overflow table block.
+ * Structure of an entry block.  Entries are allocated from the blocks
+ * in order and never move, so that iterators stay valid when the
+ * table is rehashed.  Entries of removed elements are put on a free
+ * list, linked through "overflow", and are reused by later adds.
  */
-typedef struct _tagILHashOverflow ILHashOverflow;
-struct _tagILHashOverflow
+struct _tagILHashBlock
 {
-	ILHashOverflow *next;
+	ILHashBlock    *next;
+	int				size;
 	ILHashEntry		entries[1];
 
 };
@@ -52,13 +62,17 @@ struct _tagILHashOverflow
 struct _tagILHashTable
 {
 	int						size;
+	int						count;
+	int						numEntries;
 	ILHashComputeFunc		computeFunc;
 	ILHashKeyComputeFunc	keyComputeFunc;
 	ILHashMatchFunc			matchFunc;
 	ILHashFreeFunc			freeFunc;
-	ILHashOverflow         *overflow;
-	int						overflowPosn;
-	ILHashEntry				table[1];
+	ILHashBlock		       *firstBlock;
+	ILHashBlock		       *lastBlock;
+	int						lastBlockPosn;
+	ILHashEntry		       *freeList;
+	ILHashEntry		      **table;
 
 };
 
@@ -72,121 +86,196 @@ ILHashTable *ILHashCreate(int size, ILHashComputeFunc computeFunc,
 	/* Allocate space for the hash table */
 	if(!size)
 	{
-		size = 509;
+		size = IL_HASH_DEFAULT_SIZE;
+	}
+	if((hashtab = (ILHashTable *)ILMalloc(sizeof(ILHashTable))) == 0)
+	{
+		return 0;
 	}
-	if((hashtab = (ILHashTable *)ILCalloc(1, sizeof(ILHashTable) +
-											 sizeof(ILHashEntry) * size)) == 0)
+	if((hashtab->table = (ILHashEntry **)ILCalloc
+			(size, sizeof(ILHashEntry *))) == 0)
 	{
+		ILFree(hashtab);
 		return 0;
 	}
 
 	/* Initialize the hash table */
 	hashtab->size = size;
+	hashtab->count = 0;
+	hashtab->numEntries = 0;
 	hashtab->computeFunc = computeFunc;
 	hashtab->keyComputeFunc = keyComputeFunc;
 	hashtab->matchFunc = matchFunc;
 	hashtab->freeFunc = freeFunc;
-	hashtab->overflow = 0;
-	hashtab->overflowPosn = size;
+	hashtab->firstBlock = 0;
+	hashtab->lastBlock = 0;
+	hashtab->lastBlockPosn = 0;
+	hashtab->freeList = 0;
 
 	/* Ready to go */
 	return hashtab;
 }
 
+/*
+ * Get the number of entries in use within an entry block.
+ */
+#define	BlockUsed(hashtab,block)	\
+			((block) == (hashtab)->lastBlock ? \
+				(hashtab)->lastBlockPosn : (block)->size)
+
 void ILHashDestroy(ILHashTable *hashtab)
 {
-	ILHashOverflow *overflow, *nextOverflow;
-	int hash;
-	ILHashEntry *entry;
+	ILHashBlock *block, *nextBlock;
+	int posn, used;
 
-	/* Free all elements within the hash table */
-	if(hashtab->freeFunc)
+	block = hashtab->firstBlock;
+	while(block != 0)
 	{
-		for(hash = 0; hash < hashtab->size; ++hash)
+		/* Free all elements within the block */
+		if(hashtab->freeFunc)
 		{
-			entry = &(hashtab->table[hash]);
-			while(entry != 0)
+			used = BlockUsed(hashtab, block);
+			for(posn = 0; posn < used; ++posn)
 			{
-				if(entry->elem != 0)
+				if(block->entries[posn].elem != 0)
 				{
-					(*(hashtab->freeFunc))(entry->elem);
+					(*(hashtab->freeFunc))(block->entries[posn].elem);
 				}
-				entry = entry->overflow;
 			}
 		}
-	}
 
-	/* Free the overflow table blocks */
-	overflow = hashtab->overflow;
-	while(overflow != 0)
-	{
-		nextOverflow = overflow->next;
-		ILFree(overflow);
-		overflow = nextOverflow;
+		/* Free the block itself */
+		nextBlock = block->next;
+		ILFree(block);
+		block = nextBlock;
 	}
 
 	/* Free the hash table object itself */
+	ILFree(hashtab->table);
 	ILFree(hashtab);
 }
 
-int ILHashAdd(ILHashTable *hashtab, void *elem)
+/*
+ * Link an entry to the end of its hash chain, so that elements
+ * with the same key are found in the order they were added.
+ */
+static void LinkEntry(ILHashEntry **table, int size, unsigned long hashValue,
+					  ILHashEntry *entry)
 {
-	int hash;
-	ILHashEntry *entry;
-	ILHashOverflow *overflow;
+	ILHashEntry **link = &(table[hashValue % (unsigned long)size]);
+	while(*link != 0)
+	{
+		link = &((*link)->overflow);
+	}
+	entry->overflow = 0;
+	*link = entry;
+}
 
-	/* Compute the hash table index */
-	hash = (int)((*(hashtab->computeFunc))(elem) %
-				 (unsigned long)(hashtab->size));
+/*
+ * Rehash the table into a bucket array of about twice the size.
+ * The old chains are relinked in order, so that elements with the
+ * same key stay in the order they were added.  The table stays as
+ * it is if out of memory.
+ */
+static void Rehash(ILHashTable *hashtab)
+{
+	int newSize = hashtab->size * 2 + 1;
+	ILHashEntry **newTable;
+	ILHashEntry *entry, *nextEntry;
+	int posn;
 
-	/* Add the element to the main part of the hash table if possible */
-	if(hashtab->table[hash].elem == 0)
+	if((newTable = (ILHashEntry **)ILCalloc
+			(newSize, sizeof(ILHashEntry *))) == 0)
 	{
-		hashtab->table[hash].elem = elem;
-		return 1;
+		return;
 	}
+	for(posn = 0; posn < hashtab->size; ++posn)
+	{
+		entry = hashtab->table[posn];
+		while(entry != 0)
+		{
+			nextEntry = entry->overflow;
+			LinkEntry(newTable, newSize,
+					  (*(hashtab->computeFunc))(entry->elem), entry);
+			entry = nextEntry;
+		}
+	}
+	ILFree(hashtab->table);
+	hashtab->table = newTable;
+	hashtab->size = newSize;
+}
 
-	/* Allocate a new overflow hash entry */
-	if(hashtab->overflowPosn < hashtab->size)
+int ILHashAdd(ILHashTable *hashtab, void *elem)
+{
+	ILHashEntry *entry;
+	ILHashBlock *block;
+	int blockSize;
+
+	/* Reuse the entry of a removed element, or allocate a new
+	   entry, adding a new block if necessary */
+	if(hashtab->freeList != 0)
 	{
-		entry = &(hashtab->overflow->entries[(hashtab->overflowPosn)++]);
+		entry = hashtab->freeList;
+		hashtab->freeList = entry->overflow;
 	}
-	else if((overflow = (ILHashOverflow *)ILMalloc
-				(sizeof(ILHashOverflow) +
-				 (hashtab->size - 1) * sizeof(ILHashEntry))) == 0)
+	else if(hashtab->lastBlock != 0 &&
+	   hashtab->lastBlockPosn < hashtab->lastBlock->size)
 	{
-		return 0;
+		entry = &(hashtab->lastBlock->entries[(hashtab->lastBlockPosn)++]);
 	}
 	else
 	{
-		overflow->next = hashtab->overflow;
-		hashtab->overflow = overflow;
-		entry = &(overflow->entries[0]);
-		hashtab->overflowPosn = 1;
+		/* Double the number of entries with each block */
+		blockSize = hashtab->numEntries;
+		if(blockSize < IL_HASH_MIN_BLOCK_SIZE)
+		{
+			blockSize = IL_HASH_MIN_BLOCK_SIZE;
+		}
+		if((block = (ILHashBlock *)ILMalloc
+				(sizeof(ILHashBlock) +
+				 (blockSize - 1) * sizeof(ILHashEntry))) == 0)
+		{
+			return 0;
+		}
+		block->next = 0;
+		block->size = blockSize;
+		if(hashtab->lastBlock)
+		{
+			hashtab->lastBlock->next = block;
+		}
+		else
+		{
+			hashtab->firstBlock = block;
+		}
+		hashtab->lastBlock = block;
+		hashtab->lastBlockPosn = 1;
+		hashtab->numEntries += blockSize;
+		entry = &(block->entries[0]);
 	}
 
-	/* Fill in the overflow entry and link it to the main hash table */
+	/* Fill in the entry and link it to the hash table */
 	entry->elem = elem;
-	entry->overflow = hashtab->table[hash].overflow;
-	hashtab->table[hash].overflow = entry;
+	LinkEntry(hashtab->table, hashtab->size,
+			  (*(hashtab->computeFunc))(elem), entry);
+
+	/* Rehash if the average chain length is getting too long */
+	if(++(hashtab->count) > hashtab->size)
+	{
+		Rehash(hashtab);
+	}
 	return 1;
 }
 
 void *ILHashFind(ILHashTable *hashtab, const void *key)
 {
-	int hash;
 	ILHashEntry *entry;
 
-	/* Compute the hash table index */
-	hash = (int)((*(hashtab->keyComputeFunc))(key) %
-				 (unsigned long)(hashtab->size));
-
 	/* Search for the requested entry */
-	entry = &(hashtab->table[hash]);
+	entry = hashtab->table[(*(hashtab->keyComputeFunc))(key) %
+						   (unsigned long)(hashtab->size)];
 	while(entry != 0)
 	{
-		if(entry->elem != 0 &&
-		   (*(hashtab->matchFunc))(entry->elem, key))
+		if((*(hashtab->matchFunc))(entry->elem, key))
 		{
 			return entry->elem;
 		}
@@ -201,17 +290,14 @@ void *ILHashFindAlt(ILHashTable *hashtab, const void *key,
 					ILHashKeyComputeFunc keyComputeFunc,
 					ILHashMatchFunc matchFunc)
 {
-	int hash;
 	ILHashEntry *entry;
 
-	/* Compute the hash table index */
-	hash = (int)((*keyComputeFunc)(key) % (unsigned long)(hashtab->size));
-
 	/* Search for the requested entry */
-	entry = &(hashtab->table[hash]);
+	entry = hashtab->table[(*keyComputeFunc)(key) %
+						   (unsigned long)(hashtab->size)];
 	while(entry != 0)
 	{
-		if(entry->elem != 0 && (*matchFunc)(entry->elem, key))
+		if((*matchFunc)(entry->elem, key))
 		{
 			return entry->elem;
 		}
@@ -222,52 +308,62 @@ void *ILHashFindAlt(ILHashTable *hashtab, const void *key,
 	return 0;
 }
 
-void ILHashRemove(ILHashTable *hashtab, void *elem, int freeElem)
+/*
+ * Unlink an entry from its hash chain and put it on the free list.
+ * "link" points at the chain pointer that refers to the entry.
+ */
+static void FreeEntry(ILHashTable *hashtab, ILHashEntry **link, int freeElem)
 {
-	int hash;
-	ILHashEntry *entry;
+	ILHashEntry *entry = *link;
+	*link = entry->overflow;
+	if(freeElem && hashtab->freeFunc)
+	{
+		(*(hashtab->freeFunc))(entry->elem);
+	}
+	entry->elem = 0;
+	entry->overflow = hashtab->freeList;
+	hashtab->freeList = entry;
+	--(hashtab->count);
+}
 
-	/* Compute the hash table index */
-	hash = (int)((*(hashtab->computeFunc))(elem) %
-				 (unsigned long)(hashtab->size));
+void ILHashRemove(ILHashTable *hashtab, void *elem, int freeElem)
+{
+	ILHashEntry **link;
 
 	/* Search for the requested entry */
-	entry = &(hashtab->table[hash]);
-	while(entry != 0)
+	link = &(hashtab->table[(*(hashtab->computeFunc))(elem) %
+						    (unsigned long)(hashtab->size)]);
+	while(*link != 0)
 	{
-		if(entry->elem == elem)
+		if((*link)->elem == elem)
 		{
 			/* Remove the entry from the hash table and exit */
-			if(freeElem && hashtab->freeFunc)
-			{
-				(*(hashtab->freeFunc))(entry->elem);
-			}
-			entry->elem = 0;
+			FreeEntry(hashtab, link, freeElem);
 			return;
 		}
-		entry = entry->overflow;
+		link = &((*link)->overflow);
 	}
 }
 
 void ILHashRemoveSubset(ILHashTable *hashtab, ILHashMatchFunc matchFunc,
 						const void *key, int freeElem)
 {
-	int hash;
-	ILHashEntry *entry;
-	for(hash = 0; hash < hashtab->size; ++hash)
+	ILHashEntry **link;
+	int posn;
+
+	for(posn = 0; posn < hashtab->size; ++posn)
 	{
-		entry = &(hashtab->table[hash]);
-		while(entry != 0)
+		link = &(hashtab->table[posn]);
+		while(*link != 0)
 		{
-			if(entry->elem != 0 && (*matchFunc)(entry->elem, key))
+			if((*matchFunc)((*link)->elem, key))
 			{
-				if(freeElem && hashtab->freeFunc)
-				{
-					(*(hashtab->freeFunc))(entry->elem);
-				}
-				entry->elem = 0;
+				FreeEntry(hashtab, link, freeElem);
+			}
+			else
+			{
+				link = &((*link)->overflow);
 			}
-			entry = entry->overflow;
 		}
 	}
 }
@@ -275,33 +371,43 @@ void ILHashRemoveSubset(ILHashTable *hashtab, ILHashMatchFunc matchFunc,
 void ILHashIterInit(ILHashIter *iter, ILHashTable *hashtab)
 {
 	iter->hashtab = hashtab;
-	iter->index = -1;
-	iter->entry = 0;
+	iter->block = 0;
+	iter->index = 0;
 }
 
 void *ILHashIterNext(ILHashIter *iter)
 {
-	ILHashEntry *temp;
+	ILHashTable *hashtab = iter->hashtab;
+	ILHashBlock *block = iter->block;
+	void *elem;
+
+	/* Elements are visited in entry order, which includes elements
+	   that are added to new entries during the iteration */
+	if(!block)
+	{
+		if((block = hashtab->firstBlock) == 0)
+		{
+			return 0;
+		}
+		iter->block = block;
+	}
 	for(;;)
 	{
-		if(iter->entry == 0)
+		while(iter->index < BlockUsed(hashtab, block))
 		{
-			++(iter->index);
-			if(iter->index >= iter->hashtab->size)
+			elem = block->entries[(iter->index)++].elem;
+			if(elem != 0)
 			{
-				break;
+				return elem;
 			}
-			iter->entry = &(iter->hashtab->table[iter->index]);
-		}
-		while(iter->entry != 0 && iter->entry->elem == 0)
-		{
-			iter->entry = iter->entry->overflow;
 		}
-		if((temp = iter->entry) != 0)
+		if(!(block->next))
 		{
-			iter->entry = temp->overflow;
-			return temp->elem;
+			break;
 		}
+		block = block->next;
+		iter->block = block;
+		iter->index = 0;
 	}
 	return 0;
 }
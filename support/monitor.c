@@ -26,14 +26,39 @@
 #include <il_utils.h>
 #include "thr_defs.h"
 #include "interlocked.h"
-#ifdef IL_THREAD_DEBUG
 #include <stdio.h>
-#endif
 
 #ifdef	__cplusplus
 extern	"C" {
 #endif
 
+/*
+
+Monitors are inflated from a per-thread cache.  A monitor in the cache
+of a thread is owned by that thread, so it can be attached to a monitor
+location with a single compare and exchange.  When the cache is empty,
+it is refilled with a batch of monitors from the global pool, and when
+it grows too large a batch of monitors is drained back to the pool.
+Either way, the pool lock is taken once per batch rather than once per
+monitor.
+
+The "users" count of a monitor is the number of threads that own or
+are waiting for it.  The owner of an uncontended monitor leaves it by
+changing "users" from 1 to 0 and clearing the monitor location, without
+taking the pool lock.  Threads that want to wait for a monitor increment
+"users" with the pool lock held, but only if it is not 0, so once the
+owner has started to leave the monitor nobody can join it.  A thread
+that finds "users" at 0 waits for the owner to clear the location and
+starts again.
+
+Monitors in the cache of a thread have "users" set to 0, and it is set
+to 1 only after the monitor has been attached to a location.  A thread
+that is holding a stale pointer to a cached monitor therefore cannot
+join it.  If the monitor has already been attached somewhere else, the
+thread sees that the location has changed and backs out.
+
+*/
+
 /*
  * Number of monitors that should be kept in the thread local freelist.
  */
@@ -45,13 +70,20 @@ extern	"C" {
  */
 #define MAX_FREELIST_MONITORS	5
 
+/*
+ * Number of monitors that are moved to the thread local freelist
+ * when it is empty.
+ */
+#define REFILL_FREELIST_MONITORS	3
+
 struct _tagILMonitor
 {
 	ILMonitor		   *nextUsed;	/* The next monitor in the used list */
+	ILMonitor		   *prevUsed;	/* The previous monitor in the used list */
 	ILMonitor		   *nextFree;	/* The next monitor in the free list */
 	ILThread * volatile	owner;		/* The current owner of the monotor */
 	ILInt32				enterCount;	/* The number of enters without corresponding leave by the owner */
-	ILUInt32			users;		/* The number of threads using this monitor */
+	volatile ILInt32	users;		/* The number of threads using this monitor */
 	_ILMonitor			monitor;	/* The platform dependent monitor */
 };
 
@@ -65,8 +97,9 @@ struct _tagILMonitorPool
 	ILMonitor		   *freeList;	/* List of unused monitors */
 	ILMonitor		   *usedList;	/* List of monitors in use */
 	ILMemPool			pool;		/* Pool to allocate the monitors from */
-#ifdef IL_THREAD_DEBUG
 	ILUInt32		numReclaimed;	/* Number of reclaimed monitors */
+	ILMonitorStats	threadStats;	/* Counters of threads that have exited */
+#ifdef IL_THREAD_DEBUG
 	ILUInt32		numAbandoned;	/* Number of abandoned monitors */
 #endif
 };
@@ -83,7 +116,7 @@ static int ILMonitorInit(ILMonitor *monitor, ILThread *thread)
 	monitor->nextFree = 0;
 	monitor->owner = thread;
 	monitor->enterCount = 1;
-	monitor->users = 1;
+	monitor->users = 0;
 	_ILMonitorCreate(&(monitor->monitor), result);
 	return result;
 }
@@ -93,6 +126,7 @@ static void ILMonitorDestroy(ILMonitor *monitor)
 	int result;
 
 	monitor->nextUsed = 0;
+	monitor->prevUsed = 0;
 	monitor->nextFree = 0;
 	monitor->owner = 0;
 	monitor->enterCount = 0;
@@ -112,7 +146,6 @@ static void DestroyMonitorUsedList(ILMonitor *monitor)
 	}
 }
 
-#ifdef IL_THREAD_DEBUG
 static int FreeListCount(ILMonitor *monitor)
 {
 	int count;
@@ -139,24 +172,76 @@ static int UsedListCount(ILMonitor *monitor)
 	return count;
 }
 
-void ILMonitorPrintStats()
+/*
+ * Add the counters of a thread to the counters of the pool.
+ * The monitor pool lock must be held.
+ */
+static void _ILMonitorPoolAddThreadStats(_ILMonitorPool *pool,
+										 ILThread *thread)
 {
-	fprintf(stderr, "Number of monitors in the used list: %i\n",
-		    UsedListCount(_MonitorPool.usedList));
-	fprintf(stderr, "Number of monitors in the free list: %i\n",
-		    FreeListCount(_MonitorPool.freeList));
-	fprintf(stderr, "Number of reclaimed monitors: %i\n",
-					_MonitorPool.numReclaimed);
+	pool->threadStats.cacheHits += thread->monitorCacheHits;
+	pool->threadStats.cacheMisses += thread->monitorCacheMisses;
+	pool->threadStats.contended += thread->monitorContended;
+	pool->threadStats.drains += thread->monitorDrains;
+	thread->monitorCacheHits = 0;
+	thread->monitorCacheMisses = 0;
+	thread->monitorContended = 0;
+	thread->monitorDrains = 0;
+}
+
+void ILMonitorGetStats(ILMonitorStats *stats)
+{
+	ILThread *thread = _ILThreadGetSelf();
+
+	_ILCriticalSectionEnter(&(_MonitorPool.lock));
+	*stats = _MonitorPool.threadStats;
+	stats->numUsed = (ILUInt32)UsedListCount(_MonitorPool.usedList);
+	stats->numFree = (ILUInt32)FreeListCount(_MonitorPool.freeList);
+	stats->numReclaimed = _MonitorPool.numReclaimed;
+	_ILCriticalSectionLeave(&(_MonitorPool.lock));
+
+	/* Include the counters of the calling thread, which has not exited */
+	if(thread)
+	{
+		stats->cacheHits += thread->monitorCacheHits;
+		stats->cacheMisses += thread->monitorCacheMisses;
+		stats->contended += thread->monitorContended;
+		stats->drains += thread->monitorDrains;
+	}
+}
+
+void ILMonitorPrintStats(void)
+{
+	ILMonitorStats stats;
+
+	ILMonitorGetStats(&stats);
+	fprintf(stderr, "Number of monitors in the used list: %lu\n",
+			(unsigned long)(stats.numUsed));
+	fprintf(stderr, "Number of monitors in the free list: %lu\n",
+			(unsigned long)(stats.numFree));
+	fprintf(stderr, "Number of reclaimed monitors: %lu\n",
+			(unsigned long)(stats.numReclaimed));
+#ifdef IL_THREAD_DEBUG
 	fprintf(stderr, "Number of abandoned monitors: %i\n",
 					_MonitorPool.numAbandoned);
-}
 #endif
+	fprintf(stderr, "Monitors inflated from thread caches: %lu\n",
+			(unsigned long)(stats.cacheHits));
+	fprintf(stderr, "Thread cache refills: %lu\n",
+			(unsigned long)(stats.cacheMisses));
+	fprintf(stderr, "Thread cache drains: %lu\n",
+			(unsigned long)(stats.drains));
+	fprintf(stderr, "Contended monitor enters: %lu\n",
+			(unsigned long)(stats.contended));
+}
 
 static void _ILMonitorPoolInit(void)
 {
 	ILMemPoolInitType(&(_MonitorPool.pool), ILMonitor, 20);
 	_MonitorPool.freeList = 0;
 	_MonitorPool.usedList = 0;
+	_MonitorPool.numReclaimed = 0;
+	ILMemZero(&(_MonitorPool.threadStats), sizeof(ILMonitorStats));
 #ifdef IL_THREAD_DEBUG
 	_MonitorPool.numAbandoned = 0;
 #endif
@@ -180,104 +265,97 @@ static void _ILMonitorPoolDestroy(void)
 }
 
 /*
- * Get a new monitor from the monitor pool.
- * The thread parameter *MUST* be the current thread. 
- * The monitor is owned by the current if the function returns success.
+ * Move a batch of monitors from the monitor pool to the thread local
+ * freelist of the current thread, which must be empty.
+ * The thread parameter *MUST* be the current thread.
+ * The monitors are owned by the current thread if the function returns
+ * success.
  * This function must be called with the monitorpool lock held.
  */
-static int _ILMonitorPoolAllocMonitor(ILThread *thread, ILMonitor **monitorLocation)
+static int _ILMonitorPoolRefill(ILThread *thread)
 {
 	ILMonitor *monitor;
-	int result;
+	int result = IL_THREAD_OK;
 
-	if(_MonitorPool.freeList)
+	++(thread->monitorCacheMisses);
+	while(thread->monitorFreeCount < REFILL_FREELIST_MONITORS)
 	{
-		/* We have a monitor on the global freelist so reuse this one */
-		monitor = _MonitorPool.freeList;
-		_MonitorPool.freeList = monitor->nextFree;
-		monitor->nextFree = (ILMonitor *)0;
-		if((result = _ILMonitorAcquire(&(monitor->monitor))) == IL_THREAD_OK)
+		if(_MonitorPool.freeList)
 		{
+			/* We have a monitor on the global freelist so reuse this one */
+			monitor = _MonitorPool.freeList;
+			if((result = _ILMonitorAcquire(&(monitor->monitor))) != IL_THREAD_OK)
+			{
+				break;
+			}
+			_MonitorPool.freeList = monitor->nextFree;
+
 			/* Initialize the monitor state */
 			monitor->owner = thread;
 			monitor->enterCount = 1;
-			monitor->users = 1;
-			/* Return the monitor */
-			*monitorLocation = monitor;
+			monitor->users = 0;
 		}
-		else
+		else if(thread->monitorFreeList)
 		{
-			/* Add this monitor to the freelist */
-			monitor->nextFree = _MonitorPool.freeList;
-			_MonitorPool.freeList = monitor;
+			/* Don't allocate more monitors than are needed right now */
+			break;
 		}
-		return result;
-	}
-	else
-	{
-		monitor = ILMemPoolAllocItem(&(_MonitorPool.pool));
-		if(monitor)
+		else
 		{
-			/* Add the monitor to the list of monitors*/
-			monitor->nextUsed = _MonitorPool.usedList;
-			_MonitorPool.usedList = monitor;
-
-			if((result = ILMonitorInit(monitor, thread)) == IL_THREAD_OK)
+			monitor = ILMemPoolAllocItem(&(_MonitorPool.pool));
+			if(!monitor)
 			{
-				/* Return the monitor */
-				*monitorLocation = monitor;
+				result = IL_THREAD_ERR_OUTOFMEMORY;
+				break;
 			}
-			else
+			if((result = ILMonitorInit(monitor, thread)) != IL_THREAD_OK)
 			{
-				/* Add this monitor to the freelist */
-				monitor->nextFree = _MonitorPool.freeList;
-				_MonitorPool.freeList = monitor;
+				ILMemPoolFree(&(_MonitorPool.pool), monitor);
+				break;
 			}
-			return result;
+
+			/* Add the monitor to the list of monitors*/
+			monitor->prevUsed = 0;
+			monitor->nextUsed = _MonitorPool.usedList;
+			if(_MonitorPool.usedList)
+			{
+				_MonitorPool.usedList->prevUsed = monitor;
+			}
+			_MonitorPool.usedList = monitor;
 		}
-		return IL_THREAD_ERR_OUTOFMEMORY;
+
+		/* Add the monitor to the thread local freelist */
+		monitor->nextFree = thread->monitorFreeList;
+		thread->monitorFreeList = monitor;
+		++(thread->monitorFreeCount);
 	}
-	return IL_THREAD_ERR_UNKNOWN;
+	return (thread->monitorFreeList ? IL_THREAD_OK : result);
 }
 
 /*
  * Reclaim a monitor that's no longer needed.
- * If the monitor is in the used list of the monitor pool it will be
+ * The monitor is removed from the used list of the monitor pool,
  * destroyed and moved to the memory pool freelist.
  * This function must be called with the monitorpool lock held.
  */
 static void _ILMonitorPoolReclaimMonitor(_ILMonitorPool *pool,
 										 ILMonitor *monitor)
 {
-	if(pool->usedList == monitor)
+	if(monitor->prevUsed)
 	{
-		pool->usedList = monitor->nextUsed;
-		ILMonitorDestroy(monitor);
-		ILMemPoolFree(&(pool->pool), monitor);
-#ifdef IL_THREAD_DEBUG
-		++(pool->numReclaimed);
-#endif
+		monitor->prevUsed->nextUsed = monitor->nextUsed;
 	}
 	else
 	{
-		ILMonitor *prevMonitor;
-
-		prevMonitor = pool->usedList;
-		while(prevMonitor)
-		{
-			if(prevMonitor->nextUsed == monitor)
-			{
-				prevMonitor->nextUsed = monitor->nextUsed;
-				ILMonitorDestroy(monitor);
-				ILMemPoolFree(&(pool->pool), monitor);
-#ifdef IL_THREAD_DEBUG
-				++(pool->numReclaimed);
-#endif
-				return;
-			}
-			prevMonitor = prevMonitor->nextUsed;
-		}
+		pool->usedList = monitor->nextUsed;
+	}
+	if(monitor->nextUsed)
+	{
+		monitor->nextUsed->prevUsed = monitor->prevUsed;
 	}
+	ILMonitorDestroy(monitor);
+	ILMemPoolFree(&(pool->pool), monitor);
+	++(pool->numReclaimed);
 }
 
 /*
@@ -303,6 +381,156 @@ static void _ILMonitorPoolAddListToFreeList(_ILMonitorPool *pool,
 	pool->freeList = firstMonitor;
 }
 
+/*
+ * Add the current thread to the users of a monitor that was read from
+ * a monitor location.  Returns zero if the monitor is being released or
+ * attached, or was moved to another location in the meantime, in which
+ * case the caller must call "_ILMonitorWaitUntilUsable" and then read
+ * the location again.
+ * This function must be called with the monitorpool lock held.
+ */
+static int _ILMonitorAddUser(ILMonitor *monitor, void **monitorLocation)
+{
+	ILInt32 users;
+
+	do
+	{
+		users = ILInterlockedLoadI4(&(monitor->users));
+		if(users <= 0)
+		{
+			/*
+			 * The owner is leaving the monitor, or the monitor is not
+			 * attached yet.
+			 */
+			return 0;
+		}
+	}
+	while(ILInterlockedCompareAndExchangeI4(&(monitor->users),
+											users + 1, users) != users);
+
+	if(ILInterlockedLoadP(monitorLocation) != monitor)
+	{
+		/* The monitor was recycled for another location */
+		ILInterlockedDecrementI4(&(monitor->users));
+		return 0;
+	}
+	return 1;
+}
+
+/*
+ * Wait until a monitor that "_ILMonitorAddUser" could not join is moved
+ * away from the monitor location or becomes usable.  The thread that
+ * changes it does so without the monitorpool lock, so this function
+ * must be called without the lock held.  Otherwise every slow path
+ * monitor operation would stall if that thread was preempted.
+ */
+static void _ILMonitorWaitUntilUsable(ILMonitor *monitor,
+									  void **monitorLocation)
+{
+	while(ILInterlockedLoadP(monitorLocation) == monitor &&
+		  ILInterlockedLoadI4(&(monitor->users)) <= 0)
+	{
+		_ILThreadYield();
+	}
+}
+
+/*
+ * Put a monitor that the current thread has left and that nobody else
+ * is using into the thread local freelist, and move monitors to the
+ * global freelist if there are too many of them.
+ */
+static void _ILMonitorCacheMonitor(ILThread *thread, ILMonitor *monitor)
+{
+	ILMonitor *firstMonitor;
+	ILMonitor *lastMonitor;
+	int current;
+
+	if(thread->monitorFreeCount < MAX_FREELIST_MONITORS)
+	{
+		/* Add the monitor to the thread local freelist */
+		monitor->nextFree = thread->monitorFreeList;
+		thread->monitorFreeList = monitor;
+		++thread->monitorFreeCount;
+		return;
+	}
+
+	/*
+	 * Move monitors from the thread local freelist to the global
+	 * freelist.
+	 */
+	++(thread->monitorDrains);
+
+	/*
+	 * First look for the last monitor that should stay on the
+	 * local freelist.
+	 */
+	firstMonitor = thread->monitorFreeList;
+	for(current = 0; current < (MIN_FREELIST_MONITORS - 1); ++current)
+	{
+		if(firstMonitor == 0)
+		{
+			break;
+		}
+		firstMonitor = firstMonitor->nextFree;
+	}
+
+	if(firstMonitor)
+	{
+		lastMonitor = firstMonitor->nextFree;
+		firstMonitor->nextFree = 0;
+		firstMonitor = lastMonitor;
+		thread->monitorFreeCount = current + 1;
+
+		while(lastMonitor)
+		{
+			IL_THREAD_ASSERT(lastMonitor->users == 0)
+			lastMonitor->owner = 0;
+			_ILMonitorRelease(&(lastMonitor->monitor));
+			if(lastMonitor->nextFree == 0)
+			{
+				break;
+			}
+			lastMonitor = lastMonitor->nextFree;
+		}
+		/*
+		 * Make the  current monitor the head of the monitor list
+		 * to be moved to the global freelist.
+		 */
+		monitor->nextFree = firstMonitor;
+		firstMonitor = monitor;
+		if(!lastMonitor)
+		{
+			lastMonitor = monitor;
+		}
+	}
+	else
+	{
+		/*
+		 * If this happens something is wrong or MIN and MAX
+		 * FREELIST_MONITORS are not set correctly.
+		 * So simply make monitor a single element list.
+		 */
+		firstMonitor = monitor;
+		lastMonitor = monitor;
+		thread->monitorFreeCount = current;
+	}
+
+	/* Release the current monitor */
+	IL_THREAD_ASSERT(monitor->users == 0)
+	monitor->owner = 0;
+	_ILMonitorRelease(&(monitor->monitor));
+
+	/* Lock the monitor system */
+	_ILCriticalSectionEnter(&(_MonitorPool.lock));
+
+	_ILMonitorPoolAddListToFreeList(&_MonitorPool,
+									firstMonitor,
+									lastMonitor);
+
+	/* Unlock the monitor system */
+	_ILCriticalSectionLeave(&(_MonitorPool.lock));
+}
+
 void _ILMonitorSystemInit()
 {
 	_ILMonitorPoolInit();
@@ -315,20 +543,20 @@ void _ILMonitorSystemDeinit()
 
 void _ILMonitorDestroyThread(ILThread *thread)
 {
+	ILMonitor *firstMonitor;
+	ILMonitor *lastMonitor;
+
 	IL_THREAD_ASSERT(thread == _ILThreadGetSelf());
-	if(thread->monitorFreeList)
+	firstMonitor = thread->monitorFreeList;
+	lastMonitor = firstMonitor;
+	if(firstMonitor)
 	{
-		ILMonitor *firstMonitor;
-		ILMonitor *lastMonitor;
-
-		firstMonitor = thread->monitorFreeList;
 		thread->monitorFreeList = 0;
-		lastMonitor = firstMonitor;
+		thread->monitorFreeCount = 0;
 		while(lastMonitor)
 		{
-			IL_THREAD_ASSERT(lastMonitor->users == 1)
+			IL_THREAD_ASSERT(lastMonitor->users == 0)
 			lastMonitor->owner = 0;
-			lastMonitor->users = 0;
 			_ILMonitorRelease(&(lastMonitor->monitor));
 			if(lastMonitor->nextFree == 0)
 			{
@@ -336,16 +564,20 @@ void _ILMonitorDestroyThread(ILThread *thread)
 			}
 			lastMonitor = lastMonitor->nextFree;
 		}
+	}
 
-		/* Lock the monitor system */
-		_ILCriticalSectionEnter(&(_MonitorPool.lock));
+	/* Lock the monitor system */
+	_ILCriticalSectionEnter(&(_MonitorPool.lock));
 
+	if(firstMonitor)
+	{
 		_ILMonitorPoolAddListToFreeList(&_MonitorPool,
 										firstMonitor, lastMonitor);
-
-		/* Unlock the monitor system */
-		_ILCriticalSectionLeave(&(_MonitorPool.lock));
 	}
+	_ILMonitorPoolAddThreadStats(&_MonitorPool, thread);
+
+	/* Unlock the monitor system */
+	_ILCriticalSectionLeave(&(_MonitorPool.lock));
 }
 
 int ILMonitorTimedTryEnter(void **monitorLocation, ILUInt32 ms)
@@ -387,11 +619,15 @@ int ILMonitorTimedTryEnter(void **monitorLocation, ILUInt32 ms)
 													monitor, 0) == 0)
 		{
 			/*
-			 * Remove the monitor from the thread's freelist.
+			 * Remove the monitor from the thread's freelist, and make
+			 * me its only user now that it is attached.
 			 */
 			thread->monitorFreeList = monitor->nextFree;
 			monitor->nextFree = 0;
 			--thread->monitorFreeCount;
+			++(thread->monitorCacheHits);
+			monitor->enterCount = 1;
+			ILInterlockedStoreI4_Release(&(monitor->users), 1);
 			return IL_THREAD_OK;
 		}
 	}
@@ -402,61 +638,59 @@ int ILMonitorTimedTryEnter(void **monitorLocation, ILUInt32 ms)
 	/* Lock the monitor system */
 	_ILCriticalSectionEnter(&(_MonitorPool.lock));
 
-	monitor = (ILMonitor *)ILInterlockedLoadP(monitorLocation);
-	if(monitor == 0)
+	for(;;)
 	{
-		if(thread->monitorFreeList)
+		monitor = (ILMonitor *)ILInterlockedLoadP(monitorLocation);
+		if(monitor == 0)
 		{
+			if(!(thread->monitorFreeList))
+			{
+				/* Get a batch of monitors from the pool */
+				result = _ILMonitorPoolRefill(thread);
+				if(result != IL_THREAD_OK)
+				{
+					/* Unlock the monitor system */
+					_ILCriticalSectionLeave(&(_MonitorPool.lock));
+					return result;
+				}
+			}
 			monitor = thread->monitorFreeList;
 			if(ILInterlockedCompareAndExchangeP_Acquire(monitorLocation,
 														monitor, 0) == 0)
 			{
 				/*
-				 * Release the global monitor lock.
-				 */
-				_ILCriticalSectionLeave(&(_MonitorPool.lock));
-
-				/*
-				 * And remove the monitor from the thread's freelist.
+				 * Remove the monitor from the thread's freelist.
 				 */
 				thread->monitorFreeList = monitor->nextFree;
 				monitor->nextFree = 0;
 				--thread->monitorFreeCount;
+				++(thread->monitorCacheHits);
+				monitor->enterCount = 1;
+				ILInterlockedStoreI4_Release(&(monitor->users), 1);
+
+				/*
+				 * And release the global monitor lock.
+				 */
+				_ILCriticalSectionLeave(&(_MonitorPool.lock));
 				return IL_THREAD_OK;
 			}
-			monitor = (ILMonitor *)ILInterlockedLoadP(monitorLocation);
+		}
+		else if(_ILMonitorAddUser(monitor, monitorLocation))
+		{
+			/* I'm now one of the users of the monitor */
+			break;
 		}
 		else
 		{
-			/* We have to allocate a new monitor */
-			result = _ILMonitorPoolAllocMonitor(thread, &monitor);
-
-			if(result == IL_THREAD_OK)
-			{
-				if(ILInterlockedCompareAndExchangeP_Acquire(monitorLocation,
-															monitor, 0) == 0)
-				{
-					/*
-					 * Release the global monitor lock.
-					 */
-					_ILCriticalSectionLeave(&(_MonitorPool.lock));
-					return result;
-				}
-				monitor = (ILMonitor *)ILInterlockedLoadP(monitorLocation);
-			}
-			else
-			{
-				/* Unlock the monitor system */
-				_ILCriticalSectionLeave(&(_MonitorPool.lock));
-				return result;
-			}
+			/* Wait for the monitor to settle without the lock */
+			_ILCriticalSectionLeave(&(_MonitorPool.lock));
+			_ILMonitorWaitUntilUsable(monitor, monitorLocation);
+			_ILCriticalSectionEnter(&(_MonitorPool.lock));
 		}
 	}
+	++(thread->monitorContended);
 	if(monitor->owner == 0)
 	{
-		/* Add me to the monitor users */
-		++(monitor->users);
-
 		/*
 		 * We can acquire the monitor in the lock here because we are
 		 * sure that it's not owned by someone else.
@@ -474,21 +708,6 @@ int ILMonitorTimedTryEnter(void **monitorLocation, ILUInt32 ms)
 
 			return result;
 		}
-		else if(result == IL_THREAD_BUSY)
-		{
-			if(ms == 0)
-			{
-				/* Rmove me from the monitor users */
-				--(monitor->users);
-
-				/* Unlock the monitor system */
-				_ILCriticalSectionLeave(&(_MonitorPool.lock));
-
-				return result;
-			}
-		}
-		/* Rmove me from the monitor users */
-		--(monitor->users);
 	}
 	if(ms == 0)
 	{
@@ -497,6 +716,9 @@ int ILMonitorTimedTryEnter(void **monitorLocation, ILUInt32 ms)
 		 * This is not possible.
 		 */
 
+		/* Rmove me from the monitor users */
+		ILInterlockedDecrementI4(&(monitor->users));
+
 		/* Unlock the monitor system */
 		_ILCriticalSectionLeave(&(_MonitorPool.lock));
 
@@ -508,13 +730,14 @@ int ILMonitorTimedTryEnter(void **monitorLocation, ILUInt32 ms)
 	result = _ILThreadEnterWaitState(thread);
 	if(result != IL_THREAD_OK)
 	{
+		/* Rmove me from the monitor users */
+		ILInterlockedDecrementI4(&(monitor->users));
+
 		/* Unlock the monitor pool */
 		_ILCriticalSectionLeave(&(_MonitorPool.lock));
 
 		return result;
 	}
-	/* Add me to the monitor users */
-	++(monitor->users);
 
 	/* Unlock the monitor pool */
 	_ILCriticalSectionLeave(&(_MonitorPool.lock));
@@ -537,9 +760,6 @@ int ILMonitorTimedTryEnter(void **monitorLocation, ILUInt32 ms)
 		/* Lock the monitor system again */
 		_ILCriticalSectionEnter(&(_MonitorPool.lock));
 
-		/* Remove me from the user list */
-		--(monitor->users);
-
 		/*
 		 * If we acquired the monitor successfully but got interrupted
 		 * we have to exit the monitor now.
@@ -549,7 +769,8 @@ int ILMonitorTimedTryEnter(void **monitorLocation, ILUInt32 ms)
 			_ILMonitorExit(&(monitor->monitor));
 		}
 
-		if(monitor->users <= 0)
+		/* Remove me from the user list */
+		if(ILInterlockedDecrementI4(&(monitor->users)) <= 0)
 		{
 			/* No other waiters on the monitor */
 			monitor->users = 0;
@@ -591,126 +812,56 @@ int ILMonitorExit(void **monitorLocation)
 	{
 		return IL_THREAD_ERR_SYNCLOCK;
 	}
-	if(monitor->enterCount <= 1)
+	if(monitor->enterCount > 1)
 	{
-		/* We really are leaving the monitor */
-		_ILCriticalSectionEnter(&(_MonitorPool.lock));
-
-		if(monitor->users <= 1)
-		{
-			/*
-			 * I'm the only thread in this monitor.
-			 * So move the monitor to the freelist.
-			 */
-
-			/* Clear the monitor location first */
-			ILInterlockedStoreP(monitorLocation,  0);
-
-			_ILCriticalSectionLeave(&(_MonitorPool.lock));
-
-			if(thread->monitorFreeCount < MAX_FREELIST_MONITORS)
-			{
-				/* Add the monitor to the thread local freelist */
-				monitor->nextFree = thread->monitorFreeList;
-				thread->monitorFreeList = monitor;
-				++thread->monitorFreeCount;
-			}
-			else
-			{
-				/*
-				 * Move monitors from the thread local freelist to the global
-				 * freelist.
-				 */
-				ILMonitor *firstMonitor;
-				ILMonitor *lastMonitor;
-				int current;
-
-				/*
-				 * First look for the last monitor that should stay on the
-				 * local freelist.
-				 */
-				firstMonitor = thread->monitorFreeList;
-				for(current = 0; current < (MIN_FREELIST_MONITORS - 1); ++current)
-				{
-					if(firstMonitor == 0)
-					{
-						break;
-					}
-					firstMonitor = firstMonitor->nextFree;
-				}
+		/* Simpy decrement the enter count */
+		--(monitor->enterCount);
+		return IL_THREAD_OK;
+	}
 
-				if(firstMonitor)
-				{
-					lastMonitor = firstMonitor->nextFree;
-					firstMonitor->nextFree = 0;
-					firstMonitor = lastMonitor;
-					thread->monitorFreeCount = current + 1;
-
-					while(lastMonitor)
-					{
-						IL_THREAD_ASSERT(lastMonitor->users == 1)
-						lastMonitor->owner = 0;
-						lastMonitor->users = 0;
-						_ILMonitorRelease(&(lastMonitor->monitor));
-						if(lastMonitor->nextFree == 0)
-						{
-							break;
-						}
-						lastMonitor = lastMonitor->nextFree;
-					}
-					/*
-					 * Make the  current monitor the head of the monitor list
-					 * to be moved to the global freelist.
-					 */
-					monitor->nextFree = firstMonitor;
-					firstMonitor = monitor;
-				}
-				else
-				{
-					/*
-					 * If this happens something is wrong or MIN and MAX
-					 * FREELIST_MONITORS are not set correctly.
-					 * So simply make monitor a single element list.
-					 */
-					firstMonitor = monitor;
-					lastMonitor = monitor;
-					thread->monitorFreeCount = current;
-				}
+	/* We really are leaving the monitor */
+	if(ILInterlockedCompareAndExchangeI4_Release(&(monitor->users),
+												 0, 1) == 1)
+	{
+		/*
+		 * I'm the only thread in this monitor, and nobody can join it
+		 * now.  So clear the monitor location and move the monitor to
+		 * the freelist without taking the monitor pool lock.
+		 */
+		ILInterlockedStoreP_Release(monitorLocation, 0);
+		_ILMonitorCacheMonitor(thread, monitor);
+		return IL_THREAD_OK;
+	}
 
-				/* Release the current monitor */
-				IL_THREAD_ASSERT(monitor->users == 1)
-				monitor->owner = 0;
-				monitor->users = 0;
-				_ILMonitorRelease(&(monitor->monitor));
+	/* Other threads are waiting for the monitor */
+	_ILCriticalSectionEnter(&(_MonitorPool.lock));
 
-				/* Lock the monitor system */
-				_ILCriticalSectionEnter(&(_MonitorPool.lock));
+	if(monitor->users <= 1)
+	{
+		/*
+		 * The other threads gave up waiting in the meantime.
+		 * So move the monitor to the freelist.
+		 */
+		monitor->users = 0;
 
-				_ILMonitorPoolAddListToFreeList(&_MonitorPool,
-												firstMonitor,
-												lastMonitor);
+		/* Clear the monitor location first */
+		ILInterlockedStoreP(monitorLocation,  0);
 
-				/* Unlock the monitor system */
-				_ILCriticalSectionLeave(&(_MonitorPool.lock));
-			}
-		}
-		else
-		{
-			/* Remove me from the monitor users */
-			--(monitor->users);
-			
-			/* Clear the owner and owner private data */
-			monitor->owner = 0;
-			monitor->enterCount = 0;
+		_ILCriticalSectionLeave(&(_MonitorPool.lock));
 
-			_ILCriticalSectionLeave(&(_MonitorPool.lock));
-			_ILMonitorExit(&(monitor->monitor));
-		}
+		_ILMonitorCacheMonitor(thread, monitor);
 	}
 	else
 	{
-		/* Simpy decrement the enter count */
-		--(monitor->enterCount);
+		/* Remove me from the monitor users */
+		ILInterlockedDecrementI4(&(monitor->users));
+
+		/* Clear the owner and owner private data */
+		monitor->owner = 0;
+		monitor->enterCount = 0;
+
+		_ILCriticalSectionLeave(&(_MonitorPool.lock));
+		_ILMonitorExit(&(monitor->monitor));
 	}
 	return IL_THREAD_OK;
 }
@@ -0,0 +1,398 @@
+/*
+ * pollset.c - Persistent sets of sockets that are polled for readiness.
+ *
+ * Copyright (C) 2010  Southern Storm Software, Pty Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "il_sysio.h"
+#include "il_thread.h"
+#include "il_errno.h"
+
+#ifdef IL_CONFIG_NETWORKING
+
+#if defined(HAVE_SYS_EPOLL_H) && defined(HAVE_EPOLL_CREATE) && \
+	!defined(IL_WIN32_NATIVE)
+#define	IL_POLLSET_EPOLL	1
+#include <sys/epoll.h>
+#ifdef HAVE_FCNTL_H
+#include <fcntl.h>
+#endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#include <errno.h>
+#endif
+
+#ifdef	__cplusplus
+extern	"C" {
+#endif
+
+/*
+
+A poll set keeps its sockets registered between waits, so a wait costs
+time in proportion to the number of sockets that are ready rather than
+the number that are registered.  On Linux this maps directly onto
+"epoll".  Elsewhere, the set keeps its own list of sockets and waits
+on them with "ILSysIOSocketSelect", which gives the same interface
+without the scalability.
+
+Each socket has one registration in a set, and adding a socket that
+is already registered replaces its events.  A registration that is
+made with IL_SYSIO_POLL_ONESHOT is disarmed after it is reported once,
+so that with several threads waiting on the set only one of them sees
+the event.  It is re-armed by adding the socket again.
+
+*/
+
+#ifdef IL_POLLSET_EPOLL
+
+/*
+ * Maximum number of events to collect with one "epoll_wait".
+ */
+#define	IL_POLLSET_MAX_EVENTS	64
+
+struct _tagILSysIOPollSet
+{
+	int				epfd;
+};
+
+ILSysIOPollSet *ILSysIOPollSetCreate(void)
+{
+	ILSysIOPollSet *set;
+	if((set = (ILSysIOPollSet *)ILMalloc(sizeof(ILSysIOPollSet))) == 0)
+	{
+		return 0;
+	}
+	if((set->epfd = epoll_create(IL_POLLSET_MAX_EVENTS)) < 0)
+	{
+		ILFree(set);
+		return 0;
+	}
+#if defined(HAVE_FCNTL_H) && defined(FD_CLOEXEC)
+	fcntl(set->epfd, F_SETFD, FD_CLOEXEC);
+#endif
+	return set;
+}
+
+void ILSysIOPollSetDestroy(ILSysIOPollSet *set)
+{
+	close(set->epfd);
+	ILFree(set);
+}
+
+int ILSysIOPollSetAdd(ILSysIOPollSet *set, ILSysIOHandle sockfd,
+					  ILInt32 events)
+{
+	struct epoll_event event;
+	ILMemZero(&event, sizeof(event));
+	if((events & IL_SYSIO_POLL_READ) != 0)
+	{
+		event.events |= EPOLLIN;
+	}
+	if((events & IL_SYSIO_POLL_WRITE) != 0)
+	{
+		event.events |= EPOLLOUT;
+	}
+	if((events & IL_SYSIO_POLL_ERROR) != 0)
+	{
+		event.events |= EPOLLERR | EPOLLHUP;
+	}
+	if((events & IL_SYSIO_POLL_ONESHOT) != 0)
+	{
+		event.events |= EPOLLONESHOT;
+	}
+	event.data.fd = (int)(ILNativeInt)sockfd;
+	if(epoll_ctl(set->epfd, EPOLL_CTL_ADD, event.data.fd, &event) == 0)
+	{
+		return 1;
+	}
+	if(errno == EEXIST)
+	{
+		return (epoll_ctl(set->epfd, EPOLL_CTL_MOD,
+						  event.data.fd, &event) == 0);
+	}
+	return 0;
+}
+
+int ILSysIOPollSetRemove(ILSysIOPollSet *set, ILSysIOHandle sockfd)
+{
+	/* Kernels before 2.6.9 require a non-NULL event for EPOLL_CTL_DEL */
+	struct epoll_event event;
+	ILMemZero(&event, sizeof(event));
+	return (epoll_ctl(set->epfd, EPOLL_CTL_DEL,
+					  (int)(ILNativeInt)sockfd, &event) == 0);
+}
+
+ILInt32 ILSysIOPollSetWait(ILSysIOPollSet *set, ILSysIOHandle *handles,
+						   ILInt32 *events, ILInt32 maxEvents,
+						   ILInt64 timeout)
+{
+	struct epoll_event ready[IL_POLLSET_MAX_EVENTS];
+	int msecs, result, index;
+	ILInt32 fired;
+
+	/* Convert the timeout into milliseconds, rounding up so that
+	   short timeouts don't turn into busy waits */
+	if(timeout < 0)
+	{
+		msecs = -1;
+	}
+	else if(timeout >= (ILInt64)0x7FFFFFFF * (ILInt64)1000)
+	{
+		msecs = 0x7FFFFFFF;
+	}
+	else
+	{
+		msecs = (int)((timeout + 999) / 1000);
+	}
+	if(maxEvents > IL_POLLSET_MAX_EVENTS)
+	{
+		maxEvents = IL_POLLSET_MAX_EVENTS;
+	}
+
+	/* Wait for the events.  A signal ends the wait early so that the
+	   caller has a chance to notice thread aborts */
+	result = epoll_wait(set->epfd, ready, (int)maxEvents, msecs);
+	if(result < 0)
+	{
+		return (errno == EINTR ? 0 : -1);
+	}
+
+	/* Copy out the handles and the events that fired on them */
+	for(index = 0; index < result; ++index)
+	{
+		fired = 0;
+		if((ready[index].events & (EPOLLIN | EPOLLPRI)) != 0)
+		{
+			fired |= IL_SYSIO_POLL_READ;
+		}
+		if((ready[index].events & EPOLLOUT) != 0)
+		{
+			fired |= IL_SYSIO_POLL_WRITE;
+		}
+		if((ready[index].events & (EPOLLERR | EPOLLHUP)) != 0)
+		{
+			fired |= IL_SYSIO_POLL_ERROR;
+		}
+		handles[index] = (ILSysIOHandle)(ILNativeInt)(ready[index].data.fd);
+		events[index] = fired;
+	}
+	return (ILInt32)result;
+}
+
+#else /* !IL_POLLSET_EPOLL */
+
+/*
+ * A registered socket in a set that is waited on with "select".
+ */
+typedef struct
+{
+	ILSysIOHandle	handle;
+	ILInt32			events;
+} ILPollSetEntry;
+
+struct _tagILSysIOPollSet
+{
+	ILMutex		   *lock;
+	ILPollSetEntry *entries;
+	ILInt32			numEntries;
+	ILInt32			maxEntries;
+	ILInt32			next;
+};
+
+ILSysIOPollSet *ILSysIOPollSetCreate(void)
+{
+	ILSysIOPollSet *set;
+	if((set = (ILSysIOPollSet *)ILCalloc(1, sizeof(ILSysIOPollSet))) == 0)
+	{
+		return 0;
+	}
+	if((set->lock = ILMutexCreate()) == 0)
+	{
+		ILFree(set);
+		return 0;
+	}
+	return set;
+}
+
+void ILSysIOPollSetDestroy(ILSysIOPollSet *set)
+{
+	ILMutexDestroy(set->lock);
+	if(set->entries)
+	{
+		ILFree(set->entries);
+	}
+	ILFree(set);
+}
+
+/*
+ * Find the entry for a socket.  Returns -1 if not registered.
+ */
+static ILInt32 FindEntry(ILSysIOPollSet *set, ILSysIOHandle sockfd)
+{
+	ILInt32 index;
+	for(index = 0; index < set->numEntries; ++index)
+	{
+		if(set->entries[index].handle == sockfd)
+		{
+			return index;
+		}
+	}
+	return -1;
+}
+
+int ILSysIOPollSetAdd(ILSysIOPollSet *set, ILSysIOHandle sockfd,
+					  ILInt32 events)
+{
+	ILPollSetEntry *newEntries;
+	ILInt32 index;
+
+	ILMutexLock(set->lock);
+	index = FindEntry(set, sockfd);
+	if(index < 0)
+	{
+		if(set->numEntries >= set->maxEntries)
+		{
+			newEntries = (ILPollSetEntry *)ILRealloc
+				(set->entries, sizeof(ILPollSetEntry) *
+							   (set->maxEntries + 32));
+			if(!newEntries)
+			{
+				ILMutexUnlock(set->lock);
+				return 0;
+			}
+			set->entries = newEntries;
+			set->maxEntries += 32;
+		}
+		index = (set->numEntries)++;
+		set->entries[index].handle = sockfd;
+	}
+	set->entries[index].events = events;
+	ILMutexUnlock(set->lock);
+	return 1;
+}
+
+int ILSysIOPollSetRemove(ILSysIOPollSet *set, ILSysIOHandle sockfd)
+{
+	ILInt32 index;
+	ILMutexLock(set->lock);
+	index = FindEntry(set, sockfd);
+	if(index >= 0)
+	{
+		set->entries[index] = set->entries[--(set->numEntries)];
+	}
+	ILMutexUnlock(set->lock);
+	return (index >= 0);
+}
+
+ILInt32 ILSysIOPollSetWait(ILSysIOPollSet *set, ILSysIOHandle *handles,
+						   ILInt32 *events, ILInt32 maxEvents,
+						   ILInt64 timeout)
+{
+	ILSysIOHandle *readfds;
+	ILSysIOHandle *writefds;
+	ILSysIOHandle *exceptfds;
+	ILInt32 num, index, entry, fired, result;
+
+	/* Take a snapshot of the armed sockets.  Changes that are made
+	   during the wait take effect on the next call */
+	ILMutexLock(set->lock);
+	num = set->numEntries;
+	readfds = (ILSysIOHandle *)ILMalloc(sizeof(ILSysIOHandle) * 3 * (num + 1));
+	if(!readfds)
+	{
+		ILMutexUnlock(set->lock);
+		return -1;
+	}
+	writefds = readfds + num + 1;
+	exceptfds = writefds + num + 1;
+	for(index = 0; index < num; ++index)
+	{
+		entry = set->entries[index].events;
+		readfds[index] = ((entry & IL_SYSIO_POLL_READ) != 0 ?
+							set->entries[index].handle : ILSysIOHandle_Invalid);
+		writefds[index] = ((entry & IL_SYSIO_POLL_WRITE) != 0 ?
+							set->entries[index].handle : ILSysIOHandle_Invalid);
+		exceptfds[index] = ((entry & IL_SYSIO_POLL_ERROR) != 0 ?
+							set->entries[index].handle : ILSysIOHandle_Invalid);
+	}
+	ILMutexUnlock(set->lock);
+
+	/* Wait for something to happen */
+	result = ILSysIOSocketSelect((ILSysIOHandle **)readfds, num,
+								 (ILSysIOHandle **)writefds, num,
+								 (ILSysIOHandle **)exceptfds, num, timeout);
+	if(result <= 0)
+	{
+		ILFree(readfds);
+		return result;
+	}
+
+	/* Collect the sockets that fired, starting after the last one
+	   that was reported so that busy sockets don't starve the rest */
+	ILMutexLock(set->lock);
+	result = 0;
+	for(index = 0; index < num && result < maxEvents; ++index)
+	{
+		entry = (set->next + index) % num;
+		fired = 0;
+		if(readfds[entry] != ILSysIOHandle_Invalid)
+		{
+			fired |= IL_SYSIO_POLL_READ;
+		}
+		if(writefds[entry] != ILSysIOHandle_Invalid)
+		{
+			fired |= IL_SYSIO_POLL_WRITE;
+		}
+		if(exceptfds[entry] != ILSysIOHandle_Invalid)
+		{
+			fired |= IL_SYSIO_POLL_ERROR;
+		}
+		if(!fired)
+		{
+			continue;
+		}
+
+		/* Skip sockets that were removed or disarmed by another
+		   thread during the wait, and disarm one-shot sockets */
+		handles[result] = (fired & IL_SYSIO_POLL_READ) ? readfds[entry] :
+						  (fired & IL_SYSIO_POLL_WRITE) ? writefds[entry] :
+						  exceptfds[entry];
+		if((entry = FindEntry(set, handles[result])) < 0 ||
+		   (fired &= set->entries[entry].events) == 0)
+		{
+			continue;
+		}
+		if((set->entries[entry].events & IL_SYSIO_POLL_ONESHOT) != 0)
+		{
+			set->entries[entry].events = 0;
+		}
+		events[result++] = fired;
+	}
+	set->next = (num > 0 ? (set->next + index) % num : 0);
+	ILMutexUnlock(set->lock);
+	ILFree(readfds);
+	return result;
+}
+
+#endif /* !IL_POLLSET_EPOLL */
+
+#ifdef	__cplusplus
+};
+#endif
+
+#endif /* IL_CONFIG_NETWORKING */
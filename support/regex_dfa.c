@@ -0,0 +1,1642 @@
+/*
+ * regex_dfa.c - Lazy DFA matcher for POSIX extended regular expressions.
+ *
+ * Copyright (C) 2010  Southern Storm Software, Pty Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+
+This matcher handles the subset of POSIX extended regular expressions
+that describe regular languages: everything except back-references and
+the GNU word boundary and buffer anchors.  Patterns outside that subset
+are rejected by "ILRegexDFACreate", and the caller uses "regexec".
+
+The pattern is parsed into a tree, which is compiled into two Thompson
+NFA programs: one for the pattern and one for the reversed pattern.
+DFA states are sets of NFA instructions, which are created lazily the
+first time that a transition is taken, and then cached.  Characters
+that cannot be distinguished by the pattern share a transition slot.
+
+"^" and "$" are handled as assertions on the previous and next input
+characters.  Assertions on the previous character are resolved when a
+state is created, because the previous character is part of the state.
+Assertions on the next character are kept in the state, and followed
+when the next character (or the end of the input) is seen.
+
+To report the leftmost-longest match without sub-expressions, the
+input is scanned forwards to see if there is any match at all.  If
+there is, the reversed program is run backwards over the input to find
+the leftmost position where a match starts, and then the forward
+program is run from there to find the longest match.  If the pattern
+starts with a literal string, the occurrences of that string are used
+as the only candidate start positions instead.  Otherwise, the
+unanchored scans skip over characters that cannot start a match,
+which is how "regexec" uses its fastmap.  When only a few characters
+can start a match, the skip is done with "ILUTF16IndexOfAny".
+
+Only 7-bit ASCII input is handled.  Other characters are converted to
+multi-byte sequences by the callers of "regexec", so "ILRegexDFAExec"
+reports them as needing the fallback.  The input is truncated at the
+first NUL, just like the C strings that "regexec" is given.
+
+The state cache is shared between threads.  Transitions are read
+without locking, and new states are created under a mutex.
+
+There is no native code generation: the lazily built transition
+table already costs only a table lookup per input character.
+
+*/
+
+#include "il_system.h"
+#include "il_utils.h"
+#include "il_thread.h"
+#include "il_regex.h"
+#include "interlocked.h"
+#include <ctype.h>
+
+#ifdef	__cplusplus
+extern	"C" {
+#endif
+
+/*
+ * Limits that keep the NFA programs and the state cache bounded.
+ */
+#define	RE_MAX_NODES		8192
+#define	RE_MAX_REPEAT		255
+#define	RE_MAX_STATES		2048
+
+/*
+ * Maximum number of characters that can leave the skip state for the
+ * skip to be done with "ILUTF16IndexOfAny" instead of a table lookup
+ * on every character.
+ */
+#define	RE_MAX_STOP_CHARS	4
+
+/*
+ * Parse tree node types.
+ */
+#define	RE_NODE_SET			0
+#define	RE_NODE_CAT			1
+#define	RE_NODE_ALT			2
+#define	RE_NODE_STAR		3
+#define	RE_NODE_PLUS		4
+#define	RE_NODE_QUEST		5
+#define	RE_NODE_EMPTY		6
+#define	RE_NODE_BOL			7
+#define	RE_NODE_EOL			8
+
+/*
+ * Character sets cover the 7-bit ASCII range.
+ */
+typedef ILUInt32 RESet[4];
+#define	RESetAdd(set,ch)	((set)[(ch) >> 5] |= (((ILUInt32)1) << ((ch) & 31)))
+#define	RESetHas(set,ch)	(((set)[(ch) >> 5] & (((ILUInt32)1) << ((ch) & 31))) != 0)
+
+/*
+ * Parse tree node.
+ */
+typedef struct _tagRENode RENode;
+struct _tagRENode
+{
+	int			type;
+	int			set;
+	RENode	   *left;
+	RENode	   *right;
+	RENode	   *nextAlloc;
+};
+
+/*
+ * NFA instruction opcodes.  "PREV" assertions depend upon the character
+ * before the current position, and "NEXT" assertions upon the character
+ * after it.  In the reversed program, "^" and "$" swap roles.
+ */
+#define	RE_OP_SET			0
+#define	RE_OP_SPLIT			1
+#define	RE_OP_JMP			2
+#define	RE_OP_PREV			3
+#define	RE_OP_NEXT			4
+#define	RE_OP_MATCH			5
+
+/*
+ * NFA instruction.
+ */
+typedef struct
+{
+	int			op;
+	int			x;
+	int			y;
+
+} REInst;
+
+/*
+ * Flags for DFA states.
+ */
+#define	RE_STATE_MATCH		1	/* Match at this position */
+#define	RE_STATE_MATCH_NEXT	2	/* Match if the next assertion holds */
+#define	RE_STATE_PREV		4	/* The previous assertion holds */
+
+/*
+ * DFA state.  "next" has one slot per character class, and "pcs"
+ * holds the sorted NFA instructions that make up the state.
+ */
+typedef struct _tagREState REState;
+struct _tagREState
+{
+	REState		   *hashNext;
+	unsigned long	hash;
+	int				flags;
+	int				numPcs;
+	int			   *pcs;
+	REState		   *next[1];
+};
+
+/*
+ * Cache of DFA states for one way of running a program.  Unanchored
+ * caches also record the characters that can leave the start state,
+ * so that the rest can be skipped without stepping the DFA.
+ */
+typedef struct
+{
+	REInst		   *prog;
+	int				unanchored;
+	REState		   *start[2];
+	REState		   *skip;
+	unsigned char	stops[128];
+	int				numStops;
+	unsigned short	stopChars[RE_MAX_STOP_CHARS];
+	REState		  **buckets;
+	int				numBuckets;
+	int				numStates;
+
+} RECache;
+
+/*
+ * Compiled matcher.
+ */
+struct _tagILRegexDFA
+{
+	int				cflags;
+	RESet		   *sets;
+	int				numSets;
+	unsigned char	classMap[128];
+	unsigned char	classChar[128];
+	int				numClasses;
+	REInst		   *forward;
+	REInst		   *reverse;
+	int				progLen;
+	RECache			anchored;
+	RECache			unanchored;
+	RECache			reverseUnanchored;
+	unsigned short *prefix;
+	long			prefixLen;
+	ILMutex		   *lock;
+
+	/* Scratch space for building states, protected by "lock" */
+	int			   *marks;
+	int			   *inSet;
+	int			   *stack;
+	int			   *list;
+	int			   *targets;
+	int				generation;
+};
+
+/*
+ * Parser state.
+ */
+typedef struct
+{
+	const char	   *posn;
+	int				cflags;
+	RENode		   *nodes;
+	int				numNodes;
+	RESet		   *sets;
+	int				numSets;
+	int				maxSets;
+	int				error;
+
+} REParser;
+
+/*
+ * Allocate a parse tree node.
+ */
+static RENode *NewNode(REParser *parser, int type,
+					   RENode *left, RENode *right)
+{
+	RENode *node;
+	if(parser->error || parser->numNodes >= RE_MAX_NODES ||
+	   (node = (RENode *)ILMalloc(sizeof(RENode))) == 0)
+	{
+		parser->error = 1;
+		return 0;
+	}
+	node->type = type;
+	node->set = -1;
+	node->left = left;
+	node->right = right;
+	node->nextAlloc = parser->nodes;
+	parser->nodes = node;
+	++(parser->numNodes);
+	return node;
+}
+
+/*
+ * Allocate a character set node.
+ */
+static RENode *NewSetNode(REParser *parser, const RESet set)
+{
+	RENode *node;
+	RESet *newSets;
+	if(parser->numSets >= parser->maxSets)
+	{
+		newSets = (RESet *)ILRealloc(parser->sets, sizeof(RESet) *
+									 (parser->maxSets + 32));
+		if(!newSets)
+		{
+			parser->error = 1;
+			return 0;
+		}
+		parser->sets = newSets;
+		parser->maxSets += 32;
+	}
+	node = NewNode(parser, RE_NODE_SET, 0, 0);
+	if(node)
+	{
+		ILMemCpy(parser->sets[parser->numSets], set, sizeof(RESet));
+		node->set = (parser->numSets)++;
+	}
+	return node;
+}
+
+/*
+ * Add a character to a set, folding case if necessary.
+ */
+static void AddChar(REParser *parser, RESet set, int ch)
+{
+	RESetAdd(set, ch);
+	if((parser->cflags & REG_ICASE) != 0)
+	{
+		RESetAdd(set, tolower(ch));
+		RESetAdd(set, toupper(ch));
+	}
+}
+
+/*
+ * Add a named character class to a set.  Returns zero if unknown.
+ */
+static int AddClass(REParser *parser, RESet set, const char *name, int len)
+{
+	static const char * const names[] =
+		{"alpha", "upper", "lower", "digit", "xdigit", "space",
+		 "print", "punct", "graph", "cntrl", "blank", "alnum"};
+	int which, ch, match;
+	for(which = 0; which < 12; ++which)
+	{
+		if(strlen(names[which]) == (size_t)len &&
+		   !strncmp(names[which], name, len))
+		{
+			break;
+		}
+	}
+	if(which >= 12)
+	{
+		return 0;
+	}
+	for(ch = 1; ch < 128; ++ch)
+	{
+		switch(which)
+		{
+			case 0:		match = isalpha(ch); break;
+			case 1:		match = isupper(ch); break;
+			case 2:		match = islower(ch); break;
+			case 3:		match = isdigit(ch); break;
+			case 4:		match = isxdigit(ch); break;
+			case 5:		match = isspace(ch); break;
+			case 6:		match = isprint(ch); break;
+			case 7:		match = ispunct(ch); break;
+			case 8:		match = isgraph(ch); break;
+			case 9:		match = iscntrl(ch); break;
+			case 10:	match = (ch == ' ' || ch == '\t'); break;
+			default:	match = isalnum(ch); break;
+		}
+		if(match)
+		{
+			AddChar(parser, set, ch);
+		}
+	}
+	return 1;
+}
+
+/*
+ * Parse a bracket expression, just after the "[".
+ */
+static RENode *ParseBracket(REParser *parser)
+{
+	const char *p = parser->posn;
+	RESet set = {0, 0, 0, 0};
+	int negate = 0;
+	int first = 1;
+	int lo, hi, ch;
+	const char *name;
+
+	if(*p == '^')
+	{
+		negate = 1;
+		++p;
+	}
+	for(;;)
+	{
+		lo = (unsigned char)(*p);
+		if(lo == '\0' || lo >= 128)
+		{
+			parser->error = 1;
+			return 0;
+		}
+		if(lo == ']' && !first)
+		{
+			++p;
+			break;
+		}
+		first = 0;
+		if(lo == '[' && (p[1] == '.' || p[1] == '='))
+		{
+			/* Collating elements and equivalence classes */
+			parser->error = 1;
+			return 0;
+		}
+		if(lo == '[' && p[1] == ':')
+		{
+			name = p + 2;
+			p = name;
+			while(*p != '\0' && !(p[0] == ':' && p[1] == ']'))
+			{
+				++p;
+			}
+			if(*p == '\0' || !AddClass(parser, set, name, (int)(p - name)))
+			{
+				parser->error = 1;
+				return 0;
+			}
+			p += 2;
+			continue;
+		}
+		++p;
+		if(*p == '-' && p[1] != ']' && p[1] != '\0')
+		{
+			hi = (unsigned char)(p[1]);
+			if(hi >= 128 || hi == '[' || hi < lo)
+			{
+				parser->error = 1;
+				return 0;
+			}
+			for(ch = lo; ch <= hi; ++ch)
+			{
+				AddChar(parser, set, ch);
+			}
+			p += 2;
+		}
+		else
+		{
+			AddChar(parser, set, lo);
+		}
+	}
+	parser->posn = p;
+
+	/* Invert the set if necessary.  NUL is never part of the input */
+	if(negate)
+	{
+		set[0] = ~(set[0]);
+		set[1] = ~(set[1]);
+		set[2] = ~(set[2]);
+		set[3] = ~(set[3]);
+		if((parser->cflags & REG_NEWLINE) != 0)
+		{
+			set['\n' >> 5] &= ~(((ILUInt32)1) << ('\n' & 31));
+		}
+	}
+	set[0] &= ~((ILUInt32)1);
+	return NewSetNode(parser, set);
+}
+
+/*
+ * Make a deep copy of a parse tree.
+ */
+static RENode *CopyNode(REParser *parser, RENode *node)
+{
+	RENode *copy;
+	if(!node || parser->error)
+	{
+		return 0;
+	}
+	copy = NewNode(parser, node->type, CopyNode(parser, node->left),
+				   CopyNode(parser, node->right));
+	if(copy)
+	{
+		copy->set = node->set;
+	}
+	return copy;
+}
+
+/*
+ * Forward declaration.
+ */
+static RENode *ParseAlt(REParser *parser, int depth);
+
+/*
+ * Parse an atom.
+ */
+static RENode *ParseAtom(REParser *parser, int depth)
+{
+	RESet set = {0, 0, 0, 0};
+	RENode *node;
+	int ch = (unsigned char)(*(parser->posn));
+	int posn;
+
+	++(parser->posn);
+	switch(ch)
+	{
+		case '(':
+		{
+			node = ParseAlt(parser, depth + 1);
+			if(*(parser->posn) != ')')
+			{
+				parser->error = 1;
+				return 0;
+			}
+			++(parser->posn);
+			return node;
+		}
+		/* Not reached */
+
+		case '^':	return NewNode(parser, RE_NODE_BOL, 0, 0);
+		case '$':	return NewNode(parser, RE_NODE_EOL, 0, 0);
+
+		case '.':
+		{
+			for(posn = 1; posn < 128; ++posn)
+			{
+				if(posn != '\n' || (parser->cflags & REG_NEWLINE) == 0)
+				{
+					RESetAdd(set, posn);
+				}
+			}
+			return NewSetNode(parser, set);
+		}
+		/* Not reached */
+
+		case '[':	return ParseBracket(parser);
+
+		case '\\':
+		{
+			ch = (unsigned char)(*(parser->posn));
+			++(parser->posn);
+			if(ch == 'w' || ch == 'W')
+			{
+				/* GNU word character classes */
+				for(posn = 1; posn < 128; ++posn)
+				{
+					if((isalnum(posn) || posn == '_') == (ch == 'w'))
+					{
+						RESetAdd(set, posn);
+					}
+				}
+				return NewSetNode(parser, set);
+			}
+			else if(ch == '\0' || ch >= 128 || isalnum(ch) ||
+					ch == '<' || ch == '>' || ch == '`' || ch == '\'')
+			{
+				/* Back-references, word boundaries, and buffer anchors */
+				parser->error = 1;
+				return 0;
+			}
+			AddChar(parser, set, ch);
+			return NewSetNode(parser, set);
+		}
+		/* Not reached */
+
+		case '\0': case ')': case '*': case '+': case '?': case '{':
+		{
+			parser->error = 1;
+			return 0;
+		}
+		/* Not reached */
+
+		default:
+		{
+			if(ch >= 128)
+			{
+				parser->error = 1;
+				return 0;
+			}
+			AddChar(parser, set, ch);
+			return NewSetNode(parser, set);
+		}
+		/* Not reached */
+	}
+}
+
+/*
+ * Parse a decimal number within an interval.  Returns -1 if none.
+ */
+static int ParseNumber(REParser *parser)
+{
+	int value = -1;
+	while(*(parser->posn) >= '0' && *(parser->posn) <= '9')
+	{
+		value = (value < 0 ? 0 : value * 10) + (*(parser->posn) - '0');
+		if(value > RE_MAX_REPEAT)
+		{
+			parser->error = 1;
+			return -1;
+		}
+		++(parser->posn);
+	}
+	return value;
+}
+
+/*
+ * Expand an interval "{min,max}" into copies of an atom.
+ * "max" is -1 if there is no upper bound.
+ */
+static RENode *ExpandInterval(REParser *parser, RENode *atom, int min, int max)
+{
+	RENode *result = 0;
+	RENode *item;
+	int count;
+	for(count = 0; count < min || (max >= 0 && count < max); ++count)
+	{
+		item = (count == 0 ? atom : CopyNode(parser, atom));
+		if(count >= min)
+		{
+			item = NewNode(parser, RE_NODE_QUEST, item, 0);
+		}
+		result = (result ? NewNode(parser, RE_NODE_CAT, result, item) : item);
+	}
+	if(max < 0)
+	{
+		item = (min == 0 ? atom : CopyNode(parser, atom));
+		item = NewNode(parser, RE_NODE_STAR, item, 0);
+		result = (result ? NewNode(parser, RE_NODE_CAT, result, item) : item);
+	}
+	if(!result)
+	{
+		result = NewNode(parser, RE_NODE_EMPTY, 0, 0);
+	}
+	return result;
+}
+
+/*
+ * Parse an atom and any repetition operators that follow it.
+ */
+static RENode *ParseRepeat(REParser *parser, int depth)
+{
+	RENode *node = ParseAtom(parser, depth);
+	int min, max;
+	while(!(parser->error))
+	{
+		if((node->type == RE_NODE_BOL || node->type == RE_NODE_EOL) &&
+		   strchr("*+?{", *(parser->posn)) != 0 && *(parser->posn) != '\0')
+		{
+			/* Repeated anchors are context-dependent in GNU regex */
+			parser->error = 1;
+			return 0;
+		}
+		switch(*(parser->posn))
+		{
+			case '*':
+			{
+				node = NewNode(parser, RE_NODE_STAR, node, 0);
+			}
+			break;
+
+			case '+':
+			{
+				node = NewNode(parser, RE_NODE_PLUS, node, 0);
+			}
+			break;
+
+			case '?':
+			{
+				node = NewNode(parser, RE_NODE_QUEST, node, 0);
+			}
+			break;
+
+			case '{':
+			{
+				++(parser->posn);
+				min = ParseNumber(parser);
+				max = min;
+				if(*(parser->posn) == ',')
+				{
+					++(parser->posn);
+					max = ParseNumber(parser);
+				}
+				if(min < 0 || *(parser->posn) != '}' ||
+				   (max >= 0 && max < min))
+				{
+					parser->error = 1;
+					return 0;
+				}
+				node = ExpandInterval(parser, node, min, max);
+			}
+			break;
+
+			default:	return node;
+		}
+		++(parser->posn);
+	}
+	return 0;
+}
+
+/*
+ * Parse a concatenation of atoms.
+ */
+static RENode *ParseCat(REParser *parser, int depth)
+{
+	RENode *node = 0;
+	RENode *item;
+	while(!(parser->error) && *(parser->posn) != '\0' &&
+	      *(parser->posn) != '|' && *(parser->posn) != ')')
+	{
+		item = ParseRepeat(parser, depth);
+		node = (node ? NewNode(parser, RE_NODE_CAT, node, item) : item);
+	}
+	if(!node)
+	{
+		node = NewNode(parser, RE_NODE_EMPTY, 0, 0);
+	}
+	return node;
+}
+
+/*
+ * Parse a list of alternatives.
+ */
+static RENode *ParseAlt(REParser *parser, int depth)
+{
+	RENode *node;
+	if(depth > 64)
+	{
+		parser->error = 1;
+		return 0;
+	}
+	node = ParseCat(parser, depth);
+	while(!(parser->error) && *(parser->posn) == '|')
+	{
+		++(parser->posn);
+		node = NewNode(parser, RE_NODE_ALT, node, ParseCat(parser, depth));
+	}
+	return node;
+}
+
+/*
+ * Get the number of NFA instructions that are needed for a node.
+ */
+static int ProgramSize(RENode *node)
+{
+	switch(node->type)
+	{
+		case RE_NODE_SET:	return 1;
+		case RE_NODE_CAT:	return ProgramSize(node->left) +
+								   ProgramSize(node->right);
+		case RE_NODE_ALT:	return ProgramSize(node->left) +
+								   ProgramSize(node->right) + 2;
+		case RE_NODE_STAR:	return ProgramSize(node->left) + 2;
+		case RE_NODE_PLUS:	return ProgramSize(node->left) + 1;
+		case RE_NODE_QUEST:	return ProgramSize(node->left) + 1;
+		case RE_NODE_EMPTY:	return 0;
+	}
+	return 1;
+}
+
+/*
+ * Emit the NFA instructions for a node.  Returns the next pc.
+ */
+static int Emit(REInst *prog, int pc, RENode *node, int reverse)
+{
+	int split, jump;
+	switch(node->type)
+	{
+		case RE_NODE_SET:
+		{
+			prog[pc].op = RE_OP_SET;
+			prog[pc].x = node->set;
+			++pc;
+		}
+		break;
+
+		case RE_NODE_CAT:
+		{
+			if(reverse)
+			{
+				pc = Emit(prog, pc, node->right, reverse);
+				pc = Emit(prog, pc, node->left, reverse);
+			}
+			else
+			{
+				pc = Emit(prog, pc, node->left, reverse);
+				pc = Emit(prog, pc, node->right, reverse);
+			}
+		}
+		break;
+
+		case RE_NODE_ALT:
+		{
+			split = pc++;
+			prog[split].op = RE_OP_SPLIT;
+			prog[split].x = pc;
+			pc = Emit(prog, pc, node->left, reverse);
+			jump = pc++;
+			prog[split].y = pc;
+			pc = Emit(prog, pc, node->right, reverse);
+			prog[jump].op = RE_OP_JMP;
+			prog[jump].x = pc;
+		}
+		break;
+
+		case RE_NODE_STAR:
+		{
+			split = pc++;
+			prog[split].op = RE_OP_SPLIT;
+			prog[split].x = pc;
+			pc = Emit(prog, pc, node->left, reverse);
+			prog[pc].op = RE_OP_JMP;
+			prog[pc].x = split;
+			++pc;
+			prog[split].y = pc;
+		}
+		break;
+
+		case RE_NODE_PLUS:
+		{
+			split = pc;
+			pc = Emit(prog, pc, node->left, reverse);
+			prog[pc].op = RE_OP_SPLIT;
+			prog[pc].x = split;
+			prog[pc].y = pc + 1;
+			++pc;
+		}
+		break;
+
+		case RE_NODE_QUEST:
+		{
+			split = pc++;
+			prog[split].op = RE_OP_SPLIT;
+			prog[split].x = pc;
+			pc = Emit(prog, pc, node->left, reverse);
+			prog[split].y = pc;
+		}
+		break;
+
+		case RE_NODE_EMPTY:		break;
+
+		case RE_NODE_BOL:
+		{
+			prog[pc].op = (reverse ? RE_OP_NEXT : RE_OP_PREV);
+			++pc;
+		}
+		break;
+
+		case RE_NODE_EOL:
+		{
+			prog[pc].op = (reverse ? RE_OP_PREV : RE_OP_NEXT);
+			++pc;
+		}
+		break;
+	}
+	return pc;
+}
+
+/*
+ * Compile a parse tree into an NFA program.
+ */
+static REInst *Compile(RENode *node, int size, int reverse)
+{
+	REInst *prog = (REInst *)ILCalloc(size + 1, sizeof(REInst));
+	if(prog)
+	{
+		prog[Emit(prog, 0, node, reverse)].op = RE_OP_MATCH;
+	}
+	return prog;
+}
+
+/*
+ * Extract the literal string that every match starts with.
+ */
+static void FindPrefix(ILRegexDFA *dfa, RENode *node)
+{
+	RENode *list[64];
+	int numList = 0;
+	int posn, ch, found;
+	RESet *set;
+
+	/* Flatten the leading concatenations */
+	while(node->type == RE_NODE_CAT && numList < 63)
+	{
+		list[numList++] = node->right;
+		node = node->left;
+	}
+	list[numList++] = node;
+
+	/* Collect single-character sets from the front */
+	dfa->prefix = (unsigned short *)ILMalloc(numList * sizeof(unsigned short));
+	if(!(dfa->prefix))
+	{
+		return;
+	}
+	while(numList > 0 && list[numList - 1]->type == RE_NODE_SET)
+	{
+		set = &(dfa->sets[list[numList - 1]->set]);
+		found = -1;
+		for(ch = 1; ch < 128; ++ch)
+		{
+			if(RESetHas(*set, ch))
+			{
+				if(found >= 0)
+				{
+					break;
+				}
+				found = ch;
+			}
+		}
+		if(ch < 128 || found < 0)
+		{
+			break;
+		}
+		posn = (int)(dfa->prefixLen)++;
+		dfa->prefix[posn] = (unsigned short)found;
+		--numList;
+	}
+	if(!(dfa->prefixLen))
+	{
+		ILFree(dfa->prefix);
+		dfa->prefix = 0;
+	}
+}
+
+/*
+ * Divide the characters into classes that every set treats the same.
+ */
+static void ComputeClasses(ILRegexDFA *dfa)
+{
+	unsigned char newMap[128];
+	int remap[256];
+	int set, ch, key, numClasses;
+
+	ILMemZero(dfa->classMap, sizeof(dfa->classMap));
+	dfa->numClasses = 1;
+	for(set = -1; set < dfa->numSets; ++set)
+	{
+		for(key = 0; key < 256; ++key)
+		{
+			remap[key] = -1;
+		}
+		numClasses = 0;
+		for(ch = 0; ch < 128; ++ch)
+		{
+			/* Set -1 separates the newline, which affects the anchors */
+			if(set < 0)
+			{
+				key = dfa->classMap[ch] * 2 + (ch == '\n');
+			}
+			else
+			{
+				key = dfa->classMap[ch] * 2 + RESetHas(dfa->sets[set], ch);
+			}
+			if(remap[key] < 0)
+			{
+				remap[key] = numClasses++;
+			}
+			newMap[ch] = (unsigned char)(remap[key]);
+		}
+		ILMemCpy(dfa->classMap, newMap, sizeof(newMap));
+		dfa->numClasses = numClasses;
+	}
+	for(ch = 127; ch >= 0; --ch)
+	{
+		dfa->classChar[dfa->classMap[ch]] = (unsigned char)ch;
+	}
+}
+
+/*
+ * Initialize a state cache.
+ */
+static int InitCache(RECache *cache, REInst *prog, int unanchored)
+{
+	cache->prog = prog;
+	cache->unanchored = unanchored;
+	cache->start[0] = 0;
+	cache->start[1] = 0;
+	cache->numBuckets = 256;
+	cache->numStates = 0;
+	cache->buckets = (REState **)ILCalloc(cache->numBuckets, sizeof(REState *));
+	return (cache->buckets != 0);
+}
+
+/*
+ * Free a state cache.
+ */
+static void FreeCache(RECache *cache)
+{
+	REState *state, *next;
+	int bucket;
+	if(cache->buckets)
+	{
+		for(bucket = 0; bucket < cache->numBuckets; ++bucket)
+		{
+			state = cache->buckets[bucket];
+			while(state != 0)
+			{
+				next = state->hashNext;
+				ILFree(state);
+				state = next;
+			}
+		}
+		ILFree(cache->buckets);
+	}
+}
+
+/*
+ * Add the closure of an instruction to the scratch list.  Instructions
+ * that consume characters, match, or wait for a "NEXT" assertion are
+ * added to the list.  "marks" records the instructions that were visited.
+ */
+static int AddClosure(ILRegexDFA *dfa, REInst *prog, int pc,
+					  int prevHolds, int nextHolds, int numList)
+{
+	int *stack = dfa->stack;
+	int top = 0;
+	stack[top++] = pc;
+	while(top > 0)
+	{
+		pc = stack[--top];
+		if(dfa->marks[pc] == dfa->generation)
+		{
+			continue;
+		}
+		dfa->marks[pc] = dfa->generation;
+		switch(prog[pc].op)
+		{
+			case RE_OP_JMP:
+			{
+				stack[top++] = prog[pc].x;
+			}
+			break;
+
+			case RE_OP_SPLIT:
+			{
+				stack[top++] = prog[pc].y;
+				stack[top++] = prog[pc].x;
+			}
+			break;
+
+			case RE_OP_PREV:
+			{
+				if(prevHolds)
+				{
+					stack[top++] = pc + 1;
+				}
+			}
+			break;
+
+			case RE_OP_NEXT:
+			{
+				if(nextHolds)
+				{
+					stack[top++] = pc + 1;
+				}
+				else
+				{
+					dfa->list[numList++] = pc;
+				}
+			}
+			break;
+
+			default:
+			{
+				dfa->list[numList++] = pc;
+			}
+			break;
+		}
+	}
+	return numList;
+}
+
+/*
+ * Find or create the state for the instructions in the scratch list.
+ * Returns NULL if the cache is full or out of memory.
+ */
+static REState *MakeState(ILRegexDFA *dfa, RECache *cache,
+						  int numList, int prevHolds)
+{
+	REInst *prog = cache->prog;
+	unsigned long hash;
+	REState *state;
+	int posn, pc, numPcs, flags;
+
+	/* Sort the instructions, using "inSet" to find them in program order */
+	++(dfa->generation);
+	for(posn = 0; posn < numList; ++posn)
+	{
+		dfa->inSet[dfa->list[posn]] = dfa->generation;
+	}
+	numPcs = 0;
+	flags = (prevHolds ? RE_STATE_PREV : 0);
+	hash = (unsigned long)flags;
+	for(pc = 0; pc <= dfa->progLen; ++pc)
+	{
+		if(dfa->inSet[pc] == dfa->generation)
+		{
+			dfa->list[numPcs++] = pc;
+			hash = (hash * 31) + (unsigned long)pc;
+			if(prog[pc].op == RE_OP_MATCH)
+			{
+				flags |= RE_STATE_MATCH;
+			}
+		}
+	}
+
+	/* Look for an existing state */
+	state = cache->buckets[hash % cache->numBuckets];
+	while(state != 0)
+	{
+		if(state->hash == hash && state->numPcs == numPcs &&
+		   (state->flags & RE_STATE_PREV) == (flags & RE_STATE_PREV) &&
+		   !ILMemCmp(state->pcs, dfa->list, numPcs * sizeof(int)))
+		{
+			return state;
+		}
+		state = state->hashNext;
+	}
+	if(cache->numStates >= RE_MAX_STATES)
+	{
+		return 0;
+	}
+
+	/* Determine if following the "NEXT" assertions would reach a match */
+	if(!(flags & RE_STATE_MATCH))
+	{
+		++(dfa->generation);
+		for(posn = 0; posn < numPcs; ++posn)
+		{
+			if(prog[dfa->list[posn]].op == RE_OP_NEXT)
+			{
+				/* The closure is only used for its marks */
+				AddClosure(dfa, prog, dfa->list[posn] + 1,
+						   prevHolds, 1, numPcs);
+			}
+		}
+		if(dfa->marks[dfa->progLen] == dfa->generation)
+		{
+			flags |= RE_STATE_MATCH_NEXT;
+		}
+	}
+
+	/* Create the new state */
+	state = (REState *)ILCalloc(1, sizeof(REState) +
+								dfa->numClasses * sizeof(REState *) +
+								numPcs * sizeof(int));
+	if(!state)
+	{
+		return 0;
+	}
+	state->hash = hash;
+	state->flags = flags;
+	state->numPcs = numPcs;
+	state->pcs = (int *)(&(state->next[dfa->numClasses]));
+	ILMemCpy(state->pcs, dfa->list, numPcs * sizeof(int));
+	state->hashNext = cache->buckets[hash % cache->numBuckets];
+	cache->buckets[hash % cache->numBuckets] = state;
+	++(cache->numStates);
+	return state;
+}
+
+/*
+ * Compute the characters that can start a match in an unanchored cache.
+ */
+static void ComputeStops(ILRegexDFA *dfa, RECache *cache)
+{
+	REInst *prog = cache->prog;
+	int numList, posn, ch;
+
+	/* Collect the characters that the start closure can consume,
+	   assuming that the "PREV" assertions hold to get all of them */
+	++(dfa->generation);
+	numList = AddClosure(dfa, prog, 0, 1, 0, 0);
+	for(posn = 0; posn < numList; ++posn)
+	{
+		if(prog[dfa->list[posn]].op == RE_OP_SET)
+		{
+			for(ch = 1; ch < 128; ++ch)
+			{
+				if(RESetHas(dfa->sets[prog[dfa->list[posn]].x], ch))
+				{
+					cache->stops[ch] = 1;
+				}
+			}
+		}
+	}
+
+	/* Newlines change the context for the anchors */
+	if((dfa->cflags & REG_NEWLINE) != 0)
+	{
+		cache->stops['\n'] = 1;
+	}
+
+	/* A few characters can be found with "ILUTF16IndexOfAny" */
+	cache->numStops = 0;
+	for(ch = 1; ch < 128; ++ch)
+	{
+		if(cache->stops[ch])
+		{
+			if(cache->numStops < RE_MAX_STOP_CHARS)
+			{
+				cache->stopChars[cache->numStops] = (unsigned short)ch;
+			}
+			++(cache->numStops);
+		}
+	}
+}
+
+/*
+ * Create the start states for a cache.  This is done when the
+ * matcher is created, so that the start states can be read without
+ * locking.  The start state without a preceding line boundary is
+ * skipped over in unanchored scans if it cannot match by itself.
+ */
+static int MakeStartStates(ILRegexDFA *dfa, RECache *cache)
+{
+	int prevHolds;
+	for(prevHolds = 0; prevHolds < 2; ++prevHolds)
+	{
+		++(dfa->generation);
+		cache->start[prevHolds] = MakeState
+			(dfa, cache, AddClosure(dfa, cache->prog, 0, prevHolds, 0, 0),
+			 prevHolds);
+		if(!(cache->start[prevHolds]))
+		{
+			return 0;
+		}
+	}
+	if(cache->unanchored && (cache->start[0]->flags &
+							 (RE_STATE_MATCH | RE_STATE_MATCH_NEXT)) == 0)
+	{
+		ComputeStops(dfa, cache);
+		cache->skip = cache->start[0];
+	}
+	return 1;
+}
+
+/*
+ * Compute the transition from a state on a character class.
+ * Returns NULL if the cache is full.
+ */
+static REState *Transition(ILRegexDFA *dfa, RECache *cache,
+						   REState *state, int cls)
+{
+	REInst *prog = cache->prog;
+	int ch = dfa->classChar[cls];
+	int newline = ((dfa->cflags & REG_NEWLINE) != 0 && ch == '\n');
+	int prevHolds = ((state->flags & RE_STATE_PREV) != 0);
+	int numList, numTargets, posn, pc;
+	int *targets;
+	REState *next;
+
+	ILMutexLock(dfa->lock);
+	next = state->next[cls];
+	if(next)
+	{
+		ILMutexUnlock(dfa->lock);
+		return next;
+	}
+
+	/* Collect the instructions in the state, following the "NEXT"
+	   assertions if the character is a newline */
+	++(dfa->generation);
+	numList = 0;
+	for(posn = 0; posn < state->numPcs; ++posn)
+	{
+		pc = state->pcs[posn];
+		if(prog[pc].op == RE_OP_NEXT && newline)
+		{
+			numList = AddClosure(dfa, prog, pc + 1, prevHolds, 1, numList);
+		}
+		else if(dfa->marks[pc] != dfa->generation)
+		{
+			dfa->marks[pc] = dfa->generation;
+			dfa->list[numList++] = pc;
+		}
+	}
+
+	/* Step over the character */
+	targets = dfa->targets;
+	numTargets = 0;
+	for(posn = 0; posn < numList; ++posn)
+	{
+		pc = dfa->list[posn];
+		if(prog[pc].op == RE_OP_SET && RESetHas(dfa->sets[prog[pc].x], ch))
+		{
+			targets[numTargets++] = pc + 1;
+		}
+	}
+
+	/* Build the closure of the targets for the new state */
+	++(dfa->generation);
+	numList = 0;
+	for(posn = 0; posn < numTargets; ++posn)
+	{
+		numList = AddClosure(dfa, prog, targets[posn], newline, 0, numList);
+	}
+	if(cache->unanchored)
+	{
+		numList = AddClosure(dfa, prog, 0, newline, 0, numList);
+	}
+	next = MakeState(dfa, cache, numList, newline);
+	if(next)
+	{
+		ILInterlockedStoreP_Release
+			((void * volatile *)&(state->next[cls]), next);
+	}
+	ILMutexUnlock(dfa->lock);
+	return next;
+}
+
+/*
+ * Get the next state for a character, computing it if necessary.
+ * States are published with release semantics, and everything that
+ * is read through the pointer depends upon it, so a plain load is
+ * enough here.  An acquire barrier on every character would cost
+ * more than the rest of the loop put together.
+ */
+#define	NEXT_STATE(state,ch)	\
+	do { \
+		REState *__next = \
+			*((REState * volatile *)&((state)->next[dfa->classMap[(ch)]])); \
+		if(!__next) \
+		{ \
+			__next = Transition(dfa, cache, (state), dfa->classMap[(ch)]); \
+			if(!__next) \
+			{ \
+				return -2; \
+			} \
+		} \
+		(state) = __next; \
+	} while (0)
+
+/*
+ * Skip forwards to the next character that can leave the skip state.
+ */
+static long SkipForward(RECache *cache, const unsigned short *str,
+						long posn, long len)
+{
+	long found;
+	if(cache->numStops <= RE_MAX_STOP_CHARS)
+	{
+		found = ILUTF16IndexOfAny(str + posn, len - posn,
+								  cache->stopChars, cache->numStops);
+		return (found >= 0 ? posn + found : len);
+	}
+	while(posn < len && !(cache->stops[str[posn]]))
+	{
+		++posn;
+	}
+	return posn;
+}
+
+/*
+ * Skip backwards to the next character that can leave the skip state.
+ */
+static long SkipBackward(RECache *cache, const unsigned short *str, long posn)
+{
+	if(cache->numStops <= RE_MAX_STOP_CHARS)
+	{
+		return ILUTF16LastIndexOfAny(str, posn, cache->stopChars,
+									 cache->numStops) + 1;
+	}
+	while(posn > 0 && !(cache->stops[str[posn - 1]]))
+	{
+		--posn;
+	}
+	return posn;
+}
+
+/*
+ * Run a program forwards from "from".  Returns the position of the
+ * first or last match, -1 if there is no match, or -2 if the cache
+ * is full.
+ */
+static long RunForward(ILRegexDFA *dfa, RECache *cache,
+					   const unsigned short *str, long from, long len,
+					   int eflags, int first)
+{
+	int newline = ((dfa->cflags & REG_NEWLINE) != 0);
+	long lastMatch = -1;
+	long posn = from;
+	int nextHolds;
+	REState *state;
+	REState *skip = cache->skip;
+
+	if(from == 0)
+	{
+		state = cache->start[(eflags & REG_NOTBOL) == 0];
+	}
+	else
+	{
+		state = cache->start[newline && str[from - 1] == '\n'];
+	}
+	for(;;)
+	{
+		if(state == skip)
+		{
+			posn = SkipForward(cache, str, posn, len);
+		}
+		if(state->flags & (RE_STATE_MATCH | RE_STATE_MATCH_NEXT))
+		{
+			if(posn >= len)
+			{
+				nextHolds = ((eflags & REG_NOTEOL) == 0);
+			}
+			else
+			{
+				nextHolds = (newline && str[posn] == '\n');
+			}
+			if((state->flags & RE_STATE_MATCH) != 0 || nextHolds)
+			{
+				lastMatch = posn;
+				if(first)
+				{
+					break;
+				}
+			}
+		}
+		if(posn >= len || (!(state->numPcs) && !(cache->unanchored)))
+		{
+			break;
+		}
+		NEXT_STATE(state, str[posn]);
+		++posn;
+	}
+	return lastMatch;
+}
+
+/*
+ * Run the reversed program backwards over the whole input, and
+ * return the leftmost position that a match starts at, -1 if there
+ * is no match, or -2 if the cache is full.
+ */
+static long RunReverse(ILRegexDFA *dfa, const unsigned short *str,
+					   long len, int eflags)
+{
+	RECache *cache = &(dfa->reverseUnanchored);
+	int newline = ((dfa->cflags & REG_NEWLINE) != 0);
+	long lastMatch = -1;
+	long posn = len;
+	int nextHolds;
+	REState *state;
+	REState *skip = cache->skip;
+
+	state = cache->start[(eflags & REG_NOTEOL) == 0];
+	for(;;)
+	{
+		if(state == skip)
+		{
+			posn = SkipBackward(cache, str, posn);
+		}
+		if(state->flags & (RE_STATE_MATCH | RE_STATE_MATCH_NEXT))
+		{
+			if(posn <= 0)
+			{
+				nextHolds = ((eflags & REG_NOTBOL) == 0);
+			}
+			else
+			{
+				nextHolds = (newline && str[posn - 1] == '\n');
+			}
+			if((state->flags & RE_STATE_MATCH) != 0 || nextHolds)
+			{
+				lastMatch = posn;
+			}
+		}
+		if(posn <= 0)
+		{
+			break;
+		}
+		--posn;
+		NEXT_STATE(state, str[posn]);
+	}
+	return lastMatch;
+}
+
+ILRegexDFA *ILRegexDFACreate(const char *pattern, int cflags)
+{
+	REParser parser;
+	RENode *tree;
+	RENode *node;
+	ILRegexDFA *dfa;
+	int size;
+
+	/* Parse the pattern */
+	parser.posn = pattern;
+	parser.cflags = cflags;
+	parser.nodes = 0;
+	parser.numNodes = 0;
+	parser.sets = 0;
+	parser.numSets = 0;
+	parser.maxSets = 0;
+	parser.error = 0;
+	if((cflags & REG_EXTENDED) == 0)
+	{
+		parser.error = 1;
+	}
+	tree = (parser.error ? 0 : ParseAlt(&parser, 0));
+	if(*(parser.posn) != '\0')
+	{
+		/* Unmatched ")" is ordinary in GNU regex, but rare */
+		parser.error = 1;
+	}
+
+	/* Build the programs and the caches */
+	dfa = 0;
+	if(!(parser.error) &&
+	   (dfa = (ILRegexDFA *)ILCalloc(1, sizeof(ILRegexDFA))) != 0)
+	{
+		dfa->cflags = cflags;
+		dfa->sets = parser.sets;
+		dfa->numSets = parser.numSets;
+		parser.sets = 0;
+		size = ProgramSize(tree);
+		dfa->progLen = size;
+		dfa->forward = Compile(tree, size, 0);
+		dfa->reverse = Compile(tree, size, 1);
+		dfa->marks = (int *)ILCalloc(size + 1, sizeof(int));
+		dfa->inSet = (int *)ILCalloc(size + 1, sizeof(int));
+		dfa->stack = (int *)ILCalloc(2 * (size + 2), sizeof(int));
+		dfa->list = (int *)ILCalloc(2 * (size + 1), sizeof(int));
+		dfa->targets = (int *)ILCalloc(size + 1, sizeof(int));
+		dfa->lock = ILMutexCreate();
+		if(!(dfa->forward) || !(dfa->reverse) || !(dfa->marks) ||
+		   !(dfa->inSet) || !(dfa->stack) || !(dfa->list) || !(dfa->targets) ||
+		   !(dfa->lock) ||
+		   !InitCache(&(dfa->anchored), dfa->forward, 0) ||
+		   !InitCache(&(dfa->unanchored), dfa->forward, 1) ||
+		   !InitCache(&(dfa->reverseUnanchored), dfa->reverse, 1))
+		{
+			ILRegexDFADestroy(dfa);
+			dfa = 0;
+		}
+		else
+		{
+			ComputeClasses(dfa);
+			if(!MakeStartStates(dfa, &(dfa->anchored)) ||
+			   !MakeStartStates(dfa, &(dfa->unanchored)) ||
+			   !MakeStartStates(dfa, &(dfa->reverseUnanchored)))
+			{
+				ILRegexDFADestroy(dfa);
+				dfa = 0;
+			}
+			else if((cflags & REG_ICASE) == 0)
+			{
+				FindPrefix(dfa, tree);
+			}
+		}
+	}
+
+	/* Free the parse tree */
+	while(parser.nodes != 0)
+	{
+		node = parser.nodes;
+		parser.nodes = node->nextAlloc;
+		ILFree(node);
+	}
+	if(parser.sets)
+	{
+		ILFree(parser.sets);
+	}
+	return dfa;
+}
+
+void ILRegexDFADestroy(ILRegexDFA *dfa)
+{
+	FreeCache(&(dfa->anchored));
+	FreeCache(&(dfa->unanchored));
+	FreeCache(&(dfa->reverseUnanchored));
+	if(dfa->lock)
+	{
+		ILMutexDestroy(dfa->lock);
+	}
+	ILFree(dfa->sets);
+	ILFree(dfa->forward);
+	ILFree(dfa->reverse);
+	ILFree(dfa->marks);
+	ILFree(dfa->inSet);
+	ILFree(dfa->stack);
+	ILFree(dfa->list);
+	ILFree(dfa->targets);
+	if(dfa->prefix)
+	{
+		ILFree(dfa->prefix);
+	}
+	ILFree(dfa);
+}
+
+int ILRegexDFAExec(ILRegexDFA *dfa, const unsigned short *str, long len,
+				   int eflags, long *start, long *end)
+{
+	long posn, found, matchStart;
+	unsigned short bits;
+
+	/* Truncate the input at the first NUL, and check that it is ASCII */
+	bits = 0;
+	for(posn = 0; posn < len; ++posn)
+	{
+		if(!(str[posn]))
+		{
+			len = posn;
+			break;
+		}
+		bits |= str[posn];
+	}
+	if(bits >= 128)
+	{
+		return -1;
+	}
+
+	if(dfa->prefix)
+	{
+		/* Try an anchored match at each occurrence of the prefix */
+		posn = 0;
+		while((len - posn) >= dfa->prefixLen)
+		{
+			found = ILUTF16IndexOf(str + posn, len - posn, dfa->prefix[0]);
+			if(found < 0 || (len - posn - found) < dfa->prefixLen)
+			{
+				break;
+			}
+			posn += found;
+			if(!ILMemCmp(str + posn, dfa->prefix,
+						 dfa->prefixLen * sizeof(unsigned short)))
+			{
+				found = RunForward(dfa, &(dfa->anchored), str, posn, len,
+								   eflags, (start == 0));
+				if(found == -2)
+				{
+					return -1;
+				}
+				else if(found >= 0)
+				{
+					if(start)
+					{
+						*start = posn;
+						*end = found;
+					}
+					return 1;
+				}
+			}
+			++posn;
+		}
+		return 0;
+	}
+
+	/* Look for any match at all */
+	found = RunForward(dfa, &(dfa->unanchored), str, 0, len, eflags, 1);
+	if(found < 0)
+	{
+		return (found == -1 ? 0 : -1);
+	}
+	if(!start)
+	{
+		return 1;
+	}
+
+	/* Find the leftmost start, and then the longest match from there */
+	matchStart = RunReverse(dfa, str, len, eflags);
+	if(matchStart < 0)
+	{
+		return -1;
+	}
+	found = RunForward(dfa, &(dfa->anchored), str, matchStart, len,
+					   eflags, 0);
+	if(found < 0)
+	{
+		return -1;
+	}
+	*start = matchStart;
+	*end = found;
+	return 1;
+}
+
+#ifdef	__cplusplus
+};
+#endif
@@ -24,6 +24,7 @@
 
 #include "il_crypt.h"
 #include "il_system.h"
+#include "crypt_cpu.h"
 
 #ifdef	__cplusplus
 extern	"C" {
@@ -159,6 +160,323 @@ static void ProcessBlock(ILSHAContext *sha, const unsigned char *block)
 	a = b = c = d = e = temp = 0;
 }
 
+/*
+ * Table of kernel functions.
+ */
+typedef struct
+{
+	const char *name;
+	void (*blocks)(ILSHAContext *sha, const unsigned char *data,
+				   unsigned long numBlocks);
+
+} ILSHAKernels;
+
+/*
+ * Scalar kernels.
+ */
+static void ScalarBlocks(ILSHAContext *sha, const unsigned char *data,
+						 unsigned long numBlocks)
+{
+	while(numBlocks > 0)
+	{
+		ProcessBlock(sha, data);
+		data += 64;
+		--numBlocks;
+	}
+}
+
+static const ILSHAKernels scalarKernels = {
+	"scalar",
+	ScalarBlocks
+};
+
+#ifdef IL_CRYPT_X86
+
+/*
+ * SSSE3 kernels, for CPUs without SHA-NI.  The message schedule is
+ * computed four words at a time and the round constants are added
+ * to it, which leaves the unrolled rounds with one load per round.
+ */
+#define	SSSE3_TARGET	__attribute__((target("sse2,ssse3")))
+#define	SSSE3_ROTATE(x,n)	\
+			(_mm_or_si128(_mm_slli_epi32((x), (n)), \
+						  _mm_srli_epi32((x), 32 - (n))))
+
+/*
+ * Perform a round, with the names of the state variables rotated
+ * by one place for each round instead of moving the values.
+ */
+#define	SSSE3_ROUND(a,b,c,d,e,func,t)	\
+			do { \
+				e += ROTATE(a, 5) + func(b, c, d) + WK[(t)]; \
+				b = ROTATE(b, 30); \
+			} while (0)
+#define	SSSE3_ROUNDS(func,t)	\
+			do { \
+				SSSE3_ROUND(a, b, c, d, e, func, (t)); \
+				SSSE3_ROUND(e, a, b, c, d, func, (t) + 1); \
+				SSSE3_ROUND(d, e, a, b, c, func, (t) + 2); \
+				SSSE3_ROUND(c, d, e, a, b, func, (t) + 3); \
+				SSSE3_ROUND(b, c, d, e, a, func, (t) + 4); \
+			} while (0)
+
+SSSE3_TARGET static void SSSE3Blocks(ILSHAContext *sha,
+									 const unsigned char *data,
+									 unsigned long numBlocks)
+{
+	ILUInt32 WK[80];
+	__m128i W[20];
+	__m128i temp;
+	ILUInt32 a, b, c, d, e;
+	const __m128i mask = _mm_set_epi64x(0x0c0d0e0f08090a0bLL,
+										0x0405060700010203LL);
+	const __m128i K[4] = {
+		_mm_set1_epi32((int)KROUND1), _mm_set1_epi32((int)KROUND2),
+		_mm_set1_epi32((int)KROUND3), _mm_set1_epi32((int)KROUND4)
+	};
+	int t;
+
+	while(numBlocks > 0)
+	{
+		/* Load the message words, and then compute the schedule four
+		   words at a time.  The last of the four words depends on the
+		   first, so it is computed with zero and then fixed up */
+		for(t = 0; t < 4; ++t)
+		{
+			W[t] = _mm_shuffle_epi8
+				(_mm_loadu_si128((const __m128i *)(data + t * 16)), mask);
+		}
+		for(t = 4; t < 20; ++t)
+		{
+			temp = _mm_xor_si128
+				(_mm_xor_si128(W[t - 4], _mm_alignr_epi8(W[t - 3], W[t - 4], 8)),
+				 _mm_xor_si128(W[t - 2], _mm_srli_si128(W[t - 1], 4)));
+			temp = SSSE3_ROTATE(temp, 1);
+			W[t] = _mm_xor_si128
+				(temp, SSSE3_ROTATE(_mm_slli_si128(temp, 12), 1));
+		}
+		for(t = 0; t < 20; ++t)
+		{
+			_mm_storeu_si128((__m128i *)(WK + t * 4),
+							 _mm_add_epi32(W[t], K[t / 5]));
+		}
+
+		/* Load the SHA state into local variables */
+		a = sha->A;
+		b = sha->B;
+		c = sha->C;
+		d = sha->D;
+		e = sha->E;
+
+		/* Perform the rounds */
+		for(t = 0; t < 20; t += 5)
+		{
+			SSSE3_ROUNDS(FROUND1, t);
+		}
+		for(t = 20; t < 40; t += 5)
+		{
+			SSSE3_ROUNDS(FROUND2, t);
+		}
+		for(t = 40; t < 60; t += 5)
+		{
+			SSSE3_ROUNDS(FROUND3, t);
+		}
+		for(t = 60; t < 80; t += 5)
+		{
+			SSSE3_ROUNDS(FROUND4, t);
+		}
+
+		/* Combine the previous SHA state with the new state */
+		sha->A += a;
+		sha->B += b;
+		sha->C += c;
+		sha->D += d;
+		sha->E += e;
+
+		data += 64;
+		--numBlocks;
+	}
+
+	/* Clear the temporary state */
+	ILMemZero(WK, sizeof(WK));
+	ILMemZero(W, sizeof(W));
+}
+
+static const ILSHAKernels ssse3Kernels = {
+	"ssse3",
+	SSSE3Blocks
+};
+
+/*
+ * SHA-NI kernels.  Each "sha1rnds4" performs four rounds, and the
+ * message schedule for later rounds is computed in between.
+ */
+#define	SHANI_TARGET	__attribute__((target("sse2,ssse3,sse4.1,sha")))
+
+/*
+ * Perform four rounds using the message words in "m0", and advance
+ * the schedule in "m1", "m2" and "m3" for the rounds that follow.
+ */
+#define	SHANI_ROUNDS(e,enext,m0,m1,m2,m3,func)	\
+			do { \
+				e = _mm_sha1nexte_epu32(e, m0); \
+				enext = abcd; \
+				m1 = _mm_sha1msg2_epu32(m1, m0); \
+				abcd = _mm_sha1rnds4_epu32(abcd, e, (func)); \
+				m3 = _mm_sha1msg1_epu32(m3, m0); \
+				m2 = _mm_xor_si128(m2, m0); \
+			} while (0)
+
+SHANI_TARGET static void SHANIBlocks(ILSHAContext *sha,
+									 const unsigned char *data,
+									 unsigned long numBlocks)
+{
+	__m128i abcd, e0, e1, abcdSave, eSave;
+	__m128i m0, m1, m2, m3;
+	const __m128i mask = _mm_set_epi64x(0x0001020304050607LL,
+										0x08090a0b0c0d0e0fLL);
+
+	/* Load the state, with "A" in the highest word */
+	abcd = _mm_set_epi32((int)(sha->A), (int)(sha->B),
+						 (int)(sha->C), (int)(sha->D));
+	e0 = _mm_set_epi32((int)(sha->E), 0, 0, 0);
+
+	while(numBlocks > 0)
+	{
+		abcdSave = abcd;
+		eSave = e0;
+
+		/* Rounds 0 to 15, loading the message as we go */
+		m0 = _mm_shuffle_epi8
+			(_mm_loadu_si128((const __m128i *)data), mask);
+		e0 = _mm_add_epi32(e0, m0);
+		e1 = abcd;
+		abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+
+		m1 = _mm_shuffle_epi8
+			(_mm_loadu_si128((const __m128i *)(data + 16)), mask);
+		e1 = _mm_sha1nexte_epu32(e1, m1);
+		e0 = abcd;
+		abcd = _mm_sha1rnds4_epu32(abcd, e1, 0);
+		m0 = _mm_sha1msg1_epu32(m0, m1);
+
+		m2 = _mm_shuffle_epi8
+			(_mm_loadu_si128((const __m128i *)(data + 32)), mask);
+		e0 = _mm_sha1nexte_epu32(e0, m2);
+		e1 = abcd;
+		abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+		m1 = _mm_sha1msg1_epu32(m1, m2);
+		m0 = _mm_xor_si128(m0, m2);
+
+		m3 = _mm_shuffle_epi8
+			(_mm_loadu_si128((const __m128i *)(data + 48)), mask);
+		SHANI_ROUNDS(e1, e0, m3, m0, m1, m2, 0);
+
+		/* Rounds 16 to 67 */
+		SHANI_ROUNDS(e0, e1, m0, m1, m2, m3, 0);
+		SHANI_ROUNDS(e1, e0, m1, m2, m3, m0, 1);
+		SHANI_ROUNDS(e0, e1, m2, m3, m0, m1, 1);
+		SHANI_ROUNDS(e1, e0, m3, m0, m1, m2, 1);
+		SHANI_ROUNDS(e0, e1, m0, m1, m2, m3, 1);
+		SHANI_ROUNDS(e1, e0, m1, m2, m3, m0, 1);
+		SHANI_ROUNDS(e0, e1, m2, m3, m0, m1, 2);
+		SHANI_ROUNDS(e1, e0, m3, m0, m1, m2, 2);
+		SHANI_ROUNDS(e0, e1, m0, m1, m2, m3, 2);
+		SHANI_ROUNDS(e1, e0, m1, m2, m3, m0, 2);
+		SHANI_ROUNDS(e0, e1, m2, m3, m0, m1, 2);
+		SHANI_ROUNDS(e1, e0, m3, m0, m1, m2, 3);
+		SHANI_ROUNDS(e0, e1, m0, m1, m2, m3, 3);
+
+		/* Rounds 68 to 79, which don't need any more of the schedule */
+		e1 = _mm_sha1nexte_epu32(e1, m1);
+		e0 = abcd;
+		m2 = _mm_sha1msg2_epu32(m2, m1);
+		abcd = _mm_sha1rnds4_epu32(abcd, e1, 3);
+		m3 = _mm_xor_si128(m3, m1);
+
+		e0 = _mm_sha1nexte_epu32(e0, m2);
+		e1 = abcd;
+		m3 = _mm_sha1msg2_epu32(m3, m2);
+		abcd = _mm_sha1rnds4_epu32(abcd, e0, 3);
+
+		e1 = _mm_sha1nexte_epu32(e1, m3);
+		e0 = abcd;
+		abcd = _mm_sha1rnds4_epu32(abcd, e1, 3);
+
+		/* Combine the previous state with the new state */
+		e0 = _mm_sha1nexte_epu32(e0, eSave);
+		abcd = _mm_add_epi32(abcd, abcdSave);
+
+		data += 64;
+		--numBlocks;
+	}
+
+	/* Store the state back into the context */
+	sha->A = (ILUInt32)_mm_extract_epi32(abcd, 3);
+	sha->B = (ILUInt32)_mm_extract_epi32(abcd, 2);
+	sha->C = (ILUInt32)_mm_extract_epi32(abcd, 1);
+	sha->D = (ILUInt32)_mm_extract_epi32(abcd, 0);
+	sha->E = (ILUInt32)_mm_extract_epi32(e0, 3);
+}
+
+static const ILSHAKernels shaniKernels = {
+	"shani",
+	SHANIBlocks
+};
+
+#endif /* IL_CRYPT_X86 */
+
+/*
+ * Kernels that are currently in use.  Races on the initialization
+ * are harmless because all threads will select the same kernels.
+ */
+static const ILSHAKernels *kernels = 0;
+
+/*
+ * Get the kernels with a specific name, or the best kernels for
+ * this CPU if "name" is NULL.  Returns NULL if the kernels with
+ * the name are not supported.
+ */
+static const ILSHAKernels *FindKernels(const char *name)
+{
+#ifdef IL_CRYPT_X86
+	if((_ILCryptCPUFeatures() & IL_CRYPT_CPU_SHA) != 0 &&
+	   (!name || !strcmp(name, shaniKernels.name)))
+	{
+		return &shaniKernels;
+	}
+	if((_ILCryptCPUFeatures() & IL_CRYPT_CPU_SSSE3) != 0 &&
+	   (!name || !strcmp(name, ssse3Kernels.name)))
+	{
+		return &ssse3Kernels;
+	}
+#endif
+	if(!name || !strcmp(name, scalarKernels.name))
+	{
+		return &scalarKernels;
+	}
+	return 0;
+}
+
+static const ILSHAKernels *GetKernels(void)
+{
+	if(!kernels)
+	{
+		kernels = FindKernels(0);
+	}
+	return kernels;
+}
+
+const char *ILSHAUseKernels(const char *name)
+{
+	const ILSHAKernels *newKernels = FindKernels(name);
+	if(newKernels)
+	{
+		kernels = newKernels;
+	}
+	return GetKernels()->name;
+}
+
 void ILSHAData(ILSHAContext *sha, const void *buffer, unsigned long len)
 {
 	unsigned long templen;
@@ -172,9 +490,11 @@ void ILSHAData(ILSHAContext *sha, const void *buffer, unsigned long len)
 		if(!(sha->inputLen) && len >= 64)
 		{
 			/* Short cut: no point copying the data twice */
-			ProcessBlock(sha, (const unsigned char *)buffer);
-			buffer = (const void *)(((const unsigned char *)buffer) + 64);
-			len -= 64;
+			templen = (len & ~((unsigned long)63));
+			(*(GetKernels()->blocks))
+				(sha, (const unsigned char *)buffer, templen / 64);
+			buffer = (const void *)(((const unsigned char *)buffer) + templen);
+			len -= templen;
 		}
 		else
 		{
@@ -186,7 +506,7 @@ void ILSHAData(ILSHAContext *sha, const void *buffer, unsigned long len)
 			ILMemCpy(sha->input + sha->inputLen, buffer, templen);
 			if((sha->inputLen += templen) >= 64)
 			{
-				ProcessBlock(sha, sha->input);
+				(*(GetKernels()->blocks))(sha, sha->input, 1);
 				sha->inputLen = 0;
 			}
 			buffer = (const void *)(((const unsigned char *)buffer) + templen);
@@ -222,7 +542,7 @@ void ILSHAFinalize(ILSHAContext *sha, unsigned char hash[IL_SHA_HASH_SIZE])
 			{
 				sha->input[(sha->inputLen)++] = (unsigned char)0x00;
 			}
-			ProcessBlock(sha, sha->input);
+			(*(GetKernels()->blocks))(sha, sha->input, 1);
 			sha->inputLen = 0;
 		}
 		else
@@ -237,7 +557,7 @@ void ILSHAFinalize(ILSHAContext *sha, unsigned char hash[IL_SHA_HASH_SIZE])
 		totalBits = (sha->totalLen << 3);
 		WriteLong(sha->input + 56, (ILUInt32)(totalBits >> 32));
 		WriteLong(sha->input + 60, (ILUInt32)totalBits);
-		ProcessBlock(sha, sha->input);
+		(*(GetKernels()->blocks))(sha, sha->input, 1);
 
 		/* Write the final hash value to the supplied buffer */
 		WriteLong(hash,      sha->A);
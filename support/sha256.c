@@ -24,6 +24,7 @@
 
 #include "il_crypt.h"
 #include "il_system.h"
+#include "crypt_cpu.h"
 
 #ifdef	__cplusplus
 extern	"C" {
@@ -153,6 +154,472 @@ static void ProcessBlock(ILSHA256Context *sha, const unsigned char *block)
 	a = b = c = d = e = f = g = h = temp = temp2 = 0;
 }
 
+/*
+ * Table of kernel functions.  "lanes" hashes one block from each
+ * of IL_SHA256_LANES contexts at once, or is NULL if the kernels
+ * cannot hash several buffers in parallel.
+ */
+#define	IL_SHA256_LANES		8
+typedef struct
+{
+	const char *name;
+	void (*blocks)(ILSHA256Context *sha, const unsigned char *data,
+				   unsigned long numBlocks);
+	void (*lanes)(ILSHA256Context **sha, const unsigned char **data);
+
+} ILSHA256Kernels;
+
+/*
+ * Scalar kernels.
+ */
+static void ScalarBlocks(ILSHA256Context *sha, const unsigned char *data,
+						 unsigned long numBlocks)
+{
+	while(numBlocks > 0)
+	{
+		ProcessBlock(sha, data);
+		data += 64;
+		--numBlocks;
+	}
+}
+
+static const ILSHA256Kernels scalarKernels = {
+	"scalar",
+	ScalarBlocks,
+	0
+};
+
+#ifdef IL_CRYPT_X86
+
+/*
+ * SSSE3 kernels, for CPUs without SHA-NI.  The message schedule is
+ * computed four words at a time and the round constants are added
+ * to it, which leaves the unrolled rounds with one load per round.
+ */
+#define	SSSE3_TARGET	__attribute__((target("sse2,ssse3")))
+#define	SSSE3_ROTATE(x,n)	\
+			(_mm_or_si128(_mm_srli_epi32((x), (n)), \
+						  _mm_slli_epi32((x), 32 - (n))))
+#define	SSSE3_RHO0(x)	\
+			(_mm_xor_si128(_mm_xor_si128(SSSE3_ROTATE((x), 7), \
+										 SSSE3_ROTATE((x), 18)), \
+						   _mm_srli_epi32((x), 3)))
+#define	SSSE3_RHO1(x)	\
+			(_mm_xor_si128(_mm_xor_si128(SSSE3_ROTATE((x), 17), \
+										 SSSE3_ROTATE((x), 19)), \
+						   _mm_srli_epi32((x), 10)))
+
+/*
+ * Perform a round, with the names of the state variables rotated
+ * by one place for each round instead of moving the values.
+ */
+#define	SSSE3_ROUND(a,b,c,d,e,f,g,h,t)	\
+			do { \
+				temp = h + SUM1(e) + CH(e, f, g) + WK[(t)]; \
+				d += temp; \
+				h = temp + SUM0(a) + MAJ(a, b, c); \
+			} while (0)
+#define	SSSE3_ROUNDS(t)	\
+			do { \
+				SSSE3_ROUND(a, b, c, d, e, f, g, h, (t)); \
+				SSSE3_ROUND(h, a, b, c, d, e, f, g, (t) + 1); \
+				SSSE3_ROUND(g, h, a, b, c, d, e, f, (t) + 2); \
+				SSSE3_ROUND(f, g, h, a, b, c, d, e, (t) + 3); \
+				SSSE3_ROUND(e, f, g, h, a, b, c, d, (t) + 4); \
+				SSSE3_ROUND(d, e, f, g, h, a, b, c, (t) + 5); \
+				SSSE3_ROUND(c, d, e, f, g, h, a, b, (t) + 6); \
+				SSSE3_ROUND(b, c, d, e, f, g, h, a, (t) + 7); \
+			} while (0)
+
+SSSE3_TARGET static void SSSE3Blocks(ILSHA256Context *sha,
+									 const unsigned char *data,
+									 unsigned long numBlocks)
+{
+	ILUInt32 WK[64];
+	__m128i W[16];
+	__m128i temp1;
+	ILUInt32 a, b, c, d, e, f, g, h;
+	ILUInt32 temp;
+	const __m128i mask = _mm_set_epi64x(0x0c0d0e0f08090a0bLL,
+										0x0405060700010203LL);
+	int t;
+
+	while(numBlocks > 0)
+	{
+		/* Load the message words, and then compute the schedule four
+		   words at a time.  The last two of the four words depend on
+		   the first two, so they are computed in a second step */
+		for(t = 0; t < 4; ++t)
+		{
+			W[t] = _mm_shuffle_epi8
+				(_mm_loadu_si128((const __m128i *)(data + t * 16)), mask);
+		}
+		for(t = 4; t < 16; ++t)
+		{
+			temp1 = _mm_add_epi32
+				(_mm_add_epi32(W[t - 4],
+							   SSSE3_RHO0(_mm_alignr_epi8(W[t - 3], W[t - 4], 4))),
+				 _mm_alignr_epi8(W[t - 1], W[t - 2], 4));
+			temp1 = _mm_add_epi32
+				(temp1, SSSE3_RHO1(_mm_srli_si128(W[t - 1], 8)));
+			W[t] = _mm_add_epi32
+				(temp1, SSSE3_RHO1(_mm_slli_si128(temp1, 8)));
+		}
+		for(t = 0; t < 16; ++t)
+		{
+			_mm_storeu_si128
+				((__m128i *)(WK + t * 4),
+				 _mm_add_epi32(W[t],
+				 			   _mm_loadu_si128((const __m128i *)(K + t * 4))));
+		}
+
+		/* Load the SHA-256 state into local variables */
+		a = sha->A;
+		b = sha->B;
+		c = sha->C;
+		d = sha->D;
+		e = sha->E;
+		f = sha->F;
+		g = sha->G;
+		h = sha->H;
+
+		/* Perform 64 rounds of hash computations */
+		for(t = 0; t < 64; t += 8)
+		{
+			SSSE3_ROUNDS(t);
+		}
+
+		/* Combine the previous SHA-256 state with the new state */
+		sha->A += a;
+		sha->B += b;
+		sha->C += c;
+		sha->D += d;
+		sha->E += e;
+		sha->F += f;
+		sha->G += g;
+		sha->H += h;
+
+		data += 64;
+		--numBlocks;
+	}
+
+	/* Clear the temporary state */
+	ILMemZero(WK, sizeof(WK));
+	ILMemZero(W, sizeof(W));
+}
+
+static const ILSHA256Kernels ssse3Kernels = {
+	"ssse3",
+	SSSE3Blocks,
+	0
+};
+
+/*
+ * SHA-NI kernels.  Each "sha256rnds2" performs two rounds on the
+ * state, which is held as "ABEF" and "CDGH" in two registers.
+ */
+#define	SHANI_TARGET	__attribute__((target("sse2,ssse3,sse4.1,sha")))
+
+/*
+ * Perform four rounds using the message words in "m0".
+ */
+#define	SHANI_ROUNDS(m0,t)	\
+			do { \
+				msg = _mm_add_epi32 \
+					((m0), _mm_loadu_si128((const __m128i *)(K + (t)))); \
+				cdgh = _mm_sha256rnds2_epu32(cdgh, abef, msg); \
+				msg = _mm_shuffle_epi32(msg, 0x0E); \
+				abef = _mm_sha256rnds2_epu32(abef, cdgh, msg); \
+			} while (0)
+
+/*
+ * Perform four rounds using the message words in "m0", and advance
+ * the schedule in "m1" and "m3" for the rounds that follow.
+ */
+#define	SHANI_ROUNDS_SCHEDULE(m0,m1,m3,t)	\
+			do { \
+				msg = _mm_add_epi32 \
+					((m0), _mm_loadu_si128((const __m128i *)(K + (t)))); \
+				cdgh = _mm_sha256rnds2_epu32(cdgh, abef, msg); \
+				m1 = _mm_add_epi32(m1, _mm_alignr_epi8(m0, m3, 4)); \
+				m1 = _mm_sha256msg2_epu32(m1, m0); \
+				msg = _mm_shuffle_epi32(msg, 0x0E); \
+				abef = _mm_sha256rnds2_epu32(abef, cdgh, msg); \
+				m3 = _mm_sha256msg1_epu32(m3, m0); \
+			} while (0)
+
+SHANI_TARGET static void SHANIBlocks(ILSHA256Context *sha,
+									 const unsigned char *data,
+									 unsigned long numBlocks)
+{
+	__m128i abef, cdgh, abefSave, cdghSave;
+	__m128i msg, m0, m1, m2, m3;
+	const __m128i mask = _mm_set_epi64x(0x0c0d0e0f08090a0bLL,
+										0x0405060700010203LL);
+
+	/* Load the state, with "A" and "C" in the highest words */
+	abef = _mm_set_epi32((int)(sha->A), (int)(sha->B),
+						 (int)(sha->E), (int)(sha->F));
+	cdgh = _mm_set_epi32((int)(sha->C), (int)(sha->D),
+						 (int)(sha->G), (int)(sha->H));
+
+	while(numBlocks > 0)
+	{
+		abefSave = abef;
+		cdghSave = cdgh;
+
+		/* Rounds 0 to 15, loading the message as we go */
+		m0 = _mm_shuffle_epi8
+			(_mm_loadu_si128((const __m128i *)data), mask);
+		SHANI_ROUNDS(m0, 0);
+
+		m1 = _mm_shuffle_epi8
+			(_mm_loadu_si128((const __m128i *)(data + 16)), mask);
+		SHANI_ROUNDS(m1, 4);
+		m0 = _mm_sha256msg1_epu32(m0, m1);
+
+		m2 = _mm_shuffle_epi8
+			(_mm_loadu_si128((const __m128i *)(data + 32)), mask);
+		SHANI_ROUNDS(m2, 8);
+		m1 = _mm_sha256msg1_epu32(m1, m2);
+
+		m3 = _mm_shuffle_epi8
+			(_mm_loadu_si128((const __m128i *)(data + 48)), mask);
+		SHANI_ROUNDS_SCHEDULE(m3, m0, m2, 12);
+
+		/* Rounds 16 to 51 */
+		SHANI_ROUNDS_SCHEDULE(m0, m1, m3, 16);
+		SHANI_ROUNDS_SCHEDULE(m1, m2, m0, 20);
+		SHANI_ROUNDS_SCHEDULE(m2, m3, m1, 24);
+		SHANI_ROUNDS_SCHEDULE(m3, m0, m2, 28);
+		SHANI_ROUNDS_SCHEDULE(m0, m1, m3, 32);
+		SHANI_ROUNDS_SCHEDULE(m1, m2, m0, 36);
+		SHANI_ROUNDS_SCHEDULE(m2, m3, m1, 40);
+		SHANI_ROUNDS_SCHEDULE(m3, m0, m2, 44);
+		SHANI_ROUNDS_SCHEDULE(m0, m1, m3, 48);
+
+		/* Rounds 52 to 63, which don't need any more of the schedule */
+		msg = _mm_add_epi32(m1, _mm_loadu_si128((const __m128i *)(K + 52)));
+		cdgh = _mm_sha256rnds2_epu32(cdgh, abef, msg);
+		m2 = _mm_add_epi32(m2, _mm_alignr_epi8(m1, m0, 4));
+		m2 = _mm_sha256msg2_epu32(m2, m1);
+		msg = _mm_shuffle_epi32(msg, 0x0E);
+		abef = _mm_sha256rnds2_epu32(abef, cdgh, msg);
+
+		msg = _mm_add_epi32(m2, _mm_loadu_si128((const __m128i *)(K + 56)));
+		cdgh = _mm_sha256rnds2_epu32(cdgh, abef, msg);
+		m3 = _mm_add_epi32(m3, _mm_alignr_epi8(m2, m1, 4));
+		m3 = _mm_sha256msg2_epu32(m3, m2);
+		msg = _mm_shuffle_epi32(msg, 0x0E);
+		abef = _mm_sha256rnds2_epu32(abef, cdgh, msg);
+
+		SHANI_ROUNDS(m3, 60);
+
+		/* Combine the previous state with the new state */
+		abef = _mm_add_epi32(abef, abefSave);
+		cdgh = _mm_add_epi32(cdgh, cdghSave);
+
+		data += 64;
+		--numBlocks;
+	}
+
+	/* Store the state back into the context */
+	sha->A = (ILUInt32)_mm_extract_epi32(abef, 3);
+	sha->B = (ILUInt32)_mm_extract_epi32(abef, 2);
+	sha->E = (ILUInt32)_mm_extract_epi32(abef, 1);
+	sha->F = (ILUInt32)_mm_extract_epi32(abef, 0);
+	sha->C = (ILUInt32)_mm_extract_epi32(cdgh, 3);
+	sha->D = (ILUInt32)_mm_extract_epi32(cdgh, 2);
+	sha->G = (ILUInt32)_mm_extract_epi32(cdgh, 1);
+	sha->H = (ILUInt32)_mm_extract_epi32(cdgh, 0);
+}
+
+/*
+ * AVX2 kernels, which hash eight independent buffers at once by
+ * holding the same state variable for every buffer in one register.
+ * A single buffer is hashed with the SSSE3 kernels.
+ */
+#define	AVX2_TARGET		__attribute__((target("avx2")))
+#define	AVX2_ROTATE(x,n)	\
+			(_mm256_or_si256(_mm256_srli_epi32((x), (n)), \
+							 _mm256_slli_epi32((x), 32 - (n))))
+#define	AVX2_SHIFT(x,n)		(_mm256_srli_epi32((x), (n)))
+#define	AVX2_XOR3(x,y,z)	\
+			(_mm256_xor_si256(_mm256_xor_si256((x), (y)), (z)))
+#define	AVX2_ADD(x,y)		(_mm256_add_epi32((x), (y)))
+#define	AVX2_LOAD(field)	\
+			(_mm256_set_epi32((int)(sha[7]->field), (int)(sha[6]->field), \
+							  (int)(sha[5]->field), (int)(sha[4]->field), \
+							  (int)(sha[3]->field), (int)(sha[2]->field), \
+							  (int)(sha[1]->field), (int)(sha[0]->field)))
+#define	AVX2_WORD(lane,t)	\
+			((int)((((ILUInt32)(data[(lane)][(t) * 4 + 0])) << 24) | \
+				   (((ILUInt32)(data[(lane)][(t) * 4 + 1])) << 16) | \
+				   (((ILUInt32)(data[(lane)][(t) * 4 + 2])) <<  8) | \
+				    ((ILUInt32)(data[(lane)][(t) * 4 + 3]))))
+
+AVX2_TARGET static void AVX2Lanes(ILSHA256Context **sha,
+								  const unsigned char **data)
+{
+	__m256i W[16];
+	__m256i a, b, c, d, e, f, g, h;
+	__m256i temp, temp2;
+	ILUInt32 state[8][IL_SHA256_LANES];
+	int t, lane;
+
+	/* Load the state for all lanes */
+	a = AVX2_LOAD(A);
+	b = AVX2_LOAD(B);
+	c = AVX2_LOAD(C);
+	d = AVX2_LOAD(D);
+	e = AVX2_LOAD(E);
+	f = AVX2_LOAD(F);
+	g = AVX2_LOAD(G);
+	h = AVX2_LOAD(H);
+
+	/* Perform 64 rounds of hash computations, computing the message
+	   schedule in a circular buffer of 16 words as we go */
+	for(t = 0; t < 64; ++t)
+	{
+		if(t < 16)
+		{
+			W[t] = _mm256_set_epi32(AVX2_WORD(7, t), AVX2_WORD(6, t),
+									AVX2_WORD(5, t), AVX2_WORD(4, t),
+									AVX2_WORD(3, t), AVX2_WORD(2, t),
+									AVX2_WORD(1, t), AVX2_WORD(0, t));
+		}
+		else
+		{
+			temp = W[(t - 2) & 15];
+			temp2 = W[(t - 15) & 15];
+			W[t & 15] = AVX2_ADD
+				(AVX2_ADD(AVX2_XOR3(AVX2_ROTATE(temp, 17),
+									AVX2_ROTATE(temp, 19),
+									AVX2_SHIFT(temp, 10)),
+						  W[(t - 7) & 15]),
+				 AVX2_ADD(AVX2_XOR3(AVX2_ROTATE(temp2, 7),
+									AVX2_ROTATE(temp2, 18),
+									AVX2_SHIFT(temp2, 3)),
+						  W[t & 15]));
+		}
+		temp = AVX2_ADD
+			(AVX2_ADD(h, AVX2_XOR3(AVX2_ROTATE(e, 6), AVX2_ROTATE(e, 11),
+								   AVX2_ROTATE(e, 25))),
+			 AVX2_ADD(_mm256_xor_si256(_mm256_and_si256(e, f),
+			 						   _mm256_andnot_si256(e, g)),
+					  AVX2_ADD(_mm256_set1_epi32((int)(K[t])), W[t & 15])));
+		temp2 = AVX2_ADD
+			(AVX2_XOR3(AVX2_ROTATE(a, 2), AVX2_ROTATE(a, 13),
+					   AVX2_ROTATE(a, 22)),
+			 _mm256_or_si256(_mm256_and_si256(a, b),
+			 				 _mm256_and_si256(c, _mm256_or_si256(a, b))));
+		h = g;
+		g = f;
+		f = e;
+		e = AVX2_ADD(d, temp);
+		d = c;
+		c = b;
+		b = a;
+		a = AVX2_ADD(temp, temp2);
+	}
+
+	/* Combine the previous state of each lane with the new state */
+	_mm256_storeu_si256((__m256i *)(state[0]), AVX2_ADD(a, AVX2_LOAD(A)));
+	_mm256_storeu_si256((__m256i *)(state[1]), AVX2_ADD(b, AVX2_LOAD(B)));
+	_mm256_storeu_si256((__m256i *)(state[2]), AVX2_ADD(c, AVX2_LOAD(C)));
+	_mm256_storeu_si256((__m256i *)(state[3]), AVX2_ADD(d, AVX2_LOAD(D)));
+	_mm256_storeu_si256((__m256i *)(state[4]), AVX2_ADD(e, AVX2_LOAD(E)));
+	_mm256_storeu_si256((__m256i *)(state[5]), AVX2_ADD(f, AVX2_LOAD(F)));
+	_mm256_storeu_si256((__m256i *)(state[6]), AVX2_ADD(g, AVX2_LOAD(G)));
+	_mm256_storeu_si256((__m256i *)(state[7]), AVX2_ADD(h, AVX2_LOAD(H)));
+	for(lane = 0; lane < IL_SHA256_LANES; ++lane)
+	{
+		sha[lane]->A = state[0][lane];
+		sha[lane]->B = state[1][lane];
+		sha[lane]->C = state[2][lane];
+		sha[lane]->D = state[3][lane];
+		sha[lane]->E = state[4][lane];
+		sha[lane]->F = state[5][lane];
+		sha[lane]->G = state[6][lane];
+		sha[lane]->H = state[7][lane];
+	}
+
+	/* Clear the temporary state */
+	ILMemZero(W, sizeof(W));
+	ILMemZero(state, sizeof(state));
+}
+
+static const ILSHA256Kernels shaniKernels = {
+	"shani",
+	SHANIBlocks,
+	0
+};
+
+static const ILSHA256Kernels avx2Kernels = {
+	"avx2",
+	SSSE3Blocks,
+	AVX2Lanes
+};
+
+#endif /* IL_CRYPT_X86 */
+
+/*
+ * Kernels that are currently in use.  Races on the initialization
+ * are harmless because all threads will select the same kernels.
+ */
+static const ILSHA256Kernels *kernels = 0;
+
+/*
+ * Get the kernels with a specific name, or the best kernels for
+ * this CPU if "name" is NULL.  Returns NULL if the kernels with
+ * the name are not supported.
+ */
+static const ILSHA256Kernels *FindKernels(const char *name)
+{
+#ifdef IL_CRYPT_X86
+	int features = _ILCryptCPUFeatures();
+	if((features & IL_CRYPT_CPU_SHA) != 0 &&
+	   (!name || !strcmp(name, shaniKernels.name)))
+	{
+		return &shaniKernels;
+	}
+	if((features & IL_CRYPT_CPU_AVX2) != 0 &&
+	   (!name || !strcmp(name, avx2Kernels.name)))
+	{
+		return &avx2Kernels;
+	}
+	if((features & IL_CRYPT_CPU_SSSE3) != 0 &&
+	   (!name || !strcmp(name, ssse3Kernels.name)))
+	{
+		return &ssse3Kernels;
+	}
+#endif
+	if(!name || !strcmp(name, scalarKernels.name))
+	{
+		return &scalarKernels;
+	}
+	return 0;
+}
+
+static const ILSHA256Kernels *GetKernels(void)
+{
+	if(!kernels)
+	{
+		kernels = FindKernels(0);
+	}
+	return kernels;
+}
+
+const char *ILSHA256UseKernels(const char *name)
+{
+	const ILSHA256Kernels *newKernels = FindKernels(name);
+	if(newKernels)
+	{
+		kernels = newKernels;
+	}
+	return GetKernels()->name;
+}
+
 void ILSHA256Data(ILSHA256Context *sha, const void *buffer, unsigned long len)
 {
 	unsigned long templen;
@@ -166,9 +633,11 @@ void ILSHA256Data(ILSHA256Context *sha, const void *buffer, unsigned long len)
 		if(!(sha->inputLen) && len >= 64)
 		{
 			/* Short cut: no point copying the data twice */
-			ProcessBlock(sha, (const unsigned char *)buffer);
-			buffer = (const void *)(((const unsigned char *)buffer) + 64);
-			len -= 64;
+			templen = (len & ~((unsigned long)63));
+			(*(GetKernels()->blocks))
+				(sha, (const unsigned char *)buffer, templen / 64);
+			buffer = (const void *)(((const unsigned char *)buffer) + templen);
+			len -= templen;
 		}
 		else
 		{
@@ -180,7 +649,7 @@ void ILSHA256Data(ILSHA256Context *sha, const void *buffer, unsigned long len)
 			ILMemCpy(sha->input + sha->inputLen, buffer, templen);
 			if((sha->inputLen += templen) >= 64)
 			{
-				ProcessBlock(sha, sha->input);
+				(*(GetKernels()->blocks))(sha, sha->input, 1);
 				sha->inputLen = 0;
 			}
 			buffer = (const void *)(((const unsigned char *)buffer) + templen);
@@ -217,7 +686,7 @@ void ILSHA256Finalize(ILSHA256Context *sha,
 			{
 				sha->input[(sha->inputLen)++] = (unsigned char)0x00;
 			}
-			ProcessBlock(sha, sha->input);
+			(*(GetKernels()->blocks))(sha, sha->input, 1);
 			sha->inputLen = 0;
 		}
 		else
@@ -232,7 +701,7 @@ void ILSHA256Finalize(ILSHA256Context *sha,
 		totalBits = (sha->totalLen << 3);
 		WriteLong(sha->input + 56, (ILUInt32)(totalBits >> 32));
 		WriteLong(sha->input + 60, (ILUInt32)totalBits);
-		ProcessBlock(sha, sha->input);
+		(*(GetKernels()->blocks))(sha, sha->input, 1);
 
 		/* Write the final hash value to the supplied buffer */
 		WriteLong(hash,      sha->A);
@@ -249,6 +718,92 @@ void ILSHA256Finalize(ILSHA256Context *sha,
 	ILMemZero(sha, sizeof(ILSHA256Context));
 }
 
+void ILSHA256HashBuffers(const void * const *buffers,
+						 const unsigned long *lens, int numBuffers,
+						 unsigned char *hashes)
+{
+	const ILSHA256Kernels *k = GetKernels();
+	ILSHA256Context contexts[IL_SHA256_LANES];
+	ILSHA256Context spare;
+	ILSHA256Context *lanes[IL_SHA256_LANES];
+	const unsigned char *data[IL_SHA256_LANES];
+	const unsigned char *posns[IL_SHA256_LANES];
+	unsigned long blocks[IL_SHA256_LANES];
+	unsigned char zeroes[64];
+	int numLanes, lane, active;
+
+	ILSHA256Init(&spare);
+	ILMemZero(zeroes, sizeof(zeroes));
+	while(numBuffers > 0)
+	{
+		/* Start hashing the next group of buffers */
+		numLanes = (numBuffers < IL_SHA256_LANES ? numBuffers
+												 : IL_SHA256_LANES);
+		for(lane = 0; lane < numLanes; ++lane)
+		{
+			ILSHA256Init(&(contexts[lane]));
+			posns[lane] = (const unsigned char *)(buffers[lane]);
+			blocks[lane] = lens[lane] / 64;
+		}
+
+		/* Hash the whole blocks of the buffers in parallel, for as
+		   long as at least two of the buffers have blocks left.  The
+		   lanes that have finished hash zeroes into a spare context */
+		if(k->lanes)
+		{
+			for(;;)
+			{
+				active = 0;
+				for(lane = 0; lane < IL_SHA256_LANES; ++lane)
+				{
+					if(lane < numLanes && blocks[lane] > 0)
+					{
+						lanes[lane] = &(contexts[lane]);
+						data[lane] = posns[lane];
+						posns[lane] += 64;
+						--(blocks[lane]);
+						++active;
+					}
+					else
+					{
+						lanes[lane] = &spare;
+						data[lane] = zeroes;
+					}
+				}
+				if(active < 2)
+				{
+					/* Put back the block of the single active lane */
+					for(lane = 0; lane < numLanes; ++lane)
+					{
+						if(lanes[lane] != &spare)
+						{
+							posns[lane] -= 64;
+						}
+					}
+					break;
+				}
+				(*(k->lanes))(lanes, data);
+			}
+		}
+
+		/* Hash the rest of each buffer serially */
+		for(lane = 0; lane < numLanes; ++lane)
+		{
+			data[lane] = (const unsigned char *)(buffers[lane]);
+			contexts[lane].totalLen = (ILUInt64)(posns[lane] - data[lane]);
+			ILSHA256Data(&(contexts[lane]), posns[lane],
+						 lens[lane] - (unsigned long)
+						 	(posns[lane] - data[lane]));
+			ILSHA256Finalize(&(contexts[lane]), hashes);
+			hashes += IL_SHA256_HASH_SIZE;
+		}
+		buffers += numLanes;
+		lens += numLanes;
+		numBuffers -= numLanes;
+	}
+	ILMemZero(&spare, sizeof(spare));
+}
+
 #ifdef TEST_SHA256
 
 #include <stdio.h>
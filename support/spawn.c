@@ -56,6 +56,7 @@
 		#define	WCOREDUMP(status)		(((status) & 0x80) != 0)
 	#endif
 	#include <signal.h>
+	#include <errno.h>
 #endif
 
 #ifdef	__cplusplus
@@ -229,6 +230,20 @@ int ILSpawnProcessWaitForExit(int pid, char *argv[])
 	return (status == 0);
 }
 
+int ILSpawnFunction(int (*func)(void *arg), void *arg,
+					void **output, void **errors)
+{
+	/* Not supported */
+	return 0;
+}
+
+int ILSpawnWaitForAny(int *status)
+{
+	/* Not supported */
+	*status = -1;
+	return -1;
+}
+
 #else
 #if defined(HAVE_FORK) && defined(HAVE_EXECV) && (defined(HAVE_WAITPID) || defined(HAVE_WAIT))
 
@@ -466,6 +481,103 @@ int ILSpawnProcessWaitForExit(int pid, char *argv[])
 	}
 }
 
+int ILSpawnFunction(int (*func)(void *arg), void *arg,
+					void **output, void **errors)
+{
+	FILE *outFile;
+	FILE *errFile;
+	int pid;
+
+	/* Create the temporary files that capture the child's output */
+	*output = 0;
+	*errors = 0;
+	if((outFile = tmpfile()) == 0)
+	{
+		perror("tmpfile");
+		return -1;
+	}
+	if((errFile = tmpfile()) == 0)
+	{
+		perror("tmpfile");
+		fclose(outFile);
+		return -1;
+	}
+
+	/* Flush pending output so that the child doesn't write it again */
+	fflush(stdout);
+	fflush(stderr);
+
+	/* Launch the child process */
+	pid = fork();
+	if(pid < 0)
+	{
+		/* Could not fork the child process */
+		perror("fork");
+		fclose(outFile);
+		fclose(errFile);
+		return -1;
+	}
+	else if(pid == 0)
+	{
+		/* We are in the child process: redirect stdout and stderr
+		   so that grandchild processes are captured as well */
+		dup2(fileno(outFile), 1);
+		dup2(fileno(errFile), 2);
+		fclose(outFile);
+		fclose(errFile);
+		pid = (*func)(arg);
+		fflush(stdout);
+		fflush(stderr);
+		_exit(pid);
+		return -1;		/* Keep the compiler happy */
+	}
+	else
+	{
+		/* We are in the parent process */
+		*output = (void *)outFile;
+		*errors = (void *)errFile;
+		return pid;
+	}
+}
+
+int ILSpawnWaitForAny(int *status)
+{
+	int pid;
+	int result = 1;
+#ifdef HAVE_WAITPID
+	while((pid = waitpid(-1, &result, 0)) < 0 && errno == EINTR)
+	{
+		/* Interrupted by a signal: try again */
+	}
+#else
+	while((pid = wait(&result)) < 0 && errno == EINTR)
+	{
+		/* Interrupted by a signal: try again */
+	}
+#endif
+	if(pid < 0)
+	{
+		*status = -1;
+		return -1;
+	}
+	if(WIFEXITED(result))
+	{
+		*status = WEXITSTATUS(result);
+	}
+	else
+	{
+		if(WIFSIGNALLED(result) &&
+		   (ImportantSignal(WTERMSIG(result)) || WCOREDUMP(result)))
+		{
+			fprintf(stderr, "child process %d exited with signal %d%s\n",
+					pid, (int)(WTERMSIG(result)),
+					(WCOREDUMP(result) ? " (core dumped)" : ""));
+		}
+		*status = -1;
+	}
+	return pid;
+}
+
 #else
 
 /*
@@ -492,9 +604,214 @@ int ILSpawnProcessWaitForExit(int pid, char *argv[])
 	return -1;
 }
 
+int ILSpawnFunction(int (*func)(void *arg), void *arg,
+					void **output, void **errors)
+{
+	/* Not supported */
+	return 0;
+}
+
+int ILSpawnWaitForAny(int *status)
+{
+	/* Not supported */
+	*status = -1;
+	return -1;
+}
+
 #endif
 #endif
 
+/*
+ * Internal structure of a set of jobs that run in child processes.
+ */
+struct _tagILSpawnJobs
+{
+	int			numJobs;
+	int			maxRunning;
+	int			maxHeld;
+	FILE	   *output;
+	FILE	   *errors;
+	int			numStarted;
+	int			nextOutput;
+	int			running;
+	int			status;
+	int		   *pids;
+	FILE	  **outputs;
+	FILE	  **errorOutputs;
+
+};
+
+ILSpawnJobs *ILSpawnJobsCreate(int numJobs, int maxRunning, int maxHeld,
+							   void *output, void *errors)
+{
+	ILSpawnJobs *jobs = (ILSpawnJobs *)ILMalloc(sizeof(ILSpawnJobs));
+	if(!jobs)
+	{
+		return 0;
+	}
+	jobs->numJobs = numJobs;
+	jobs->maxRunning = (maxRunning > 0 ? maxRunning : 1);
+	jobs->maxHeld = (maxHeld > jobs->maxRunning ? maxHeld : jobs->maxRunning);
+	jobs->output = (FILE *)output;
+	jobs->errors = (FILE *)errors;
+	jobs->numStarted = 0;
+	jobs->nextOutput = 0;
+	jobs->running = 0;
+	jobs->status = 0;
+	jobs->pids = (int *)ILCalloc(numJobs + 1, sizeof(int));
+	jobs->outputs = (FILE **)ILCalloc(numJobs + 1, sizeof(FILE *));
+	jobs->errorOutputs = (FILE **)ILCalloc(numJobs + 1, sizeof(FILE *));
+	if(!(jobs->pids) || !(jobs->outputs) || !(jobs->errorOutputs))
+	{
+		ILFree(jobs->pids);
+		ILFree(jobs->outputs);
+		ILFree(jobs->errorOutputs);
+		ILFree(jobs);
+		return 0;
+	}
+	return jobs;
+}
+
+/*
+ * Copy the captured output of a child process to a stream.
+ */
+static void CopyCapturedOutput(FILE *captured, FILE *stream)
+{
+	char buffer[BUFSIZ];
+	size_t len;
+	if(captured)
+	{
+		rewind(captured);
+		while((len = fread(buffer, 1, sizeof(buffer), captured)) > 0)
+		{
+			fwrite(buffer, 1, len, stream);
+		}
+		fclose(captured);
+	}
+}
+
+/*
+ * Copy the output of the jobs that are done, in job order.
+ */
+static void CopyFinishedOutputs(ILSpawnJobs *jobs)
+{
+	while(jobs->nextOutput < jobs->numStarted &&
+		  jobs->pids[jobs->nextOutput] <= 0)
+	{
+		CopyCapturedOutput(jobs->outputs[jobs->nextOutput], jobs->output);
+		fflush(jobs->output);
+		CopyCapturedOutput(jobs->errorOutputs[jobs->nextOutput],
+						   jobs->errors);
+		fflush(jobs->errors);
+		jobs->outputs[jobs->nextOutput] = 0;
+		jobs->errorOutputs[jobs->nextOutput] = 0;
+		++(jobs->nextOutput);
+	}
+}
+
+/*
+ * Wait for one of the running jobs to exit.
+ */
+static void WaitForJob(ILSpawnJobs *jobs)
+{
+	int pid, status, job;
+	pid = ILSpawnWaitForAny(&status);
+	if(pid < 0)
+	{
+		/* There is nothing left to wait for: treat the jobs as done */
+		for(job = jobs->nextOutput; job < jobs->numStarted; ++job)
+		{
+			if(jobs->pids[job] > 0)
+			{
+				jobs->pids[job] = 0;
+				if(!(jobs->status))
+				{
+					jobs->status = 1;
+				}
+			}
+		}
+		jobs->running = 0;
+		return;
+	}
+	for(job = jobs->nextOutput; job < jobs->numStarted; ++job)
+	{
+		if(jobs->pids[job] == pid)
+		{
+			jobs->pids[job] = 0;
+			--(jobs->running);
+			if(status && !(jobs->status))
+			{
+				jobs->status = (status < 0 ? 1 : status);
+			}
+			break;
+		}
+	}
+}
+
+int ILSpawnJobsStart(ILSpawnJobs *jobs, int (*func)(void *arg), void *arg)
+{
+	int pid;
+	void *output;
+	void *errors;
+
+	/* Wait until there is room for another child, and until the
+	   output of enough earlier jobs has been copied out */
+	for(;;)
+	{
+		CopyFinishedOutputs(jobs);
+		if(jobs->running < jobs->maxRunning &&
+		   (jobs->numStarted - jobs->nextOutput) < jobs->maxHeld)
+		{
+			break;
+		}
+		WaitForJob(jobs);
+	}
+
+	/* Launch the child process */
+	pid = ILSpawnFunction(func, arg, &output, &errors);
+	if(pid > 0)
+	{
+		jobs->pids[jobs->numStarted] = pid;
+		jobs->outputs[jobs->numStarted] = (FILE *)output;
+		jobs->errorOutputs[jobs->numStarted] = (FILE *)errors;
+		++(jobs->running);
+		++(jobs->numStarted);
+	}
+	else if(pid < 0)
+	{
+		jobs->pids[jobs->numStarted] = -1;
+		++(jobs->numStarted);
+		if(!(jobs->status))
+		{
+			jobs->status = 1;
+		}
+	}
+	return pid;
+}
+
+void ILSpawnJobsSkip(ILSpawnJobs *jobs)
+{
+	jobs->pids[jobs->numStarted] = 0;
+	++(jobs->numStarted);
+	CopyFinishedOutputs(jobs);
+}
+
+int ILSpawnJobsFinish(ILSpawnJobs *jobs)
+{
+	int status;
+	while(jobs->running > 0)
+	{
+		WaitForJob(jobs);
+	}
+	CopyFinishedOutputs(jobs);
+	status = jobs->status;
+	ILFree(jobs->pids);
+	ILFree(jobs->outputs);
+	ILFree(jobs->errorOutputs);
+	ILFree(jobs);
+	return status;
+}
+
 #ifdef	__cplusplus
 };
 #endif
@@ -218,6 +218,11 @@ struct _tagILThread
 	ILWaitHandle					*monitor;
 	ILMonitor						*monitorFreeList;
 	ILUInt32						monitorFreeCount;
+	/* Monitor pool counters that are added to the pool on exit */
+	ILUInt32						monitorCacheHits;
+	ILUInt32						monitorCacheMisses;
+	ILUInt32						monitorContended;
+	ILUInt32						monitorDrains;
 	/* 1 if the gc knows the thread and is allowed to execute managed code */
 #if defined(IL_INTERRUPT_SUPPORTS)
 	ILInterruptHandler				interruptHandler;
@@ -0,0 +1,712 @@
+/*
+ * utf16_search.c - Search and compare kernels for UTF-16 buffers.
+ *
+ * Copyright (C) 2026  Free Software Foundation, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "il_system.h"
+#include "il_utils.h"
+
+/*
+ * Determine which vector kernels can be built.  SSE2 is used if the
+ * compiler targets it by default, which is always the case on x86_64.
+ * AVX2 kernels are compiled with a target attribute and only used
+ * if the CPU supports them at runtime.
+ */
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__)) && \
+	defined(__SSE2__)
+#define	IL_UTF16_SSE2	1
+#include <emmintrin.h>
+#if defined(__clang__) || __GNUC__ > 4 || \
+	(__GNUC__ == 4 && __GNUC_MINOR__ >= 9)
+#define	IL_UTF16_AVX2	1
+#include <immintrin.h>
+#endif
+#endif
+
+#ifdef	__cplusplus
+extern	"C" {
+#endif
+
+/*
+ * Table of kernel functions.
+ */
+typedef struct
+{
+	const char *name;
+	long (*indexOf)(const unsigned short *str, long len, unsigned short ch);
+	long (*lastIndexOf)(const unsigned short *str, long len,
+						unsigned short ch);
+	long (*indexOfAny)(const unsigned short *str, long len,
+					   const unsigned short *anyOf, long anyLen);
+	long (*lastIndexOfAny)(const unsigned short *str, long len,
+						   const unsigned short *anyOf, long anyLen);
+	long (*mismatch)(const unsigned short *str1,
+					 const unsigned short *str2, long len);
+	void (*replace)(unsigned short *dest, const unsigned short *src,
+					long len, unsigned short oldCh, unsigned short newCh);
+
+} ILUTF16Kernels;
+
+/*
+ * Maximum number of characters in an "anyOf" set that the vector
+ * kernels compare against directly.  Larger sets use the scalar code.
+ */
+#define	IL_UTF16_MAX_VECTOR_ANY		8
+
+/*
+ * Minimum number of characters that an "anyOf" search must cover
+ * before the vector kernels are used.  Shorter searches, and searches
+ * for larger sets, go straight to the scalar loops, because setting
+ * up the vectors costs more than it saves.
+ */
+#define	IL_UTF16_MIN_VECTOR_LEN		8
+
+/*
+ * Scalar kernels.
+ */
+static long ScalarIndexOf(const unsigned short *str, long len,
+						  unsigned short ch)
+{
+	const unsigned short *end = str + len;
+	const unsigned short *posn = str;
+	while(posn < end)
+	{
+		if(*posn == ch)
+		{
+			return (long)(posn - str);
+		}
+		++posn;
+	}
+	return -1;
+}
+
+static long ScalarLastIndexOf(const unsigned short *str, long len,
+							  unsigned short ch)
+{
+	const unsigned short *posn = str + len;
+	while(posn > str)
+	{
+		if(*(--posn) == ch)
+		{
+			return (long)(posn - str);
+		}
+	}
+	return -1;
+}
+
+/*
+ * Build a filter for an "anyOf" set, with one bit for the low 5 bits
+ * of every character in the set.  Characters whose bit is clear cannot
+ * be in the set, so the scalar loops only compare the others against
+ * the set, instead of comparing every character against every member.
+ */
+static ILUInt32 AnyFilter(const unsigned short *anyOf, long anyLen)
+{
+	ILUInt32 filter = 0;
+	while(anyLen > 0)
+	{
+		--anyLen;
+		filter |= (((ILUInt32)1) << (anyOf[anyLen] & 31));
+	}
+	return filter;
+}
+
+/*
+ * Determine if a character that passed the filter is in a set.
+ */
+static int InAnyOf(unsigned short ch, const unsigned short *anyOf, long anyLen)
+{
+	while(anyLen > 0)
+	{
+		--anyLen;
+		if(ch == anyOf[anyLen])
+		{
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static long ScalarIndexOfAny(const unsigned short *str, long len,
+							 const unsigned short *anyOf, long anyLen)
+{
+	ILUInt32 filter = AnyFilter(anyOf, anyLen);
+	long posn;
+	for(posn = 0; posn < len; ++posn)
+	{
+		if(((filter >> (str[posn] & 31)) & 1) != 0 &&
+		   InAnyOf(str[posn], anyOf, anyLen))
+		{
+			return posn;
+		}
+	}
+	return -1;
+}
+
+static long ScalarLastIndexOfAny(const unsigned short *str, long len,
+								 const unsigned short *anyOf, long anyLen)
+{
+	ILUInt32 filter = AnyFilter(anyOf, anyLen);
+	while(len > 0)
+	{
+		--len;
+		if(((filter >> (str[len] & 31)) & 1) != 0 &&
+		   InAnyOf(str[len], anyOf, anyLen))
+		{
+			return len;
+		}
+	}
+	return -1;
+}
+
+static long ScalarMismatch(const unsigned short *str1,
+						   const unsigned short *str2, long len)
+{
+	long posn;
+	for(posn = 0; posn < len; ++posn)
+	{
+		if(str1[posn] != str2[posn])
+		{
+			return posn;
+		}
+	}
+	return -1;
+}
+
+static void ScalarReplace(unsigned short *dest, const unsigned short *src,
+						  long len, unsigned short oldCh,
+						  unsigned short newCh)
+{
+	while(len > 0)
+	{
+		*dest++ = (*src == oldCh ? newCh : *src);
+		++src;
+		--len;
+	}
+}
+
+static const ILUTF16Kernels scalarKernels = {
+	"scalar",
+	ScalarIndexOf,
+	ScalarLastIndexOf,
+	ScalarIndexOfAny,
+	ScalarLastIndexOfAny,
+	ScalarMismatch,
+	ScalarReplace
+};
+
+#ifdef IL_UTF16_SSE2
+
+/*
+ * SSE2 kernels, which process 8 characters at a time.  The byte masks
+ * returned by "movemask" have two bits for every matching character.
+ */
+#define	SSE2_CHARS		8
+
+static long SSE2IndexOf(const unsigned short *str, long len,
+						unsigned short ch)
+{
+	__m128i value = _mm_set1_epi16((short)ch);
+	long posn = 0;
+	int mask;
+
+	while((len - posn) >= SSE2_CHARS)
+	{
+		mask = _mm_movemask_epi8(_mm_cmpeq_epi16
+			(_mm_loadu_si128((const __m128i *)(str + posn)), value));
+		if(mask != 0)
+		{
+			return posn + (__builtin_ctz(mask) >> 1);
+		}
+		posn += SSE2_CHARS;
+	}
+	len = ScalarIndexOf(str + posn, len - posn, ch);
+	return (len < 0 ? -1 : posn + len);
+}
+
+static long SSE2LastIndexOf(const unsigned short *str, long len,
+							unsigned short ch)
+{
+	__m128i value = _mm_set1_epi16((short)ch);
+	int mask;
+
+	while(len >= SSE2_CHARS)
+	{
+		len -= SSE2_CHARS;
+		mask = _mm_movemask_epi8(_mm_cmpeq_epi16
+			(_mm_loadu_si128((const __m128i *)(str + len)), value));
+		if(mask != 0)
+		{
+			return len + ((31 - __builtin_clz(mask)) >> 1);
+		}
+	}
+	return ScalarLastIndexOf(str, len, ch);
+}
+
+/*
+ * Compare 8 characters against a small "anyOf" set.
+ */
+static int SSE2AnyMask(__m128i chars, const __m128i *anyOf, long anyLen)
+{
+	__m128i result = _mm_cmpeq_epi16(chars, anyOf[0]);
+	long anyPosn;
+	for(anyPosn = 1; anyPosn < anyLen; ++anyPosn)
+	{
+		result = _mm_or_si128
+			(result, _mm_cmpeq_epi16(chars, anyOf[anyPosn]));
+	}
+	return _mm_movemask_epi8(result);
+}
+
+static long SSE2IndexOfAny(const unsigned short *str, long len,
+						   const unsigned short *anyOf, long anyLen)
+{
+	__m128i values[IL_UTF16_MAX_VECTOR_ANY];
+	long posn, anyPosn;
+	int mask;
+
+	if(anyLen > IL_UTF16_MAX_VECTOR_ANY)
+	{
+		return ScalarIndexOfAny(str, len, anyOf, anyLen);
+	}
+	for(anyPosn = 0; anyPosn < anyLen; ++anyPosn)
+	{
+		values[anyPosn] = _mm_set1_epi16((short)(anyOf[anyPosn]));
+	}
+	posn = 0;
+	while((len - posn) >= SSE2_CHARS)
+	{
+		mask = SSE2AnyMask(_mm_loadu_si128((const __m128i *)(str + posn)),
+						   values, anyLen);
+		if(mask != 0)
+		{
+			return posn + (__builtin_ctz(mask) >> 1);
+		}
+		posn += SSE2_CHARS;
+	}
+	len = ScalarIndexOfAny(str + posn, len - posn, anyOf, anyLen);
+	return (len < 0 ? -1 : posn + len);
+}
+
+static long SSE2LastIndexOfAny(const unsigned short *str, long len,
+							   const unsigned short *anyOf, long anyLen)
+{
+	__m128i values[IL_UTF16_MAX_VECTOR_ANY];
+	long anyPosn;
+	int mask;
+
+	if(anyLen > IL_UTF16_MAX_VECTOR_ANY)
+	{
+		return ScalarLastIndexOfAny(str, len, anyOf, anyLen);
+	}
+	for(anyPosn = 0; anyPosn < anyLen; ++anyPosn)
+	{
+		values[anyPosn] = _mm_set1_epi16((short)(anyOf[anyPosn]));
+	}
+	while(len >= SSE2_CHARS)
+	{
+		len -= SSE2_CHARS;
+		mask = SSE2AnyMask(_mm_loadu_si128((const __m128i *)(str + len)),
+						   values, anyLen);
+		if(mask != 0)
+		{
+			return len + ((31 - __builtin_clz(mask)) >> 1);
+		}
+	}
+	return ScalarLastIndexOfAny(str, len, anyOf, anyLen);
+}
+
+static long SSE2Mismatch(const unsigned short *str1,
+						 const unsigned short *str2, long len)
+{
+	long posn = 0;
+	int mask;
+
+	while((len - posn) >= SSE2_CHARS)
+	{
+		mask = _mm_movemask_epi8(_mm_cmpeq_epi16
+			(_mm_loadu_si128((const __m128i *)(str1 + posn)),
+			 _mm_loadu_si128((const __m128i *)(str2 + posn))));
+		if(mask != 0xFFFF)
+		{
+			return posn + (__builtin_ctz(~mask) >> 1);
+		}
+		posn += SSE2_CHARS;
+	}
+	len = ScalarMismatch(str1 + posn, str2 + posn, len - posn);
+	return (len < 0 ? -1 : posn + len);
+}
+
+static void SSE2Replace(unsigned short *dest, const unsigned short *src,
+						long len, unsigned short oldCh,
+						unsigned short newCh)
+{
+	__m128i oldValue = _mm_set1_epi16((short)oldCh);
+	__m128i newValue = _mm_set1_epi16((short)newCh);
+	__m128i chars, match;
+	long posn = 0;
+
+	while((len - posn) >= SSE2_CHARS)
+	{
+		chars = _mm_loadu_si128((const __m128i *)(src + posn));
+		match = _mm_cmpeq_epi16(chars, oldValue);
+		_mm_storeu_si128((__m128i *)(dest + posn),
+						 _mm_or_si128(_mm_andnot_si128(match, chars),
+									  _mm_and_si128(match, newValue)));
+		posn += SSE2_CHARS;
+	}
+	ScalarReplace(dest + posn, src + posn, len - posn, oldCh, newCh);
+}
+
+static const ILUTF16Kernels sse2Kernels = {
+	"sse2",
+	SSE2IndexOf,
+	SSE2LastIndexOf,
+	SSE2IndexOfAny,
+	SSE2LastIndexOfAny,
+	SSE2Mismatch,
+	SSE2Replace
+};
+
+#endif /* IL_UTF16_SSE2 */
+
+#ifdef IL_UTF16_AVX2
+
+/*
+ * AVX2 kernels, which process 16 characters at a time.  Tails that
+ * are shorter than a vector are handed to the SSE2 kernels, after
+ * clearing the upper halves of the vector registers.  Running SSE2 code
+ * with them dirty stalls every instruction on many CPUs.
+ */
+#define	AVX2_CHARS		16
+#define	AVX2_TARGET		__attribute__((target("avx2")))
+
+AVX2_TARGET static long AVX2IndexOf(const unsigned short *str, long len,
+									unsigned short ch)
+{
+	__m256i value = _mm256_set1_epi16((short)ch);
+	long posn = 0;
+	unsigned int mask;
+
+	while((len - posn) >= AVX2_CHARS)
+	{
+		mask = (unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi16
+			(_mm256_loadu_si256((const __m256i *)(str + posn)), value));
+		if(mask != 0)
+		{
+			return posn + (__builtin_ctz(mask) >> 1);
+		}
+		posn += AVX2_CHARS;
+	}
+	_mm256_zeroupper();
+	len = SSE2IndexOf(str + posn, len - posn, ch);
+	return (len < 0 ? -1 : posn + len);
+}
+
+AVX2_TARGET static long AVX2LastIndexOf(const unsigned short *str, long len,
+										unsigned short ch)
+{
+	__m256i value = _mm256_set1_epi16((short)ch);
+	unsigned int mask;
+
+	while(len >= AVX2_CHARS)
+	{
+		len -= AVX2_CHARS;
+		mask = (unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi16
+			(_mm256_loadu_si256((const __m256i *)(str + len)), value));
+		if(mask != 0)
+		{
+			return len + ((31 - __builtin_clz(mask)) >> 1);
+		}
+	}
+	_mm256_zeroupper();
+	return SSE2LastIndexOf(str, len, ch);
+}
+
+AVX2_TARGET static long AVX2IndexOfAny(const unsigned short *str, long len,
+									   const unsigned short *anyOf,
+									   long anyLen)
+{
+	__m256i values[IL_UTF16_MAX_VECTOR_ANY];
+	__m256i chars, result;
+	long posn, anyPosn;
+	unsigned int mask;
+
+	if(anyLen > IL_UTF16_MAX_VECTOR_ANY)
+	{
+		return ScalarIndexOfAny(str, len, anyOf, anyLen);
+	}
+	for(anyPosn = 0; anyPosn < anyLen; ++anyPosn)
+	{
+		values[anyPosn] = _mm256_set1_epi16((short)(anyOf[anyPosn]));
+	}
+	posn = 0;
+	while((len - posn) >= AVX2_CHARS)
+	{
+		chars = _mm256_loadu_si256((const __m256i *)(str + posn));
+		result = _mm256_cmpeq_epi16(chars, values[0]);
+		for(anyPosn = 1; anyPosn < anyLen; ++anyPosn)
+		{
+			result = _mm256_or_si256
+				(result, _mm256_cmpeq_epi16(chars, values[anyPosn]));
+		}
+		mask = (unsigned int)_mm256_movemask_epi8(result);
+		if(mask != 0)
+		{
+			return posn + (__builtin_ctz(mask) >> 1);
+		}
+		posn += AVX2_CHARS;
+	}
+	_mm256_zeroupper();
+	len = SSE2IndexOfAny(str + posn, len - posn, anyOf, anyLen);
+	return (len < 0 ? -1 : posn + len);
+}
+
+AVX2_TARGET static long AVX2LastIndexOfAny(const unsigned short *str,
+										   long len,
+										   const unsigned short *anyOf,
+										   long anyLen)
+{
+	__m256i values[IL_UTF16_MAX_VECTOR_ANY];
+	__m256i chars, result;
+	long anyPosn;
+	unsigned int mask;
+
+	if(anyLen > IL_UTF16_MAX_VECTOR_ANY)
+	{
+		return ScalarLastIndexOfAny(str, len, anyOf, anyLen);
+	}
+	for(anyPosn = 0; anyPosn < anyLen; ++anyPosn)
+	{
+		values[anyPosn] = _mm256_set1_epi16((short)(anyOf[anyPosn]));
+	}
+	while(len >= AVX2_CHARS)
+	{
+		len -= AVX2_CHARS;
+		chars = _mm256_loadu_si256((const __m256i *)(str + len));
+		result = _mm256_cmpeq_epi16(chars, values[0]);
+		for(anyPosn = 1; anyPosn < anyLen; ++anyPosn)
+		{
+			result = _mm256_or_si256
+				(result, _mm256_cmpeq_epi16(chars, values[anyPosn]));
+		}
+		mask = (unsigned int)_mm256_movemask_epi8(result);
+		if(mask != 0)
+		{
+			return len + ((31 - __builtin_clz(mask)) >> 1);
+		}
+	}
+	_mm256_zeroupper();
+	return SSE2LastIndexOfAny(str, len, anyOf, anyLen);
+}
+
+AVX2_TARGET static long AVX2Mismatch(const unsigned short *str1,
+									 const unsigned short *str2, long len)
+{
+	long posn = 0;
+	unsigned int mask;
+
+	while((len - posn) >= AVX2_CHARS)
+	{
+		mask = (unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi16
+			(_mm256_loadu_si256((const __m256i *)(str1 + posn)),
+			 _mm256_loadu_si256((const __m256i *)(str2 + posn))));
+		if(mask != 0xFFFFFFFFU)
+		{
+			return posn + (__builtin_ctz(~mask) >> 1);
+		}
+		posn += AVX2_CHARS;
+	}
+	_mm256_zeroupper();
+	len = SSE2Mismatch(str1 + posn, str2 + posn, len - posn);
+	return (len < 0 ? -1 : posn + len);
+}
+
+AVX2_TARGET static void AVX2Replace(unsigned short *dest,
+									const unsigned short *src, long len,
+									unsigned short oldCh,
+									unsigned short newCh)
+{
+	__m256i oldValue = _mm256_set1_epi16((short)oldCh);
+	__m256i newValue = _mm256_set1_epi16((short)newCh);
+	__m256i chars;
+	long posn = 0;
+
+	while((len - posn) >= AVX2_CHARS)
+	{
+		chars = _mm256_loadu_si256((const __m256i *)(src + posn));
+		_mm256_storeu_si256((__m256i *)(dest + posn),
+							_mm256_blendv_epi8
+								(chars, newValue,
+								 _mm256_cmpeq_epi16(chars, oldValue)));
+		posn += AVX2_CHARS;
+	}
+	_mm256_zeroupper();
+	SSE2Replace(dest + posn, src + posn, len - posn, oldCh, newCh);
+}
+
+static const ILUTF16Kernels avx2Kernels = {
+	"avx2",
+	AVX2IndexOf,
+	AVX2LastIndexOf,
+	AVX2IndexOfAny,
+	AVX2LastIndexOfAny,
+	AVX2Mismatch,
+	AVX2Replace
+};
+
+#endif /* IL_UTF16_AVX2 */
+
+/*
+ * Kernels that are currently in use.  Races on the initialization
+ * are harmless because all threads will select the same kernels.
+ */
+static const ILUTF16Kernels *kernels = 0;
+
+/*
+ * Get the kernels with a specific name, or the best kernels for
+ * this CPU if "name" is NULL.  Returns NULL if the kernels with
+ * the name are not supported.
+ */
+static const ILUTF16Kernels *FindKernels(const char *name)
+{
+#ifdef IL_UTF16_AVX2
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("avx2") &&
+	   (!name || !strcmp(name, avx2Kernels.name)))
+	{
+		return &avx2Kernels;
+	}
+#endif
+#ifdef IL_UTF16_SSE2
+	if(!name || !strcmp(name, sse2Kernels.name))
+	{
+		return &sse2Kernels;
+	}
+#endif
+	if(!name || !strcmp(name, scalarKernels.name))
+	{
+		return &scalarKernels;
+	}
+	return 0;
+}
+
+static const ILUTF16Kernels *GetKernels(void)
+{
+	if(!kernels)
+	{
+		kernels = FindKernels(0);
+	}
+	return kernels;
+}
+
+const char *ILUTF16UseKernels(const char *name)
+{
+	const ILUTF16Kernels *newKernels = FindKernels(name);
+	if(newKernels)
+	{
+		kernels = newKernels;
+	}
+	return GetKernels()->name;
+}
+
+long ILUTF16IndexOf(const unsigned short *str, long len, unsigned short ch)
+{
+	return (*(GetKernels()->indexOf))(str, len, ch);
+}
+
+long ILUTF16LastIndexOf(const unsigned short *str, long len,
+						unsigned short ch)
+{
+	return (*(GetKernels()->lastIndexOf))(str, len, ch);
+}
+
+long ILUTF16IndexOfAny(const unsigned short *str, long len,
+					   const unsigned short *anyOf, long anyLen)
+{
+	if(anyLen <= 0)
+	{
+		return -1;
+	}
+	else if(anyLen == 1)
+	{
+		return (*(GetKernels()->indexOf))(str, len, anyOf[0]);
+	}
+	else if(len < IL_UTF16_MIN_VECTOR_LEN || anyLen > IL_UTF16_MAX_VECTOR_ANY)
+	{
+		return ScalarIndexOfAny(str, len, anyOf, anyLen);
+	}
+	return (*(GetKernels()->indexOfAny))(str, len, anyOf, anyLen);
+}
+
+long ILUTF16LastIndexOfAny(const unsigned short *str, long len,
+						   const unsigned short *anyOf, long anyLen)
+{
+	if(anyLen <= 0)
+	{
+		return -1;
+	}
+	else if(anyLen == 1)
+	{
+		return (*(GetKernels()->lastIndexOf))(str, len, anyOf[0]);
+	}
+	else if(len < IL_UTF16_MIN_VECTOR_LEN || anyLen > IL_UTF16_MAX_VECTOR_ANY)
+	{
+		return ScalarLastIndexOfAny(str, len, anyOf, anyLen);
+	}
+	return (*(GetKernels()->lastIndexOfAny))(str, len, anyOf, anyLen);
+}
+
+long ILUTF16Mismatch(const unsigned short *str1,
+					 const unsigned short *str2, long len)
+{
+	return (*(GetKernels()->mismatch))(str1, str2, len);
+}
+
+int ILUTF16CompareOrdinal(const unsigned short *str1, long len1,
+						  const unsigned short *str2, long len2)
+{
+	long posn = (*(GetKernels()->mismatch))
+		(str1, str2, (len1 < len2 ? len1 : len2));
+	if(posn >= 0)
+	{
+		return (str1[posn] < str2[posn] ? -1 : 1);
+	}
+	else if(len1 > len2)
+	{
+		return 1;
+	}
+	else if(len1 < len2)
+	{
+		return -1;
+	}
+	else
+	{
+		return 0;
+	}
+}
+
+void ILUTF16Replace(unsigned short *dest, const unsigned short *src,
+					long len, unsigned short oldCh, unsigned short newCh)
+{
+	(*(GetKernels()->replace))(dest, src, len, oldCh, newCh);
+}
+
+#ifdef	__cplusplus
+};
+#endif
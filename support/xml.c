@@ -20,6 +20,7 @@
 
 #include "il_xml.h"
 #include "il_system.h"
+#include "il_utils.h"
 
 /*
 
@@ -29,80 +30,72 @@ UCS-2, UCS-4, EBCDIC, or some other stupid character encoding
 (UTF-8 or a byte-based character encoding is preferred).  If this
 is not the case, the results will be unexpected.
 
+The tokenizer works on ranges of an input window.  When reading from
+a file, the window is the whole file, mapped into memory if possible.
+Otherwise, the window is a buffer that is refilled from the stream,
+and which is grown whenever an item does not fit in it.  Tag names,
+parameters, and text are returned as views into the window, and are
+only copied if they contain entity references or characters that must
+be removed.  The NUL-terminated packed form that "ILXMLGetParam" and
+friends use is built from the views on demand.
+
 */
 
 #ifdef	__cplusplus
 extern	"C" {
 #endif
 
+/*
+ * View of a tag parameter.
+ */
+typedef struct
+{
+	const char	   *name;
+	int				nameLen;
+	const char	   *value;
+	int				valueLen;
+
+} ILXMLParam;
+
 /*
  * XML reader control data structure.
  */
-#define	IL_XML_BUFFER_SIZE	1024
+#define	IL_XML_BUFFER_SIZE	16384
 struct _tagILXMLReader
 {
+	/* Input window.  The unread input is between "posn" and "end" */
 	ILXMLReadFunc		readFunc;
 	void			   *data;
-	char				buffer[IL_XML_BUFFER_SIZE];
-	int					bufPosn, bufLen;
+	char			   *buffer;
+	int					bufSize;
+	const char		   *posn;
+	const char		   *end;
+	void			   *mapAddress;
+	unsigned long		mapLength;
+
+	/* Views of the current item */
+	const char		   *name;
+	int					nameLen;
+	int					withoutNamespace;
+	ILXMLParam		   *params;
+	int					numParams, maxParams;
+	const char		   *textView;
+	int					textViewLen;
+
+	/* Buffer for views that had to be decoded */
+	char			   *decode;
+	int					decodeLen, decodeMax;
+
+	/* Packed form of the current item */
 	char			   *text;
 	int					textLen, textMax;
-	int					withoutNamespace;
 	ILXMLItem			currentItem;
+	int					packed : 1;
 	int					whiteSpace : 1;
 	int					fixedTextMax : 1;
 	int					sawEOF : 1;
 };
 
-/*
- * Get the next character from an XML input stream.
- */
-static int XMLGetCh(ILXMLReader *reader)
-{
-	if(!(reader->sawEOF))
-	{
-		/* Read the next buffer from the input stream */
-		reader->bufLen = (*(reader->readFunc))(reader->data, reader->buffer,
-									           IL_XML_BUFFER_SIZE);
-		reader->bufPosn = 0;
-		if(reader->bufPosn < reader->bufLen)
-		{
-			return (((int)(reader->buffer[(reader->bufPosn)++])) & 0xFF);
-		}
-		else
-		{
-			/* We have reached EOF, or a read error occurred */
-			reader->sawEOF = 1;
-			return -1;
-		}
-	}
-	else
-	{
-		/* We are already at EOF */
-		return -1;
-	}
-}
-#define	XML_GETCH(ch)	\
-			do { \
-				if(reader->bufPosn < reader->bufLen) \
-				{ \
-					(ch) = (((int)(reader->buffer \
-									[(reader->bufPosn)++])) & 0xFF); \
-				} \
-				else \
-				{ \
-					(ch) = XMLGetCh(reader); \
-				} \
-			} while (0)
-
-/*
- * Unget the last character that was read.
- */
-#define	XML_UNGETCH()	\
-			do { \
-				--(reader->bufPosn); \
-			} while (0)
-
 /*
  * Determine if a character looks like white space.  We deliberately
  * avoid using "isspace" because it doesn't work properly with 8-bit
@@ -113,69 +106,19 @@ static int XMLGetCh(ILXMLReader *reader)
 			 (ch) == '\n' || (ch) == '\f' || (ch) == '\v')
 
 /*
- * Reset the text output buffer.
- */
-#define	TEXT_RESET()	\
-			do { \
-				reader->textLen = 0; \
-			} while (0)
-
-/*
- * Add a character to the text output buffer.
- */
-static void TextAddCh(ILXMLReader *reader, int ch)
-{
-	if(!(reader->fixedTextMax))
-	{
-		/* We leave one extra character for the terminating NUL */
-		char *newText = (char *)ILRealloc(reader->text, reader->textMax + 257);
-		if(newText)
-		{
-			reader->text = newText;
-			reader->textMax += 256;
-			reader->text[(reader->textLen)++] = (char)ch;
-		}
-	}
-}
-#define	TEXT_ADDCH(ch)	\
-			do { \
-				if(reader->textLen < reader->textMax) \
-				{ \
-					reader->text[(reader->textLen)++] = (char)(ch); \
-				} \
-				else \
-				{ \
-					TextAddCh(reader, (ch)); \
-				} \
-			} while (0)
-
-/*
- * Finalize the text output buffer.
+ * Allocate a reader and its buffers.
  */
-#define	TEXT_FINALIZE()	\
-			do { \
-				reader->text[reader->textLen] = '\0'; \
-			} while (0)
-
-ILXMLReader *ILXMLCreate(ILXMLReadFunc readFunc, void *data, int maxText)
+static ILXMLReader *CreateReader(int maxText)
 {
 	ILXMLReader *reader;
 
 	/* Allocate and initialize the reader */
-	if((reader = (ILXMLReader *)ILMalloc(sizeof(ILXMLReader))) == 0)
+	if((reader = (ILXMLReader *)ILCalloc(1, sizeof(ILXMLReader))) == 0)
 	{
 		return 0;
 	}
-	reader->readFunc = readFunc;
-	reader->data = data;
-	reader->bufPosn = 0;
-	reader->bufLen = 0;
-	reader->text = 0;
-	reader->textLen = 0;
-	reader->withoutNamespace = 0;
 	reader->currentItem = ILXMLItem_EOF;
-	reader->whiteSpace = 0;
-	reader->sawEOF = 0;
+	reader->packed = 1;
 
 	/* Allocate the initial text buffer */
 	if(maxText > 0)
@@ -198,13 +141,129 @@ ILXMLReader *ILXMLCreate(ILXMLReadFunc readFunc, void *data, int maxText)
 		reader->textMax = 256;
 		reader->fixedTextMax = 0;
 	}
+	reader->text[0] = '\0';
 
 	/* Ready to go */
 	return reader;
 }
 
+ILXMLReader *ILXMLCreate(ILXMLReadFunc readFunc, void *data, int maxText)
+{
+	ILXMLReader *reader;
+
+	if((reader = CreateReader(maxText)) == 0)
+	{
+		return 0;
+	}
+	if((reader->buffer = (char *)ILMalloc(IL_XML_BUFFER_SIZE)) == 0)
+	{
+		ILXMLDestroy(reader);
+		return 0;
+	}
+	reader->readFunc = readFunc;
+	reader->data = data;
+	reader->bufSize = IL_XML_BUFFER_SIZE;
+	reader->posn = reader->buffer;
+	reader->end = reader->buffer;
+	return reader;
+}
+
+ILXMLReader *ILXMLCreateFromBuffer(const char *buffer, unsigned long len,
+								   int maxText)
+{
+	ILXMLReader *reader;
+
+	if((reader = CreateReader(maxText)) == 0)
+	{
+		return 0;
+	}
+	reader->posn = buffer;
+	reader->end = buffer + len;
+	reader->sawEOF = 1;
+	return reader;
+}
+
+/*
+ * Read data from a stdio stream.
+ */
+static int StreamRead(void *data, void *buffer, int len)
+{
+	if(!feof((FILE *)data))
+	{
+		return (int)fread(buffer, 1, len, (FILE *)data);
+	}
+	else
+	{
+		return 0;
+	}
+}
+
+ILXMLReader *ILXMLCreateFromStream(FILE *stream, int maxText)
+{
+	ILXMLReader *reader;
+	long position;
+	long length;
+	void *mapAddress;
+	unsigned long mapLength;
+	char *data;
+
+	/* Determine the size of the rest of the stream, if it is seekable */
+	position = ftell(stream);
+	if(position != -1L && fseek(stream, 0L, SEEK_END) == 0)
+	{
+		length = ftell(stream);
+		if(length == position)
+		{
+			/* Empty file, or a device that cannot be mapped */
+			fseek(stream, position, SEEK_SET);
+		}
+		else if(length > position &&
+		        ILMapFileToMemory(fileno(stream), (unsigned long)position,
+								  (unsigned long)length, &mapAddress,
+								  &mapLength, &data))
+		{
+			/* Parse the file directly from the mapped memory */
+			reader = ILXMLCreateFromBuffer
+				(data, (unsigned long)(length - position), maxText);
+			if(reader)
+			{
+				reader->mapAddress = mapAddress;
+				reader->mapLength = mapLength;
+			}
+			else
+			{
+				ILUnmapFileFromMemory(mapAddress, mapLength);
+			}
+			return reader;
+		}
+		else
+		{
+			fseek(stream, position, SEEK_SET);
+		}
+	}
+
+	/* Read the stream in blocks */
+	return ILXMLCreate(StreamRead, stream, maxText);
+}
+
 void ILXMLDestroy(ILXMLReader *reader)
 {
+	if(reader->mapAddress)
+	{
+		ILUnmapFileFromMemory(reader->mapAddress, reader->mapLength);
+	}
+	if(reader->buffer)
+	{
+		ILFree(reader->buffer);
+	}
+	if(reader->params)
+	{
+		ILFree(reader->params);
+	}
+	if(reader->decode)
+	{
+		ILFree(reader->decode);
+	}
 	if(reader->text)
 	{
 		ILFree(reader->text);
@@ -213,22 +272,121 @@ void ILXMLDestroy(ILXMLReader *reader)
 }
 
 /*
- * Parse a named entity.
+ * Read more input into the window.  Returns zero at EOF, or if the
+ * window cannot be grown any further.  The window may move, so any
+ * pointers into it must be recomputed afterwards.
  */
-static int ParseEntity(ILXMLReader *reader)
+static int Refill(ILXMLReader *reader)
 {
-	int ch, ch2;
+	int len = (int)(reader->end - reader->posn);
+	char *newBuffer;
+
+	if(reader->sawEOF)
+	{
+		return 0;
+	}
+
+	/* Move the unread input to the front of the window */
+	if(reader->posn != reader->buffer)
+	{
+		ILMemMove(reader->buffer, reader->posn, len);
+		reader->posn = reader->buffer;
+		reader->end = reader->buffer + len;
+	}
+
+	/* Grow the window if the current item fills it.  If there is a
+	   limit on the text size, then we stop growing just beyond it,
+	   to avoid allocating arbitrary amounts of memory */
+	if(len >= reader->bufSize)
+	{
+		if(reader->fixedTextMax &&
+		   reader->bufSize >= reader->textMax + IL_XML_BUFFER_SIZE)
+		{
+			return 0;
+		}
+		newBuffer = (char *)ILRealloc(reader->buffer, reader->bufSize * 2);
+		if(!newBuffer)
+		{
+			return 0;
+		}
+		reader->buffer = newBuffer;
+		reader->bufSize *= 2;
+		reader->posn = newBuffer;
+		reader->end = newBuffer + len;
+	}
+
+	/* Read the next block from the input stream */
+	len = (*(reader->readFunc))(reader->data, reader->buffer + len,
+								reader->bufSize - len);
+	if(len <= 0)
+	{
+		/* We have reached EOF, or a read error occurred */
+		reader->sawEOF = 1;
+		return 0;
+	}
+	reader->end += len;
+	return 1;
+}
+
+/*
+ * Find a character in the unread input, starting "offset" bytes into
+ * it.  Returns the offset of the character, or -1 if it was not found.
+ */
+static long FindChar(ILXMLReader *reader, long offset, int ch)
+{
+	const char *found;
+	for(;;)
+	{
+		if(reader->posn + offset < reader->end)
+		{
+			found = (const char *)ILMemChr
+				(reader->posn + offset, ch,
+				 (unsigned long)(reader->end - reader->posn - offset));
+			if(found)
+			{
+				return (long)(found - reader->posn);
+			}
+			offset = (long)(reader->end - reader->posn);
+		}
+		if(!Refill(reader))
+		{
+			return -1;
+		}
+	}
+}
+
+/*
+ * Make sure that at least "len" bytes of unread input are in the
+ * window, if possible.  Returns the number of bytes available.
+ */
+static long Ensure(ILXMLReader *reader, long len)
+{
+	while((reader->end - reader->posn) < len && Refill(reader))
+	{
+		/* Keep reading until we have enough */
+	}
+	return (long)(reader->end - reader->posn);
+}
+
+/*
+ * Parse a named entity, just after the "&".
+ */
+static unsigned long ParseEntity(const char **posn, const char *end)
+{
+	const char *p = *posn;
+	unsigned long ch;
+	int ch2;
 	char name[16];
 	int namelen = 0;
-	XML_GETCH(ch);
-	while(ch != -1 && ch != ';')
+	while(p < end && *p != ';')
 	{
-		if(ch != 0 && namelen < 15)
+		if(*p != 0 && namelen < 15)
 		{
-			name[namelen++] = (char)ch;
+			name[namelen++] = *p;
 		}
-		XML_GETCH(ch);
+		++p;
 	}
+	*posn = (p < end ? p + 1 : p);
 	name[namelen] = '\0';
 	if(!strcmp(name, "lt"))
 	{
@@ -300,251 +458,389 @@ static int ParseEntity(ILXMLReader *reader)
 	}
 }
 
-ILXMLItem ILXMLReadNext(ILXMLReader *reader)
+/*
+ * Reserve space in the decode buffer for decoding "len" bytes of input.
+ * Decoding never makes a string longer, because the shortest entity
+ * for a multi-byte character is longer than its UTF-8 form.  Reserving
+ * the space up front means that the buffer does not move while the
+ * views for an item are being built.
+ */
+static void ReserveDecode(ILXMLReader *reader, long len)
 {
-	int ch, quote;
-	unsigned level;
-	XML_GETCH(ch);
-	while(ch != -1)
+	char *newDecode;
+	reader->decodeLen = 0;
+	if(len > (long)(reader->decodeMax))
 	{
-		if(ch == '<')
+		newDecode = (char *)ILRealloc(reader->decode, len + 256);
+		if(newDecode)
 		{
-			/* Start of a tag of some kind */
-			XML_GETCH(ch);
-			if(ch == '/')
+			reader->decode = newDecode;
+			reader->decodeMax = (int)(len + 256);
+		}
+	}
+}
+
+/*
+ * Ways to decode a range of input.
+ */
+#define	XML_DECODE_NAME		0	/* Remove white space and NUL's */
+#define	XML_DECODE_VALUE	1	/* Expand entities and remove NUL's */
+
+/*
+ * Get the view for a range of input, stopping when "limit" bytes have
+ * been produced.  The range is used as-is if possible, and otherwise
+ * it is decoded into the decode buffer.  On return, "*end" is the end
+ * of the input that was used, and "*len" is the length of the view.
+ */
+static const char *Decode(ILXMLReader *reader, const char *start,
+						  const char **end, int mode, long limit, int *len)
+{
+	const char *p = start;
+	const char *stop = *end;
+	char *out;
+	char *outStart;
+	char *outLimit;
+	unsigned long ch;
+
+	/* Look for a character that needs special handling */
+	if(mode == XML_DECODE_NAME)
+	{
+		while(p < stop && *p != 0 && !XML_ISSPACE(*p))
+		{
+			++p;
+		}
+	}
+	else
+	{
+		/* Values and text can be long, so use "memchr" to search them */
+		p = (const char *)ILMemChr(start, '&', (unsigned long)(stop - start));
+		if(!p)
+		{
+			p = stop;
+		}
+		if(ILMemChr(start, 0, (unsigned long)(p - start)) != 0)
+		{
+			p = (const char *)ILMemChr(start, 0, (unsigned long)(p - start));
+		}
+	}
+	if(p >= stop || (reader->decodeMax - reader->decodeLen) < (stop - start))
+	{
+		/* Use the range as-is */
+		if((stop - start) > limit)
+		{
+			stop = start + limit;
+			*end = stop;
+		}
+		*len = (int)(stop - start);
+		return start;
+	}
+
+	/* Copy the range into the decode buffer */
+	outStart = reader->decode + reader->decodeLen;
+	outLimit = outStart + limit;
+	out = outStart;
+	if((p - start) > limit)
+	{
+		p = start + limit;
+	}
+	ILMemCpy(out, start, (int)(p - start));
+	out += (int)(p - start);
+	while(p < stop && out < outLimit)
+	{
+		if(*p == 0 || (mode == XML_DECODE_NAME && XML_ISSPACE(*p)))
+		{
+			++p;
+		}
+		else if(*p == '&' && mode != XML_DECODE_NAME)
+		{
+			++p;
+			ch = ParseEntity(&p, stop);
+			if(ch >= 0x80)
 			{
-				/* End tag */
-				TEXT_RESET();
-				XML_GETCH(ch);
-				reader->withoutNamespace = 0;
-				while(ch != -1 && ch != '>' && !XML_ISSPACE(ch))
-				{
-					if(ch != 0)
-					{
-						TEXT_ADDCH(ch);
-						if(ch == ':')
-						{
-							reader->withoutNamespace = reader->textLen;
-						}
-					}
-					XML_GETCH(ch);
-				}
-				while(ch != -1 && ch != '>')
-				{
-					/* Skip the rest of the tag after the name,
-					   which we don't care about */
-					XML_GETCH(ch);
-				}
-				TEXT_FINALIZE();
-				reader->currentItem = ILXMLItem_EndTag;
-				return ILXMLItem_EndTag;
+				out += ILUTF8WriteChar(out, ch);
 			}
-			else if(ch == '?')
+			else if(ch != 0)
 			{
-				/* Processing instruction: skip it */
-				XML_GETCH(ch);
-				while(ch != -1 && ch != '>')
-				{
-					XML_GETCH(ch);
-				}
-				XML_GETCH(ch);
+				*out++ = (char)ch;
 			}
-			else if(ch == '!')
+		}
+		else
+		{
+			*out++ = *p++;
+		}
+	}
+	*end = p;
+	*len = (int)(out - outStart);
+	reader->decodeLen += *len;
+	return outStart;
+}
+
+/*
+ * Set the name of the current tag.
+ */
+static void SetTagName(ILXMLReader *reader, const char *start,
+					   const char *end)
+{
+	int len;
+	reader->name = Decode(reader, start, &end, XML_DECODE_NAME,
+						  0x7FFFFFFFL, &(reader->nameLen));
+	len = reader->nameLen;
+	while(len > 0 && reader->name[len - 1] != ':')
+	{
+		--len;
+	}
+	reader->withoutNamespace = len;
+}
+
+/*
+ * Parse a start or singleton tag between "p" and "end".
+ * The "<" and ">" are not included in the range.
+ */
+static ILXMLItem ParseTag(ILXMLReader *reader, const char *p, const char *end)
+{
+	const char *start;
+	const char *stop;
+	ILXMLParam *param;
+	int quote;
+
+	/* Parse the tag name */
+	ReserveDecode(reader, (long)(end - p));
+	start = p;
+	while(p < end && *p != '/' && !XML_ISSPACE(*p))
+	{
+		++p;
+	}
+	SetTagName(reader, start, p);
+
+	/* Parse the tag's parameters */
+	reader->numParams = 0;
+	while(p < end && *p != '/')
+	{
+		/* Skip white space before the next parameter */
+		while(p < end && XML_ISSPACE(*p))
+		{
+			++p;
+		}
+		if(p >= end || *p == '/')
+		{
+			break;
+		}
+
+		/* Allocate space for the parameter */
+		if(reader->numParams >= reader->maxParams)
+		{
+			param = (ILXMLParam *)ILRealloc
+				(reader->params, sizeof(ILXMLParam) * (reader->maxParams + 8));
+			if(!param)
 			{
-				/* Comment or document type definition command: skip it */
-				XML_GETCH(ch);
-				if(ch == '-')
-				{
-					XML_GETCH(ch);
-					if(ch == '-')
-					{
-						/* Skip the comment */
-						XML_GETCH(ch);
-						while(ch != -1)
-						{
-							if(ch == '-')
-							{
-								XML_GETCH(ch);
-								while(ch == '-')
-								{
-									XML_GETCH(ch);
-									if(ch == '>')
-									{
-										ch = -2;
-										break;
-									}
-								}
-								if(ch == -2)
-								{
-									break;
-								}
-							}
-							XML_GETCH(ch);
-						}
-						XML_GETCH(ch);
-						continue;
-					}
-				}
+				break;
+			}
+			reader->params = param;
+			reader->maxParams += 8;
+		}
+		param = &(reader->params[(reader->numParams)++]);
 
-				/* Probably some kind of DTD definition tag */
-				level = 0;
-				while(ch != -1 && (ch != '>' || level > 0))
-				{
-					if(ch == '[')
-					{
-						++level;
-					}
-					else if(ch == ']' && level > 0)
-					{
-						--level;
-					}
-					XML_GETCH(ch);
-				}
-				XML_GETCH(ch);
+		/* Parse the parameter name */
+		start = p;
+		while(p < end && *p != '/' && *p != '=')
+		{
+			++p;
+		}
+		stop = p;
+		param->name = Decode(reader, start, &stop, XML_DECODE_NAME,
+							 0x7FFFFFFFL, &(param->nameLen));
+		param->value = p;
+		param->valueLen = 0;
+
+		/* Parse the parameter value */
+		if(p < end && *p == '=')
+		{
+			do
+			{
+				++p;
 			}
-			else
+			while(p < end && XML_ISSPACE(*p));
+			if(p < end && (*p == '"' || *p == '\''))
 			{
-				/* Start or singleton tag: parse the name */
-				TEXT_RESET();
-				reader->withoutNamespace = 0;
-				while(ch != -1 && ch != '>' && ch != '/' && !XML_ISSPACE(ch))
+				quote = *p++;
+				start = p;
+				p = (const char *)ILMemChr(start, quote,
+										   (unsigned long)(end - start));
+				if(!p)
 				{
-					if(ch != 0)
-					{
-						TEXT_ADDCH(ch);
-						if(ch == ':')
-						{
-							reader->withoutNamespace = reader->textLen;
-						}
-					}
-					XML_GETCH(ch);
+					p = end;
 				}
-				TEXT_ADDCH('\0');
-
-				/* Parse the tag's parameters */
-				while(ch != -1 && ch != '>' && ch != '/')
+				stop = p;
+				param->value = Decode(reader, start, &stop, XML_DECODE_VALUE,
+									  0x7FFFFFFFL, &(param->valueLen));
+				if(p < end)
 				{
-					/* Skip white space before the next parameter */
-					while(XML_ISSPACE(ch))
-					{
-						XML_GETCH(ch);
-					}
-					if(ch == -1 || ch == '>' || ch == '/')
-					{
-						break;
-					}
-
-					/* Parse the parameter name */
-					while(ch != -1 && ch != '>' && ch != '/' && ch != '=')
-					{
-						if(!XML_ISSPACE(ch) && ch != 0)
-						{
-							TEXT_ADDCH(ch);
-						}
-						XML_GETCH(ch);
-					}
-					TEXT_ADDCH('\0');
-
-					/* Parse the parameter value */
-					if(ch == '=')
-					{
-						do
-						{
-							XML_GETCH(ch);
-						}
-						while(XML_ISSPACE(ch));
-						if(ch == '"' || ch == '\'')
-						{
-							quote = ch;
-							XML_GETCH(ch);
-							while(ch != -1 && ch != '>' && ch != quote)
-							{
-								if(ch != '&')
-								{
-									if(ch != 0)
-									{
-										TEXT_ADDCH(ch);
-									}
-								}
-								else
-								{
-									ch = ParseEntity(reader);
-									if(ch != 0)
-									{
-										TEXT_ADDCH(ch);
-									}
-								}
-								XML_GETCH(ch);
-							}
-							if(ch == quote)
-							{
-								XML_GETCH(ch);
-							}
-						}
-					}
-					TEXT_ADDCH('\0');
+					++p;
 				}
+			}
+		}
+	}
 
-				/* Terminate the parameter list */
-				TEXT_FINALIZE();
+	/* Determine the kind of tag */
+	if(p < end && *p == '/')
+	{
+		return ILXMLItem_SingletonTag;
+	}
+	else
+	{
+		return ILXMLItem_StartTag;
+	}
+}
 
-				/* Parse the end of the tag */
-				if(ch == '/')
-				{
-					do
-					{
-						XML_GETCH(ch);
-					}
-					while(ch != -1 && ch != '>');
-					reader->currentItem = ILXMLItem_SingletonTag;
-					return ILXMLItem_SingletonTag;
-				}
-				else
-				{
-					reader->currentItem = ILXMLItem_StartTag;
-					return ILXMLItem_StartTag;
-				}
+/*
+ * Skip a comment, starting "offset" bytes into the unread input.
+ */
+static void SkipComment(ILXMLReader *reader, long offset)
+{
+	long posn;
+	for(;;)
+	{
+		posn = FindChar(reader, offset, '-');
+		if(posn < 0)
+		{
+			reader->posn = reader->end;
+			return;
+		}
+		if(Ensure(reader, posn + 3) >= posn + 3 &&
+		   reader->posn[posn + 1] == '-' && reader->posn[posn + 2] == '>')
+		{
+			reader->posn += posn + 3;
+			return;
+		}
+
+		/* Discard what we have scanned, so that long comments
+		   do not need to fit in the window */
+		reader->posn += posn + 1;
+		offset = 0;
+	}
+}
+
+/*
+ * Skip a document type definition, starting "offset" bytes
+ * into the unread input.
+ */
+static void SkipDefinition(ILXMLReader *reader, long offset)
+{
+	unsigned level = 0;
+	int ch;
+	for(;;)
+	{
+		if(reader->posn + offset >= reader->end)
+		{
+			reader->posn = reader->end;
+			offset = 0;
+			if(!Refill(reader))
+			{
+				return;
 			}
+			continue;
 		}
-		else if(reader->whiteSpace || !XML_ISSPACE(ch))
+		ch = reader->posn[offset++];
+		if(ch == '>' && level == 0)
+		{
+			reader->posn += offset;
+			return;
+		}
+		else if(ch == '[')
+		{
+			++level;
+		}
+		else if(ch == ']' && level > 0)
+		{
+			--level;
+		}
+	}
+}
+
+ILXMLItem ILXMLReadNext(ILXMLReader *reader)
+{
+	const char *start;
+	const char *stop;
+	long posn, avail;
+	int ch, next;
+
+	reader->packed = 0;
+	for(;;)
+	{
+		if(reader->posn >= reader->end && !Refill(reader))
 		{
-			/* Start of a text block, which may include entities */
-			TEXT_RESET();
-			TEXT_ADDCH(ch);
-			XML_GETCH(ch);
-			while(ch != -1 && ch != '<')
+			break;
+		}
+		ch = *(reader->posn);
+		if(ch == '<')
+		{
+			/* Start of a tag of some kind */
+			avail = Ensure(reader, 4);
+			next = (avail > 1 ? reader->posn[1] : -1);
+			if(next == '/')
 			{
-				if(reader->fixedTextMax &&
-				   reader->textLen >= reader->textMax)
+				/* End tag: we only need the name */
+				posn = FindChar(reader, 2, '>');
+				start = reader->posn + 2;
+				stop = (posn >= 0 ? reader->posn + posn : reader->end);
+				reader->posn = (posn >= 0 ? stop + 1 : stop);
+				ReserveDecode(reader, (long)(stop - start));
+				for(posn = 0; (start + posn) < stop &&
+							  !XML_ISSPACE(start[posn]); ++posn)
 				{
-					/* Split large text blocks if we are using
-					   a fixed-sized buffer */
-					break;
+					/* Skip the rest of the tag after the name,
+					   which we don't care about */
 				}
-				if(ch != '&')
+				SetTagName(reader, start, start + posn);
+				reader->currentItem = ILXMLItem_EndTag;
+				return ILXMLItem_EndTag;
+			}
+			else if(next == '?')
+			{
+				/* Processing instruction: skip it */
+				posn = FindChar(reader, 2, '>');
+				reader->posn = (posn >= 0 ? reader->posn + posn + 1
+										  : reader->end);
+			}
+			else if(next == '!')
+			{
+				/* Comment or document type definition command: skip it */
+				if(avail >= 4 && reader->posn[2] == '-' &&
+				   reader->posn[3] == '-')
 				{
-					/* Ordinary character */
-					if(ch != 0)
-					{
-						TEXT_ADDCH(ch);
-					}
+					SkipComment(reader, 4);
 				}
 				else
 				{
-					/* Parse a named entity */
-					ch = ParseEntity(reader);
-					if(ch != 0)
-					{
-						TEXT_ADDCH(ch);
-					}
+					SkipDefinition
+						(reader, ((avail >= 3 && reader->posn[2] == '-')
+										? 3 : 2));
 				}
-				XML_GETCH(ch);
 			}
-			if(ch != -1)
+			else
 			{
-				XML_UNGETCH();
+				/* Start or singleton tag */
+				posn = FindChar(reader, 1, '>');
+				start = reader->posn + 1;
+				stop = (posn >= 0 ? reader->posn + posn : reader->end);
+				reader->posn = (posn >= 0 ? stop + 1 : stop);
+				reader->currentItem = ParseTag(reader, start, stop);
+				return reader->currentItem;
 			}
-			TEXT_FINALIZE();
+		}
+		else if(reader->whiteSpace || !XML_ISSPACE(ch))
+		{
+			/* Text block, which may include entities */
+			posn = FindChar(reader, 1, '<');
+			start = reader->posn;
+			stop = (posn >= 0 ? reader->posn + posn : reader->end);
+			ReserveDecode(reader, (long)(stop - start));
+			reader->textView = Decode
+				(reader, start, &stop, XML_DECODE_VALUE,
+				 (reader->fixedTextMax && reader->textMax > 0
+						? reader->textMax : 0x7FFFFFFFL),
+				 &(reader->textViewLen));
+			reader->posn = stop;
 			reader->currentItem = ILXMLItem_Text;
 			return ILXMLItem_Text;
 		}
@@ -553,15 +849,95 @@ ILXMLItem ILXMLReadNext(ILXMLReader *reader)
 			/* Skip non-significant white space */
 			do
 			{
-				XML_GETCH(ch);
+				++(reader->posn);
 			}
-			while(XML_ISSPACE(ch));
+			while(reader->posn < reader->end && XML_ISSPACE(*(reader->posn)));
 		}
 	}
 	reader->currentItem = ILXMLItem_EOF;
 	return ILXMLItem_EOF;
 }
 
+/*
+ * Add a string to the packed form of the current item.
+ */
+static void PackAdd(ILXMLReader *reader, const char *str, int len)
+{
+	char *newText;
+	if((reader->textMax - reader->textLen) < len)
+	{
+		if(!(reader->fixedTextMax))
+		{
+			/* We leave one extra character for the terminating NUL */
+			newText = (char *)ILRealloc(reader->text, reader->textLen + len +
+											          257);
+			if(newText)
+			{
+				reader->text = newText;
+				reader->textMax = reader->textLen + len + 256;
+			}
+		}
+		if((reader->textMax - reader->textLen) < len)
+		{
+			len = reader->textMax - reader->textLen;
+		}
+	}
+	ILMemCpy(reader->text + reader->textLen, str, len);
+	reader->textLen += len;
+}
+
+/*
+ * Build the packed form of the current item.  Tags are packed as the
+ * name followed by name/value pairs, each terminated by a NUL.
+ */
+static void Pack(ILXMLReader *reader)
+{
+	int param;
+	reader->textLen = 0;
+	switch(reader->currentItem)
+	{
+		case ILXMLItem_StartTag:
+		case ILXMLItem_SingletonTag:
+		{
+			PackAdd(reader, reader->name, reader->nameLen);
+			PackAdd(reader, "", 1);
+			for(param = 0; param < reader->numParams; ++param)
+			{
+				PackAdd(reader, reader->params[param].name,
+						reader->params[param].nameLen);
+				PackAdd(reader, "", 1);
+				PackAdd(reader, reader->params[param].value,
+						reader->params[param].valueLen);
+				PackAdd(reader, "", 1);
+			}
+		}
+		break;
+
+		case ILXMLItem_EndTag:
+		{
+			PackAdd(reader, reader->name, reader->nameLen);
+		}
+		break;
+
+		case ILXMLItem_Text:
+		{
+			PackAdd(reader, reader->textView, reader->textViewLen);
+		}
+		break;
+
+		default: break;
+	}
+	reader->text[reader->textLen] = '\0';
+	reader->packed = 1;
+}
+#define	PACK()	\
+			do { \
+				if(!(reader->packed)) \
+				{ \
+					Pack(reader); \
+				} \
+			} while (0)
+
 ILXMLItem ILXMLGetItem(ILXMLReader *reader)
 {
 	return reader->currentItem;
@@ -573,6 +949,11 @@ const char *ILXMLTagName(ILXMLReader *reader)
 	   reader->currentItem == ILXMLItem_SingletonTag ||
 	   reader->currentItem == ILXMLItem_EndTag)
 	{
+		PACK();
+		if(reader->withoutNamespace > reader->textLen)
+		{
+			return reader->text + reader->textLen;
+		}
 		return reader->text + reader->withoutNamespace;
 	}
 	else
@@ -587,6 +968,7 @@ const char *ILXMLTagNameWithNS(ILXMLReader *reader)
 	   reader->currentItem == ILXMLItem_SingletonTag ||
 	   reader->currentItem == ILXMLItem_EndTag)
 	{
+		PACK();
 		return reader->text;
 	}
 	else
@@ -595,25 +977,37 @@ const char *ILXMLTagNameWithNS(ILXMLReader *reader)
 	}
 }
 
+/*
+ * Determine if the name of the current tag is "name",
+ * with or without its namespace.
+ */
+static int TagNameIs(ILXMLReader *reader, const char *name)
+{
+	int len = strlen(name);
+
+	/* Check the name directly */
+	if(len == reader->nameLen && !ILMemCmp(reader->name, name, len))
+	{
+		return 1;
+	}
+
+	/* If the tag has a namespace, then strip it and retry */
+	if(reader->withoutNamespace)
+	{
+		return (len == (reader->nameLen - reader->withoutNamespace) &&
+				!ILMemCmp(reader->name + reader->withoutNamespace, name, len));
+	}
+	else
+	{
+		return 0;
+	}
+}
+
 int ILXMLIsStartTag(ILXMLReader *reader, const char *name)
 {
 	if(reader->currentItem == ILXMLItem_StartTag)
 	{
-		/* Check the name directly */
-		if(!strcmp(reader->text, name))
-		{
-			return 1;
-		}
-
-		/* If the tag has a namespace, then strip it and retry */
-		if(reader->withoutNamespace)
-		{
-			return (strcmp(reader->text + reader->withoutNamespace, name) == 0);
-		}
-		else
-		{
-			return 0;
-		}
+		return TagNameIs(reader, name);
 	}
 	else
 	{
@@ -626,21 +1020,7 @@ int ILXMLIsTag(ILXMLReader *reader, const char *name)
 	if(reader->currentItem == ILXMLItem_StartTag ||
 	   reader->currentItem == ILXMLItem_SingletonTag)
 	{
-		/* Check the name directly */
-		if(!strcmp(reader->text, name))
-		{
-			return 1;
-		}
-
-		/* If the tag has a namespace, then strip it and retry */
-		if(reader->withoutNamespace)
-		{
-			return (strcmp(reader->text + reader->withoutNamespace, name) == 0);
-		}
-		else
-		{
-			return 0;
-		}
+		return TagNameIs(reader, name);
 	}
 	else
 	{
@@ -674,7 +1054,9 @@ const char *ILXMLGetParam(ILXMLReader *reader, const char *name)
 	if(reader->currentItem == ILXMLItem_StartTag ||
 	   reader->currentItem == ILXMLItem_SingletonTag)
 	{
-		char *str = NextString(reader, reader->text);
+		char *str;
+		PACK();
+		str = NextString(reader, reader->text);
 		while(*str != '\0')
 		{
 			if(!strcmp(str, name))
@@ -695,6 +1077,7 @@ const char *ILXMLGetText(ILXMLReader *reader)
 {
 	if(reader->currentItem == ILXMLItem_Text)
 	{
+		PACK();
 		return reader->text;
 	}
 	else
@@ -703,6 +1086,57 @@ const char *ILXMLGetText(ILXMLReader *reader)
 	}
 }
 
+const char *ILXMLTagNameView(ILXMLReader *reader, int *len)
+{
+	if(reader->currentItem == ILXMLItem_StartTag ||
+	   reader->currentItem == ILXMLItem_SingletonTag ||
+	   reader->currentItem == ILXMLItem_EndTag)
+	{
+		*len = reader->nameLen - reader->withoutNamespace;
+		return reader->name + reader->withoutNamespace;
+	}
+	else
+	{
+		*len = 0;
+		return 0;
+	}
+}
+
+const char *ILXMLGetParamView(ILXMLReader *reader, const char *name, int *len)
+{
+	int nameLen = strlen(name);
+	int param;
+	if(reader->currentItem == ILXMLItem_StartTag ||
+	   reader->currentItem == ILXMLItem_SingletonTag)
+	{
+		for(param = 0; param < reader->numParams; ++param)
+		{
+			if(reader->params[param].nameLen == nameLen &&
+			   !ILMemCmp(reader->params[param].name, name, nameLen))
+			{
+				*len = reader->params[param].valueLen;
+				return reader->params[param].value;
+			}
+		}
+	}
+	*len = 0;
+	return 0;
+}
+
+const char *ILXMLGetTextView(ILXMLReader *reader, int *len)
+{
+	if(reader->currentItem == ILXMLItem_Text)
+	{
+		*len = reader->textViewLen;
+		return reader->textView;
+	}
+	else
+	{
+		*len = 0;
+		return 0;
+	}
+}
+
 char *ILXMLGetContents(ILXMLReader *reader, int whiteSpace)
 {
 	int oldWhite;
@@ -711,6 +1145,7 @@ char *ILXMLGetContents(ILXMLReader *reader, int whiteSpace)
 	char *newValue;
 	ILXMLItem item;
 	unsigned long depth;
+	int len;
 
 	/* Bail if immediately if we are not positioned on a start tag */
 	if(reader->currentItem != ILXMLItem_StartTag)
@@ -740,18 +1175,18 @@ char *ILXMLGetContents(ILXMLReader *reader, int whiteSpace)
 		}
 		else if(item == ILXMLItem_Text)
 		{
+			len = reader->textViewLen;
 			if(!whiteSpace)
 			{
 				/* Strip white space from the end of the text.
 				   ILXMLReadItem has already stripped any white
 				   space from the front of the text */
-				while(reader->textLen > 0 &&
-					  XML_ISSPACE(reader->text[reader->textLen - 1]))
+				while(len > 0 && XML_ISSPACE(reader->textView[len - 1]))
 				{
-					--(reader->textLen);
+					--len;
 				}
 			}
-			newValue = (char *)ILRealloc(value, valueLen + reader->textLen + 1);
+			newValue = (char *)ILRealloc(value, valueLen + len + 1);
 			if(!newValue)
 			{
 				if(value)
@@ -762,8 +1197,8 @@ char *ILXMLGetContents(ILXMLReader *reader, int whiteSpace)
 				return 0;
 			}
 			value = newValue;
-			ILMemCpy(value + valueLen, reader->text, reader->textLen);
-			valueLen += reader->textLen;
+			ILMemCpy(value + valueLen, reader->textView, len);
+			valueLen += len;
 		}
 	}
 
@@ -814,11 +1249,13 @@ void ILXMLWhiteSpace(ILXMLReader *reader, int flag)
 
 int ILXMLGetPackedSize(ILXMLReader *reader)
 {
+	PACK();
 	return reader->textLen + 1;
 }
 
 void ILXMLGetPacked(ILXMLReader *reader, void *buffer)
 {
+	PACK();
 	ILMemCpy(buffer, reader->text, reader->textLen + 1);
 }
 
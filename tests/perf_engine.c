@@ -0,0 +1,2225 @@
+/*
+ * perf_engine.c - Micro benchmarks for the runtime engine.
+ *
+ * Copyright (C) 2010  Southern Storm Software, Pty Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ilunit.h"
+#include "../engine/engine.h"
+#include "../engine/lib_defs.h"
+#include "../engine/int_proto.h"
+#include "../engine/method_cache.h"
+#include "interlocked.h"
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#if defined(HAVE_SYS_SOCKET_H) && !defined(IL_WIN32_NATIVE)
+#include <sys/types.h>
+#include <sys/socket.h>
+#endif
+
+#ifdef	__cplusplus
+extern	"C" {
+#endif
+
+/*
+ * The process all benchmarks are run in.  It is created with the
+ * null coder so no managed code can be run.
+ */
+static ILExecProcess *process;
+
+/*
+ * Get the number of milliseconds elapsed since "start".
+ */
+static ILInt64 elapsedMs(ILCurrTime *start)
+{
+	ILCurrTime now;
+
+	ILGetSinceRebootTime(&now);
+	return (now.secs - start->secs) * 1000 +
+		   ((ILInt64)now.nsecs - (ILInt64)start->nsecs) / 1000000;
+}
+
+/*
+ * Report the throughput of a benchmark.
+ */
+static void reportRate(const char *what, ILInt64 ops, ILInt64 ms)
+{
+	if(ms <= 0)
+	{
+		ms = 1;
+	}
+	printf("%lld %s/ms ... ", (long long)(ops / ms), what);
+	fflush(stdout);
+}
+
+/*
+ * Allocate a dummy object that can be used for locking.  The object
+ * doesn't have a class so it must not be passed to managed code.
+ */
+static ILObject *allocObject(void)
+{
+	void *ptr = ILGCAlloc(IL_OBJECT_HEADER_SIZE + sizeof(ILNativeInt));
+	if(!ptr)
+	{
+		ILUnitOutOfMemory();
+	}
+	return GetObjectFromGcBase(ptr);
+}
+
+/*
+ * Number of objects each thread locks in turn and the
+ * number of Enter/Exit pairs each thread performs.
+ */
+#define	MONITOR_OBJECTS		64
+#define	MONITOR_ITERATIONS	200000
+#define	MONITOR_MAX_THREADS	16
+
+/*
+ * The object to monitor table is only used with thin locks.  Otherwise
+ * the monitor is found through the lock word in the object header.
+ */
+#ifdef IL_CONFIG_USE_THIN_LOCKS
+#define	MONITOR_LOCK_KIND	"thin locks"
+#else
+#define	MONITOR_LOCK_KIND	"header locks"
+#endif
+
+/*
+ * Get the number of processors that the benchmark threads can run on.
+ * The monitor benchmarks only show how the monitor table scales when
+ * there is more than one.
+ */
+static int monitorProcessors(void)
+{
+#ifdef _SC_NPROCESSORS_ONLN
+	long num = sysconf(_SC_NPROCESSORS_ONLN);
+	if(num > 0)
+	{
+		return (int)num;
+	}
+#endif
+	return 1;
+}
+
+typedef struct
+{
+	ILObject  *objects[MONITOR_OBJECTS];
+	int		   failed;
+
+} MonitorBenchArgs;
+
+/*
+ * Perform Monitor.Enter/Monitor.Exit pairs on the objects passed
+ * in the argument block.
+ */
+static void monitorBenchThread(void *arg)
+{
+	MonitorBenchArgs *args = (MonitorBenchArgs *)arg;
+	ILExecThread *thread;
+	ILObject *obj;
+	int iter;
+
+	thread = ILThreadRegisterForManagedExecution(process, ILThreadSelf());
+	if(!thread)
+	{
+		args->failed = 1;
+		return;
+	}
+	for(iter = 0; iter < MONITOR_ITERATIONS; ++iter)
+	{
+		obj = args->objects[iter % MONITOR_OBJECTS];
+		_IL_Monitor_Enter(thread, obj);
+		_IL_Monitor_Exit(thread, obj);
+		if(_ILExecThreadHasException(thread))
+		{
+			args->failed = 1;
+			break;
+		}
+	}
+	ILThreadUnregisterForManagedExecution(ILThreadSelf());
+}
+
+/*
+ * Run Monitor.Enter/Monitor.Exit pairs on a number of threads.
+ * If "shared" is zero each thread locks its own objects, which
+ * measures the scalability of the object to monitor mapping.
+ * Otherwise all threads contend for the same objects.
+ */
+static void monitorBench(int numThreads, int shared)
+{
+	ILThread *threads[MONITOR_MAX_THREADS];
+	MonitorBenchArgs *args[MONITOR_MAX_THREADS];
+	ILCurrTime start;
+	ILInt64 ms;
+	int thread, obj;
+
+	for(thread = 0; thread < numThreads; ++thread)
+	{
+		args[thread] = (MonitorBenchArgs *)ILGCAlloc(sizeof(MonitorBenchArgs));
+		if(!(args[thread]))
+		{
+			ILUnitOutOfMemory();
+		}
+		for(obj = 0; obj < MONITOR_OBJECTS; ++obj)
+		{
+			if(shared && thread > 0)
+			{
+				args[thread]->objects[obj] = args[0]->objects[obj];
+			}
+			else
+			{
+				args[thread]->objects[obj] = allocObject();
+			}
+		}
+		if(!(threads[thread] = ILThreadCreate(monitorBenchThread,
+											  args[thread])))
+		{
+			ILUnitOutOfMemory();
+		}
+	}
+
+	ILGetSinceRebootTime(&start);
+	for(thread = 0; thread < numThreads; ++thread)
+	{
+		ILThreadStart(threads[thread]);
+	}
+	for(thread = 0; thread < numThreads; ++thread)
+	{
+		ILThreadJoin(threads[thread], -1);
+		ILThreadDestroy(threads[thread]);
+	}
+	ms = elapsedMs(&start);
+
+	for(thread = 0; thread < numThreads; ++thread)
+	{
+		if(args[thread]->failed)
+		{
+			ILUnitFailed("Monitor.Enter/Exit failed on thread %d", thread);
+		}
+	}
+	printf("%s on %d cpu(s) ... ", MONITOR_LOCK_KIND, monitorProcessors());
+	reportRate("enter+exit", (ILInt64)numThreads * MONITOR_ITERATIONS, ms);
+}
+
+static void monitor_private_1(void *arg)
+{
+	monitorBench(1, 0);
+}
+
+static void monitor_private_2(void *arg)
+{
+	monitorBench(2, 0);
+}
+
+static void monitor_private_4(void *arg)
+{
+	monitorBench(4, 0);
+}
+
+static void monitor_private_8(void *arg)
+{
+	monitorBench(8, 0);
+}
+
+static void monitor_private_16(void *arg)
+{
+	monitorBench(16, 0);
+}
+
+static void monitor_shared_4(void *arg)
+{
+	monitorBench(4, 1);
+}
+
+#ifdef IL_CONFIG_RUNTIME_INFRA
+
+/*
+ * Number of handles each thread keeps alive at a time, the number
+ * of times each thread allocates them, and the target reads per handle.
+ */
+#define	GC_HANDLE_LIVE			16
+#define	GC_HANDLE_ROUNDS		20000
+#define	GC_HANDLE_READS			4
+#define	GC_HANDLE_MAX_THREADS	16
+
+typedef struct
+{
+	ILObject  *objects[GC_HANDLE_LIVE];
+	ILInt32	   type;
+	int		   failed;
+
+} GCHandleBenchArgs;
+
+/*
+ * Allocate handles for the objects in the argument block, read their
+ * targets back, and free them again.
+ */
+static void gcHandleBenchThread(void *arg)
+{
+	GCHandleBenchArgs *args = (GCHandleBenchArgs *)arg;
+	ILInt32 handles[GC_HANDLE_LIVE];
+	ILExecThread *thread;
+	int round, posn, read;
+
+	thread = ILThreadRegisterForManagedExecution(process, ILThreadSelf());
+	if(!thread)
+	{
+		args->failed = 1;
+		return;
+	}
+	for(round = 0; round < GC_HANDLE_ROUNDS && !(args->failed); ++round)
+	{
+		for(posn = 0; posn < GC_HANDLE_LIVE; ++posn)
+		{
+			handles[posn] = _IL_GCHandle_GCAlloc
+				(thread, args->objects[posn], args->type);
+			if(!(handles[posn]))
+			{
+				args->failed = 1;
+			}
+		}
+		for(read = 0; read < GC_HANDLE_READS; ++read)
+		{
+			for(posn = 0; posn < GC_HANDLE_LIVE; ++posn)
+			{
+				if(_IL_GCHandle_GCGetTarget(thread, handles[posn]) !=
+						args->objects[posn])
+				{
+					args->failed = 1;
+				}
+			}
+		}
+		for(posn = 0; posn < GC_HANDLE_LIVE; ++posn)
+		{
+			_IL_GCHandle_GCFree(thread, handles[posn]);
+		}
+	}
+	ILThreadUnregisterForManagedExecution(ILThreadSelf());
+}
+
+/*
+ * Run GCHandle.Alloc/Target/Free on a number of threads,
+ * using handles of the given type.
+ */
+static void gcHandleBench(int numThreads, ILInt32 type)
+{
+	ILThread *threads[GC_HANDLE_MAX_THREADS];
+	GCHandleBenchArgs *args[GC_HANDLE_MAX_THREADS];
+	ILCurrTime start;
+	ILInt64 ms;
+	int thread, obj;
+
+	for(thread = 0; thread < numThreads; ++thread)
+	{
+		args[thread] = (GCHandleBenchArgs *)ILGCAlloc(sizeof(GCHandleBenchArgs));
+		if(!(args[thread]))
+		{
+			ILUnitOutOfMemory();
+		}
+		for(obj = 0; obj < GC_HANDLE_LIVE; ++obj)
+		{
+			args[thread]->objects[obj] = allocObject();
+		}
+		args[thread]->type = type;
+		if(!(threads[thread] = ILThreadCreate(gcHandleBenchThread,
+											  args[thread])))
+		{
+			ILUnitOutOfMemory();
+		}
+	}
+
+	ILGetSinceRebootTime(&start);
+	for(thread = 0; thread < numThreads; ++thread)
+	{
+		ILThreadStart(threads[thread]);
+	}
+	for(thread = 0; thread < numThreads; ++thread)
+	{
+		ILThreadJoin(threads[thread], -1);
+		ILThreadDestroy(threads[thread]);
+	}
+	ms = elapsedMs(&start);
+
+	for(thread = 0; thread < numThreads; ++thread)
+	{
+		if(args[thread]->failed)
+		{
+			ILUnitFailed("GCHandle operation failed on thread %d", thread);
+		}
+	}
+	reportRate("alloc+target+free",
+			   (ILInt64)numThreads * GC_HANDLE_ROUNDS * GC_HANDLE_LIVE, ms);
+}
+
+static void gc_handle_pinned_1(void *arg)
+{
+	gcHandleBench(1, 3 /* GCHandleType.Pinned */);
+}
+
+static void gc_handle_pinned_4(void *arg)
+{
+	gcHandleBench(4, 3 /* GCHandleType.Pinned */);
+}
+
+static void gc_handle_pinned_16(void *arg)
+{
+	gcHandleBench(16, 3 /* GCHandleType.Pinned */);
+}
+
+static void gc_handle_weak_1(void *arg)
+{
+	gcHandleBench(1, 0 /* GCHandleType.Weak */);
+}
+
+static void gc_handle_weak_4(void *arg)
+{
+	gcHandleBench(4, 0 /* GCHandleType.Weak */);
+}
+
+#endif /* IL_CONFIG_RUNTIME_INFRA */
+
+/*
+ * Number of distinct strings interned by the intern table benchmarks.
+ */
+#define	INTERN_STRINGS		100000
+#define	INTERN_LOOKUPS		4
+#define	INTERN_THREADS		4
+
+/*
+ * Allocate a string containing the decimal representation of "num".
+ * The string doesn't have a class so it must not be passed to
+ * managed code.
+ */
+static System_String *allocNumberString(ILInt32 num)
+{
+	char buf[32];
+	System_String *str;
+	ILUInt16 *chars;
+	int len, posn;
+	void *ptr;
+
+	len = sprintf(buf, "str%ld", (long)num);
+	ptr = ILGCAllocAtomic(IL_OBJECT_HEADER_SIZE + sizeof(System_String) +
+						  len * sizeof(ILUInt16));
+	if(!ptr)
+	{
+		ILUnitOutOfMemory();
+	}
+	str = (System_String *)GetObjectFromGcBase(ptr);
+	str->capacity = len;
+	str->length = len;
+	chars = StringToBuffer(str);
+	for(posn = 0; posn < len; ++posn)
+	{
+		chars[posn] = (ILUInt16)(buf[posn]);
+	}
+	return str;
+}
+
+/*
+ * Allocate the strings used by the intern table benchmarks.
+ */
+static System_String **allocNumberStrings(ILInt32 first, ILInt32 count)
+{
+	System_String **strings;
+	ILInt32 posn;
+
+	strings = (System_String **)ILGCAlloc(sizeof(System_String *) * count);
+	if(!strings)
+	{
+		ILUnitOutOfMemory();
+	}
+	for(posn = 0; posn < count; ++posn)
+	{
+		strings[posn] = allocNumberString(first + posn);
+	}
+	return strings;
+}
+
+/*
+ * Intern a large number of distinct strings, which forces the
+ * intern table to grow, and then look them all up again.
+ */
+static void intern_grow(void *arg)
+{
+	ILExecThread *thread = ILExecProcessGetMain(process);
+	System_String **strings;
+	System_String **copies;
+	ILCurrTime start;
+	ILInt32 posn;
+	int lookup;
+
+	strings = allocNumberStrings(0x10000000, INTERN_STRINGS);
+	copies = allocNumberStrings(0x10000000, INTERN_STRINGS);
+
+	ILGetSinceRebootTime(&start);
+	for(posn = 0; posn < INTERN_STRINGS; ++posn)
+	{
+		if(_IL_String_Intern(thread, strings[posn]) !=
+				strings[posn])
+		{
+			ILUnitFailed("string %ld was not added to the intern table",
+						 (long)posn);
+		}
+	}
+	reportRate("adds", INTERN_STRINGS, elapsedMs(&start));
+
+	ILGetSinceRebootTime(&start);
+	for(lookup = 0; lookup < INTERN_LOOKUPS; ++lookup)
+	{
+		for(posn = 0; posn < INTERN_STRINGS; ++posn)
+		{
+			if(_IL_String_IsInterned(thread, copies[posn]) !=
+					strings[posn])
+			{
+				ILUnitFailed("string %ld was not found in the intern table",
+							 (long)posn);
+			}
+		}
+	}
+	reportRate("lookups", (ILInt64)INTERN_LOOKUPS * INTERN_STRINGS,
+			   elapsedMs(&start));
+}
+
+typedef struct
+{
+	System_String **strings;
+	System_String **results;
+	int				failed;
+
+} InternBenchArgs;
+
+/*
+ * Intern all strings in the argument block.
+ */
+static void internBenchThread(void *arg)
+{
+	InternBenchArgs *args = (InternBenchArgs *)arg;
+	ILExecThread *thread;
+	ILInt32 posn;
+
+	thread = ILThreadRegisterForManagedExecution(process, ILThreadSelf());
+	if(!thread)
+	{
+		args->failed = 1;
+		return;
+	}
+	for(posn = 0; posn < INTERN_STRINGS; ++posn)
+	{
+		args->results[posn] = _IL_String_Intern
+			(thread, args->strings[posn]);
+		if(!(args->results[posn]))
+		{
+			args->failed = 1;
+			break;
+		}
+	}
+	ILThreadUnregisterForManagedExecution(ILThreadSelf());
+}
+
+/*
+ * Intern the same set of strings on several threads at once.
+ * All threads must end up with the same instance for each value.
+ */
+static void intern_threads(void *arg)
+{
+	ILThread *threads[INTERN_THREADS];
+	InternBenchArgs *args[INTERN_THREADS];
+	ILCurrTime start;
+	ILInt64 ms;
+	ILInt32 posn;
+	int thread;
+
+	for(thread = 0; thread < INTERN_THREADS; ++thread)
+	{
+		args[thread] = (InternBenchArgs *)ILGCAlloc(sizeof(InternBenchArgs));
+		if(!(args[thread]))
+		{
+			ILUnitOutOfMemory();
+		}
+		args[thread]->strings = allocNumberStrings(0x20000000, INTERN_STRINGS);
+		args[thread]->results = (System_String **)
+			ILGCAlloc(sizeof(System_String *) * INTERN_STRINGS);
+		if(!(args[thread]->results))
+		{
+			ILUnitOutOfMemory();
+		}
+		if(!(threads[thread] = ILThreadCreate(internBenchThread,
+											  args[thread])))
+		{
+			ILUnitOutOfMemory();
+		}
+	}
+
+	ILGetSinceRebootTime(&start);
+	for(thread = 0; thread < INTERN_THREADS; ++thread)
+	{
+		ILThreadStart(threads[thread]);
+	}
+	for(thread = 0; thread < INTERN_THREADS; ++thread)
+	{
+		ILThreadJoin(threads[thread], -1);
+		ILThreadDestroy(threads[thread]);
+	}
+	ms = elapsedMs(&start);
+
+	for(thread = 0; thread < INTERN_THREADS; ++thread)
+	{
+		if(args[thread]->failed)
+		{
+			ILUnitFailed("String.Intern failed on thread %d", thread);
+		}
+		for(posn = 0; posn < INTERN_STRINGS; ++posn)
+		{
+			if(args[thread]->results[posn] != args[0]->results[posn])
+			{
+				ILUnitFailed("thread %d got a different instance of string %ld",
+							 thread, (long)posn);
+			}
+		}
+	}
+	reportRate("interns", (ILInt64)INTERN_THREADS * INTERN_STRINGS, ms);
+}
+
+/*
+ * Number of methods written by the method cache benchmarks, the
+ * number of lookup passes over them and the number of reader threads.
+ */
+#define	CACHE_METHODS		20000
+#define	CACHE_PASSES		20
+#define	CACHE_THREADS		4
+
+/*
+ * Entry points and sizes of the methods written to the cache.
+ * "cacheMethodsWritten" is published to the readers with release
+ * semantics after each method is written.
+ */
+typedef struct
+{
+	unsigned char  *start;
+	unsigned long	size;
+
+} CacheMethodInfo;
+static CacheMethodInfo *cacheMethods;
+static ILInt32 cacheMethodsWritten;
+static ILInt32 cacheWriterDone;
+
+/*
+ * Write a dummy method with two exception regions to the cache.
+ * The method is identified by its index plus one.  The first region
+ * has a NULL cookie and the second has the method plus CACHE_METHODS.
+ */
+static int writeCacheMethod(ILCache *cache, ILInt32 index)
+{
+	ILCachePosn posn;
+	unsigned char *start;
+	unsigned long size = 16 + (index % 7) * 8;
+	unsigned long offset;
+	int result;
+
+	do
+	{
+		start = (unsigned char *)ILCacheStartMethod
+			(cache, &posn, 1, (void *)(ILNativeInt)(index + 1));
+		if(!start)
+		{
+			return 0;
+		}
+		for(offset = 0; offset < size; ++offset)
+		{
+			if(offset == size / 2)
+			{
+				ILCacheNewRegion(&posn, (void *)(ILNativeInt)
+										(index + 1 + CACHE_METHODS));
+			}
+			ILCacheByte(&posn, offset);
+		}
+		result = ILCacheEndMethod(&posn);
+	}
+	while(result == IL_CACHE_END_RESTART);
+	if(result != IL_CACHE_END_OK)
+	{
+		return 0;
+	}
+	cacheMethods[index].start = start;
+	cacheMethods[index].size = size;
+	return 1;
+}
+
+/*
+ * Look up the first and last bytes of a method in the cache and check
+ * that the right method and exception region cookies are returned.
+ */
+static int checkCacheMethod(ILCache *cache, ILInt32 index)
+{
+	unsigned char *start = cacheMethods[index].start;
+	void *cookie = (void *)1;
+
+	if(ILCacheGetMethod(cache, start, &cookie) !=
+			(void *)(ILNativeInt)(index + 1) || cookie != 0)
+	{
+		return 0;
+	}
+	if(ILCacheGetMethod(cache, start + cacheMethods[index].size - 1,
+						&cookie) != (void *)(ILNativeInt)(index + 1) ||
+	   cookie != (void *)(ILNativeInt)(index + 1 + CACHE_METHODS))
+	{
+		return 0;
+	}
+	return 1;
+}
+
+/*
+ * Create a method cache and the method information table.
+ */
+static ILCache *createCache(void)
+{
+	ILCache *cache = ILCacheCreate(0, 0);
+	cacheMethods = (CacheMethodInfo *)ILCalloc
+		(CACHE_METHODS, sizeof(CacheMethodInfo));
+	if(!cache || !cacheMethods)
+	{
+		ILUnitOutOfMemory();
+	}
+	cacheMethodsWritten = 0;
+	cacheWriterDone = 0;
+	return cache;
+}
+
+/*
+ * Look up methods in a cache while it isn't being written to.
+ * The methods are visited in a pseudo-random order, like the
+ * frames of a stack walk.
+ */
+static void method_cache_lookup(void *arg)
+{
+	ILCache *cache = createCache();
+	void **list;
+	ILCurrTime start;
+	ILInt32 index;
+	ILUInt32 random = 1;
+	int pass;
+
+	for(index = 0; index < CACHE_METHODS; ++index)
+	{
+		if(!writeCacheMethod(cache, index))
+		{
+			ILUnitFailed("could not write method %ld", (long)index);
+		}
+	}
+
+	ILGetSinceRebootTime(&start);
+	for(pass = 0; pass < CACHE_PASSES; ++pass)
+	{
+		for(index = 0; index < CACHE_METHODS; ++index)
+		{
+			random = random * 1103515245 + 12345;
+			if(!checkCacheMethod(cache, (ILInt32)((random >> 8) % CACHE_METHODS)))
+			{
+				ILUnitFailed("lookup of method %ld failed",
+							 (long)((random >> 8) % CACHE_METHODS));
+			}
+		}
+	}
+	reportRate("lookups", (ILInt64)CACHE_PASSES * CACHE_METHODS * 2,
+			   elapsedMs(&start));
+
+	if(ILCacheGetMethod(cache, cacheMethods[0].start - 1, 0) != 0)
+	{
+		ILUnitFailed("address before the first method was found");
+	}
+	list = ILCacheGetMethodList(cache);
+	if(!list)
+	{
+		ILUnitOutOfMemory();
+	}
+	for(index = 0; list[index] != 0; ++index)
+	{
+		/* Count the methods */
+	}
+	ILFree(list);
+	if(index != CACHE_METHODS)
+	{
+		ILUnitFailed("method list has %ld entries instead of %ld",
+					 (long)index, (long)CACHE_METHODS);
+	}
+
+	ILCacheDestroy(cache);
+	ILFree(cacheMethods);
+}
+
+/*
+ * Arguments for a method cache reader thread.
+ */
+typedef struct
+{
+	ILCache		   *cache;
+	ILInt64			lookups;
+	ILInt32			failed;
+
+} CacheBenchArgs;
+
+/*
+ * Look up methods that have already been written until the
+ * writer has finished and at least CACHE_METHODS lookups are done.
+ */
+static void cacheBenchThread(void *arg)
+{
+	CacheBenchArgs *args = (CacheBenchArgs *)arg;
+	ILUInt32 random = (ILUInt32)(ILNativeUInt)arg;
+	ILInt32 written;
+
+	while(!ILInterlockedLoadI4_Acquire(&cacheWriterDone) ||
+		  args->lookups < CACHE_METHODS)
+	{
+		written = ILInterlockedLoadI4_Acquire(&cacheMethodsWritten);
+		if(!written)
+		{
+			ILThreadYield();
+			continue;
+		}
+		random = random * 1103515245 + 12345;
+		if(!checkCacheMethod(args->cache, (ILInt32)((random >> 8) % written)))
+		{
+			args->failed = 1;
+		}
+		++(args->lookups);
+	}
+}
+
+/*
+ * Look up methods on several threads while another thread is
+ * writing methods to the cache.
+ */
+static void method_cache_threads(void *arg)
+{
+	ILCache *cache = createCache();
+	ILThread *threads[CACHE_THREADS];
+	CacheBenchArgs args[CACHE_THREADS];
+	ILCurrTime start;
+	ILInt64 lookups;
+	ILInt64 ms;
+	ILInt32 index;
+	int thread;
+
+	for(thread = 0; thread < CACHE_THREADS; ++thread)
+	{
+		args[thread].cache = cache;
+		args[thread].lookups = 0;
+		args[thread].failed = 0;
+		if(!(threads[thread] = ILThreadCreate(cacheBenchThread,
+											  &(args[thread]))))
+		{
+			ILUnitOutOfMemory();
+		}
+	}
+
+	ILGetSinceRebootTime(&start);
+	for(thread = 0; thread < CACHE_THREADS; ++thread)
+	{
+		ILThreadStart(threads[thread]);
+	}
+	for(index = 0; index < CACHE_METHODS; ++index)
+	{
+		if(!writeCacheMethod(cache, index))
+		{
+			ILUnitFailed("could not write method %ld", (long)index);
+		}
+		ILInterlockedStoreI4_Release(&cacheMethodsWritten, index + 1);
+	}
+	ILInterlockedStoreI4_Release(&cacheWriterDone, 1);
+	lookups = 0;
+	for(thread = 0; thread < CACHE_THREADS; ++thread)
+	{
+		ILThreadJoin(threads[thread], -1);
+		ILThreadDestroy(threads[thread]);
+		lookups += args[thread].lookups;
+	}
+	ms = elapsedMs(&start);
+
+	for(thread = 0; thread < CACHE_THREADS; ++thread)
+	{
+		if(args[thread].failed)
+		{
+			ILUnitFailed("lookup failed on thread %d", thread);
+		}
+	}
+	reportRate("lookups", lookups * 2, ms);
+
+	ILCacheDestroy(cache);
+	ILFree(cacheMethods);
+}
+
+/*
+ * Number of lookups performed by the call site cache benchmarks and
+ * the number of distinct receiver classes used by the megamorphic test.
+ */
+#define	CALL_SITE_LOOKUPS	10000000
+#define	CALL_SITE_CLASSES	(IL_CALL_SITE_CACHE_SIZE * 2)
+
+/*
+ * Perform lookups at a call site that sees "numClasses" receiver classes
+ * in rotation, filling the cache on misses the way the engine does.
+ * The class and target pointers are dummies that are never dereferenced.
+ */
+static void callSiteBench(int numClasses)
+{
+	ILExecThread *thread = ILExecProcessGetMain(process);
+	static char classes[CALL_SITE_CLASSES];
+	ILCallSiteCache site;
+	ILClassPrivate *classPrivate;
+	ILUInt64 hits = thread->icHits;
+	ILUInt64 misses = thread->icMisses;
+	ILInt32 megamorphic = process->icMegamorphic;
+	ILCurrTime start;
+	void *target;
+	int iter;
+
+	ILMemZero(&site, sizeof(site));
+	ILGetSinceRebootTime(&start);
+	for(iter = 0; iter < CALL_SITE_LOOKUPS; ++iter)
+	{
+		classPrivate = (ILClassPrivate *)&(classes[iter % numClasses]);
+		target = _ILCallSiteCacheFind(thread, &site, classPrivate);
+		if(!target)
+		{
+			target = (void *)(((char *)classPrivate) + 1);
+			_ILCallSiteCacheAdd(process, &site, classPrivate, target);
+		}
+		else if(target != (void *)(((char *)classPrivate) + 1))
+		{
+			ILUnitFailed("call site cache returned the wrong target");
+		}
+	}
+	reportRate("lookups", CALL_SITE_LOOKUPS, elapsedMs(&start));
+
+	/* Check the statistics against the number of classes */
+	hits = thread->icHits - hits;
+	misses = thread->icMisses - misses;
+	megamorphic = process->icMegamorphic - megamorphic;
+	if(numClasses <= IL_CALL_SITE_CACHE_SIZE)
+	{
+		if(misses != (ILUInt64)numClasses || megamorphic != 0)
+		{
+			ILUnitFailed("%d classes gave %lu misses", numClasses,
+						 (unsigned long)misses);
+		}
+	}
+	else if(megamorphic != 1)
+	{
+		ILUnitFailed("megamorphic call site wasn't counted");
+	}
+	printf("%d%% hits ... ", (int)((hits * 100) / (hits + misses)));
+	fflush(stdout);
+}
+
+/*
+ * Call sites with one, several and too many receiver classes.
+ */
+static void call_site_mono(void *arg)
+{
+	callSiteBench(1);
+}
+static void call_site_poly(void *arg)
+{
+	callSiteBench(IL_CALL_SITE_CACHE_SIZE);
+}
+static void call_site_mega(void *arg)
+{
+	callSiteBench(CALL_SITE_CLASSES);
+}
+
+/*
+ * Sample rate and amount of CPU time used by the sampler test.
+ */
+#define	SAMPLE_RATE			1000
+#define	SAMPLE_TIME			200
+
+/*
+ * Check that the profiler's timer flags samples against the running
+ * thread and that reaching a safe point collects them.
+ */
+static void sampler_signals(void *arg)
+{
+	ILExecThread *thread = ILExecProcessGetMain(process);
+	ILCurrTime start;
+	ILInt32 pending;
+	volatile ILUInt32 spin = 0;
+
+	if(!ILExecProcessStartSampling(process, SAMPLE_RATE))
+	{
+		printf("not supported ... ");
+		fflush(stdout);
+		return;
+	}
+	ILGetSinceRebootTime(&start);
+	while(elapsedMs(&start) < SAMPLE_TIME)
+	{
+		++spin;
+	}
+	ILExecProcessStopSampling(process);
+
+	pending = thread->samplesPending;
+	if(pending <= 0 ||
+	   !(thread->managedSafePointFlags & _IL_MANAGED_SAFEPOINT_SAMPLE))
+	{
+		ILUnitFailed("no samples were flagged");
+	}
+	_ILSamplerRecord(thread, 0);
+	if(thread->samplesPending != 0 ||
+	   (thread->managedSafePointFlags & _IL_MANAGED_SAFEPOINT_SAMPLE) != 0)
+	{
+		ILUnitFailed("pending samples weren't collected at the safe point");
+	}
+	printf("%ld samples ... ", (long)pending);
+	fflush(stdout);
+}
+
+#if defined(IL_CONFIG_NETWORKING) && defined(HAVE_SYS_SOCKET_H) && \
+	!defined(IL_WIN32_NATIVE)
+#define	POLLER_TESTS_SUPPORTED	1
+#endif
+
+/*
+ * Number of operations that are queued to the socket poller.
+ */
+#define	POLLER_CYCLES		20000
+#define	POLLER_SLICES		10
+
+/*
+ * Queue operations for a socket to the process's socket poller one
+ * after the other.  Each one completes before the next can be queued,
+ * so the poller's table of pending operations is churned but never
+ * holds more than one operation.  The times of the first and last
+ * slices are reported, and should be about the same.
+ */
+static void socket_poller_churn(void *arg)
+{
+#ifdef POLLER_TESTS_SUPPORTED
+	ILExecThread *thread = ILExecProcessGetMain(process);
+	ILInt64 firstMs = 0, lastMs = 0, ms;
+	ILCurrTime start;
+	int fds[2];
+	int posn, slice;
+
+	if(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0)
+	{
+		ILUnitFailed("could not create a socket pair");
+	}
+	if(!_IL_SocketMethods_QueueReadyItem(thread, (ILNativeInt)(fds[0]),
+										 IL_SYSIO_POLL_WRITE, 0, 0))
+	{
+		printf("not supported ... ");
+		fflush(stdout);
+		ILSysIOSocketClose((ILSysIOHandle)(ILNativeInt)(fds[0]));
+		ILSysIOSocketClose((ILSysIOHandle)(ILNativeInt)(fds[1]));
+		return;
+	}
+	for(slice = 0; slice < POLLER_SLICES; ++slice)
+	{
+		ILGetSinceRebootTime(&start);
+		for(posn = 0; posn < POLLER_CYCLES / POLLER_SLICES; ++posn)
+		{
+			/* The socket is always writable, so the previous operation
+			   completes straight away and then this one is accepted */
+			while(!_IL_SocketMethods_QueueReadyItem
+					(thread, (ILNativeInt)(fds[0]), IL_SYSIO_POLL_WRITE, 0, 0))
+			{
+				if(elapsedMs(&start) > 10000)
+				{
+					ILUnitFailed("operation %d was never completed", posn);
+				}
+				ILThreadYield();
+			}
+		}
+		ms = elapsedMs(&start);
+		if(slice == 0)
+		{
+			firstMs = ms;
+		}
+		lastMs = ms;
+	}
+	printf("%lld ms -> %lld ms ... ", (long long)firstMs, (long long)lastMs);
+	fflush(stdout);
+
+	/* Close the socket through the poller, so that the last operation
+	   does not stay pending on a descriptor that may be reused */
+	_IL_SocketMethods_Close(thread, (ILNativeInt)(fds[0]));
+	ILSysIOSocketClose((ILSysIOHandle)(ILNativeInt)(fds[1]));
+#else
+	printf("not supported ... ");
+	fflush(stdout);
+#endif
+}
+
+#ifdef POLLER_TESTS_SUPPORTED
+
+/*
+ * Queue an operation to the socket poller, waiting for the previous
+ * operation in the same direction to complete first.
+ */
+static void queueReadyItem(ILExecThread *thread, int fd, ILInt32 events,
+						   const char *what)
+{
+	ILCurrTime start;
+	ILGetSinceRebootTime(&start);
+	while(!_IL_SocketMethods_QueueReadyItem
+			(thread, (ILNativeInt)fd, events, 0, 0))
+	{
+		if(elapsedMs(&start) > 10000)
+		{
+			ILUnitFailed("the %s operation was never completed", what);
+		}
+		ILThreadYield();
+	}
+}
+
+#endif /* POLLER_TESTS_SUPPORTED */
+
+/*
+ * Queue a read and a write operation for the same socket.  Both must
+ * be accepted by the poller, and the write must complete while the
+ * read is still waiting for data.
+ */
+static void socket_poller_directions(void *arg)
+{
+#ifdef POLLER_TESTS_SUPPORTED
+	ILExecThread *thread = ILExecProcessGetMain(process);
+	int fds[2];
+	int posn;
+
+	if(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0)
+	{
+		ILUnitFailed("could not create a socket pair");
+	}
+	if(!_IL_SocketMethods_QueueReadyItem(thread, (ILNativeInt)(fds[0]),
+										 IL_SYSIO_POLL_READ, 0, 0))
+	{
+		printf("not supported ... ");
+		fflush(stdout);
+		ILSysIOSocketClose((ILSysIOHandle)(ILNativeInt)(fds[0]));
+		ILSysIOSocketClose((ILSysIOHandle)(ILNativeInt)(fds[1]));
+		return;
+	}
+	if(!_IL_SocketMethods_QueueReadyItem(thread, (ILNativeInt)(fds[0]),
+										 IL_SYSIO_POLL_WRITE, 0, 0))
+	{
+		ILUnitFailed("a write was rejected while a read was waiting");
+	}
+
+	/* The socket is writable, so the writes keep completing, and the
+	   read must stay armed while they do */
+	for(posn = 0; posn < 100; ++posn)
+	{
+		queueReadyItem(thread, fds[0], IL_SYSIO_POLL_WRITE, "write");
+	}
+	if(_IL_SocketMethods_QueueReadyItem(thread, (ILNativeInt)(fds[0]),
+										IL_SYSIO_POLL_READ, 0, 0))
+	{
+		ILUnitFailed("the read completed before there was data");
+	}
+
+	/* Send some data, which should complete the read */
+	if(ILSysIOSocketSend((ILSysIOHandle)(ILNativeInt)(fds[1]),
+						 "x", 1, 0) != 1)
+	{
+		ILUnitFailed("could not write to the socket pair");
+	}
+	queueReadyItem(thread, fds[0], IL_SYSIO_POLL_READ, "read");
+	_IL_SocketMethods_Close(thread, (ILNativeInt)(fds[0]));
+	ILSysIOSocketClose((ILSysIOHandle)(ILNativeInt)(fds[1]));
+#else
+	printf("not supported ... ");
+	fflush(stdout);
+#endif
+}
+
+/*
+ * Algorithm number of AES in "Platform.CryptoMethods", and the size
+ * of the buffer that is encrypted by the crypto native benchmarks.
+ */
+#define	CRYPT_ALG_RIJNDAEL	8
+#define	CRYPT_LENGTH		65536
+#define	CRYPT_PASSES		500
+
+/*
+ * Allocate a "byte[]" array for passing to the crypto natives.
+ */
+static System_Array *allocByteArray(ILInt32 length)
+{
+	System_Array *array;
+	array = (System_Array *)ILGCAlloc(sizeof(System_Array) + length);
+	if(!array)
+	{
+		ILUnitOutOfMemory();
+	}
+	ArrayLength(array) = length;
+	return array;
+}
+
+/*
+ * Encrypt a buffer with AES one block at a time using "Encrypt",
+ * and then all at once using "EncryptBlocks", which pipelines the
+ * blocks.  Both must give the same result, and "DecryptBlocks"
+ * must give back the original buffer.  The times for "Encrypt"
+ * and "EncryptBlocks" are reported.
+ */
+static void crypt_aes_blocks(void *arg)
+{
+	ILExecThread *thread = ILExecProcessGetMain(process);
+	System_Array *key = allocByteArray(16);
+	System_Array *plain = allocByteArray(CRYPT_LENGTH);
+	System_Array *cipher1 = allocByteArray(CRYPT_LENGTH);
+	System_Array *cipher2 = allocByteArray(CRYPT_LENGTH);
+	unsigned char *buf;
+	ILNativeInt encrypt, decrypt;
+	ILCurrTime start;
+	ILInt64 msBlock, msBlocks;
+	int pass, posn;
+
+	buf = (unsigned char *)ArrayToBuffer(key);
+	for(posn = 0; posn < 16; ++posn)
+	{
+		buf[posn] = (unsigned char)(posn * 7 + 1);
+	}
+	buf = (unsigned char *)ArrayToBuffer(plain);
+	for(posn = 0; posn < CRYPT_LENGTH; ++posn)
+	{
+		buf[posn] = (unsigned char)(posn * 13 + (posn >> 8));
+	}
+	encrypt = _IL_CryptoMethods_EncryptCreate
+		(thread, CRYPT_ALG_RIJNDAEL, key);
+	decrypt = _IL_CryptoMethods_DecryptCreate
+		(thread, CRYPT_ALG_RIJNDAEL, key);
+	if(!encrypt || !decrypt)
+	{
+		ILUnitOutOfMemory();
+	}
+
+	ILGetSinceRebootTime(&start);
+	for(pass = 0; pass < CRYPT_PASSES; ++pass)
+	{
+		for(posn = 0; posn < CRYPT_LENGTH; posn += 16)
+		{
+			_IL_CryptoMethods_Encrypt(thread, encrypt, plain, posn,
+									  cipher1, posn);
+		}
+	}
+	msBlock = elapsedMs(&start);
+
+	ILGetSinceRebootTime(&start);
+	for(pass = 0; pass < CRYPT_PASSES; ++pass)
+	{
+		_IL_CryptoMethods_EncryptBlocks(thread, encrypt, plain, 0,
+										cipher2, 0, CRYPT_LENGTH);
+	}
+	msBlocks = elapsedMs(&start);
+
+	if(ILMemCmp(ArrayToBuffer(cipher1), ArrayToBuffer(cipher2),
+				CRYPT_LENGTH) != 0)
+	{
+		ILUnitFailed("EncryptBlocks differs from Encrypt");
+	}
+	_IL_CryptoMethods_DecryptBlocks(thread, decrypt, cipher2, 0,
+									cipher2, 0, CRYPT_LENGTH);
+	if(ILMemCmp(ArrayToBuffer(plain), ArrayToBuffer(cipher2),
+				CRYPT_LENGTH) != 0)
+	{
+		ILUnitFailed("DecryptBlocks did not give back the input");
+	}
+	_IL_CryptoMethods_SymmetricFree(thread, encrypt);
+	_IL_CryptoMethods_SymmetricFree(thread, decrypt);
+
+	printf("%lld ms -> %lld ms ... ", (long long)msBlock,
+		   (long long)msBlocks);
+}
+
+/*
+ * Number of methods in the class used by the named lookup benchmark,
+ * and the number of lookups to perform.
+ */
+#define	LOOKUP_METHODS		20
+#define	LOOKUP_ITERATIONS	1000000
+
+/*
+ * Create the class that is searched by the named lookup benchmark.
+ */
+static void createLookupClass(void)
+{
+	ILContext *context = ILExecProcessGetContext(process);
+	ILImage *image;
+	ILClass *classInfo;
+	ILMethod *method;
+	ILType *signature;
+	char name[16];
+	int index;
+
+	image = ILImageCreate(context);
+	if(!image || !ILModuleCreate(image, 0, "LookupBench", 0) ||
+	   !ILAssemblyCreate(image, 0, "LookupBench", 0))
+	{
+		ILUnitOutOfMemory();
+	}
+	classInfo = ILClassCreate(ILClassGlobalScope(image), 0,
+							  "LookupBench", "Bench", 0);
+	if(!classInfo)
+	{
+		ILUnitOutOfMemory();
+	}
+	for(index = 0; index < LOOKUP_METHODS; ++index)
+	{
+		sprintf(name, "M%d", index);
+		method = ILMethodCreate(classInfo, 0, name,
+								IL_META_METHODDEF_PUBLIC |
+								IL_META_METHODDEF_STATIC);
+		signature = ILTypeCreateMethod(context, ILType_Int32);
+		if(!method || !signature ||
+		   !ILTypeAddParam(context, signature, ILType_Int32))
+		{
+			ILUnitOutOfMemory();
+		}
+		ILMemberSetSignature((ILMember *)method, signature);
+	}
+}
+
+/*
+ * Look up a method by name the way the engine's internal calls do,
+ * with and without the per-process lookup cache.
+ */
+static void lookup_method(void *arg)
+{
+	ILExecThread *thread = ILExecProcessGetMain(process);
+	ILMethod *expected;
+	ILMethod *method;
+	ILClass *classInfo;
+	ILCurrTime start;
+	ILInt64 msUncached;
+	char name[16];
+	int iter;
+
+	createLookupClass();
+	expected = ILExecThreadLookupMethod
+		(thread, "Bench.LookupBench", "M19", "(i)i");
+	if(!expected)
+	{
+		ILUnitFailed("could not find the method");
+	}
+
+	/* Search the class and its methods every time */
+	ILGetSinceRebootTime(&start);
+	for(iter = 0; iter < LOOKUP_ITERATIONS; ++iter)
+	{
+		classInfo = _ILLookupClass(process, "Bench.LookupBench", 17);
+		method = ILExecThreadLookupMethodInClass
+			(thread, classInfo, "M19", "(i)i");
+		if(method != expected)
+		{
+			ILUnitFailed("uncached lookup returned the wrong method");
+		}
+	}
+	msUncached = elapsedMs(&start);
+
+	/* Use the cache */
+	ILGetSinceRebootTime(&start);
+	for(iter = 0; iter < LOOKUP_ITERATIONS; ++iter)
+	{
+		method = ILExecThreadLookupMethod
+			(thread, "Bench.LookupBench", "M19", "(i)i");
+		if(method != expected)
+		{
+			ILUnitFailed("cached lookup returned the wrong method");
+		}
+	}
+	printf("%lld ms -> %lld ms ... ", (long long)msUncached,
+		   (long long)elapsedMs(&start));
+	fflush(stdout);
+
+	/* Reusing a buffer for a different name must not hit the cache */
+	strcpy(name, "M19");
+	if(ILExecThreadLookupMethod(thread, "Bench.LookupBench",
+								name, "(i)i") != expected)
+	{
+		ILUnitFailed("lookup from a buffer returned the wrong method");
+	}
+	strcpy(name, "M18");
+	method = ILExecThreadLookupMethod(thread, "Bench.LookupBench",
+									  name, "(i)i");
+	if(!method || method == expected)
+	{
+		ILUnitFailed("reused buffer returned a stale method");
+	}
+}
+
+#ifdef IL_USE_CVM
+
+/*
+ * The process that the superinstruction benchmarks run code in.
+ * Unlike "process", it uses the CVM coder.
+ */
+static ILExecProcess *cvmProcess;
+static ILImage *superImage;
+static ILClass *superClass;
+
+/*
+ * Description of a method that is used to benchmark superinstructions.
+ * The method takes a single "int32" argument and returns an "int32".
+ */
+typedef struct
+{
+	const char			*name;
+	const unsigned char	*code;
+	unsigned long		 codeLen;
+	int					 numLocals;
+	ILInt32				 arg;
+	ILInt32			   (*expected)(ILInt32 n);
+
+} SuperBenchMethod;
+
+/*
+ * static int Sum(int n)
+ * {
+ *     int s = 0;
+ *     for(int i = 0; i < n; ++i) s += i;
+ *     return s;
+ * }
+ */
+static const unsigned char superSumCode[] = {
+	0x16, 0x0A, 0x16, 0x0B, 0x2B, 0x08, 0x06, 0x07,
+	0x58, 0x0A, 0x07, 0x17, 0x58, 0x0B, 0x07, 0x02,
+	0x32, 0xF4, 0x06, 0x2A
+};
+static ILInt32 superSumExpected(ILInt32 n)
+{
+	ILUInt32 s = 0;
+	ILInt32 i;
+	for(i = 0; i < n; ++i)
+	{
+		s += (ILUInt32)i;
+	}
+	return (ILInt32)s;
+}
+
+/*
+ * static int Nested(int n)
+ * {
+ *     int s = 0;
+ *     for(int i = 0; i < n; ++i)
+ *         for(int j = 0; j < 100; ++j) s += i * j;
+ *     return s;
+ * }
+ */
+static const unsigned char superNestedCode[] = {
+	0x16, 0x0A, 0x16, 0x0B, 0x2B, 0x17, 0x16, 0x0C,
+	0x2B, 0x0A, 0x06, 0x07, 0x08, 0x5A, 0x58, 0x0A,
+	0x08, 0x17, 0x58, 0x0C, 0x08, 0x1F, 0x64, 0x32,
+	0xF1, 0x07, 0x17, 0x58, 0x0B, 0x07, 0x02, 0x32,
+	0xE5, 0x06, 0x2A
+};
+static ILInt32 superNestedExpected(ILInt32 n)
+{
+	ILUInt32 s = 0;
+	ILInt32 i, j;
+	for(i = 0; i < n; ++i)
+	{
+		for(j = 0; j < 100; ++j)
+		{
+			s += (ILUInt32)i * (ILUInt32)j;
+		}
+	}
+	return (ILInt32)s;
+}
+
+/*
+ * static int GcdSum(int n)
+ * {
+ *     int s = 0;
+ *     for(int i = 1; i <= n; ++i)
+ *     {
+ *         int a = i, b = n;
+ *         while(b != 0) { int t = a % b; a = b; b = t; }
+ *         s += a;
+ *     }
+ *     return s;
+ * }
+ */
+static const unsigned char superGcdCode[] = {
+	0x16, 0x0A, 0x17, 0x0B, 0x2B, 0x1B, 0x07, 0x0C,
+	0x02, 0x0D, 0x2B, 0x0A, 0x08, 0x09, 0x5D, 0x13,
+	0x04, 0x09, 0x0C, 0x11, 0x04, 0x0D, 0x09, 0x2D,
+	0xF3, 0x06, 0x08, 0x58, 0x0A, 0x07, 0x17, 0x58,
+	0x0B, 0x07, 0x02, 0x31, 0xE1, 0x06, 0x2A
+};
+static ILInt32 superGcdExpected(ILInt32 n)
+{
+	ILUInt32 s = 0;
+	ILInt32 i, a, b, t;
+	for(i = 1; i <= n; ++i)
+	{
+		a = i;
+		b = n;
+		while(b != 0)
+		{
+			t = a % b;
+			a = b;
+			b = t;
+		}
+		s += (ILUInt32)a;
+	}
+	return (ILInt32)s;
+}
+
+/*
+ * static int Hash(int n)
+ * {
+ *     int h = 0;
+ *     for(int i = 0; i < n; ++i)
+ *     {
+ *         h = h * 31 + i;
+ *         if(((h ^ i) & 1023) < 512) h += 5;
+ *     }
+ *     return h;
+ * }
+ */
+static const unsigned char superHashCode[] = {
+	0x16, 0x0A, 0x16, 0x0B, 0x2B, 0x1F, 0x06, 0x1F,
+	0x1F, 0x5A, 0x07, 0x58, 0x0A, 0x06, 0x07, 0x61,
+	0x20, 0xFF, 0x03, 0x00, 0x00, 0x5F, 0x20, 0x00,
+	0x02, 0x00, 0x00, 0x2F, 0x04, 0x06, 0x1B, 0x58,
+	0x0A, 0x07, 0x17, 0x58, 0x0B, 0x07, 0x02, 0x32,
+	0xDD, 0x06, 0x2A
+};
+static ILInt32 superHashExpected(ILInt32 n)
+{
+	ILUInt32 h = 0;
+	ILInt32 i;
+	for(i = 0; i < n; ++i)
+	{
+		h = h * 31 + (ILUInt32)i;
+		if(((h ^ (ILUInt32)i) & 1023) < 512)
+		{
+			h += 5;
+		}
+	}
+	return (ILInt32)h;
+}
+
+static const SuperBenchMethod superSum =
+	{"Sum", superSumCode, sizeof(superSumCode), 2, 10000000,
+	 superSumExpected};
+static const SuperBenchMethod superNested =
+	{"Nested", superNestedCode, sizeof(superNestedCode), 3, 100000,
+	 superNestedExpected};
+static const SuperBenchMethod superGcd =
+	{"GcdSum", superGcdCode, sizeof(superGcdCode), 5, 1000000,
+	 superGcdExpected};
+static const SuperBenchMethod superHash =
+	{"Hash", superHashCode, sizeof(superHashCode), 2, 10000000,
+	 superHashExpected};
+
+/*
+ * Arguments for a superinstruction benchmark thread.  Index 0 of
+ * the results is for optimization level 0, which doesn't use
+ * superinstructions, and index 1 is for optimization level 1.
+ */
+typedef struct
+{
+	const SuperBenchMethod *info;
+	ILInt32					results[2];
+	ILInt64					ms[2];
+	int						failed;
+
+} SuperBenchArgs;
+
+/*
+ * Create a method from a benchmark description and convert it
+ * into CVM code at a specific optimization level.
+ */
+static ILMethod *createSuperMethod(ILExecThread *thread,
+								   const SuperBenchMethod *info,
+								   ILUInt32 level)
+{
+	ILContext *context = ILExecProcessGetContext(cvmProcess);
+	ILMethod *method;
+	ILType *signature;
+	ILType *locals;
+	ILMethodCode code;
+	unsigned char *start;
+	int local, ok;
+
+	method = ILMethodCreate(superClass, 0, info->name,
+							IL_META_METHODDEF_PUBLIC |
+							IL_META_METHODDEF_STATIC);
+	signature = ILTypeCreateMethod(context, ILType_Int32);
+	locals = ILTypeCreateLocalList(context);
+	if(!method || !signature || !locals ||
+	   !ILTypeAddParam(context, signature, ILType_Int32))
+	{
+		ILUnitOutOfMemory();
+	}
+	ILMemberSetSignature((ILMember *)method, signature);
+	for(local = 0; local < info->numLocals; ++local)
+	{
+		if(!ILTypeAddLocal(context, locals, ILType_Int32))
+		{
+			ILUnitOutOfMemory();
+		}
+	}
+
+	ILMemZero(&code, sizeof(code));
+	code.code = (void *)(info->code);
+	code.codeLen = (ILUInt32)(info->codeLen);
+	code.maxStack = 8;
+	code.initLocals = 1;
+	if((code.localVarSig = ILStandAloneSigCreate
+			(superImage, 0, locals)) == 0)
+	{
+		ILUnitOutOfMemory();
+	}
+
+	METADATA_WRLOCK(cvmProcess);
+	ILCoderSetOptimizationLevel(cvmProcess->coder, level);
+	ok = _ILVerify(cvmProcess->coder, &start, method, &code, 1, thread);
+	METADATA_UNLOCK(cvmProcess);
+	if(!ok)
+	{
+		return 0;
+	}
+	ILMethodSetUserData(method, start);
+	return method;
+}
+
+/*
+ * Convert and run a benchmark method at optimization levels 0 and 1.
+ */
+static void superBenchThread(void *arg)
+{
+	SuperBenchArgs *args = (SuperBenchArgs *)arg;
+	ILExecThread *thread;
+	ILMethod *method;
+	ILCurrTime start;
+	ILInt32 result;
+	ILUInt32 level;
+
+	thread = ILThreadRegisterForManagedExecution(cvmProcess, ILThreadSelf());
+	if(!thread)
+	{
+		args->failed = 1;
+		return;
+	}
+	for(level = 0; level < 2; ++level)
+	{
+		method = createSuperMethod(thread, args->info, level);
+		if(!method)
+		{
+			args->failed = 1;
+			break;
+		}
+		ILGetSinceRebootTime(&start);
+		if(ILExecThreadCall(thread, method, &result, args->info->arg))
+		{
+			args->failed = 1;
+			break;
+		}
+		args->ms[level] = elapsedMs(&start);
+		args->results[level] = result;
+	}
+	ILThreadUnregisterForManagedExecution(ILThreadSelf());
+}
+
+/*
+ * Run a benchmark method on a thread that is registered with the
+ * CVM process, and compare the time taken with and without
+ * superinstructions.  The coder is in debug mode, so that the
+ * method is interpreted rather than being unrolled to native code.
+ */
+static void superBench(const SuperBenchMethod *info)
+{
+	SuperBenchArgs args;
+	ILThread *thread;
+	ILInt32 expected;
+
+	ILMemZero(&args, sizeof(args));
+	args.info = info;
+	if(!(thread = ILThreadCreate(superBenchThread, &args)))
+	{
+		ILUnitOutOfMemory();
+	}
+	ILThreadStart(thread);
+	ILThreadJoin(thread, -1);
+	ILThreadDestroy(thread);
+
+	if(args.failed)
+	{
+		ILUnitFailed("could not run %s", info->name);
+	}
+	expected = (*(info->expected))(info->arg);
+	if(args.results[0] != expected || args.results[1] != expected)
+	{
+		ILUnitFailed("%s returned %ld and %ld instead of %ld", info->name,
+					 (long)(args.results[0]), (long)(args.results[1]),
+					 (long)expected);
+	}
+	printf("%lld ms -> %lld ms ... ", (long long)(args.ms[0]),
+		   (long long)(args.ms[1]));
+	fflush(stdout);
+}
+
+static void super_sum(void *arg)
+{
+	superBench(&superSum);
+}
+
+static void super_nested(void *arg)
+{
+	superBench(&superNested);
+}
+
+static void super_gcd(void *arg)
+{
+	superBench(&superGcd);
+}
+
+static void super_hash(void *arg)
+{
+	superBench(&superHash);
+}
+
+#ifdef IL_CONFIG_REFLECTION
+
+/*
+ * Number of calls made by the reflection invoke benchmark.
+ */
+#define	INVOKE_ITERATIONS	1000000
+
+/*
+ * static int Square(int n) { return n * n; }
+ */
+static const unsigned char superSquareCode[] = {
+	0x02, 0x02, 0x5A, 0x2A
+};
+static ILInt32 superSquareExpected(ILInt32 n)
+{
+	return n * n;
+}
+static const SuperBenchMethod superSquare =
+	{"Square", superSquareCode, sizeof(superSquareCode), 0, 12,
+	 superSquareExpected};
+
+/*
+ * static int CallSquare(int n)
+ * {
+ *     int s = 0;
+ *     for(int i = 0; i < n; ++i) s += Square(i);
+ *     return s;
+ * }
+ *
+ * The token for "Square" is patched in at "INVOKE_CALL_TOKEN".
+ */
+#define	INVOKE_CALL_TOKEN	9
+static const unsigned char superCallSquareCode[] = {
+	0x16, 0x0A, 0x16, 0x0B, 0x2B, 0x0D, 0x06, 0x07,
+	0x28, 0x00, 0x00, 0x00, 0x00, 0x58, 0x0A, 0x07,
+	0x17, 0x58, 0x0B, 0x07, 0x02, 0x32, 0xEF, 0x06,
+	0x2A
+};
+static ILInt32 superCallSquareExpected(ILInt32 n)
+{
+	ILUInt32 s = 0;
+	ILInt32 i;
+	for(i = 0; i < n; ++i)
+	{
+		s += (ILUInt32)i * (ILUInt32)i;
+	}
+	return (ILInt32)s;
+}
+
+/*
+ * Arguments for the reflection invoke benchmark thread.  Index 0 of
+ * the results is for calls from managed code, index 1 for reflection
+ * through the generic "InvokeMethod" path, and index 2 for reflection
+ * through the invoke stub for the signature.
+ */
+typedef struct
+{
+	ILInt64		ms[3];
+	ILInt32		results[3];
+	int			failed;
+
+} InvokeBenchArgs;
+
+/*
+ * Create a boxing class for "int32", because there is no class library.
+ */
+static ILClass *createInt32Class(void)
+{
+	ILClass *classInfo;
+	ILField *field;
+
+	classInfo = ILClassLookup(ILClassGlobalScope(superImage),
+							  "Int32", "System");
+	if(classInfo)
+	{
+		return classInfo;
+	}
+	classInfo = ILClassCreate(ILClassGlobalScope(superImage), 0,
+							  "Int32", "System", 0);
+	if(!classInfo ||
+	   !(field = ILFieldCreate(classInfo, 0, "m_value",
+	   						   IL_META_FIELDDEF_PRIVATE)))
+	{
+		return 0;
+	}
+	ILMemberSetSignature((ILMember *)field, ILType_Int32);
+	return classInfo;
+}
+
+/*
+ * Call a method from managed code, and then via "MethodInfo.Invoke"
+ * with and without the invoke stub for its signature.
+ */
+static void invokeBenchThread(void *arg)
+{
+	InvokeBenchArgs *args = (InvokeBenchArgs *)arg;
+	System_Reflection methodInfo;
+	ILExecThread *thread;
+	ILMethod *method;
+	ILMethod *caller;
+	ILClass *int32Class;
+	System_Array *parameters;
+	ILObject *boxed;
+	ILObject *result;
+	ILCurrTime start;
+	unsigned char callCode[sizeof(superCallSquareCode)];
+	SuperBenchMethod callInfo;
+	int iter, useStub;
+
+	thread = ILThreadRegisterForManagedExecution(cvmProcess, ILThreadSelf());
+	if(!thread)
+	{
+		args->failed = 1;
+		return;
+	}
+	method = createSuperMethod(thread, &superSquare, 1);
+	int32Class = createInt32Class();
+	parameters = (System_Array *)ILGCAlloc
+		(sizeof(System_Array) + sizeof(ILObject *));
+	if(!method || !int32Class || !parameters ||
+	   !(boxed = _ILEngineAllocObject(thread, int32Class)))
+	{
+		args->failed = 1;
+		ILThreadUnregisterForManagedExecution(ILThreadSelf());
+		return;
+	}
+	*((ILInt32 *)boxed) = superSquare.arg;
+	ArrayLength(parameters) = 1;
+	((ILObject **)ArrayToBuffer(parameters))[0] = boxed;
+	methodInfo.privateData = method;
+
+	/* Call the method from a managed loop, which is what a direct
+	   call costs once the loop overhead is included */
+	ILMemCpy(callCode, superCallSquareCode, sizeof(callCode));
+	IL_WRITE_UINT32(callCode + INVOKE_CALL_TOKEN, ILMethod_Token(method));
+	callInfo.name = "CallSquare";
+	callInfo.code = callCode;
+	callInfo.codeLen = sizeof(callCode);
+	callInfo.numLocals = 2;
+	callInfo.arg = INVOKE_ITERATIONS;
+	callInfo.expected = superCallSquareExpected;
+	caller = createSuperMethod(thread, &callInfo, 1);
+	ILGetSinceRebootTime(&start);
+	if(!caller || ILExecThreadCall(thread, caller, &(args->results[0]),
+								   (ILInt32)INVOKE_ITERATIONS))
+	{
+		args->failed = 1;
+	}
+	args->ms[0] = elapsedMs(&start);
+
+	/* Call the method via reflection.  The access check looks at
+	   the current method, so make it look like we are in the image */
+	thread->method = method;
+	for(useStub = 0; useStub < 2 && !(args->failed); ++useStub)
+	{
+		result = 0;
+		ILGetSinceRebootTime(&start);
+		for(iter = 0; iter < INVOKE_ITERATIONS && !(args->failed); ++iter)
+		{
+			if(useStub)
+			{
+				result = _IL_ClrMethod_Invoke
+					(thread, (ILObject *)&methodInfo, 0, 0, 0, parameters, 0);
+			}
+			else
+			{
+				result = _ILInvokeMethodGeneric
+					(thread, method, ILMethod_Signature(method), 0,
+					 parameters, 0);
+			}
+			if(!result || GetObjectClass(result) != int32Class)
+			{
+				args->failed = 1;
+			}
+		}
+		args->ms[useStub + 1] = elapsedMs(&start);
+		if(result)
+		{
+			args->results[useStub + 1] = *((ILInt32 *)result);
+		}
+	}
+	thread->method = 0;
+	ILThreadUnregisterForManagedExecution(ILThreadSelf());
+}
+
+/*
+ * Compare the cost of invoking a method via reflection with a call
+ * from managed code, and the invoke stub with the generic path that
+ * it replaces.  The times are reported, not checked.
+ */
+static void reflect_invoke(void *arg)
+{
+	InvokeBenchArgs args;
+	ILThread *thread;
+	ILInt32 expected;
+
+	ILMemZero(&args, sizeof(args));
+	if(!(thread = ILThreadCreate(invokeBenchThread, &args)))
+	{
+		ILUnitOutOfMemory();
+	}
+	ILThreadStart(thread);
+	ILThreadJoin(thread, -1);
+	ILThreadDestroy(thread);
+
+	if(args.failed)
+	{
+		ILUnitFailed("could not invoke the method");
+	}
+	if(args.results[0] != superCallSquareExpected(INVOKE_ITERATIONS))
+	{
+		ILUnitFailed("CallSquare returned %ld instead of %ld",
+					 (long)(args.results[0]),
+					 (long)superCallSquareExpected(INVOKE_ITERATIONS));
+	}
+	expected = superSquareExpected(superSquare.arg);
+	if(args.results[1] != expected || args.results[2] != expected)
+	{
+		ILUnitFailed("Square returned %ld and %ld instead of %ld",
+					 (long)(args.results[1]), (long)(args.results[2]),
+					 (long)expected);
+	}
+	printf("managed %lld ms, generic invoke %lld ms, stub invoke %lld ms ... ",
+		   (long long)(args.ms[0]), (long long)(args.ms[1]),
+		   (long long)(args.ms[2]));
+	fflush(stdout);
+}
+
+#endif /* IL_CONFIG_REFLECTION */
+
+#ifdef IL_CONFIG_DEBUG_LINES
+
+/*
+ * Depth of the call stack that the stack trace benchmark captures,
+ * and the number of times that the stack trace is captured.
+ */
+#define	TRACE_DEPTH			32
+#define	TRACE_ITERATIONS	20000
+
+/*
+ * Arguments for the stack trace benchmark thread.  Index 0 of
+ * the results is without the thread's offset cache and index 1 with.
+ */
+typedef struct
+{
+	PackedStackFrame	frames[2][TRACE_DEPTH];
+	ILInt64				ms[2];
+	int					failed;
+
+} TraceBenchArgs;
+
+/*
+ * Push call frames for a converted method onto the CVM stack and
+ * capture stack traces for them the way that a throw does.
+ */
+static void traceBenchThread(void *arg)
+{
+	TraceBenchArgs *args = (TraceBenchArgs *)arg;
+	ILExecThread *thread;
+	ILMethod *method;
+	ILCallFrame *frame;
+	unsigned char *start;
+	ILCurrTime startTime;
+	int depth, iter, cached;
+
+	thread = ILThreadRegisterForManagedExecution(cvmProcess, ILThreadSelf());
+	if(!thread)
+	{
+		args->failed = 1;
+		return;
+	}
+	method = createSuperMethod(thread, &superHash, 1);
+	if(!method)
+	{
+		args->failed = 1;
+		ILThreadUnregisterForManagedExecution(ILThreadSelf());
+		return;
+	}
+	start = (unsigned char *)ILMethodGetUserData(method);
+
+	/* Push frames that return to different places within the method */
+	for(depth = 0; depth < TRACE_DEPTH; ++depth)
+	{
+		if(thread->numFrames < thread->maxFrames)
+		{
+			frame = &(thread->frameStack[(thread->numFrames)++]);
+		}
+		else if((frame = _ILAllocCallFrame(thread)) == 0)
+		{
+			args->failed = 1;
+			break;
+		}
+		frame->method = method;
+		frame->pc = start + 1 + (depth % 8) * 4;
+		frame->frame = 0;
+		frame->permissions = 0;
+	}
+
+	/* Capture the stack trace with and without the offset cache */
+	for(cached = 0; cached < 2 && !(args->failed); ++cached)
+	{
+		ILGetSinceRebootTime(&startTime);
+		for(iter = 0; iter < TRACE_ITERATIONS; ++iter)
+		{
+			if(!cached && thread->traceOffsets)
+			{
+				ILMemZero(thread->traceOffsets, IL_TRACE_OFFSET_CACHE_SIZE *
+												sizeof(ILTraceOffset));
+			}
+			_ILFillPackedStackFrames(thread, args->frames[cached], depth);
+		}
+		args->ms[cached] = elapsedMs(&startTime);
+	}
+	thread->numFrames -= depth;
+	ILThreadUnregisterForManagedExecution(ILThreadSelf());
+}
+
+/*
+ * Capture the stack trace for an exception thrown from deep within
+ * interpreted code.  The offsets must be the same with the cache.
+ */
+static void exception_trace(void *arg)
+{
+	TraceBenchArgs *args;
+	ILThread *thread;
+
+	args = (TraceBenchArgs *)ILMalloc(sizeof(TraceBenchArgs));
+	if(!args)
+	{
+		ILUnitOutOfMemory();
+	}
+	ILMemZero(args, sizeof(TraceBenchArgs));
+	if(!(thread = ILThreadCreate(traceBenchThread, args)))
+	{
+		ILUnitOutOfMemory();
+	}
+	ILThreadStart(thread);
+	ILThreadJoin(thread, -1);
+	ILThreadDestroy(thread);
+
+	if(args->failed)
+	{
+		ILFree(args);
+		ILUnitFailed("could not capture the stack trace");
+	}
+	if(ILMemCmp(args->frames[0], args->frames[1],
+				sizeof(args->frames[0])) != 0)
+	{
+		ILFree(args);
+		ILUnitFailed("cached offsets differ from the coder's offsets");
+	}
+	printf("%lld ms -> %lld ms ... ", (long long)(args->ms[0]),
+		   (long long)(args->ms[1]));
+	fflush(stdout);
+	ILFree(args);
+}
+
+#endif /* IL_CONFIG_DEBUG_LINES */
+
+/*
+ * Create the CVM process and the class that holds the benchmark methods.
+ */
+static int createSuperProcess(void)
+{
+	if((cvmProcess = ILExecProcessCreate(0, 0)) == 0)
+	{
+		return 0;
+	}
+	ILCoderEnableDebug(cvmProcess->coder);
+	superImage = ILImageCreate(ILExecProcessGetContext(cvmProcess));
+	if(!superImage ||
+	   !ILModuleCreate(superImage, 0, "SuperBench", 0) ||
+	   !ILAssemblyCreate(superImage, 0, "SuperBench", 0))
+	{
+		return 0;
+	}
+	superClass = ILClassCreate(ILClassGlobalScope(superImage), 0,
+							   "SuperBench", "", 0);
+	return (superClass != 0);
+}
+
+#endif /* IL_USE_CVM */
+
+/*
+ * Simple test registration macro.
+ */
+#define	RegisterSimple(name)	(ILUnitRegister(#name, name, 0))
+
+/*
+ * Register all unit tests.
+ */
+void ILUnitRegisterTests(void)
+{
+	/*
+	 * Initialize the engine and create a process that can't execute code.
+	 */
+	if(ILExecInit(0) != IL_EXEC_INIT_OK ||
+	   (process = ILExecProcessCreateNull()) == 0)
+	{
+		fputs("Could not initialize the engine - skipping all tests\n",
+			  stdout);
+		return;
+	}
+	ILExecProcessGetMain(process);
+
+	/*
+	 * Monitor.Enter/Exit throughput by number of threads.
+	 */
+	if(ILHasThreads())
+	{
+		ILUnitRegisterSuite("Monitor Enter/Exit");
+		RegisterSimple(monitor_private_1);
+		RegisterSimple(monitor_private_2);
+		RegisterSimple(monitor_private_4);
+		RegisterSimple(monitor_private_8);
+		RegisterSimple(monitor_private_16);
+		RegisterSimple(monitor_shared_4);
+	}
+
+#ifdef IL_CONFIG_RUNTIME_INFRA
+	/*
+	 * GCHandle.Alloc/Target/Free throughput by number of threads.
+	 */
+	if(ILHasThreads())
+	{
+		ILUnitRegisterSuite("GC Handles");
+		RegisterSimple(gc_handle_pinned_1);
+		RegisterSimple(gc_handle_pinned_4);
+		RegisterSimple(gc_handle_pinned_16);
+		RegisterSimple(gc_handle_weak_1);
+		RegisterSimple(gc_handle_weak_4);
+	}
+#endif
+
+	/*
+	 * Method cache lookups by address.
+	 */
+	ILUnitRegisterSuite("Method Cache");
+	RegisterSimple(method_cache_lookup);
+	if(ILHasThreads())
+	{
+		RegisterSimple(method_cache_threads);
+	}
+
+	/*
+	 * Inline caches for interface call sites.
+	 */
+	ILUnitRegisterSuite("Interface Call Sites");
+	RegisterSimple(call_site_mono);
+	RegisterSimple(call_site_poly);
+	RegisterSimple(call_site_mega);
+
+	/*
+	 * Sampling profiler.
+	 */
+	ILUnitRegisterSuite("Sampling Profiler");
+	RegisterSimple(sampler_signals);
+
+	/*
+	 * Socket poller for asynchronous socket operations.
+	 */
+	if(ILHasThreads())
+	{
+		ILUnitRegisterSuite("Socket Poller");
+		RegisterSimple(socket_poller_churn);
+		RegisterSimple(socket_poller_directions);
+	}
+
+	/*
+	 * Crypto natives that process a run of blocks.
+	 */
+	ILUnitRegisterSuite("Crypto Natives");
+	RegisterSimple(crypt_aes_blocks);
+
+	/*
+	 * Classes and methods looked up by name.
+	 */
+	ILUnitRegisterSuite("Named Lookups");
+	RegisterSimple(lookup_method);
+
+#ifdef IL_USE_CVM
+	/*
+	 * CVM superinstructions.
+	 */
+	if(ILHasThreads() && createSuperProcess())
+	{
+		ILUnitRegisterSuite("CVM Superinstructions");
+		RegisterSimple(super_sum);
+		RegisterSimple(super_nested);
+		RegisterSimple(super_gcd);
+		RegisterSimple(super_hash);
+#ifdef IL_CONFIG_DEBUG_LINES
+		ILUnitRegisterSuite("Exception Stack Traces");
+		RegisterSimple(exception_trace);
+#endif
+#ifdef IL_CONFIG_REFLECTION
+		ILUnitRegisterSuite("Reflection Invoke");
+		RegisterSimple(reflect_invoke);
+#endif
+	}
+#endif
+
+	/*
+	 * String intern table.
+	 */
+	ILUnitRegisterSuite("String Intern Table");
+	RegisterSimple(intern_grow);
+	if(ILHasThreads())
+	{
+		RegisterSimple(intern_threads);
+	}
+}
+
+void ILUnitCleanupTests(void)
+{
+	/*
+	 * Shut down the engine, which also destroys the process.
+	 */
+	ILExecDeinit();
+}
+
+#ifdef	__cplusplus
+};
+#endif
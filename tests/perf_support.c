@@ -0,0 +1,2576 @@
+/*
+ * perf_support.c - Micro benchmarks for the support and image routines.
+ *
+ * Copyright (C) 2010  Southern Storm Software, Pty Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ilunit.h"
+#include "il_system.h"
+#include "il_utils.h"
+#include "il_program.h"
+#include "il_writer.h"
+#include "il_sysio.h"
+#include "il_thread.h"
+#include "il_regex.h"
+#include "il_xml.h"
+#include "il_crypt.h"
+#if defined(HAVE_SYS_SOCKET_H) && !defined(IL_WIN32_NATIVE)
+#include <sys/types.h>
+#include <sys/socket.h>
+#endif
+
+#ifdef	__cplusplus
+extern	"C" {
+#endif
+
+/*
+ * Get the number of milliseconds elapsed since "start".
+ */
+static ILInt64 elapsedMs(ILCurrTime *start)
+{
+	ILCurrTime now;
+
+	ILGetSinceRebootTime(&now);
+	return (now.secs - start->secs) * 1000 +
+		   ((ILInt64)now.nsecs - (ILInt64)start->nsecs) / 1000000;
+}
+
+/*
+ * Report the throughput of a benchmark.
+ */
+static void reportRate(const char *what, ILInt64 ops, ILInt64 ms)
+{
+	if(ms <= 0)
+	{
+		ms = 1;
+	}
+	printf("%lld %s/ms ... ", (long long)(ops / ms), what);
+	fflush(stdout);
+}
+
+/*
+ * Number of elements in the hash table benchmarks.
+ */
+#define	HASH_ELEMENTS		200000
+
+/*
+ * Hash table callbacks for elements that are pointers to integers.
+ */
+static unsigned long IntHash_Compute(const void *elem)
+{
+	return (unsigned long)(*((const ILInt32 *)elem));
+}
+static unsigned long IntHash_KeyCompute(const void *key)
+{
+	return (unsigned long)(*((const ILInt32 *)key));
+}
+static int IntHash_Match(const void *elem, const void *key)
+{
+	return (*((const ILInt32 *)elem) == *((const ILInt32 *)key));
+}
+
+/*
+ * Add a large number of elements to a hash table that starts
+ * with the default size, then find, remove and iterate them.
+ */
+static void hashtab_grow(void *arg)
+{
+	ILHashTable *hashtab;
+	ILHashIter iter;
+	ILInt32 *values;
+	ILInt32 *value;
+	ILInt32 key;
+	ILCurrTime start;
+	int posn, count;
+
+	values = (ILInt32 *)ILMalloc(sizeof(ILInt32) * (HASH_ELEMENTS + 1));
+	hashtab = ILHashCreate(0, IntHash_Compute, IntHash_KeyCompute,
+						   IntHash_Match, (ILHashFreeFunc)0);
+	if(!values || !hashtab)
+	{
+		ILUnitOutOfMemory();
+	}
+
+	ILGetSinceRebootTime(&start);
+	for(posn = 0; posn < HASH_ELEMENTS; ++posn)
+	{
+		values[posn] = posn * 7;
+		if(!ILHashAdd(hashtab, &(values[posn])))
+		{
+			ILUnitOutOfMemory();
+		}
+	}
+	reportRate("adds", HASH_ELEMENTS, elapsedMs(&start));
+
+	ILGetSinceRebootTime(&start);
+	for(posn = 0; posn < HASH_ELEMENTS; ++posn)
+	{
+		key = posn * 7;
+		if(ILHashFindType(hashtab, &key, ILInt32) != &(values[posn]))
+		{
+			ILUnitFailed("element %d was not found", posn);
+		}
+	}
+	reportRate("finds", HASH_ELEMENTS, elapsedMs(&start));
+
+	/* Remove the odd elements */
+	for(posn = 1; posn < HASH_ELEMENTS; posn += 2)
+	{
+		ILHashRemove(hashtab, &(values[posn]), 0);
+	}
+
+	/* Iterate over the rest, adding one more element on the way */
+	values[HASH_ELEMENTS] = -1;
+	count = 0;
+	ILHashIterInit(&iter, hashtab);
+	while((value = ILHashIterNextType(&iter, ILInt32)) != 0)
+	{
+		if(((*value / 7) % 2) != 0)
+		{
+			ILUnitFailed("removed element %ld was returned", (long)*value);
+		}
+		if(count == 0 && !ILHashAdd(hashtab, &(values[HASH_ELEMENTS])))
+		{
+			ILUnitOutOfMemory();
+		}
+		++count;
+	}
+	if(count != (HASH_ELEMENTS / 2) + 1)
+	{
+		ILUnitFailed("iteration returned %d elements", count);
+	}
+	key = -1;
+	if(ILHashFindType(hashtab, &key, ILInt32) != &(values[HASH_ELEMENTS]))
+	{
+		ILUnitFailed("element added during the iteration was not found");
+	}
+
+	ILHashDestroy(hashtab);
+	ILFree(values);
+}
+
+/*
+ * Add two elements with the same key, where the second one reuses
+ * the entry of an element that was removed earlier, and check that
+ * the first one is still found after the table has been rehashed.
+ */
+static void hashtab_duplicates(void *arg)
+{
+	ILHashTable *hashtab;
+	ILInt32 values[32];
+	ILInt32 key;
+	int posn;
+
+	hashtab = ILHashCreate(7, IntHash_Compute, IntHash_KeyCompute,
+						   IntHash_Match, (ILHashFreeFunc)0);
+	if(!hashtab)
+	{
+		ILUnitOutOfMemory();
+	}
+	values[0] = 1000;
+	values[1] = 42;
+	values[2] = 42;
+	if(!ILHashAdd(hashtab, &(values[0])) || !ILHashAdd(hashtab, &(values[1])))
+	{
+		ILUnitOutOfMemory();
+	}
+	ILHashRemove(hashtab, &(values[0]), 0);
+	if(!ILHashAdd(hashtab, &(values[2])))
+	{
+		ILUnitOutOfMemory();
+	}
+
+	/* Add enough elements to rehash the table */
+	for(posn = 3; posn < 32; ++posn)
+	{
+		values[posn] = posn;
+		if(!ILHashAdd(hashtab, &(values[posn])))
+		{
+			ILUnitOutOfMemory();
+		}
+	}
+
+	key = 42;
+	if(ILHashFindType(hashtab, &key, ILInt32) != &(values[1]))
+	{
+		ILUnitFailed("the duplicate that was added first was not found");
+	}
+	ILHashRemove(hashtab, &(values[1]), 0);
+	if(ILHashFindType(hashtab, &key, ILInt32) != &(values[2]))
+	{
+		ILUnitFailed("the second duplicate was not found");
+	}
+	ILHashDestroy(hashtab);
+}
+
+/*
+ * Number of add/remove cycles in the churn test, and the number
+ * of elements that are live in the table at any one time.
+ */
+#define	CHURN_CYCLES		1000000
+#define	CHURN_LIVE			1000
+#define	CHURN_SLICES		10
+
+/*
+ * Repeatedly add and remove elements while keeping the number
+ * of live elements constant.  Removed entries must be reused,
+ * so that the later cycles run as fast as the earlier ones.  The
+ * times of the first and last slices are reported, not checked.
+ */
+static void hashtab_churn(void *arg)
+{
+	ILHashTable *hashtab;
+	ILHashIter iter;
+	ILInt32 *values;
+	ILInt32 key;
+	ILCurrTime start;
+	ILInt64 firstMs, lastMs, ms;
+	int posn, slice, count;
+
+	values = (ILInt32 *)ILMalloc(sizeof(ILInt32) * CHURN_LIVE);
+	hashtab = ILHashCreate(0, IntHash_Compute, IntHash_KeyCompute,
+						   IntHash_Match, (ILHashFreeFunc)0);
+	if(!values || !hashtab)
+	{
+		ILUnitOutOfMemory();
+	}
+
+	firstMs = 0;
+	lastMs = 0;
+	for(slice = 0; slice < CHURN_SLICES; ++slice)
+	{
+		ILGetSinceRebootTime(&start);
+		for(posn = slice * (CHURN_CYCLES / CHURN_SLICES);
+			posn < (slice + 1) * (CHURN_CYCLES / CHURN_SLICES); ++posn)
+		{
+			/* Replace the oldest element with a new one */
+			if(posn >= CHURN_LIVE)
+			{
+				ILHashRemove(hashtab, &(values[posn % CHURN_LIVE]), 0);
+			}
+			values[posn % CHURN_LIVE] = posn;
+			if(!ILHashAdd(hashtab, &(values[posn % CHURN_LIVE])))
+			{
+				ILUnitOutOfMemory();
+			}
+			key = posn;
+			if(ILHashFindType(hashtab, &key, ILInt32) !=
+					&(values[posn % CHURN_LIVE]))
+			{
+				ILUnitFailed("element %d was not found", posn);
+			}
+		}
+		ms = elapsedMs(&start);
+		if(slice == 0)
+		{
+			firstMs = ms;
+		}
+		lastMs = ms;
+	}
+	printf("%lld ms -> %lld ms ... ", (long long)firstMs, (long long)lastMs);
+	fflush(stdout);
+
+	/* Only the live elements should remain in the table */
+	count = 0;
+	ILHashIterInit(&iter, hashtab);
+	while(ILHashIterNext(&iter) != 0)
+	{
+		++count;
+	}
+	if(count != CHURN_LIVE)
+	{
+		ILUnitFailed("iteration returned %d elements", count);
+	}
+	key = CHURN_CYCLES - CHURN_LIVE - 1;
+	if(ILHashFind(hashtab, &key) != 0)
+	{
+		ILUnitFailed("removed element %ld was found", (long)key);
+	}
+
+	ILHashDestroy(hashtab);
+	ILFree(values);
+}
+
+/*
+ * Number of classes and namespaces in the class lookup benchmark.
+ */
+#define	LOOKUP_CLASSES		50000
+#define	LOOKUP_NAMESPACES	100
+#define	LOOKUP_ITERATIONS	4
+
+/*
+ * Create a large number of classes in a context and then
+ * measure the speed of looking them up by name.
+ */
+static void class_lookup(void *arg)
+{
+	ILContext *context;
+	ILImage *image;
+	ILProgramItem *scope;
+	ILClass *classInfo;
+	char name[32];
+	char nspace[32];
+	ILCurrTime start;
+	int posn, iter;
+
+	if((context = ILContextCreate()) == 0 ||
+	   (image = ILImageCreate(context)) == 0 ||
+	   (scope = (ILProgramItem *)ILModuleCreate
+			(image, 0, "perf_support", 0)) == 0)
+	{
+		ILUnitOutOfMemory();
+	}
+
+	ILGetSinceRebootTime(&start);
+	for(posn = 0; posn < LOOKUP_CLASSES; ++posn)
+	{
+		sprintf(name, "Class%d", posn);
+		sprintf(nspace, "Namespace%d", posn % LOOKUP_NAMESPACES);
+		if(!ILClassCreate(scope, 0, name, nspace, 0))
+		{
+			ILUnitOutOfMemory();
+		}
+	}
+	reportRate("creates", LOOKUP_CLASSES, elapsedMs(&start));
+
+	ILGetSinceRebootTime(&start);
+	for(iter = 0; iter < LOOKUP_ITERATIONS; ++iter)
+	{
+		for(posn = 0; posn < LOOKUP_CLASSES; ++posn)
+		{
+			sprintf(name, "Class%d", posn);
+			sprintf(nspace, "Namespace%d", posn % LOOKUP_NAMESPACES);
+			classInfo = ILClassLookup(scope, name, nspace);
+			if(!classInfo || strcmp(ILClass_Name(classInfo), name) != 0)
+			{
+				ILUnitFailed("class %s.%s was not found", nspace, name);
+			}
+		}
+	}
+	reportRate("lookups", (ILInt64)LOOKUP_ITERATIONS * LOOKUP_CLASSES,
+			   elapsedMs(&start));
+
+	ILContextDestroy(context);
+}
+
+/*
+ * Number of classes and methods per class in the metadata loading
+ * benchmark, and the number of times that the image is loaded.
+ */
+#define	LAZY_CLASSES		2000
+#define	LAZY_METHODS		16
+#define	LAZY_ITERATIONS		10
+#define	LAZY_FILENAME		"perf_lazy.dll"
+
+/*
+ * Write an image with many classes to "LAZY_FILENAME".  Each class
+ * has a field, some methods, and a property with a getter.
+ */
+static void createLazyImage(void)
+{
+	ILContext *context;
+	ILImage *image = 0;
+	ILProgramItem *scope = 0;
+	ILClass *classInfo;
+	ILMethod *method;
+	ILField *field;
+	ILProperty *property;
+	ILType *signature;
+	ILWriter *writer;
+	FILE *stream;
+	char name[32];
+	int posn, member;
+
+	if((context = ILContextCreate()) == 0 ||
+	   (image = ILImageCreate(context)) == 0 ||
+	   !ILAssemblyCreate(image, 0, "perf_lazy", 0) ||
+	   (scope = (ILProgramItem *)ILModuleCreate
+			(image, 0, LAZY_FILENAME, 0)) == 0 ||
+	   !ILClassCreate(scope, 0, "<Module>", 0, 0))
+	{
+		ILUnitOutOfMemory();
+	}
+	for(posn = 0; posn < LAZY_CLASSES; ++posn)
+	{
+		sprintf(name, "Class%d", posn);
+		classInfo = ILClassCreate(scope, 0, name, "Lazy", 0);
+		if(!classInfo)
+		{
+			ILUnitOutOfMemory();
+		}
+		ILClassSetAttrs(classInfo, ~0, IL_META_TYPEDEF_PUBLIC |
+										IL_META_TYPEDEF_ABSTRACT);
+		field = ILFieldCreate(classInfo, 0, "value", IL_META_FIELDDEF_PUBLIC);
+		if(!field)
+		{
+			ILUnitOutOfMemory();
+		}
+		ILMemberSetSignature((ILMember *)field, ILType_Int32);
+		for(member = 0; member <= LAZY_METHODS; ++member)
+		{
+			if(member < LAZY_METHODS)
+			{
+				sprintf(name, "M%d", member);
+				signature = ILTypeCreateMethod(context, ILType_Void);
+			}
+			else
+			{
+				strcpy(name, "get_P");
+				signature = ILTypeCreateMethod(context, ILType_Int32);
+			}
+			method = ILMethodCreate(classInfo, 0, name,
+									IL_META_METHODDEF_PUBLIC |
+									IL_META_METHODDEF_VIRTUAL |
+									IL_META_METHODDEF_ABSTRACT);
+			if(!method || !signature)
+			{
+				ILUnitOutOfMemory();
+			}
+			ILTypeSetCallConv(signature, IL_META_CALLCONV_HASTHIS);
+			ILMemberSetSignature((ILMember *)method, signature);
+			ILMethodSetCallConv(method, IL_META_CALLCONV_HASTHIS);
+		}
+		signature = ILTypeCreateProperty(context, ILType_Int32);
+		if(!signature)
+		{
+			ILUnitOutOfMemory();
+		}
+		ILTypeSetCallConv(signature, IL_META_CALLCONV_HASTHIS);
+		property = ILPropertyCreate(classInfo, 0, "P", 0, signature);
+		if(!property ||
+		   !ILMethodSemCreate((ILProgramItem *)property, 0,
+		   					  IL_META_METHODSEM_GETTER, method))
+		{
+			ILUnitOutOfMemory();
+		}
+	}
+
+	if((stream = fopen(LAZY_FILENAME, "wb")) == NULL)
+	{
+		ILUnitFailed("could not create `%s'", LAZY_FILENAME);
+	}
+	writer = ILWriterCreate(stream, 1, IL_IMAGETYPE_DLL, 0);
+	if(!writer)
+	{
+		ILUnitOutOfMemory();
+	}
+	ILWriterOutputMetadata(writer, image);
+	if(ILWriterDestroy(writer) != 1)
+	{
+		ILUnitFailed("could not write `%s'", LAZY_FILENAME);
+	}
+	fclose(stream);
+	ILContextDestroy(context);
+}
+
+/*
+ * Load the benchmark image with particular flags.
+ */
+static ILImage *loadLazyImage(ILContext *context, int flags)
+{
+	ILImage *image;
+	int error = ILImageLoadFromFile(LAZY_FILENAME, context, &image,
+									IL_LOADFLAG_FORCE_32BIT | flags, 0);
+	if(error != 0)
+	{
+		ILUnitFailed("could not load `%s': %s", LAZY_FILENAME,
+					 ILImageLoadError(error));
+	}
+	return image;
+}
+
+/*
+ * Compare the time to load an image eagerly and lazily, and
+ * check that the members of a class appear when it is used.
+ */
+static void lazy_metadata(void *arg)
+{
+	ILContext *context;
+	ILImage *image;
+	ILClass *classInfo;
+	ILMember *member;
+	ILMethod *method;
+	unsigned long eagerLoaded, present;
+	unsigned long lazyLoaded, usedLoaded;
+	ILCurrTime start;
+	ILInt64 eagerMs, lazyMs;
+	int iter;
+
+	createLazyImage();
+
+	/* Time the eager and lazy loads */
+	ILGetSinceRebootTime(&start);
+	for(iter = 0; iter < LAZY_ITERATIONS; ++iter)
+	{
+		if((context = ILContextCreate()) == 0)
+		{
+			ILUnitOutOfMemory();
+		}
+		image = loadLazyImage(context, 0);
+		ILImageMetaRowCounts(image, &eagerLoaded, &present);
+		ILContextDestroy(context);
+	}
+	eagerMs = elapsedMs(&start);
+	ILGetSinceRebootTime(&start);
+	for(iter = 0; iter < LAZY_ITERATIONS; ++iter)
+	{
+		if((context = ILContextCreate()) == 0)
+		{
+			ILUnitOutOfMemory();
+		}
+		image = loadLazyImage(context, IL_LOADFLAG_LAZY_METADATA);
+		ILImageMetaRowCounts(image, &lazyLoaded, &present);
+		ILContextDestroy(context);
+	}
+	lazyMs = elapsedMs(&start);
+	if(lazyLoaded >= eagerLoaded)
+	{
+		ILUnitFailed("%lu rows were loaded lazily, and %lu eagerly",
+					 lazyLoaded, eagerLoaded);
+	}
+
+	/* Using one class must load its members, and nothing else */
+	if((context = ILContextCreate()) == 0)
+	{
+		ILUnitOutOfMemory();
+	}
+	image = loadLazyImage(context, IL_LOADFLAG_LAZY_METADATA);
+	classInfo = ILClassLookup(ILClassGlobalScope(image), "Class7", "Lazy");
+	if(!classInfo)
+	{
+		ILUnitFailed("class Lazy.Class7 was not found");
+	}
+	member = ILClassNextMemberMatch(classInfo, 0, IL_META_MEMBERKIND_METHOD,
+									"M3", 0);
+	if(!member)
+	{
+		ILUnitFailed("method M3 was not loaded on demand");
+	}
+	member = ILClassNextMemberMatch(classInfo, 0, IL_META_MEMBERKIND_PROPERTY,
+									"P", 0);
+	method = (member ? ILPropertyGetGetter((ILProperty *)member) : 0);
+	if(!method || strcmp(ILMethod_Name(method), "get_P") != 0)
+	{
+		ILUnitFailed("property P was not loaded on demand");
+	}
+	ILImageMetaRowCounts(image, &usedLoaded, &present);
+	if(usedLoaded != lazyLoaded + LAZY_METHODS + 3)
+	{
+		ILUnitFailed("using one class loaded %lu rows",
+					 usedLoaded - lazyLoaded);
+	}
+
+	/* Tokens for members of other classes must load on demand */
+	method = ILMethod_FromToken
+		(image, IL_META_TOKEN_METHOD_DEF |
+				ILImageNumTokens(image, IL_META_TOKEN_METHOD_DEF));
+	if(!method || strcmp(ILClass_Name(ILMethod_Owner(method)),
+						 "Class1999") != 0)
+	{
+		ILUnitFailed("the last method was not loaded on demand");
+	}
+	ILContextDestroy(context);
+	remove(LAZY_FILENAME);
+
+	printf("%lld ms -> %lld ms, %lu -> %lu of %lu rows ... ",
+		   (long long)eagerMs, (long long)lazyMs,
+		   eagerLoaded, lazyLoaded, present);
+	fflush(stdout);
+}
+
+/*
+ * Number of threads and rounds in the concurrent lazy loading test.
+ */
+#define	LAZY_THREADS		4
+#define	LAZY_ROUNDS			20
+
+/*
+ * Arguments for a concurrent lazy loading thread.
+ */
+typedef struct
+{
+	ILImage		   *image;
+	int				byToken;
+	int				failures;
+
+} LazyThreadArgs;
+
+/*
+ * Walk the members of every class in a lazily loaded image, or look up
+ * every method by token, and check that each class is complete.
+ */
+static void lazyThreadFunc(void *arg)
+{
+	LazyThreadArgs *args = (LazyThreadArgs *)arg;
+	ILImage *image = args->image;
+	ILUInt32 numClasses = ILImageNumTokens(image, IL_META_TOKEN_TYPE_DEF);
+	ILUInt32 numMethods = ILImageNumTokens(image, IL_META_TOKEN_METHOD_DEF);
+	ILClass *classInfo;
+	ILMember *member;
+	ILMethod *method;
+	ILUInt32 token;
+	int methods, fields, properties;
+
+	if(args->byToken)
+	{
+		/* Start with the last method, so that the other threads
+		   meet this one in the middle */
+		for(token = numMethods; token > 0; --token)
+		{
+			method = ILMethod_FromToken(image,
+										IL_META_TOKEN_METHOD_DEF | token);
+			if(!method || !ILMethod_Signature(method) ||
+			   ILClassNextMemberMatch(ILMethod_Owner(method), 0,
+			   						  IL_META_MEMBERKIND_METHOD,
+									  ILMethod_Name(method), 0) == 0)
+			{
+				++(args->failures);
+			}
+		}
+		return;
+	}
+
+	/* Skip the "<Module>" class, which has no members */
+	for(token = 2; token <= numClasses; ++token)
+	{
+		classInfo = ILClass_FromToken(image, IL_META_TOKEN_TYPE_DEF | token);
+		methods = fields = properties = 0;
+		member = 0;
+		while(classInfo &&
+			  (member = ILClassNextMember(classInfo, member)) != 0)
+		{
+			if(ILMember_IsMethod(member))
+			{
+				++methods;
+			}
+			else if(ILMember_IsField(member))
+			{
+				++fields;
+			}
+			else if(ILMember_IsProperty(member) &&
+					ILPropertyGetGetter((ILProperty *)member) != 0)
+			{
+				++properties;
+			}
+		}
+		if(methods != LAZY_METHODS + 1 || fields != 1 || properties != 1)
+		{
+			++(args->failures);
+		}
+	}
+}
+
+/*
+ * Load the members of a lazy image from several threads at
+ * once, and check that every thread sees complete classes.
+ */
+static void lazy_metadata_threads(void *arg)
+{
+	ILContext *context;
+	ILImage *image;
+	ILThread *threads[LAZY_THREADS];
+	LazyThreadArgs args[LAZY_THREADS];
+	ILCurrTime start;
+	int round, posn, failures;
+
+	createLazyImage();
+	ILThreadInit();
+	ILGetSinceRebootTime(&start);
+	failures = 0;
+	for(round = 0; round < LAZY_ROUNDS; ++round)
+	{
+		if((context = ILContextCreate()) == 0)
+		{
+			ILUnitOutOfMemory();
+		}
+		image = loadLazyImage(context, IL_LOADFLAG_LAZY_METADATA);
+		for(posn = 0; posn < LAZY_THREADS; ++posn)
+		{
+			args[posn].image = image;
+			args[posn].byToken = ((posn % 2) != 0);
+			args[posn].failures = 0;
+			threads[posn] = ILThreadCreate(lazyThreadFunc, &(args[posn]));
+			if(!threads[posn] || !ILThreadStart(threads[posn]))
+			{
+				ILUnitFailed("could not start thread %d", posn);
+			}
+		}
+		for(posn = 0; posn < LAZY_THREADS; ++posn)
+		{
+			ILThreadJoin(threads[posn], -1);
+			ILThreadDestroy(threads[posn]);
+			failures += args[posn].failures;
+		}
+		ILContextDestroy(context);
+	}
+	remove(LAZY_FILENAME);
+
+	printf("%lld ms ... ", (long long)elapsedMs(&start));
+	fflush(stdout);
+	if(failures != 0)
+	{
+		ILUnitFailed("%d classes or methods were incomplete", failures);
+	}
+}
+
+/*
+ * Number of token lookups for each thread in the loaded token benchmark.
+ */
+#define	LAZY_LOOKUPS		2000000
+
+/*
+ * Look up methods that are already loaded by token, over and over.
+ */
+static void lazyLookupThreadFunc(void *arg)
+{
+	LazyThreadArgs *args = (LazyThreadArgs *)arg;
+	ILImage *image = args->image;
+	ILUInt32 numMethods = ILImageNumTokens(image, IL_META_TOKEN_METHOD_DEF);
+	ILUInt32 posn;
+
+	for(posn = 0; posn < LAZY_LOOKUPS; ++posn)
+	{
+		if(!ILMethod_FromToken(image, IL_META_TOKEN_METHOD_DEF |
+									  (posn % numMethods + 1)))
+		{
+			++(args->failures);
+		}
+	}
+}
+
+/*
+ * Time lookups of methods that were already loaded from a lazy
+ * image, on one thread and on several threads at once.
+ */
+static void lazy_token_lookups(void *arg)
+{
+	ILContext *context;
+	ILImage *image;
+	ILThread *threads[LAZY_THREADS];
+	LazyThreadArgs args[LAZY_THREADS];
+	ILCurrTime start;
+	int numThreads, posn, failures;
+
+	createLazyImage();
+	ILThreadInit();
+	if((context = ILContextCreate()) == 0)
+	{
+		ILUnitOutOfMemory();
+	}
+	image = loadLazyImage(context, IL_LOADFLAG_LAZY_METADATA);
+	args[0].image = image;
+	args[0].failures = 0;
+	lazyLookupThreadFunc(&(args[0]));
+	failures = args[0].failures;
+	for(numThreads = 1; numThreads <= LAZY_THREADS; numThreads *= LAZY_THREADS)
+	{
+		ILGetSinceRebootTime(&start);
+		for(posn = 0; posn < numThreads; ++posn)
+		{
+			args[posn].image = image;
+			args[posn].failures = 0;
+			threads[posn] = ILThreadCreate(lazyLookupThreadFunc,
+										   &(args[posn]));
+			if(!threads[posn] || !ILThreadStart(threads[posn]))
+			{
+				ILUnitFailed("could not start thread %d", posn);
+			}
+		}
+		for(posn = 0; posn < numThreads; ++posn)
+		{
+			ILThreadJoin(threads[posn], -1);
+			ILThreadDestroy(threads[posn]);
+			failures += args[posn].failures;
+		}
+		printf("%d thread%s: ", numThreads, (numThreads == 1 ? "" : "s"));
+		reportRate("lookups", (ILInt64)LAZY_LOOKUPS * numThreads,
+				   elapsedMs(&start));
+	}
+	ILContextDestroy(context);
+	remove(LAZY_FILENAME);
+	if(failures != 0)
+	{
+		ILUnitFailed("%d lookups failed", failures);
+	}
+}
+
+/*
+ * Size of the buffers and number of passes in the UTF-16 benchmarks.
+ */
+#define	UTF16_LENGTH		4096
+#define	UTF16_PASSES		50000
+
+/*
+ * Length of the strings and number of searches in the short
+ * string benchmark.  Most strings that programs search are short.
+ */
+#define	UTF16_SHORT_LENGTH		45
+#define	UTF16_SHORT_SEARCHES	2000000
+
+/*
+ * The search loops that were used by the string natives before the
+ * UTF-16 kernels were introduced.  These are the reference for
+ * both correctness and speed.
+ */
+static long RefIndexOf(const unsigned short *str, long len,
+					   unsigned short ch)
+{
+	long posn = 0;
+	while(len > 0)
+	{
+		if(*str++ == ch)
+		{
+			return posn;
+		}
+		++posn;
+		--len;
+	}
+	return -1;
+}
+static long RefLastIndexOf(const unsigned short *str, long len,
+						   unsigned short ch)
+{
+	str += len - 1;
+	while(len > 0)
+	{
+		--len;
+		if(*str-- == ch)
+		{
+			return len;
+		}
+	}
+	return -1;
+}
+static long RefIndexOfAny(const unsigned short *str, long len,
+						  const unsigned short *anyOf, long anyLen)
+{
+	long posn, anyPosn;
+	for(posn = 0; posn < len; ++posn)
+	{
+		for(anyPosn = 0; anyPosn < anyLen; ++anyPosn)
+		{
+			if(str[posn] == anyOf[anyPosn])
+			{
+				return posn;
+			}
+		}
+	}
+	return -1;
+}
+static long RefLastIndexOfAny(const unsigned short *str, long len,
+							  const unsigned short *anyOf, long anyLen)
+{
+	long anyPosn;
+	while(len > 0)
+	{
+		--len;
+		for(anyPosn = 0; anyPosn < anyLen; ++anyPosn)
+		{
+			if(str[len] == anyOf[anyPosn])
+			{
+				return len;
+			}
+		}
+	}
+	return -1;
+}
+static int RefCompareOrdinal(const unsigned short *str1, long len1,
+							 const unsigned short *str2, long len2)
+{
+	while(len1 > 0 && len2 > 0)
+	{
+		if(*str1 < *str2)
+		{
+			return -1;
+		}
+		else if(*str1 > *str2)
+		{
+			return 1;
+		}
+		++str1;
+		++str2;
+		--len1;
+		--len2;
+	}
+	return (len1 > 0 ? 1 : (len2 > 0 ? -1 : 0));
+}
+static void RefReplace(unsigned short *dest, const unsigned short *src,
+					   long len, unsigned short oldCh, unsigned short newCh)
+{
+	while(len > 0)
+	{
+		*dest++ = (*src == oldCh ? newCh : *src);
+		++src;
+		--len;
+	}
+}
+
+/*
+ * Fill a buffer with text that looks like a log file.
+ */
+static void fillText(unsigned short *buf, long len)
+{
+	static const char text[] =
+		"2010-01-01 12:00:00 INFO [worker-7] request handled in 12ms; ";
+	long posn;
+	for(posn = 0; posn < len; ++posn)
+	{
+		buf[posn] = (unsigned short)(text[posn % (sizeof(text) - 1)]);
+	}
+}
+
+/*
+ * Check the current UTF-16 kernels against the reference loops
+ * for all short lengths and match positions.
+ */
+static void checkKernels(const char *name)
+{
+	static const unsigned short anyOf[] = {'#', '|', 0x263A};
+	unsigned short buf1[80] = {0};
+	unsigned short buf2[80] = {0};
+	unsigned short dest1[80];
+	unsigned short dest2[80];
+	long len, posn;
+
+	for(len = 0; len <= 72; ++len)
+	{
+		for(posn = -1; posn < len; ++posn)
+		{
+			fillText(buf1, len);
+			fillText(buf2, len);
+			if(posn >= 0)
+			{
+				buf1[posn] = 0x263A;
+				buf2[posn] = 0x263B;
+			}
+			if(ILUTF16IndexOf(buf1, len, 0x263A) !=
+					RefIndexOf(buf1, len, 0x263A) ||
+			   ILUTF16LastIndexOf(buf1, len, 0x263A) !=
+			   		RefLastIndexOf(buf1, len, 0x263A) ||
+			   ILUTF16LastIndexOf(buf1, len, ':') !=
+			   		RefLastIndexOf(buf1, len, ':') ||
+			   ILUTF16IndexOfAny(buf1, len, anyOf, 3) !=
+			   		RefIndexOfAny(buf1, len, anyOf, 3) ||
+			   ILUTF16LastIndexOfAny(buf1, len, anyOf, 3) !=
+			   		RefLastIndexOfAny(buf1, len, anyOf, 3) ||
+			   ILUTF16CompareOrdinal(buf1, len, buf2, len) !=
+			   		RefCompareOrdinal(buf1, len, buf2, len) ||
+			   ILUTF16CompareOrdinal(buf2, len, buf1, len / 2) !=
+			   		RefCompareOrdinal(buf2, len, buf1, len / 2))
+			{
+				ILUnitFailed("%s kernels failed for length %ld at %ld",
+							 name, len, posn);
+			}
+			RefReplace(dest1, buf1, len, ' ', '_');
+			ILUTF16Replace(dest2, buf1, len, ' ', '_');
+			if(ILUTF16Mismatch(dest1, dest2, len) != -1 ||
+			   (len > 0 && RefIndexOf(dest2, len, ' ') != -1))
+			{
+				ILUnitFailed("%s replace failed for length %ld", name, len);
+			}
+		}
+	}
+}
+
+/*
+ * Modify the first character of a buffer on every pass so that
+ * the compiler can't hoist the reference loops out of the passes.
+ */
+#define	TOUCH(buf,pass)	((buf)[0] = (unsigned short)('0' + ((pass) & 7)))
+
+/*
+ * Time the UTF-16 kernels, or the reference loops if "name" is NULL.
+ */
+static void utf16Bench(const char *name)
+{
+	static const unsigned short anyOf[] = {'#', '|', '\n'};
+	unsigned short *buf1;
+	unsigned short *buf2;
+	ILCurrTime start;
+	ILInt64 chars = (ILInt64)UTF16_LENGTH * UTF16_PASSES;
+	int pass;
+	long result = 0;
+
+	if(name && strcmp(ILUTF16UseKernels(name), name) != 0)
+	{
+		printf("not supported by this CPU ... ");
+		ILUTF16UseKernels(0);
+		return;
+	}
+	buf1 = (unsigned short *)ILMalloc(UTF16_LENGTH * sizeof(unsigned short));
+	buf2 = (unsigned short *)ILMalloc(UTF16_LENGTH * sizeof(unsigned short));
+	if(!buf1 || !buf2)
+	{
+		ILUnitOutOfMemory();
+	}
+	fillText(buf1, UTF16_LENGTH);
+	fillText(buf2, UTF16_LENGTH);
+	buf1[UTF16_LENGTH - 1] = '\n';
+	if(name)
+	{
+		checkKernels(name);
+	}
+
+	ILGetSinceRebootTime(&start);
+	for(pass = 0; pass < UTF16_PASSES; ++pass)
+	{
+		TOUCH(buf1, pass);
+		result += (name ? ILUTF16IndexOf(buf1, UTF16_LENGTH, '\n')
+						: RefIndexOf(buf1, UTF16_LENGTH, '\n'));
+	}
+	reportRate("IndexOf chars", chars, elapsedMs(&start));
+
+	ILGetSinceRebootTime(&start);
+	for(pass = 0; pass < UTF16_PASSES; ++pass)
+	{
+		TOUCH(buf2, pass);
+		result += (name ? ILUTF16LastIndexOf(buf2, UTF16_LENGTH, '\n')
+						: RefLastIndexOf(buf2, UTF16_LENGTH, '\n'));
+	}
+	reportRate("LastIndexOf chars", chars, elapsedMs(&start));
+
+	ILGetSinceRebootTime(&start);
+	for(pass = 0; pass < UTF16_PASSES; ++pass)
+	{
+		TOUCH(buf1, pass);
+		result += (name ? ILUTF16IndexOfAny(buf1, UTF16_LENGTH, anyOf, 3)
+						: RefIndexOfAny(buf1, UTF16_LENGTH, anyOf, 3));
+	}
+	reportRate("IndexOfAny chars", chars, elapsedMs(&start));
+
+	ILGetSinceRebootTime(&start);
+	for(pass = 0; pass < UTF16_PASSES; ++pass)
+	{
+		TOUCH(buf1, pass);
+		TOUCH(buf2, pass);
+		result += (name ? ILUTF16CompareOrdinal(buf1, UTF16_LENGTH,
+												buf2, UTF16_LENGTH)
+						: RefCompareOrdinal(buf1, UTF16_LENGTH,
+											buf2, UTF16_LENGTH));
+	}
+	reportRate("CompareOrdinal chars", chars, elapsedMs(&start));
+
+	ILGetSinceRebootTime(&start);
+	for(pass = 0; pass < UTF16_PASSES; ++pass)
+	{
+		TOUCH(buf1, pass);
+		if(name)
+		{
+			ILUTF16Replace(buf2, buf1, UTF16_LENGTH, ' ', '_');
+		}
+		else
+		{
+			RefReplace(buf2, buf1, UTF16_LENGTH, ' ', '_');
+		}
+	}
+	reportRate("Replace chars", chars, elapsedMs(&start));
+
+	if(result != (ILInt64)UTF16_PASSES * (2 * (UTF16_LENGTH - 1) - 2))
+	{
+		ILUnitFailed("unexpected search results");
+	}
+	ILFree(buf1);
+	ILFree(buf2);
+	ILUTF16UseKernels(0);
+}
+
+static void utf16_reference(void *arg)
+{
+	utf16Bench(0);
+}
+
+static void utf16_scalar(void *arg)
+{
+	utf16Bench("scalar");
+}
+
+static void utf16_sse2(void *arg)
+{
+	utf16Bench("sse2");
+}
+
+static void utf16_avx2(void *arg)
+{
+	utf16Bench("avx2");
+}
+
+/*
+ * Time searches of short strings with the reference loops or the
+ * current kernels, in milliseconds.
+ */
+static ILInt64 utf16ShortTime(unsigned short *buf, int useKernels)
+{
+	static const unsigned short anyOf[] = {'#', '|', '\n'};
+	ILCurrTime start;
+	long result = 0;
+	int pass;
+
+	ILGetSinceRebootTime(&start);
+	for(pass = 0; pass < UTF16_SHORT_SEARCHES; ++pass)
+	{
+		TOUCH(buf, pass);
+		if(useKernels)
+		{
+			result += ILUTF16IndexOf(buf, UTF16_SHORT_LENGTH, '\n');
+			result += ILUTF16IndexOfAny(buf, UTF16_SHORT_LENGTH, anyOf, 3);
+		}
+		else
+		{
+			result += RefIndexOf(buf, UTF16_SHORT_LENGTH, '\n');
+			result += RefIndexOfAny(buf, UTF16_SHORT_LENGTH, anyOf, 3);
+		}
+	}
+	if(result != (ILInt64)UTF16_SHORT_SEARCHES * 2 * (UTF16_SHORT_LENGTH - 1))
+	{
+		ILUnitFailed("unexpected search results");
+	}
+	return elapsedMs(&start);
+}
+
+/*
+ * Time the kernels against the reference loops on short strings,
+ * where setting up the vectors and switching between the instruction
+ * sets costs more than the search itself.
+ */
+static void utf16_short(void *arg)
+{
+	static const char * const names[] = {"scalar", "sse2", "avx2"};
+	unsigned short buf[UTF16_SHORT_LENGTH];
+	ILInt64 refMs, ms;
+	int posn;
+
+	fillText(buf, UTF16_SHORT_LENGTH);
+	buf[UTF16_SHORT_LENGTH - 1] = '\n';
+	refMs = utf16ShortTime(buf, 0);
+	printf("reference %lld ms", (long long)refMs);
+	for(posn = 0; posn < 3; ++posn)
+	{
+		if(strcmp(ILUTF16UseKernels(names[posn]), names[posn]) != 0)
+		{
+			continue;
+		}
+		ms = utf16ShortTime(buf, 1);
+		printf(", %s %lld ms", names[posn], (long long)ms);
+	}
+	printf(" ... ");
+	fflush(stdout);
+	ILUTF16UseKernels(0);
+}
+
+#if defined(IL_CONFIG_NETWORKING) && defined(HAVE_SYS_SOCKET_H) && \
+	!defined(IL_WIN32_NATIVE)
+#define	POLL_TESTS_SUPPORTED	1
+
+/*
+ * Number of socket pairs in the poll set benchmarks.  Only one of
+ * them is ever ready, which is typical of a server with many idle
+ * connections.
+ */
+#define	POLL_PAIRS			250
+
+/*
+ * Number of waits to time in the poll set benchmarks.
+ */
+#define	POLL_WAITS			20000
+
+/*
+ * Create socket pairs for the poll set tests.  The first socket of
+ * each pair is polled and the second is written to.
+ */
+static void createPairs(ILSysIOHandle *polled, ILSysIOHandle *peers, int num)
+{
+	int fds[2];
+	int posn;
+
+	/* Poll sets that are not built on "epoll" use mutexes */
+	ILThreadInit();
+
+	for(posn = 0; posn < num; ++posn)
+	{
+		if(socketpair(AF_UNIX, SOCK_DGRAM, 0, fds) < 0)
+		{
+			ILUnitFailed("could not create socket pair %d", posn);
+		}
+		polled[posn] = (ILSysIOHandle)(ILNativeInt)(fds[0]);
+		peers[posn] = (ILSysIOHandle)(ILNativeInt)(fds[1]);
+	}
+}
+
+/*
+ * Close the socket pairs for the poll set tests.
+ */
+static void closePairs(ILSysIOHandle *polled, ILSysIOHandle *peers, int num)
+{
+	int posn;
+	for(posn = 0; posn < num; ++posn)
+	{
+		ILSysIOSocketClose(polled[posn]);
+		ILSysIOSocketClose(peers[posn]);
+	}
+}
+
+#endif /* POLL_TESTS_SUPPORTED */
+
+/*
+ * Check the semantics of poll sets: readiness, one-shot
+ * registrations, re-arming and removal.
+ */
+static void pollset_events(void *arg)
+{
+#ifdef POLL_TESTS_SUPPORTED
+	ILSysIOHandle polled[4];
+	ILSysIOHandle peers[4];
+	ILSysIOHandle handles[4];
+	ILInt32 events[4];
+	ILSysIOPollSet *set;
+	ILInt32 count;
+	int posn;
+
+	createPairs(polled, peers, 4);
+	if((set = ILSysIOPollSetCreate()) == 0)
+	{
+		ILUnitFailed("could not create a poll set");
+	}
+	for(posn = 0; posn < 4; ++posn)
+	{
+		if(!ILSysIOPollSetAdd(set, polled[posn],
+							  IL_SYSIO_POLL_READ | IL_SYSIO_POLL_ONESHOT))
+		{
+			ILUnitFailed("could not add socket %d", posn);
+		}
+	}
+
+	/* Nothing is ready yet */
+	if((count = ILSysIOPollSetWait(set, handles, events, 4, 0)) != 0)
+	{
+		ILUnitFailed("empty wait returned %ld", (long)count);
+	}
+
+	/* Make the third socket ready, and check that it is reported once */
+	ILSysIOSocketSend(peers[2], "x", 1, 0);
+	count = ILSysIOPollSetWait(set, handles, events, 4, 1000000);
+	if(count != 1 || handles[0] != polled[2] ||
+	   events[0] != IL_SYSIO_POLL_READ)
+	{
+		ILUnitFailed("ready wait returned %ld", (long)count);
+	}
+	if((count = ILSysIOPollSetWait(set, handles, events, 4, 0)) != 0)
+	{
+		ILUnitFailed("one-shot socket was reported again");
+	}
+
+	/* Re-arm it, and check that it is reported again */
+	ILSysIOPollSetAdd(set, polled[2], IL_SYSIO_POLL_READ);
+	count = ILSysIOPollSetWait(set, handles, events, 4, 0);
+	if(count != 1 || handles[0] != polled[2])
+	{
+		ILUnitFailed("re-armed wait returned %ld", (long)count);
+	}
+
+	/* Remove it, and check that it is no longer reported */
+	if(!ILSysIOPollSetRemove(set, polled[2]))
+	{
+		ILUnitFailed("could not remove socket");
+	}
+	if((count = ILSysIOPollSetWait(set, handles, events, 4, 0)) != 0)
+	{
+		ILUnitFailed("removed socket was reported");
+	}
+	if(ILSysIOPollSetRemove(set, polled[2]))
+	{
+		ILUnitFailed("removed socket was removed again");
+	}
+
+	ILSysIOPollSetDestroy(set);
+	closePairs(polled, peers, 4);
+#else
+	printf("not supported ... ");
+#endif
+}
+
+/*
+ * Time waits on a poll set with many idle sockets and one ready one.
+ */
+static void pollset_wait(void *arg)
+{
+#ifdef POLL_TESTS_SUPPORTED
+	ILSysIOHandle polled[POLL_PAIRS];
+	ILSysIOHandle peers[POLL_PAIRS];
+	ILSysIOHandle handles[8];
+	ILInt32 events[8];
+	ILSysIOPollSet *set;
+	ILCurrTime start;
+	int posn;
+
+	createPairs(polled, peers, POLL_PAIRS);
+	if((set = ILSysIOPollSetCreate()) == 0)
+	{
+		ILUnitFailed("could not create a poll set");
+	}
+	for(posn = 0; posn < POLL_PAIRS; ++posn)
+	{
+		ILSysIOPollSetAdd(set, polled[posn], IL_SYSIO_POLL_READ);
+	}
+	ILSysIOSocketSend(peers[POLL_PAIRS / 2], "x", 1, 0);
+
+	ILGetSinceRebootTime(&start);
+	for(posn = 0; posn < POLL_WAITS; ++posn)
+	{
+		if(ILSysIOPollSetWait(set, handles, events, 8, 0) != 1)
+		{
+			ILUnitFailed("wait %d did not find the ready socket", posn);
+		}
+	}
+	reportRate("waits", POLL_WAITS, elapsedMs(&start));
+
+	ILSysIOPollSetDestroy(set);
+	closePairs(polled, peers, POLL_PAIRS);
+#else
+	printf("not supported ... ");
+#endif
+}
+
+/*
+ * Time the same waits with "ILSysIOSocketSelect", for comparison.
+ */
+static void pollset_select(void *arg)
+{
+#ifdef POLL_TESTS_SUPPORTED
+	ILSysIOHandle polled[POLL_PAIRS];
+	ILSysIOHandle peers[POLL_PAIRS];
+	ILSysIOHandle readfds[POLL_PAIRS];
+	ILCurrTime start;
+	int posn;
+
+	createPairs(polled, peers, POLL_PAIRS);
+	ILSysIOSocketSend(peers[POLL_PAIRS / 2], "x", 1, 0);
+
+	ILGetSinceRebootTime(&start);
+	for(posn = 0; posn < POLL_WAITS; ++posn)
+	{
+		/* "select" overwrites the sockets that are not ready */
+		ILMemCpy(readfds, polled, sizeof(polled));
+		if(ILSysIOSocketSelect((ILSysIOHandle **)readfds, POLL_PAIRS,
+							   0, 0, 0, 0, 0) != 1)
+		{
+			ILUnitFailed("select %d did not find the ready socket", posn);
+		}
+	}
+	reportRate("waits", POLL_WAITS, elapsedMs(&start));
+
+	closePairs(polled, peers, POLL_PAIRS);
+#else
+	printf("not supported ... ");
+#endif
+}
+
+/*
+ * Number of threads and enters per thread in the monitor benchmarks.
+ */
+#define	MONITOR_THREADS		4
+#define	MONITOR_ENTERS		200000
+
+/*
+ * Monitor locations for the monitor benchmarks.
+ */
+static void *monitorLocations[MONITOR_THREADS][4];
+static void *sharedMonitor;
+static volatile long sharedCounter;
+
+/*
+ * Enter and leave monitors that no other thread is using.
+ */
+static void monitorPrivateFunc(void *arg)
+{
+	void **locations = (void **)arg;
+	int count;
+	for(count = 0; count < MONITOR_ENTERS; ++count)
+	{
+		ILMonitorEnter(&(locations[count & 3]));
+		ILMonitorExit(&(locations[count & 3]));
+	}
+}
+
+/*
+ * Enter and leave a monitor that all threads are using.
+ */
+static void monitorSharedFunc(void *arg)
+{
+	int count;
+	for(count = 0; count < MONITOR_ENTERS / 10; ++count)
+	{
+		ILMonitorEnter(&sharedMonitor);
+		++sharedCounter;
+		ILMonitorExit(&sharedMonitor);
+	}
+}
+
+/*
+ * Run a monitor benchmark on several threads and return the
+ * elapsed time in milliseconds.
+ */
+static ILInt64 monitorBench(ILThreadStartFunc func, int shared)
+{
+	ILThread *threads[MONITOR_THREADS];
+	ILCurrTime start;
+	int posn;
+
+	ILThreadInit();
+	ILGetSinceRebootTime(&start);
+	for(posn = 0; posn < MONITOR_THREADS; ++posn)
+	{
+		threads[posn] = ILThreadCreate
+			(func, (shared ? 0 : (void *)(monitorLocations[posn])));
+		if(!threads[posn] || !ILThreadStart(threads[posn]))
+		{
+			ILUnitFailed("could not start thread %d", posn);
+		}
+	}
+	for(posn = 0; posn < MONITOR_THREADS; ++posn)
+	{
+		ILThreadJoin(threads[posn], -1);
+		ILThreadDestroy(threads[posn]);
+	}
+	return elapsedMs(&start);
+}
+
+/*
+ * Time uncontended monitors, and check that they are inflated
+ * from the thread caches without going to the pool.
+ */
+static void monitor_private(void *arg)
+{
+	ILMonitorStats before;
+	ILMonitorStats after;
+	ILInt64 total = (ILInt64)MONITOR_THREADS * MONITOR_ENTERS;
+	ILInt64 ms;
+
+	ILThreadInit();
+	ILMonitorGetStats(&before);
+	ms = monitorBench(monitorPrivateFunc, 0);
+	reportRate("enters", total, ms);
+	ILMonitorGetStats(&after);
+	if((ILInt64)(after.cacheHits - before.cacheHits) < total)
+	{
+		ILUnitFailed("only %ld monitors came from the thread caches",
+					 (long)(after.cacheHits - before.cacheHits));
+	}
+	if((ILInt64)(after.cacheMisses - before.cacheMisses) > total / 1000)
+	{
+		ILUnitFailed("%ld thread cache refills",
+					 (long)(after.cacheMisses - before.cacheMisses));
+	}
+}
+
+/*
+ * Time a monitor that all threads are using, and check that
+ * it provides mutual exclusion.
+ */
+static void monitor_shared(void *arg)
+{
+	ILInt64 total = (ILInt64)MONITOR_THREADS * (MONITOR_ENTERS / 10);
+	ILInt64 ms;
+
+	sharedCounter = 0;
+	ms = monitorBench(monitorSharedFunc, 1);
+	reportRate("enters", total, ms);
+	if(sharedCounter != (long)total)
+	{
+		ILUnitFailed("counter is %ld instead of %ld",
+					 (long)sharedCounter, (long)total);
+	}
+}
+
+/*
+ * Patterns for the regular expression tests.  Patterns that start
+ * with "!" must be rejected by the DFA.
+ */
+static const char * const regexPatterns[] = {
+	"abc", "a|b|c", "a*", "a+b", "(ab)*c", "a?b?c?", "^abc", "abc$",
+	"^$", "^", "$", "x*$", "a.c", "[a-c]+", "[^a-c]+", "[[:digit:]]+",
+	"[]a]", "[a-]+", "a{2}", "a{2,}", "a{1,3}b", "(a|ab)(c|bcd)(d*)",
+	"(foo|foobar)baz", "\\.", "\\w+", "\\W", "(^a|b$)", "a$|^b",
+	"(a|^)b", "a($|b)", "ERROR [0-9]+", "[[:alpha:]_][[:alnum:]_]*=",
+	"()", "(|x)y", "(a*)*b", "([a-z]+)@([a-z]+)\\.com",
+	"!(a)\\1", "!\\bfoo", "!\\<foo", "![[.a.]]"
+};
+#define	NUM_REGEX_PATTERNS	\
+	(sizeof(regexPatterns) / sizeof(regexPatterns[0]))
+
+/*
+ * Inputs for the regular expression tests.
+ */
+static const char * const regexInputs[] = {
+	"", "abc", "xabcx", "aaa", "ab\nc", "a\nb", "b\na", "\nabc\n",
+	"AbC", "aab", "acbd", "abcbcd", "foobarbaz", "x=1", "_y2 = 3",
+	"me@example.com and you@test.com", "a.b", "--]a-", "line\n\n",
+	"ERROR 42 then ERROR 7", "aaab", "ab ab\nab", "a\0bc"
+};
+#define	NUM_REGEX_INPUTS	\
+	(sizeof(regexInputs) / sizeof(regexInputs[0]))
+
+/*
+ * Convert an ASCII string into UTF-16.
+ */
+static long regexToUTF16(unsigned short *buf, const char *str)
+{
+	long len = 0;
+	while(str[len] != '\0')
+	{
+		buf[len] = (unsigned char)(str[len]);
+		++len;
+	}
+	return len;
+}
+
+/*
+ * Check that the DFA agrees with "regexec" on the overall match.
+ */
+static void regex_dfa(void *arg)
+{
+	static const int cflagList[] =
+		{REG_EXTENDED, REG_EXTENDED | REG_ICASE, REG_EXTENDED | REG_NEWLINE};
+	static const int eflagList[] = {0, REG_NOTBOL, REG_NOTEOL};
+	unsigned short buf[64];
+	const char *pattern;
+	ILRegexDFA *dfa;
+	regex_t regex;
+	regmatch_t match;
+	int pnum, inum, cnum, fnum, expected, result;
+	long len, start, end;
+
+	ILThreadInit();
+	for(pnum = 0; pnum < NUM_REGEX_PATTERNS; ++pnum)
+	{
+		for(cnum = 0; cnum < 3; ++cnum)
+		{
+			pattern = regexPatterns[pnum];
+			dfa = ILRegexDFACreate(pattern + (*pattern == '!'),
+								   cflagList[cnum]);
+			if(*pattern == '!')
+			{
+				if(dfa)
+				{
+					ILUnitFailed("DFA accepted \"%s\"", pattern + 1);
+				}
+				continue;
+			}
+			if(!dfa)
+			{
+				ILUnitFailed("DFA rejected \"%s\"", pattern);
+			}
+			if(IL_regcomp(&regex, pattern, cflagList[cnum]) != 0)
+			{
+				ILUnitFailed("regcomp failed on \"%s\"", pattern);
+			}
+			for(inum = 0; inum < NUM_REGEX_INPUTS; ++inum)
+			{
+				/* "a\0bc" is passed with its NUL, which must truncate it */
+				len = regexToUTF16(buf, regexInputs[inum]);
+				if(!strcmp(regexInputs[inum], "a"))
+				{
+					buf[1] = 0;
+					buf[2] = 'b';
+					buf[3] = 'c';
+					len = 4;
+				}
+				for(fnum = 0; fnum < 3; ++fnum)
+				{
+					expected = (IL_regexec(&regex, regexInputs[inum], 1,
+										   &match, eflagList[fnum]) == 0);
+					result = ILRegexDFAExec(dfa, buf, len, eflagList[fnum],
+											&start, &end);
+					if(result != expected ||
+					   (expected && (start != (long)(match.rm_so) ||
+									 end != (long)(match.rm_eo))))
+					{
+						ILUnitFailed("\"%s\" on \"%s\" (%d/%d): "
+									 "DFA %d [%ld,%ld], regexec %d [%ld,%ld]",
+									 pattern, regexInputs[inum],
+									 cflagList[cnum], eflagList[fnum],
+									 result, start, end, expected,
+									 (long)(match.rm_so), (long)(match.rm_eo));
+					}
+					result = ILRegexDFAExec(dfa, buf, len, eflagList[fnum],
+											0, 0);
+					if(result != expected)
+					{
+						ILUnitFailed("\"%s\" on \"%s\": existence test failed",
+									 pattern, regexInputs[inum]);
+					}
+				}
+			}
+			IL_regfree(&regex);
+			ILRegexDFADestroy(dfa);
+		}
+	}
+
+	/* Non-ASCII input must use the fallback */
+	dfa = ILRegexDFACreate("a", REG_EXTENDED);
+	buf[0] = 0x00E9;
+	buf[1] = 'a';
+	if(!dfa || ILRegexDFAExec(dfa, buf, 2, 0, &start, &end) != -1)
+	{
+		ILUnitFailed("non-ASCII input did not fall back");
+	}
+	ILRegexDFADestroy(dfa);
+}
+
+/*
+ * Number of lines to search in the regular expression benchmark,
+ * and the number of times that they are searched.
+ */
+#define	REGEX_LINES			100000
+#define	REGEX_PASSES		10
+
+/*
+ * Length of the lines in the regular expression benchmark.
+ */
+#define	REGEX_LINE_SIZE		80
+
+/*
+ * Time the DFA and "regexec" on log-like lines.  Both are asked only
+ * whether there is a match, which is what "ExecInternal" in the engine
+ * does.  "regexec" is given the lines as C strings that were converted
+ * up front, so the conversion that "ExecInternal" does before calling
+ * it is not counted.  Only the match counts are checked.
+ */
+static void regex_bench(void *arg)
+{
+	static const char * const pattern =
+		"(WARN|ERROR) [a-z]+\\.[a-z]+: code [0-9]+$";
+	char *lines;
+	unsigned short *buffers;
+	long *lengths;
+	ILRegexDFA *dfa;
+	regex_t regex;
+	ILCurrTime start;
+	ILInt64 dfaMs, regexMs;
+	int pass, posn, dfaHits, regexHits;
+
+	ILThreadInit();
+	dfa = ILRegexDFACreate(pattern, REG_EXTENDED);
+	if(!dfa || IL_regcomp(&regex, pattern, REG_EXTENDED) != 0)
+	{
+		ILUnitFailed("could not compile the benchmark pattern");
+	}
+
+	/* Build the lines in both encodings before timing anything */
+	lines = (char *)ILMalloc(REGEX_LINES * REGEX_LINE_SIZE);
+	buffers = (unsigned short *)ILMalloc
+		(REGEX_LINES * REGEX_LINE_SIZE * sizeof(unsigned short));
+	lengths = (long *)ILMalloc(REGEX_LINES * sizeof(long));
+	if(!lines || !buffers || !lengths)
+	{
+		ILUnitOutOfMemory();
+	}
+	for(posn = 0; posn < REGEX_LINES; ++posn)
+	{
+		sprintf(lines + posn * REGEX_LINE_SIZE,
+				"2010-03-%02d 12:%02d:%02d %s server.request: code %d",
+				posn % 28 + 1, posn % 60, (posn / 60) % 60,
+				((posn % 7) == 0 ? "ERROR" : "INFO"), posn);
+		lengths[posn] = regexToUTF16(buffers + posn * REGEX_LINE_SIZE,
+									 lines + posn * REGEX_LINE_SIZE);
+	}
+
+	/* Search with the DFA */
+	dfaHits = 0;
+	ILGetSinceRebootTime(&start);
+	for(pass = 0; pass < REGEX_PASSES; ++pass)
+	{
+		for(posn = 0; posn < REGEX_LINES; ++posn)
+		{
+			if(ILRegexDFAExec(dfa, buffers + posn * REGEX_LINE_SIZE,
+							  lengths[posn], 0, 0, 0) == 1)
+			{
+				++dfaHits;
+			}
+		}
+	}
+	dfaMs = elapsedMs(&start);
+	reportRate("dfa lines", REGEX_LINES * REGEX_PASSES, dfaMs);
+
+	/* Search with "regexec" */
+	regexHits = 0;
+	ILGetSinceRebootTime(&start);
+	for(pass = 0; pass < REGEX_PASSES; ++pass)
+	{
+		for(posn = 0; posn < REGEX_LINES; ++posn)
+		{
+			if(IL_regexec(&regex, lines + posn * REGEX_LINE_SIZE,
+						  0, 0, 0) == 0)
+			{
+				++regexHits;
+			}
+		}
+	}
+	regexMs = elapsedMs(&start);
+	reportRate("regexec lines", REGEX_LINES * REGEX_PASSES, regexMs);
+
+	IL_regfree(&regex);
+	ILRegexDFADestroy(dfa);
+	ILFree(lines);
+	ILFree(buffers);
+	ILFree(lengths);
+	if(dfaHits != regexHits)
+	{
+		ILUnitFailed("DFA found %d lines, regexec found %d",
+					 dfaHits, regexHits);
+	}
+}
+
+/*
+ * Time a pattern that makes "regexec" backtrack exponentially.
+ */
+static void regex_backtrack(void *arg)
+{
+	static const char * const pattern = "(x+x+)+y";
+	char line[32];
+	unsigned short buf[32];
+	ILRegexDFA *dfa;
+	regex_t regex;
+	regmatch_t match;
+	ILCurrTime start;
+	long len, mstart, mend;
+	int posn;
+
+	ILThreadInit();
+	dfa = ILRegexDFACreate(pattern, REG_EXTENDED);
+	if(!dfa || IL_regcomp(&regex, pattern, REG_EXTENDED) != 0)
+	{
+		ILUnitFailed("could not compile the backtracking pattern");
+	}
+	strcpy(line, "xxxxxxxxxxxxxxxxxx");
+	len = regexToUTF16(buf, line);
+
+	ILGetSinceRebootTime(&start);
+	for(posn = 0; posn < 100000; ++posn)
+	{
+		if(ILRegexDFAExec(dfa, buf, len, 0, &mstart, &mend) != 0)
+		{
+			ILUnitFailed("DFA matched \"%s\"", line);
+		}
+	}
+	reportRate("dfa searches", 100000, elapsedMs(&start));
+
+	ILGetSinceRebootTime(&start);
+	for(posn = 0; posn < 5; ++posn)
+	{
+		if(IL_regexec(&regex, line, 1, &match, 0) == 0)
+		{
+			ILUnitFailed("regexec matched \"%s\"", line);
+		}
+	}
+	printf("%lld ms per regexec search ... ",
+		   (long long)(elapsedMs(&start) / 5));
+	fflush(stdout);
+
+	IL_regfree(&regex);
+	ILRegexDFADestroy(dfa);
+}
+
+/*
+ * Document for the XML reader tests, and the items that it contains.
+ * Start tags are "<name", singletons "<name/", end tags "/name",
+ * and text items are "=text".  Parameters follow as "@name=value".
+ */
+static const char xmlDocument[] =
+	"<?xml version=\"1.0\"?>\n"
+	"<!DOCTYPE doc [ <!ENTITY x \"y\"> ]>\n"
+	"<!-- a comment with -- dashes -->\n"
+	"<doc xmlns:n=\"urn:x\" a='1' b = \"two &amp; &lt;3&gt;\">\n"
+	"  <n:item id=\"&#65;&#x42;\"/>\n"
+	"  <item>Text &quot;quoted&quot; here</item>\n"
+	"  <empty a=\"\" b='x/y'></empty>\n"
+	"  &lt;leading entity\n"
+	"</doc>\n";
+static const char * const xmlItems[] = {
+	"<doc", "@xmlns:n=urn:x", "@a=1", "@b=two & <3>",
+	"<item/", "@id=AB",
+	"<item", "=Text \"quoted\" here", "/item",
+	"<empty", "@a=", "@b=x/y", "/empty",
+	"=<leading entity\n",
+	"/doc",
+	0
+};
+
+/*
+ * Read data from a string in small pieces, to test window refills.
+ */
+typedef struct
+{
+	const char *data;
+	int			len;
+	int			posn;
+	int			chunk;
+
+} XMLStringSource;
+static int xmlStringRead(void *data, void *buffer, int len)
+{
+	XMLStringSource *source = (XMLStringSource *)data;
+	if(len > source->chunk)
+	{
+		len = source->chunk;
+	}
+	if(len > (source->len - source->posn))
+	{
+		len = source->len - source->posn;
+	}
+	ILMemCpy(buffer, source->data + source->posn, len);
+	source->posn += len;
+	return len;
+}
+
+/*
+ * Check the items that a reader returns for "xmlDocument".
+ */
+static void checkXMLItems(ILXMLReader *reader, const char *how)
+{
+	const char * const *expected = xmlItems;
+	const char *value;
+	char item[256];
+	char *equals;
+	ILXMLItem kind;
+	int len;
+
+	while((kind = ILXMLReadNext(reader)) != ILXMLItem_EOF)
+	{
+		/* Format the item in the same way as "xmlItems" */
+		switch(kind)
+		{
+			case ILXMLItem_StartTag:
+			case ILXMLItem_SingletonTag:
+			{
+				sprintf(item, "<%s%s", ILXMLTagName(reader),
+						(kind == ILXMLItem_SingletonTag ? "/" : ""));
+			}
+			break;
+
+			case ILXMLItem_EndTag:
+			{
+				sprintf(item, "/%s", ILXMLTagName(reader));
+			}
+			break;
+
+			default:
+			{
+				sprintf(item, "=%s", ILXMLGetText(reader));
+				value = ILXMLGetTextView(reader, &len);
+				if(len != (int)strlen(item + 1) ||
+				   ILMemCmp(value, item + 1, len) != 0)
+				{
+					ILUnitFailed("%s: text view differs for \"%s\"",
+								 how, item);
+				}
+			}
+			break;
+		}
+		if(!(*expected) || strcmp(*expected, item) != 0)
+		{
+			ILUnitFailed("%s: got \"%s\", expected \"%s\"", how, item,
+						 (*expected ? *expected : "EOF"));
+		}
+		++expected;
+
+		/* Check the parameters with both lookup methods */
+		while(*expected && (*expected)[0] == '@')
+		{
+			strcpy(item, *expected + 1);
+			equals = strchr(item, '=');
+			*equals = '\0';
+			value = ILXMLGetParam(reader, item);
+			if(!value || strcmp(value, equals + 1) != 0)
+			{
+				ILUnitFailed("%s: parameter %s is \"%s\"", how, item,
+							 (value ? value : "NULL"));
+			}
+			value = ILXMLGetParamView(reader, item, &len);
+			if(!value || len != (int)strlen(equals + 1) ||
+			   ILMemCmp(value, equals + 1, len) != 0)
+			{
+				ILUnitFailed("%s: parameter view %s differs", how, item);
+			}
+			++expected;
+		}
+	}
+	if(*expected)
+	{
+		ILUnitFailed("%s: EOF before \"%s\"", how, *expected);
+	}
+}
+
+/*
+ * Check the XML reader on buffers, and on streams that are
+ * delivered in pieces of various sizes.
+ */
+static void xml_items(void *arg)
+{
+	XMLStringSource source;
+	ILXMLReader *reader;
+	char how[64];
+	int chunk;
+
+	reader = ILXMLCreateFromBuffer(xmlDocument, strlen(xmlDocument), 0);
+	if(!reader)
+	{
+		ILUnitOutOfMemory();
+	}
+	checkXMLItems(reader, "buffer");
+	ILXMLDestroy(reader);
+
+	for(chunk = 1; chunk <= 64; chunk = chunk * 2 + 1)
+	{
+		source.data = xmlDocument;
+		source.len = strlen(xmlDocument);
+		source.posn = 0;
+		source.chunk = chunk;
+		reader = ILXMLCreate(xmlStringRead, &source, 0);
+		if(!reader)
+		{
+			ILUnitOutOfMemory();
+		}
+		sprintf(how, "stream in %d byte pieces", chunk);
+		checkXMLItems(reader, how);
+		ILXMLDestroy(reader);
+	}
+}
+
+/*
+ * Check that text items are split when the text size is limited.
+ */
+static void xml_max_text(void *arg)
+{
+	static const char document[] = "<a>0123456789abcdef&amp;xyz</a>";
+	static const char * const pieces[] =
+		{"01234567", "89abcdef", "&xyz"};
+	ILXMLReader *reader;
+	int piece = 0;
+
+	reader = ILXMLCreateFromBuffer(document, strlen(document), 9);
+	if(!reader)
+	{
+		ILUnitOutOfMemory();
+	}
+	while(ILXMLReadNext(reader) != ILXMLItem_EOF)
+	{
+		if(ILXMLGetItem(reader) != ILXMLItem_Text)
+		{
+			continue;
+		}
+		if(piece >= 3 || strcmp(ILXMLGetText(reader), pieces[piece]) != 0)
+		{
+			ILUnitFailed("piece %d is \"%s\"", piece, ILXMLGetText(reader));
+		}
+		++piece;
+	}
+	if(piece != 3)
+	{
+		ILUnitFailed("only %d pieces", piece);
+	}
+	ILXMLDestroy(reader);
+}
+
+/*
+ * Number of elements in the XML benchmark file.
+ */
+#define	XML_ELEMENTS		60000
+
+/*
+ * Read an XML file and return the number of items in it.
+ */
+static long readXMLItems(ILXMLReader *reader)
+{
+	long items = 0;
+	while(ILXMLReadNext(reader) != ILXMLItem_EOF)
+	{
+		if(ILXMLIsTag(reader, "member") &&
+		   !ILXMLGetParam(reader, "name"))
+		{
+			ILUnitFailed("missing name parameter");
+		}
+		++items;
+	}
+	return items;
+}
+
+/*
+ * Read data from a stdio stream for the XML benchmark.
+ */
+static int xmlStdioRead(void *data, void *buffer, int len)
+{
+	return (int)fread(buffer, 1, len, (FILE *)data);
+}
+
+/*
+ * Time the XML reader on a multi-megabyte file, both mapped into
+ * memory and read from a stream.
+ */
+static void xml_bench(void *arg)
+{
+	FILE *file;
+	ILXMLReader *reader;
+	ILCurrTime start;
+	ILInt64 ms;
+	long size, items, streamItems;
+	int posn;
+
+	/* Build a file that looks like the output of "csdoc" */
+	file = tmpfile();
+	if(!file)
+	{
+		ILUnitFailed("could not create a temporary file");
+	}
+	fputs("<?xml version=\"1.0\"?>\n<Libraries>\n", file);
+	for(posn = 0; posn < XML_ELEMENTS; ++posn)
+	{
+		fprintf(file, "  <member name=\"M:Namespace.Type%d.Method(System."
+				"String,System.Int32)\" kind=\"method\">\n"
+				"    <summary>Performs operation &lt;%d&gt; on the "
+				"object, and returns the result.</summary>\n"
+				"    <param name=\"value\">The value to use.</param>\n"
+				"  </member>\n", posn % 97, posn);
+	}
+	fputs("</Libraries>\n", file);
+	fflush(file);
+	size = ftell(file);
+
+	/* Read it from mapped memory */
+	rewind(file);
+	ILGetSinceRebootTime(&start);
+	reader = ILXMLCreateFromStream(file, 0);
+	if(!reader)
+	{
+		ILUnitOutOfMemory();
+	}
+	items = readXMLItems(reader);
+	ILXMLDestroy(reader);
+	ms = elapsedMs(&start);
+	reportRate("mapped KB", size / 1024, ms);
+
+	/* Read it as a stream */
+	rewind(file);
+	ILGetSinceRebootTime(&start);
+	reader = ILXMLCreate(xmlStdioRead, file, 0);
+	if(!reader)
+	{
+		ILUnitOutOfMemory();
+	}
+	streamItems = readXMLItems(reader);
+	ILXMLDestroy(reader);
+	ms = elapsedMs(&start);
+	reportRate("streamed KB", size / 1024, ms);
+
+	fclose(file);
+	if(items != streamItems || items != (long)XML_ELEMENTS * 8 + 2)
+	{
+		ILUnitFailed("read %ld and %ld items", items, streamItems);
+	}
+}
+
+/*
+ * Size of the buffers and number of passes in the crypto benchmarks.
+ */
+#define	CRYPT_LENGTH		65536
+#define	CRYPT_PASSES		200
+#define	CRYPT_BUFFERS		64
+#define	CRYPT_BUFFER_LENGTH	4096
+
+/*
+ * Fill a buffer with pseudo-random bytes.
+ */
+static void fillBytes(unsigned char *buf, long len, ILUInt32 seed)
+{
+	long posn;
+	for(posn = 0; posn < len; ++posn)
+	{
+		seed = seed * 1103515245 + 12345;
+		buf[posn] = (unsigned char)(seed >> 16);
+	}
+}
+
+/*
+ * Check the current AES kernels against the scalar kernels for all
+ * key sizes and for runs of blocks that are not a multiple of four.
+ */
+static void checkAES(const char *name)
+{
+	ILAESContext aes;
+	unsigned char key[32];
+	unsigned char plain[16 * 9];
+	unsigned char cipher1[16 * 9];
+	unsigned char cipher2[16 * 9];
+	int keyBits, numBlocks, block;
+
+	fillBytes(key, sizeof(key), 1);
+	fillBytes(plain, sizeof(plain), 2);
+	for(keyBits = 128; keyBits <= 256; keyBits += 64)
+	{
+		ILAESInit(&aes, key, keyBits);
+		for(numBlocks = 1; numBlocks <= 9; ++numBlocks)
+		{
+			ILAESUseKernels("scalar");
+			for(block = 0; block < numBlocks; ++block)
+			{
+				ILAESEncrypt(&aes, plain + block * 16, cipher1 + block * 16);
+			}
+			ILAESUseKernels(name);
+			ILAESEncryptBlocks(&aes, plain, cipher2, numBlocks);
+			if(ILMemCmp(cipher1, cipher2, numBlocks * 16) != 0)
+			{
+				ILUnitFailed("%s encryption failed for %d-bit keys "
+							 "and %d blocks", name, keyBits, numBlocks);
+			}
+			ILAESDecryptBlocks(&aes, cipher2, cipher2, numBlocks);
+			if(ILMemCmp(plain, cipher2, numBlocks * 16) != 0)
+			{
+				ILUnitFailed("%s decryption failed for %d-bit keys "
+							 "and %d blocks", name, keyBits, numBlocks);
+			}
+		}
+		ILAESFinalize(&aes);
+	}
+}
+
+/*
+ * Time the AES kernels with a specific name.
+ */
+static void aesBench(const char *name)
+{
+	ILAESContext aes;
+	unsigned char key[16];
+	unsigned char *buf;
+	ILCurrTime start;
+	int passes = (strcmp(name, "scalar") != 0 ? CRYPT_PASSES * 20
+											  : CRYPT_PASSES);
+	ILInt64 bytes = (ILInt64)CRYPT_LENGTH * passes;
+	int pass;
+	long posn;
+
+	if(strcmp(ILAESUseKernels(name), name) != 0)
+	{
+		printf("not supported by this CPU ... ");
+		ILAESUseKernels(0);
+		return;
+	}
+	checkAES(name);
+	buf = (unsigned char *)ILMalloc(CRYPT_LENGTH);
+	if(!buf)
+	{
+		ILUnitOutOfMemory();
+	}
+	fillBytes(key, sizeof(key), 3);
+	fillBytes(buf, CRYPT_LENGTH, 4);
+	ILAESInit(&aes, key, 128);
+
+	/* One block at a time, which is how the crypto natives use AES */
+	ILGetSinceRebootTime(&start);
+	for(pass = 0; pass < passes; ++pass)
+	{
+		for(posn = 0; posn < CRYPT_LENGTH; posn += 16)
+		{
+			ILAESEncrypt(&aes, buf + posn, buf + posn);
+		}
+	}
+	reportRate("encrypt bytes", bytes, elapsedMs(&start));
+
+	ILGetSinceRebootTime(&start);
+	for(pass = 0; pass < passes; ++pass)
+	{
+		ILAESEncryptBlocks(&aes, buf, buf, CRYPT_LENGTH / 16);
+	}
+	reportRate("encrypt blocks bytes", bytes, elapsedMs(&start));
+
+	ILGetSinceRebootTime(&start);
+	for(pass = 0; pass < passes; ++pass)
+	{
+		ILAESDecryptBlocks(&aes, buf, buf, CRYPT_LENGTH / 16);
+	}
+	reportRate("decrypt blocks bytes", bytes, elapsedMs(&start));
+
+	ILAESFinalize(&aes);
+	ILFree(buf);
+	ILAESUseKernels(0);
+}
+
+static void aes_scalar(void *arg)
+{
+	aesBench("scalar");
+}
+
+static void aes_aesni(void *arg)
+{
+	aesBench("aesni");
+}
+
+/*
+ * Check the current SHA1 and SHA-256 kernels against the scalar
+ * kernels for short lengths, fed in pieces of various sizes.
+ */
+static void checkSHA(const char *name, int sha256)
+{
+	ILSHAContext sha1;
+	ILSHA256Context sha2;
+	unsigned char buf[300];
+	unsigned char hash1[IL_SHA256_HASH_SIZE];
+	unsigned char hash2[IL_SHA256_HASH_SIZE];
+	long len, posn, piece;
+	int pass;
+
+	fillBytes(buf, sizeof(buf), 5);
+	for(len = 0; len <= (long)sizeof(buf); ++len)
+	{
+		for(pass = 0; pass < 2; ++pass)
+		{
+			if(sha256)
+			{
+				ILSHA256UseKernels(pass ? name : "scalar");
+				ILSHA256Init(&sha2);
+			}
+			else
+			{
+				ILSHAUseKernels(pass ? name : "scalar");
+				ILSHAInit(&sha1);
+			}
+			for(posn = 0; posn < len; posn += piece)
+			{
+				piece = (pass ? len - posn : 1 + (posn % 70));
+				if(piece > len - posn)
+				{
+					piece = len - posn;
+				}
+				if(sha256)
+				{
+					ILSHA256Data(&sha2, buf + posn, (unsigned long)piece);
+				}
+				else
+				{
+					ILSHAData(&sha1, buf + posn, (unsigned long)piece);
+				}
+			}
+			if(sha256)
+			{
+				ILSHA256Finalize(&sha2, (pass ? hash2 : hash1));
+			}
+			else
+			{
+				ILSHAFinalize(&sha1, (pass ? hash2 : hash1));
+			}
+		}
+		if(ILMemCmp(hash1, hash2, (sha256 ? IL_SHA256_HASH_SIZE
+										  : IL_SHA_HASH_SIZE)) != 0)
+		{
+			ILUnitFailed("%s kernels failed for length %ld", name, len);
+		}
+	}
+}
+
+/*
+ * Time the SHA1 kernels with a specific name.
+ */
+static void sha1Bench(const char *name)
+{
+	ILSHAContext sha;
+	unsigned char *buf;
+	unsigned char hash[IL_SHA_HASH_SIZE];
+	ILCurrTime start;
+	int pass;
+
+	if(strcmp(ILSHAUseKernels(name), name) != 0)
+	{
+		printf("not supported by this CPU ... ");
+		ILSHAUseKernels(0);
+		return;
+	}
+	checkSHA(name, 0);
+	ILSHAUseKernels(name);
+	buf = (unsigned char *)ILMalloc(CRYPT_LENGTH);
+	if(!buf)
+	{
+		ILUnitOutOfMemory();
+	}
+	fillBytes(buf, CRYPT_LENGTH, 6);
+
+	ILGetSinceRebootTime(&start);
+	ILSHAInit(&sha);
+	for(pass = 0; pass < CRYPT_PASSES; ++pass)
+	{
+		ILSHAData(&sha, buf, CRYPT_LENGTH);
+	}
+	ILSHAFinalize(&sha, hash);
+	reportRate("bytes", (ILInt64)CRYPT_LENGTH * CRYPT_PASSES,
+			   elapsedMs(&start));
+
+	ILFree(buf);
+	ILSHAUseKernels(0);
+}
+
+static void sha1_scalar(void *arg)
+{
+	sha1Bench("scalar");
+}
+
+static void sha1_ssse3(void *arg)
+{
+	sha1Bench("ssse3");
+}
+
+static void sha1_shani(void *arg)
+{
+	sha1Bench("shani");
+}
+
+/*
+ * Check "ILSHA256HashBuffers" against hashing the buffers one
+ * at a time, for buffers of different lengths.
+ */
+static void checkSHA256Buffers(const char *name)
+{
+	unsigned char buf[CRYPT_BUFFERS * 200];
+	const void *buffers[CRYPT_BUFFERS];
+	unsigned long lens[CRYPT_BUFFERS];
+	unsigned char hashes[CRYPT_BUFFERS * IL_SHA256_HASH_SIZE];
+	unsigned char hash[IL_SHA256_HASH_SIZE];
+	ILSHA256Context sha;
+	int posn;
+
+	fillBytes(buf, sizeof(buf), 7);
+	for(posn = 0; posn < CRYPT_BUFFERS; ++posn)
+	{
+		buffers[posn] = buf + posn * 200;
+		lens[posn] = (unsigned long)((posn * 37) % 200);
+	}
+	ILSHA256HashBuffers(buffers, lens, CRYPT_BUFFERS - 3, hashes);
+	ILSHA256UseKernels("scalar");
+	for(posn = 0; posn < CRYPT_BUFFERS - 3; ++posn)
+	{
+		ILSHA256Init(&sha);
+		ILSHA256Data(&sha, buffers[posn], lens[posn]);
+		ILSHA256Finalize(&sha, hash);
+		if(ILMemCmp(hash, hashes + posn * IL_SHA256_HASH_SIZE,
+					IL_SHA256_HASH_SIZE) != 0)
+		{
+			ILUnitFailed("%s kernels failed for buffer %d", name, posn);
+		}
+	}
+	ILSHA256UseKernels(name);
+}
+
+/*
+ * Time the SHA-256 kernels with a specific name.
+ */
+static void sha256Bench(const char *name)
+{
+	ILSHA256Context sha;
+	unsigned char *buf;
+	unsigned char hash[IL_SHA256_HASH_SIZE];
+	unsigned char hashes[CRYPT_BUFFERS * IL_SHA256_HASH_SIZE];
+	const void *buffers[CRYPT_BUFFERS];
+	unsigned long lens[CRYPT_BUFFERS];
+	ILCurrTime start;
+	int pass, posn;
+
+	if(strcmp(ILSHA256UseKernels(name), name) != 0)
+	{
+		printf("not supported by this CPU ... ");
+		ILSHA256UseKernels(0);
+		return;
+	}
+	checkSHA(name, 1);
+	ILSHA256UseKernels(name);
+	checkSHA256Buffers(name);
+	buf = (unsigned char *)ILMalloc(CRYPT_LENGTH);
+	if(!buf)
+	{
+		ILUnitOutOfMemory();
+	}
+	fillBytes(buf, CRYPT_LENGTH, 8);
+
+	ILGetSinceRebootTime(&start);
+	ILSHA256Init(&sha);
+	for(pass = 0; pass < CRYPT_PASSES; ++pass)
+	{
+		ILSHA256Data(&sha, buf, CRYPT_LENGTH);
+	}
+	ILSHA256Finalize(&sha, hash);
+	reportRate("bytes", (ILInt64)CRYPT_LENGTH * CRYPT_PASSES,
+			   elapsedMs(&start));
+
+	/* Hash many 4K buffers at once, like a checksumming service */
+	for(posn = 0; posn < CRYPT_BUFFERS; ++posn)
+	{
+		buffers[posn] = buf + (posn * CRYPT_BUFFER_LENGTH) % CRYPT_LENGTH;
+		lens[posn] = CRYPT_BUFFER_LENGTH;
+	}
+	ILGetSinceRebootTime(&start);
+	for(pass = 0; pass < CRYPT_PASSES; ++pass)
+	{
+		ILSHA256HashBuffers(buffers, lens, CRYPT_BUFFERS, hashes);
+	}
+	reportRate("buffer bytes",
+			   (ILInt64)CRYPT_BUFFERS * CRYPT_BUFFER_LENGTH * CRYPT_PASSES,
+			   elapsedMs(&start));
+
+	ILFree(buf);
+	ILSHA256UseKernels(0);
+}
+
+static void sha256_scalar(void *arg)
+{
+	sha256Bench("scalar");
+}
+
+static void sha256_ssse3(void *arg)
+{
+	sha256Bench("ssse3");
+}
+
+static void sha256_avx2(void *arg)
+{
+	sha256Bench("avx2");
+}
+
+static void sha256_shani(void *arg)
+{
+	sha256Bench("shani");
+}
+
+/*
+ * Time SHA-512, which only has scalar kernels.
+ */
+static void sha512_scalar(void *arg)
+{
+	ILSHA512Context sha;
+	unsigned char *buf;
+	unsigned char hash[IL_SHA512_HASH_SIZE];
+	ILCurrTime start;
+	int pass;
+
+	buf = (unsigned char *)ILMalloc(CRYPT_LENGTH);
+	if(!buf)
+	{
+		ILUnitOutOfMemory();
+	}
+	fillBytes(buf, CRYPT_LENGTH, 9);
+
+	ILGetSinceRebootTime(&start);
+	ILSHA512Init(&sha);
+	for(pass = 0; pass < CRYPT_PASSES; ++pass)
+	{
+		ILSHA512Data(&sha, buf, CRYPT_LENGTH);
+	}
+	ILSHA512Finalize(&sha, hash);
+	reportRate("bytes", (ILInt64)CRYPT_LENGTH * CRYPT_PASSES,
+			   elapsedMs(&start));
+
+	ILFree(buf);
+}
+
+/*
+ * Simple test registration macro.
+ */
+#define	RegisterSimple(name)	(ILUnitRegister(#name, name, 0))
+
+/*
+ * Register all unit tests.
+ */
+void ILUnitRegisterTests(void)
+{
+	/*
+	 * Hash tables.
+	 */
+	ILUnitRegisterSuite("Hash Tables");
+	RegisterSimple(hashtab_grow);
+	RegisterSimple(hashtab_duplicates);
+	RegisterSimple(hashtab_churn);
+	RegisterSimple(class_lookup);
+
+	/*
+	 * Metadata loading.
+	 */
+	ILUnitRegisterSuite("Metadata Loading");
+	RegisterSimple(lazy_metadata);
+	if(ILHasThreads())
+	{
+		RegisterSimple(lazy_metadata_threads);
+		RegisterSimple(lazy_token_lookups);
+	}
+
+	/*
+	 * UTF-16 search and compare kernels.
+	 */
+	ILUnitRegisterSuite("UTF-16 Kernels");
+	RegisterSimple(utf16_reference);
+	RegisterSimple(utf16_scalar);
+	RegisterSimple(utf16_sse2);
+	RegisterSimple(utf16_avx2);
+	RegisterSimple(utf16_short);
+
+	/*
+	 * Socket poll sets.
+	 */
+	ILUnitRegisterSuite("Socket Poll Sets");
+	RegisterSimple(pollset_events);
+	RegisterSimple(pollset_wait);
+	RegisterSimple(pollset_select);
+
+	/*
+	 * Monitor pool.
+	 */
+	ILUnitRegisterSuite("Monitors");
+	RegisterSimple(monitor_private);
+	RegisterSimple(monitor_shared);
+
+	/*
+	 * Regular expressions.
+	 */
+	ILUnitRegisterSuite("Regular Expressions");
+	RegisterSimple(regex_dfa);
+	RegisterSimple(regex_bench);
+	RegisterSimple(regex_backtrack);
+
+	/*
+	 * XML reader.
+	 */
+	ILUnitRegisterSuite("XML Reader");
+	RegisterSimple(xml_items);
+	RegisterSimple(xml_max_text);
+	RegisterSimple(xml_bench);
+
+	/*
+	 * Crypto kernels.
+	 */
+	ILUnitRegisterSuite("Crypto Kernels");
+	RegisterSimple(aes_scalar);
+	RegisterSimple(aes_aesni);
+	RegisterSimple(sha1_scalar);
+	RegisterSimple(sha1_ssse3);
+	RegisterSimple(sha1_shani);
+	RegisterSimple(sha256_scalar);
+	RegisterSimple(sha256_ssse3);
+	RegisterSimple(sha256_avx2);
+	RegisterSimple(sha256_shani);
+	RegisterSimple(sha512_scalar);
+}
+
+void ILUnitCleanupTests(void)
+{
+}
+
+#ifdef	__cplusplus
+};
+#endif
@@ -0,0 +1,294 @@
+/*
+ * test_link.c - Test the library handling in "ilalink".
+ *
+ * Copyright (C) 2026  Free Software Foundation, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ilunit.h"
+#include "il_system.h"
+#include "il_program.h"
+#include "il_writer.h"
+#include "il_linker.h"
+#include "il_sysio.h"
+#ifdef HAVE_SYS_TYPES_H
+#include <sys/types.h>
+#endif
+#ifdef HAVE_SYS_STAT_H
+#include <sys/stat.h>
+#endif
+#ifdef HAVE_FCNTL_H
+#include <fcntl.h>
+#endif
+#include <time.h>
+
+#ifdef	__cplusplus
+extern	"C" {
+#endif
+
+/*
+ * Files that are used by the library index tests.  The type names
+ * have the same length, so that every build of the library has the
+ * same size, and only the index header can tell the builds apart.
+ */
+#define	INDEX_LIBRARY		"./linkidx.dll"
+#define	INDEX_LIBRARY_NEW	"./linkidx.new"
+#define	INDEX_FILE			"./linkidx.dll.ilidx"
+#define	INDEX_OUTPUT		"./linkidx.out"
+#define	INDEX_OLD_TYPE		"StaleType"
+#define	INDEX_NEW_TYPE		"FreshType"
+
+#if defined(HAVE_STAT) && defined(HAVE_STAT_ST_MTIM) && defined(HAVE_UTIMENSAT)
+
+/*
+ * Write a library that contains a single type called "typeName".
+ */
+static void writeLibrary(const char *filename, const char *typeName)
+{
+	ILContext *context;
+	ILImage *image;
+	ILWriter *writer;
+	ILClass *classInfo;
+	FILE *stream;
+
+	context = ILContextCreate();
+	if(!context)
+	{
+		ILUnitOutOfMemory();
+	}
+	image = ILImageCreate(context);
+	if(!image || !ILModuleCreate(image, 0, "linkidx.dll", 0) ||
+	   !ILAssemblyCreate(image, 0, "linkidx", 0))
+	{
+		ILUnitOutOfMemory();
+	}
+	classInfo = ILClassCreate(ILClassGlobalScope(image), 0,
+							  typeName, "LinkTest", 0);
+	if(!classInfo)
+	{
+		ILUnitOutOfMemory();
+	}
+	ILClassSetAttrs(classInfo, ~0, IL_META_TYPEDEF_PUBLIC);
+	if((stream = fopen(filename, "wb")) == NULL)
+	{
+		ILUnitFailed("could not open `%s' for writing", filename);
+	}
+	writer = ILWriterCreate(stream, 1, IL_IMAGETYPE_DLL, 0);
+	if(!writer)
+	{
+		ILUnitOutOfMemory();
+	}
+	ILWriterOutputMetadata(writer, image);
+	if(ILWriterDestroy(writer) <= 0)
+	{
+		ILUnitFailed("could not write `%s'", filename);
+	}
+	fclose(stream);
+	ILContextDestroy(context);
+}
+
+/*
+ * Set the modification time of a file.
+ */
+static void setModTime(const char *filename, time_t secs, long nsecs)
+{
+	struct timespec times[2];
+	times[0].tv_sec = secs;
+	times[0].tv_nsec = nsecs;
+	times[1].tv_sec = secs;
+	times[1].tv_nsec = nsecs;
+	if(utimensat(AT_FDCWD, filename, times, 0) < 0)
+	{
+		ILUnitFailed("could not set the modification time of `%s'", filename);
+	}
+}
+
+/*
+ * Link against the library with the library index enabled.
+ */
+static void linkLibrary(void)
+{
+	ILLinker *linker;
+	FILE *stream;
+	int ok;
+
+	if((stream = fopen(INDEX_OUTPUT, "wb")) == NULL)
+	{
+		ILUnitFailed("could not open `%s' for writing", INDEX_OUTPUT);
+	}
+	linker = ILLinkerCreate(stream, 1, IL_IMAGETYPE_DLL, 0);
+	if(!linker)
+	{
+		ILUnitOutOfMemory();
+	}
+	ILLinkerSetFlags(linker, IL_LINKFLAG_LIBRARY_INDEX);
+	ok = ILLinkerAddLibrary(linker, INDEX_LIBRARY);
+	ILLinkerDestroy(linker);
+	fclose(stream);
+	if(!ok)
+	{
+		ILUnitFailed("could not link against `%s'", INDEX_LIBRARY);
+	}
+}
+
+/*
+ * Determine if the library index mentions a type name.
+ */
+static int indexMentions(const char *typeName)
+{
+	char buffer[8192];
+	FILE *file;
+	int len, nameLen, posn;
+
+	if((file = fopen(INDEX_FILE, "rb")) == NULL)
+	{
+		ILUnitFailed("`%s' was not written", INDEX_FILE);
+	}
+	len = (int)fread(buffer, 1, sizeof(buffer), file);
+	fclose(file);
+	nameLen = strlen(typeName);
+	for(posn = 0; posn + nameLen <= len; ++posn)
+	{
+		if(!ILMemCmp(buffer + posn, typeName, nameLen))
+		{
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Get the inode of the library index, which changes every time
+ * that the index is rewritten.
+ */
+static ino_t indexInode(void)
+{
+	struct stat st;
+	if(stat(INDEX_FILE, &st) < 0)
+	{
+		ILUnitFailed("`%s' was not written", INDEX_FILE);
+	}
+	return st.st_ino;
+}
+
+/*
+ * Remove the files that are used by the library index tests.
+ */
+static void removeFiles(void)
+{
+	ILDeleteFile(INDEX_LIBRARY);
+	ILDeleteFile(INDEX_LIBRARY_NEW);
+	ILDeleteFile(INDEX_FILE);
+	ILDeleteFile(INDEX_OUTPUT);
+}
+
+/*
+ * Build the library, link against it to write the index, and
+ * check that a second link uses the index as-is.
+ */
+static void indexPrepare(time_t secs)
+{
+	ino_t inode;
+
+	removeFiles();
+	writeLibrary(INDEX_LIBRARY, INDEX_OLD_TYPE);
+	setModTime(INDEX_LIBRARY, secs, 0);
+	linkLibrary();
+	if(!indexMentions(INDEX_OLD_TYPE))
+	{
+		ILUnitFailed("the index does not describe the library");
+	}
+	inode = indexInode();
+	linkLibrary();
+	if(indexInode() != inode)
+	{
+		ILUnitFailed("the index was rewritten for an unchanged library");
+	}
+}
+
+/*
+ * Check that the index was rebuilt from the new version of the library.
+ */
+static void indexCheckRebuilt(void)
+{
+	linkLibrary();
+	if(indexMentions(INDEX_OLD_TYPE) || !indexMentions(INDEX_NEW_TYPE))
+	{
+		removeFiles();
+		ILUnitFailed("a stale index was used for a rebuilt library");
+	}
+	removeFiles();
+}
+
+/*
+ * Rebuild the library in place within the same second, so that
+ * only the sub-second part of its modification time changes.
+ */
+static void index_same_second(void *arg)
+{
+	time_t secs = time(0);
+	indexPrepare(secs);
+	writeLibrary(INDEX_LIBRARY, INDEX_NEW_TYPE);
+	setModTime(INDEX_LIBRARY, secs, 1);
+	indexCheckRebuilt();
+}
+
+/*
+ * Replace the library with a new file that has exactly the same
+ * size and modification time, so that only its inode changes.
+ */
+static void index_replaced(void *arg)
+{
+	time_t secs = time(0);
+	indexPrepare(secs);
+	writeLibrary(INDEX_LIBRARY_NEW, INDEX_NEW_TYPE);
+	setModTime(INDEX_LIBRARY_NEW, secs, 0);
+	if(ILRenameDir(INDEX_LIBRARY_NEW, INDEX_LIBRARY) != 0)
+	{
+		ILUnitFailed("could not replace `%s'", INDEX_LIBRARY);
+	}
+	indexCheckRebuilt();
+}
+
+#endif /* HAVE_STAT && HAVE_STAT_ST_MTIM && HAVE_UTIMENSAT */
+
+/*
+ * Simple test registration macro.
+ */
+#define	RegisterSimple(name)	(ILUnitRegister(#name, name, 0))
+
+/*
+ * Register all unit tests.
+ */
+void ILUnitRegisterTests(void)
+{
+	/*
+	 * Library index.
+	 */
+	ILUnitRegisterSuite("Library Index");
+#if defined(HAVE_STAT) && defined(HAVE_STAT_ST_MTIM) && defined(HAVE_UTIMENSAT)
+	RegisterSimple(index_same_second);
+	RegisterSimple(index_replaced);
+#endif
+}
+
+void ILUnitCleanupTests(void)
+{
+}
+
+#ifdef	__cplusplus
+};
+#endif
@@ -0,0 +1,330 @@
+/*
+ * test_spawn.c - Test running functions in child processes.
+ *
+ * Copyright (C) 2026  Free Software Foundation, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ilunit.h"
+#if HAVE_UNISTD_H
+	#include <unistd.h>
+#endif
+
+#ifdef	__cplusplus
+extern	"C" {
+#endif
+
+#if defined(HAVE_FORK) && defined(HAVE_USLEEP) && !defined(IL_WIN32_PLATFORM)
+
+/*
+ * Number of jobs used by the job set tests.
+ */
+#define	NUM_JOBS		8
+
+/*
+ * Put a child process to sleep for a number of milliseconds.
+ */
+static void sleepMs(int ms)
+{
+	usleep(ms * 1000);
+}
+
+/*
+ * Read the contents of a captured output stream into a buffer.
+ */
+static void readCaptured(FILE *stream, char *buffer, int size)
+{
+	int len;
+	fflush(stream);
+	rewind(stream);
+	len = (int)fread(buffer, 1, size - 1, stream);
+	buffer[len] = '\0';
+}
+
+/*
+ * Child function that writes to stdout and stderr, and then exits
+ * with the status that is passed as its argument.
+ */
+static int captureFunc(void *arg)
+{
+	printf("output %d\n", (int)(ILNativeInt)arg);
+	fprintf(stderr, "errors %d\n", (int)(ILNativeInt)arg);
+	return (int)(ILNativeInt)arg;
+}
+
+/*
+ * Child function that sleeps for the number of milliseconds that
+ * is passed as its argument.
+ */
+static int sleepFunc(void *arg)
+{
+	sleepMs((int)(ILNativeInt)arg);
+	return 0;
+}
+
+/*
+ * Test that the output and exit status of a child are captured.
+ */
+static void spawn_capture(void *arg)
+{
+	void *output;
+	void *errors;
+	char buffer[64];
+	int pid, status;
+
+	pid = ILSpawnFunction(captureFunc, (void *)(ILNativeInt)3,
+						  &output, &errors);
+	if(pid <= 0)
+	{
+		ILUnitFailed("could not spawn the child process");
+	}
+	if(ILSpawnWaitForAny(&status) != pid)
+	{
+		ILUnitFailed("the wrong child process was reported");
+	}
+	if(status != 3)
+	{
+		ILUnitFailed("exit status was %d instead of 3", status);
+	}
+	readCaptured((FILE *)output, buffer, sizeof(buffer));
+	fclose((FILE *)output);
+	if(strcmp(buffer, "output 3\n") != 0)
+	{
+		fclose((FILE *)errors);
+		ILUnitFailed("stdout was captured as \"%s\"", buffer);
+	}
+	readCaptured((FILE *)errors, buffer, sizeof(buffer));
+	fclose((FILE *)errors);
+	if(strcmp(buffer, "errors 3\n") != 0)
+	{
+		ILUnitFailed("stderr was captured as \"%s\"", buffer);
+	}
+}
+
+/*
+ * Test that waiting for any child reports every child once, in the
+ * order that they exit, and then reports that none are left.
+ */
+static void spawn_wait_any(void *arg)
+{
+	void *output[3];
+	void *errors[3];
+	int pids[3];
+	int posn, status;
+
+	for(posn = 0; posn < 3; ++posn)
+	{
+		pids[posn] = ILSpawnFunction(sleepFunc,
+									 (void *)(ILNativeInt)((3 - posn) * 100),
+									 &(output[posn]), &(errors[posn]));
+		if(pids[posn] <= 0)
+		{
+			ILUnitFailed("could not spawn child process %d", posn);
+		}
+	}
+	for(posn = 2; posn >= 0; --posn)
+	{
+		if(ILSpawnWaitForAny(&status) != pids[posn])
+		{
+			ILUnitFailed("child process %d did not exit in order", posn);
+		}
+		if(status != 0)
+		{
+			ILUnitFailed("child process %d exited with %d", posn, status);
+		}
+		fclose((FILE *)(output[posn]));
+		fclose((FILE *)(errors[posn]));
+	}
+	if(ILSpawnWaitForAny(&status) != -1)
+	{
+		ILUnitFailed("a child process was reported twice");
+	}
+}
+
+/*
+ * Child function for a job: sleep for longer the earlier the job is,
+ * so that the jobs exit in reverse order, and then report the job.
+ */
+static int jobFunc(void *arg)
+{
+	int job = (int)(ILNativeInt)arg;
+	sleepMs((NUM_JOBS - job) * 20);
+	printf("job %d\n", job);
+	fprintf(stderr, "job %d error\n", job);
+	return (job == 5 ? 2 : 0);
+}
+
+/*
+ * Test that a job set prints the output of its jobs in the order that
+ * they were started, and not the order that they exit.
+ */
+static void spawn_jobs_order(void *arg)
+{
+	ILSpawnJobs *jobs;
+	FILE *output;
+	FILE *errors;
+	char buffer[512];
+	char expected[512];
+	char expectedErrors[512];
+	int job, status;
+
+	if((output = tmpfile()) == 0 || (errors = tmpfile()) == 0)
+	{
+		ILUnitFailed("could not create the output files");
+	}
+	jobs = ILSpawnJobsCreate(NUM_JOBS, 4, 4, output, errors);
+	if(!jobs)
+	{
+		ILUnitOutOfMemory();
+	}
+	expected[0] = '\0';
+	expectedErrors[0] = '\0';
+	for(job = 0; job < NUM_JOBS; ++job)
+	{
+		if(job == 3)
+		{
+			/* Jobs that the caller deals with have no output */
+			ILSpawnJobsSkip(jobs);
+			continue;
+		}
+		if(ILSpawnJobsStart(jobs, jobFunc, (void *)(ILNativeInt)job) <= 0)
+		{
+			ILUnitFailed("could not start job %d", job);
+		}
+		sprintf(expected + strlen(expected), "job %d\n", job);
+		sprintf(expectedErrors + strlen(expectedErrors),
+				"job %d error\n", job);
+	}
+	status = ILSpawnJobsFinish(jobs);
+	readCaptured(output, buffer, sizeof(buffer));
+	fclose(output);
+	if(strcmp(buffer, expected) != 0)
+	{
+		fclose(errors);
+		ILUnitFailed("the output was out of order:\n%s", buffer);
+	}
+	readCaptured(errors, buffer, sizeof(buffer));
+	fclose(errors);
+	if(strcmp(buffer, expectedErrors) != 0)
+	{
+		ILUnitFailed("the errors were out of order:\n%s", buffer);
+	}
+	if(status != 2)
+	{
+		ILUnitFailed("exit status was %d instead of 2", status);
+	}
+}
+
+/*
+ * Child function for a job that is slow if it is the first job.
+ */
+static int slowFirstFunc(void *arg)
+{
+	int job = (int)(ILNativeInt)arg;
+	if(job == 0)
+	{
+		sleepMs(300);
+	}
+	printf("job %d\n", job);
+	return 0;
+}
+
+/*
+ * Test that a job set does not start a job while the output of too
+ * many earlier jobs is waiting to be printed.
+ */
+static void spawn_jobs_held(void *arg)
+{
+	ILSpawnJobs *jobs;
+	FILE *output;
+	FILE *errors;
+	char buffer[512];
+	char expected[32];
+	int job;
+
+	if((output = tmpfile()) == 0 || (errors = tmpfile()) == 0)
+	{
+		ILUnitFailed("could not create the output files");
+	}
+	jobs = ILSpawnJobsCreate(NUM_JOBS, 2, 3, output, errors);
+	if(!jobs)
+	{
+		ILUnitOutOfMemory();
+	}
+	for(job = 0; job < NUM_JOBS; ++job)
+	{
+		if(ILSpawnJobsStart(jobs, slowFirstFunc,
+							(void *)(ILNativeInt)job) <= 0)
+		{
+			ILUnitFailed("could not start job %d", job);
+		}
+
+		/* At most three jobs can be held, so the output of the job
+		   that was started three jobs ago must have been printed */
+		if(job >= 3)
+		{
+			sprintf(expected, "job %d\n", job - 3);
+			readCaptured(output, buffer, sizeof(buffer));
+			fseek(output, 0, SEEK_END);
+			if(!strstr(buffer, expected))
+			{
+				ILSpawnJobsFinish(jobs);
+				fclose(output);
+				fclose(errors);
+				ILUnitFailed("job %d started before job %d was printed",
+							 job, job - 3);
+			}
+		}
+	}
+	if(ILSpawnJobsFinish(jobs) != 0)
+	{
+		ILUnitFailed("a job failed");
+	}
+	fclose(output);
+	fclose(errors);
+}
+
+#endif /* HAVE_FORK && HAVE_USLEEP && !IL_WIN32_PLATFORM */
+
+/*
+ * Simple test registration macro.
+ */
+#define	RegisterSimple(name)	(ILUnitRegister(#name, name, 0))
+
+/*
+ * Register all unit tests.
+ */
+void ILUnitRegisterTests(void)
+{
+	/*
+	 * Child processes.
+	 */
+	ILUnitRegisterSuite("Spawn");
+#if defined(HAVE_FORK) && defined(HAVE_USLEEP) && !defined(IL_WIN32_PLATFORM)
+	RegisterSimple(spawn_capture);
+	RegisterSimple(spawn_wait_any);
+	RegisterSimple(spawn_jobs_order);
+	RegisterSimple(spawn_jobs_held);
+#endif
+}
+
+void ILUnitCleanupTests(void)
+{
+}
+
+#ifdef	__cplusplus
+};
+#endif